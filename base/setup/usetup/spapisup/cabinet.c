@@ -305,11 +305,6 @@ MSZipCodecUncompress(
     return CS_SUCCESS;
 }
 
-static CAB_CODEC MSZipCodec =
-{
-    MSZipCodecUncompress, {0}
-};
-
 
 /* Memory functions */
 
@@ -807,6 +802,15 @@ VOID
 CabinetClose(
     IN OUT PCABINET_CONTEXT CabinetContext)
 {
+    if (CabinetContext->MSZipCodec)
+    {
+        RtlFreeHeap(ProcessHeap, 0, CabinetContext->MSZipCodec);
+        CabinetContext->MSZipCodec = NULL;
+
+        CabinetContext->CodecSelected = FALSE;
+        CabinetSelectCodec(CabinetContext, CAB_CODEC_RAW);
+    }
+
     if (!CabinetContext->FileOpen)
         return;
 
@@ -1029,6 +1033,9 @@ CabinetExtractFile(
             return CAB_STATUS_UNSUPPCOMP;
     }
 
+    if (!CabinetContext->CodecSelected)
+        return CAB_STATUS_NOMEMORY;
+
     DPRINT("Extracting file at uncompressed offset (0x%X) Size (%d bytes)\n",
            (UINT)Search->File->FileOffset, (UINT)Search->File->FileSize);
 
@@ -1329,7 +1336,19 @@ CabinetSelectCodec(
 
         case CAB_CODEC_MSZIP:
         {
-            CabinetContext->Codec = &MSZipCodec;
+            /* The codec state is per-context, so that contexts can be used by different threads */
+            if (CabinetContext->MSZipCodec == NULL)
+            {
+                CabinetContext->MSZipCodec = RtlAllocateHeap(ProcessHeap,
+                                                             HEAP_ZERO_MEMORY,
+                                                             sizeof(CAB_CODEC));
+                if (CabinetContext->MSZipCodec == NULL)
+                    return;
+
+                CabinetContext->MSZipCodec->Uncompress = MSZipCodecUncompress;
+            }
+
+            CabinetContext->Codec = CabinetContext->MSZipCodec;
             CabinetContext->Codec->ZStream.zalloc = MSZipAlloc;
             CabinetContext->Codec->ZStream.zfree = MSZipFree;
             CabinetContext->Codec->ZStream.opaque = (voidpf)0;
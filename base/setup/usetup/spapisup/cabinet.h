@@ -103,6 +103,7 @@ typedef struct _CABINET_CONTEXT
     ULONG FolderReserved;
     ULONG DataReserved;
     PCAB_CODEC Codec;
+    PCAB_CODEC MSZipCodec;          // Per-context MSZIP codec state
     ULONG CodecId;
     BOOL CodecSelected;
     ULONG LastFileOffset;           // Uncompressed offset of last extracted file
@@ -47,6 +47,14 @@ typedef struct _QUEUEENTRY
     PWSTR TargetFileName;
 } QUEUEENTRY, *PQUEUEENTRY;
 
+typedef struct _CABINET_STATE
+{
+    BOOLEAN HasCurrentCabinet;
+    CABINET_CONTEXT CabinetContext;
+    CAB_SEARCH Search;
+    WCHAR CurrentCabinetName[MAX_PATH];
+} CABINET_STATE, *PCABINET_STATE;
+
 typedef struct _FILEQUEUEHEADER
 {
     LIST_ENTRY DeleteQueue; // PQUEUEENTRY entries
@@ -58,18 +66,63 @@ typedef struct _FILEQUEUEHEADER
     LIST_ENTRY CopyQueue;   // PQUEUEENTRY entries
     ULONG CopyCount;
 
-    BOOLEAN HasCurrentCabinet;
-    CABINET_CONTEXT CabinetContext;
-    CAB_SEARCH Search;
-    WCHAR CurrentCabinetName[MAX_PATH];
+    CABINET_STATE Cabinet;  // Used for the retries done by the committing thread
 } FILEQUEUEHEADER, *PFILEQUEUEHEADER;
 
+/*
+ * The copy queue is committed by a pipeline: the files are copied or
+ * extracted by worker threads, each with its own cabinet context, while
+ * the committing thread sends the notifications in the order of the queue.
+ * At most COPY_WINDOW_SIZE copies may be in flight at once.
+ *
+ * STARTCOPY is sent when the result of a copy is reported, right before
+ * its ENDCOPY, so the notifications of different files never interleave.
+ * A worker may have done the copy already by then: skipping a file from
+ * STARTCOPY does not undo it, and aborting only cancels the copies that
+ * no worker has taken yet. The usetup handler never does either.
+ */
+#define COPY_MAX_WORKERS    4
+#define COPY_WINDOW_SIZE    16
+
+typedef struct _COPY_JOB
+{
+    PQUEUEENTRY Entry;
+    NTSTATUS Status;
+    BOOLEAN Completed;
+    WCHAR FileSrcPath[MAX_PATH];
+    WCHAR FileDstPath[MAX_PATH];
+} COPY_JOB, *PCOPY_JOB;
+
+struct _COPY_PIPELINE;
+
+typedef struct _COPY_WORKER
+{
+    struct _COPY_PIPELINE* Pipeline;
+    HANDLE Thread;
+    CABINET_STATE Cabinet;
+} COPY_WORKER, *PCOPY_WORKER;
+
+typedef struct _COPY_PIPELINE
+{
+    HANDLE Mutex;           // Protects the job counters and the completion flags
+    HANDLE JobSemaphore;    // Released once per queued job, and once per worker to stop it
+    HANDLE JobCompletedEvent;
+
+    ULONG Queued;           // Number of jobs handed to the workers
+    ULONG Started;          // Number of jobs taken by a worker
+    ULONG Retired;          // Number of jobs whose result has been reported
+
+    ULONG WorkerCount;      // May be zero, then the jobs are run synchronously
+    COPY_WORKER Workers[COPY_MAX_WORKERS];
+    COPY_JOB Jobs[COPY_WINDOW_SIZE];
+} COPY_PIPELINE, *PCOPY_PIPELINE;
+
 
 /* SETUP* API COMPATIBILITY FUNCTIONS ****************************************/
 
 static NTSTATUS
 SetupExtractFile(
-    IN OUT PFILEQUEUEHEADER QueueHeader,
+    IN OUT PCABINET_STATE Cabinet,
     IN PCWSTR CabinetFileName,
     IN PCWSTR SourceFileName,
     IN PCWSTR DestinationPathName)
@@ -79,54 +132,54 @@ SetupExtractFile(
     DPRINT("SetupExtractFile(CabinetFileName: '%S', SourceFileName: '%S', DestinationPathName: '%S')\n",
            CabinetFileName, SourceFileName, DestinationPathName);
 
-    if (QueueHeader->HasCurrentCabinet)
+    if (Cabinet->HasCurrentCabinet)
     {
-        DPRINT("CurrentCabinetName: '%S'\n", QueueHeader->CurrentCabinetName);
+        DPRINT("CurrentCabinetName: '%S'\n", Cabinet->CurrentCabinetName);
     }
 
-    if (QueueHeader->HasCurrentCabinet &&
-        (wcscmp(CabinetFileName, QueueHeader->CurrentCabinetName) == 0))
+    if (Cabinet->HasCurrentCabinet &&
+        (wcscmp(CabinetFileName, Cabinet->CurrentCabinetName) == 0))
     {
         DPRINT("Using same cabinet as last time\n");
 
         /* Use our last location because the files should be sequential */
-        CabStatus = CabinetFindNextFileSequential(&QueueHeader->CabinetContext,
+        CabStatus = CabinetFindNextFileSequential(&Cabinet->CabinetContext,
                                                   SourceFileName,
-                                                  &QueueHeader->Search);
+                                                  &Cabinet->Search);
         if (CabStatus != CAB_STATUS_SUCCESS)
         {
             DPRINT("Sequential miss on file: %S\n", SourceFileName);
 
             /* Looks like we got unlucky */
-            CabStatus = CabinetFindFirst(&QueueHeader->CabinetContext,
+            CabStatus = CabinetFindFirst(&Cabinet->CabinetContext,
                                          SourceFileName,
-                                         &QueueHeader->Search);
+                                         &Cabinet->Search);
         }
     }
     else
     {
         DPRINT("Using new cabinet\n");
 
-        if (QueueHeader->HasCurrentCabinet)
+        if (Cabinet->HasCurrentCabinet)
         {
-            QueueHeader->HasCurrentCabinet = FALSE;
-            CabinetCleanup(&QueueHeader->CabinetContext);
+            Cabinet->HasCurrentCabinet = FALSE;
+            CabinetCleanup(&Cabinet->CabinetContext);
         }
 
-        RtlStringCchCopyW(QueueHeader->CurrentCabinetName,
-                          ARRAYSIZE(QueueHeader->CurrentCabinetName),
+        RtlStringCchCopyW(Cabinet->CurrentCabinetName,
+                          ARRAYSIZE(Cabinet->CurrentCabinetName),
                           CabinetFileName);
 
-        CabinetInitialize(&QueueHeader->CabinetContext);
-        CabinetSetEventHandlers(&QueueHeader->CabinetContext,
+        CabinetInitialize(&Cabinet->CabinetContext);
+        CabinetSetEventHandlers(&Cabinet->CabinetContext,
                                 NULL, NULL, NULL, NULL);
-        CabinetSetCabinetName(&QueueHeader->CabinetContext, CabinetFileName);
+        CabinetSetCabinetName(&Cabinet->CabinetContext, CabinetFileName);
 
-        CabStatus = CabinetOpen(&QueueHeader->CabinetContext);
+        CabStatus = CabinetOpen(&Cabinet->CabinetContext);
         if (CabStatus == CAB_STATUS_SUCCESS)
         {
-            DPRINT("Opened cabinet %S\n", CabinetFileName /*CabinetGetCabinetName(&QueueHeader->CabinetContext)*/);
-            QueueHeader->HasCurrentCabinet = TRUE;
+            DPRINT("Opened cabinet %S\n", CabinetFileName /*CabinetGetCabinetName(&Cabinet->CabinetContext)*/);
+            Cabinet->HasCurrentCabinet = TRUE;
         }
         else
         {
@@ -135,20 +188,20 @@ SetupExtractFile(
         }
 
         /* We have to start at the beginning here */
-        CabStatus = CabinetFindFirst(&QueueHeader->CabinetContext,
+        CabStatus = CabinetFindFirst(&Cabinet->CabinetContext,
                                      SourceFileName,
-                                     &QueueHeader->Search);
+                                     &Cabinet->Search);
     }
 
     if (CabStatus != CAB_STATUS_SUCCESS)
     {
         DPRINT1("Unable to find '%S' in cabinet '%S'\n",
-                SourceFileName, CabinetGetCabinetName(&QueueHeader->CabinetContext));
+                SourceFileName, CabinetGetCabinetName(&Cabinet->CabinetContext));
         return STATUS_UNSUCCESSFUL;
     }
 
-    CabinetSetDestinationPath(&QueueHeader->CabinetContext, DestinationPathName);
-    CabStatus = CabinetExtractFile(&QueueHeader->CabinetContext, &QueueHeader->Search);
+    CabinetSetDestinationPath(&Cabinet->CabinetContext, DestinationPathName);
+    CabStatus = CabinetExtractFile(&Cabinet->CabinetContext, &Cabinet->Search);
     if (CabStatus != CAB_STATUS_SUCCESS)
     {
         DPRINT("Cannot extract file %S (%d)\n", SourceFileName, CabStatus);
@@ -158,6 +211,319 @@ SetupExtractFile(
     return STATUS_SUCCESS;
 }
 
+static NTSTATUS
+SetupCopyQueueEntry(
+    IN OUT PCABINET_STATE Cabinet,
+    IN PCOPY_JOB Job)
+{
+    if (Job->Entry->SourceCabinet != NULL)
+    {
+        /*
+         * The file is in a cabinet, use only the destination path
+         * and keep the source name as the target name.
+         */
+        /* Extract the file from the cabinet */
+        return SetupExtractFile(Cabinet,
+                                Job->FileSrcPath, // Specifies the cabinet path
+                                Job->Entry->SourceFileName,
+                                Job->Entry->TargetDirectory);
+    }
+    else
+    {
+        /* Copy the file */
+        return SetupCopyFile(Job->FileSrcPath, Job->FileDstPath, FALSE);
+    }
+}
+
+/* Loop to copy the queued files until asked to stop */
+static ULONG NTAPI
+SetupCopyWorkerThread(
+    IN PVOID Parameter)
+{
+    PCOPY_WORKER Worker = (PCOPY_WORKER)Parameter;
+    PCOPY_PIPELINE Pipeline = Worker->Pipeline;
+    PCOPY_JOB Job;
+    NTSTATUS Status;
+
+    for (;;)
+    {
+        /* Wait for a job, or for the request to stop */
+        NtWaitForSingleObject(Pipeline->JobSemaphore, FALSE, NULL);
+
+        NtWaitForSingleObject(Pipeline->Mutex, FALSE, NULL);
+        Job = ((Pipeline->Started != Pipeline->Queued)
+                  ? &Pipeline->Jobs[Pipeline->Started++ % COPY_WINDOW_SIZE] : NULL);
+        NtReleaseMutant(Pipeline->Mutex, NULL);
+
+        /* Stop if all the queued jobs have been taken */
+        if (Job == NULL)
+            break;
+
+        Status = SetupCopyQueueEntry(&Worker->Cabinet, Job);
+
+        NtWaitForSingleObject(Pipeline->Mutex, FALSE, NULL);
+        Job->Status = Status;
+        Job->Completed = TRUE;
+        NtReleaseMutant(Pipeline->Mutex, NULL);
+
+        NtSetEvent(Pipeline->JobCompletedEvent, NULL);
+    }
+
+    NtTerminateThread(NtCurrentThread(), STATUS_SUCCESS);
+    return 0;
+}
+
+static PCOPY_PIPELINE
+SetupCreateCopyPipeline(VOID)
+{
+    NTSTATUS Status;
+    PCOPY_PIPELINE Pipeline;
+    SYSTEM_BASIC_INFORMATION BasicInfo;
+    ULONG i, WorkerCount;
+
+    Pipeline = RtlAllocateHeap(ProcessHeap, HEAP_ZERO_MEMORY, sizeof(COPY_PIPELINE));
+    if (Pipeline == NULL)
+        return NULL;
+
+    /* Use one worker per processor */
+    Status = NtQuerySystemInformation(SystemBasicInformation,
+                                      &BasicInfo,
+                                      sizeof(BasicInfo),
+                                      NULL);
+    WorkerCount = (NT_SUCCESS(Status) ? BasicInfo.NumberOfProcessors : 1);
+    WorkerCount = min(max(WorkerCount, 1), COPY_MAX_WORKERS);
+
+    /*
+     * If anything fails from here, the pipeline runs with
+     * the workers started so far, or copies synchronously.
+     */
+    Status = NtCreateMutant(&Pipeline->Mutex,
+                            MUTANT_ALL_ACCESS,
+                            NULL, FALSE);
+    if (!NT_SUCCESS(Status))
+    {
+        DPRINT1("Could not create the copy mutex (Status 0x%08lx)\n", Status);
+        return Pipeline;
+    }
+
+    Status = NtCreateSemaphore(&Pipeline->JobSemaphore,
+                               SEMAPHORE_ALL_ACCESS,
+                               NULL, 0, MAXLONG);
+    if (!NT_SUCCESS(Status))
+    {
+        DPRINT1("Could not create the copy semaphore (Status 0x%08lx)\n", Status);
+        return Pipeline;
+    }
+
+    Status = NtCreateEvent(&Pipeline->JobCompletedEvent,
+                           EVENT_ALL_ACCESS,
+                           NULL,
+                           SynchronizationEvent,
+                           FALSE);
+    if (!NT_SUCCESS(Status))
+    {
+        DPRINT1("Could not create the copy event (Status 0x%08lx)\n", Status);
+        return Pipeline;
+    }
+
+    for (i = 0; i < WorkerCount; i++)
+    {
+        Pipeline->Workers[i].Pipeline = Pipeline;
+
+        Status = RtlCreateUserThread(NtCurrentProcess(),
+                                     NULL,
+                                     FALSE,
+                                     0,
+                                     0,
+                                     0,
+                                     SetupCopyWorkerThread,
+                                     &Pipeline->Workers[i],
+                                     &Pipeline->Workers[i].Thread,
+                                     NULL);
+        if (!NT_SUCCESS(Status))
+        {
+            DPRINT1("Failed to create the copy worker thread (Status 0x%08lx)\n", Status);
+            break;
+        }
+
+        Pipeline->WorkerCount++;
+    }
+
+    return Pipeline;
+}
+
+/* Drops the queued copies that no worker has taken yet */
+static VOID
+SetupCancelCopyJobs(
+    IN OUT PCOPY_PIPELINE Pipeline)
+{
+    if (Pipeline->WorkerCount == 0)
+    {
+        Pipeline->Queued = Pipeline->Started = Pipeline->Retired;
+        return;
+    }
+
+    /* The workers stop when they find nothing left to take */
+    NtWaitForSingleObject(Pipeline->Mutex, FALSE, NULL);
+    Pipeline->Queued = Pipeline->Started;
+    NtReleaseMutant(Pipeline->Mutex, NULL);
+}
+
+static VOID
+SetupDestroyCopyPipeline(
+    IN PCOPY_PIPELINE Pipeline)
+{
+    ULONG i;
+
+    /* Let the workers finish the queued jobs, then stop them */
+    if (Pipeline->WorkerCount != 0)
+        NtReleaseSemaphore(Pipeline->JobSemaphore, Pipeline->WorkerCount, NULL);
+
+    for (i = 0; i < Pipeline->WorkerCount; i++)
+    {
+        NtWaitForSingleObject(Pipeline->Workers[i].Thread, FALSE, NULL);
+        NtClose(Pipeline->Workers[i].Thread);
+
+        if (Pipeline->Workers[i].Cabinet.HasCurrentCabinet)
+            CabinetCleanup(&Pipeline->Workers[i].Cabinet.CabinetContext);
+    }
+
+    if (Pipeline->JobCompletedEvent)
+        NtClose(Pipeline->JobCompletedEvent);
+
+    if (Pipeline->JobSemaphore)
+        NtClose(Pipeline->JobSemaphore);
+
+    if (Pipeline->Mutex)
+        NtClose(Pipeline->Mutex);
+
+    RtlFreeHeap(ProcessHeap, 0, Pipeline);
+}
+
+static VOID
+SetupQueueCopyJob(
+    IN OUT PFILEQUEUEHEADER QueueHeader,
+    IN OUT PCOPY_PIPELINE Pipeline,
+    IN OUT PCOPY_JOB Job)
+{
+    Job->Completed = FALSE;
+
+    if (Pipeline->WorkerCount == 0)
+    {
+        /* No worker could be started, the copy is done when it is reported */
+        Pipeline->Queued++;
+        Pipeline->Started++;
+        return;
+    }
+
+    NtWaitForSingleObject(Pipeline->Mutex, FALSE, NULL);
+    Pipeline->Queued++;
+    NtReleaseMutant(Pipeline->Mutex, NULL);
+
+    /* Wake up a worker */
+    NtReleaseSemaphore(Pipeline->JobSemaphore, 1, NULL);
+}
+
+static NTSTATUS
+SetupWaitCopyJob(
+    IN PCOPY_PIPELINE Pipeline,
+    IN PCOPY_JOB Job)
+{
+    BOOLEAN Completed;
+
+    for (;;)
+    {
+        NtWaitForSingleObject(Pipeline->Mutex, FALSE, NULL);
+        Completed = Job->Completed;
+        NtReleaseMutant(Pipeline->Mutex, NULL);
+
+        if (Completed)
+            return Job->Status;
+
+        NtWaitForSingleObject(Pipeline->JobCompletedEvent, FALSE, NULL);
+    }
+}
+
+/* Notifies the start of the oldest copy in flight, waits for it and reports its result */
+static BOOL
+SetupRetireCopyJob(
+    IN OUT PFILEQUEUEHEADER QueueHeader,
+    IN OUT PCOPY_PIPELINE Pipeline,
+    IN PSP_FILE_CALLBACK_W MsgHandler,
+    IN PVOID Context OPTIONAL)
+{
+    BOOL Success = TRUE; // Suppose success
+    UINT Result;
+    NTSTATUS Status = STATUS_SUCCESS;
+    PCOPY_JOB Job;
+    FILEPATHS_W FilePathInfo;
+
+    ASSERT(Pipeline->Retired != Pipeline->Queued);
+    Job = &Pipeline->Jobs[Pipeline->Retired % COPY_WINDOW_SIZE];
+
+    FilePathInfo.Target = Job->FileDstPath;
+    FilePathInfo.Source = Job->FileSrcPath;
+    FilePathInfo.Win32Error = STATUS_SUCCESS;
+    FilePathInfo.Flags = 0; // FIXME: Unused yet...
+
+    Result = MsgHandler(Context,
+                        SPFILENOTIFY_STARTCOPY,
+                        (UINT_PTR)&FilePathInfo,
+                        FILEOP_COPY);
+    if (Result == FILEOP_ABORT)
+    {
+        Success = FALSE;
+    }
+    else if (Pipeline->WorkerCount == 0)
+    {
+        if (Result == FILEOP_DOIT)
+            Status = SetupCopyQueueEntry(&QueueHeader->Cabinet, Job);
+    }
+    else
+    {
+        /* The slot is reused once the copy is done, even if it is skipped */
+        Status = SetupWaitCopyJob(Pipeline, Job);
+        if (Result != FILEOP_DOIT)
+            Status = STATUS_SUCCESS;
+    }
+
+    while (Success && !NT_SUCCESS(Status))
+    {
+        /* An error happened */
+        FilePathInfo.Win32Error = (UINT)Status;
+        Result = MsgHandler(Context,
+                            SPFILENOTIFY_COPYERROR,
+                            (UINT_PTR)&FilePathInfo,
+                            (UINT_PTR)NULL); // FIXME: Unused yet...
+        if (Result == FILEOP_ABORT)
+        {
+            Success = FALSE;
+            break;
+        }
+        else if (Result == FILEOP_SKIP)
+            break;
+        else if (Result == FILEOP_RETRY || Result == FILEOP_NEWPATH) // TODO: FILEOP_NEWPATH
+        {
+            /* Retry the copy here, the workers are busy with the next files */
+            Status = SetupCopyQueueEntry(&QueueHeader->Cabinet, Job);
+            continue;
+        }
+
+        Success = FALSE;
+        break;
+    }
+
+    /* This notification is always sent, even in case of error */
+    FilePathInfo.Win32Error = (UINT)Status;
+    MsgHandler(Context,
+               SPFILENOTIFY_ENDCOPY,
+               (UINT_PTR)&FilePathInfo,
+               0);
+
+    Pipeline->Retired++;
+    return Success;
+}
+
 HSPFILEQ
 WINAPI
 SetupOpenFileQueue(VOID)
@@ -179,7 +545,7 @@ SetupOpenFileQueue(VOID)
     InitializeListHead(&QueueHeader->CopyQueue);
     QueueHeader->CopyCount = 0;
 
-    QueueHeader->HasCurrentCabinet = FALSE;
+    QueueHeader->Cabinet.HasCurrentCabinet = FALSE;
 
     return (HSPFILEQ)QueueHeader;
 }
@@ -252,6 +618,10 @@ SetupCloseFileQueue(
         SetupDeleteQueueEntry(Entry);
     }
 
+    /* Close the cabinet used for the retries */
+    if (QueueHeader->Cabinet.HasCurrentCabinet)
+        CabinetCleanup(&QueueHeader->Cabinet.CabinetContext);
+
     /* Delete queue header */
     RtlFreeHeap(ProcessHeap, 0, QueueHeader);
 
@@ -628,6 +998,8 @@ SetupCommitFileQueueW(
     PFILEQUEUEHEADER QueueHeader;
     PLIST_ENTRY ListEntry;
     PQUEUEENTRY Entry;
+    PCOPY_PIPELINE Pipeline;
+    PCOPY_JOB Job;
     FILEPATHS_W FilePathInfo;
     WCHAR FileSrcPath[MAX_PATH];
     WCHAR FileDstPath[MAX_PATH];
@@ -851,12 +1223,32 @@ EndRename:
         }
     }
 
+    Pipeline = SetupCreateCopyPipeline();
+    if (Pipeline == NULL)
+    {
+        Success = FALSE;
+        goto Quit;
+    }
+
     for (ListEntry = QueueHeader->CopyQueue.Flink;
          ListEntry != &QueueHeader->CopyQueue;
          ListEntry = ListEntry->Flink)
     {
         Entry = CONTAINING_RECORD(ListEntry, QUEUEENTRY, ListEntry);
 
+        /* Report the oldest copy if there is no room for a new one */
+        if (Pipeline->Queued - Pipeline->Retired == COPY_WINDOW_SIZE)
+        {
+            if (!SetupRetireCopyJob(QueueHeader, Pipeline, MsgHandler, Context))
+            {
+                Success = FALSE;
+                goto StopCopy;
+            }
+        }
+
+        Job = &Pipeline->Jobs[Pipeline->Queued % COPY_WINDOW_SIZE];
+        Job->Entry = Entry;
+
         //
         // TODO: Send a SPFILENOTIFY_NEEDMEDIA notification
         // when we switch to a new installation media.
@@ -867,7 +1259,7 @@ EndRename:
         /* Build the full source path */
         if (Entry->SourceCabinet == NULL)
         {
-            CombinePaths(FileSrcPath, ARRAYSIZE(FileSrcPath), 3,
+            CombinePaths(Job->FileSrcPath, ARRAYSIZE(Job->FileSrcPath), 3,
                          Entry->SourceRootPath, Entry->SourcePath,
                          Entry->SourceFileName);
         }
@@ -877,104 +1269,55 @@ EndRename:
              * The cabinet must be in Entry->SourceRootPath only!
              * (Should we ignore Entry->SourcePath?)
              */
-            CombinePaths(FileSrcPath, ARRAYSIZE(FileSrcPath), 3,
+            CombinePaths(Job->FileSrcPath, ARRAYSIZE(Job->FileSrcPath), 3,
                          Entry->SourceRootPath, Entry->SourcePath,
                          Entry->SourceCabinet);
         }
 
         /* Build the full target path */
-        RtlStringCchCopyW(FileDstPath, ARRAYSIZE(FileDstPath), Entry->TargetDirectory);
+        RtlStringCchCopyW(Job->FileDstPath, ARRAYSIZE(Job->FileDstPath), Entry->TargetDirectory);
         if (Entry->SourceCabinet == NULL)
         {
             /* If the file is not in a cabinet, possibly use a different target name */
             if (Entry->TargetFileName != NULL)
-                ConcatPaths(FileDstPath, ARRAYSIZE(FileDstPath), 1, Entry->TargetFileName);
+                ConcatPaths(Job->FileDstPath, ARRAYSIZE(Job->FileDstPath), 1, Entry->TargetFileName);
             else
-                ConcatPaths(FileDstPath, ARRAYSIZE(FileDstPath), 1, Entry->SourceFileName);
+                ConcatPaths(Job->FileDstPath, ARRAYSIZE(Job->FileDstPath), 1, Entry->SourceFileName);
         }
         else
         {
-            ConcatPaths(FileDstPath, ARRAYSIZE(FileDstPath), 1, Entry->SourceFileName);
+            ConcatPaths(Job->FileDstPath, ARRAYSIZE(Job->FileDstPath), 1, Entry->SourceFileName);
         }
 
-        DPRINT(" -----> " "Copy: '%S' ==> '%S'\n", FileSrcPath, FileDstPath);
+        DPRINT(" -----> " "Copy: '%S' ==> '%S'\n", Job->FileSrcPath, Job->FileDstPath);
 
         //
         // Technically, here we should create the target directory,
         // if it does not already exist... before calling the handler!
         //
 
-        FilePathInfo.Target = FileDstPath;
-        FilePathInfo.Source = FileSrcPath;
-        FilePathInfo.Win32Error = STATUS_SUCCESS;
-        FilePathInfo.Flags = 0; // FIXME: Unused yet...
-
-        Result = MsgHandler(Context,
-                            SPFILENOTIFY_STARTCOPY,
-                            (UINT_PTR)&FilePathInfo,
-                            FILEOP_COPY);
-        if (Result == FILEOP_ABORT)
-        {
-            Success = FALSE;
-            goto EndCopy;
-        }
-        else if (Result == FILEOP_SKIP)
-            goto EndCopy;
-        // else (Result == FILEOP_DOIT)
-
-RetryCopy:
-        if (Entry->SourceCabinet != NULL)
-        {
-            /*
-             * The file is in a cabinet, use only the destination path
-             * and keep the source name as the target name.
-             */
-            /* Extract the file from the cabinet */
-            Status = SetupExtractFile(QueueHeader,
-                                      FileSrcPath, // Specifies the cabinet path
-                                      Entry->SourceFileName,
-                                      Entry->TargetDirectory);
-        }
-        else
-        {
-            /* Copy the file */
-            Status = SetupCopyFile(FileSrcPath, FileDstPath, FALSE);
-        }
+        /* Hand the copy to the workers, it is notified and reported in order later */
+        SetupQueueCopyJob(QueueHeader, Pipeline, Job);
+    }
 
-        if (!NT_SUCCESS(Status))
+    /* Report the remaining copies */
+    while (Pipeline->Retired != Pipeline->Queued)
+    {
+        if (!SetupRetireCopyJob(QueueHeader, Pipeline, MsgHandler, Context))
         {
-            /* An error happened */
-            FilePathInfo.Win32Error = (UINT)Status;
-            Result = MsgHandler(Context,
-                                SPFILENOTIFY_COPYERROR,
-                                (UINT_PTR)&FilePathInfo,
-                                (UINT_PTR)NULL); // FIXME: Unused yet...
-            if (Result == FILEOP_ABORT)
-            {
-                Success = FALSE;
-                goto EndCopy;
-            }
-            else if (Result == FILEOP_SKIP)
-                goto EndCopy;
-            else if (Result == FILEOP_RETRY)
-                goto RetryCopy;
-            else if (Result == FILEOP_NEWPATH)
-                goto RetryCopy; // TODO!
-
             Success = FALSE;
+            break;
         }
-
-EndCopy:
-        /* This notification is always sent, even in case of error */
-        FilePathInfo.Win32Error = (UINT)Status;
-        MsgHandler(Context,
-                   SPFILENOTIFY_ENDCOPY,
-                   (UINT_PTR)&FilePathInfo,
-                   0);
-        if (Success == FALSE /* && Result == FILEOP_ABORT */)
-            goto Quit;
     }
 
+StopCopy:
+    /* Don't wait for copies whose result won't be reported */
+    if (Success == FALSE)
+        SetupCancelCopyJobs(Pipeline);
+    SetupDestroyCopyPipeline(Pipeline);
+    if (Success == FALSE)
+        goto Quit;
+
     if (!IsListEmpty(&QueueHeader->CopyQueue))
     {
         MsgHandler(Context,
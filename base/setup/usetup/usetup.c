@@ -3098,6 +3098,40 @@ typedef struct _COPYCONTEXT
     PPROGRESSBAR MemoryBars[4];
 } COPYCONTEXT, *PCOPYCONTEXT;
 
+/* Tick count at the start of the current sub-queue, for the throughput */
+static ULONG SubQueueStartTime;
+
+static
+BOOLEAN NTAPI
+ProgressCopyStringHandler(
+    IN PPROGRESSBAR Bar,
+    IN BOOLEAN AlwaysUpdate,
+    OUT PSTR Buffer,
+    IN SIZE_T cchBufferSize)
+{
+    ULONG OldProgress = Bar->Progress;
+    ULONG Elapsed;
+
+    /* Calculate the new percentage */
+    if (Bar->StepCount == 0)
+        Bar->Progress = 0;
+    else
+        Bar->Progress = ((100 * Bar->CurrentStep + (Bar->StepCount / 2)) / Bar->StepCount);
+
+    /* Build the progress string if it has changed */
+    if (Bar->ProgressFormatText &&
+        (AlwaysUpdate || (Bar->Progress != OldProgress)))
+    {
+        /* Also show the number of files processed per second */
+        Elapsed = max(1, NtGetTickCount() - SubQueueStartTime);
+        RtlStringCchPrintfA(Buffer, cchBufferSize,
+                            Bar->ProgressFormatText, Bar->Progress,
+                            (ULONG)(((ULONGLONG)Bar->CurrentStep * 1000) / Elapsed));
+        return TRUE;
+    }
+    return FALSE;
+}
+
 static VOID
 SetupUpdateMemoryInfo(IN PCOPYCONTEXT CopyContext,
                       IN BOOLEAN First)
@@ -3142,6 +3176,7 @@ FileCopyCallback(PVOID Context,
         {
             CopyContext->TotalOperations = (ULONG)Param2;
             CopyContext->CompletedOperations = 0;
+            SubQueueStartTime = NtGetTickCount();
             ProgressSetStepCount(CopyContext->ProgressBar,
                                  CopyContext->TotalOperations);
             SetupUpdateMemoryInfo(CopyContext, TRUE);
@@ -3264,15 +3299,19 @@ FileCopyPage(PINPUT_RECORD Ir)
     CopyContext.TotalOperations = 0;
     CopyContext.CompletedOperations = 0;
 
-    /* Create the progress bar as well */
-    CopyContext.ProgressBar = CreateProgressBar(13,
-                                                26,
-                                                xScreen - 13,
-                                                yScreen - 20,
-                                                10,
-                                                24,
-                                                TRUE,
-                                                MUIGetString(STRING_SETUPCOPYINGFILES));
+    /* Create the progress bar as well, showing the throughput */
+    CopyContext.ProgressBar = CreateProgressBarEx(13,
+                                                  26,
+                                                  xScreen - 13,
+                                                  yScreen - 20,
+                                                  10,
+                                                  24,
+                                                  TRUE,
+                                                  FOREGROUND_YELLOW | BACKGROUND_BLUE,
+                                                  0,
+                                                  MUIGetString(STRING_SETUPCOPYINGFILES),
+                                                  "%-3lu%%  %5lu files/s",
+                                                  ProgressCopyStringHandler);
 
     // fit memory bars to screen width, distribute them uniform
     MemBarWidth = (xScreen - 26) / 5;
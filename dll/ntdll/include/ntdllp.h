@@ -96,6 +96,24 @@ NTSTATUS NTAPI
 LdrpWalkImportDescriptor(IN LPWSTR DllPath OPTIONAL,
                          IN PLDR_DATA_TABLE_ENTRY LdrEntry);
 
+/* ldrworker.c */
+extern ULONG LdrpImportWalkDepth;
+
+BOOLEAN NTAPI
+LdrpIsLoaderWorkerThread(IN HANDLE UniqueThread);
+
+VOID NTAPI
+LdrpQueueImportSections(IN LPWSTR DllPath OPTIONAL,
+                        IN PVOID DllBase,
+                        IN PIMAGE_IMPORT_DESCRIPTOR ImportEntry);
+
+HANDLE NTAPI
+LdrpTakeImportSection(IN PWSTR DllName,
+                      IN PUNICODE_STRING FullDllName);
+
+VOID NTAPI
+LdrpRetireImportSections(VOID);
+
 /* libsupp.c */
 NTSYSAPI
 NTSTATUS
@@ -124,6 +142,19 @@ LdrpAllocateDataTableEntry(IN PVOID BaseAddress);
 VOID NTAPI
 LdrpInsertMemoryTableEntry(IN PLDR_DATA_TABLE_ENTRY LdrEntry);
 
+NTSTATUS NTAPI
+LdrpCodeAuthzCheckDllAllowed(IN PUNICODE_STRING FullName,
+                             IN HANDLE DllHandle);
+
+VOID NTAPI
+LdrpInitializeModuleAddressIndex(VOID);
+
+VOID NTAPI
+LdrpRemoveModuleAddressIndex(IN PLDR_DATA_TABLE_ENTRY LdrEntry);
+
+PLDR_DATA_TABLE_ENTRY NTAPI
+LdrpFindModuleByAddress(IN PVOID Address);
+
 NTSTATUS NTAPI
 LdrpLoadDll(IN BOOLEAN Redirected,
             IN PWSTR DllPath OPTIONAL,
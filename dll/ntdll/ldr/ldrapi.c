@@ -426,7 +426,6 @@ LdrFindEntryForAddress(
     _In_ PVOID Address,
     _Out_ PLDR_DATA_TABLE_ENTRY *Module)
 {
-    PLIST_ENTRY ListHead, NextEntry;
     PLDR_DATA_TABLE_ENTRY LdrEntry;
     PIMAGE_NT_HEADERS NtHeader;
     PPEB_LDR_DATA Ldr = NtCurrentPeb()->Ldr;
@@ -460,32 +459,17 @@ LdrFindEntryForAddress(
         }
     }
 
-    /* Loop the module list */
-    ListHead = &Ldr->InMemoryOrderModuleList;
-    NextEntry = ListHead->Flink;
-    while (NextEntry != ListHead)
-    {
-        /* Get the entry and NT Headers */
-        LdrEntry = CONTAINING_RECORD(NextEntry, LDR_DATA_TABLE_ENTRY, InMemoryOrderLinks);
-        NtHeader = RtlImageNtHeader(LdrEntry->DllBase);
-        if (NtHeader)
-        {
-            /* Get the Image Base */
-            DllBase = (ULONG_PTR)LdrEntry->DllBase;
-            DllEnd = DllBase + NtHeader->OptionalHeader.SizeOfImage;
+    /* Look it up in the address index, and make sure it's not unloading */
+    RtlEnterCriticalSection(&LdrpLoaderLock);
+    LdrEntry = LdrpFindModuleByAddress(Address);
+    if ((LdrEntry) && !(LdrEntry->InMemoryOrderLinks.Flink)) LdrEntry = NULL;
+    RtlLeaveCriticalSection(&LdrpLoaderLock);
 
-            /* Check if they match */
-            if (((ULONG_PTR)Address >= DllBase) &&
-                ((ULONG_PTR)Address < DllEnd))
-            {
-                /* Return it */
-                *Module = LdrEntry;
-                return STATUS_SUCCESS;
-            }
-
-            /* Next Entry */
-            NextEntry = NextEntry->Flink;
-        }
+    if (LdrEntry)
+    {
+        /* Return it */
+        *Module = LdrEntry;
+        return STATUS_SUCCESS;
     }
 
     /* Nothing found */
@@ -1471,6 +1455,7 @@ LdrUnloadDll(
         }
 
         /* Remove it from the list */
+        LdrpRemoveModuleAddressIndex(CurrentEntry);
         RemoveEntryList(&CurrentEntry->InLoadOrderLinks);
         CurrentEntry = NULL;
         NextEntry = LdrpUnloadHead.Flink;
@@ -662,6 +662,9 @@ LdrpRunInitializeRoutines(IN PCONTEXT Context OPTIONAL)
     /* Check the Loader Lock */
     LdrpEnsureLoaderLockIsHeld();
 
+    /* The import sections are normally settled already, unless an import walk raised */
+    LdrpRetireImportSections();
+
      /* Get the number of entries to call */
     if ((Count = LdrpClearLoadInProgress()))
     {
@@ -1792,6 +1795,7 @@ LdrpInitializeProcess(IN PCONTEXT Context,
     PWCHAR Current;
     ULONG ExecuteOptions = 0;
     PVOID ViewBase;
+    LARGE_INTEGER StartTime, EndTime, Frequency;
 
     /* Set a NULL SEH Filter */
     RtlSetUnhandledExceptionFilter(NULL);
@@ -1978,6 +1982,9 @@ LdrpInitializeProcess(IN PCONTEXT Context,
         InitializeListHead(&LdrpHashTable[i]);
     }
 
+    /* And the address index */
+    LdrpInitializeModuleAddressIndex();
+
     /* Initialize the Loader Lock */
     // FIXME: What's the point of initing it manually, if two lines lower
     //        a call to RtlInitializeCriticalSection() is being made anyway?
@@ -2351,7 +2358,15 @@ LdrpInitializeProcess(IN PCONTEXT Context,
     }
 
     /* Walk the IAT and load all the DLLs */
+    if (ShowSnaps) NtQueryPerformanceCounter(&StartTime, NULL);
     ImportStatus = LdrpWalkImportDescriptor(LdrpDefaultPath.Buffer, LdrpImageEntry);
+    if (ShowSnaps)
+    {
+        NtQueryPerformanceCounter(&EndTime, &Frequency);
+        DPRINT1("LDR: Static imports of %wZ loaded in %I64u us\n",
+                &LdrpImageEntry->BaseDllName,
+                (EndTime.QuadPart - StartTime.QuadPart) * 1000000 / max(Frequency.QuadPart, 1));
+    }
 
     /* Check if relocation is needed */
     if (Peb->ImageBaseAddress != (PVOID)NtHeader->OptionalHeader.ImageBase)
@@ -2600,6 +2615,9 @@ LdrpInit(PCONTEXT Context,
         Teb->DeallocationStack = MemoryBasicInfo.AllocationBase;
     }
 
+    /* Loader workers run while the process is initialized, and need nothing else */
+    if (LdrpIsLoaderWorkerThread(Teb->ClientId.UniqueThread)) return;
+
     /* Now check if the process is already being initialized */
     while (_InterlockedCompareExchange(&LdrpProcessInitialized,
                                       1,
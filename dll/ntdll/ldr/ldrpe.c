@@ -750,6 +750,10 @@ LdrpWalkImportDescriptor(IN LPWSTR DllPath OPTIONAL,
     /* Check if we got at least one */
     if ((BoundEntry) || (ImportEntry))
     {
+        /* Let the loader workers create the sections of the imports meanwhile */
+        LdrpImportWalkDepth++;
+        if (ImportEntry) LdrpQueueImportSections(DllPath, LdrEntry->DllBase, ImportEntry);
+
         /* Do we have a Bound IAT */
         if (BoundEntry)
         {
@@ -766,6 +770,9 @@ LdrpWalkImportDescriptor(IN LPWSTR DllPath OPTIONAL,
                                                           ImportEntry);
         }
 
+        /* The outermost walk is done, before any initializer runs */
+        if (!--LdrpImportWalkDepth) LdrpRetireImportSections();
+
         /* Check the status of the handlers */
         if (NT_SUCCESS(Status))
         {
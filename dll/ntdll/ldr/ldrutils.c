@@ -18,6 +18,17 @@
 
 PLDR_DATA_TABLE_ENTRY LdrpLoadedDllHandleCache, LdrpGetModuleHandleCache;
 
+/* Index of the modules in the load order list by their address range */
+typedef struct _LDRP_ADDRESS_INDEX_ENTRY
+{
+    ULONG_PTR Start;
+    ULONG_PTR End;
+    PLDR_DATA_TABLE_ENTRY LdrEntry;
+} LDRP_ADDRESS_INDEX_ENTRY, *PLDRP_ADDRESS_INDEX_ENTRY;
+
+RTL_AVL_TABLE LdrpModuleAddressIndex;
+BOOLEAN LdrpModuleAddressIndexIncomplete;
+
 BOOLEAN g_ShimsEnabled;
 PVOID g_pShimEngineModule;
 PVOID g_pfnSE_DllLoaded;
@@ -1091,32 +1102,41 @@ SkipCheck:
                         &FullDllName);
             }
 
-            /* Convert to NT Name */
-            if (!RtlDosPathNameToNtPathName_U(FullDllName.Buffer,
-                                              &NtPathDllName,
-                                              NULL,
-                                              NULL))
+            /* Check if a loader worker already created the section of this import */
+            if (Static && !DllCharacteristics)
             {
-                /* Path was invalid */
-                return STATUS_OBJECT_PATH_SYNTAX_BAD;
+                SectionHandle = LdrpTakeImportSection(DllName, &FullDllName);
             }
 
-            /* Create a section for this dLL */
-            Status = LdrpCreateDllSection(&NtPathDllName,
-                                          DllHandle,
-                                          DllCharacteristics,
-                                          &SectionHandle);
+            if (!SectionHandle)
+            {
+                /* Convert to NT Name */
+                if (!RtlDosPathNameToNtPathName_U(FullDllName.Buffer,
+                                                  &NtPathDllName,
+                                                  NULL,
+                                                  NULL))
+                {
+                    /* Path was invalid */
+                    return STATUS_OBJECT_PATH_SYNTAX_BAD;
+                }
 
-            /* Free the NT Name */
-            RtlFreeHeap(RtlGetProcessHeap(), 0, NtPathDllName.Buffer);
+                /* Create a section for this dLL */
+                Status = LdrpCreateDllSection(&NtPathDllName,
+                                              DllHandle,
+                                              DllCharacteristics,
+                                              &SectionHandle);
 
-            /* If we failed */
-            if (!NT_SUCCESS(Status))
-            {
-                /* Free the name strings and return */
-                LdrpFreeUnicodeString(&FullDllName);
-                LdrpFreeUnicodeString(&BaseDllName);
-                return Status;
+                /* Free the NT Name */
+                RtlFreeHeap(RtlGetProcessHeap(), 0, NtPathDllName.Buffer);
+
+                /* If we failed */
+                if (!NT_SUCCESS(Status))
+                {
+                    /* Free the name strings and return */
+                    LdrpFreeUnicodeString(&FullDllName);
+                    LdrpFreeUnicodeString(&BaseDllName);
+                    return Status;
+                }
             }
         }
         else
@@ -1258,6 +1278,7 @@ SkipCheck:
         if (NT_SUCCESS(HardErrorStatus) && Response == ResponseCancel)
         {
             /* Remove the DLL from the lists */
+            LdrpRemoveModuleAddressIndex(LdrEntry);
             RemoveEntryList(&LdrEntry->InLoadOrderLinks);
             RemoveEntryList(&LdrEntry->InMemoryOrderLinks);
             RemoveEntryList(&LdrEntry->HashLinks);
@@ -1452,6 +1473,7 @@ FailRelocate:
             if (!NT_SUCCESS(Status))
             {
                 /* Remove it from the lists */
+                LdrpRemoveModuleAddressIndex(LdrEntry);
                 RemoveEntryList(&LdrEntry->InLoadOrderLinks);
                 RemoveEntryList(&LdrEntry->InMemoryOrderLinks);
                 RemoveEntryList(&LdrEntry->HashLinks);
@@ -1551,6 +1573,129 @@ LdrpAllocateDataTableEntry(IN PVOID BaseAddress)
     return LdrEntry;
 }
 
+static
+RTL_GENERIC_COMPARE_RESULTS
+NTAPI
+LdrpCompareAddressIndexEntries(IN PRTL_AVL_TABLE Table,
+                               IN PVOID FirstStruct,
+                               IN PVOID SecondStruct)
+{
+    PLDRP_ADDRESS_INDEX_ENTRY First = FirstStruct, Second = SecondStruct;
+
+    /* Images don't overlap, so overlapping ranges are the same module */
+    if (First->End <= Second->Start) return GenericLessThan;
+    if (First->Start >= Second->End) return GenericGreaterThan;
+    return GenericEqual;
+}
+
+static
+PVOID
+NTAPI
+LdrpAllocateAddressIndexEntry(IN PRTL_AVL_TABLE Table,
+                              IN CLONG ByteSize)
+{
+    return RtlAllocateHeap(LdrpHeap, 0, ByteSize);
+}
+
+static
+VOID
+NTAPI
+LdrpFreeAddressIndexEntry(IN PRTL_AVL_TABLE Table,
+                          IN PVOID Buffer)
+{
+    RtlFreeHeap(LdrpHeap, 0, Buffer);
+}
+
+VOID
+NTAPI
+LdrpInitializeModuleAddressIndex(VOID)
+{
+    RtlInitializeGenericTableAvl(&LdrpModuleAddressIndex,
+                                 LdrpCompareAddressIndexEntries,
+                                 LdrpAllocateAddressIndexEntry,
+                                 LdrpFreeAddressIndexEntry,
+                                 NULL);
+}
+
+static
+VOID
+LdrpInsertModuleAddressIndex(IN PLDR_DATA_TABLE_ENTRY LdrEntry)
+{
+    LDRP_ADDRESS_INDEX_ENTRY IndexEntry;
+    BOOLEAN NewElement = FALSE;
+
+    IndexEntry.Start = (ULONG_PTR)LdrEntry->DllBase;
+    IndexEntry.End = IndexEntry.Start + LdrEntry->SizeOfImage;
+    IndexEntry.LdrEntry = LdrEntry;
+
+    /* If the entry can't be indexed, lookups go back to walking the list */
+    if (!LdrEntry->SizeOfImage ||
+        !RtlInsertElementGenericTableAvl(&LdrpModuleAddressIndex,
+                                         &IndexEntry,
+                                         sizeof(IndexEntry),
+                                         &NewElement) ||
+        !NewElement)
+    {
+        DPRINT1("LDR: Failed to index %wZ at %p\n", &LdrEntry->BaseDllName, LdrEntry->DllBase);
+        LdrpModuleAddressIndexIncomplete = TRUE;
+    }
+}
+
+VOID
+NTAPI
+LdrpRemoveModuleAddressIndex(IN PLDR_DATA_TABLE_ENTRY LdrEntry)
+{
+    PLDRP_ADDRESS_INDEX_ENTRY IndexEntry;
+    LDRP_ADDRESS_INDEX_ENTRY Key;
+
+    Key.Start = (ULONG_PTR)LdrEntry->DllBase;
+    Key.End = Key.Start + 1;
+
+    /* Only remove it if it's the one that was indexed */
+    IndexEntry = RtlLookupElementGenericTableAvl(&LdrpModuleAddressIndex, &Key);
+    if (IndexEntry && IndexEntry->LdrEntry == LdrEntry)
+    {
+        RtlDeleteElementGenericTableAvl(&LdrpModuleAddressIndex, &Key);
+    }
+}
+
+/*
+ * Returns the module of the load order list that contains the address.
+ * The caller must own the loader lock.
+ */
+PLDR_DATA_TABLE_ENTRY
+NTAPI
+LdrpFindModuleByAddress(IN PVOID Address)
+{
+    PLDRP_ADDRESS_INDEX_ENTRY IndexEntry;
+    LDRP_ADDRESS_INDEX_ENTRY Key;
+    PLDR_DATA_TABLE_ENTRY Current;
+    PLIST_ENTRY ListHead, Next;
+
+    if (!LdrpModuleAddressIndexIncomplete)
+    {
+        Key.Start = (ULONG_PTR)Address;
+        Key.End = Key.Start + 1;
+
+        IndexEntry = RtlLookupElementGenericTableAvl(&LdrpModuleAddressIndex, &Key);
+        return IndexEntry ? IndexEntry->LdrEntry : NULL;
+    }
+
+    /* Walk the list */
+    ListHead = &NtCurrentPeb()->Ldr->InLoadOrderModuleList;
+    for (Next = ListHead->Flink; Next != ListHead; Next = Next->Flink)
+    {
+        Current = CONTAINING_RECORD(Next, LDR_DATA_TABLE_ENTRY, InLoadOrderLinks);
+        if (((ULONG_PTR)Address >= (ULONG_PTR)Current->DllBase) &&
+            ((ULONG_PTR)Address < (ULONG_PTR)Current->DllBase + Current->SizeOfImage))
+        {
+            return Current;
+        }
+    }
+
+    return NULL;
+}
+
 VOID
 NTAPI
 LdrpInsertMemoryTableEntry(IN PLDR_DATA_TABLE_ENTRY LdrEntry)
@@ -1565,6 +1710,9 @@ LdrpInsertMemoryTableEntry(IN PLDR_DATA_TABLE_ENTRY LdrEntry)
     /* Insert into other lists */
     InsertTailList(&PebData->InLoadOrderModuleList, &LdrEntry->InLoadOrderLinks);
     InsertTailList(&PebData->InMemoryOrderModuleList, &LdrEntry->InMemoryOrderLinks);
+
+    /* And into the address index */
+    LdrpInsertModuleAddressIndex(LdrEntry);
 }
 
 VOID
@@ -1596,7 +1744,6 @@ LdrpCheckForLoadedDllHandle(IN PVOID Base,
                             OUT PLDR_DATA_TABLE_ENTRY *LdrEntry)
 {
     PLDR_DATA_TABLE_ENTRY Current;
-    PLIST_ENTRY ListHead, Next;
 
     /* Check the cache first */
     if ((LdrpLoadedDllHandleCache) &&
@@ -1608,28 +1755,19 @@ LdrpCheckForLoadedDllHandle(IN PVOID Base,
     }
 
     /* Time for a lookup */
-    ListHead = &NtCurrentPeb()->Ldr->InLoadOrderModuleList;
-    Next = ListHead->Flink;
-    while (Next != ListHead)
-    {
-        /* Get the current entry */
-        Current = CONTAINING_RECORD(Next,
-                                    LDR_DATA_TABLE_ENTRY,
-                                    InLoadOrderLinks);
-
-        /* Make sure it's not unloading and check for a match */
-        if ((Current->InMemoryOrderLinks.Flink) && (Base == Current->DllBase))
-        {
-            /* Save in cache */
-            LdrpLoadedDllHandleCache = Current;
+    Current = LdrpFindModuleByAddress(Base);
 
-            /* Return it */
-            *LdrEntry = Current;
-            return TRUE;
-        }
+    /* Make sure it's not unloading and check for a match */
+    if ((Current) &&
+        (Current->InMemoryOrderLinks.Flink) &&
+        (Base == Current->DllBase))
+    {
+        /* Save in cache */
+        LdrpLoadedDllHandleCache = Current;
 
-        /* Move to the next one */
-        Next = Next->Flink;
+        /* Return it */
+        *LdrEntry = Current;
+        return TRUE;
     }
 
     /* Nothing found */
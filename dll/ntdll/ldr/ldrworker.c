@@ -0,0 +1,644 @@
+/*
+ * COPYRIGHT:       See COPYING in the top level directory
+ * PROJECT:         ReactOS NT User-Mode Library
+ * FILE:            dll/ntdll/ldr/ldrworker.c
+ * PURPOSE:         Loader worker threads, creating the sections of imports
+ */
+
+/*
+ * The loader maps, relocates and snaps the imports of a module depth-first,
+ * one DLL after the other. Most of the time of a cold start goes into
+ * finding the files and creating their image sections, which doesn't depend
+ * on any loader state. So when the imports of a module get walked, the ones
+ * which aren't loaded yet are queued to a few worker threads that create
+ * their sections meanwhile. LdrpMapDll then picks up the section instead of
+ * creating it. Mapping, snapping and the initializers stay on the loading
+ * thread, in the same order as before.
+ *
+ * The workers are only started for modules with enough imports to be worth
+ * it, and then stay around for the next loads until they were idle for a
+ * while. The sections of a walk are settled when the outermost walk returns,
+ * so no DLL initializer ever runs while a worker is busy for it. The
+ * workers don't go through LdrpInit, which is why the thread pool, whose
+ * threads need the loader lock to start, can't be used for this. For the
+ * same reason they have no activation context, so imports that SxS or an
+ * API set redirects are never queued and stay with the loading thread.
+ */
+
+/* INCLUDES *****************************************************************/
+
+#include <ntdll.h>
+
+#define NDEBUG
+#include <debug.h>
+
+/* GLOBALS *******************************************************************/
+
+#define LDRP_MAX_LOADER_WORKERS 4
+
+/* Fewer imports are done as fast by the loading thread alone */
+#define LDRP_MIN_IMPORTS_FOR_WORKERS 4
+
+/* Idle workers exit after this many seconds */
+#define LDRP_LOADER_WORKER_IDLE_TIMEOUT 30
+
+typedef enum _LDRP_SECTION_REQUEST_STATE
+{
+    SectionRequestQueued,
+    SectionRequestRunning,
+    SectionRequestDone
+} LDRP_SECTION_REQUEST_STATE;
+
+typedef struct _LDRP_SECTION_REQUEST
+{
+    LIST_ENTRY Links;
+    LDRP_SECTION_REQUEST_STATE State;
+    UNICODE_STRING DllName;
+    PWSTR DllPath;
+    UNICODE_STRING FullDllName;
+    HANDLE SectionHandle;
+} LDRP_SECTION_REQUEST, *PLDRP_SECTION_REQUEST;
+
+RTL_CRITICAL_SECTION LdrpLoaderWorkerLock;
+BOOLEAN LdrpLoaderWorkerLockInitialized;
+LIST_ENTRY LdrpSectionRequestList;
+HANDLE LdrpLoaderWorkerSemaphore, LdrpSectionRequestDoneEvent;
+HANDLE LdrpLoaderWorkerIds[LDRP_MAX_LOADER_WORKERS];
+ULONG LdrpLoaderWorkerCount;
+ULONG LdrpImportWalkDepth;
+
+/* Statistics of the current walk, for debugging */
+ULONG LdrpSectionRequestCount, LdrpSectionRequestHits;
+
+/* FUNCTIONS *****************************************************************/
+
+BOOLEAN
+NTAPI
+LdrpIsLoaderWorkerThread(IN HANDLE UniqueThread)
+{
+    BOOLEAN Found = FALSE;
+    ULONG i;
+
+    if (!LdrpLoaderWorkerLockInitialized) return FALSE;
+
+    RtlEnterCriticalSection(&LdrpLoaderWorkerLock);
+    for (i = 0; i < LDRP_MAX_LOADER_WORKERS; i++)
+    {
+        if (LdrpLoaderWorkerIds[i] == UniqueThread) Found = TRUE;
+    }
+    RtlLeaveCriticalSection(&LdrpLoaderWorkerLock);
+
+    return Found;
+}
+
+static
+VOID
+LdrpFreeSectionRequest(IN PLDRP_SECTION_REQUEST Request)
+{
+    if (Request->SectionHandle) NtClose(Request->SectionHandle);
+    if (Request->FullDllName.Buffer) RtlFreeHeap(LdrpHeap, 0, Request->FullDllName.Buffer);
+    RtlFreeHeap(LdrpHeap, 0, Request);
+}
+
+/* Does what LdrpResolveDllName and LdrpCreateDllSection do, without raising hard errors */
+static
+VOID
+LdrpCreateRequestedSection(IN PLDRP_SECTION_REQUEST Request)
+{
+    UNICODE_STRING NtPathDllName;
+    OBJECT_ATTRIBUTES ObjectAttributes;
+    IO_STATUS_BLOCK IoStatusBlock;
+    SECTION_IMAGE_INFORMATION SectionImageInfo;
+    HANDLE FileHandle, SectionHandle;
+    PWSTR FilePart;
+    ULONG Length;
+    NTSTATUS Status;
+
+    /* Leave the known DLLs alone, they already have a section */
+    if (LdrpKnownDllObjectDirectory)
+    {
+        InitializeObjectAttributes(&ObjectAttributes,
+                                   &Request->DllName,
+                                   OBJ_CASE_INSENSITIVE,
+                                   LdrpKnownDllObjectDirectory,
+                                   NULL);
+        Status = NtOpenSection(&SectionHandle,
+                               SECTION_MAP_READ | SECTION_MAP_EXECUTE | SECTION_MAP_WRITE,
+                               &ObjectAttributes);
+        if (NT_SUCCESS(Status))
+        {
+            NtClose(SectionHandle);
+            return;
+        }
+    }
+
+    /* Find the file */
+    Request->FullDllName.Buffer = RtlAllocateHeap(LdrpHeap, 0, MAX_PATH * sizeof(WCHAR));
+    if (!Request->FullDllName.Buffer) return;
+
+    Length = RtlDosSearchPath_U(Request->DllPath ? Request->DllPath : LdrpDefaultPath.Buffer,
+                                Request->DllName.Buffer,
+                                NULL,
+                                MAX_PATH * sizeof(WCHAR),
+                                Request->FullDllName.Buffer,
+                                &FilePart);
+    if (!Length || Length >= MAX_PATH * sizeof(WCHAR)) return;
+    Request->FullDllName.Length = (USHORT)Length;
+    Request->FullDllName.MaximumLength = MAX_PATH * sizeof(WCHAR);
+
+    if (!RtlDosPathNameToNtPathName_U(Request->FullDllName.Buffer,
+                                      &NtPathDllName,
+                                      NULL,
+                                      NULL))
+    {
+        return;
+    }
+
+    /* Open it the same way LdrpCreateDllSection does */
+    InitializeObjectAttributes(&ObjectAttributes,
+                               &NtPathDllName,
+                               OBJ_CASE_INSENSITIVE,
+                               NULL,
+                               NULL);
+    Status = NtOpenFile(&FileHandle,
+                        SYNCHRONIZE | FILE_EXECUTE | FILE_READ_DATA,
+                        &ObjectAttributes,
+                        &IoStatusBlock,
+                        FILE_SHARE_READ | FILE_SHARE_DELETE,
+                        FILE_NON_DIRECTORY_FILE | FILE_SYNCHRONOUS_IO_NONALERT);
+    if (!NT_SUCCESS(Status))
+    {
+        Status = NtOpenFile(&FileHandle,
+                            SYNCHRONIZE | FILE_EXECUTE,
+                            &ObjectAttributes,
+                            &IoStatusBlock,
+                            FILE_SHARE_READ | FILE_SHARE_DELETE,
+                            FILE_NON_DIRECTORY_FILE | FILE_SYNCHRONOUS_IO_NONALERT);
+    }
+    RtlFreeHeap(RtlGetProcessHeap(), 0, NtPathDllName.Buffer);
+    if (!NT_SUCCESS(Status)) return;
+
+    Status = NtCreateSection(&SectionHandle,
+                             SECTION_MAP_READ | SECTION_MAP_EXECUTE |
+                             SECTION_MAP_WRITE | SECTION_QUERY,
+                             NULL,
+                             NULL,
+                             PAGE_EXECUTE,
+                             SEC_IMAGE,
+                             FileHandle);
+    NtClose(FileHandle);
+    if (!NT_SUCCESS(Status)) return;
+
+    /* And make the same checks */
+    Status = ZwQuerySection(SectionHandle,
+                            SectionImageInformation,
+                            &SectionImageInfo,
+                            sizeof(SECTION_IMAGE_INFORMATION),
+                            NULL);
+    if (NT_SUCCESS(Status) &&
+        !(SectionImageInfo.LoaderFlags & IMAGE_LOADER_FLAGS_COMPLUS))
+    {
+        Status = LdrpCodeAuthzCheckDllAllowed(&Request->FullDllName, NULL);
+        if (Status == STATUS_NOT_FOUND) Status = STATUS_SUCCESS;
+    }
+
+    if (!NT_SUCCESS(Status))
+    {
+        NtClose(SectionHandle);
+        return;
+    }
+
+    Request->SectionHandle = SectionHandle;
+}
+
+static
+ULONG
+NTAPI
+LdrpLoaderWorker(IN PVOID Parameter)
+{
+    PLDRP_SECTION_REQUEST Request;
+    PLIST_ENTRY Entry;
+    LARGE_INTEGER Timeout;
+    NTSTATUS Status;
+    ULONG i;
+
+    Timeout.QuadPart = Int32x32To64(LDRP_LOADER_WORKER_IDLE_TIMEOUT, -10000000);
+
+    for (;;)
+    {
+        Status = NtWaitForSingleObject(LdrpLoaderWorkerSemaphore, FALSE, &Timeout);
+
+        /* Take the oldest queued request */
+        Request = NULL;
+        RtlEnterCriticalSection(&LdrpLoaderWorkerLock);
+        for (Entry = LdrpSectionRequestList.Flink;
+             Entry != &LdrpSectionRequestList;
+             Entry = Entry->Flink)
+        {
+            Request = CONTAINING_RECORD(Entry, LDRP_SECTION_REQUEST, Links);
+            if (Request->State == SectionRequestQueued)
+            {
+                Request->State = SectionRequestRunning;
+                break;
+            }
+            Request = NULL;
+        }
+
+        if (!Request && Status == STATUS_TIMEOUT)
+        {
+            /* Nothing came for a while, give our slot up and leave */
+            for (i = 0; i < LDRP_MAX_LOADER_WORKERS; i++)
+            {
+                if (LdrpLoaderWorkerIds[i] == NtCurrentTeb()->ClientId.UniqueThread)
+                    LdrpLoaderWorkerIds[i] = NULL;
+            }
+            LdrpLoaderWorkerCount--;
+            RtlLeaveCriticalSection(&LdrpLoaderWorkerLock);
+            break;
+        }
+        RtlLeaveCriticalSection(&LdrpLoaderWorkerLock);
+
+        if (!Request) continue;
+
+        LdrpCreateRequestedSection(Request);
+
+        RtlEnterCriticalSection(&LdrpLoaderWorkerLock);
+        Request->State = SectionRequestDone;
+        RtlLeaveCriticalSection(&LdrpLoaderWorkerLock);
+        NtSetEvent(LdrpSectionRequestDoneEvent, NULL);
+    }
+
+    /* We never went through the thread initialization, so don't do the shutdown */
+    NtCurrentTeb()->FreeStackOnTermination = TRUE;
+    NtTerminateThread(NtCurrentThread(), STATUS_SUCCESS);
+    return 0;
+}
+
+static
+BOOLEAN
+LdrpInitializeLoaderWorkers(VOID)
+{
+    NTSTATUS Status;
+
+    if (LdrpLoaderWorkerLockInitialized) return TRUE;
+
+    Status = NtCreateSemaphore(&LdrpLoaderWorkerSemaphore,
+                               SEMAPHORE_ALL_ACCESS,
+                               NULL,
+                               0,
+                               MAXLONG);
+    if (!NT_SUCCESS(Status)) return FALSE;
+
+    Status = NtCreateEvent(&LdrpSectionRequestDoneEvent,
+                           EVENT_ALL_ACCESS,
+                           NULL,
+                           SynchronizationEvent,
+                           FALSE);
+    if (!NT_SUCCESS(Status))
+    {
+        NtClose(LdrpLoaderWorkerSemaphore);
+        LdrpLoaderWorkerSemaphore = NULL;
+        return FALSE;
+    }
+
+    Status = RtlInitializeCriticalSection(&LdrpLoaderWorkerLock);
+    if (!NT_SUCCESS(Status))
+    {
+        NtClose(LdrpSectionRequestDoneEvent);
+        NtClose(LdrpLoaderWorkerSemaphore);
+        LdrpSectionRequestDoneEvent = LdrpLoaderWorkerSemaphore = NULL;
+        return FALSE;
+    }
+
+    InitializeListHead(&LdrpSectionRequestList);
+    LdrpLoaderWorkerLockInitialized = TRUE;
+    return TRUE;
+}
+
+/* Makes sure there are as many workers as are useful for the given number of imports */
+static
+BOOLEAN
+LdrpStartLoaderWorkers(IN ULONG Imports)
+{
+    HANDLE Handles[LDRP_MAX_LOADER_WORKERS];
+    CLIENT_ID ClientId;
+    ULONG Wanted, Created = 0, i, j;
+    NTSTATUS Status;
+
+    /* There's no point in it on a single processor */
+    Wanted = min(min(LdrpNumberOfProcessors, LDRP_MAX_LOADER_WORKERS), Imports);
+    if (Wanted < 2) return FALSE;
+
+    if (!LdrpInitializeLoaderWorkers()) return FALSE;
+
+    RtlEnterCriticalSection(&LdrpLoaderWorkerLock);
+
+    /*
+     * The workers are created suspended, so that they are known as such
+     * before LdrpInit runs for them. It lets them through even when the
+     * process is still being initialized.
+     */
+    for (i = 0; LdrpLoaderWorkerCount < Wanted && i < LDRP_MAX_LOADER_WORKERS; i++)
+    {
+        if (LdrpLoaderWorkerIds[i]) continue;
+
+        Status = RtlCreateUserThread(NtCurrentProcess(),
+                                     NULL,
+                                     TRUE,
+                                     0,
+                                     0,
+                                     0,
+                                     (PTHREAD_START_ROUTINE)LdrpLoaderWorker,
+                                     NULL,
+                                     &Handles[Created],
+                                     &ClientId);
+        if (!NT_SUCCESS(Status)) break;
+
+        LdrpLoaderWorkerIds[i] = ClientId.UniqueThread;
+        LdrpLoaderWorkerCount++;
+        Created++;
+    }
+
+    RtlLeaveCriticalSection(&LdrpLoaderWorkerLock);
+
+    /* Nobody waits for them, they exit on their own */
+    for (j = 0; j < Created; j++)
+    {
+        NtResumeThread(Handles[j], NULL);
+        NtClose(Handles[j]);
+    }
+
+    return LdrpLoaderWorkerCount != 0;
+}
+
+static
+BOOLEAN
+LdrpIsImportLoaded(IN PUNICODE_STRING DllName)
+{
+    PLIST_ENTRY ListHead, Entry;
+    PLDR_DATA_TABLE_ENTRY LdrEntry;
+
+    ListHead = &LdrpHashTable[LDR_GET_HASH_ENTRY(DllName->Buffer[0])];
+    for (Entry = ListHead->Flink; Entry != ListHead; Entry = Entry->Flink)
+    {
+        LdrEntry = CONTAINING_RECORD(Entry, LDR_DATA_TABLE_ENTRY, HashLinks);
+        if (RtlEqualUnicodeString(DllName, &LdrEntry->BaseDllName, TRUE)) return TRUE;
+    }
+
+    return FALSE;
+}
+
+static
+PLDRP_SECTION_REQUEST
+LdrpFindSectionRequest(IN PUNICODE_STRING DllName)
+{
+    PLIST_ENTRY Entry;
+    PLDRP_SECTION_REQUEST Request;
+
+    for (Entry = LdrpSectionRequestList.Flink;
+         Entry != &LdrpSectionRequestList;
+         Entry = Entry->Flink)
+    {
+        Request = CONTAINING_RECORD(Entry, LDRP_SECTION_REQUEST, Links);
+        if (RtlEqualUnicodeString(DllName, &Request->DllName, TRUE)) return Request;
+    }
+
+    return NULL;
+}
+
+/*
+ * Gets the name of an import as LdrpLoadImportModule does, with an extension.
+ * Runs on the loading thread, with the activation context of the importing
+ * module active, so the redirections are the ones the import will get.
+ */
+static
+BOOLEAN
+LdrpGetImportName(IN PVOID DllBase,
+                  IN PIMAGE_IMPORT_DESCRIPTOR ImportEntry,
+                  OUT PUNICODE_STRING DllName,
+                  IN PWCHAR Buffer,
+                  IN USHORT BufferSize)
+{
+    ANSI_STRING AnsiName;
+    UNICODE_STRING StaticString, *RedirectedName;
+    WCHAR StaticBuffer[MAX_PATH];
+    BOOLEAN GotExtension = FALSE, Redirected;
+    USHORT i;
+
+    RtlInitAnsiString(&AnsiName, (PCHAR)DllBase + ImportEntry->Name);
+    RtlInitEmptyUnicodeString(DllName, Buffer, BufferSize);
+    if (!NT_SUCCESS(RtlAnsiStringToUnicodeString(DllName, &AnsiName, FALSE))) return FALSE;
+
+    for (i = 0; i < DllName->Length / sizeof(WCHAR); i++)
+    {
+        /* Names with a path are left to the loading thread */
+        if (DllName->Buffer[i] == L'\\' || DllName->Buffer[i] == L'/') return FALSE;
+        if (DllName->Buffer[i] == L'.') GotExtension = TRUE;
+    }
+
+    if (!GotExtension &&
+        !NT_SUCCESS(RtlAppendUnicodeStringToString(DllName, &LdrApiDefaultExtension)))
+    {
+        return FALSE;
+    }
+
+    /* A worker would look for the DLL where it isn't, leave these alone */
+    RtlInitEmptyUnicodeString(&StaticString, StaticBuffer, sizeof(StaticBuffer));
+    RedirectedName = DllName;
+    Redirected = FALSE;
+    if (!NT_SUCCESS(LdrpApplyFileNameRedirection(DllName,
+                                                 &LdrApiDefaultExtension,
+                                                 &StaticString,
+                                                 NULL,
+                                                 &RedirectedName,
+                                                 &Redirected)))
+    {
+        return FALSE;
+    }
+
+    return !Redirected;
+}
+
+/*
+ * Queues the imports of a module that aren't loaded yet to the loader
+ * workers. Called by LdrpWalkImportDescriptor before it handles them.
+ */
+VOID
+NTAPI
+LdrpQueueImportSections(IN LPWSTR DllPath OPTIONAL,
+                        IN PVOID DllBase,
+                        IN PIMAGE_IMPORT_DESCRIPTOR ImportEntry)
+{
+    PLDRP_SECTION_REQUEST Request;
+    PIMAGE_IMPORT_DESCRIPTOR Entry;
+    UNICODE_STRING DllName;
+    WCHAR NameBuffer[64];
+    SIZE_T PathSize, Size;
+    ULONG Queued = 0, Missing = 0;
+
+    PathSize = DllPath ? (wcslen(DllPath) + 1) * sizeof(WCHAR) : 0;
+
+    /* Only fan out when there's enough to load */
+    for (Entry = ImportEntry; Entry->Name && Entry->FirstThunk; Entry++)
+    {
+        if (LdrpGetImportName(DllBase, Entry, &DllName, NameBuffer, sizeof(NameBuffer)) &&
+            !LdrpIsImportLoaded(&DllName))
+        {
+            Missing++;
+        }
+    }
+    if (Missing < LDRP_MIN_IMPORTS_FOR_WORKERS) return;
+
+    if (!LdrpStartLoaderWorkers(Missing)) return;
+
+    for (; ImportEntry->Name && ImportEntry->FirstThunk; ImportEntry++)
+    {
+        if (!LdrpGetImportName(DllBase, ImportEntry, &DllName, NameBuffer, sizeof(NameBuffer)) ||
+            LdrpIsImportLoaded(&DllName))
+        {
+            continue;
+        }
+
+        RtlEnterCriticalSection(&LdrpLoaderWorkerLock);
+        Request = LdrpFindSectionRequest(&DllName);
+        RtlLeaveCriticalSection(&LdrpLoaderWorkerLock);
+        if (Request) continue;
+
+        /* The names are stored right after the request */
+        Size = sizeof(*Request) + DllName.Length + sizeof(UNICODE_NULL) + PathSize;
+        Request = RtlAllocateHeap(LdrpHeap, HEAP_ZERO_MEMORY, Size);
+        if (!Request) break;
+
+        Request->State = SectionRequestQueued;
+        Request->DllName.Buffer = (PWSTR)(Request + 1);
+        Request->DllName.MaximumLength = DllName.Length + sizeof(UNICODE_NULL);
+        RtlCopyUnicodeString(&Request->DllName, &DllName);
+        if (DllPath)
+        {
+            Request->DllPath = (PWSTR)((PUCHAR)Request->DllName.Buffer + Request->DllName.MaximumLength);
+            RtlCopyMemory(Request->DllPath, DllPath, PathSize);
+        }
+
+        RtlEnterCriticalSection(&LdrpLoaderWorkerLock);
+        InsertTailList(&LdrpSectionRequestList, &Request->Links);
+        RtlLeaveCriticalSection(&LdrpLoaderWorkerLock);
+
+        LdrpSectionRequestCount++;
+        Queued++;
+    }
+
+    if (Queued) NtReleaseSemaphore(LdrpLoaderWorkerSemaphore, Queued, NULL);
+}
+
+/*
+ * Returns the section a loader worker created for the DLL, if it was found
+ * at the same place by the loading thread. Waits for the worker if needed.
+ */
+HANDLE
+NTAPI
+LdrpTakeImportSection(IN PWSTR DllName,
+                      IN PUNICODE_STRING FullDllName)
+{
+    PLDRP_SECTION_REQUEST Request;
+    UNICODE_STRING Name;
+    HANDLE SectionHandle = NULL;
+
+    if (!LdrpLoaderWorkerLockInitialized) return NULL;
+
+    RtlInitUnicodeString(&Name, DllName);
+
+    RtlEnterCriticalSection(&LdrpLoaderWorkerLock);
+    Request = LdrpFindSectionRequest(&Name);
+    if (Request && Request->State == SectionRequestQueued)
+    {
+        /* Not started yet, doing it here is as fast */
+        RemoveEntryList(&Request->Links);
+        RtlLeaveCriticalSection(&LdrpLoaderWorkerLock);
+        LdrpFreeSectionRequest(Request);
+        return NULL;
+    }
+
+    while (Request && Request->State == SectionRequestRunning)
+    {
+        RtlLeaveCriticalSection(&LdrpLoaderWorkerLock);
+        NtWaitForSingleObject(LdrpSectionRequestDoneEvent, FALSE, NULL);
+        RtlEnterCriticalSection(&LdrpLoaderWorkerLock);
+    }
+
+    if (Request) RemoveEntryList(&Request->Links);
+    RtlLeaveCriticalSection(&LdrpLoaderWorkerLock);
+
+    if (!Request) return NULL;
+
+    if (Request->SectionHandle &&
+        RtlEqualUnicodeString(FullDllName, &Request->FullDllName, TRUE))
+    {
+        SectionHandle = Request->SectionHandle;
+        Request->SectionHandle = NULL;
+        LdrpSectionRequestHits++;
+    }
+
+    LdrpFreeSectionRequest(Request);
+    return SectionHandle;
+}
+
+/*
+ * Ends the outermost import walk: drops what wasn't started, waits for the
+ * sections being created and throws away the ones nobody took. The workers
+ * stay for the next walk.
+ */
+VOID
+NTAPI
+LdrpRetireImportSections(VOID)
+{
+    PLDRP_SECTION_REQUEST Request;
+    PLIST_ENTRY Entry;
+    BOOLEAN Running;
+
+    LdrpImportWalkDepth = 0;
+    if (!LdrpLoaderWorkerLockInitialized) return;
+
+    RtlEnterCriticalSection(&LdrpLoaderWorkerLock);
+    if (IsListEmpty(&LdrpSectionRequestList) && !LdrpSectionRequestCount)
+    {
+        /* This walk didn't fan out */
+        RtlLeaveCriticalSection(&LdrpLoaderWorkerLock);
+        return;
+    }
+
+    do
+    {
+        Running = FALSE;
+        Entry = LdrpSectionRequestList.Flink;
+        while (Entry != &LdrpSectionRequestList)
+        {
+            Request = CONTAINING_RECORD(Entry, LDRP_SECTION_REQUEST, Links);
+            Entry = Entry->Flink;
+
+            if (Request->State == SectionRequestRunning)
+            {
+                Running = TRUE;
+                continue;
+            }
+
+            RemoveEntryList(&Request->Links);
+            LdrpFreeSectionRequest(Request);
+        }
+
+        if (Running)
+        {
+            RtlLeaveCriticalSection(&LdrpLoaderWorkerLock);
+            NtWaitForSingleObject(LdrpSectionRequestDoneEvent, FALSE, NULL);
+            RtlEnterCriticalSection(&LdrpLoaderWorkerLock);
+        }
+    } while (Running);
+    RtlLeaveCriticalSection(&LdrpLoaderWorkerLock);
+
+    DPRINT("LDR: Loader workers created %lu of %lu import sections\n",
+           LdrpSectionRequestHits,
+           LdrpSectionRequestCount);
+
+    LdrpSectionRequestCount = LdrpSectionRequestHits = 0;
+}
+
+/* EOF */
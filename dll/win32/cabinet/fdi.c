@@ -1953,8 +1953,15 @@ static int fdi_decomp(const struct fdi_file *fi, int savemode, fdi_decomp_state
     if (cando > bytes) cando = bytes;
 
     /* if cando != 0 */
+#ifdef __REACTOS__
+    /* a short write means the target is full or broken */
+    if (cando && savemode &&
+        CAB(fdi)->write(CAB(filehf), CAB(outpos), cando) != cando)
+      return DECR_OUTPUT;
+#else
     if (cando && savemode)
       CAB(fdi)->write(CAB(filehf), CAB(outpos), cando);
+#endif
 
     CAB(outpos) += cando;
     CAB(outlen) -= cando;
@@ -2264,6 +2271,270 @@ static void free_decompression_mem(FDI_Int *fdi, fdi_decomp_state *decomp_state)
   }
 }
 
+#ifdef __REACTOS__
+/*
+ * Parallel folder decompression.
+ *
+ * When a cabinet which is not part of a set holds several folders, FDICopy
+ * reads the data blocks of the folder being extracted and of the following
+ * ones, up to FDI_PREFETCH_BUDGET uncompressed bytes, and decompresses each
+ * folder into memory on a thread pool worker.  The folders are then
+ * decompressed in parallel with each other and with the writing of the
+ * output files.  The callbacks given to FDICreate and FDICopy are only ever
+ * called on the caller's thread: the workers allocate from the process heap.
+ * Folders which do not fit in the budget use the serial path.
+ */
+#define FDI_PREFETCH_BUDGET (32 * 1024 * 1024)
+#define DECR_SERIAL (-1)
+
+enum fdi_prefetch_state {
+  PREFETCH_NONE,    /* not looked at yet */
+  PREFETCH_WAITING, /* scanned, waiting for memory to be released */
+  PREFETCH_PENDING, /* queued to a worker, maybe done */
+  PREFETCH_SERIAL,  /* extracted by the serial path */
+};
+
+struct fdi_prefetch {
+  struct fdi_folder *fol;
+  enum fdi_prefetch_state state;
+  FDI_Int fdi;                    /* heap allocators for the worker */
+  fdi_decomp_state *decomp_state; /* the worker's decompressor */
+  cab_UBYTE *blocks;              /* CFDATA headers and data, no reserve */
+  cab_UBYTE *data;                /* the uncompressed folder */
+  cab_ULONG size;                 /* also set while waiting */
+  HANDLE done;
+  int err;
+};
+
+static void * __cdecl fdi_heap_alloc(ULONG cb)
+{
+  return HeapAlloc(GetProcessHeap(), 0, cb);
+}
+
+static void __cdecl fdi_heap_free(void *pv)
+{
+  HeapFree(GetProcessHeap(), 0, pv);
+}
+
+static DWORD WINAPI fdi_prefetch_worker(void *param)
+{
+  struct fdi_prefetch *pf = param;
+  fdi_decomp_state *decomp_state = pf->decomp_state;
+  cab_UWORD comptype = pf->fol->comp_type;
+  cab_UBYTE *in = pf->blocks, *out = pf->data;
+  cab_UWORD inlen, outlen, i;
+  cab_ULONG cksum;
+  int err = DECR_OK;
+
+  CAB(fdi) = &pf->fdi;
+
+  switch (comptype & cffoldCOMPTYPE_MASK) {
+  case cffoldCOMPTYPE_NONE:
+    CAB(decompress) = NONEfdi_decomp;
+    break;
+  case cffoldCOMPTYPE_MSZIP:
+    CAB(decompress) = ZIPfdi_decomp;
+    break;
+  case cffoldCOMPTYPE_QUANTUM:
+    CAB(decompress) = QTMfdi_decomp;
+    err = QTMfdi_init((comptype >> 8) & 0x1f, (comptype >> 4) & 0xF, decomp_state);
+    break;
+  case cffoldCOMPTYPE_LZX:
+    CAB(decompress) = LZXfdi_decomp;
+    err = LZXfdi_init((comptype >> 8) & 0x1f, decomp_state);
+    break;
+  default:
+    err = DECR_DATAFORMAT;
+  }
+
+  for (i = 0; !err && i < pf->fol->num_blocks; i++) {
+    cksum  = EndGetI32(in+cfdata_CheckSum);
+    inlen  = EndGetI16(in+cfdata_CompressedSize);
+    outlen = EndGetI16(in+cfdata_UncompressedSize);
+
+    memcpy(CAB(inbuf), in + cfdata_SIZEOF, inlen);
+    CAB(inbuf)[inlen+1] = CAB(inbuf)[inlen+2] = 0;
+
+    if (cksum && cksum != checksum(in+4, 4, checksum(CAB(inbuf), inlen, 0))) {
+      err = DECR_CHECKSUM;
+    } else if (!(err = CAB(decompress)(inlen, outlen, decomp_state))) {
+      memcpy(out, CAB(outbuf), outlen);
+      out += outlen;
+    }
+    in += cfdata_SIZEOF + inlen;
+  }
+
+  free_decompression_temps(&pf->fdi, pf->fol, decomp_state);
+  pf->err = err;
+  SetEvent(pf->done);
+  return 0;
+}
+
+static void fdi_prefetch_release(struct fdi_prefetch *pf, cab_ULONG *held)
+{
+  if (pf->state != PREFETCH_PENDING) return;
+
+  WaitForSingleObject(pf->done, INFINITE);
+  CloseHandle(pf->done);
+  HeapFree(GetProcessHeap(), 0, pf->decomp_state);
+  HeapFree(GetProcessHeap(), 0, pf->blocks);
+  HeapFree(GetProcessHeap(), 0, pf->data);
+  *held -= pf->size;
+
+  /* files going back to this folder use the serial path */
+  pf->state = PREFETCH_SERIAL;
+}
+
+/*
+ * Reads the data blocks of a folder and queues it for decompression.
+ * Returns FALSE if the folder has to wait until the memory held by the
+ * folders before it is released.
+ */
+static BOOL fdi_prefetch_start(FDI_Int *fdi, fdi_decomp_state *decomp_state,
+  struct fdi_prefetch *pf, cab_ULONG *held)
+{
+  cab_UBYTE buf[cfdata_SIZEOF], *pos;
+  cab_ULONG comp_size = 0, size = 0;
+  cab_UWORD inlen, outlen, i;
+
+  pf->state = PREFETCH_SERIAL;
+
+  /* add up the block sizes */
+  if (fdi->seek(CAB(cabhf), pf->fol->offset, SEEK_SET) == -1) return TRUE;
+  for (i = 0; i < pf->fol->num_blocks; i++) {
+    if (fdi->read(CAB(cabhf), buf, cfdata_SIZEOF) != cfdata_SIZEOF) return TRUE;
+    inlen  = EndGetI16(buf+cfdata_CompressedSize);
+    outlen = EndGetI16(buf+cfdata_UncompressedSize);
+
+    /* a block continued in the next cabinet, or garbage */
+    if (inlen > CAB_INPUTMAX || !outlen || outlen > CAB_BLOCKMAX) return TRUE;
+
+    comp_size += cfdata_SIZEOF + inlen;
+    size += outlen;
+    if (size > FDI_PREFETCH_BUDGET) return TRUE;
+
+    if (fdi->seek(CAB(cabhf), CAB(mii).block_resv + inlen, SEEK_CUR) == -1) return TRUE;
+  }
+
+  if (*held + size > FDI_PREFETCH_BUDGET) {
+    pf->state = PREFETCH_WAITING;
+    pf->size = size;
+    return FALSE;
+  }
+
+  pf->fdi = *fdi;
+  pf->fdi.alloc = fdi_heap_alloc;
+  pf->fdi.free = fdi_heap_free;
+  pf->decomp_state = HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY, sizeof(fdi_decomp_state));
+  pf->blocks = HeapAlloc(GetProcessHeap(), 0, comp_size);
+  pf->data = HeapAlloc(GetProcessHeap(), 0, size ? size : 1);
+  pf->done = CreateEventW(NULL, TRUE, FALSE, NULL);
+  pf->size = size;
+  pf->err = DECR_OK;
+  if (!pf->decomp_state || !pf->blocks || !pf->data || !pf->done)
+    goto fail;
+
+  /* read the blocks, dropping the reserved areas */
+  if (fdi->seek(CAB(cabhf), pf->fol->offset, SEEK_SET) == -1) goto fail;
+  for (i = 0, pos = pf->blocks; i < pf->fol->num_blocks; i++) {
+    if (fdi->read(CAB(cabhf), pos, cfdata_SIZEOF) != cfdata_SIZEOF) goto fail;
+    inlen = EndGetI16(pos+cfdata_CompressedSize);
+    if (pos + cfdata_SIZEOF + inlen > pf->blocks + comp_size) goto fail;
+    if (CAB(mii).block_resv &&
+        fdi->seek(CAB(cabhf), CAB(mii).block_resv, SEEK_CUR) == -1) goto fail;
+    if (fdi->read(CAB(cabhf), pos + cfdata_SIZEOF, inlen) != inlen) goto fail;
+    pos += cfdata_SIZEOF + inlen;
+  }
+
+  if (!QueueUserWorkItem(fdi_prefetch_worker, pf, WT_EXECUTELONGFUNCTION)) goto fail;
+
+  pf->state = PREFETCH_PENDING;
+  *held += size;
+  return TRUE;
+
+fail:
+  if (pf->done) CloseHandle(pf->done);
+  HeapFree(GetProcessHeap(), 0, pf->decomp_state);
+  HeapFree(GetProcessHeap(), 0, pf->blocks);
+  HeapFree(GetProcessHeap(), 0, pf->data);
+  pf->done = NULL;
+  pf->decomp_state = NULL;
+  pf->blocks = pf->data = NULL;
+  return TRUE;
+}
+
+/*
+ * Extracts a file from its prefetched folder, after queuing the folders
+ * which come next.  Returns DECR_SERIAL if the file has to be extracted by
+ * the serial path.
+ */
+static int fdi_prefetch_extract(FDI_Int *fdi, fdi_decomp_state *decomp_state,
+  struct fdi_prefetch *prefetch, unsigned int count, const struct fdi_file *file,
+  const struct fdi_folder *fol, INT_PTR filehf, cab_ULONG *held)
+{
+  struct fdi_prefetch *pf;
+  cab_ULONG pos, cando;
+  LONG cabpos = -1;
+  unsigned int cur, i;
+
+  for (cur = 0; cur < count && prefetch[cur].fol != fol; cur++);
+  if (cur == count) return DECR_SERIAL;
+  pf = &prefetch[cur];
+
+  /* the folders before this one are done with */
+  for (i = 0; i < cur; i++)
+    fdi_prefetch_release(&prefetch[i], held);
+
+  for (i = cur; i < count; i++) {
+    /* a folder that didn't fit is only retried once enough memory was released */
+    if (prefetch[i].state == PREFETCH_WAITING &&
+        *held + prefetch[i].size > FDI_PREFETCH_BUDGET) break;
+    if (prefetch[i].state != PREFETCH_NONE &&
+        prefetch[i].state != PREFETCH_WAITING) continue;
+
+    /* the serial path may be in the middle of a folder, keep its place */
+    if (cabpos == -1 && (cabpos = fdi->seek(CAB(cabhf), 0, SEEK_CUR)) == -1) {
+      if (CAB(current)) {
+        free_decompression_temps(fdi, CAB(current), decomp_state);
+        CAB(current) = NULL;
+      }
+      cabpos = 0;
+    }
+    if (!fdi_prefetch_start(fdi, decomp_state, &prefetch[i], held)) break;
+  }
+
+  if (cabpos != -1 && fdi->seek(CAB(cabhf), cabpos, SEEK_SET) == -1 && CAB(current)) {
+    /* lost it, so the serial path starts the folder over */
+    free_decompression_temps(fdi, CAB(current), decomp_state);
+    CAB(current) = NULL;
+  }
+
+  if (pf->state != PREFETCH_PENDING) return DECR_SERIAL;
+
+  WaitForSingleObject(pf->done, INFINITE);
+  if (pf->err) return pf->err;
+  if (file->offset > pf->size || file->length > pf->size - file->offset)
+    return DECR_INPUT;
+
+  for (pos = 0; pos < file->length; pos += cando) {
+    cando = min(file->length - pos, CAB_BLOCKMAX);
+    if (fdi->write(filehf, pf->data + file->offset + pos, cando) != cando)
+      return DECR_OUTPUT;
+  }
+  return DECR_OK;
+}
+
+static void fdi_prefetch_free(struct fdi_prefetch *prefetch, unsigned int count)
+{
+  cab_ULONG held = 0;
+  unsigned int i;
+
+  for (i = 0; i < count; i++)
+    fdi_prefetch_release(&prefetch[i], &held);
+  HeapFree(GetProcessHeap(), 0, prefetch);
+}
+#endif
+
 /***********************************************************************
  *		FDICopy (CABINET.22)
  *
@@ -2449,6 +2720,11 @@ BOOL __cdecl FDICopy(
   struct fdi_file   *file = NULL, *linkfile = NULL;
   fdi_decomp_state *decomp_state;
   FDI_Int *fdi = get_fdi_ptr( hfdi );
+#ifdef __REACTOS__
+  struct fdi_prefetch *prefetch = NULL;
+  cab_ULONG         held = 0;
+  SYSTEM_INFO       si;
+#endif
 
   TRACE("(hfdi == ^%p, pszCabinet == %s, pszCabPath == %s, flags == %x, "
         "pfnfdin == ^%p, pfnfdid == ^%p, pvUser == ^%p)\n",
@@ -2580,6 +2856,20 @@ BOOL __cdecl FDICopy(
     linkfile = file;
   }
 
+#ifdef __REACTOS__
+  /* decompress the folders in parallel, unless the cabinet is part of a set */
+  GetSystemInfo(&si);
+  if (fdici.cFolders > 1 && si.dwNumberOfProcessors > 1 &&
+      !CAB(mii).hasnext && !CAB(mii).prevname) {
+    struct fdi_folder *pffol;
+
+    prefetch = HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY, fdici.cFolders * sizeof(*prefetch));
+    if (prefetch)
+      for (i = 0, pffol = CAB(firstfol); pffol && i < fdici.cFolders; pffol = pffol->next, i++)
+        prefetch[i].fol = pffol;
+  }
+#endif
+
   for (file = CAB(firstfile); (file); file = file->next) {
 
     /*
@@ -2688,6 +2978,16 @@ BOOL __cdecl FDICopy(
       CAB(fdi) = fdi;
       CAB(filehf) = filehf;
 
+#ifdef __REACTOS__
+      if (prefetch) {
+        err = fdi_prefetch_extract(fdi, decomp_state, prefetch, fdici.cFolders,
+                                   file, fol, filehf, &held);
+        if (err != DECR_SERIAL) goto close_file;
+        err = 0;
+        ct2 = CAB(current) ? (CAB(current)->comp_type & cffoldCOMPTYPE_MASK) : 0;
+      }
+#endif
+
       /* Was there a change of folder?  Compression type?  Did we somehow go backwards? */
       if ((ct1 != ct2) || (CAB(current) != fol) || (file->offset < CAB(offset))) {
 
@@ -2770,6 +3070,9 @@ BOOL __cdecl FDICopy(
       err = fdi_decomp(file, 1, decomp_state, pszCabPath, pfnfdin, pvUser);
       if (err) CAB(current) = NULL; else CAB(offset) += file->length;
 
+#ifdef __REACTOS__
+close_file:
+#endif
       /* fdintCLOSE_FILE_INFO notification */
       ZeroMemory(&fdin, sizeof(FDINOTIFICATION));
       fdin.pv = pvUser;
@@ -2792,6 +3095,11 @@ BOOL __cdecl FDICopy(
         case DECR_NOMEMORY:
           set_error( fdi, FDIERROR_ALLOC_FAIL, ERROR_NOT_ENOUGH_MEMORY );
           goto bail_and_fail;
+#ifdef __REACTOS__
+        case DECR_OUTPUT:
+          set_error( fdi, FDIERROR_TARGET_FILE, 0 );
+          goto bail_and_fail;
+#endif
         default:
           set_error( fdi, FDIERROR_CORRUPT_CABINET, 0 );
           goto bail_and_fail;
@@ -2800,6 +3108,9 @@ BOOL __cdecl FDICopy(
   }
 
   if (fol) free_decompression_temps(fdi, fol, decomp_state);
+#ifdef __REACTOS__
+  if (prefetch) fdi_prefetch_free(prefetch, fdici.cFolders);
+#endif
   free_decompression_mem(fdi, decomp_state);
  
   return TRUE;
@@ -2810,6 +3121,9 @@ BOOL __cdecl FDICopy(
 
   if (filehf) fdi->close(filehf);
 
+#ifdef __REACTOS__
+  if (prefetch) fdi_prefetch_free(prefetch, fdici.cFolders);
+#endif
   free_decompression_mem(fdi, decomp_state);
 
   return FALSE;
@@ -63,6 +63,7 @@
 @ stub GetOwnerModuleFromUdp6Entry
 @ stdcall GetOwnerModuleFromUdpEntry(ptr long ptr ptr)
 @ stdcall GetPerAdapterInfo(long ptr ptr)
+@ stdcall GetPerTcpConnectionEStats(ptr long ptr long long ptr long long ptr long long)
 @ stdcall GetRTTAndHopCount(long ptr long ptr)
 @ stub GetTcpExTable2FromStack
 @ stdcall GetTcpStatistics(ptr)
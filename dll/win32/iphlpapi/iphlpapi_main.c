@@ -2463,6 +2463,98 @@ DWORD WINAPI GetPerAdapterInfo(ULONG IfIndex, PIP_PER_ADAPTER_INFO pPerAdapterIn
 }
 
 
+/******************************************************************
+ *    GetPerTcpConnectionEStats (IPHLPAPI.@)
+ *
+ * Get extended statistics of a TCP connection.
+ *
+ * PARAMS
+ *  Row        [In]  Connection, as returned by GetTcpTable
+ *  EstatsType [In]  Statistics to get
+ *  Rw         [Out] Collection settings (optional)
+ *  RwVersion  [In]
+ *  RwSize     [In]
+ *  Ros        [Out] Static information (optional)
+ *  RosVersion [In]
+ *  RosSize    [In]
+ *  Rod        [Out] Dynamic information (optional)
+ *  RodVersion [In]
+ *  RodSize    [In]
+ *
+ * RETURNS
+ *  Success: NO_ERROR
+ *  Failure: error code from winerror.h
+ *
+ * NOTES
+ *  Statistics are always collected, there is nothing to enable.
+ */
+ULONG WINAPI GetPerTcpConnectionEStats(PMIB_TCPROW Row, TCP_ESTATS_TYPE EstatsType,
+                                       PUCHAR Rw, ULONG RwVersion, ULONG RwSize,
+                                       PUCHAR Ros, ULONG RosVersion, ULONG RosSize,
+                                       PUCHAR Rod, ULONG RodVersion, ULONG RodSize)
+{
+    TCP_ESTATS_ENTRY Entry;
+    PVOID Data;
+    ULONG DataSize;
+    DWORD ret;
+
+    TRACE("Row %p, EstatsType %d, Rw %p, Ros %p, Rod %p\n", Row, EstatsType, Rw, Ros, Rod);
+
+    if (!Row)
+        return ERROR_INVALID_PARAMETER;
+
+    switch (EstatsType)
+    {
+        case TcpConnectionEstatsData:
+            Data = &Entry.Data;
+            DataSize = sizeof(Entry.Data);
+            break;
+        case TcpConnectionEstatsSndCong:
+            Data = &Entry.SndCong;
+            DataSize = sizeof(Entry.SndCong);
+            break;
+        case TcpConnectionEstatsPath:
+            Data = &Entry.Path;
+            DataSize = sizeof(Entry.Path);
+            break;
+        case TcpConnectionEstatsRec:
+            Data = &Entry.Rec;
+            DataSize = sizeof(Entry.Rec);
+            break;
+        case TcpConnectionEstatsObsRec:
+            Data = &Entry.ObsRec;
+            DataSize = sizeof(Entry.ObsRec);
+            break;
+        default:
+            FIXME("EstatsType %d not supported\n", EstatsType);
+            return ERROR_NOT_SUPPORTED;
+    }
+
+    /* None of the supported types has static information */
+    if ((Rw && (RwVersion != 0 || RwSize != sizeof(BOOLEAN))) ||
+        (Ros && RosSize != 0) ||
+        (Rod && (RodVersion != 0 || RodSize != DataSize)))
+    {
+        return ERROR_INVALID_PARAMETER;
+    }
+
+    if (Rod)
+    {
+        ret = getTcpConnectionEStats(Row, &Entry);
+        if (ret != NO_ERROR)
+            return ret;
+
+        CopyMemory(Rod, Data, DataSize);
+    }
+
+    /* All the RW_v0 structures are a single EnableCollection */
+    if (Rw)
+        *(PBOOLEAN)Rw = TRUE;
+
+    return NO_ERROR;
+}
+
+
 /******************************************************************
  *    GetRTTAndHopCount (IPHLPAPI.@)
  *
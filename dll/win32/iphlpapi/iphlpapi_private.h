@@ -42,6 +42,7 @@
 
 #include <tdiinfo.h>
 #include <tcpioctl.h>
+#include <tcpestats.h>
 
 #include <tdilib.h>
 
@@ -51,6 +51,11 @@ DWORD getIPStats(PMIB_IPSTATS stats, DWORD family);
  */
 DWORD getTCPStats(MIB_TCPSTATS *stats, DWORD family);
 
+/* Gets the extended statistics of the TCP connection described by row.
+ * Returns ERROR_NOT_FOUND if there is no such connection.
+ */
+DWORD getTcpConnectionEStats(PMIB_TCPROW row, PTCP_ESTATS_ENTRY entry);
+
 /* Gets UDP statistics into stats.  Returns ERROR_INVALID_PARAMETER if stats is
  * NULL, NO_ERROR otherwise.
  */
@@ -341,17 +341,123 @@ DWORD getIPStats(PMIB_IPSTATS stats, DWORD family)
   return NO_ERROR;
 }
 
+static NTSTATUS tdiGetTcpInfo( HANDLE tcpFile, DWORD instance, DWORD id,
+                               PVOID info, DWORD size ) {
+    TCP_REQUEST_QUERY_INFORMATION_EX req = TCP_REQUEST_QUERY_INFORMATION_INIT;
+    DWORD returnSize;
+
+    req.ID.toi_class                = INFO_CLASS_PROTOCOL;
+    req.ID.toi_type                 = INFO_TYPE_PROVIDER;
+    req.ID.toi_id                   = id;
+    req.ID.toi_entity.tei_entity    = CO_TL_ENTITY;
+    req.ID.toi_entity.tei_instance  = instance;
+
+    if (!DeviceIoControl( tcpFile,
+                          IOCTL_TCP_QUERY_INFORMATION_EX,
+                          &req,
+                          sizeof(req),
+                          info,
+                          size,
+                          &returnSize,
+                          NULL ))
+        return STATUS_UNSUCCESSFUL;
+
+    return returnSize == size ? STATUS_SUCCESS : STATUS_UNSUCCESSFUL;
+}
+
 DWORD getTCPStats(MIB_TCPSTATS *stats, DWORD family)
 {
+  HANDLE tcpFile;
+  NTSTATUS status;
+
   if (!stats)
     return ERROR_INVALID_PARAMETER;
 
   if (family != AF_INET && family != AF_INET6)
     return ERROR_INVALID_PARAMETER;
 
+  memset(stats, 0, sizeof(MIB_TCPSTATS));
+
+  /* tcpip.sys has no IPv6 support */
+  if (family != AF_INET)
+    return NO_ERROR;
+
+  status = openTcpFile(&tcpFile, FILE_READ_DATA);
+  if (!NT_SUCCESS(status))
+  {
+    ERR("openTcpFile returned 0x%08lx\n", status);
+    return RtlNtStatusToDosError(status);
+  }
+
+  /* The statistics are global (TCP_MIB_STAT_ID), tcpip.sys serves them for
+   * any TCP instance, so this works without any connection open */
+  status = tdiGetTcpInfo(tcpFile, 0, IP_MIB_STATS_ID, stats, sizeof(MIB_TCPSTATS));
+
+  closeTcpFile(tcpFile);
+
+  if (!NT_SUCCESS(status))
+  {
+    ERR("Querying the TCP statistics returned 0x%08lx\n", status);
+    memset(stats, 0, sizeof(MIB_TCPSTATS));
+    return ERROR_NOT_SUPPORTED;
+  }
+
   return NO_ERROR;
 }
 
+DWORD getTcpConnectionEStats(PMIB_TCPROW row, PTCP_ESTATS_ENTRY entry)
+{
+  DWORD numEntities, i;
+  TDIEntityID *entitySet = NULL;
+  HANDLE tcpFile;
+  MIB_TCPROW entityRow;
+  NTSTATUS status;
+
+  status = openTcpFile(&tcpFile, FILE_READ_DATA);
+  if (!NT_SUCCESS(status))
+  {
+    ERR("openTcpFile returned 0x%08lx\n", status);
+    return RtlNtStatusToDosError(status);
+  }
+
+  status = tdiGetEntityIDSet(tcpFile, &entitySet, &numEntities);
+  if (NT_SUCCESS(status))
+  {
+    status = STATUS_NOT_FOUND;
+
+    /* Each TCP entity is one connection, find the one matching row */
+    for (i = 0; i < numEntities; i++)
+    {
+      if (entitySet[i].tei_entity != CO_TL_ENTITY)
+        continue;
+
+      if (!NT_SUCCESS(tdiGetTcpInfo(tcpFile, entitySet[i].tei_instance,
+                                    IP_MIB_ARPTABLE_ENTRY_ID, &entityRow, sizeof(entityRow))))
+        continue;
+
+      if (entityRow.dwState == MIB_TCP_STATE_LISTEN ||
+          entityRow.dwLocalAddr != row->dwLocalAddr ||
+          entityRow.dwLocalPort != row->dwLocalPort ||
+          entityRow.dwRemoteAddr != row->dwRemoteAddr ||
+          entityRow.dwRemotePort != row->dwRemotePort)
+        continue;
+
+      status = tdiGetTcpInfo(tcpFile, entitySet[i].tei_instance,
+                             TCP_ESTATS_ENTRY_ID, entry, sizeof(*entry));
+      break;
+    }
+
+    tdiFreeThingSet(entitySet);
+  }
+
+  closeTcpFile(tcpFile);
+
+  if (status == STATUS_NOT_FOUND)
+    return ERROR_NOT_FOUND;
+
+  return NT_SUCCESS(status) ? NO_ERROR : RtlNtStatusToDosError(status);
+}
+
 DWORD getUDPStats(MIB_UDPSTATS *stats, DWORD family)
 {
   if (!stats)
@@ -2890,15 +2890,22 @@ WSPSetSockOpt(
                                    NULL,
                                    NULL);
 
-              return NO_ERROR;
+              /* Let the transport size its own send buffer as well */
+              goto SendToHelper;
 
            case SO_RCVBUF:
+           {
+              ULONG WindowSize;
+
               if (optlen < sizeof(ULONG))
               {
                   if (lpErrno) *lpErrno = WSAEFAULT;
                   return SOCKET_ERROR;
               }
 
+              /* The transport gets the window size that was asked for */
+              WindowSize = *(PULONG)optval;
+
               /* FIXME: We should not have to limit the packet receive buffer size like this. workaround for CORE-15804 */
               if (*(PULONG)optval > 0x2000)
                   *(PULONG)optval = 0x2000;
@@ -2918,7 +2925,17 @@ WSPSetSockOpt(
                                    NULL,
                                    NULL);
 
-              return NO_ERROR;
+              Errno = Socket->HelperData->WSHSetSocketInformation(Socket->HelperContext,
+                                                                  s,
+                                                                  Socket->TdiAddressHandle,
+                                                                  Socket->TdiConnectionHandle,
+                                                                  level,
+                                                                  optname,
+                                                                  (PCHAR)&WindowSize,
+                                                                  sizeof(WindowSize));
+              if (lpErrno) *lpErrno = Errno;
+              return (Errno == NO_ERROR) ? NO_ERROR : SOCKET_ERROR;
+           }
 
            case SO_ERROR:
               if (optlen < sizeof(INT))
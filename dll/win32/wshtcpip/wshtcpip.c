@@ -174,6 +174,14 @@ GetTdiTypeId(
                 /* FIXME: Return proper option */
                 ASSERT(FALSE);
                 break;
+             case SO_RCVBUF:
+                *TdiType = INFO_TYPE_CONNECTION;
+                *TdiId = TCP_SOCKET_WINDOW;
+                return;
+             case SO_SNDBUF:
+                *TdiType = INFO_TYPE_CONNECTION;
+                *TdiId = TCP_SOCKET_SNDBUF;
+                return;
              default:
                 break;
           }
@@ -694,6 +702,20 @@ WSHSetSocketInformation(
                     DPRINT1("Set: SO_KEEPALIVE not yet supported\n");
                     return 0;
 
+                case SO_RCVBUF:
+                case SO_SNDBUF:
+                    if (OptionLength < sizeof(ULONG))
+                    {
+                        return WSAEFAULT;
+                    }
+                    /* AFD already took care of its own buffering */
+                    if (Context->SocketType != SOCK_STREAM)
+                    {
+                        return 0;
+                    }
+                    /* Send these to TCPIP */
+                    break;
+
                 default:
                     /* Invalid option */
                     DPRINT1("Set: Received unexpected SOL_SOCKET option %d\n", OptionName);
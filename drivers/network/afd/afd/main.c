@@ -451,6 +451,10 @@ AfdCleanupSocket(PDEVICE_OBJECT DeviceObject, PIRP Irp,
         }
     }
 
+    /* This one isn't on any list, its buffer is with the transport */
+    if (FCB->DirectRecvIrp)
+        IoCancelIrp(FCB->DirectRecvIrp);
+
     KillSelectsForFCB( FCB->DeviceExt, FileObject, FALSE );
 
     return UnlockAndMaybeComplete(FCB, STATUS_SUCCESS, Irp, 0);
@@ -1274,6 +1278,17 @@ AfdCancelHandler(PDEVICE_OBJECT DeviceObject,
             return;
     }
 
+    if (Function == FUNCTION_RECV && Irp == FCB->DirectRecvIrp)
+    {
+        /* Recall the buffer from the transport, DirectReceiveComplete
+         * will complete the IRP */
+        if (FCB->ReceiveIrp.InFlightRequest)
+            IoCancelIrp(FCB->ReceiveIrp.InFlightRequest);
+
+        SocketStateUnlock(FCB);
+        return;
+    }
+
     CurrentEntry = FCB->PendingIrpList[Function].Flink;
     while (CurrentEntry != &FCB->PendingIrpList[Function])
     {
@@ -10,14 +10,76 @@
 
 #include "afd.h"
 
+/* Returns the waiting receive whose own buffer can be given to the
+ * transport, so the data is copied only once. That's only possible for
+ * a plain single-buffer receive at the head of the queue, and only when
+ * nothing is left in the window that it would have to see first. */
+static PIRP GetDirectReceiveCandidate( PAFD_FCB FCB, UINT MinimumLength )
+{
+    PIRP NextIrp;
+    PAFD_RECV_INFO RecvReq;
+    PAFD_MAPBUF Map;
+
+    if (FCB->Recv.Content != FCB->Recv.BytesUsed) return NULL;
+    if (IsListEmpty(&FCB->PendingIrpList[FUNCTION_RECV])) return NULL;
+
+    NextIrp = CONTAINING_RECORD(FCB->PendingIrpList[FUNCTION_RECV].Flink,
+                                IRP, Tail.Overlay.ListEntry);
+    RecvReq = GetLockedData(NextIrp, IoGetCurrentIrpStackLocation(NextIrp));
+
+    if (!RecvReq->BufferArray || RecvReq->BufferCount != 1) return NULL;
+    if (RecvReq->TdiFlags & (TDI_RECEIVE_PEEK | TDI_RECEIVE_EXPEDITED)) return NULL;
+    if (!RecvReq->BufferArray[0].len ||
+        RecvReq->BufferArray[0].len < MinimumLength) return NULL;
+
+    Map = (PAFD_MAPBUF)(RecvReq->BufferArray + RecvReq->BufferCount);
+    if (!Map[0].Mdl) return NULL;
+
+    return NextIrp;
+}
+
+static BOOLEAN PostDirectReceive( PAFD_FCB FCB, PIRP Irp )
+{
+    PAFD_RECV_INFO RecvReq = GetLockedData(Irp, IoGetCurrentIrpStackLocation(Irp));
+    PAFD_MAPBUF Map = (PAFD_MAPBUF)(RecvReq->BufferArray + RecvReq->BufferCount);
+    NTSTATUS Status;
+
+    AFD_DbgPrint(MID_TRACE,("Receiving straight into %p\n", Irp));
+
+    RemoveEntryList(&Irp->Tail.Overlay.ListEntry);
+    FCB->DirectRecvIrp = Irp;
+
+    Status = TdiReceiveMdl( &FCB->ReceiveIrp.InFlightRequest,
+                            FCB->Connection.Object,
+                            TDI_RECEIVE_NORMAL,
+                            Map[0].Mdl,
+                            RecvReq->BufferArray[0].len,
+                            DirectReceiveComplete,
+                            FCB );
+
+    /* The IRP may already be completed here */
+    if (Status == STATUS_PENDING) return TRUE;
+
+    FCB->DirectRecvIrp = NULL;
+    InsertHeadList(&FCB->PendingIrpList[FUNCTION_RECV],
+                   &Irp->Tail.Overlay.ListEntry);
+    return FALSE;
+}
+
 static VOID RefillSocketBuffer( PAFD_FCB FCB )
 {
+    PIRP NextIrp;
+
     /* Make sure nothing's in flight first */
     if (FCB->ReceiveIrp.InFlightRequest) return;
 
     /* Now ensure that receive is still allowed */
     if (FCB->TdiReceiveClosed) return;
 
+    /* The window is only needed when nobody is waiting for the data */
+    NextIrp = GetDirectReceiveCandidate(FCB, 0);
+    if (NextIrp && PostDirectReceive(FCB, NextIrp)) return;
+
     /* Check if the buffer is full */
     if (FCB->Recv.Content == FCB->Recv.Size)
     {
@@ -52,6 +114,13 @@ static VOID RefillSocketBuffer( PAFD_FCB FCB )
 
 static VOID HandleReceiveComplete( PAFD_FCB FCB, NTSTATUS Status, ULONG_PTR Information )
 {
+    /* We cancelled the window receive ourselves to post a user buffer */
+    if (FCB->RecvWindowRecalled)
+    {
+        FCB->RecvWindowRecalled = FALSE;
+        if (Status == STATUS_CANCELLED) return;
+    }
+
     FCB->LastReceiveStatus = Status;
 
     /* We got closed while the receive was in progress */
@@ -71,11 +140,6 @@ static VOID HandleReceiveComplete( PAFD_FCB FCB, NTSTATUS Status, ULONG_PTR Info
             /* Receive is closed */
             FCB->TdiReceiveClosed = TRUE;
         }
-        else
-        {
-            /* Issue another receive IRP to keep the buffer well stocked */
-            RefillSocketBuffer(FCB);
-        }
     }
     /* Receive failed with no data (unexpected closure) */
     else
@@ -142,9 +206,6 @@ static NTSTATUS TryToSatisfyRecvRequestFromBuffer( PAFD_FCB FCB,
         }
     }
 
-    /* Issue another receive IRP to keep the buffer well stocked */
-    RefillSocketBuffer(FCB);
-
     return STATUS_SUCCESS;
 }
 
@@ -259,15 +320,31 @@ static NTSTATUS ReceiveActivity( PAFD_FCB FCB, PIRP Irp ) {
     return RetStatus;
 }
 
+static VOID FlushReceiveQueue( PAFD_FCB FCB ) {
+    PLIST_ENTRY NextIrpEntry;
+    PIRP NextIrp;
+    PAFD_RECV_INFO RecvReq;
+    PIO_STACK_LOCATION NextIrpSp;
+
+    while( !IsListEmpty( &FCB->PendingIrpList[FUNCTION_RECV] ) ) {
+        NextIrpEntry = RemoveHeadList(&FCB->PendingIrpList[FUNCTION_RECV]);
+        NextIrp = CONTAINING_RECORD(NextIrpEntry, IRP, Tail.Overlay.ListEntry);
+        NextIrpSp = IoGetCurrentIrpStackLocation(NextIrp);
+        RecvReq = GetLockedData(NextIrp, NextIrpSp);
+        NextIrp->IoStatus.Status = STATUS_FILE_CLOSED;
+        NextIrp->IoStatus.Information = 0;
+        UnlockBuffers(RecvReq->BufferArray, RecvReq->BufferCount, FALSE);
+        if( NextIrp->MdlAddress ) UnlockRequest( NextIrp, IoGetCurrentIrpStackLocation( NextIrp ) );
+        (void)IoSetCancelRoutine(NextIrp, NULL);
+        IoCompleteRequest( NextIrp, IO_NETWORK_INCREMENT );
+    }
+}
+
 NTSTATUS NTAPI ReceiveComplete
 ( PDEVICE_OBJECT DeviceObject,
   PIRP Irp,
   PVOID Context ) {
     PAFD_FCB FCB = (PAFD_FCB)Context;
-    PLIST_ENTRY NextIrpEntry;
-    PIRP NextIrp;
-    PAFD_RECV_INFO RecvReq;
-    PIO_STACK_LOCATION NextIrpSp;
 
     UNREFERENCED_PARAMETER(DeviceObject);
 
@@ -281,18 +358,7 @@ NTSTATUS NTAPI ReceiveComplete
 
     if( FCB->State == SOCKET_STATE_CLOSED ) {
         /* Cleanup our IRP queue because the FCB is being destroyed */
-        while( !IsListEmpty( &FCB->PendingIrpList[FUNCTION_RECV] ) ) {
-            NextIrpEntry = RemoveHeadList(&FCB->PendingIrpList[FUNCTION_RECV]);
-            NextIrp = CONTAINING_RECORD(NextIrpEntry, IRP, Tail.Overlay.ListEntry);
-            NextIrpSp = IoGetCurrentIrpStackLocation(NextIrp);
-            RecvReq = GetLockedData(NextIrp, NextIrpSp);
-            NextIrp->IoStatus.Status = STATUS_FILE_CLOSED;
-            NextIrp->IoStatus.Information = 0;
-            UnlockBuffers(RecvReq->BufferArray, RecvReq->BufferCount, FALSE);
-            if( NextIrp->MdlAddress ) UnlockRequest( NextIrp, IoGetCurrentIrpStackLocation( NextIrp ) );
-            (void)IoSetCancelRoutine(NextIrp, NULL);
-            IoCompleteRequest( NextIrp, IO_NETWORK_INCREMENT );
-        }
+        FlushReceiveQueue( FCB );
         SocketStateUnlock( FCB );
         return STATUS_FILE_CLOSED;
     } else if( FCB->State == SOCKET_STATE_LISTENING ) {
@@ -305,6 +371,71 @@ NTSTATUS NTAPI ReceiveComplete
 
     ReceiveActivity( FCB, NULL );
 
+    /* Issue another receive IRP to keep the buffer well stocked */
+    RefillSocketBuffer( FCB );
+
+    SocketStateUnlock( FCB );
+
+    return STATUS_SUCCESS;
+}
+
+NTSTATUS NTAPI DirectReceiveComplete
+( PDEVICE_OBJECT DeviceObject,
+  PIRP Irp,
+  PVOID Context ) {
+    PAFD_FCB FCB = (PAFD_FCB)Context;
+    NTSTATUS Status = Irp->IoStatus.Status;
+    ULONG_PTR Information = Irp->IoStatus.Information;
+    PIRP UserIrp;
+    PAFD_RECV_INFO RecvReq;
+
+    UNREFERENCED_PARAMETER(DeviceObject);
+
+    AFD_DbgPrint(MID_TRACE,("Called\n"));
+
+    /* The MDL belongs to the user request, keep the I/O manager off it */
+    Irp->MdlAddress = NULL;
+
+    if( !SocketAcquireStateLock( FCB ) )
+        return STATUS_FILE_CLOSED;
+
+    ASSERT(FCB->ReceiveIrp.InFlightRequest == Irp);
+    FCB->ReceiveIrp.InFlightRequest = NULL;
+
+    UserIrp = FCB->DirectRecvIrp;
+    FCB->DirectRecvIrp = NULL;
+    ASSERT(UserIrp);
+
+    if( FCB->State == SOCKET_STATE_CLOSED ) {
+        InsertHeadList(&FCB->PendingIrpList[FUNCTION_RECV],
+                       &UserIrp->Tail.Overlay.ListEntry);
+        FlushReceiveQueue( FCB );
+        SocketStateUnlock( FCB );
+        return STATUS_FILE_CLOSED;
+    }
+
+    if( (Status == STATUS_SUCCESS && Information && !FCB->TdiReceiveClosed) ||
+        (Status == STATUS_CANCELLED && UserIrp->Cancel) ) {
+        AFD_DbgPrint(MID_TRACE,("Completing recv %p (%u)\n", UserIrp,
+                                (UINT)Information));
+        RecvReq = GetLockedData(UserIrp, IoGetCurrentIrpStackLocation(UserIrp));
+        UnlockBuffers( RecvReq->BufferArray, RecvReq->BufferCount, FALSE );
+        UserIrp->IoStatus.Status = Status;
+        UserIrp->IoStatus.Information = (Status == STATUS_SUCCESS) ? Information : 0;
+        if( UserIrp->MdlAddress ) UnlockRequest( UserIrp, IoGetCurrentIrpStackLocation( UserIrp ) );
+        (void)IoSetCancelRoutine(UserIrp, NULL);
+        IoCompleteRequest( UserIrp, IO_NETWORK_INCREMENT );
+    } else {
+        /* End of stream or failure, let the usual path report it */
+        InsertHeadList(&FCB->PendingIrpList[FUNCTION_RECV],
+                       &UserIrp->Tail.Overlay.ListEntry);
+        HandleReceiveComplete( FCB, Status, 0 );
+    }
+
+    ReceiveActivity( FCB, NULL );
+
+    RefillSocketBuffer( FCB );
+
     SocketStateUnlock( FCB );
 
     return STATUS_SUCCESS;
@@ -519,14 +650,29 @@ AfdConnectedSocketReadData(PDEVICE_OBJECT DeviceObject, PIRP Irp,
         TotalBytesCopied = 0;
         RemoveEntryList( &Irp->Tail.Overlay.ListEntry );
         UnlockBuffers( RecvReq->BufferArray, RecvReq->BufferCount, FALSE );
+        RefillSocketBuffer( FCB );
         return UnlockAndMaybeComplete( FCB, Status, Irp,
                                        TotalBytesCopied );
     } else if( Status == STATUS_PENDING ) {
         AFD_DbgPrint(MID_TRACE,("Leaving read irp\n"));
         IoMarkIrpPending( Irp );
         (void)IoSetCancelRoutine(Irp, AfdCancelHandler);
+
+        /* A window receive waiting for data would make us copy it twice.
+         * For a big enough request, recall it so this buffer gets posted
+         * instead (ReceiveComplete does the refill). */
+        if( FCB->ReceiveIrp.InFlightRequest && !FCB->DirectRecvIrp &&
+            GetDirectReceiveCandidate( FCB, AFD_DIRECT_RECEIVE_MIN ) == Irp ) {
+            FCB->RecvWindowRecalled = TRUE;
+            IoCancelIrp( FCB->ReceiveIrp.InFlightRequest );
+        } else {
+            RefillSocketBuffer( FCB );
+        }
     } else {
         AFD_DbgPrint(MID_TRACE,("Completed with status %x\n", Status));
+
+        /* Issue another receive IRP to keep the buffer well stocked */
+        RefillSocketBuffer( FCB );
     }
 
     SocketStateUnlock( FCB );
@@ -1054,6 +1054,59 @@ NTSTATUS TdiReceive(
     return STATUS_PENDING;
 }
 
+NTSTATUS TdiReceiveMdl(
+    PIRP *Irp,
+    PFILE_OBJECT TransportObject,
+    USHORT Flags,
+    PMDL Mdl,
+    UINT BufferLength,
+    PIO_COMPLETION_ROUTINE CompletionRoutine,
+    PVOID CompletionContext)
+{
+    PDEVICE_OBJECT DeviceObject;
+
+    ASSERT(*Irp == NULL);
+
+    if (!TransportObject) {
+        AFD_DbgPrint(MIN_TRACE, ("Bad transport object.\n"));
+        return STATUS_INVALID_PARAMETER;
+    }
+
+    DeviceObject = IoGetRelatedDeviceObject(TransportObject);
+    if (!DeviceObject) {
+        AFD_DbgPrint(MIN_TRACE, ("Bad device object.\n"));
+        return STATUS_INVALID_PARAMETER;
+    }
+
+    *Irp = TdiBuildInternalDeviceControlIrp(TDI_RECEIVE,             /* Sub function */
+                                            DeviceObject,            /* Device object */
+                                            TransportObject,         /* File object */
+                                            NULL,                    /* Event */
+                                            NULL);                   /* Status */
+
+    if (!*Irp) {
+        AFD_DbgPrint(MIN_TRACE, ("Insufficient resources.\n"));
+        return STATUS_INSUFFICIENT_RESOURCES;
+    }
+
+    AFD_DbgPrint(MID_TRACE, ("Receiving into caller MDL %p:%u\n", Mdl, BufferLength));
+
+    /* The MDL is already locked and belongs to the caller: the completion
+       routine must detach it from the IRP before returning */
+    TdiBuildReceive(*Irp,                   /* I/O Request Packet */
+                    DeviceObject,           /* Device object */
+                    TransportObject,        /* File object */
+                    CompletionRoutine,      /* Completion routine */
+                    CompletionContext,      /* Completion context */
+                    Mdl,                    /* Data buffer */
+                    Flags,                  /* Flags */
+                    BufferLength);          /* Length of data */
+
+    TdiCall(*Irp, DeviceObject, NULL, NULL);
+
+    return STATUS_PENDING;
+}
+
 
 NTSTATUS TdiReceiveDatagram(
     PIRP *Irp,
@@ -92,6 +92,9 @@ typedef struct IPADDR_ENTRY {
 
 #define IN_FLIGHT_REQUESTS              5
 
+/* Smallest receive worth cancelling an idle window receive for */
+#define AFD_DIRECT_RECEIVE_MIN          0x1000
+
 #define EXTRA_LOCK_BUFFERS              2 /* Number of extra buffers needed
 					   * for ancillary data on packet
 					   * requests. */
@@ -176,6 +179,8 @@ typedef struct _AFD_FCB {
     AFD_TDI_OBJECT AddressFile, Connection;
     AFD_IN_FLIGHT_REQUEST ConnectIrp, ListenIrp, ReceiveIrp, SendIrp, DisconnectIrp;
     AFD_DATA_WINDOW Send, Recv;
+    PIRP DirectRecvIrp;         /* Receive IRP whose buffer is posted to the transport */
+    BOOLEAN RecvWindowRecalled; /* Window receive cancelled to post a user buffer */
     KMUTEX Mutex;
     PKEVENT EventSelect;
     DWORD EventSelectTriggers;
@@ -308,6 +313,7 @@ BOOLEAN CheckUnlockExtraBuffers(PAFD_FCB FCB, PIO_STACK_LOCATION IrpSp);
 /* read.c */
 
 IO_COMPLETION_ROUTINE ReceiveComplete;
+IO_COMPLETION_ROUTINE DirectReceiveComplete;
 
 IO_COMPLETION_ROUTINE PacketSocketRecvComplete;
 
@@ -370,6 +376,15 @@ NTSTATUS TdiReceive
   PIO_COMPLETION_ROUTINE  CompletionRoutine,
   PVOID CompletionContext);
 
+NTSTATUS TdiReceiveMdl
+( PIRP *Irp,
+  PFILE_OBJECT ConnectionObject,
+  USHORT Flags,
+  PMDL Mdl,
+  UINT BufferLength,
+  PIO_COMPLETION_ROUTINE  CompletionRoutine,
+  PVOID CompletionContext);
+
 NTSTATUS TdiSend
 ( PIRP *Irp,
   PFILE_OBJECT ConnectionObject,
@@ -12,6 +12,7 @@
 #define DWORD ULONG
 #include <in6addr.h>
 #include <tcpmib.h>
+#include <tcpestats.h>
 #include <udpmib.h>
 
 #define MAX_PHYSADDR_LEN 8
@@ -67,6 +68,26 @@ typedef struct IPROUTE_ENTRY {
 
 #define TL_INSTANCE 0
 
+/* ReactOS-specific: lwIP glue allocator statistics, on CO_TL_ENTITY */
+#define TCP_POOL_STATS_ID   0x1001
+#define TCP_POOL_CLASSES    6
+
+typedef struct _TCP_POOL_CLASS_STATISTICS {
+    ULONG BlockSize;
+    ULONG InUse;
+    ULONG Allocations;
+    ULONG AllocationMisses; /* Allocations that had to hit the pool */
+    ULONG Frees;
+    ULONG FreeMisses;       /* Frees that went back to the pool */
+} TCP_POOL_CLASS_STATISTICS, *PTCP_POOL_CLASS_STATISTICS;
+
+typedef struct _TCP_POOL_STATISTICS {
+    ULONG HeapInUse;        /* Bytes lwIP has allocated, from its MEM_STATS */
+    ULONG HeapMaxInUse;
+    ULONG HeapFailures;     /* Allocations that couldn't be satisfied */
+    TCP_POOL_CLASS_STATISTICS Classes[TCP_POOL_CLASSES];
+} TCP_POOL_STATISTICS, *PTCP_POOL_STATISTICS;
+
 
 typedef struct ADDRESS_INFO {
     ULONG LocalAddress;
@@ -138,6 +159,16 @@ TDI_STATUS InfoTdiSetArptableMIB(PIP_INTERFACE IF,
                                  PVOID Buffer,
                                  UINT BufferSize);
 
+TDI_STATUS InfoTdiQueryGetPoolStatistics(PNDIS_BUFFER Buffer,
+                                         PUINT BufferSize);
+
+TDI_STATUS InfoTdiQueryGetTcpStatistics(PNDIS_BUFFER Buffer,
+                                        PUINT BufferSize);
+
+TDI_STATUS InfoTdiQueryGetTcpConnectionStatistics(PADDRESS_FILE AddrFile,
+                                                  PNDIS_BUFFER Buffer,
+                                                  PUINT BufferSize);
+
 TDI_STATUS InfoTdiQueryGetArptableMIB(TDIEntityID ID,
 				      PIP_INTERFACE Interface,
 				      PNDIS_BUFFER Buffer,
@@ -154,7 +185,7 @@ TDI_STATUS GetAddressFileInfo(TDIObjectID *ID,
                               PUINT BufferSize);
 
 TDI_STATUS SetConnectionInfo(TDIObjectID *ID,
-                             PCONNECTION_ENDPOINT Connection,
+                             PADDRESS_FILE AddrFile,
                              PVOID Buffer,
                              UINT BufferSize);
 
@@ -0,0 +1,17 @@
+/* ReactOS-Specific lwIP hooks (see LWIP_HOOK_FILENAME in lwipopts.h) */
+
+#ifndef _LWIP_ARCH_HOOKS_H_
+#define _LWIP_ARCH_HOOKS_H_
+
+struct tcp_pcb;
+struct tcp_hdr;
+struct pbuf;
+
+/* Statistics gathering, implemented in ip/lwip_glue/tcp.c */
+err_t
+LibTCPInPacketHook(struct tcp_pcb *pcb, struct tcp_hdr *hdr, struct pbuf *p);
+
+u32_t *
+LibTCPOutPacketHook(struct pbuf *p, struct tcp_hdr *hdr, const struct tcp_pcb *pcb, u32_t *opts);
+
+#endif /* _LWIP_ARCH_HOOKS_H_ */
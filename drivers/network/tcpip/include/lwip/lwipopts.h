@@ -45,26 +45,72 @@
  * add support for other transport mediums */
 #define TCP_MSS                         1460
 
-#define TCP_WND                         0xFFFF
+/* RFC 7323 window scaling. TCP_WND and TCP_SND_BUF are the upper bounds;
+ * the per-connection limits actually used are read from the registry
+ * (TcpWindowSize, TcpSendBufferSize) and can be lowered per socket with
+ * SO_RCVBUF/SO_SNDBUF. */
+#define LWIP_WND_SCALE                  1
 
-#define TCP_SND_BUF                     TCP_WND
+#define TCP_RCV_SCALE                   3
+
+#define TCP_WND                         (256 * 1024)
+
+#define TCP_SND_BUF                     (256 * 1024)
+
+/* Selective acknowledgements for out-of-sequence data we have queued */
+#define LWIP_TCP_SACK_OUT               1
 
 #define TCP_MAXRTX                      8
 
 #define TCP_SYNMAXRTX                   4
 
+/* Enables the listen backlog; the actual depth is given to tcp_listen_with_backlog() */
 #define TCP_LISTEN_BACKLOG              1
 
+#define TCP_DEFAULT_LISTEN_BACKLOG      0xFF
+
 #define LWIP_TCP_TIMESTAMPS             1
 
 #define LWIP_SOCKET                     0
 
 #define LWIP_NETCONN                    0
 
-#define LWIP_STATS                      0
+/* Only what the TCP MIB (see InfoTdiQueryGetTcpStatistics)
+ * and the allocator statistics (see InfoTdiQueryGetPoolStatistics) need */
+#define LWIP_STATS                      1
+
+#define MIB2_STATS                      1
+
+#define TCP_STATS                       1
+
+#define LINK_STATS                      0
+
+#define ETHARP_STATS                    0
+
+#define IP_STATS                        0
+
+#define IPFRAG_STATS                    0
 
 #define ICMP_STATS                      0
 
+#define UDP_STATS                       0
+
+#define SYS_STATS                       0
+
+/* Kept by lwIP itself even though ip/lwip_glue/memory.c does the allocations */
+#define MEM_STATS                       1
+
+#define MEMP_STATS                      1
+
+/* Per-connection statistics are gathered by hooks in ip/lwip_glue/tcp.c */
+#define LWIP_HOOK_FILENAME              "arch/hooks.h"
+
+#define LWIP_HOOK_TCP_INPACKET_PCB(pcb, hdr, optlen, opt1len, opt2, p) \
+    LibTCPInPacketHook(pcb, hdr, p)
+
+#define LWIP_HOOK_TCP_OUT_ADD_TCPOPTS(p, hdr, pcb, opts) \
+    LibTCPOutPacketHook(p, hdr, pcb, opts)
+
 /*
    ---------------------------------------
    ---------- Debugging options ----------
@@ -188,12 +188,30 @@ BOOLEAN TCPRemoveIRP( PCONNECTION_ENDPOINT Connection, PIRP Irp );
 
 NTSTATUS TCPSetNoDelay(PCONNECTION_ENDPOINT Connection, BOOLEAN Set);
 
+NTSTATUS TCPSetReceiveWindow(PADDRESS_FILE AddrFile, ULONG Size);
+
+NTSTATUS TCPSetSendBufferSize(PADDRESS_FILE AddrFile, ULONG Size);
+
+VOID TCPInheritBufferSizes(PCONNECTION_ENDPOINT Connection, PADDRESS_FILE AddrFile);
+
+VOID TCPQueryPoolStatistics(struct _TCP_POOL_STATISTICS *Statistics);
+
+NTSTATUS TCPGetConnectionStatistics(PCONNECTION_ENDPOINT Connection, struct _TCP_ESTATS_ENTRY *Entry);
+
+NTSTATUS TCPGetMibStatistics(struct _MIB_TCPSTATS *Stats);
+
+extern ULONG TCPReceiveWindowSize;
+extern ULONG TCPSendBufferSize;
+
 VOID
 TCPUpdateInterfaceLinkStatus(PIP_INTERFACE IF);
 
 VOID
 TCPUpdateInterfaceIPInformation(PIP_INTERFACE IF);
 
+VOID
+TCPInitializeCompletionQueue(VOID);
+
 VOID
 FlushListenQueue(PCONNECTION_ENDPOINT Connection, const NTSTATUS Status);
 
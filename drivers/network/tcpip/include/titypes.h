@@ -123,6 +123,8 @@ typedef struct _ADDRESS_FILE {
     UINT DF;                              /* Don't fragment */
     UINT BCast;                           /* Receive broadcast packets */
     UINT HeaderIncl;                      /* Include header in RawIP packets */
+    ULONG ReceiveWindowSize;              /* SO_RCVBUF of connections on this address, 0 for the default */
+    ULONG SendBufferSize;                 /* SO_SNDBUF of connections on this address, 0 for the default */
     DATAGRAM_COMPLETION_ROUTINE Complete; /* Completion routine for delete request */
     PVOID Context;                        /* Delete request context */
     DATAGRAM_SEND_ROUTINE Send;           /* Routine to send a datagram */
@@ -237,6 +239,35 @@ typedef struct _TDI_BUCKET {
 /* Transport connection context structure A.K.A. Transmission Control Block
    (TCB) in TCP terminology. The FileObject->FsContext2 field holds a pointer
    to this structure */
+/* Extended statistics of a connection, gathered by the lwIP hooks in
+ * ip/lwip_glue/tcp.c. Only the tcpip thread updates them. Times are in ms */
+typedef struct _TCP_CONNECTION_STATISTICS {
+    ULONG64 SegsIn;
+    ULONG64 SegsOut;
+    ULONG64 DataSegsIn;
+    ULONG64 DataSegsOut;
+    ULONG64 DataBytesIn;
+    ULONG64 DataBytesOut;
+    ULONG64 BytesAcked;
+    ULONG PktsRetrans;
+    ULONG BytesRetrans;
+    ULONG FastRetran;          /* Retransmissions from fast recovery */
+    ULONG Timeouts;            /* Retransmissions from the retransmission timer */
+    ULONG DupAcksIn;
+    ULONG OutOfOrderIn;        /* Segments received ahead of rcv_nxt */
+    ULONG ZeroWindowRcvd;      /* Times the peer closed its window */
+    ULONG SampleRtt;
+    ULONG MinRtt;
+    ULONG MaxRtt;
+    ULONG SumRtt;
+    ULONG CountRtt;
+    ULONG MaxCwnd;
+    ULONG MaxRwinRcvd;
+    ULONG MinRwinRcvd;
+    ULONG MaxRwinSent;
+    ULONG MinRwinSent;
+} TCP_CONNECTION_STATISTICS, *PTCP_CONNECTION_STATISTICS;
+
 typedef struct _CONNECTION_ENDPOINT {
     PVOID SocketContext;        /* Context for lower layer (MUST be first member in struct) */
     LIST_ENTRY ListEntry;       /* Entry on list */
@@ -254,6 +285,16 @@ typedef struct _CONNECTION_ENDPOINT {
     LIST_ENTRY ShutdownRequest;/* Queued shutdown requests */
 
     LIST_ENTRY PacketQueue;    /* Queued received packets waiting to be processed */
+    LIST_ENTRY BacklogQueue;   /* Established connections waiting for a listen request */
+
+    /* Buffering limits */
+    ULONG ReceiveWindowSize;   /* Bytes we queue before we stop opening the window */
+    ULONG ReceiveQueued;       /* Bytes in PacketQueue not read yet */
+    ULONG ReceiveWithheld;     /* Window update held back until the client reads */
+    ULONG ReceiveReserved;     /* Part of lwIP's window we don't advertise */
+    ULONG SendBufferSize;      /* Bytes lwIP may buffer for sending */
+
+    TCP_CONNECTION_STATISTICS Statistics;
 
     /* Disconnect Timer */
     KTIMER DisconnectTimer;
@@ -6,6 +6,9 @@ typedef struct netif* PNETIF;
 void
 sys_shutdown(void);
 
+void
+LibTCPInitializeSubmit(void);
+
 void
 LibIPInsertPacket(void *ifarg,
                   const void *const data,
@@ -34,6 +37,9 @@ LibIPInitialize(void)
 {
     /* This completes asynchronously */
     tcpip_init(NULL, NULL);
+
+    /* lwIP's pools are set up by now */
+    LibTCPInitializeSubmit();
 }
 
 void
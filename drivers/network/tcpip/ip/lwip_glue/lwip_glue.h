@@ -4,14 +4,19 @@
 #include <lwip/tcp.h>
 #include <lwip/pbuf.h>
 #include <lwip/ip_addr.h>
+#include <lwip/tcpip.h>
 #include <tcpip.h>
 
 #ifndef LWIP_TAG
     #define LWIP_TAG         'PIwl'
     #define LWIP_MESSAGE_TAG 'sMwl'
     #define LWIP_QUEUE_TAG   'uQwl'
+    #define LWIP_BACKLOG_TAG 'lBwl'
 #endif
 
+/* Number of size classes in the glue allocator (see memory.c) */
+#define LWIP_POOL_CLASSES 6
+
 typedef struct tcp_pcb* PTCP_PCB;
 
 typedef struct _QUEUE_ENTRY
@@ -21,8 +26,21 @@ typedef struct _QUEUE_ENTRY
     LIST_ENTRY ListEntry;
 } QUEUE_ENTRY, *PQUEUE_ENTRY;
 
+typedef struct _BACKLOG_ENTRY
+{
+    LIST_ENTRY ListEntry;
+    PTCP_PCB pcb;
+    PCONNECTION_ENDPOINT Listener;
+    LIST_ENTRY PacketQueue;
+    BOOLEAN ReceiveShutdown;
+} BACKLOG_ENTRY, *PBACKLOG_ENTRY;
+
 struct lwip_callback_msg
 {
+    /* Submission (see LibTCPSubmit) */
+    SLIST_ENTRY SubmitEntry;
+    tcpip_callback_fn Callback;
+
     /* Synchronization */
     KEVENT Event;
 
@@ -46,7 +64,7 @@ struct lwip_callback_msg
         struct {
             PCONNECTION_ENDPOINT Connection;
             void *Data;
-            u16_t DataLength;
+            ULONG DataLength;
         } Send;
         struct {
             PCONNECTION_ENDPOINT Connection;
@@ -62,6 +80,28 @@ struct lwip_callback_msg
             PCONNECTION_ENDPOINT Connection;
             int Callback;
         } Close;
+        struct {
+            PCONNECTION_ENDPOINT Connection;
+            ULONG Length;
+        } Recved;
+        struct {
+            PCONNECTION_ENDPOINT Listener;
+        } AcceptBacklog;
+        struct {
+            PCONNECTION_ENDPOINT Connection;
+            ULONG Size;
+        } SendBuffer;
+        struct {
+            PCONNECTION_ENDPOINT Connection;
+            ULONG Size;
+        } ReceiveWindow;
+        struct {
+            PCONNECTION_ENDPOINT Connection;
+            struct _TCP_ESTATS_ENTRY *Entry;
+        } Statistics;
+        struct {
+            struct _MIB_TCPSTATS *Stats;
+        } MibStatistics;
     } Input;
 
     /* Output */
@@ -88,6 +128,12 @@ struct lwip_callback_msg
         struct {
             err_t Error;
         } Close;
+        struct {
+            err_t Error;
+        } SendBuffer;
+        struct {
+            err_t Error;
+        } ReceiveWindow;
     } Output;
 };
 
@@ -104,8 +150,8 @@ extern void TCPRecvEventHandler(void *arg);
 PTCP_PCB    LibTCPSocket(void *arg);
 VOID        LibTCPFreeSocket(PTCP_PCB pcb);
 err_t       LibTCPBind(PCONNECTION_ENDPOINT Connection, ip4_addr_t *const ipaddr, const u16_t port);
-PTCP_PCB    LibTCPListen(PCONNECTION_ENDPOINT Connection, const u8_t backlog);
-err_t       LibTCPSend(PCONNECTION_ENDPOINT Connection, void *const dataptr, const u16_t len, ULONG *sent, const int safe);
+PTCP_PCB    LibTCPListen(PCONNECTION_ENDPOINT Connection, const ULONG backlog);
+err_t       LibTCPSend(PCONNECTION_ENDPOINT Connection, void *const dataptr, const ULONG len, ULONG *sent, const int safe);
 err_t       LibTCPConnect(PCONNECTION_ENDPOINT Connection, ip4_addr_t *const ipaddr, const u16_t port);
 err_t       LibTCPShutdown(PCONNECTION_ENDPOINT Connection, const int shut_rx, const int shut_tx);
 err_t       LibTCPClose(PCONNECTION_ENDPOINT Connection, const int safe, const int callback);
@@ -113,8 +159,19 @@ err_t       LibTCPClose(PCONNECTION_ENDPOINT Connection, const int safe, const i
 err_t       LibTCPGetPeerName(PTCP_PCB pcb, ip4_addr_t *const ipaddr, u16_t *const port);
 err_t       LibTCPGetHostName(PTCP_PCB pcb, ip4_addr_t *const ipaddr, u16_t *const port);
 void        LibTCPAccept(PTCP_PCB pcb, struct tcp_pcb *listen_pcb, void *arg);
+void        LibTCPAcceptBacklog(PCONNECTION_ENDPOINT Listener);
+err_t       LibTCPSetSendBufferSize(PCONNECTION_ENDPOINT Connection, const ULONG size);
+err_t       LibTCPSetReceiveWindow(PCONNECTION_ENDPOINT Connection, const ULONG size);
 void        LibTCPSetNoDelay(PTCP_PCB pcb, BOOLEAN Set);
 void        LibTCPGetSocketStatus(PTCP_PCB pcb, PULONG State);
+err_t       LibTCPGetStatistics(PCONNECTION_ENDPOINT Connection, struct _TCP_ESTATS_ENTRY *Entry);
+err_t       LibTCPGetMibStatistics(struct _MIB_TCPSTATS *Stats);
+void        LibTCPInitializeSubmit(void);
+
+/* Memory functions */
+void LibTCPInitializeMemory(void);
+void LibTCPShutdownMemory(void);
+VOID LibTCPQueryPoolStatistics(struct _TCP_POOL_STATISTICS *Statistics);
 
 /* IP functions */
 void LibIPInsertPacket(void *ifarg, const void *const data, const u32_t size);
@@ -1,19 +1,195 @@
 #include <lwip/mem.h>
+#include <lwip/stats.h>
+#include <lwip/sys.h>
+
+#include "lwip_glue.h"
+#include <info.h>
 
 #ifndef LWIP_TAG
     #define LWIP_TAG 'PIwl'
 #endif
 
+/* Every lwIP allocation (pbufs, PCBs, segments...) goes through here, so
+ * small blocks are served from per-processor lookaside lists, one per size
+ * class. Anything bigger than the largest class goes straight to the pool. */
+static const ULONG PoolClassSize[LWIP_POOL_CLASSES] = { 64, 128, 256, 512, 1024, 2048 };
+
+#define LWIP_POOL_LARGE ((USHORT)-1)
+
+typedef union _LWIP_POOL_HEADER
+{
+    struct
+    {
+        USHORT Class;
+        ULONG Size;
+    };
+    UCHAR Alignment[MEMORY_ALLOCATION_ALIGNMENT];
+} LWIP_POOL_HEADER, *PLWIP_POOL_HEADER;
+
+C_ASSERT(LWIP_POOL_CLASSES == TCP_POOL_CLASSES);
+
+static PNPAGED_LOOKASIDE_LIST PoolLists;
+static ULONG PoolProcessors;
+
+#define POOL_LIST(Processor, Class) (&PoolLists[(Processor) * LWIP_POOL_CLASSES + (Class)])
+
+static
+USHORT
+PoolClassFromSize(size_t size)
+{
+    USHORT Class;
+
+    for (Class = 0; Class < LWIP_POOL_CLASSES; Class++)
+    {
+        if (size <= PoolClassSize[Class])
+            return Class;
+    }
+
+    return LWIP_POOL_LARGE;
+}
+
+static
+SIZE_T
+PoolCapacity(PLWIP_POOL_HEADER Header)
+{
+    if (Header->Class == LWIP_POOL_LARGE)
+        return Header->Size;
+
+    return PoolClassSize[Header->Class];
+}
+
+void
+LibTCPInitializeMemory(void)
+{
+    ULONG Processor, Class;
+
+    PoolProcessors = KeNumberProcessors;
+    PoolLists = ExAllocatePoolWithTag(NonPagedPool,
+                                      PoolProcessors * LWIP_POOL_CLASSES * sizeof(NPAGED_LOOKASIDE_LIST),
+                                      LWIP_TAG);
+    if (!PoolLists)
+    {
+        /* Everything will come from the pool directly */
+        DbgPrint("lwIP: no memory for the lookaside lists\n");
+        return;
+    }
+
+    for (Processor = 0; Processor < PoolProcessors; Processor++)
+    {
+        for (Class = 0; Class < LWIP_POOL_CLASSES; Class++)
+        {
+            ExInitializeNPagedLookasideList(POOL_LIST(Processor, Class),
+                                            NULL,
+                                            NULL,
+                                            0,
+                                            sizeof(LWIP_POOL_HEADER) + PoolClassSize[Class],
+                                            LWIP_TAG,
+                                            0);
+        }
+    }
+}
+
+void
+LibTCPShutdownMemory(void)
+{
+    ULONG Processor, Class;
+
+    /* This runs once the tcpip thread and every other user of lwIP is gone,
+     * so nobody can be using the lists anymore. Blocks freed from now on are
+     * given back to the pool (see free()) */
+    if (!PoolLists)
+        return;
+
+    for (Processor = 0; Processor < PoolProcessors; Processor++)
+    {
+        for (Class = 0; Class < LWIP_POOL_CLASSES; Class++)
+            ExDeleteNPagedLookasideList(POOL_LIST(Processor, Class));
+    }
+
+    ExFreePoolWithTag(PoolLists, LWIP_TAG);
+    PoolLists = NULL;
+}
+
+VOID
+LibTCPQueryPoolStatistics(PTCP_POOL_STATISTICS Statistics)
+{
+    PGENERAL_LOOKASIDE List;
+    ULONG Processor, Class;
+    SYS_ARCH_DECL_PROTECT(OldLevel);
+
+    RtlZeroMemory(Statistics, sizeof(*Statistics));
+
+#if MEM_STATS
+    /* lwIP keeps count of everything it allocates, whatever the size */
+    SYS_ARCH_PROTECT(OldLevel);
+    Statistics->HeapInUse = (ULONG)STATS_GET(mem.used);
+    Statistics->HeapMaxInUse = (ULONG)STATS_GET(mem.max);
+    Statistics->HeapFailures = (ULONG)STATS_GET(mem.err);
+    SYS_ARCH_UNPROTECT(OldLevel);
+#endif
+
+    for (Class = 0; Class < LWIP_POOL_CLASSES; Class++)
+        Statistics->Classes[Class].BlockSize = PoolClassSize[Class];
+
+    if (!PoolLists)
+        return;
+
+    for (Class = 0; Class < LWIP_POOL_CLASSES; Class++)
+    {
+        for (Processor = 0; Processor < PoolProcessors; Processor++)
+        {
+            List = &POOL_LIST(Processor, Class)->L;
+
+            Statistics->Classes[Class].Allocations += List->TotalAllocates;
+            Statistics->Classes[Class].AllocationMisses += List->AllocateMisses;
+            Statistics->Classes[Class].Frees += List->TotalFrees;
+            Statistics->Classes[Class].FreeMisses += List->FreeMisses;
+        }
+
+        /* Blocks are freed to the list of whatever processor frees them */
+        Statistics->Classes[Class].InUse = Statistics->Classes[Class].Allocations -
+                                           Statistics->Classes[Class].Frees;
+    }
+}
+
 void *
 malloc(mem_size_t size)
 {
-    return ExAllocatePoolWithTag(NonPagedPool, size, LWIP_TAG);
+    PLWIP_POOL_HEADER Header;
+    USHORT Class;
+
+    Class = PoolClassFromSize(size);
+
+    if (Class != LWIP_POOL_LARGE && PoolLists)
+    {
+        Header = ExAllocateFromNPagedLookasideList(POOL_LIST(KeGetCurrentProcessorNumber() % PoolProcessors,
+                                                             Class));
+    }
+    else
+    {
+        Class = LWIP_POOL_LARGE;
+        Header = ExAllocatePoolWithTag(NonPagedPool, sizeof(*Header) + size, LWIP_TAG);
+    }
+
+    /* Failures are counted by lwIP (MEM_STATS) */
+    if (!Header)
+        return NULL;
+
+    Header->Class = Class;
+    Header->Size = size;
+
+    return Header + 1;
 }
 
 void *
 calloc(mem_size_t count, mem_size_t size)
 {
-    void *mem = malloc(count * size);
+    void *mem;
+
+    /* Don't let the multiplication wrap around */
+    if (size && count > ((mem_size_t)-1) / size) return NULL;
+
+    mem = malloc(count * size);
 
     if (!mem) return NULL;
 
@@ -25,13 +201,27 @@ calloc(mem_size_t count, mem_size_t size)
 void
 free(void *mem)
 {
-    ExFreePoolWithTag(mem, LWIP_TAG);
+    PLWIP_POOL_HEADER Header = (PLWIP_POOL_HEADER)mem - 1;
+
+    /* Lookaside entries come from the pool with our tag, so they can
+     * still be released after the lists are gone */
+    if (Header->Class != LWIP_POOL_LARGE && PoolLists)
+    {
+        ExFreeToNPagedLookasideList(POOL_LIST(KeGetCurrentProcessorNumber() % PoolProcessors,
+                                              Header->Class),
+                                    Header);
+    }
+    else
+    {
+        ExFreePoolWithTag(Header, LWIP_TAG);
+    }
 }
 
 /* This is only used to trim in lwIP */
 void *
 realloc(void *mem, size_t size)
 {
+    PLWIP_POOL_HEADER Header;
     void* new_mem;
 
     /* realloc() with a NULL mem pointer acts like a call to malloc() */
@@ -45,6 +235,13 @@ realloc(void *mem, size_t size)
         return NULL;
     }
 
+    /* Trimming (the common case) never needs to move the block */
+    Header = (PLWIP_POOL_HEADER)mem - 1;
+    if (size <= PoolCapacity(Header)) {
+        Header->Size = size;
+        return mem;
+    }
+
     /* Allocate the new buffer first */
     new_mem = malloc(size);
     if (new_mem == NULL) {
@@ -53,7 +250,7 @@ realloc(void *mem, size_t size)
     }
 
     /* Copy the data over */
-    RtlCopyMemory(new_mem, mem, size);
+    RtlCopyMemory(new_mem, mem, Header->Size);
 
     /* Deallocate the old buffer */
     free(mem);
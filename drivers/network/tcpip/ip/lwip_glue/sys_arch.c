@@ -1,5 +1,6 @@
 #include <debug.h>
 #include <lwip/sys.h>
+#include <lwip/tcpip.h>
 
 #include "lwip_glue.h"
 
@@ -10,6 +11,11 @@ KEVENT TerminationEvent;
 NPAGED_LOOKASIDE_LIST MessageLookasideList;
 NPAGED_LOOKASIDE_LIST QueueEntryLookasideList;
 
+/* Requests waiting for the tcpip thread */
+SLIST_HEADER SubmitList;
+LONG SubmitScheduled;
+struct tcpip_callback_msg *SubmitMessage;
+
 static LARGE_INTEGER StartTime;
 
 typedef struct _thread_t
@@ -309,8 +315,14 @@ sys_init(void)
 
     KeQuerySystemTime(&StartTime);
 
+    LibTCPInitializeMemory();
+
     KeInitializeEvent(&TerminationEvent, NotificationEvent, FALSE);
 
+    InitializeSListHead(&SubmitList);
+    SubmitScheduled = FALSE;
+    SubmitMessage = NULL;
+
     ExInitializeNPagedLookasideList(&MessageLookasideList,
                                     NULL,
                                     NULL,
@@ -354,6 +366,15 @@ sys_shutdown(void)
         }
     }
 
+    /* The tcpip thread is gone, nobody can be holding the drain message anymore */
+    if (SubmitMessage)
+    {
+        tcpip_callbackmsg_delete(SubmitMessage);
+        SubmitMessage = NULL;
+    }
+
+    LibTCPShutdownMemory();
+
     ExDeleteNPagedLookasideList(&MessageLookasideList);
     ExDeleteNPagedLookasideList(&QueueEntryLookasideList);
 }
@@ -1,7 +1,10 @@
 #include <debug.h>
 #include <lwip/tcpip.h>
+#include <lwip/stats.h>
+#include <lwip/priv/tcp_priv.h>
 
 #include "lwip_glue.h"
+#include <info.h>
 
 static const char * const tcp_state_str[] = {
   "CLOSED",
@@ -21,13 +24,18 @@ static const char * const tcp_state_str[] = {
  * we best go along with it unless we want another unstable TCP library. lwIP uses
  * a thread called the "tcpip thread" which is the only one allowed to call raw API
  * functions. Since this is the case, for each of our LibTCP* functions, we queue a request
- * for a callback to "tcpip thread" which calls our LibTCP*Callback functions. Yes, this is
- * a lot of unnecessary thread swapping and it could definitely be faster, but I don't want
- * to going messing around in lwIP because I have no desire to create another mess like oskittcp */
+ * for a callback to "tcpip thread" which calls our LibTCP*Callback functions.
+ * To keep the thread swapping down, requests are pushed on a lock-free list and the
+ * tcpip thread is only woken up once to run everything that piled up in the meantime
+ * (see LibTCPSubmit). I don't want to going messing around in lwIP because I have
+ * no desire to create another mess like oskittcp */
 
 extern KEVENT TerminationEvent;
 extern NPAGED_LOOKASIDE_LIST MessageLookasideList;
 extern NPAGED_LOOKASIDE_LIST QueueEntryLookasideList;
+extern SLIST_HEADER SubmitList;
+extern LONG SubmitScheduled;
+extern struct tcpip_callback_msg *SubmitMessage;
 
 /* Required for ERR_T to NTSTATUS translation in receive error handling */
 NTSTATUS TCPTranslateError(const err_t err);
@@ -47,6 +55,135 @@ LibTCPDumpPcb(PVOID SocketContext)
     pcb->remote_port);
 }
 
+static
+void
+LibTCPDrainRequests(void *arg)
+{
+    PSLIST_ENTRY Entry, Next, Ordered = NULL;
+    struct lwip_callback_msg *msg;
+
+    /* Clear the flag first, anything pushed from now on schedules another drain */
+    InterlockedExchange(&SubmitScheduled, FALSE);
+
+    Entry = InterlockedFlushSList(&SubmitList);
+
+    /* The list is LIFO, put the requests back in submission order */
+    while (Entry)
+    {
+        Next = Entry->Next;
+        Entry->Next = Ordered;
+        Ordered = Entry;
+        Entry = Next;
+    }
+
+    while (Ordered)
+    {
+        msg = CONTAINING_RECORD(Ordered, struct lwip_callback_msg, SubmitEntry);
+
+        /* The callback may free the message */
+        Ordered = Ordered->Next;
+
+        msg->Callback(msg);
+    }
+}
+
+/* Wakes up the tcpip thread to drain the submission list */
+static
+err_t
+LibTCPScheduleDrain(void)
+{
+    /* The drain message is only ever posted once at a time, SubmitScheduled guards it */
+    if (SubmitMessage)
+        return tcpip_callbackmsg_trycallback(SubmitMessage);
+
+    return tcpip_callback(LibTCPDrainRequests, NULL);
+}
+
+/* Takes a request back off the submission list. Returns FALSE if a drain got it first. */
+static
+BOOLEAN
+LibTCPWithdrawRequest(struct lwip_callback_msg *msg)
+{
+    PSLIST_ENTRY Entry, Next, Ordered = NULL;
+    BOOLEAN Found = FALSE;
+
+    Entry = InterlockedFlushSList(&SubmitList);
+
+    /* The list is LIFO, so reverse it while dropping our request */
+    while (Entry)
+    {
+        Next = Entry->Next;
+        if (Entry == &msg->SubmitEntry)
+        {
+            Found = TRUE;
+        }
+        else
+        {
+            Entry->Next = Ordered;
+            Ordered = Entry;
+        }
+        Entry = Next;
+    }
+
+    /* Push the other requests back oldest first so they keep their order */
+    while (Ordered)
+    {
+        Next = Ordered->Next;
+        InterlockedPushEntrySList(&SubmitList, Ordered);
+        Ordered = Next;
+    }
+
+    return Found;
+}
+
+/* Queues a request for the tcpip thread. This never waits for it to run.
+ * On failure the request is not queued and the caller still owns the message. */
+static
+err_t
+LibTCPSubmit(tcpip_callback_fn Callback, struct lwip_callback_msg *msg)
+{
+    msg->Callback = Callback;
+
+    InterlockedPushEntrySList(&SubmitList, &msg->SubmitEntry);
+
+    /* Only wake up the tcpip thread if no drain is pending already */
+    if (InterlockedExchange(&SubmitScheduled, TRUE))
+        return ERR_OK;
+
+    if (LibTCPScheduleDrain() == ERR_OK)
+        return ERR_OK;
+
+    /* Nobody will run the list, so our request must not stay on it */
+    if (!LibTCPWithdrawRequest(msg))
+    {
+        /* A drain that was still running picked it up already */
+        InterlockedExchange(&SubmitScheduled, FALSE);
+        return ERR_OK;
+    }
+
+    InterlockedExchange(&SubmitScheduled, FALSE);
+
+    /* Requests of other threads may still be queued behind a failed wakeup */
+    if (QueryDepthSList(&SubmitList) != 0 &&
+        !InterlockedExchange(&SubmitScheduled, TRUE) &&
+        LibTCPScheduleDrain() != ERR_OK)
+    {
+        InterlockedExchange(&SubmitScheduled, FALSE);
+        DbgPrint("LibTCPSubmit: Unable to wake up the tcpip thread\n");
+    }
+
+    return ERR_MEM;
+}
+
+void
+LibTCPInitializeSubmit(void)
+{
+    /* Preallocate the drain message so scheduling a drain cannot run out of memory */
+    SubmitMessage = tcpip_callbackmsg_new(LibTCPDrainRequests, NULL);
+    if (!SubmitMessage)
+        DbgPrint("LibTCPInitializeSubmit: No drain message, falling back to tcpip_callback\n");
+}
+
 static
 void
 LibTCPEmptyQueue(PCONNECTION_ENDPOINT Connection)
@@ -67,20 +204,172 @@ LibTCPEmptyQueue(PCONNECTION_ENDPOINT Connection)
         ExFreeToNPagedLookasideList(&QueueEntryLookasideList, qp);
     }
 
+    Connection->ReceiveQueued = 0;
+    Connection->ReceiveWithheld = 0;
+
     DereferenceObject(Connection);
 }
 
-void LibTCPEnqueuePacket(PCONNECTION_ENDPOINT Connection, struct pbuf *p)
+static
+void
+LibTCPFreeBacklogEntry(PBACKLOG_ENTRY Entry)
 {
+    PLIST_ENTRY ListEntry;
     PQUEUE_ENTRY qp;
 
+    while (!IsListEmpty(&Entry->PacketQueue))
+    {
+        ListEntry = RemoveHeadList(&Entry->PacketQueue);
+        qp = CONTAINING_RECORD(ListEntry, QUEUE_ENTRY, ListEntry);
+
+        /* We're in the tcpip thread here so this is safe */
+        pbuf_free(qp->p);
+
+        ExFreeToNPagedLookasideList(&QueueEntryLookasideList, qp);
+    }
+
+    DereferenceObject(Entry->Listener);
+
+    ExFreePoolWithTag(Entry, LWIP_BACKLOG_TAG);
+}
+
+static
+void
+LibTCPEmptyBacklog(PCONNECTION_ENDPOINT Listener)
+{
+    PLIST_ENTRY ListEntry;
+    PBACKLOG_ENTRY Entry;
+
+    while (!IsListEmpty(&Listener->BacklogQueue))
+    {
+        ListEntry = RemoveHeadList(&Listener->BacklogQueue);
+        Entry = CONTAINING_RECORD(ListEntry, BACKLOG_ENTRY, ListEntry);
+
+        /* Nobody is ever going to accept these */
+        tcp_arg(Entry->pcb, NULL);
+        tcp_abort(Entry->pcb);
+
+        LibTCPFreeBacklogEntry(Entry);
+    }
+}
+
+/* Returns the number of bytes we can give back to the receive window right away */
+static
+u16_t
+LibTCPEnqueuePacket(PCONNECTION_ENDPOINT Connection, struct pbuf *p)
+{
+    PQUEUE_ENTRY qp;
+    u16_t Credit;
+
     qp = (PQUEUE_ENTRY)ExAllocateFromNPagedLookasideList(&QueueEntryLookasideList);
     qp->p = p;
     qp->Offset = 0;
 
     LockObject(Connection);
     InsertTailList(&Connection->PacketQueue, &qp->ListEntry);
+
+    Connection->ReceiveQueued += p->tot_len;
+    if (Connection->ReceiveQueued > Connection->ReceiveWindowSize)
+    {
+        /* The client isn't keeping up, so let the window close until it reads */
+        Connection->ReceiveWithheld += p->tot_len;
+        Credit = 0;
+    }
+    else
+    {
+        Credit = p->tot_len;
+    }
     UnlockObject(Connection);
+
+    return Credit;
+}
+
+/* lwIP opens the window up to TCP_WND. Keep back the part the client didn't
+ * ask for with SO_RCVBUF out of the updates we give it, and let tcp_recved
+ * announce the rest. */
+static
+void
+LibTCPOpenWindow(PCONNECTION_ENDPOINT Connection, PTCP_PCB pcb, ULONG Credit)
+{
+    ULONG Target, Taken;
+    u16_t Chunk;
+
+    /* The full window is only known once the handshake settled on scaling */
+    if (pcb->state >= ESTABLISHED)
+    {
+        Target = TCP_WND_MAX(pcb) - MIN(Connection->ReceiveWindowSize, TCP_WND_MAX(pcb));
+        if (Target >= Connection->ReceiveReserved)
+        {
+            /* lwIP never takes back what it already announced, so the window
+             * closes down to the requested size as the data comes in */
+            Taken = MIN(Target - Connection->ReceiveReserved, Credit);
+            Connection->ReceiveReserved += Taken;
+            Credit -= Taken;
+        }
+        else
+        {
+            /* The window grew, give back what we kept */
+            Credit += Connection->ReceiveReserved - Target;
+            Connection->ReceiveReserved = Target;
+        }
+    }
+
+    while (Credit != 0)
+    {
+        Chunk = (u16_t)MIN(Credit, 0xFFFF);
+        tcp_recved(pcb, Chunk);
+        Credit -= Chunk;
+    }
+}
+
+static
+void
+LibTCPRecvedCallback(void *arg)
+{
+    struct lwip_callback_msg *msg = arg;
+    PCONNECTION_ENDPOINT Connection = msg->Input.Recved.Connection;
+
+    /* The PCB may have gone away since the data was read */
+    if (Connection->SocketContext)
+        LibTCPOpenWindow(Connection, Connection->SocketContext, msg->Input.Recved.Length);
+
+    DereferenceObject(Connection);
+
+    ExFreeToNPagedLookasideList(&MessageLookasideList, msg);
+}
+
+/* Reopens the receive window once the client has read data we withheld it for.
+ * This doesn't wait for the tcpip thread, so it's usable from any context. */
+static
+void
+LibTCPRecved(PCONNECTION_ENDPOINT Connection, const ULONG len)
+{
+    struct lwip_callback_msg *msg;
+
+    msg = ExAllocateFromNPagedLookasideList(&MessageLookasideList);
+    if (!msg)
+    {
+        /* Put it back, the next read will try again */
+        LockObject(Connection);
+        Connection->ReceiveWithheld += len;
+        UnlockObject(Connection);
+        return;
+    }
+
+    ReferenceObject(Connection);
+    msg->Input.Recved.Connection = Connection;
+    msg->Input.Recved.Length = len;
+
+    if (LibTCPSubmit(LibTCPRecvedCallback, msg) != ERR_OK)
+    {
+        /* Same as above, the window stays closed until the next read */
+        LockObject(Connection);
+        Connection->ReceiveWithheld += len;
+        UnlockObject(Connection);
+
+        DereferenceObject(Connection);
+        ExFreeToNPagedLookasideList(&MessageLookasideList, msg);
+    }
 }
 
 PQUEUE_ENTRY LibTCPDequeuePacket(PCONNECTION_ENDPOINT Connection)
@@ -103,6 +392,7 @@ NTSTATUS LibTCPGetDataFromConnectionQueue(PCONNECTION_ENDPOINT Connection, PUCHA
     struct pbuf* p;
     NTSTATUS Status;
     UINT ReadLength, PayloadLength, Offset, Copied;
+    ULONG Credit = 0;
 
     (*Received) = 0;
 
@@ -157,6 +447,15 @@ NTSTATUS LibTCPGetDataFromConnectionQueue(PCONNECTION_ENDPOINT Connection, PUCHA
             if (!RecvLen)
                 break;
         }
+
+        Connection->ReceiveQueued -= (*Received);
+        if (Connection->ReceiveWithheld != 0 &&
+            Connection->ReceiveQueued <= Connection->ReceiveWindowSize)
+        {
+            /* There's room again, reopen the window */
+            Credit = Connection->ReceiveWithheld;
+            Connection->ReceiveWithheld = 0;
+        }
     }
     else
     {
@@ -168,6 +467,9 @@ NTSTATUS LibTCPGetDataFromConnectionQueue(PCONNECTION_ENDPOINT Connection, PUCHA
 
     UnlockObject(Connection);
 
+    if (Credit != 0)
+        LibTCPRecved(Connection, Credit);
+
     return Status;
 }
 
@@ -225,9 +527,7 @@ InternalRecvEventHandler(void *arg, PTCP_PCB pcb, struct pbuf *p, const err_t er
 
     if (p)
     {
-        LibTCPEnqueuePacket(Connection, p);
-
-        tcp_recved(pcb, p->tot_len);
+        LibTCPOpenWindow(Connection, pcb, LibTCPEnqueuePacket(Connection, p));
 
         TCPRecvEventHandler(arg);
     }
@@ -260,6 +560,84 @@ InternalRecvEventHandler(void *arg, PTCP_PCB pcb, struct pbuf *p, const err_t er
     return ERR_OK;
 }
 
+static
+err_t
+InternalBacklogRecvEventHandler(void *arg, PTCP_PCB pcb, struct pbuf *p, const err_t err)
+{
+    PBACKLOG_ENTRY Entry = arg;
+    PQUEUE_ENTRY qp;
+
+    if (!arg)
+    {
+        if (p)
+            pbuf_free(p);
+
+        return ERR_OK;
+    }
+
+    if (p)
+    {
+        /* Hold on to the data until a listen request picks this connection up.
+         * We don't call tcp_recved() here, so the window closes if that takes long. */
+        qp = (PQUEUE_ENTRY)ExAllocateFromNPagedLookasideList(&QueueEntryLookasideList);
+        if (!qp)
+            return ERR_MEM;
+
+        qp->p = p;
+        qp->Offset = 0;
+        InsertTailList(&Entry->PacketQueue, &qp->ListEntry);
+    }
+    else if (err == ERR_OK)
+    {
+        /* The peer closed before we accepted, replay that on accept */
+        Entry->ReceiveShutdown = TRUE;
+    }
+
+    return ERR_OK;
+}
+
+static
+void
+InternalBacklogErrorEventHandler(void *arg, const err_t err)
+{
+    PBACKLOG_ENTRY Entry = arg;
+
+    if (!arg)
+        return;
+
+    /* The PCB is dead now, drop it from the backlog */
+    RemoveEntryList(&Entry->ListEntry);
+    LibTCPFreeBacklogEntry(Entry);
+}
+
+/* Parks an established connection until a listen request for it is queued */
+static
+err_t
+LibTCPEnqueueBacklog(PCONNECTION_ENDPOINT Listener, PTCP_PCB newpcb)
+{
+    PBACKLOG_ENTRY Entry;
+
+    Entry = ExAllocatePoolWithTag(NonPagedPool, sizeof(*Entry), LWIP_BACKLOG_TAG);
+    if (!Entry)
+        return ERR_MEM;
+
+    ReferenceObject(Listener);
+    Entry->Listener = Listener;
+    Entry->pcb = newpcb;
+    Entry->ReceiveShutdown = FALSE;
+    InitializeListHead(&Entry->PacketQueue);
+    InsertTailList(&Listener->BacklogQueue, &Entry->ListEntry);
+
+    /* Keep counting it against the listen backlog until it's accepted */
+    tcp_backlog_delayed(newpcb);
+
+    tcp_recv(newpcb, InternalBacklogRecvEventHandler);
+    tcp_err(newpcb, InternalBacklogErrorEventHandler);
+    tcp_arg(newpcb, Entry);
+
+    return ERR_OK;
+}
+
 /* This function MUST return an error value that is not ERR_ABRT or ERR_OK if the connection
  * is not accepted to avoid leaking the new PCB */
 static
@@ -270,13 +648,22 @@ InternalAcceptEventHandler(void *arg, PTCP_PCB newpcb, const err_t err)
     if (!arg)
         return ERR_CLSD;
 
+    /* lwIP failed to allocate a PCB for the connection request */
+    if (!newpcb || err != ERR_OK)
+        return ERR_VAL;
+
+    /* The new PCB inherited the listener's argument, clear it so we can tell
+     * whether TCPAcceptEventHandler handed it to a connection */
+    tcp_arg(newpcb, NULL);
+
     TCPAcceptEventHandler(arg, newpcb);
 
     /* Set in LibTCPAccept (called from TCPAcceptEventHandler) */
     if (newpcb->callback_arg)
         return ERR_OK;
-    else
-        return ERR_CLSD;
+
+    /* No listen request is pending yet, queue it in the backlog */
+    return LibTCPEnqueueBacklog(arg, newpcb);
 }
 
 static
@@ -325,6 +712,10 @@ LibTCPSocketCallback(void *arg)
 
     if (msg->Output.Socket.NewPcb)
     {
+        PCONNECTION_ENDPOINT Connection = msg->Input.Socket.Arg;
+
+        msg->Output.Socket.NewPcb->snd_buf = Connection->SendBufferSize;
+
         tcp_arg(msg->Output.Socket.NewPcb, msg->Input.Socket.Arg);
         tcp_err(msg->Output.Socket.NewPcb, InternalErrorEventHandler);
     }
@@ -343,9 +734,9 @@ LibTCPSocket(void *arg)
         KeInitializeEvent(&msg->Event, NotificationEvent, FALSE);
         msg->Input.Socket.Arg = arg;
 
-        tcpip_callback_with_block(LibTCPSocketCallback, msg, 1);
-
-        if (WaitForEventSafely(&msg->Event))
+        if (LibTCPSubmit(LibTCPSocketCallback, msg) != ERR_OK)
+            ret = NULL;
+        else if (WaitForEventSafely(&msg->Event))
             ret = msg->Output.Socket.NewPcb;
         else
             ret = NULL;
@@ -379,7 +770,11 @@ void LibTCPFreeSocket(PTCP_PCB pcb)
     KeInitializeEvent(&msg.Event, NotificationEvent, FALSE);
     msg.Input.FreeSocket.pcb = pcb;
 
-    tcpip_callback_with_block(LibTCPFreeSocketCallback, &msg, 1);
+    if (LibTCPSubmit(LibTCPFreeSocketCallback, &msg) != ERR_OK)
+    {
+        DbgPrint("LibTCPFreeSocket: Unable to queue the close, leaking PCB %p\n", pcb);
+        return;
+    }
 
     WaitForEventSafely(&msg.Event);
 }
@@ -425,9 +820,9 @@ LibTCPBind(PCONNECTION_ENDPOINT Connection, ip4_addr_t *const ipaddr, const u16_
         msg->Input.Bind.IpAddress = ipaddr;
         msg->Input.Bind.Port = port;
 
-        tcpip_callback_with_block(LibTCPBindCallback, msg, 1);
-
-        if (WaitForEventSafely(&msg->Event))
+        if (LibTCPSubmit(LibTCPBindCallback, msg) != ERR_OK)
+            ret = ERR_MEM;
+        else if (WaitForEventSafely(&msg->Event))
             ret = msg->Output.Bind.Error;
         else
             ret = ERR_CLSD;
@@ -466,7 +861,7 @@ done:
 }
 
 PTCP_PCB
-LibTCPListen(PCONNECTION_ENDPOINT Connection, const u8_t backlog)
+LibTCPListen(PCONNECTION_ENDPOINT Connection, const ULONG backlog)
 {
     struct lwip_callback_msg *msg;
     PTCP_PCB ret;
@@ -476,11 +871,12 @@ LibTCPListen(PCONNECTION_ENDPOINT Connection, const u8_t backlog)
     {
         KeInitializeEvent(&msg->Event, NotificationEvent, FALSE);
         msg->Input.Listen.Connection = Connection;
-        msg->Input.Listen.Backlog = backlog;
+        /* lwIP keeps the backlog in a u8_t, don't let it wrap around */
+        msg->Input.Listen.Backlog = (u8_t)MAX(MIN(backlog, TCP_DEFAULT_LISTEN_BACKLOG), 1);
 
-        tcpip_callback_with_block(LibTCPListenCallback, msg, 1);
-
-        if (WaitForEventSafely(&msg->Event))
+        if (LibTCPSubmit(LibTCPListenCallback, msg) != ERR_OK)
+            ret = NULL;
+        else if (WaitForEventSafely(&msg->Event))
             ret = msg->Output.Listen.NewPcb;
         else
             ret = NULL;
@@ -499,8 +895,10 @@ LibTCPSendCallback(void *arg)
 {
     struct lwip_callback_msg *msg = arg;
     PTCP_PCB pcb = msg->Input.Send.Connection->SocketContext;
-    ULONG SendLength;
+    ULONG SendLength, Offset;
+    u16_t Chunk;
     UCHAR SendFlags;
+    err_t Error = ERR_OK;
 
     ASSERT(msg);
 
@@ -516,7 +914,6 @@ LibTCPSendCallback(void *arg)
         goto done;
     }
 
-    SendFlags = TCP_WRITE_FLAG_COPY;
     SendLength = msg->Input.Send.DataLength;
     if (tcp_sndbuf(pcb) == 0)
     {
@@ -528,33 +925,51 @@ LibTCPSendCallback(void *arg)
     {
         /* We've got some room so let's send what we can */
         SendLength = tcp_sndbuf(pcb);
+    }
+
+    /* tcp_write() takes at most 64k at once, so queue the whole send
+     * here instead of making the caller come back for each piece */
+    for (Offset = 0; Offset < SendLength; Offset += Chunk)
+    {
+        Chunk = (u16_t)MIN(SendLength - Offset, 0xFFFF);
 
-        /* Don't set the push flag */
-        SendFlags |= TCP_WRITE_FLAG_MORE;
+        SendFlags = TCP_WRITE_FLAG_COPY;
+
+        /* Don't set the push flag unless this is the end of the data */
+        if (Offset + Chunk < msg->Input.Send.DataLength)
+            SendFlags |= TCP_WRITE_FLAG_MORE;
+
+        Error = tcp_write(pcb,
+                          (PUCHAR)msg->Input.Send.Data + Offset,
+                          Chunk,
+                          SendFlags);
+        if (Error != ERR_OK)
+            break;
     }
 
-    msg->Output.Send.Error = tcp_write(pcb,
-                                       msg->Input.Send.Data,
-                                       SendLength,
-                                       SendFlags);
-    if (msg->Output.Send.Error == ERR_OK)
+    if (Offset != 0)
     {
         /* Queued successfully so try to send it */
-        tcp_output((PTCP_PCB)msg->Input.Send.Connection->SocketContext);
-        msg->Output.Send.Information = SendLength;
+        tcp_output(pcb);
+        msg->Output.Send.Error = ERR_OK;
+        msg->Output.Send.Information = Offset;
     }
-    else if (msg->Output.Send.Error == ERR_MEM)
+    else if (Error == ERR_MEM)
     {
         /* The queue is too long */
         msg->Output.Send.Error = ERR_INPROGRESS;
     }
+    else
+    {
+        msg->Output.Send.Error = Error;
+    }
 
 done:
     KeSetEvent(&msg->Event, IO_NO_INCREMENT, FALSE);
 }
 
 err_t
-LibTCPSend(PCONNECTION_ENDPOINT Connection, void *const dataptr, const u16_t len, ULONG *sent, const int safe)
+LibTCPSend(PCONNECTION_ENDPOINT Connection, void *const dataptr, const ULONG len, ULONG *sent, const int safe)
 {
     err_t ret;
     struct lwip_callback_msg *msg;
@@ -568,11 +983,13 @@ LibTCPSend(PCONNECTION_ENDPOINT Connection, void *const dataptr, const u16_t len
         msg->Input.Send.DataLength = len;
 
         if (safe)
+        {
             LibTCPSendCallback(msg);
-        else
-            tcpip_callback_with_block(LibTCPSendCallback, msg, 1);
-
-        if (WaitForEventSafely(&msg->Event))
+            ret = msg->Output.Send.Error;
+        }
+        else if (LibTCPSubmit(LibTCPSendCallback, msg) != ERR_OK)
+            ret = ERR_MEM;
+        else if (WaitForEventSafely(&msg->Event))
             ret = msg->Output.Send.Error;
         else
             ret = ERR_CLSD;
@@ -608,6 +1025,10 @@ LibTCPConnectCallback(void *arg)
     tcp_recv((PTCP_PCB)msg->Input.Connect.Connection->SocketContext, InternalRecvEventHandler);
     tcp_sent((PTCP_PCB)msg->Input.Connect.Connection->SocketContext, InternalSendEventHandler);
 
+    /* Nothing was written on this PCB yet */
+    ((PTCP_PCB)msg->Input.Connect.Connection->SocketContext)->snd_buf =
+        msg->Input.Connect.Connection->SendBufferSize;
+
     Error = tcp_connect((PTCP_PCB)msg->Input.Connect.Connection->SocketContext,
                         msg->Input.Connect.IpAddress, lwip_ntohs(msg->Input.Connect.Port),
                         InternalConnectEventHandler);
@@ -632,9 +1053,9 @@ LibTCPConnect(PCONNECTION_ENDPOINT Connection, ip_addr_t *const ipaddr, const u1
         msg->Input.Connect.IpAddress = ipaddr;
         msg->Input.Connect.Port = port;
 
-        tcpip_callback_with_block(LibTCPConnectCallback, msg, 1);
-
-        if (WaitForEventSafely(&msg->Event))
+        if (LibTCPSubmit(LibTCPConnectCallback, msg) != ERR_OK)
+            ret = ERR_MEM;
+        else if (WaitForEventSafely(&msg->Event))
         {
             ret = msg->Output.Connect.Error;
         }
@@ -728,9 +1149,9 @@ LibTCPShutdown(PCONNECTION_ENDPOINT Connection, const int shut_rx, const int shu
         msg->Input.Shutdown.shut_rx = shut_rx;
         msg->Input.Shutdown.shut_tx = shut_tx;
 
-        tcpip_callback_with_block(LibTCPShutdownCallback, msg, 1);
-
-        if (WaitForEventSafely(&msg->Event))
+        if (LibTCPSubmit(LibTCPShutdownCallback, msg) != ERR_OK)
+            ret = ERR_MEM;
+        else if (WaitForEventSafely(&msg->Event))
             ret = msg->Output.Shutdown.Error;
         else
             ret = ERR_CLSD;
@@ -753,6 +1174,9 @@ LibTCPCloseCallback(void *arg)
     /* Empty the queue even if we're already "closed" */
     LibTCPEmptyQueue(msg->Input.Close.Connection);
 
+    /* Reset connections that were never accepted */
+    LibTCPEmptyBacklog(msg->Input.Close.Connection);
+
     /* Check if we've already been closed */
     if (msg->Input.Close.Connection->Closing)
     {
@@ -809,11 +1233,13 @@ LibTCPClose(PCONNECTION_ENDPOINT Connection, const int safe, const int callback)
         msg->Input.Close.Callback = callback;
 
         if (safe)
+        {
             LibTCPCloseCallback(msg);
-        else
-            tcpip_callback_with_block(LibTCPCloseCallback, msg, 1);
-
-        if (WaitForEventSafely(&msg->Event))
+            ret = msg->Output.Close.Error;
+        }
+        else if (LibTCPSubmit(LibTCPCloseCallback, msg) != ERR_OK)
+            ret = ERR_MEM;
+        else if (WaitForEventSafely(&msg->Event))
             ret = msg->Output.Close.Error;
         else
             ret = ERR_CLSD;
@@ -829,6 +1255,8 @@ LibTCPClose(PCONNECTION_ENDPOINT Connection, const int safe, const int callback)
 void
 LibTCPAccept(PTCP_PCB pcb, struct tcp_pcb *listen_pcb, void *arg)
 {
+    PCONNECTION_ENDPOINT Connection = arg;
+
     ASSERT(arg);
 
     tcp_arg(pcb, NULL);
@@ -837,9 +1265,200 @@ LibTCPAccept(PTCP_PCB pcb, struct tcp_pcb *listen_pcb, void *arg)
     tcp_err(pcb, InternalErrorEventHandler);
     tcp_arg(pcb, arg);
 
+    /* Nothing was written on this PCB yet */
+    pcb->snd_buf = Connection->SendBufferSize;
+
     tcp_accepted(listen_pcb);
 }
 
+static
+void
+LibTCPAcceptBacklogCallback(void *arg)
+{
+    struct lwip_callback_msg *msg = arg;
+    PCONNECTION_ENDPOINT Listener = msg->Input.AcceptBacklog.Listener;
+    PBACKLOG_ENTRY Entry;
+    PQUEUE_ENTRY qp;
+    PLIST_ENTRY ListEntry;
+    PTCP_PCB pcb;
+
+    while (Listener->SocketContext && !IsListEmpty(&Listener->BacklogQueue))
+    {
+        Entry = CONTAINING_RECORD(Listener->BacklogQueue.Flink, BACKLOG_ENTRY, ListEntry);
+        pcb = Entry->pcb;
+
+        tcp_arg(pcb, NULL);
+
+        TCPAcceptEventHandler(Listener, pcb);
+
+        if (!pcb->callback_arg)
+        {
+            /* None of the queued listen requests wanted it */
+            tcp_arg(pcb, Entry);
+            break;
+        }
+
+        RemoveEntryList(&Entry->ListEntry);
+        tcp_backlog_accepted(pcb);
+
+        /* Hand over what we received while it sat in the backlog */
+        while (!IsListEmpty(&Entry->PacketQueue))
+        {
+            ListEntry = RemoveHeadList(&Entry->PacketQueue);
+            qp = CONTAINING_RECORD(ListEntry, QUEUE_ENTRY, ListEntry);
+
+            InternalRecvEventHandler(pcb->callback_arg, pcb, qp->p, ERR_OK);
+
+            ExFreeToNPagedLookasideList(&QueueEntryLookasideList, qp);
+        }
+
+        if (Entry->ReceiveShutdown)
+            InternalRecvEventHandler(pcb->callback_arg, pcb, NULL, ERR_OK);
+
+        LibTCPFreeBacklogEntry(Entry);
+    }
+
+    DereferenceObject(Listener);
+
+    ExFreeToNPagedLookasideList(&MessageLookasideList, msg);
+}
+
+/* Offers the connections in the backlog to newly queued listen requests.
+ * This doesn't wait for the tcpip thread, so it's usable from any context. */
+void
+LibTCPAcceptBacklog(PCONNECTION_ENDPOINT Listener)
+{
+    struct lwip_callback_msg *msg;
+
+    msg = ExAllocateFromNPagedLookasideList(&MessageLookasideList);
+    if (!msg)
+    {
+        DbgPrint("LibTCPAcceptBacklog: No message, the backlog waits for the next listen request\n");
+        return;
+    }
+
+    ReferenceObject(Listener);
+    msg->Input.AcceptBacklog.Listener = Listener;
+
+    if (LibTCPSubmit(LibTCPAcceptBacklogCallback, msg) != ERR_OK)
+    {
+        DbgPrint("LibTCPAcceptBacklog: Unable to submit, the backlog waits for the next listen request\n");
+        DereferenceObject(Listener);
+        ExFreeToNPagedLookasideList(&MessageLookasideList, msg);
+    }
+}
+
+static
+void
+LibTCPSetSendBufferSizeCallback(void *arg)
+{
+    struct lwip_callback_msg *msg = arg;
+    PCONNECTION_ENDPOINT Connection = msg->Input.SendBuffer.Connection;
+    PTCP_PCB pcb = Connection->SocketContext;
+    ULONG OldSize = Connection->SendBufferSize;
+    ULONG NewSize = msg->Input.SendBuffer.Size;
+
+    /* snd_buf is the free space, move it by the change in size */
+    if (pcb && pcb->state != LISTEN)
+    {
+        if (NewSize >= OldSize)
+            pcb->snd_buf += NewSize - OldSize;
+        else if (pcb->snd_buf > OldSize - NewSize)
+            pcb->snd_buf -= OldSize - NewSize;
+        else
+            pcb->snd_buf = 0;
+    }
+
+    Connection->SendBufferSize = NewSize;
+    msg->Output.SendBuffer.Error = ERR_OK;
+
+    KeSetEvent(&msg->Event, IO_NO_INCREMENT, FALSE);
+}
+
+err_t
+LibTCPSetSendBufferSize(PCONNECTION_ENDPOINT Connection, const ULONG size)
+{
+    struct lwip_callback_msg *msg;
+    err_t ret;
+
+    msg = ExAllocateFromNPagedLookasideList(&MessageLookasideList);
+    if (msg)
+    {
+        KeInitializeEvent(&msg->Event, NotificationEvent, FALSE);
+        msg->Input.SendBuffer.Connection = Connection;
+        msg->Input.SendBuffer.Size = size;
+
+        if (LibTCPSubmit(LibTCPSetSendBufferSizeCallback, msg) != ERR_OK)
+            ret = ERR_MEM;
+        else if (WaitForEventSafely(&msg->Event))
+            ret = msg->Output.SendBuffer.Error;
+        else
+            ret = ERR_CLSD;
+
+        ExFreeToNPagedLookasideList(&MessageLookasideList, msg);
+
+        return ret;
+    }
+
+    return ERR_MEM;
+}
+
+static
+void
+LibTCPSetReceiveWindowCallback(void *arg)
+{
+    struct lwip_callback_msg *msg = arg;
+    PCONNECTION_ENDPOINT Connection = msg->Input.ReceiveWindow.Connection;
+    PTCP_PCB pcb = Connection->SocketContext;
+    ULONG Credit = 0;
+
+    LockObject(Connection);
+    Connection->ReceiveWindowSize = msg->Input.ReceiveWindow.Size;
+    if (Connection->ReceiveWithheld != 0 &&
+        Connection->ReceiveQueued <= Connection->ReceiveWindowSize)
+    {
+        /* What's queued fits now, stop holding the window back */
+        Credit = Connection->ReceiveWithheld;
+        Connection->ReceiveWithheld = 0;
+    }
+    UnlockObject(Connection);
+
+    if (pcb && pcb->state != LISTEN)
+        LibTCPOpenWindow(Connection, pcb, Credit);
+
+    msg->Output.ReceiveWindow.Error = ERR_OK;
+
+    KeSetEvent(&msg->Event, IO_NO_INCREMENT, FALSE);
+}
+
+err_t
+LibTCPSetReceiveWindow(PCONNECTION_ENDPOINT Connection, const ULONG size)
+{
+    struct lwip_callback_msg *msg;
+    err_t ret;
+
+    msg = ExAllocateFromNPagedLookasideList(&MessageLookasideList);
+    if (msg)
+    {
+        KeInitializeEvent(&msg->Event, NotificationEvent, FALSE);
+        msg->Input.ReceiveWindow.Connection = Connection;
+        msg->Input.ReceiveWindow.Size = size;
+
+        if (LibTCPSubmit(LibTCPSetReceiveWindowCallback, msg) != ERR_OK)
+            ret = ERR_MEM;
+        else if (WaitForEventSafely(&msg->Event))
+            ret = msg->Output.ReceiveWindow.Error;
+        else
+            ret = ERR_CLSD;
+
+        ExFreeToNPagedLookasideList(&MessageLookasideList, msg);
+
+        return ret;
+    }
+
+    return ERR_MEM;
+}
+
 err_t
 LibTCPGetHostName(PTCP_PCB pcb, ip_addr_t *const ipaddr, u16_t *const port)
 {
@@ -883,3 +1502,311 @@ LibTCPGetSocketStatus(
     /* Translate state from enum tcp_state -> MIB_TCP_STATE */
     *State = pcb->state + 1;
 }
+
+/* Returns the connection statistics are gathered for, if any. Listeners,
+ * backlogged PCBs and PCBs we already closed don't have one */
+static
+PCONNECTION_ENDPOINT
+LibTCPStatisticsOwner(const struct tcp_pcb *pcb)
+{
+    if (!pcb || pcb->state == LISTEN || pcb->recv != InternalRecvEventHandler)
+        return NULL;
+
+    return pcb->callback_arg;
+}
+
+/* LWIP_HOOK_TCP_INPACKET_PCB: the header is already in host byte order and
+ * p only covers the data. This runs before lwIP processes the segment */
+err_t
+LibTCPInPacketHook(struct tcp_pcb *pcb, struct tcp_hdr *hdr, struct pbuf *p)
+{
+    PCONNECTION_ENDPOINT Connection = LibTCPStatisticsOwner(pcb);
+    PTCP_CONNECTION_STATISTICS Statistics;
+    u8_t flags = TCPH_FLAGS(hdr);
+    ULONG Window, Rtt;
+
+    if (!Connection)
+        return ERR_OK;
+
+    Statistics = &Connection->Statistics;
+    Statistics->SegsIn++;
+
+    if (p->tot_len)
+    {
+        Statistics->DataSegsIn++;
+        Statistics->DataBytesIn += p->tot_len;
+
+        /* rcv_nxt isn't known before the SYN */
+        if (!(flags & TCP_SYN) && pcb->state != SYN_SENT &&
+            TCP_SEQ_GT(hdr->seqno, pcb->rcv_nxt))
+            Statistics->OutOfOrderIn++;
+    }
+
+    if (!(flags & TCP_ACK))
+        return ERR_OK;
+
+    if (TCP_SEQ_BETWEEN(hdr->ackno, pcb->lastack + 1, pcb->snd_nxt))
+    {
+        Statistics->BytesAcked += hdr->ackno - pcb->lastack;
+
+        /* Same sample lwIP is about to feed to its RTT estimator */
+        if (pcb->rttest && TCP_SEQ_LT(pcb->rtseq, hdr->ackno))
+        {
+            Rtt = (tcp_ticks - pcb->rttest) * TCP_SLOW_INTERVAL;
+
+            Statistics->SampleRtt = Rtt;
+            Statistics->SumRtt += Rtt;
+            Statistics->CountRtt++;
+            if (Rtt < Statistics->MinRtt)
+                Statistics->MinRtt = Rtt;
+            if (Rtt > Statistics->MaxRtt)
+                Statistics->MaxRtt = Rtt;
+        }
+    }
+    else if (hdr->ackno == pcb->lastack && !p->tot_len && pcb->unacked)
+    {
+        Statistics->DupAcksIn++;
+    }
+
+    /* The window in a SYN is never scaled */
+    if (flags & TCP_SYN)
+        return ERR_OK;
+
+    Window = (ULONG)hdr->wnd << pcb->snd_scale;
+
+    if (Window == 0 && pcb->snd_wnd != 0)
+        Statistics->ZeroWindowRcvd++;
+    if (Window < Statistics->MinRwinRcvd)
+        Statistics->MinRwinRcvd = Window;
+    if (Window > Statistics->MaxRwinRcvd)
+        Statistics->MaxRwinRcvd = Window;
+
+    return ERR_OK;
+}
+
+/* LWIP_HOOK_TCP_OUT_ADD_TCPOPTS: called for every segment we send, with the
+ * header in network byte order. pcb is NULL for resets sent without one */
+u32_t *
+LibTCPOutPacketHook(struct pbuf *p, struct tcp_hdr *hdr, const struct tcp_pcb *pcb, u32_t *opts)
+{
+    PCONNECTION_ENDPOINT Connection = LibTCPStatisticsOwner(pcb);
+    PTCP_CONNECTION_STATISTICS Statistics;
+    ULONG Length, Window;
+    u32_t seqno;
+
+    if (!Connection)
+        return opts;
+
+    Statistics = &Connection->Statistics;
+    Statistics->SegsOut++;
+
+    Length = p->tot_len - TCPH_HDRLEN_BYTES(hdr);
+    seqno = lwip_ntohl(hdr->seqno);
+
+    if (Length)
+    {
+        Statistics->DataSegsOut++;
+        Statistics->DataBytesOut += Length;
+
+        /* snd_nxt only moves once the segment went out */
+        if (TCP_SEQ_LT(seqno, pcb->snd_nxt))
+        {
+            Statistics->PktsRetrans++;
+            Statistics->BytesRetrans += Length;
+
+            if (seqno == pcb->lastack)
+            {
+                if (pcb->flags & TF_INFR)
+                    Statistics->FastRetran++;
+                else
+                    Statistics->Timeouts++;
+            }
+        }
+    }
+
+    if (pcb->cwnd > Statistics->MaxCwnd)
+        Statistics->MaxCwnd = pcb->cwnd;
+
+    if (!(TCPH_FLAGS(hdr) & TCP_SYN))
+    {
+        Window = (ULONG)lwip_ntohs(hdr->wnd) << pcb->rcv_scale;
+
+        if (Window < Statistics->MinRwinSent)
+            Statistics->MinRwinSent = Window;
+        if (Window > Statistics->MaxRwinSent)
+            Statistics->MaxRwinSent = Window;
+    }
+
+    return opts;
+}
+
+static
+void
+LibTCPGetStatisticsCallback(void *arg)
+{
+    struct lwip_callback_msg *msg = arg;
+    PCONNECTION_ENDPOINT Connection = msg->Input.Statistics.Connection;
+    PTCP_CONNECTION_STATISTICS Statistics = &Connection->Statistics;
+    PTCP_ESTATS_ENTRY Entry = msg->Input.Statistics.Entry;
+    PTCP_PCB pcb = Connection->SocketContext;
+
+    RtlZeroMemory(Entry, sizeof(*Entry));
+
+    Entry->Data.SegsIn = Statistics->SegsIn;
+    Entry->Data.SegsOut = Statistics->SegsOut;
+    Entry->Data.DataSegsIn = Statistics->DataSegsIn;
+    Entry->Data.DataSegsOut = Statistics->DataSegsOut;
+    Entry->Data.DataBytesIn = Statistics->DataBytesIn;
+    Entry->Data.DataBytesOut = Statistics->DataBytesOut;
+    Entry->Data.ThruBytesAcked = Statistics->BytesAcked;
+    Entry->Data.ThruBytesReceived = Statistics->DataBytesIn;
+
+    Entry->SndCong.SndLimTransRwin = Statistics->ZeroWindowRcvd;
+    Entry->SndCong.MaxSsCwnd = Statistics->MaxCwnd;
+
+    Entry->Path.FastRetran = Statistics->FastRetran;
+    Entry->Path.Timeouts = Statistics->Timeouts;
+    Entry->Path.PktsRetrans = Statistics->PktsRetrans;
+    Entry->Path.BytesRetrans = Statistics->BytesRetrans;
+    Entry->Path.DupAcksIn = Statistics->DupAcksIn;
+    Entry->Path.SampleRtt = Statistics->SampleRtt;
+    Entry->Path.SumRtt = Statistics->SumRtt;
+    Entry->Path.CountRtt = Statistics->CountRtt;
+    Entry->Path.MaxRtt = Statistics->MaxRtt;
+    Entry->Path.MinRtt = Statistics->MinRtt;
+    Entry->Path.RetranThresh = 3;
+
+    /* Out of order segments are what makes us send duplicate ACKs */
+    Entry->Rec.DupAcksOut = Statistics->OutOfOrderIn;
+    Entry->Rec.MaxRwinSent = Statistics->MaxRwinSent;
+    Entry->Rec.MinRwinSent = Statistics->MinRwinSent;
+
+    Entry->ObsRec.MaxRwinRcvd = Statistics->MaxRwinRcvd;
+    Entry->ObsRec.MinRwinRcvd = Statistics->MinRwinRcvd;
+
+    if (pcb && pcb->state != LISTEN)
+    {
+        Entry->Data.SndUna = pcb->lastack;
+        Entry->Data.SndNxt = pcb->snd_nxt;
+        Entry->Data.SndMax = pcb->snd_nxt;
+        Entry->Data.RcvNxt = pcb->rcv_nxt;
+
+        Entry->SndCong.CurCwnd = pcb->cwnd;
+        Entry->SndCong.CurSsthresh = pcb->ssthresh;
+
+        /* sa and sv are scaled by 8 and 4, in TCP_SLOW_INTERVAL ticks */
+        Entry->Path.SmoothedRtt = (pcb->sa >> 3) * TCP_SLOW_INTERVAL;
+        Entry->Path.RttVar = (pcb->sv >> 2) * TCP_SLOW_INTERVAL;
+        Entry->Path.CurRto = pcb->rto * TCP_SLOW_INTERVAL;
+        Entry->Path.CurTimeoutCount = pcb->nrtx;
+        Entry->Path.CurMss = pcb->mss;
+
+        Entry->Rec.CurRwinSent = pcb->rcv_ann_wnd;
+        Entry->Rec.WinScaleSent = pcb->rcv_scale;
+        Entry->Rec.CurAppRQueue = Connection->ReceiveQueued;
+
+        Entry->ObsRec.CurRwinRcvd = pcb->snd_wnd;
+        Entry->ObsRec.WinScaleRcvd = pcb->snd_scale;
+    }
+
+    KeSetEvent(&msg->Event, IO_NO_INCREMENT, FALSE);
+}
+
+err_t
+LibTCPGetStatistics(PCONNECTION_ENDPOINT Connection, PTCP_ESTATS_ENTRY Entry)
+{
+    struct lwip_callback_msg *msg;
+    err_t ret;
+
+    msg = ExAllocateFromNPagedLookasideList(&MessageLookasideList);
+    if (msg)
+    {
+        KeInitializeEvent(&msg->Event, NotificationEvent, FALSE);
+        msg->Input.Statistics.Connection = Connection;
+        msg->Input.Statistics.Entry = Entry;
+
+        if (LibTCPSubmit(LibTCPGetStatisticsCallback, msg) != ERR_OK)
+            ret = ERR_MEM;
+        else if (WaitForEventSafely(&msg->Event))
+            ret = ERR_OK;
+        else
+            ret = ERR_CLSD;
+
+        ExFreeToNPagedLookasideList(&MessageLookasideList, msg);
+
+        return ret;
+    }
+
+    return ERR_MEM;
+}
+
+static
+void
+LibTCPGetMibStatisticsCallback(void *arg)
+{
+    struct lwip_callback_msg *msg = arg;
+    PMIB_TCPSTATS Stats = msg->Input.MibStatistics.Stats;
+    struct tcp_pcb *pcb;
+    struct tcp_pcb_listen *lpcb;
+
+    Stats->dwRtoAlgorithm = MIB_TCP_RTO_VANJ;
+    Stats->dwRtoMin = TCP_SLOW_INTERVAL;
+    /* The RTO is a s16_t count of TCP_SLOW_INTERVAL ticks */
+    Stats->dwRtoMax = 0x7FFF * TCP_SLOW_INTERVAL;
+    Stats->dwMaxConn = (DWORD)-1;
+
+    Stats->dwActiveOpens = lwip_stats.mib2.tcpactiveopens;
+    Stats->dwPassiveOpens = lwip_stats.mib2.tcppassiveopens;
+    Stats->dwAttemptFails = lwip_stats.mib2.tcpattemptfails;
+    Stats->dwEstabResets = lwip_stats.mib2.tcpestabresets;
+    Stats->dwInSegs = lwip_stats.mib2.tcpinsegs;
+    Stats->dwOutSegs = lwip_stats.mib2.tcpoutsegs;
+    Stats->dwRetransSegs = lwip_stats.mib2.tcpretranssegs;
+    Stats->dwInErrs = lwip_stats.mib2.tcpinerrs;
+    Stats->dwOutRsts = lwip_stats.mib2.tcpoutrsts;
+
+    Stats->dwCurrEstab = 0;
+    Stats->dwNumConns = 0;
+
+    for (pcb = tcp_active_pcbs; pcb; pcb = pcb->next)
+    {
+        if (pcb->state == ESTABLISHED || pcb->state == CLOSE_WAIT)
+            Stats->dwCurrEstab++;
+        Stats->dwNumConns++;
+    }
+
+    for (lpcb = tcp_listen_pcbs.listen_pcbs; lpcb; lpcb = lpcb->next)
+        Stats->dwNumConns++;
+
+    for (pcb = tcp_tw_pcbs; pcb; pcb = pcb->next)
+        Stats->dwNumConns++;
+
+    KeSetEvent(&msg->Event, IO_NO_INCREMENT, FALSE);
+}
+
+err_t
+LibTCPGetMibStatistics(PMIB_TCPSTATS Stats)
+{
+    struct lwip_callback_msg *msg;
+    err_t ret;
+
+    msg = ExAllocateFromNPagedLookasideList(&MessageLookasideList);
+    if (msg)
+    {
+        KeInitializeEvent(&msg->Event, NotificationEvent, FALSE);
+        msg->Input.MibStatistics.Stats = Stats;
+
+        if (LibTCPSubmit(LibTCPGetMibStatisticsCallback, msg) != ERR_OK)
+            ret = ERR_MEM;
+        else if (WaitForEventSafely(&msg->Event))
+            ret = ERR_OK;
+        else
+            ret = ERR_CLSD;
+
+        ExFreeToNPagedLookasideList(&MessageLookasideList, msg);
+
+        return ret;
+    }
+
+    return ERR_MEM;
+}
@@ -164,5 +164,9 @@ NTSTATUS TCPAccept ( PTDI_REQUEST Request,
 
     UnlockObject(Listener);
 
+    /* A connection may already be waiting in the backlog */
+    if (Status == STATUS_PENDING)
+        LibTCPAcceptBacklog(Listener);
+
     return Status;
 }
@@ -18,6 +18,11 @@
 
 extern NPAGED_LOOKASIDE_LIST TdiBucketLookasideList;
 
+/* Asynchronous completions are delivered in batches by a single work item */
+static LIST_ENTRY CompletionQueue;
+static KSPIN_LOCK CompletionQueueLock;
+static BOOLEAN CompletionWorkerQueued;
+
 static
 VOID
 BucketCompletionWorker(PVOID Context)
@@ -34,9 +39,55 @@ BucketCompletionWorker(PVOID Context)
     ExFreeToNPagedLookasideList(&TdiBucketLookasideList, Bucket);
 }
 
+static
+VOID
+BucketBatchWorker(PVOID Context)
+{
+    LIST_ENTRY Batch;
+    PLIST_ENTRY Entry;
+    KIRQL OldIrql;
+
+    InitializeListHead(&Batch);
+
+    for (;;)
+    {
+        /* Grab everything that was completed since we last looked */
+        KeAcquireSpinLock(&CompletionQueueLock, &OldIrql);
+        if (IsListEmpty(&CompletionQueue))
+        {
+            CompletionWorkerQueued = FALSE;
+            KeReleaseSpinLock(&CompletionQueueLock, OldIrql);
+            break;
+        }
+        while (!IsListEmpty(&CompletionQueue))
+        {
+            Entry = RemoveHeadList(&CompletionQueue);
+            InsertTailList(&Batch, Entry);
+        }
+        KeReleaseSpinLock(&CompletionQueueLock, OldIrql);
+
+        while (!IsListEmpty(&Batch))
+        {
+            Entry = RemoveHeadList(&Batch);
+            BucketCompletionWorker(CONTAINING_RECORD(Entry, TDI_BUCKET, Entry));
+        }
+    }
+}
+
+VOID
+TCPInitializeCompletionQueue(VOID)
+{
+    InitializeListHead(&CompletionQueue);
+    KeInitializeSpinLock(&CompletionQueueLock);
+    CompletionWorkerQueued = FALSE;
+}
+
 VOID
 CompleteBucket(PCONNECTION_ENDPOINT Connection, PTDI_BUCKET Bucket, const BOOLEAN Synchronous)
 {
+    KIRQL OldIrql;
+    BOOLEAN QueueWorker;
+
     ReferenceObject(Connection);
     Bucket->AssociatedEndpoint = Connection;
     if (Synchronous)
@@ -45,7 +96,18 @@ CompleteBucket(PCONNECTION_ENDPOINT Connection, PTDI_BUCKET Bucket, const BOOLEA
     }
     else
     {
-        ChewCreate(BucketCompletionWorker, Bucket);
+        KeAcquireSpinLock(&CompletionQueueLock, &OldIrql);
+        InsertTailList(&CompletionQueue, &Bucket->Entry);
+        QueueWorker = !CompletionWorkerQueued;
+        CompletionWorkerQueued = TRUE;
+        KeReleaseSpinLock(&CompletionQueueLock, OldIrql);
+
+        /* Only one worker is needed, it picks up whatever gets queued while it runs */
+        if (QueueWorker && !ChewCreate(BucketBatchWorker, NULL))
+        {
+            /* No work item, so complete the queue here rather than strand it */
+            BucketBatchWorker(NULL);
+        }
     }
 }
 
@@ -272,6 +334,9 @@ TCPAcceptEventHandler(void *arg, PTCP_PCB newpcb)
             /* free previously created socket context (we don't use it, we use newpcb) */
             Bucket->AssociatedEndpoint->SocketContext = newpcb;
 
+            /* Buffer sizes set on the listening socket apply to what it accepts */
+            TCPInheritBufferSizes(Bucket->AssociatedEndpoint, Connection->AddressFile);
+
             UnlockObject(Bucket->AssociatedEndpoint);
 
             LibTCPAccept(newpcb, (PTCP_PCB)Connection->SocketContext, Bucket->AssociatedEndpoint);
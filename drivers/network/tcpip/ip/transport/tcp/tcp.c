@@ -25,6 +25,10 @@ PORT_SET TCPPorts;
 
 NPAGED_LOOKASIDE_LIST TdiBucketLookasideList;
 
+/* Default per-connection buffer sizes, tunable through the registry */
+ULONG TCPReceiveWindowSize = TCP_WND;
+ULONG TCPSendBufferSize = TCP_SND_BUF;
+
 static
 IO_WORKITEM_ROUTINE
 DisconnectWorker;
@@ -124,6 +128,16 @@ PCONNECTION_ENDPOINT TCPAllocateConnectionEndpoint( PVOID ClientContext )
     InitializeListHead(&Connection->SendRequest);
     InitializeListHead(&Connection->ShutdownRequest);
     InitializeListHead(&Connection->PacketQueue);
+    InitializeListHead(&Connection->BacklogQueue);
+
+    /* Use the system wide buffer sizes until the client changes them */
+    Connection->ReceiveWindowSize = TCPReceiveWindowSize;
+    Connection->SendBufferSize = TCPSendBufferSize;
+
+    /* The minimums are only valid once something was seen */
+    Connection->Statistics.MinRtt = MAXULONG;
+    Connection->Statistics.MinRwinRcvd = MAXULONG;
+    Connection->Statistics.MinRwinSent = MAXULONG;
 
     /* Initialize disconnect timer */
     KeInitializeTimer(&Connection->DisconnectTimer);
@@ -205,6 +219,41 @@ VOID TCPReceive(PIP_INTERFACE Interface, PIP_PACKET IPPacket)
     LibIPInsertPacket(Interface->TCPContext, IPPacket->Header, IPPacket->TotalSize);
 }
 
+static
+VOID
+TCPReadParameters(VOID)
+/*
+ * FUNCTION: Reads the TCP tunables from Services\Tcpip\Parameters
+ */
+{
+    ULONG WindowSize = TCPReceiveWindowSize;
+    ULONG SendBufferSize = TCPSendBufferSize;
+    RTL_QUERY_REGISTRY_TABLE QueryTable[3];
+
+    RtlZeroMemory(QueryTable, sizeof(QueryTable));
+
+    QueryTable[0].Flags = RTL_QUERY_REGISTRY_DIRECT;
+    QueryTable[0].Name = L"TcpWindowSize";
+    QueryTable[0].EntryContext = &WindowSize;
+
+    QueryTable[1].Flags = RTL_QUERY_REGISTRY_DIRECT;
+    QueryTable[1].Name = L"TcpSendBufferSize";
+    QueryTable[1].EntryContext = &SendBufferSize;
+
+    /* Missing values simply keep the defaults */
+    RtlQueryRegistryValues(RTL_REGISTRY_SERVICES,
+                           L"Tcpip\\Parameters",
+                           QueryTable,
+                           NULL,
+                           NULL);
+
+    TCPReceiveWindowSize = max(min(WindowSize, TCP_WND), TCP_MSS);
+    TCPSendBufferSize = max(min(SendBufferSize, TCP_SND_BUF), 2 * TCP_MSS);
+
+    TI_DbgPrint(DEBUG_TCP, ("TCP window size %u, send buffer size %u\n",
+                            TCPReceiveWindowSize, TCPSendBufferSize));
+}
+
 NTSTATUS TCPStartup(VOID)
 /*
  * FUNCTION: Initializes the TCP subsystem
@@ -214,6 +263,8 @@ NTSTATUS TCPStartup(VOID)
 {
     NTSTATUS Status;
 
+    TCPReadParameters();
+
     Status = PortsStartup(&TCPPorts, 1, 0xffff);
     if (!NT_SUCCESS(Status))
     {
@@ -228,6 +279,8 @@ NTSTATUS TCPStartup(VOID)
                                     TDI_BUCKET_TAG,
                                     0);
 
+    TCPInitializeCompletionQueue();
+
     /* Initialize our IP library */
     LibIPInitialize();
 
@@ -406,6 +459,8 @@ NTSTATUS TCPConnect
 
     InsertTailList( &Connection->ConnectRequest, &Bucket->Entry );
 
+    TCPInheritBufferSizes(Connection, Connection->AddressFile);
+
     UnlockObject(Connection);
 
     Status = TCPTranslateError(LibTCPConnect(Connection,
@@ -745,6 +800,127 @@ TCPSetNoDelay(
     return STATUS_SUCCESS;
 }
 
+VOID
+TCPInheritBufferSizes(
+    PCONNECTION_ENDPOINT Connection,
+    PADDRESS_FILE AddrFile)
+/*
+ * FUNCTION: Takes over the SO_RCVBUF/SO_SNDBUF sizes set on an address file
+ * ARGUMENTS:
+ *     Connection = Connection about to be connected or accepted, locked
+ *     AddrFile   = Address file the sizes were set on
+ * NOTES:
+ *     lwIP applies them when the connection is established
+ */
+{
+    if (!AddrFile)
+        return;
+
+    LockObject(AddrFile);
+    if (AddrFile->ReceiveWindowSize)
+        Connection->ReceiveWindowSize = AddrFile->ReceiveWindowSize;
+    if (AddrFile->SendBufferSize)
+        Connection->SendBufferSize = AddrFile->SendBufferSize;
+    UnlockObject(AddrFile);
+}
+
+static
+PCONNECTION_ENDPOINT
+TCPGetSocketConnection(
+    PADDRESS_FILE AddrFile)
+/*
+ * FUNCTION: Returns the connection a socket option applies to right away
+ * NOTES:
+ *     The connections associated with a listening address file are waiting
+ *     for accepts and take the sizes over then. Returned referenced.
+ */
+{
+    PCONNECTION_ENDPOINT Connection = NULL;
+
+    LockObject(AddrFile);
+    if (!AddrFile->Listener && AddrFile->Connection)
+    {
+        Connection = AddrFile->Connection;
+        ReferenceObject(Connection);
+    }
+    UnlockObject(AddrFile);
+
+    return Connection;
+}
+
+NTSTATUS
+TCPSetReceiveWindow(
+    PADDRESS_FILE AddrFile,
+    ULONG Size)
+{
+    PCONNECTION_ENDPOINT Connection;
+    NTSTATUS Status = STATUS_SUCCESS;
+
+    Size = max(min(Size, TCP_WND), TCP_MSS);
+
+    LockObject(AddrFile);
+    AddrFile->ReceiveWindowSize = Size;
+    UnlockObject(AddrFile);
+
+    Connection = TCPGetSocketConnection(AddrFile);
+    if (Connection)
+    {
+        Status = TCPTranslateError(LibTCPSetReceiveWindow(Connection, Size));
+        DereferenceObject(Connection);
+    }
+
+    return Status;
+}
+
+NTSTATUS
+TCPSetSendBufferSize(
+    PADDRESS_FILE AddrFile,
+    ULONG Size)
+{
+    PCONNECTION_ENDPOINT Connection;
+    NTSTATUS Status = STATUS_SUCCESS;
+
+    Size = max(min(Size, TCP_SND_BUF), 2 * TCP_MSS);
+
+    LockObject(AddrFile);
+    AddrFile->SendBufferSize = Size;
+    UnlockObject(AddrFile);
+
+    Connection = TCPGetSocketConnection(AddrFile);
+    if (Connection)
+    {
+        Status = TCPTranslateError(LibTCPSetSendBufferSize(Connection, Size));
+        DereferenceObject(Connection);
+    }
+
+    return Status;
+}
+
+VOID
+TCPQueryPoolStatistics(
+    PTCP_POOL_STATISTICS Statistics)
+{
+    LibTCPQueryPoolStatistics(Statistics);
+}
+
+NTSTATUS
+TCPGetConnectionStatistics(
+    PCONNECTION_ENDPOINT Connection,
+    PTCP_ESTATS_ENTRY Entry)
+{
+    if (!Connection)
+        return STATUS_UNSUCCESSFUL;
+
+    return TCPTranslateError(LibTCPGetStatistics(Connection, Entry));
+}
+
+NTSTATUS
+TCPGetMibStatistics(
+    PMIB_TCPSTATS Stats)
+{
+    return TCPTranslateError(LibTCPGetMibStatistics(Stats));
+}
+
 NTSTATUS
 TCPGetSocketStatus(
     PCONNECTION_ENDPOINT Connection,
@@ -9,7 +9,7 @@
 #include "precomp.h"
 
 TDI_STATUS SetConnectionInfo(TDIObjectID *ID,
-                             PCONNECTION_ENDPOINT Connection,
+                             PADDRESS_FILE AddrFile,
                              PVOID Buffer,
                              UINT BufferSize)
 {
@@ -22,7 +22,19 @@ TDI_STATUS SetConnectionInfo(TDIObjectID *ID,
             if (BufferSize < sizeof(BOOLEAN))
                 return TDI_INVALID_PARAMETER;
             Set = *(BOOLEAN*)Buffer;
-            return TCPSetNoDelay(Connection, Set);
+            return TCPSetNoDelay(AddrFile->Connection, Set);
+        }
+        case TCP_SOCKET_WINDOW:
+        {
+            if (BufferSize < sizeof(ULONG))
+                return TDI_INVALID_PARAMETER;
+            return TCPSetReceiveWindow(AddrFile, *(ULONG*)Buffer);
+        }
+        case TCP_SOCKET_SNDBUF:
+        {
+            if (BufferSize < sizeof(ULONG))
+                return TDI_INVALID_PARAMETER;
+            return TCPSetSendBufferSize(AddrFile, *(ULONG*)Buffer);
         }
         default:
             DbgPrint("TCPIP: Unknown connection info ID: %u.\n", ID->toi_id);
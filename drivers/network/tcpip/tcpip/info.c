@@ -293,6 +293,9 @@ TDI_STATUS InfoTdiQueryInformationEx(
                          return InfoTdiQueryGetATInfo(ID->toi_entity, EntityListContext, Buffer, BufferSize);
                      else
                          return TDI_INVALID_PARAMETER;
+                 else if (ID->toi_entity.tei_entity == CO_TL_ENTITY)
+                     /* TCP_MIB_STAT_ID */
+                     return InfoTdiQueryGetTcpStatistics(Buffer, BufferSize);
                  else
                      return TDI_INVALID_PARAMETER;
 
@@ -316,6 +319,23 @@ TDI_STATUS InfoTdiQueryInformationEx(
                 else
                     return TDI_INVALID_PARAMETER;
 
+              case TCP_ESTATS_ENTRY_ID:
+                 if (ID->toi_type != INFO_TYPE_PROVIDER ||
+                     ID->toi_entity.tei_entity != CO_TL_ENTITY)
+                     return TDI_INVALID_PARAMETER;
+
+                 if ((EntityListContext = GetContext(ID->toi_entity)))
+                     return InfoTdiQueryGetTcpConnectionStatistics(EntityListContext, Buffer, BufferSize);
+                 else
+                     return TDI_INVALID_PARAMETER;
+
+              case TCP_POOL_STATS_ID:
+                 if (ID->toi_type != INFO_TYPE_PROVIDER ||
+                     ID->toi_entity.tei_entity != CO_TL_ENTITY)
+                     return TDI_INVALID_PARAMETER;
+
+                 return InfoTdiQueryGetPoolStatistics(Buffer, BufferSize);
+
               case IP_MIB_ARPTABLE_ENTRY_ID:
                  if (ID->toi_type != INFO_TYPE_PROVIDER)
                      return TDI_INVALID_PARAMETER;
@@ -415,7 +435,7 @@ TDI_STATUS InfoTdiSetInformationEx
                     PADDRESS_FILE AddressFile = GetContext(ID->toi_entity);
                     if (AddressFile == NULL)
                         return TDI_INVALID_PARAMETER;
-                    return SetConnectionInfo(ID, AddressFile->Connection, Buffer, BufferSize);
+                    return SetConnectionInfo(ID, AddressFile, Buffer, BufferSize);
                 }
                 case INFO_TYPE_PROVIDER:
                 {
@@ -27,6 +27,56 @@ TDI_STATUS InfoTransportLayerTdiQueryEx( UINT InfoClass,
     return TDI_INVALID_REQUEST;
 }
 
+TDI_STATUS InfoTdiQueryGetPoolStatistics(PNDIS_BUFFER Buffer,
+                                         PUINT BufferSize)
+{
+    TCP_POOL_STATISTICS Statistics;
+
+    TCPQueryPoolStatistics(&Statistics);
+
+    return InfoCopyOut((PCHAR)&Statistics, sizeof(Statistics), Buffer, BufferSize);
+}
+
+TDI_STATUS InfoTdiQueryGetTcpStatistics(PNDIS_BUFFER Buffer,
+                                        PUINT BufferSize)
+{
+    MIB_TCPSTATS Stats;
+    NTSTATUS Status;
+
+    Status = TCPGetMibStatistics(&Stats);
+    if (!NT_SUCCESS(Status))
+        return Status;
+
+    return InfoCopyOut((PCHAR)&Stats, sizeof(Stats), Buffer, BufferSize);
+}
+
+TDI_STATUS InfoTdiQueryGetTcpConnectionStatistics(PADDRESS_FILE AddrFile,
+                                                  PNDIS_BUFFER Buffer,
+                                                  PUINT BufferSize)
+{
+    PCONNECTION_ENDPOINT Connection;
+    TCP_ESTATS_ENTRY Entry;
+    NTSTATUS Status;
+
+    /* The connection can be disassociated meanwhile, keep it around */
+    LockObject(AddrFile);
+    Connection = AddrFile->Connection;
+    if (Connection)
+        ReferenceObject(Connection);
+    UnlockObject(AddrFile);
+
+    /* Listeners don't have any */
+    if (!Connection)
+        return TDI_INVALID_PARAMETER;
+
+    Status = TCPGetConnectionStatistics(Connection, &Entry);
+    DereferenceObject(Connection);
+    if (!NT_SUCCESS(Status))
+        return Status;
+
+    return InfoCopyOut((PCHAR)&Entry, sizeof(Entry), Buffer, BufferSize);
+}
+
 TDI_STATUS InfoTransportLayerTdiSetEx( UINT InfoClass,
 				       UINT InfoType,
 				       UINT InfoId,
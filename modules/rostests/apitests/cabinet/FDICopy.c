@@ -0,0 +1,329 @@
+/*
+ * PROJECT:     ReactOS api tests
+ * LICENSE:     GPL-2.0-or-later (https://spdx.org/licenses/GPL-2.0-or-later)
+ * PURPOSE:     Test and benchmark for FDICopy on multi-folder cabinets
+ */
+
+#include <apitest.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <io.h>
+#include <fcntl.h>
+#include <fci.h>
+#include <fdi.h>
+
+#define FOLDER_COUNT    8
+#define FILE_SIZE       (1024 * 1024)
+
+static char TestDir[MAX_PATH];
+static ULONG FilesChecked;
+
+/* Somewhat compressible contents, different for every file */
+static void FillFile(PUCHAR Buffer, ULONG Size, ULONG Seed)
+{
+    ULONG i;
+
+    for (i = 0; i < Size; i++)
+    {
+        Seed = Seed * 1103515245 + 12345;
+        Buffer[i] = "abcdefgh\r\n"[(Seed >> 16) % 10];
+    }
+}
+
+static void *CDECL mem_alloc(ULONG cb)
+{
+    return HeapAlloc(GetProcessHeap(), 0, cb);
+}
+
+static void CDECL mem_free(void *pv)
+{
+    HeapFree(GetProcessHeap(), 0, pv);
+}
+
+static INT_PTR CabOpen(const char *pszFile, int oflag)
+{
+    DWORD Access = (oflag & (_O_WRONLY | _O_RDWR)) ? GENERIC_READ | GENERIC_WRITE : GENERIC_READ;
+    DWORD Disposition = (oflag & _O_CREAT) ? CREATE_ALWAYS : OPEN_EXISTING;
+    HANDLE hFile;
+
+    hFile = CreateFileA(pszFile, Access, FILE_SHARE_READ, NULL, Disposition,
+                        FILE_ATTRIBUTE_NORMAL, NULL);
+    return (hFile == INVALID_HANDLE_VALUE) ? -1 : (INT_PTR)hFile;
+}
+
+static UINT CabRead(INT_PTR hf, void *pv, UINT cb)
+{
+    DWORD cbRead;
+
+    return ReadFile((HANDLE)hf, pv, cb, &cbRead, NULL) ? cbRead : (UINT)-1;
+}
+
+static UINT CabWrite(INT_PTR hf, void *pv, UINT cb)
+{
+    DWORD cbWritten;
+
+    return WriteFile((HANDLE)hf, pv, cb, &cbWritten, NULL) ? cbWritten : (UINT)-1;
+}
+
+static LONG CabSeek(INT_PTR hf, LONG dist, int seektype)
+{
+    return SetFilePointer((HANDLE)hf, dist, NULL, seektype);
+}
+
+/* FCI callbacks */
+
+static int CDECL fci_placed(PCCAB pccab, char *pszFile, LONG cbFile, BOOL fContinuation, void *pv)
+{
+    return 0;
+}
+
+static INT_PTR CDECL fci_open(char *pszFile, int oflag, int pmode, int *err, void *pv)
+{
+    return CabOpen(pszFile, oflag);
+}
+
+static UINT CDECL fci_read(INT_PTR hf, void *memory, UINT cb, int *err, void *pv)
+{
+    return CabRead(hf, memory, cb);
+}
+
+static UINT CDECL fci_write(INT_PTR hf, void *memory, UINT cb, int *err, void *pv)
+{
+    return CabWrite(hf, memory, cb);
+}
+
+static int CDECL fci_close(INT_PTR hf, int *err, void *pv)
+{
+    return CloseHandle((HANDLE)hf) ? 0 : -1;
+}
+
+static LONG CDECL fci_seek(INT_PTR hf, LONG dist, int seektype, int *err, void *pv)
+{
+    return CabSeek(hf, dist, seektype);
+}
+
+static int CDECL fci_delete(char *pszFile, int *err, void *pv)
+{
+    return DeleteFileA(pszFile) ? 0 : -1;
+}
+
+static BOOL CDECL fci_temp(char *pszTempName, int cbTempName, void *pv)
+{
+    char TempName[MAX_PATH];
+
+    if (!GetTempFileNameA(TestDir, "fci", 0, TempName) || (int)strlen(TempName) >= cbTempName)
+        return FALSE;
+    DeleteFileA(TempName);
+    strcpy(pszTempName, TempName);
+    return TRUE;
+}
+
+static BOOL CDECL fci_next(PCCAB pccab, ULONG cbPrevCab, void *pv)
+{
+    return TRUE;
+}
+
+static LONG CDECL fci_status(UINT typeStatus, ULONG cb1, ULONG cb2, void *pv)
+{
+    return 0;
+}
+
+static INT_PTR CDECL fci_info(char *pszName, USHORT *pdate, USHORT *ptime,
+                              USHORT *pattribs, int *err, void *pv)
+{
+    *pdate = *ptime = 0;
+    *pattribs = _A_NORMAL;
+    return CabOpen(pszName, _O_RDONLY);
+}
+
+/* FDI callbacks */
+
+static INT_PTR CDECL fdi_open(char *pszFile, int oflag, int pmode)
+{
+    return CabOpen(pszFile, oflag);
+}
+
+static UINT CDECL fdi_read(INT_PTR hf, void *pv, UINT cb)
+{
+    return CabRead(hf, pv, cb);
+}
+
+static UINT CDECL fdi_write(INT_PTR hf, void *pv, UINT cb)
+{
+    return CabWrite(hf, pv, cb);
+}
+
+static int CDECL fdi_close(INT_PTR hf)
+{
+    return CloseHandle((HANDLE)hf) ? 0 : -1;
+}
+
+static LONG CDECL fdi_seek(INT_PTR hf, LONG dist, int seektype)
+{
+    return CabSeek(hf, dist, seektype);
+}
+
+static INT_PTR CDECL fdi_notify(FDINOTIFICATIONTYPE fdint, PFDINOTIFICATION pfdin)
+{
+    char Path[MAX_PATH];
+    PUCHAR Expected, Actual;
+    DWORD cbRead;
+    ULONG Index;
+
+    switch (fdint)
+    {
+        case fdintCOPY_FILE:
+            sprintf(Path, "%s\\%s.out", TestDir, pfdin->psz1);
+            return CabOpen(Path, _O_RDWR | _O_CREAT);
+
+        case fdintCLOSE_FILE_INFO:
+            /* Compare the file with what was put in the cabinet */
+            Index = atoi(pfdin->psz1);
+            Expected = HeapAlloc(GetProcessHeap(), 0, FILE_SIZE);
+            Actual = HeapAlloc(GetProcessHeap(), 0, FILE_SIZE);
+            if (Expected && Actual)
+            {
+                FillFile(Expected, FILE_SIZE, Index);
+                SetFilePointer((HANDLE)pfdin->hf, 0, NULL, FILE_BEGIN);
+                ok(ReadFile((HANDLE)pfdin->hf, Actual, FILE_SIZE, &cbRead, NULL), "ReadFile failed\n");
+                ok(cbRead == FILE_SIZE, "File %s: got %lu bytes\n", pfdin->psz1, cbRead);
+                ok(!memcmp(Expected, Actual, FILE_SIZE), "File %s differs\n", pfdin->psz1);
+                FilesChecked++;
+            }
+            HeapFree(GetProcessHeap(), 0, Expected);
+            HeapFree(GetProcessHeap(), 0, Actual);
+            CloseHandle((HANDLE)pfdin->hf);
+            sprintf(Path, "%s\\%s.out", TestDir, pfdin->psz1);
+            DeleteFileA(Path);
+            return TRUE;
+
+        default:
+            return 0;
+    }
+}
+
+/*
+ * One file per folder, or all of them in one folder. FCI only writes MSZIP
+ * (or stored) folders, so the LZX and Quantum decoders aren't covered here.
+ */
+static BOOL CreateCabinet(const char *CabName, BOOL SingleFolder)
+{
+    char Name[16], Path[MAX_PATH];
+    PUCHAR Buffer;
+    INT_PTR hf;
+    HFCI hfci;
+    CCAB ccab;
+    ERF erf;
+    ULONG i;
+    BOOL Success = TRUE;
+
+    Buffer = HeapAlloc(GetProcessHeap(), 0, FILE_SIZE);
+    if (!Buffer)
+        return FALSE;
+
+    ZeroMemory(&ccab, sizeof(ccab));
+    ccab.cb = 0x7FFFFFFF;
+    ccab.cbFolderThresh = 0x7FFFFFFF;
+    sprintf(ccab.szCabPath, "%s\\", TestDir);
+    strcpy(ccab.szCab, CabName);
+
+    hfci = FCICreate(&erf, fci_placed, mem_alloc, mem_free, fci_open, fci_read,
+                     fci_write, fci_close, fci_seek, fci_delete, fci_temp, &ccab, NULL);
+    ok(hfci != NULL, "FCICreate failed\n");
+    if (!hfci)
+    {
+        HeapFree(GetProcessHeap(), 0, Buffer);
+        return FALSE;
+    }
+
+    for (i = 0; Success && i < FOLDER_COUNT; i++)
+    {
+        sprintf(Name, "%lu", i);
+        sprintf(Path, "%s\\%s", TestDir, Name);
+        FillFile(Buffer, FILE_SIZE, i);
+        hf = CabOpen(Path, _O_RDWR | _O_CREAT);
+        Success = (hf != -1) && (CabWrite(hf, Buffer, FILE_SIZE) == FILE_SIZE);
+        if (hf != -1)
+            CloseHandle((HANDLE)hf);
+
+        Success = Success &&
+                  FCIAddFile(hfci, Path, Name, FALSE, fci_next, fci_status, fci_info,
+                             tcompTYPE_MSZIP) &&
+                  (SingleFolder || FCIFlushFolder(hfci, fci_next, fci_status));
+        ok(Success, "Adding file %lu failed, error %d\n", i, erf.erfOper);
+        DeleteFileA(Path);
+    }
+
+    Success = Success && FCIFlushCabinet(hfci, FALSE, fci_next, fci_status);
+    ok(Success, "Creating the cabinet failed, error %d\n", erf.erfOper);
+    FCIDestroy(hfci);
+    HeapFree(GetProcessHeap(), 0, Buffer);
+    return Success;
+}
+
+/* Extracts a cabinet and returns the time it took */
+static DWORD ExtractCabinet(HFDI hfdi, char *CabName)
+{
+    char CabPath[MAX_PATH + 1];
+    DWORD Start, Time;
+    BOOL Success;
+
+    sprintf(CabPath, "%s\\", TestDir);
+    FilesChecked = 0;
+
+    Start = GetTickCount();
+    Success = FDICopy(hfdi, CabName, CabPath, 0, fdi_notify, NULL, NULL);
+    Time = GetTickCount() - Start;
+
+    ok(Success, "FDICopy(%s) failed\n", CabName);
+    ok(FilesChecked == FOLDER_COUNT, "%s: checked %lu files\n", CabName, FilesChecked);
+
+    sprintf(CabPath, "%s\\%s", TestDir, CabName);
+    DeleteFileA(CabPath);
+    return Time;
+}
+
+START_TEST(FDICopy)
+{
+    char CabName[] = "test.cab", SerialCabName[] = "serial.cab", Path[MAX_PATH];
+    DWORD Time, SerialTime;
+    HFDI hfdi;
+    ERF erf;
+
+    GetTempPathA(sizeof(TestDir), TestDir);
+    strcat(TestDir, "fdicopy_apitest");
+    CreateDirectoryA(TestDir, NULL);
+
+    if (!CreateCabinet(CabName, FALSE) || !CreateCabinet(SerialCabName, TRUE))
+    {
+        skip("No cabinet to extract\n");
+        sprintf(Path, "%s\\%s", TestDir, CabName);
+        DeleteFileA(Path);
+        RemoveDirectoryA(TestDir);
+        return;
+    }
+
+    hfdi = FDICreate(mem_alloc, mem_free, fdi_open, fdi_read, fdi_write,
+                     fdi_close, fdi_seek, cpuUNKNOWN, &erf);
+    ok(hfdi != NULL, "FDICreate failed\n");
+    if (hfdi)
+    {
+        /* The same data in one folder always goes through the serial path */
+        SerialTime = ExtractCabinet(hfdi, SerialCabName);
+        Time = ExtractCabinet(hfdi, CabName);
+
+        trace("Extracted %u MB: %lu ms from one folder, %lu ms from %u folders\n",
+              FOLDER_COUNT * FILE_SIZE / (1024 * 1024), SerialTime, Time, FOLDER_COUNT);
+
+        FDIDestroy(hfdi);
+    }
+    else
+    {
+        sprintf(Path, "%s\\%s", TestDir, CabName);
+        DeleteFileA(Path);
+        sprintf(Path, "%s\\%s", TestDir, SerialCabName);
+        DeleteFileA(Path);
+    }
+
+    RemoveDirectoryA(TestDir);
+}
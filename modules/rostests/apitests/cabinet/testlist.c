@@ -0,0 +1,10 @@
+#define STANDALONE
+#include <apitest.h>
+
+extern void func_FDICopy(void);
+
+const struct test winetest_testlist[] =
+{
+    { "FDICopy", func_FDICopy },
+    { 0, 0 }
+};
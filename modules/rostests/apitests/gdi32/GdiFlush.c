@@ -0,0 +1,166 @@
+/*
+ * PROJECT:         ReactOS api tests
+ * LICENSE:         GPL - See COPYING in the top level directory
+ * PURPOSE:         Test for GdiFlush and batched drawing calls
+ * PROGRAMMERS:
+ */
+
+#include "precomp.h"
+
+#include <ndk/rtlfuncs.h>
+
+static ULONG gcCalls, gcBatched;
+
+/* Counts the calls that were queued in the TEB instead of entering win32k */
+static void CountCall(ULONG cPrevious)
+{
+    gcCalls++;
+    if (NtCurrentTeb()->GdiBatchCount == cPrevious + 1)
+        gcBatched++;
+}
+
+#define BATCH_CALL(x) \
+    do { ULONG cPrevious = NtCurrentTeb()->GdiBatchCount; ok(x, #x " failed\n"); CountCall(cPrevious); } while (0)
+
+static void Test_DrawFrame(void)
+{
+    static const POINT apt[] = { { 0, 4 }, { 10, 4 }, { 10, 6 } };
+    HDC hdc;
+    HBITMAP hbmp, hbmpOld;
+    HGDIOBJ hpenOld, hbrOld;
+    POINT pt;
+
+    hdc = CreateCompatibleDC(NULL);
+    ok(hdc != NULL, "CreateCompatibleDC failed\n");
+    hbmp = CreateBitmap(32, 32, 1, 32, NULL);
+    ok(hbmp != NULL, "CreateBitmap failed\n");
+    if (!hdc || !hbmp)
+    {
+        skip("Failed to create the DC\n");
+        goto Cleanup;
+    }
+
+    hbmpOld = SelectObject(hdc, hbmp);
+    hpenOld = SelectObject(hdc, GetStockObject(DC_PEN));
+    hbrOld = SelectObject(hdc, GetStockObject(DC_BRUSH));
+
+    gcCalls = gcBatched = 0;
+    GdiFlush();
+
+    /* One frame, the colors change between the calls */
+    BATCH_CALL(PatBlt(hdc, 0, 0, 32, 32, WHITENESS));
+    SetDCPenColor(hdc, RGB(255, 0, 0));
+    ok(MoveToEx(hdc, 0, 0, NULL), "MoveToEx failed\n");
+    BATCH_CALL(LineTo(hdc, 10, 0));
+    SetDCPenColor(hdc, RGB(0, 255, 0));
+    ok(MoveToEx(hdc, 0, 2, NULL), "MoveToEx failed\n");
+    BATCH_CALL(LineTo(hdc, 10, 2));
+    SetDCPenColor(hdc, RGB(0, 0, 255));
+    BATCH_CALL(Polyline(hdc, apt, ARRAYSIZE(apt)));
+    SetDCPenColor(hdc, RGB(0, 0, 0));
+    SetDCBrushColor(hdc, RGB(255, 255, 0));
+    BATCH_CALL(Rectangle(hdc, 0, 8, 10, 14));
+    SetDCBrushColor(hdc, RGB(0, 255, 255));
+    BATCH_CALL(Rectangle(hdc, 0, 14, 10, 20));
+    BATCH_CALL(SetPixelV(hdc, 0, 24, RGB(255, 0, 255)));
+    BATCH_CALL(BitBlt(hdc, 16, 0, 10, 26, hdc, 0, 0, SRCCOPY));
+
+    /* The current position was moved by the last LineTo */
+    ok(MoveToEx(hdc, 0, 0, &pt), "MoveToEx failed\n");
+    ok_long(pt.x, 10);
+    ok_long(pt.y, 2);
+
+    trace("batched %lu of %lu calls\n", gcBatched, gcCalls);
+    GdiFlush();
+    ok_long(NtCurrentTeb()->GdiBatchCount, 0);
+
+    ok_long(GetPixel(hdc, 5, 0), RGB(255, 0, 0));
+    ok_long(GetPixel(hdc, 10, 0), RGB(255, 255, 255));
+    ok_long(GetPixel(hdc, 5, 2), RGB(0, 255, 0));
+    ok_long(GetPixel(hdc, 5, 4), RGB(0, 0, 255));
+    ok_long(GetPixel(hdc, 10, 5), RGB(0, 0, 255));
+    ok_long(GetPixel(hdc, 0, 8), RGB(0, 0, 0));
+    ok_long(GetPixel(hdc, 5, 11), RGB(255, 255, 0));
+    ok_long(GetPixel(hdc, 5, 17), RGB(0, 255, 255));
+    ok_long(GetPixel(hdc, 0, 24), RGB(255, 0, 255));
+    ok_long(GetPixel(hdc, 1, 24), RGB(255, 255, 255));
+
+    /* The copy sees everything drawn before it */
+    ok_long(GetPixel(hdc, 21, 0), RGB(255, 0, 0));
+    ok_long(GetPixel(hdc, 21, 2), RGB(0, 255, 0));
+    ok_long(GetPixel(hdc, 21, 4), RGB(0, 0, 255));
+    ok_long(GetPixel(hdc, 21, 11), RGB(255, 255, 0));
+    ok_long(GetPixel(hdc, 21, 17), RGB(0, 255, 255));
+    ok_long(GetPixel(hdc, 16, 24), RGB(255, 0, 255));
+
+    SelectObject(hdc, hbrOld);
+    SelectObject(hdc, hpenOld);
+    SelectObject(hdc, hbmpOld);
+
+Cleanup:
+    if (hbmp) DeleteObject(hbmp);
+    if (hdc) DeleteDC(hdc);
+}
+
+static void Test_Path(void)
+{
+    static const POINT aptExpected[] = { { 0, 0 }, { 10, 0 }, { 10, 10 }, { 20, 0 }, { 30, 0 } };
+    static const BYTE ajExpected[] = { PT_MOVETO, PT_LINETO, PT_LINETO, PT_MOVETO, PT_LINETO };
+    POINT apt[8];
+    BYTE aj[8];
+    HDC hdc;
+    int i, cpt;
+
+    hdc = CreateCompatibleDC(NULL);
+    ok(hdc != NULL, "CreateCompatibleDC failed\n");
+    if (!hdc)
+    {
+        skip("Failed to create the DC\n");
+        return;
+    }
+
+    gcCalls = gcBatched = 0;
+    ok(BeginPath(hdc), "BeginPath failed\n");
+
+    /* The lines are queued while the path is open, the moves must still split the figures */
+    ok(MoveToEx(hdc, 0, 0, NULL), "MoveToEx failed\n");
+    BATCH_CALL(LineTo(hdc, 10, 0));
+    BATCH_CALL(LineTo(hdc, 10, 10));
+    ok(MoveToEx(hdc, 20, 0, NULL), "MoveToEx failed\n");
+    BATCH_CALL(LineTo(hdc, 30, 0));
+    trace("batched %lu of %lu calls\n", gcBatched, gcCalls);
+
+    ok(EndPath(hdc), "EndPath failed\n");
+
+    cpt = GetPath(hdc, apt, aj, ARRAYSIZE(apt));
+    ok_int(cpt, ARRAYSIZE(aptExpected));
+    for (i = 0; i < cpt && i < ARRAYSIZE(aptExpected); i++)
+    {
+        ok(apt[i].x == aptExpected[i].x && apt[i].y == aptExpected[i].y,
+           "Point %d is (%ld, %ld), expected (%ld, %ld)\n",
+           i, apt[i].x, apt[i].y, aptExpected[i].x, aptExpected[i].y);
+        ok(aj[i] == ajExpected[i], "Point %d has type %u, expected %u\n", i, aj[i], ajExpected[i]);
+    }
+
+    DeleteDC(hdc);
+}
+
+static void Test_DeletedDC(void)
+{
+    HDC hdc;
+
+    /* A batched call can't fail, but a deleted DC is caught before batching */
+    hdc = CreateCompatibleDC(NULL);
+    ok(hdc != NULL, "CreateCompatibleDC failed\n");
+    DeleteDC(hdc);
+    ok(!SetPixelV(hdc, 0, 0, RGB(0, 0, 0)), "SetPixelV succeeded\n");
+    ok(!Rectangle(hdc, 0, 0, 1, 1), "Rectangle succeeded\n");
+    ok(GdiFlush(), "GdiFlush failed\n");
+}
+
+START_TEST(GdiFlush)
+{
+    Test_DrawFrame();
+    Test_Path();
+    Test_DeletedDC();
+}
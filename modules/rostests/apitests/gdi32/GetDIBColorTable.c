@@ -100,8 +100,98 @@ void Test_GetDIBColorTable()
 
 }
 
+/* Blits must use the current colors, not translations from earlier blits */
+void Test_ColorTableBlits()
+{
+    struct
+    {
+        BITMAPINFOHEADER bmiHeader;
+        ULONG bmiColors[256];
+    } bmibuffer;
+    BITMAPINFO *pbmi = (PVOID)&bmibuffer;
+    HBITMAP hbmp8, hbmp32, hbmpOld8, hbmpOld32;
+    HDC hdc8, hdc32;
+    PBYTE pjBits8;
+    PULONG pulBits32;
+    ULONG i, aulColors[256];
+
+    hdc8 = CreateCompatibleDC(0);
+    hdc32 = CreateCompatibleDC(0);
+    ok(hdc8 != 0 && hdc32 != 0, "failed\n");
+
+    /* A 4x1 8bpp DIB section with a gray ramp */
+    ZeroMemory(&bmibuffer, sizeof(bmibuffer));
+    pbmi->bmiHeader.biSize = sizeof(BITMAPINFOHEADER);
+    pbmi->bmiHeader.biWidth = 4;
+    pbmi->bmiHeader.biHeight = -1;
+    pbmi->bmiHeader.biPlanes = 1;
+    pbmi->bmiHeader.biBitCount = 8;
+    pbmi->bmiHeader.biCompression = BI_RGB;
+    for (i = 0; i < 256; i++)
+        bmibuffer.bmiColors[i] = i * 0x010101;
+    hbmp8 = CreateDIBSection(hdc8, pbmi, DIB_RGB_COLORS, (PVOID*)&pjBits8, 0, 0);
+    ok(hbmp8 != NULL, "error=%ld\n", GetLastError());
+
+    /* And a 4x1 32bpp one */
+    pbmi->bmiHeader.biBitCount = 32;
+    hbmp32 = CreateDIBSection(hdc32, pbmi, DIB_RGB_COLORS, (PVOID*)&pulBits32, 0, 0);
+    ok(hbmp32 != NULL, "error=%ld\n", GetLastError());
+    if (!hbmp8 || !hbmp32)
+    {
+        skip("Failed to create DIB sections\n");
+        goto cleanup;
+    }
+
+    hbmpOld8 = SelectObject(hdc8, hbmp8);
+    hbmpOld32 = SelectObject(hdc32, hbmp32);
+
+    /* Indexed to RGB */
+    pjBits8[0] = 0x10;
+    pjBits8[1] = 0x20;
+    pjBits8[2] = 0x30;
+    pjBits8[3] = 0x40;
+    ok(BitBlt(hdc32, 0, 0, 4, 1, hdc8, 0, 0, SRCCOPY), "BitBlt failed\n");
+    ok_long(pulBits32[0], 0x101010);
+    ok_long(pulBits32[3], 0x404040);
+
+    aulColors[0] = 0xff0000;
+    ok_long(SetDIBColorTable(hdc8, 0x40, 1, (RGBQUAD*)aulColors), 1);
+    ok(BitBlt(hdc32, 0, 0, 4, 1, hdc8, 0, 0, SRCCOPY), "BitBlt failed\n");
+    ok_long(pulBits32[0], 0x101010);
+    ok_long(pulBits32[3], 0xff0000);
+
+    /* RGB to indexed */
+    pulBits32[0] = 0x202020;
+    pulBits32[1] = 0x404040;
+    pulBits32[2] = 0xff0000;
+    pulBits32[3] = 0x808080;
+    ok(BitBlt(hdc8, 0, 0, 4, 1, hdc32, 0, 0, SRCCOPY), "BitBlt failed\n");
+    ok_int(pjBits8[0], 0x20);
+    ok_int(pjBits8[2], 0x40);
+    ok_int(pjBits8[3], 0x80);
+
+    aulColors[0] = 0x404040;
+    aulColors[1] = 0x00ff00;
+    ok_long(SetDIBColorTable(hdc8, 0x80, 2, (RGBQUAD*)aulColors), 2);
+    ok(BitBlt(hdc8, 0, 0, 4, 1, hdc32, 0, 0, SRCCOPY), "BitBlt failed\n");
+    ok_int(pjBits8[0], 0x20);
+    ok_int(pjBits8[1], 0x80);
+    ok_int(pjBits8[2], 0x40);
+    ok(pjBits8[3] != 0x80, "Got %u\n", pjBits8[3]);
+
+    SelectObject(hdc8, hbmpOld8);
+    SelectObject(hdc32, hbmpOld32);
+
+cleanup:
+    if (hbmp8) DeleteObject(hbmp8);
+    if (hbmp32) DeleteObject(hbmp32);
+    DeleteDC(hdc8);
+    DeleteDC(hdc32);
+}
+
 START_TEST(GetDIBColorTable)
 {
     Test_GetDIBColorTable();
+    Test_ColorTableBlits();
 }
 
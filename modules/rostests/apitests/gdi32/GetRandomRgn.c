@@ -343,6 +343,78 @@ void Test_GetRandomRgn_RGN5()
     DeleteDC(hdc);
 }
 
+static BOOL PtInSysRgn(HWND hwnd, INT x, INT y)
+{
+    HDC hdc;
+    HRGN hrgn;
+    BOOL bResult;
+
+    hrgn = CreateRectRgn(0, 0, 0, 0);
+    hdc = GetDC(hwnd);
+    ok_int(GetRandomRgn(hdc, hrgn, SYSRGN), 1);
+    bResult = PtInRegion(hrgn, x, y);
+    ReleaseDC(hwnd, hdc);
+    DeleteObject(hrgn);
+    return bResult;
+}
+
+void Test_GetRandomRgn_SYSRGN_Overlap()
+{
+    HWND hwndBack, hwndFront, hwndOther;
+    WNDCLASSW wc = { 0 };
+
+    /* A class without CS_PARENTDC, so that GetDC clips the siblings */
+    wc.lpfnWndProc = DefWindowProcW;
+    wc.hInstance = GetModuleHandleW(NULL);
+    wc.lpszClassName = L"VisRgnTest";
+    RegisterClassW(&wc);
+
+    /* Topmost, so that nothing else is on top of them */
+    hwndBack = CreateWindowExW(WS_EX_TOPMOST, L"VisRgnTest", L"Back", WS_POPUP | WS_VISIBLE,
+                               100, 100, 200, 200, NULL, NULL, wc.hInstance, 0);
+    hwndFront = CreateWindowExW(WS_EX_TOPMOST, L"VisRgnTest", L"Front", WS_POPUP | WS_VISIBLE,
+                                150, 150, 100, 100, NULL, NULL, wc.hInstance, 0);
+    hwndOther = CreateWindowExW(WS_EX_TOPMOST, L"VisRgnTest", L"Other", WS_POPUP | WS_VISIBLE,
+                                600, 100, 50, 50, NULL, NULL, wc.hInstance, 0);
+    if (!hwndBack || !hwndFront || !hwndOther)
+    {
+        skip("Failed to create the windows\n");
+        goto Cleanup;
+    }
+
+    ok(PtInSysRgn(hwndBack, 120, 120), "Uncovered part is not visible\n");
+    ok(!PtInSysRgn(hwndBack, 160, 160), "Covered part is visible\n");
+
+    /* Moving a window that doesn't overlap changes nothing */
+    MoveWindow(hwndOther, 650, 150, 50, 50, FALSE);
+    ok(PtInSysRgn(hwndBack, 120, 120), "Uncovered part is not visible\n");
+    ok(!PtInSysRgn(hwndBack, 160, 160), "Covered part is visible\n");
+
+    /* Moving the covering window away uncovers it */
+    MoveWindow(hwndFront, 400, 150, 100, 100, FALSE);
+    ok(PtInSysRgn(hwndBack, 160, 160), "Uncovered part is not visible\n");
+    ok(PtInSysRgn(hwndFront, 410, 160), "Moved window is not visible\n");
+
+    /* And back on top of it */
+    SetWindowPos(hwndFront, HWND_TOP, 150, 150, 0, 0, SWP_NOSIZE | SWP_NOACTIVATE);
+    ok(!PtInSysRgn(hwndBack, 160, 160), "Covered part is visible\n");
+
+    /* Raising the covered window */
+    SetWindowPos(hwndBack, HWND_TOP, 0, 0, 0, 0, SWP_NOMOVE | SWP_NOSIZE | SWP_NOACTIVATE);
+    ok(PtInSysRgn(hwndBack, 160, 160), "Raised window is covered\n");
+    ok(!PtInSysRgn(hwndFront, 160, 160), "Lowered window is not covered\n");
+
+    /* Hiding it */
+    ShowWindow(hwndBack, SW_HIDE);
+    ok(PtInSysRgn(hwndFront, 160, 160), "Uncovered part is not visible\n");
+
+Cleanup:
+    if (hwndOther) DestroyWindow(hwndOther);
+    if (hwndFront) DestroyWindow(hwndFront);
+    if (hwndBack) DestroyWindow(hwndBack);
+    UnregisterClassW(L"VisRgnTest", GetModuleHandleW(NULL));
+}
+
 START_TEST(GetRandomRgn)
 {
 
@@ -362,6 +434,7 @@ START_TEST(GetRandomRgn)
     Test_GetRandomRgn_APIRGN();
     Test_GetRandomRgn_SYSRGN();
     Test_GetRandomRgn_RGN5();
+    Test_GetRandomRgn_SYSRGN_Overlap();
 
 }
 
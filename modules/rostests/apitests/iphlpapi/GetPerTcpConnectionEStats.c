@@ -0,0 +1,237 @@
+/*
+ * PROJECT:     ReactOS API Tests
+ * LICENSE:     LGPL-2.1-or-later (https://spdx.org/licenses/LGPL-2.1-or-later)
+ * PURPOSE:     Tests for TCP statistics (GetTcpStatistics, GetPerTcpConnectionEStats)
+ */
+
+#include <apitest.h>
+
+#define WIN32_NO_STATUS
+#include <iphlpapi.h>
+#include <winsock2.h>
+#include <tcpestats.h>
+
+#define TRANSFER_SIZE (64 * 1024)
+
+static ULONG (WINAPI *pGetPerTcpConnectionEStats)(PMIB_TCPROW, TCP_ESTATS_TYPE,
+                                                  PUCHAR, ULONG, ULONG,
+                                                  PUCHAR, ULONG, ULONG,
+                                                  PUCHAR, ULONG, ULONG);
+
+static
+BOOL
+CreateConnection(SOCKET *client, SOCKET *server)
+{
+    SOCKET listener;
+    struct sockaddr_in addr;
+    int addrlen = sizeof(addr);
+
+    *client = *server = INVALID_SOCKET;
+
+    listener = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if (listener == INVALID_SOCKET)
+        return FALSE;
+
+    ZeroMemory(&addr, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = inet_addr("127.0.0.1");
+
+    if (bind(listener, (SOCKADDR *)&addr, sizeof(addr)) == SOCKET_ERROR ||
+        getsockname(listener, (SOCKADDR *)&addr, &addrlen) == SOCKET_ERROR ||
+        listen(listener, 1) == SOCKET_ERROR)
+    {
+        closesocket(listener);
+        return FALSE;
+    }
+
+    *client = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if (*client != INVALID_SOCKET &&
+        connect(*client, (SOCKADDR *)&addr, sizeof(addr)) != SOCKET_ERROR)
+    {
+        *server = accept(listener, NULL, NULL);
+    }
+
+    closesocket(listener);
+
+    if (*server == INVALID_SOCKET)
+    {
+        if (*client != INVALID_SOCKET)
+            closesocket(*client);
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+static
+BOOL
+FindConnection(SOCKET client, PMIB_TCPROW Row)
+{
+    PMIB_TCPTABLE TcpTable;
+    struct sockaddr_in local, remote;
+    int addrlen;
+    DWORD Size = 0, i;
+    BOOL Found = FALSE;
+
+    addrlen = sizeof(local);
+    if (getsockname(client, (SOCKADDR *)&local, &addrlen) == SOCKET_ERROR)
+        return FALSE;
+    addrlen = sizeof(remote);
+    if (getpeername(client, (SOCKADDR *)&remote, &addrlen) == SOCKET_ERROR)
+        return FALSE;
+
+    if (GetTcpTable(NULL, &Size, FALSE) != ERROR_INSUFFICIENT_BUFFER)
+        return FALSE;
+
+    TcpTable = HeapAlloc(GetProcessHeap(), 0, Size);
+    if (!TcpTable)
+        return FALSE;
+
+    if (GetTcpTable(TcpTable, &Size, FALSE) == NO_ERROR)
+    {
+        for (i = 0; i < TcpTable->dwNumEntries; i++)
+        {
+            if (TcpTable->table[i].dwState == MIB_TCP_STATE_ESTAB &&
+                TcpTable->table[i].dwLocalPort == local.sin_port &&
+                TcpTable->table[i].dwRemotePort == remote.sin_port)
+            {
+                *Row = TcpTable->table[i];
+                Found = TRUE;
+                break;
+            }
+        }
+    }
+
+    HeapFree(GetProcessHeap(), 0, TcpTable);
+    return Found;
+}
+
+static
+VOID
+test_GetTcpStatistics(void)
+{
+    MIB_TCPSTATS Stats;
+    DWORD ret;
+
+    ret = GetTcpStatistics(NULL);
+    ok(ret == ERROR_INVALID_PARAMETER, "GetTcpStatistics returned %lu\n", ret);
+
+    ret = GetTcpStatistics(&Stats);
+    ok(ret == NO_ERROR, "GetTcpStatistics returned %lu\n", ret);
+    if (ret != NO_ERROR)
+        return;
+
+    /* The caller holds both ends of a connection */
+    ok(Stats.dwCurrEstab >= 2, "dwCurrEstab is %lu\n", Stats.dwCurrEstab);
+    ok(Stats.dwNumConns >= Stats.dwCurrEstab, "dwNumConns is %lu\n", Stats.dwNumConns);
+    ok(Stats.dwActiveOpens >= 1, "dwActiveOpens is %lu\n", Stats.dwActiveOpens);
+    ok(Stats.dwPassiveOpens >= 1, "dwPassiveOpens is %lu\n", Stats.dwPassiveOpens);
+    ok(Stats.dwInSegs > 0, "dwInSegs is %lu\n", Stats.dwInSegs);
+    ok(Stats.dwOutSegs > 0, "dwOutSegs is %lu\n", Stats.dwOutSegs);
+    ok(Stats.dwRtoMin <= Stats.dwRtoMax, "dwRtoMin %lu, dwRtoMax %lu\n", Stats.dwRtoMin, Stats.dwRtoMax);
+}
+
+static
+VOID
+test_GetPerTcpConnectionEStats(PMIB_TCPROW Row)
+{
+    TCP_ESTATS_DATA_RW_v0 Rw;
+    TCP_ESTATS_DATA_ROD_v0 Data;
+    TCP_ESTATS_PATH_ROD_v0 Path;
+    ULONG ret;
+
+    ret = pGetPerTcpConnectionEStats(NULL, TcpConnectionEstatsData,
+                                     NULL, 0, 0, NULL, 0, 0,
+                                     (PUCHAR)&Data, 0, sizeof(Data));
+    ok(ret == ERROR_INVALID_PARAMETER, "GetPerTcpConnectionEStats returned %lu\n", ret);
+
+    ret = pGetPerTcpConnectionEStats(Row, TcpConnectionEstatsData,
+                                     NULL, 0, 0, NULL, 0, 0,
+                                     (PUCHAR)&Data, 0, sizeof(Data) - 1);
+    ok(ret == ERROR_INVALID_PARAMETER, "GetPerTcpConnectionEStats returned %lu\n", ret);
+
+    ZeroMemory(&Rw, sizeof(Rw));
+    ret = pGetPerTcpConnectionEStats(Row, TcpConnectionEstatsData,
+                                     (PUCHAR)&Rw, 0, sizeof(Rw), NULL, 0, 0,
+                                     (PUCHAR)&Data, 0, sizeof(Data));
+    ok(ret == NO_ERROR, "GetPerTcpConnectionEStats returned %lu\n", ret);
+    if (ret != NO_ERROR)
+        return;
+
+    /* Windows only collects once SetPerTcpConnectionEStats enabled it */
+    if (!Rw.EnableCollection)
+    {
+        skip("Collection is not enabled\n");
+        return;
+    }
+
+    ok(Data.DataBytesOut >= TRANSFER_SIZE, "DataBytesOut is %I64u\n", Data.DataBytesOut);
+    ok(Data.DataSegsOut > 0, "DataSegsOut is %I64u\n", Data.DataSegsOut);
+    ok(Data.SegsOut >= Data.DataSegsOut, "SegsOut is %I64u\n", Data.SegsOut);
+    ok(Data.SegsIn > 0, "SegsIn is %I64u\n", Data.SegsIn);
+    ok(Data.ThruBytesAcked >= TRANSFER_SIZE, "ThruBytesAcked is %I64u\n", Data.ThruBytesAcked);
+    /* Acknowledgments may still be in flight, SndUna never passes SndNxt though */
+    ok((LONG)(Data.SndNxt - Data.SndUna) >= 0, "SndUna %lu, SndNxt %lu\n", Data.SndUna, Data.SndNxt);
+
+    ret = pGetPerTcpConnectionEStats(Row, TcpConnectionEstatsPath,
+                                     NULL, 0, 0, NULL, 0, 0,
+                                     (PUCHAR)&Path, 0, sizeof(Path));
+    ok(ret == NO_ERROR, "GetPerTcpConnectionEStats returned %lu\n", ret);
+    if (ret == NO_ERROR)
+    {
+        ok(Path.CurMss > 0, "CurMss is %lu\n", Path.CurMss);
+        ok(Path.CountRtt == 0 || Path.MinRtt <= Path.MaxRtt,
+           "MinRtt %lu, MaxRtt %lu\n", Path.MinRtt, Path.MaxRtt);
+    }
+}
+
+START_TEST(GetPerTcpConnectionEStats)
+{
+    WSADATA wsaData;
+    SOCKET client, server;
+    MIB_TCPROW Row;
+    char *Buffer;
+    int ret, received;
+
+    if (WSAStartup(MAKEWORD(2, 2), &wsaData) != 0)
+    {
+        skip("Failed to init WS2\n");
+        return;
+    }
+
+    Buffer = HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY, TRANSFER_SIZE);
+    if (!Buffer || !CreateConnection(&client, &server))
+    {
+        skip("Cannot create a connection\n");
+        goto quit;
+    }
+
+    /* Move some data so there is something to count */
+    ret = send(client, Buffer, TRANSFER_SIZE, 0);
+    ok(ret == TRANSFER_SIZE, "send returned %d, error %d\n", ret, WSAGetLastError());
+    for (received = 0; received < TRANSFER_SIZE; received += ret)
+    {
+        ret = recv(server, Buffer, TRANSFER_SIZE - received, 0);
+        if (ret <= 0)
+            break;
+    }
+    ok(received == TRANSFER_SIZE, "Received %d bytes\n", received);
+
+    test_GetTcpStatistics();
+
+    pGetPerTcpConnectionEStats = (void *)GetProcAddress(GetModuleHandleW(L"iphlpapi.dll"),
+                                                        "GetPerTcpConnectionEStats");
+    if (!pGetPerTcpConnectionEStats)
+        skip("GetPerTcpConnectionEStats not found\n");
+    else if (!FindConnection(client, &Row))
+        skip("Our connection wasn't found!\n");
+    else
+        test_GetPerTcpConnectionEStats(&Row);
+
+    closesocket(server);
+    closesocket(client);
+quit:
+    if (Buffer)
+        HeapFree(GetProcessHeap(), 0, Buffer);
+    WSACleanup();
+}
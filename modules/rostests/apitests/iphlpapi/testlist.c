@@ -9,6 +9,7 @@ extern void func_GetInterfaceName(void);
 extern void func_GetNetworkParams(void);
 extern void func_GetOwnerModuleFromTcpEntry(void);
 extern void func_GetOwnerModuleFromUdpEntry(void);
+extern void func_GetPerTcpConnectionEStats(void);
 extern void func_icmp(void);
 extern void func_SendARP(void);
 
@@ -20,6 +21,7 @@ const struct test winetest_testlist[] =
     { "GetNetworkParams",           func_GetNetworkParams },
     { "GetOwnerModuleFromTcpEntry", func_GetOwnerModuleFromTcpEntry },
     { "GetOwnerModuleFromUdpEntry", func_GetOwnerModuleFromUdpEntry },
+    { "GetPerTcpConnectionEStats",  func_GetPerTcpConnectionEStats },
     { "icmp",                       func_icmp },
     { "SendARP",                    func_SendARP },
 
@@ -0,0 +1,295 @@
+/*
+ * PROJECT:     ReactOS api tests
+ * LICENSE:     GPL-2.0-or-later (https://spdx.org/licenses/GPL-2.0-or-later)
+ * PURPOSE:     Tests for byte-range locks with many locks and contending threads
+ */
+
+#include "precomp.h"
+
+#define TEST_LOCK_COUNT     4096
+#define TEST_LOCK_SPACING   32
+#define TEST_LOCK_LENGTH    16
+#define TEST_READS          20000
+#define TEST_THREADS        4
+#define TEST_SLOTS          64
+#define TEST_SLOT_LENGTH    8
+#define TEST_ITERATIONS     5000
+
+/* Exclusive holders count in the high word, shared ones in the low word */
+#define EXCLUSIVE_HOLDER    0x10000
+
+static CHAR FileName[MAX_PATH];
+static volatile LONG SlotHolders[TEST_SLOTS];
+static volatile LONG Violations;
+static HANDLE StartEvent;
+
+static
+HANDLE
+OpenTestFile(VOID)
+{
+    return CreateFileA(FileName,
+                       GENERIC_READ | GENERIC_WRITE,
+                       FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                       NULL,
+                       OPEN_EXISTING,
+                       FILE_ATTRIBUTE_NORMAL,
+                       NULL);
+}
+
+static
+BOOL
+ReadAt(
+    _In_ HANDLE Handle,
+    _In_ ULONG Offset,
+    _In_ ULONG Length)
+{
+    CHAR Buffer[TEST_LOCK_SPACING];
+    OVERLAPPED Overlapped;
+    DWORD Read;
+
+    ZeroMemory(&Overlapped, sizeof(Overlapped));
+    Overlapped.Offset = Offset;
+    return ReadFile(Handle, Buffer, Length, &Read, &Overlapped);
+}
+
+static
+BOOL
+LockAt(
+    _In_ HANDLE Handle,
+    _In_ DWORD Flags,
+    _In_ ULONG Offset,
+    _In_ ULONG Length)
+{
+    OVERLAPPED Overlapped;
+
+    ZeroMemory(&Overlapped, sizeof(Overlapped));
+    Overlapped.Offset = Offset;
+    return LockFileEx(Handle, Flags, 0, Length, 0, &Overlapped);
+}
+
+static
+BOOL
+UnlockAt(
+    _In_ HANDLE Handle,
+    _In_ ULONG Offset,
+    _In_ ULONG Length)
+{
+    OVERLAPPED Overlapped;
+
+    ZeroMemory(&Overlapped, sizeof(Overlapped));
+    Overlapped.Offset = Offset;
+    return UnlockFileEx(Handle, 0, Length, 0, &Overlapped);
+}
+
+static
+VOID
+TestManyLocks(VOID)
+{
+    HANDLE Locker, Reader;
+    ULONG i, Start, Elapsed;
+    BOOL Ret;
+
+    Locker = OpenTestFile();
+    Reader = OpenTestFile();
+    ok(Locker != INVALID_HANDLE_VALUE, "Failed to open the file (%lu)\n", GetLastError());
+    ok(Reader != INVALID_HANDLE_VALUE, "Failed to open the file (%lu)\n", GetLastError());
+    if (Locker == INVALID_HANDLE_VALUE || Reader == INVALID_HANDLE_VALUE)
+    {
+        skip("No test file\n");
+        goto Quit;
+    }
+
+    /* Thousands of locks with gaps between them */
+    Start = GetTickCount();
+    for (i = 0; i < TEST_LOCK_COUNT; i++)
+    {
+        Ret = LockAt(Locker,
+                     LOCKFILE_EXCLUSIVE_LOCK | LOCKFILE_FAIL_IMMEDIATELY,
+                     i * TEST_LOCK_SPACING,
+                     TEST_LOCK_LENGTH);
+        if (!Ret)
+            break;
+    }
+    Elapsed = GetTickCount() - Start;
+    ok(i == TEST_LOCK_COUNT, "Lock %lu failed (%lu)\n", i, GetLastError());
+    trace("%lu locks taken in %lu ms\n", i, Elapsed);
+
+    /* Overlaps are refused, the gaps are free */
+    ok(!LockAt(Locker, LOCKFILE_FAIL_IMMEDIATELY, 100 * TEST_LOCK_SPACING + 8, TEST_LOCK_LENGTH),
+       "Overlapping lock succeeded\n");
+    ok(LockAt(Reader, LOCKFILE_FAIL_IMMEDIATELY, 100 * TEST_LOCK_SPACING + TEST_LOCK_LENGTH, TEST_LOCK_LENGTH),
+       "Lock in a gap failed (%lu)\n", GetLastError());
+    ok(UnlockAt(Reader, 100 * TEST_LOCK_SPACING + TEST_LOCK_LENGTH, TEST_LOCK_LENGTH),
+       "Unlock in a gap failed (%lu)\n", GetLastError());
+    ok(!UnlockAt(Reader, 100 * TEST_LOCK_SPACING, TEST_LOCK_LENGTH),
+       "Unlocking another handle's lock succeeded\n");
+
+    /* Only the locking handle can read the locked ranges */
+    SetLastError(0xdeadbeef);
+    ok(!ReadAt(Reader, 200 * TEST_LOCK_SPACING + 4, 4), "Read in a locked range succeeded\n");
+    ok(GetLastError() == ERROR_LOCK_VIOLATION, "GetLastError() = %lu\n", GetLastError());
+    ok(ReadAt(Locker, 200 * TEST_LOCK_SPACING + 4, 4), "Owner read failed (%lu)\n", GetLastError());
+
+    /* Every read has to be checked against the locks */
+    Start = GetTickCount();
+    for (i = 0; i < TEST_READS; i++)
+    {
+        Ret = ReadAt(Reader,
+                     (i % TEST_LOCK_COUNT) * TEST_LOCK_SPACING + TEST_LOCK_LENGTH,
+                     TEST_LOCK_SPACING - TEST_LOCK_LENGTH);
+        if (!Ret)
+            break;
+    }
+    Elapsed = GetTickCount() - Start;
+    ok(i == TEST_READS, "Read %lu failed (%lu)\n", i, GetLastError());
+    trace("%lu checked reads with %lu locks: %lu reads/s\n",
+          i,
+          (ULONG)TEST_LOCK_COUNT,
+          (ULONG)((ULONGLONG)i * 1000 / max(Elapsed, 1)));
+
+    /* Closing the handle drops all of its locks at once */
+    Start = GetTickCount();
+    CloseHandle(Locker);
+    Locker = INVALID_HANDLE_VALUE;
+    Elapsed = GetTickCount() - Start;
+    trace("Locks released in %lu ms\n", Elapsed);
+    ok(ReadAt(Reader, 200 * TEST_LOCK_SPACING + 4, 4), "Read after unlock failed (%lu)\n", GetLastError());
+
+Quit:
+    if (Locker != INVALID_HANDLE_VALUE)
+        CloseHandle(Locker);
+    if (Reader != INVALID_HANDLE_VALUE)
+        CloseHandle(Reader);
+}
+
+static
+DWORD
+WINAPI
+LockThread(
+    _In_ PVOID Parameter)
+{
+    HANDLE Handle;
+    ULONG Seed = PtrToUlong(Parameter);
+    ULONG i, Slot, Flags;
+    LONG Holders;
+
+    Handle = OpenTestFile();
+    ok(Handle != INVALID_HANDLE_VALUE, "Failed to open the file (%lu)\n", GetLastError());
+    WaitForSingleObject(StartEvent, INFINITE);
+    if (Handle == INVALID_HANDLE_VALUE)
+        return 0;
+
+    for (i = 0; i < TEST_ITERATIONS; i++)
+    {
+        Seed = Seed * 1103515245 + 12345;
+        Slot = (Seed >> 16) % TEST_SLOTS;
+
+        /* Mostly shared and immediate, some exclusive locks have to wait */
+        Flags = 0;
+        if ((Seed & 3) == 0)
+            Flags |= LOCKFILE_EXCLUSIVE_LOCK;
+        if ((Seed & 0xC) != 0)
+            Flags |= LOCKFILE_FAIL_IMMEDIATELY;
+
+        if (!LockAt(Handle, Flags, Slot * TEST_SLOT_LENGTH, TEST_SLOT_LENGTH))
+        {
+            if (GetLastError() != ERROR_LOCK_VIOLATION)
+                InterlockedIncrement(&Violations);
+            continue;
+        }
+
+        /* Nobody else may hold an exclusive lock on the slot, nor any lock if ours is exclusive */
+        if (Flags & LOCKFILE_EXCLUSIVE_LOCK)
+        {
+            Holders = InterlockedExchangeAdd(&SlotHolders[Slot], EXCLUSIVE_HOLDER);
+            if (Holders != 0)
+                InterlockedIncrement(&Violations);
+            InterlockedExchangeAdd(&SlotHolders[Slot], -EXCLUSIVE_HOLDER);
+        }
+        else
+        {
+            Holders = InterlockedIncrement(&SlotHolders[Slot]);
+            if (Holders >= EXCLUSIVE_HOLDER)
+                InterlockedIncrement(&Violations);
+            InterlockedDecrement(&SlotHolders[Slot]);
+        }
+
+        if (!UnlockAt(Handle, Slot * TEST_SLOT_LENGTH, TEST_SLOT_LENGTH))
+            InterlockedIncrement(&Violations);
+    }
+
+    CloseHandle(Handle);
+    return 0;
+}
+
+static
+VOID
+TestLockContention(VOID)
+{
+    HANDLE Threads[TEST_THREADS];
+    ULONG i, Start, Elapsed;
+
+    StartEvent = CreateEventW(NULL, TRUE, FALSE, NULL);
+    ok(StartEvent != NULL, "CreateEventW failed\n");
+    if (!StartEvent)
+        return;
+
+    for (i = 0; i < TEST_THREADS; i++)
+    {
+        Threads[i] = CreateThread(NULL, 0, LockThread, UlongToPtr(i + 1), 0, NULL);
+        ok(Threads[i] != NULL, "CreateThread failed (%lu)\n", GetLastError());
+        if (!Threads[i])
+        {
+            skip("No thread\n");
+            SetEvent(StartEvent);
+            WaitForMultipleObjects(i, Threads, TRUE, INFINITE);
+            goto Quit;
+        }
+    }
+
+    Start = GetTickCount();
+    SetEvent(StartEvent);
+    WaitForMultipleObjects(TEST_THREADS, Threads, TRUE, INFINITE);
+    Elapsed = GetTickCount() - Start;
+
+    ok(Violations == 0, "%ld lock violations\n", Violations);
+    trace("%lu threads on %lu slots: %lu lock/unlock pairs/s\n",
+          (ULONG)TEST_THREADS,
+          (ULONG)TEST_SLOTS,
+          (ULONG)((ULONGLONG)TEST_THREADS * TEST_ITERATIONS * 1000 / max(Elapsed, 1)));
+
+Quit:
+    while (i--)
+        CloseHandle(Threads[i]);
+    CloseHandle(StartEvent);
+}
+
+START_TEST(LockFile)
+{
+    CHAR TempPath[MAX_PATH];
+    HANDLE Handle;
+
+    GetTempPathA(_countof(TempPath), TempPath);
+    if (!GetTempFileNameA(TempPath, "lck", 0, FileName))
+    {
+        skip("GetTempFileNameA failed (%lu)\n", GetLastError());
+        return;
+    }
+
+    /* Make the file large enough for all the ranges */
+    Handle = OpenTestFile();
+    ok(Handle != INVALID_HANDLE_VALUE, "Failed to open the file (%lu)\n", GetLastError());
+    if (Handle == INVALID_HANDLE_VALUE)
+    {
+        DeleteFileA(FileName);
+        return;
+    }
+    SetFilePointer(Handle, TEST_LOCK_COUNT * TEST_LOCK_SPACING, NULL, FILE_BEGIN);
+    ok(SetEndOfFile(Handle), "SetEndOfFile failed (%lu)\n", GetLastError());
+    CloseHandle(Handle);
+
+    TestManyLocks();
+    TestLockContention();
+
+    ok(DeleteFileA(FileName), "DeleteFileA failed (%lu)\n", GetLastError());
+}
@@ -0,0 +1,284 @@
+/*
+ * PROJECT:     ReactOS api tests
+ * LICENSE:     GPL-2.0-or-later (https://spdx.org/licenses/GPL-2.0-or-later)
+ * PURPOSE:     Tests for the scenario files saved by the kernel prefetcher
+ */
+
+#include "precomp.h"
+
+#define TEST_PAGES          64
+#define TEST_PAGE_SIZE      4096
+#define TEST_WAIT_SECONDS   40
+
+/* Scenario file layout, see ntoskrnl/cc/prefetch.c */
+#define PF_ROS_TRACE_MAGIC      'SORP'
+#define PF_ROS_TRACE_VERSION    2
+#define PF_LOG_ENTRY_DATA       0
+#define PF_MAX_ENTRY_AGE        8
+
+typedef struct _PF_SCENARIO_ID
+{
+    WCHAR ScenName[30];
+    ULONG HashId;
+} PF_SCENARIO_ID;
+
+typedef struct _PF_LOG_ENTRY
+{
+    ULONG FileOffset:30;
+    ULONG Type:2;
+    ULONG FileKey;
+} PF_LOG_ENTRY, *PPF_LOG_ENTRY;
+
+typedef struct _PF_TRACE_HEADER
+{
+    ULONG Version;
+    ULONG MagicNumber;
+    ULONG Size;
+    PF_SCENARIO_ID ScenarioId;
+    ULONG ScenarioType;
+    ULONG EventEntryIdxs[8];
+    ULONG NumEventEntryIdxs;
+    ULONG TraceBufferOffset;
+    ULONG NumEntries;
+    ULONG SectionInfoOffset;
+    ULONG NumSections;
+    ULONG FaultsPerPeriod[10];
+    LARGE_INTEGER LaunchTime;
+    ULONGLONG Reserved[5];
+} PF_TRACE_HEADER, *PPF_TRACE_HEADER;
+
+typedef struct _PF_ROS_FILE_INFO
+{
+    ULONG NameOffset;
+    USHORT NameLength;
+    USHORT Reserved;
+} PF_ROS_FILE_INFO, *PPF_ROS_FILE_INFO;
+
+static const WCHAR ChildName[] = L"PFTEST.EXE";
+static const WCHAR DataName[] = L"\\PFTEST_DATA.BIN";
+
+/* Reads the whole data file at once, so the cache faults it in as one range */
+static
+VOID
+RunChild(
+    _In_ PCSTR DataPath)
+{
+    HANDLE Handle;
+    PVOID Buffer;
+    DWORD Read;
+
+    Handle = CreateFileA(DataPath, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, 0, NULL);
+    Buffer = HeapAlloc(GetProcessHeap(), 0, TEST_PAGES * TEST_PAGE_SIZE);
+    if (Handle != INVALID_HANDLE_VALUE && Buffer)
+        ReadFile(Handle, Buffer, TEST_PAGES * TEST_PAGE_SIZE, &Read, NULL);
+    if (Buffer)
+        HeapFree(GetProcessHeap(), 0, Buffer);
+    if (Handle != INVALID_HANDLE_VALUE)
+        CloseHandle(Handle);
+}
+
+/* Writes the data file without going through the cache, so that nothing of it is resident */
+static
+BOOL
+CreateDataFile(
+    _In_ PCWSTR DataPath)
+{
+    HANDLE Handle;
+    PUCHAR Buffer;
+    DWORD Written = 0;
+
+    Buffer = VirtualAlloc(NULL, TEST_PAGES * TEST_PAGE_SIZE, MEM_COMMIT, PAGE_READWRITE);
+    if (!Buffer)
+        return FALSE;
+    FillMemory(Buffer, TEST_PAGES * TEST_PAGE_SIZE, 0x5A);
+
+    Handle = CreateFileW(DataPath,
+                         GENERIC_WRITE,
+                         0,
+                         NULL,
+                         CREATE_ALWAYS,
+                         FILE_FLAG_NO_BUFFERING | FILE_FLAG_WRITE_THROUGH,
+                         NULL);
+    if (Handle != INVALID_HANDLE_VALUE)
+    {
+        WriteFile(Handle, Buffer, TEST_PAGES * TEST_PAGE_SIZE, &Written, NULL);
+        CloseHandle(Handle);
+    }
+
+    VirtualFree(Buffer, 0, MEM_RELEASE);
+    return Written == TEST_PAGES * TEST_PAGE_SIZE;
+}
+
+/* Finds the scenario of the child saved after the given time */
+static
+PPF_TRACE_HEADER
+LoadScenario(
+    _In_ PCWSTR PrefetchDir,
+    _In_ const FILETIME *After,
+    _Out_ PULONG Size)
+{
+    WCHAR Pattern[MAX_PATH], Path[MAX_PATH];
+    WIN32_FIND_DATAW FindData;
+    PPF_TRACE_HEADER Scenario = NULL;
+    HANDLE Find, Handle;
+    DWORD Read;
+
+    StringCbPrintfW(Pattern, sizeof(Pattern), L"%ls\\%ls-*.pf", PrefetchDir, ChildName);
+    Find = FindFirstFileW(Pattern, &FindData);
+    if (Find == INVALID_HANDLE_VALUE)
+        return NULL;
+
+    do
+    {
+        if (CompareFileTime(&FindData.ftLastWriteTime, After) < 0 ||
+            FindData.nFileSizeLow < sizeof(PF_TRACE_HEADER))
+        {
+            continue;
+        }
+
+        StringCbPrintfW(Path, sizeof(Path), L"%ls\\%ls", PrefetchDir, FindData.cFileName);
+        Handle = CreateFileW(Path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, 0, NULL);
+        if (Handle == INVALID_HANDLE_VALUE)
+            continue;
+
+        Scenario = HeapAlloc(GetProcessHeap(), 0, FindData.nFileSizeLow);
+        if (Scenario &&
+            (!ReadFile(Handle, Scenario, FindData.nFileSizeLow, &Read, NULL) ||
+             Read != FindData.nFileSizeLow))
+        {
+            HeapFree(GetProcessHeap(), 0, Scenario);
+            Scenario = NULL;
+        }
+        *Size = FindData.nFileSizeLow;
+        CloseHandle(Handle);
+    } while (!Scenario && FindNextFileW(Find, &FindData));
+
+    FindClose(Find);
+    return Scenario;
+}
+
+static
+VOID
+CheckScenario(
+    _In_ PPF_TRACE_HEADER Scenario,
+    _In_ ULONG Size)
+{
+    PPF_ROS_FILE_INFO FileInfo;
+    PPF_LOG_ENTRY Entries;
+    PUCHAR Ages;
+    ULONG i, DataKey = MAXULONG, DataPages = 0;
+    USHORT NameLength = (USHORT)(wcslen(DataName) * sizeof(WCHAR));
+    PWCHAR Name;
+
+    ok(Scenario->MagicNumber == PF_ROS_TRACE_MAGIC, "MagicNumber = 0x%lx\n", Scenario->MagicNumber);
+    ok(Scenario->Version == PF_ROS_TRACE_VERSION, "Version = %lu\n", Scenario->Version);
+    ok(Scenario->Size == Size, "Size = %lu, expected %lu\n", Scenario->Size, Size);
+    if (Scenario->MagicNumber != PF_ROS_TRACE_MAGIC ||
+        Scenario->Version != PF_ROS_TRACE_VERSION ||
+        Scenario->Size != Size ||
+        Scenario->SectionInfoOffset + Scenario->NumSections * sizeof(PF_ROS_FILE_INFO) > Size ||
+        Scenario->TraceBufferOffset + Scenario->NumEntries * (sizeof(PF_LOG_ENTRY) + 1) > Size)
+    {
+        skip("Unexpected scenario layout\n");
+        return;
+    }
+
+    /* The data file is saved by its NT path */
+    FileInfo = (PPF_ROS_FILE_INFO)((ULONG_PTR)Scenario + Scenario->SectionInfoOffset);
+    for (i = 0; i < Scenario->NumSections; i++)
+    {
+        if (FileInfo[i].NameLength < NameLength ||
+            FileInfo[i].NameOffset + FileInfo[i].NameLength > Size)
+        {
+            continue;
+        }
+        Name = (PWCHAR)((ULONG_PTR)Scenario + FileInfo[i].NameOffset + FileInfo[i].NameLength - NameLength);
+        if (!_wcsnicmp(Name, DataName, NameLength / sizeof(WCHAR)))
+            DataKey = i;
+    }
+    ok(DataKey != MAXULONG, "The data file is missing from %lu files\n", Scenario->NumSections);
+
+    Entries = (PPF_LOG_ENTRY)((ULONG_PTR)Scenario + Scenario->TraceBufferOffset);
+    Ages = (PUCHAR)&Entries[Scenario->NumEntries];
+    for (i = 0; i < Scenario->NumEntries; i++)
+    {
+        ok(Ages[i] < PF_MAX_ENTRY_AGE, "Entry %lu has age %u\n", i, Ages[i]);
+        if (Entries[i].FileKey == DataKey && Entries[i].Type == PF_LOG_ENTRY_DATA)
+        {
+            /* Nothing was replayed for the first run */
+            ok(Ages[i] == 0, "Data page %lu has age %u\n", (ULONG)Entries[i].FileOffset, Ages[i]);
+            DataPages++;
+        }
+    }
+
+    /* Every page of the read was logged, not only the first one */
+    ok(DataPages == TEST_PAGES, "Logged %lu data pages, expected %u\n", DataPages, TEST_PAGES);
+}
+
+START_TEST(Prefetch)
+{
+    WCHAR TempPath[MAX_PATH], ChildPath[MAX_PATH], DataPath[MAX_PATH];
+    WCHAR SelfPath[MAX_PATH], PrefetchDir[MAX_PATH], CommandLine[3 * MAX_PATH];
+    STARTUPINFOW StartupInfo;
+    PROCESS_INFORMATION ProcessInfo;
+    PPF_TRACE_HEADER Scenario = NULL;
+    FILETIME Start;
+    ULONG Size = 0, i;
+    char **argv;
+    int argc;
+
+    argc = winetest_get_mainargs(&argv);
+    if (argc >= 4 && !strcmp(argv[2], "child"))
+    {
+        RunChild(argv[3]);
+        return;
+    }
+
+    GetTempPathW(_countof(TempPath), TempPath);
+    StringCbPrintfW(ChildPath, sizeof(ChildPath), L"%ls%ls", TempPath, ChildName);
+    StringCbPrintfW(DataPath, sizeof(DataPath), L"%ls%ls", TempPath, DataName + 1);
+    GetWindowsDirectoryW(PrefetchDir, _countof(PrefetchDir));
+    StringCbCatW(PrefetchDir, sizeof(PrefetchDir), L"\\Prefetch");
+
+    /* A copy of ourselves gets a scenario of its own */
+    GetModuleFileNameW(NULL, SelfPath, _countof(SelfPath));
+    if (!CopyFileW(SelfPath, ChildPath, FALSE) || !CreateDataFile(DataPath))
+    {
+        skip("Failed to create the test files (%lu)\n", GetLastError());
+        goto Quit;
+    }
+
+    StringCbPrintfW(CommandLine, sizeof(CommandLine), L"\"%ls\" Prefetch child \"%ls\"", ChildPath, DataPath);
+    ZeroMemory(&StartupInfo, sizeof(StartupInfo));
+    StartupInfo.cb = sizeof(StartupInfo);
+
+    GetSystemTimeAsFileTime(&Start);
+    if (!CreateProcessW(ChildPath, CommandLine, NULL, NULL, FALSE, 0, NULL, NULL, &StartupInfo, &ProcessInfo))
+    {
+        skip("CreateProcess failed (%lu)\n", GetLastError());
+        goto Quit;
+    }
+    WaitForSingleObject(ProcessInfo.hProcess, INFINITE);
+    CloseHandle(ProcessInfo.hThread);
+    CloseHandle(ProcessInfo.hProcess);
+
+    /* The launch is traced for a while, then saved by a worker */
+    for (i = 0; !Scenario && i < TEST_WAIT_SECONDS; i++)
+    {
+        Sleep(1000);
+        Scenario = LoadScenario(PrefetchDir, &Start, &Size);
+    }
+
+    if (!Scenario)
+    {
+        skip("No scenario was saved, the prefetcher may be disabled\n");
+        goto Quit;
+    }
+
+    CheckScenario(Scenario, Size);
+    HeapFree(GetProcessHeap(), 0, Scenario);
+
+Quit:
+    DeleteFileW(ChildPath);
+    DeleteFileW(DataPath);
+}
@@ -0,0 +1,100 @@
+/*
+ * PROJECT:     ReactOS API Tests
+ * LICENSE:     LGPL-2.0-or-later (https://spdx.org/licenses/LGPL-2.0-or-later)
+ * PURPOSE:     Test for LdrFindEntryForAddress and RtlPcToFileHeader
+ */
+
+#include "precomp.h"
+
+static
+VOID
+TestModule(
+    _In_ PLDR_DATA_TABLE_ENTRY LdrEntry)
+{
+    PLDR_DATA_TABLE_ENTRY Found;
+    NTSTATUS Status;
+    PVOID Base;
+    PUCHAR Start = LdrEntry->DllBase;
+    PUCHAR End = Start + LdrEntry->SizeOfImage;
+
+    Found = NULL;
+    Status = LdrFindEntryForAddress(Start, &Found);
+    ok_ntstatus(Status, STATUS_SUCCESS);
+    ok(Found == LdrEntry, "%wZ: got %p, expected %p\n", &LdrEntry->BaseDllName, Found, LdrEntry);
+
+    Found = NULL;
+    Status = LdrFindEntryForAddress(End - 1, &Found);
+    ok_ntstatus(Status, STATUS_SUCCESS);
+    ok(Found == LdrEntry, "%wZ: got %p, expected %p\n", &LdrEntry->BaseDllName, Found, LdrEntry);
+
+    /* The byte after the image belongs to another module, if any */
+    Found = NULL;
+    Status = LdrFindEntryForAddress(End, &Found);
+    ok(Found != LdrEntry, "%wZ: found past the end of the image\n", &LdrEntry->BaseDllName);
+
+    Base = InvalidPointer;
+    ok_ptr(RtlPcToFileHeader(Start + LdrEntry->SizeOfImage / 2, &Base), Start);
+    ok_ptr(Base, Start);
+}
+
+START_TEST(LdrFindEntryForAddress)
+{
+    PLIST_ENTRY ListHead, Entry;
+    PLDR_DATA_TABLE_ENTRY LdrEntry, Found;
+    NTSTATUS Status;
+    HMODULE hMod;
+    PVOID Base;
+    ULONG i, Count = 0;
+    DWORD Start;
+
+    ListHead = &NtCurrentPeb()->Ldr->InLoadOrderModuleList;
+    for (Entry = ListHead->Flink; Entry != ListHead; Entry = Entry->Flink)
+    {
+        LdrEntry = CONTAINING_RECORD(Entry, LDR_DATA_TABLE_ENTRY, InLoadOrderLinks);
+        TestModule(LdrEntry);
+        Count++;
+    }
+    ok(Count >= 2, "Only %lu modules loaded\n", Count);
+
+    /* Addresses outside of any image */
+    Found = InvalidPointer;
+    Status = LdrFindEntryForAddress(NULL, &Found);
+    ok_ntstatus(Status, STATUS_NO_MORE_ENTRIES);
+    Base = InvalidPointer;
+    ok_ptr(RtlPcToFileHeader(&Count, &Base), NULL);
+    ok_ptr(Base, NULL);
+
+    /* A module that gets loaded and unloaded again */
+    if (GetModuleHandleW(L"dbghelp.dll"))
+    {
+        skip("dbghelp.dll is already loaded\n");
+    }
+    else
+    {
+        hMod = LoadLibraryW(L"dbghelp.dll");
+        ok(hMod != NULL, "LoadLibraryW failed with %lu\n", GetLastError());
+        if (hMod)
+        {
+            Found = NULL;
+            Status = LdrFindEntryForAddress((PUCHAR)hMod + 0x100, &Found);
+            ok_ntstatus(Status, STATUS_SUCCESS);
+            ok(Found && Found->DllBase == hMod, "Found %p\n", Found);
+            if (Found)
+                TestModule(Found);
+
+            ok(FreeLibrary(hMod), "FreeLibrary failed\n");
+
+            Found = InvalidPointer;
+            Status = LdrFindEntryForAddress((PUCHAR)hMod + 0x100, &Found);
+            ok_ntstatus(Status, STATUS_NO_MORE_ENTRIES);
+            Base = InvalidPointer;
+            ok_ptr(RtlPcToFileHeader((PUCHAR)hMod + 0x100, &Base), NULL);
+        }
+    }
+
+    /* Lookup cost, for comparison across module counts */
+    Start = GetTickCount();
+    for (i = 0; i < 100000; i++)
+        RtlPcToFileHeader((PVOID)TestModule, &Base);
+    trace("100000 lookups with %lu modules took %lu ms\n", Count, GetTickCount() - Start);
+}
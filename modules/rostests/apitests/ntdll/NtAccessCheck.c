@@ -182,7 +182,253 @@ Quit:
     }
 }
 
+#define TEST_DOMAIN_RID_BASE    1000
+#define TEST_OTHER_RID_BASE     100000
+#define TEST_ACE_COUNT          256
+#define TEST_ITERATIONS         2000
+
+static
+PSID
+AllocateDomainSid(
+    _In_ ULONG Rid)
+{
+    NTSTATUS Status;
+    PSID Sid;
+    static SID_IDENTIFIER_AUTHORITY NtAuthority = {SECURITY_NT_AUTHORITY};
+
+    Status = RtlAllocateAndInitializeSid(&NtAuthority,
+                                         5,
+                                         SECURITY_NT_NON_UNIQUE,
+                                         1111,
+                                         2222,
+                                         3333,
+                                         Rid,
+                                         0,
+                                         0,
+                                         0,
+                                         &Sid);
+    return NT_SUCCESS(Status) ? Sid : NULL;
+}
+
+static
+ULONG
+AccessCheckLargeTokenRun(
+    _In_ HANDLE Token,
+    _In_ ULONG SidCount)
+{
+    NTSTATUS Status;
+    NTSTATUS AccessStatus;
+    ACCESS_MASK GrantedAccess;
+    PPRIVILEGE_SET PrivilegeSet = NULL;
+    ULONG PrivilegeSetLength;
+    HANDLE RestrictedToken = NULL;
+    PTOKEN_GROUPS RestrictedSids = NULL;
+    PSID Sids[TEST_ACE_COUNT + 1];
+    PACL Dacl = NULL;
+    ULONG DaclSize;
+    SECURITY_DESCRIPTOR Sd;
+    PSID WorldSid = NULL;
+    ULONG i, Start, Elapsed, Rate = 0;
+    static SID_IDENTIFIER_AUTHORITY WorldAuthority = {SECURITY_WORLD_SID_AUTHORITY};
+    static GENERIC_MAPPING Mapping = {0x1, 0x2, 0x0, 0x3};
+
+    RtlZeroMemory(Sids, sizeof(Sids));
+
+    PrivilegeSetLength = FIELD_OFFSET(PRIVILEGE_SET, Privilege[16]);
+    PrivilegeSet = RtlAllocateHeap(RtlGetProcessHeap(), 0, PrivilegeSetLength);
+    RestrictedSids = RtlAllocateHeap(RtlGetProcessHeap(),
+                                     HEAP_ZERO_MEMORY,
+                                     FIELD_OFFSET(TOKEN_GROUPS, Groups[SidCount]));
+    if (PrivilegeSet == NULL || RestrictedSids == NULL)
+    {
+        skip("Failed to allocate memory, skipping tests\n");
+        goto Quit;
+    }
+
+    Status = RtlAllocateAndInitializeSid(&WorldAuthority,
+                                         1,
+                                         SECURITY_WORLD_RID,
+                                         0,
+                                         0,
+                                         0,
+                                         0,
+                                         0,
+                                         0,
+                                         0,
+                                         &WorldSid);
+    if (!NT_SUCCESS(Status))
+    {
+        skip("Failed to create World SID, skipping tests\n");
+        goto Quit;
+    }
+
+    /* Restrict the token to many SIDs of a made up domain */
+    RestrictedSids->GroupCount = SidCount;
+    for (i = 0; i < SidCount; i++)
+    {
+        RestrictedSids->Groups[i].Sid = AllocateDomainSid(TEST_DOMAIN_RID_BASE + i);
+        if (RestrictedSids->Groups[i].Sid == NULL)
+        {
+            skip("Failed to create restricted SID %lu, skipping tests\n", i);
+            goto Quit;
+        }
+    }
+
+    Status = NtFilterToken(Token,
+                           0,
+                           NULL,
+                           NULL,
+                           RestrictedSids,
+                           &RestrictedToken);
+    ok_hex(Status, STATUS_SUCCESS);
+    if (!NT_SUCCESS(Status))
+    {
+        skip("Failed to filter the token, skipping tests\n");
+        RestrictedToken = NULL;
+        goto Quit;
+    }
+
+    /*
+     * Build a long DACL where no ACE but the last one matches a restricted
+     * SID, and where the user and groups of the token only match the World
+     * ACE. Every check then has to look up every ACE SID in both lists.
+     */
+    DaclSize = sizeof(ACL);
+    for (i = 0; i < TEST_ACE_COUNT; i++)
+    {
+        Sids[i] = AllocateDomainSid(TEST_OTHER_RID_BASE + i);
+        if (Sids[i] == NULL)
+        {
+            skip("Failed to create ACE SID %lu, skipping tests\n", i);
+            goto Quit;
+        }
+        DaclSize += sizeof(ACCESS_ALLOWED_ACE) + RtlLengthSid(Sids[i]);
+    }
+    Sids[TEST_ACE_COUNT] = AllocateDomainSid(TEST_DOMAIN_RID_BASE + SidCount - 1);
+    if (Sids[TEST_ACE_COUNT] == NULL)
+    {
+        skip("Failed to create ACE SID, skipping tests\n");
+        goto Quit;
+    }
+    DaclSize += sizeof(ACCESS_ALLOWED_ACE) + RtlLengthSid(Sids[TEST_ACE_COUNT]);
+    DaclSize += sizeof(ACCESS_ALLOWED_ACE) + RtlLengthSid(WorldSid);
+
+    Dacl = RtlAllocateHeap(RtlGetProcessHeap(), HEAP_ZERO_MEMORY, DaclSize);
+    if (Dacl == NULL)
+    {
+        skip("Failed to allocate memory for DACL, skipping tests\n");
+        goto Quit;
+    }
+
+    Status = RtlCreateAcl(Dacl, DaclSize, ACL_REVISION);
+    ok_hex(Status, STATUS_SUCCESS);
+    for (i = 0; i <= TEST_ACE_COUNT; i++)
+    {
+        Status = RtlAddAccessAllowedAce(Dacl, ACL_REVISION, 0x1, Sids[i]);
+        ok_hex(Status, STATUS_SUCCESS);
+    }
+    Status = RtlAddAccessAllowedAce(Dacl, ACL_REVISION, 0x3, WorldSid);
+    ok_hex(Status, STATUS_SUCCESS);
+
+    RtlCreateSecurityDescriptor(&Sd, SECURITY_DESCRIPTOR_REVISION);
+    RtlSetGroupSecurityDescriptor(&Sd, WorldSid, FALSE);
+    RtlSetOwnerSecurityDescriptor(&Sd, WorldSid, FALSE);
+    RtlSetDaclSecurityDescriptor(&Sd, TRUE, Dacl, FALSE);
+
+    /* World grants both rights to the user, the last restricted SID only the first one */
+    Status = NtAccessCheck(&Sd,
+                           RestrictedToken,
+                           MAXIMUM_ALLOWED,
+                           &Mapping,
+                           PrivilegeSet,
+                           &PrivilegeSetLength,
+                           &GrantedAccess,
+                           &AccessStatus);
+    ok_hex(Status, STATUS_SUCCESS);
+    ok_hex(AccessStatus, STATUS_SUCCESS);
+    ok((GrantedAccess & 0x3) == 0x1, "GrantedAccess == 0x%08lx\n", GrantedAccess);
+
+    Start = GetTickCount();
+    for (i = 0; i < TEST_ITERATIONS; i++)
+    {
+        Status = NtAccessCheck(&Sd,
+                               RestrictedToken,
+                               MAXIMUM_ALLOWED,
+                               &Mapping,
+                               PrivilegeSet,
+                               &PrivilegeSetLength,
+                               &GrantedAccess,
+                               &AccessStatus);
+        if (!NT_SUCCESS(Status))
+            break;
+    }
+    Elapsed = GetTickCount() - Start;
+    ok_hex(Status, STATUS_SUCCESS);
+
+    /* Access checks per second */
+    Rate = (ULONG)((ULONGLONG)i * 1000 / max(Elapsed, 1));
+
+Quit:
+    if (Dacl)
+        RtlFreeHeap(RtlGetProcessHeap(), 0, Dacl);
+
+    for (i = 0; i <= TEST_ACE_COUNT; i++)
+    {
+        if (Sids[i])
+            RtlFreeSid(Sids[i]);
+    }
+
+    if (RestrictedToken)
+        NtClose(RestrictedToken);
+
+    if (RestrictedSids)
+    {
+        for (i = 0; i < SidCount; i++)
+        {
+            if (RestrictedSids->Groups[i].Sid)
+                RtlFreeSid(RestrictedSids->Groups[i].Sid);
+        }
+        RtlFreeHeap(RtlGetProcessHeap(), 0, RestrictedSids);
+    }
+
+    if (WorldSid)
+        RtlFreeSid(WorldSid);
+
+    if (PrivilegeSet)
+        RtlFreeHeap(RtlGetProcessHeap(), 0, PrivilegeSet);
+
+    return Rate;
+}
+
+static
+VOID
+AccessCheckLargeTokenTest(VOID)
+{
+    HANDLE Token;
+    ULONG SidCount, Rate;
+
+    Token = GetToken();
+    if (Token == NULL)
+    {
+        skip("Failed to get token, skipping tests\n");
+        return;
+    }
+
+    /* The cost of a check should barely depend on the number of SIDs in the token */
+    for (SidCount = 4; SidCount <= 1024; SidCount *= 4)
+    {
+        Rate = AccessCheckLargeTokenRun(Token, SidCount);
+        trace("%lu restricted SIDs, %lu ACEs: %lu checks/s\n",
+              SidCount,
+              TEST_ACE_COUNT + 2,
+              Rate);
+    }
+
+    NtClose(Token);
+}
+
 START_TEST(NtAccessCheck)
 {
     AccessCheckEmptyMappingTest();
+    AccessCheckLargeTokenTest();
 }
@@ -0,0 +1,279 @@
+/*
+ * PROJECT:     ReactOS API tests
+ * LICENSE:     LGPL-2.1-or-later (https://spdx.org/licenses/LGPL-2.1-or-later)
+ * PURPOSE:     Test for NtConnectPort with client and server section views
+ */
+
+#include "precomp.h"
+
+#include <process.h>
+
+#define TEST_VIEW_SIZE      0x10000
+#define TEST_PAYLOAD_SIZE   0x8000
+
+typedef struct _TEST_MESSAGE
+{
+    PORT_MESSAGE Header;
+    ULONG Offset;
+    ULONG Length;
+} TEST_MESSAGE, *PTEST_MESSAGE;
+
+static UNICODE_STRING PortName = RTL_CONSTANT_STRING(L"\\NtdllApitestNtConnectPortTestPort");
+
+static
+HANDLE
+CreateTestSection(VOID)
+{
+    NTSTATUS Status;
+    LARGE_INTEGER MaximumSize;
+    HANDLE SectionHandle;
+
+    MaximumSize.QuadPart = TEST_VIEW_SIZE;
+    Status = NtCreateSection(&SectionHandle,
+                             SECTION_ALL_ACCESS,
+                             NULL,
+                             &MaximumSize,
+                             PAGE_READWRITE,
+                             SEC_COMMIT,
+                             NULL);
+    ok_hex(Status, STATUS_SUCCESS);
+    return NT_SUCCESS(Status) ? SectionHandle : NULL;
+}
+
+static
+VOID
+FillPayload(
+    _Out_writes_bytes_(Length) PUCHAR Buffer,
+    _In_ ULONG Length,
+    _In_ UCHAR Seed)
+{
+    ULONG i;
+
+    for (i = 0; i < Length; i++)
+        Buffer[i] = (UCHAR)(i * 7 + Seed);
+}
+
+static
+BOOLEAN
+CheckPayload(
+    _In_reads_bytes_(Length) PUCHAR Buffer,
+    _In_ ULONG Length,
+    _In_ UCHAR Seed)
+{
+    ULONG i;
+
+    for (i = 0; i < Length; i++)
+    {
+        if (Buffer[i] != (UCHAR)(i * 7 + Seed))
+            return FALSE;
+    }
+
+    return TRUE;
+}
+
+static
+UINT
+CALLBACK
+ServerThread(
+    _Inout_ PVOID Parameter)
+{
+    NTSTATUS Status;
+    TEST_MESSAGE Message;
+    HANDLE PortHandle;
+    HANDLE ServerPortHandle = Parameter;
+    PORT_VIEW ServerView;
+    REMOTE_PORT_VIEW ClientView;
+
+    RtlZeroMemory(&Message, sizeof(Message));
+    Status = NtListenPort(ServerPortHandle, &Message.Header);
+    ok_hex(Status, STATUS_SUCCESS);
+    ok(Message.Header.ClientViewSize >= TEST_VIEW_SIZE,
+       "ClientViewSize = %Iu\n", Message.Header.ClientViewSize);
+
+    /* Accept with a view of our own section */
+    RtlZeroMemory(&ServerView, sizeof(ServerView));
+    ServerView.Length = sizeof(ServerView);
+    ServerView.SectionHandle = CreateTestSection();
+    ServerView.ViewSize = TEST_VIEW_SIZE;
+    RtlZeroMemory(&ClientView, sizeof(ClientView));
+    ClientView.Length = sizeof(ClientView);
+    Status = NtAcceptConnectPort(&PortHandle,
+                                 NULL,
+                                 &Message.Header,
+                                 TRUE,
+                                 &ServerView,
+                                 &ClientView);
+    ok_hex(Status, STATUS_SUCCESS);
+    NtClose(ServerView.SectionHandle);
+    if (!NT_SUCCESS(Status))
+        return 0;
+
+    ok(ServerView.ViewBase != NULL, "ViewBase = NULL\n");
+    ok(ServerView.ViewRemoteBase != NULL, "ViewRemoteBase = NULL\n");
+    ok(ServerView.ViewSize >= TEST_VIEW_SIZE, "ViewSize = %Iu\n", ServerView.ViewSize);
+    ok(ClientView.ViewBase != NULL, "ViewBase = NULL\n");
+    ok(ClientView.ViewSize >= TEST_VIEW_SIZE, "ViewSize = %Iu\n", ClientView.ViewSize);
+
+    Status = NtCompleteConnectPort(PortHandle);
+    ok_hex(Status, STATUS_SUCCESS);
+
+    /* The request only describes where the payload is in the client view */
+    RtlZeroMemory(&Message, sizeof(Message));
+    Status = NtReplyWaitReceivePort(PortHandle, NULL, NULL, &Message.Header);
+    ok_hex(Status, STATUS_SUCCESS);
+    ok(Message.Header.u2.s2.Type == LPC_REQUEST, "Type = %x\n", Message.Header.u2.s2.Type);
+    ok(Message.Offset == 0x100, "Offset = %lx\n", Message.Offset);
+    ok(Message.Length == TEST_PAYLOAD_SIZE, "Length = %lx\n", Message.Length);
+    if (ClientView.ViewBase && (Message.Length == TEST_PAYLOAD_SIZE))
+    {
+        ok(CheckPayload((PUCHAR)ClientView.ViewBase + Message.Offset, Message.Length, 1),
+           "Request payload mismatch\n");
+    }
+
+    /* Answer in our own view */
+    if (ServerView.ViewBase)
+        FillPayload(ServerView.ViewBase, TEST_PAYLOAD_SIZE, 2);
+    Message.Offset = 0;
+    Message.Length = TEST_PAYLOAD_SIZE;
+    Status = NtReplyPort(PortHandle, &Message.Header);
+    ok_hex(Status, STATUS_SUCCESS);
+
+    /* Wait for the client to go away */
+    Status = NtReplyWaitReceivePort(PortHandle, NULL, NULL, &Message.Header);
+    ok_hex(Status, STATUS_SUCCESS);
+    ok(Message.Header.u2.s2.Type == LPC_PORT_CLOSED, "Type = %x\n", Message.Header.u2.s2.Type);
+
+    Status = NtClose(PortHandle);
+    ok_hex(Status, STATUS_SUCCESS);
+
+    return 0;
+}
+
+static
+UINT
+CALLBACK
+ClientThread(
+    _Inout_ PVOID Parameter)
+{
+    NTSTATUS Status;
+    HANDLE PortHandle;
+    SECURITY_QUALITY_OF_SERVICE SecurityQos;
+    PORT_VIEW ClientView;
+    REMOTE_PORT_VIEW ServerView;
+    TEST_MESSAGE Request, Reply;
+
+    SecurityQos.Length = sizeof(SecurityQos);
+    SecurityQos.ImpersonationLevel = SecurityIdentification;
+    SecurityQos.EffectiveOnly = TRUE;
+    SecurityQos.ContextTrackingMode = SECURITY_STATIC_TRACKING;
+
+    RtlZeroMemory(&ClientView, sizeof(ClientView));
+    ClientView.Length = sizeof(ClientView);
+    ClientView.SectionHandle = CreateTestSection();
+    ClientView.ViewSize = TEST_VIEW_SIZE;
+    RtlZeroMemory(&ServerView, sizeof(ServerView));
+    ServerView.Length = sizeof(ServerView);
+    Status = NtConnectPort(&PortHandle,
+                           &PortName,
+                           &SecurityQos,
+                           &ClientView,
+                           &ServerView,
+                           NULL,
+                           NULL,
+                           NULL);
+    ok_hex(Status, STATUS_SUCCESS);
+    NtClose(ClientView.SectionHandle);
+    if (!NT_SUCCESS(Status))
+    {
+        skip("Failed to connect\n");
+        return 0;
+    }
+
+    ok(ClientView.ViewBase != NULL, "ViewBase = NULL\n");
+    ok(ClientView.ViewRemoteBase != NULL, "ViewRemoteBase = NULL\n");
+    ok(ClientView.ViewSize >= TEST_VIEW_SIZE, "ViewSize = %Iu\n", ClientView.ViewSize);
+    ok(ServerView.ViewBase != NULL, "ViewBase = NULL\n");
+    ok(ServerView.ViewSize >= TEST_VIEW_SIZE, "ViewSize = %Iu\n", ServerView.ViewSize);
+
+    /* Put the payload in our view and only send its location */
+    if (ClientView.ViewBase)
+        FillPayload((PUCHAR)ClientView.ViewBase + 0x100, TEST_PAYLOAD_SIZE, 1);
+    RtlZeroMemory(&Request, sizeof(Request));
+    Request.Header.u1.s1.TotalLength = sizeof(Request);
+    Request.Header.u1.s1.DataLength = sizeof(Request) - sizeof(Request.Header);
+    Request.Offset = 0x100;
+    Request.Length = TEST_PAYLOAD_SIZE;
+    RtlZeroMemory(&Reply, sizeof(Reply));
+    Status = NtRequestWaitReplyPort(PortHandle, &Request.Header, &Reply.Header);
+    ok_hex(Status, STATUS_SUCCESS);
+    ok(Reply.Offset == 0, "Offset = %lx\n", Reply.Offset);
+    ok(Reply.Length == TEST_PAYLOAD_SIZE, "Length = %lx\n", Reply.Length);
+
+    /* The answer was written in the server view */
+    if (ServerView.ViewBase && (Reply.Length == TEST_PAYLOAD_SIZE))
+    {
+        ok(CheckPayload((PUCHAR)ServerView.ViewBase + Reply.Offset, Reply.Length, 2),
+           "Reply payload mismatch\n");
+    }
+
+    Status = NtClose(PortHandle);
+    ok_hex(Status, STATUS_SUCCESS);
+
+    return 0;
+}
+
+START_TEST(NtConnectPort)
+{
+    NTSTATUS Status;
+    OBJECT_ATTRIBUTES ObjectAttributes;
+    HANDLE PortHandle;
+    HANDLE ThreadHandles[2];
+
+    InitializeObjectAttributes(&ObjectAttributes,
+                               &PortName,
+                               OBJ_CASE_INSENSITIVE,
+                               NULL,
+                               NULL);
+    Status = NtCreatePort(&PortHandle,
+                          &ObjectAttributes,
+                          0,
+                          sizeof(TEST_MESSAGE),
+                          2 * sizeof(TEST_MESSAGE));
+    ok_hex(Status, STATUS_SUCCESS);
+    if (!NT_SUCCESS(Status))
+    {
+        skip("Failed to create port\n");
+        return;
+    }
+
+    ThreadHandles[0] = (HANDLE)_beginthreadex(NULL,
+                                              0,
+                                              ServerThread,
+                                              PortHandle,
+                                              0,
+                                              NULL);
+    ok(ThreadHandles[0] != NULL, "_beginthreadex failed\n");
+
+    ThreadHandles[1] = (HANDLE)_beginthreadex(NULL,
+                                              0,
+                                              ClientThread,
+                                              PortHandle,
+                                              0,
+                                              NULL);
+    ok(ThreadHandles[1] != NULL, "_beginthreadex failed\n");
+
+    Status = NtWaitForMultipleObjects(RTL_NUMBER_OF(ThreadHandles),
+                                      ThreadHandles,
+                                      WaitAll,
+                                      FALSE,
+                                      NULL);
+    ok_hex(Status, STATUS_SUCCESS);
+
+    Status = NtClose(ThreadHandles[0]);
+    ok_hex(Status, STATUS_SUCCESS);
+    Status = NtClose(ThreadHandles[1]);
+    ok_hex(Status, STATUS_SUCCESS);
+
+    Status = NtClose(PortHandle);
+    ok_hex(Status, STATUS_SUCCESS);
+}
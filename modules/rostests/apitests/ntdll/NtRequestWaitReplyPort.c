@@ -0,0 +1,452 @@
+/*
+ * PROJECT:     ReactOS API tests
+ * LICENSE:     LGPL-2.1-or-later (https://spdx.org/licenses/LGPL-2.1-or-later)
+ * PURPOSE:     Test for NtRequestWaitReplyPort ping-pong across independent ports
+ *              and replies sent over another connection
+ */
+
+#include "precomp.h"
+
+#include <process.h>
+
+#define TEST_MAX_PAIRS  8
+#define TEST_CALLS      20000
+
+typedef struct _TEST_MESSAGE
+{
+    PORT_MESSAGE Header;
+    ULONG Value;
+} TEST_MESSAGE, *PTEST_MESSAGE;
+
+typedef struct _TEST_PAIR
+{
+    WCHAR PortNameBuffer[64];
+    UNICODE_STRING PortName;
+    HANDLE ConnectionPort;
+    HANDLE ReadyEvent;
+    HANDLE ServerThread;
+    HANDLE ClientThread;
+    ULONG Calls;
+} TEST_PAIR, *PTEST_PAIR;
+
+static HANDLE StartEvent;
+
+static
+UINT
+CALLBACK
+ServerThread(
+    _Inout_ PVOID Parameter)
+{
+    PTEST_PAIR Pair = Parameter;
+    NTSTATUS Status;
+    TEST_MESSAGE Message;
+    PPORT_MESSAGE ReplyMessage;
+    HANDLE PortHandle;
+
+    RtlZeroMemory(&Message, sizeof(Message));
+    Status = NtListenPort(Pair->ConnectionPort, &Message.Header);
+    ok_hex(Status, STATUS_SUCCESS);
+    if (!NT_SUCCESS(Status))
+        return 0;
+
+    Status = NtAcceptConnectPort(&PortHandle,
+                                 NULL,
+                                 &Message.Header,
+                                 TRUE,
+                                 NULL,
+                                 NULL);
+    ok_hex(Status, STATUS_SUCCESS);
+    if (!NT_SUCCESS(Status))
+        return 0;
+
+    Status = NtCompleteConnectPort(PortHandle);
+    ok_hex(Status, STATUS_SUCCESS);
+
+    /* Answer every request with its value incremented, until the client leaves */
+    ReplyMessage = NULL;
+    for (;;)
+    {
+        Status = NtReplyWaitReceivePort(PortHandle,
+                                        NULL,
+                                        ReplyMessage,
+                                        &Message.Header);
+        if (!NT_SUCCESS(Status) || (Message.Header.u2.s2.Type != LPC_REQUEST))
+            break;
+
+        Message.Value++;
+        ReplyMessage = &Message.Header;
+    }
+    ok_hex(Status, STATUS_SUCCESS);
+    ok(Message.Header.u2.s2.Type == LPC_PORT_CLOSED,
+       "Type = %x\n", Message.Header.u2.s2.Type);
+
+    Status = NtClose(PortHandle);
+    ok_hex(Status, STATUS_SUCCESS);
+
+    return 0;
+}
+
+static
+UINT
+CALLBACK
+ClientThread(
+    _Inout_ PVOID Parameter)
+{
+    PTEST_PAIR Pair = Parameter;
+    NTSTATUS Status;
+    SECURITY_QUALITY_OF_SERVICE SecurityQos;
+    TEST_MESSAGE Request, Reply;
+    HANDLE PortHandle;
+    ULONG i;
+
+    SecurityQos.Length = sizeof(SecurityQos);
+    SecurityQos.ImpersonationLevel = SecurityIdentification;
+    SecurityQos.EffectiveOnly = TRUE;
+    SecurityQos.ContextTrackingMode = SECURITY_STATIC_TRACKING;
+
+    Status = NtConnectPort(&PortHandle,
+                           &Pair->PortName,
+                           &SecurityQos,
+                           NULL,
+                           NULL,
+                           NULL,
+                           NULL,
+                           NULL);
+    ok_hex(Status, STATUS_SUCCESS);
+    SetEvent(Pair->ReadyEvent);
+    if (!NT_SUCCESS(Status))
+        return 0;
+
+    /* Start along with the other pairs */
+    WaitForSingleObject(StartEvent, INFINITE);
+
+    RtlZeroMemory(&Reply, sizeof(Reply));
+    for (i = 0; i < TEST_CALLS; i++)
+    {
+        RtlZeroMemory(&Request, sizeof(Request));
+        Request.Header.u1.s1.TotalLength = sizeof(Request);
+        Request.Header.u1.s1.DataLength = sizeof(Request.Value);
+        Request.Value = i;
+        Status = NtRequestWaitReplyPort(PortHandle,
+                                        &Request.Header,
+                                        &Reply.Header);
+        if (!NT_SUCCESS(Status) || (Reply.Value != i + 1))
+            break;
+    }
+    ok_hex(Status, STATUS_SUCCESS);
+    ok(i == TEST_CALLS, "Stopped after %lu calls, Value = %lu\n", i, Reply.Value);
+    Pair->Calls = i;
+
+    Status = NtClose(PortHandle);
+    ok_hex(Status, STATUS_SUCCESS);
+
+    return 0;
+}
+
+static
+ULONG
+RunPairs(
+    _In_ ULONG PairCount)
+{
+    NTSTATUS Status;
+    OBJECT_ATTRIBUTES ObjectAttributes;
+    TEST_PAIR Pairs[TEST_MAX_PAIRS];
+    HANDLE Handles[TEST_MAX_PAIRS];
+    ULONG i, Calls, Start, Elapsed;
+
+    RtlZeroMemory(Pairs, sizeof(Pairs));
+    ResetEvent(StartEvent);
+
+    /* Every pair gets its own connection port, so they share no port at all */
+    for (i = 0; i < PairCount; i++)
+    {
+        StringCbPrintfW(Pairs[i].PortNameBuffer,
+                        sizeof(Pairs[i].PortNameBuffer),
+                        L"\\NtdllApitestNtRequestWaitReplyPort%lu",
+                        i);
+        RtlInitUnicodeString(&Pairs[i].PortName, Pairs[i].PortNameBuffer);
+        InitializeObjectAttributes(&ObjectAttributes,
+                                   &Pairs[i].PortName,
+                                   OBJ_CASE_INSENSITIVE,
+                                   NULL,
+                                   NULL);
+        Status = NtCreatePort(&Pairs[i].ConnectionPort,
+                              &ObjectAttributes,
+                              0,
+                              sizeof(TEST_MESSAGE),
+                              2 * sizeof(TEST_MESSAGE));
+        ok_hex(Status, STATUS_SUCCESS);
+        if (!NT_SUCCESS(Status))
+        {
+            skip("Failed to create port %lu\n", i);
+            PairCount = i;
+            break;
+        }
+
+        Pairs[i].ReadyEvent = CreateEventW(NULL, TRUE, FALSE, NULL);
+        Pairs[i].ServerThread = (HANDLE)_beginthreadex(NULL,
+                                                       0,
+                                                       ServerThread,
+                                                       &Pairs[i],
+                                                       0,
+                                                       NULL);
+        ok(Pairs[i].ServerThread != NULL, "_beginthreadex failed\n");
+        Pairs[i].ClientThread = (HANDLE)_beginthreadex(NULL,
+                                                       0,
+                                                       ClientThread,
+                                                       &Pairs[i],
+                                                       0,
+                                                       NULL);
+        ok(Pairs[i].ClientThread != NULL, "_beginthreadex failed\n");
+        Handles[i] = Pairs[i].ReadyEvent;
+    }
+
+    if (!PairCount)
+        return 0;
+
+    /* Wait for all clients to be connected, then let them go at once */
+    WaitForMultipleObjects(PairCount, Handles, TRUE, INFINITE);
+    Start = GetTickCount();
+    SetEvent(StartEvent);
+
+    for (i = 0; i < PairCount; i++)
+        Handles[i] = Pairs[i].ClientThread;
+    WaitForMultipleObjects(PairCount, Handles, TRUE, INFINITE);
+    Elapsed = GetTickCount() - Start;
+
+    Calls = 0;
+    for (i = 0; i < PairCount; i++)
+    {
+        WaitForSingleObject(Pairs[i].ServerThread, INFINITE);
+        CloseHandle(Pairs[i].ServerThread);
+        CloseHandle(Pairs[i].ClientThread);
+        CloseHandle(Pairs[i].ReadyEvent);
+        Status = NtClose(Pairs[i].ConnectionPort);
+        ok_hex(Status, STATUS_SUCCESS);
+        Calls += Pairs[i].Calls;
+    }
+
+    /* Round trips per second for all pairs together */
+    return (ULONG)((ULONGLONG)Calls * 1000 / max(Elapsed, 1));
+}
+
+typedef struct _CROSS_CLIENT
+{
+    PUNICODE_STRING PortName;
+    BOOLEAN SendRequest;
+    HANDLE DoneEvent;
+    NTSTATUS Status;
+    ULONG Value;
+} CROSS_CLIENT, *PCROSS_CLIENT;
+
+static
+UINT
+CALLBACK
+CrossClientThread(
+    _Inout_ PVOID Parameter)
+{
+    PCROSS_CLIENT Client = Parameter;
+    NTSTATUS Status;
+    SECURITY_QUALITY_OF_SERVICE SecurityQos;
+    TEST_MESSAGE Request, Reply;
+    HANDLE PortHandle;
+
+    SecurityQos.Length = sizeof(SecurityQos);
+    SecurityQos.ImpersonationLevel = SecurityIdentification;
+    SecurityQos.EffectiveOnly = TRUE;
+    SecurityQos.ContextTrackingMode = SECURITY_STATIC_TRACKING;
+
+    Status = NtConnectPort(&PortHandle,
+                           Client->PortName,
+                           &SecurityQos,
+                           NULL,
+                           NULL,
+                           NULL,
+                           NULL,
+                           NULL);
+    Client->Status = Status;
+    if (!NT_SUCCESS(Status))
+        return 0;
+
+    if (Client->SendRequest)
+    {
+        RtlZeroMemory(&Request, sizeof(Request));
+        RtlZeroMemory(&Reply, sizeof(Reply));
+        Request.Header.u1.s1.TotalLength = sizeof(Request);
+        Request.Header.u1.s1.DataLength = sizeof(Request.Value);
+        Request.Value = 0x1234;
+        Client->Status = NtRequestWaitReplyPort(PortHandle,
+                                                &Request.Header,
+                                                &Reply.Header);
+        Client->Value = Reply.Value;
+    }
+    else
+    {
+        /* Stay connected until the reply went through */
+        WaitForSingleObject(Client->DoneEvent, INFINITE);
+    }
+
+    NtClose(PortHandle);
+    return 0;
+}
+
+static
+BOOLEAN
+AcceptCrossClient(
+    _In_ HANDLE ConnectionPort,
+    _Out_ PHANDLE PortHandle)
+{
+    NTSTATUS Status;
+    TEST_MESSAGE Message;
+
+    RtlZeroMemory(&Message, sizeof(Message));
+    Status = NtListenPort(ConnectionPort, &Message.Header);
+    ok_hex(Status, STATUS_SUCCESS);
+    if (!NT_SUCCESS(Status))
+        return FALSE;
+
+    Status = NtAcceptConnectPort(PortHandle,
+                                 NULL,
+                                 &Message.Header,
+                                 TRUE,
+                                 NULL,
+                                 NULL);
+    ok_hex(Status, STATUS_SUCCESS);
+    if (!NT_SUCCESS(Status))
+        return FALSE;
+
+    Status = NtCompleteConnectPort(*PortHandle);
+    ok_hex(Status, STATUS_SUCCESS);
+    return TRUE;
+}
+
+static
+VOID
+TestCrossReply(VOID)
+{
+    NTSTATUS Status;
+    OBJECT_ATTRIBUTES ObjectAttributes;
+    WCHAR PortNameBuffers[2][64];
+    UNICODE_STRING PortNames[2];
+    CROSS_CLIENT Clients[2];
+    HANDLE ConnectionPorts[2] = { NULL, NULL };
+    HANDLE PortHandles[2] = { NULL, NULL };
+    HANDLE Threads[2] = { NULL, NULL };
+    HANDLE DoneEvent;
+    TEST_MESSAGE Message;
+    ULONG i;
+
+    DoneEvent = CreateEventW(NULL, TRUE, FALSE, NULL);
+    ok(DoneEvent != NULL, "CreateEventW failed\n");
+    if (!DoneEvent)
+        return;
+
+    /* Two unrelated connections, the first one sends a request */
+    RtlZeroMemory(Clients, sizeof(Clients));
+    for (i = 0; i < 2; i++)
+    {
+        StringCbPrintfW(PortNameBuffers[i],
+                        sizeof(PortNameBuffers[i]),
+                        L"\\NtdllApitestNtRequestWaitReplyPortCross%lu",
+                        i);
+        RtlInitUnicodeString(&PortNames[i], PortNameBuffers[i]);
+        InitializeObjectAttributes(&ObjectAttributes,
+                                   &PortNames[i],
+                                   OBJ_CASE_INSENSITIVE,
+                                   NULL,
+                                   NULL);
+        Status = NtCreatePort(&ConnectionPorts[i],
+                              &ObjectAttributes,
+                              0,
+                              sizeof(TEST_MESSAGE),
+                              2 * sizeof(TEST_MESSAGE));
+        ok_hex(Status, STATUS_SUCCESS);
+        if (!NT_SUCCESS(Status))
+            goto Cleanup;
+
+        Clients[i].PortName = &PortNames[i];
+        Clients[i].SendRequest = (i == 0);
+        Clients[i].DoneEvent = DoneEvent;
+        Threads[i] = (HANDLE)_beginthreadex(NULL,
+                                            0,
+                                            CrossClientThread,
+                                            &Clients[i],
+                                            0,
+                                            NULL);
+        ok(Threads[i] != NULL, "_beginthreadex failed\n");
+        if (!Threads[i])
+            goto Cleanup;
+
+        if (!AcceptCrossClient(ConnectionPorts[i], &PortHandles[i]))
+            goto Cleanup;
+    }
+
+    /* Receive the request on the first connection */
+    RtlZeroMemory(&Message, sizeof(Message));
+    Status = NtReplyWaitReceivePort(PortHandles[0],
+                                    NULL,
+                                    NULL,
+                                    &Message.Header);
+    ok_hex(Status, STATUS_SUCCESS);
+    ok(Message.Header.u2.s2.Type == LPC_REQUEST,
+       "Type = %x\n", Message.Header.u2.s2.Type);
+    ok(Message.Value == 0x1234, "Value = %lx\n", Message.Value);
+
+    /* And reply to it over the second one, the message id is what matters */
+    Message.Value++;
+    Status = NtReplyPort(PortHandles[1], &Message.Header);
+    ok_hex(Status, STATUS_SUCCESS);
+
+    WaitForSingleObject(Threads[0], INFINITE);
+    ok_hex(Clients[0].Status, STATUS_SUCCESS);
+    ok(Clients[0].Value == 0x1235, "Value = %lx\n", Clients[0].Value);
+
+Cleanup:
+    SetEvent(DoneEvent);
+    for (i = 0; i < 2; i++)
+    {
+        if (Threads[i])
+        {
+            WaitForSingleObject(Threads[i], INFINITE);
+            CloseHandle(Threads[i]);
+        }
+        if (PortHandles[i])
+            NtClose(PortHandles[i]);
+        if (ConnectionPorts[i])
+            NtClose(ConnectionPorts[i]);
+    }
+    CloseHandle(DoneEvent);
+}
+
+START_TEST(NtRequestWaitReplyPort)
+{
+    SYSTEM_INFO SystemInfo;
+    ULONG PairCount, Rate, SinglePairRate;
+
+    StartEvent = CreateEventW(NULL, TRUE, FALSE, NULL);
+    ok(StartEvent != NULL, "CreateEventW failed\n");
+    if (!StartEvent)
+        return;
+
+    TestCrossReply();
+
+    GetSystemInfo(&SystemInfo);
+    SinglePairRate = 0;
+
+    /* Pairs on different ports should not slow each other down */
+    for (PairCount = 1; PairCount <= TEST_MAX_PAIRS; PairCount *= 2)
+    {
+        Rate = RunPairs(PairCount);
+        if (PairCount == 1)
+            SinglePairRate = max(Rate, 1);
+
+        trace("%lu pair(s) on %lu processor(s): %lu calls/s, %lu.%02lux one pair\n",
+              PairCount,
+              SystemInfo.dwNumberOfProcessors,
+              Rate,
+              Rate / SinglePairRate,
+              (Rate % SinglePairRate) * 100 / SinglePairRate);
+    }
+
+    CloseHandle(StartEvent);
+}
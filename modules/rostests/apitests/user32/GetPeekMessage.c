@@ -27,6 +27,93 @@ void Test_PeekMessage(HWND hWnd)
     ok(GetLastError() == ERROR_INVALID_WINDOW_HANDLE, "GetLastError() = %lu\n", GetLastError());
 }
 
+#define FILTER_POSTED 9000
+
+/* Removes the matching messages and checks that they come in posting order */
+static UINT RemoveFiltered(HWND hWnd, UINT MsgMin, UINT MsgMax, HWND hWndExpected, UINT Modulo, UINT Skip)
+{
+    MSG msg;
+    UINT Count = 0;
+    WPARAM Last = 0;
+    BOOL InOrder = TRUE, Matching = TRUE;
+
+    while (PeekMessageW(&msg, hWnd, MsgMin, MsgMax, PM_REMOVE))
+    {
+        if (msg.message < WM_APP || msg.message > WM_APP + 3)
+            continue;
+
+        if (Count && msg.wParam <= Last)
+            InOrder = FALSE;
+        if (msg.hwnd != hWndExpected && hWndExpected != INVALID_HANDLE_VALUE)
+            Matching = FALSE;
+        if (msg.message != WM_APP + msg.wParam % 4 || (Modulo && msg.wParam % Modulo == Skip))
+            Matching = FALSE;
+
+        Last = msg.wParam;
+        Count++;
+    }
+
+    ok(InOrder, "Messages were not retrieved in posting order\n");
+    ok(Matching, "Unexpected message retrieved\n");
+    return Count;
+}
+
+void Test_PeekMessage_Filters(void)
+{
+    HWND hWnd[3];
+    UINT i;
+    DWORD Start;
+    MSG msg;
+
+    hWnd[0] = CreateWindowExW(0, L"STATIC", L"One", 0, 0, 0, 10, 10, NULL, NULL, GetModuleHandle(NULL), NULL);
+    hWnd[1] = CreateWindowExW(0, L"STATIC", L"Two", 0, 0, 0, 10, 10, NULL, NULL, GetModuleHandle(NULL), NULL);
+    hWnd[2] = NULL;
+    ok(hWnd[0] != NULL && hWnd[1] != NULL, "CreateWindowExW failed\n");
+    if (!hWnd[0] || !hWnd[1])
+    {
+        skip("No windows\n");
+        goto Cleanup;
+    }
+
+    /* Flush what creating the windows queued */
+    while (PeekMessageW(&msg, NULL, 0, 0, PM_REMOVE));
+
+    /* Message i goes to hWnd[i % 3] with the message WM_APP + i % 4 */
+    for (i = 0; i < FILTER_POSTED; i++)
+    {
+        if (!PostMessageW(hWnd[i % 3], WM_APP + i % 4, i, 0))
+        {
+            ok(0, "PostMessageW failed for message %u, error %lu\n", i, GetLastError());
+            break;
+        }
+    }
+
+    Start = GetTickCount();
+
+    /* One window and one message: i % 12 == 1 */
+    ok_int(RemoveFiltered(hWnd[0], WM_APP + 1, WM_APP + 1, hWnd[0], 0, 0), FILTER_POSTED / 12);
+
+    /* One message, any window: i % 4 == 2 */
+    ok_int(RemoveFiltered(NULL, WM_APP + 2, WM_APP + 2, INVALID_HANDLE_VALUE, 0, 0), FILTER_POSTED / 4);
+
+    /* One window, any message, without the ones removed above */
+    ok_int(RemoveFiltered(hWnd[1], 0, 0, hWnd[1], 4, 2), FILTER_POSTED / 4);
+
+    /* The thread messages */
+    ok_int(RemoveFiltered((HWND)-1, 0, 0, NULL, 4, 2), FILTER_POSTED / 4);
+
+    /* What is left for the first window */
+    ok_int(RemoveFiltered(NULL, WM_APP, WM_APP + 3, hWnd[0], 0, 0), FILTER_POSTED / 6);
+
+    trace("Filtered removal of %u messages took %lu ms\n", FILTER_POSTED, GetTickCount() - Start);
+
+    ok(!PeekMessageW(&msg, NULL, WM_APP, WM_APP + 3, PM_NOREMOVE), "Messages left in the queue\n");
+
+Cleanup:
+    if (hWnd[1]) DestroyWindow(hWnd[1]);
+    if (hWnd[0]) DestroyWindow(hWnd[0]);
+}
+
 START_TEST(GetPeekMessage)
 {
     HWND hWnd = CreateWindowExW(0, L"EDIT", L"miau", 0, CW_USEDEFAULT, CW_USEDEFAULT,
@@ -37,4 +124,5 @@ START_TEST(GetPeekMessage)
 
     Test_GetMessage(hWnd);
     Test_PeekMessage(hWnd);
+    Test_PeekMessage_Filters();
 }
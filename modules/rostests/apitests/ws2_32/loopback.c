@@ -0,0 +1,247 @@
+/*
+ * PROJECT:     ReactOS api tests
+ * LICENSE:     LGPL-2.1-or-later (https://spdx.org/licenses/LGPL-2.1-or-later)
+ * PURPOSE:     Test for TCP accept backlog and loopback throughput
+ */
+
+#include "ws2_32.h"
+
+#define BACKLOG_CONNECTIONS 16
+#define TRANSFER_SIZE       (32 * 1024 * 1024)
+#define CHUNK_SIZE          (64 * 1024)
+/* The window the stack used before window scaling was enabled */
+#define LEGACY_WINDOW       (8 * 1024)
+
+static
+VOID
+SetBufferSizes(
+    _In_ SOCKET sock,
+    _In_ int size)
+{
+    int ret;
+
+    ret = setsockopt(sock, SOL_SOCKET, SO_RCVBUF, (const char *)&size, sizeof(size));
+    ok(ret == 0, "SO_RCVBUF failed with %d\n", WSAGetLastError());
+    ret = setsockopt(sock, SOL_SOCKET, SO_SNDBUF, (const char *)&size, sizeof(size));
+    ok(ret == 0, "SO_SNDBUF failed with %d\n", WSAGetLastError());
+}
+
+static
+SOCKET
+CreateListener(
+    _Out_ struct sockaddr_in *addr,
+    _In_ int backlog,
+    _In_ int bufsize)
+{
+    SOCKET listener;
+    int addrlen = sizeof(*addr);
+    int ret;
+
+    listener = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    ok(listener != INVALID_SOCKET, "socket failed with %d\n", WSAGetLastError());
+    if (listener == INVALID_SOCKET)
+        return INVALID_SOCKET;
+
+    memset(addr, 0, sizeof(*addr));
+    addr->sin_family = AF_INET;
+    addr->sin_addr.s_addr = inet_addr("127.0.0.1");
+    addr->sin_port = 0;
+
+    ret = bind(listener, (const struct sockaddr *)addr, sizeof(*addr));
+    ok(ret == 0, "bind failed with %d\n", WSAGetLastError());
+    ret = getsockname(listener, (struct sockaddr *)addr, &addrlen);
+    ok(ret == 0, "getsockname failed with %d\n", WSAGetLastError());
+    /* Accepted connections take these over */
+    if (bufsize)
+        SetBufferSizes(listener, bufsize);
+    ret = listen(listener, backlog);
+    ok(ret == 0, "listen failed with %d\n", WSAGetLastError());
+
+    return listener;
+}
+
+static
+VOID
+test_backlog(void)
+{
+    SOCKET listener, clients[BACKLOG_CONNECTIONS], server;
+    struct sockaddr_in addr;
+    char buffer[4];
+    int ret, i;
+
+    listener = CreateListener(&addr, SOMAXCONN, 0);
+    if (listener == INVALID_SOCKET)
+    {
+        skip("No listener\n");
+        return;
+    }
+
+    /* Connect everybody before anyone gets accepted */
+    for (i = 0; i < BACKLOG_CONNECTIONS; i++)
+    {
+        clients[i] = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+        ok(clients[i] != INVALID_SOCKET, "socket failed with %d\n", WSAGetLastError());
+        ret = connect(clients[i], (const struct sockaddr *)&addr, sizeof(addr));
+        ok(ret == 0, "connect %d failed with %d\n", i, WSAGetLastError());
+
+        /* Data sent before the accept must not get lost */
+        ret = send(clients[i], (const char *)&i, sizeof(i), 0);
+        ok(ret == sizeof(i), "send %d returned %d\n", i, ret);
+    }
+
+    for (i = 0; i < BACKLOG_CONNECTIONS; i++)
+    {
+        server = accept(listener, NULL, NULL);
+        ok(server != INVALID_SOCKET, "accept %d failed with %d\n", i, WSAGetLastError());
+        if (server == INVALID_SOCKET)
+            continue;
+
+        ret = recv(server, buffer, sizeof(buffer), MSG_WAITALL);
+        ok(ret == sizeof(buffer), "recv %d returned %d\n", i, ret);
+        closesocket(server);
+    }
+
+    for (i = 0; i < BACKLOG_CONNECTIONS; i++)
+        closesocket(clients[i]);
+    closesocket(listener);
+}
+
+static
+DWORD
+WINAPI
+SenderThread(
+    _In_ PVOID Parameter)
+{
+    SOCKET sock = (SOCKET)Parameter;
+    PUCHAR chunk;
+    ULONG sent, i;
+    int ret;
+
+    chunk = HeapAlloc(GetProcessHeap(), 0, CHUNK_SIZE);
+    if (!chunk)
+        return 1;
+
+    for (sent = 0; sent < TRANSFER_SIZE; sent += CHUNK_SIZE)
+    {
+        for (i = 0; i < CHUNK_SIZE; i++)
+            chunk[i] = (UCHAR)(sent + i);
+
+        ret = send(sock, (const char *)chunk, CHUNK_SIZE, 0);
+        if (ret != CHUNK_SIZE)
+            break;
+    }
+
+    shutdown(sock, SD_SEND);
+    HeapFree(GetProcessHeap(), 0, chunk);
+    return sent == TRANSFER_SIZE ? 0 : 1;
+}
+
+/* Returns the throughput in KiB/s, 0 on failure */
+static
+ULONG
+MeasureThroughput(
+    _In_ int bufsize)
+{
+    SOCKET listener, client, server;
+    struct sockaddr_in addr;
+    HANDLE thread;
+    PUCHAR buffer;
+    ULONG received = 0, i, mismatches = 0, rate;
+    DWORD start, elapsed, exitcode;
+    int ret;
+
+    listener = CreateListener(&addr, 1, bufsize);
+    if (listener == INVALID_SOCKET)
+    {
+        skip("No listener\n");
+        return 0;
+    }
+
+    client = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    ok(client != INVALID_SOCKET, "socket failed with %d\n", WSAGetLastError());
+    if (bufsize)
+        SetBufferSizes(client, bufsize);
+    ret = connect(client, (const struct sockaddr *)&addr, sizeof(addr));
+    ok(ret == 0, "connect failed with %d\n", WSAGetLastError());
+    server = accept(listener, NULL, NULL);
+    ok(server != INVALID_SOCKET, "accept failed with %d\n", WSAGetLastError());
+    closesocket(listener);
+
+    buffer = HeapAlloc(GetProcessHeap(), 0, CHUNK_SIZE);
+    if (!buffer || server == INVALID_SOCKET)
+    {
+        skip("Setup failed\n");
+        closesocket(server);
+        closesocket(client);
+        return 0;
+    }
+
+    start = GetTickCount();
+    thread = CreateThread(NULL, 0, SenderThread, (PVOID)client, 0, NULL);
+    ok(thread != NULL, "CreateThread failed with %lu\n", GetLastError());
+
+    while (thread)
+    {
+        ret = recv(server, (char *)buffer, CHUNK_SIZE, 0);
+        if (ret <= 0)
+            break;
+
+        for (i = 0; i < (ULONG)ret; i++)
+        {
+            if (buffer[i] != (UCHAR)(received + i))
+                mismatches++;
+        }
+        received += ret;
+    }
+    elapsed = GetTickCount() - start;
+
+    ok(received == TRANSFER_SIZE, "received %lu bytes\n", received);
+    ok(mismatches == 0, "%lu bytes were corrupted\n", mismatches);
+    rate = elapsed ? (received / 1024) * 1000 / elapsed : 0;
+    trace("Transferred %lu KiB over loopback with %s buffers in %lu ms (%lu KiB/s)\n",
+          received / 1024, bufsize ? "small" : "default", elapsed, rate);
+
+    if (thread)
+    {
+        WaitForSingleObject(thread, INFINITE);
+        GetExitCodeThread(thread, &exitcode);
+        ok(exitcode == 0, "sender failed\n");
+        CloseHandle(thread);
+    }
+
+    HeapFree(GetProcessHeap(), 0, buffer);
+    closesocket(server);
+    closesocket(client);
+
+    return (received == TRANSFER_SIZE && mismatches == 0) ? rate : 0;
+}
+
+static
+VOID
+test_throughput(void)
+{
+    ULONG before, after;
+
+    /* Same transfer with the old window forced through SO_RCVBUF/SO_SNDBUF,
+     * then with the defaults */
+    before = MeasureThroughput(LEGACY_WINDOW);
+    after = MeasureThroughput(0);
+
+    if (before && after)
+    {
+        trace("Default buffers run at %lu.%02lu times the speed of %u KiB ones\n",
+              after / before, (after % before) * 100 / before, LEGACY_WINDOW / 1024);
+    }
+}
+
+START_TEST(loopback)
+{
+    int ret;
+    WSADATA wsad;
+
+    ret = WSAStartup(MAKEWORD(2, 2), &wsad);
+    ok(ret == 0, "WSAStartup failed with %d\n", ret);
+    test_backlog();
+    test_throughput();
+    WSACleanup();
+}
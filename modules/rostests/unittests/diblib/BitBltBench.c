@@ -0,0 +1,95 @@
+/*
+ * PROJECT:     ReactOS DIB Library - Unit-tests
+ * LICENSE:     GPL-2.0-or-later (https://spdx.org/licenses/GPL-2.0-or-later)
+ * PURPOSE:     Measure the throughput of the common blits
+ */
+
+#include "precomp.h"
+
+#define BENCH_WIDTH 1024
+#define BENCH_HEIGHT 768
+#define BENCH_DELTA (BENCH_WIDTH * 4)
+#define BENCH_LOOPS 20
+
+typedef struct
+{
+    PCSTR pszName;
+    BOOL bEqSurf;
+    ULONG flSimd;
+} BENCH_VARIANT;
+
+static const BENCH_VARIANT gaVariants[] =
+{
+    { "generic", FALSE, 0 },
+    { "rows", TRUE, 0 },
+    { "sse2", TRUE, DIBLIB_SIMD_SSE2 },
+    { "avx2", TRUE, DIBLIB_SIMD_SSE2 | DIBLIB_SIMD_AVX2 },
+};
+
+static
+VOID
+BenchRop(PFN_DIBFUNCTION pfnRop, PCSTR pszRop, BOOL bSolid, PBYTE pjDst, PBYTE pjSrc)
+{
+    LARGE_INTEGER liFrequency, liStart, liEnd;
+    BLTDATA BltData;
+    ULONG i, iVariant, iLoop;
+    double dMPixels;
+
+    QueryPerformanceFrequency(&liFrequency);
+
+    for (i = 0; i < TEST_FORMATS; i++)
+    {
+        for (iVariant = 0; iVariant < _countof(gaVariants); iVariant++)
+        {
+            if ((gaVariants[iVariant].flSimd & gflDibSimd) != gaVariants[iVariant].flSimd)
+                continue;
+
+            /* Solid fills have no per pixel version any more */
+            if (bSolid && !gaVariants[iVariant].bEqSurf)
+                continue;
+
+            InitBltData(&BltData, gaiTestFormat[i], gaVariants[iVariant].bEqSurf,
+                        pjDst, pjSrc, BENCH_DELTA, BENCH_WIDTH, BENCH_HEIGHT,
+                        gaVariants[iVariant].flSimd);
+            if (bSolid)
+                BltData.ulSolidColor = 0x00123456;
+
+            QueryPerformanceCounter(&liStart);
+            for (iLoop = 0; iLoop < BENCH_LOOPS; iLoop++)
+                pfnRop(&BltData);
+            QueryPerformanceCounter(&liEnd);
+
+            dMPixels = (double)BENCH_WIDTH * BENCH_HEIGHT * BENCH_LOOPS / 1000000.0;
+            trace("%-9s %2u bpp %-8s %8.1f MPixel/s\n",
+                  pszRop, BltData.siDst.jBpp, gaVariants[iVariant].pszName,
+                  dMPixels * liFrequency.QuadPart /
+                  (double)max(liEnd.QuadPart - liStart.QuadPart, 1));
+        }
+    }
+}
+
+START_TEST(BitBltBench)
+{
+    PBYTE pjDst, pjSrc;
+
+    DibLib_Initialize(DIBLIB_SIMD_SSE2 | DIBLIB_SIMD_AVX2);
+
+    pjDst = HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY, BENCH_DELTA * BENCH_HEIGHT);
+    pjSrc = HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY, BENCH_DELTA * BENCH_HEIGHT);
+    if (!pjDst || !pjSrc)
+    {
+        skip("Out of memory\n");
+        goto Cleanup;
+    }
+
+    BenchRop(Dib_BitBlt_SRCCOPY, "SRCCOPY", FALSE, pjDst, pjSrc);
+    BenchRop(Dib_BitBlt_SRCAND, "SRCAND", FALSE, pjDst, pjSrc);
+    BenchRop(Dib_BitBlt_SRCPAINT, "SRCPAINT", FALSE, pjDst, pjSrc);
+    BenchRop(Dib_BitBlt_PATCOPY, "PATCOPY", TRUE, pjDst, pjSrc);
+
+Cleanup:
+    if (pjSrc)
+        HeapFree(GetProcessHeap(), 0, pjSrc);
+    if (pjDst)
+        HeapFree(GetProcessHeap(), 0, pjDst);
+}
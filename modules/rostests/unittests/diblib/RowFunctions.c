@@ -0,0 +1,191 @@
+/*
+ * PROJECT:     ReactOS DIB Library - Unit-tests
+ * LICENSE:     GPL-2.0-or-later (https://spdx.org/licenses/GPL-2.0-or-later)
+ * PURPOSE:     Test the row functions against the generic blit functions
+ */
+
+#include "precomp.h"
+
+/* Normally in DibLib.c, which would pull in every blit function and with
+   them the win32k exports they use */
+const BYTE ajShift4[2] = {4, 0};
+
+const ULONG gaiTestFormat[TEST_FORMATS] = {BMF_8BPP, BMF_16BPP, BMF_24BPP, BMF_32BPP};
+
+static const BYTE gajBpp[] = {0, 1, 4, 8, 16, 24, 32};
+
+static
+ULONG
+FASTCALL
+XlateTrivial(XLATEOBJ *pxlo, ULONG ulColor)
+{
+    UNREFERENCED_PARAMETER(pxlo);
+    return ulColor;
+}
+
+static XLATEOBJ gxloTrivial = {0, XO_TRIVIAL, 0, 0, 0, 0};
+
+VOID
+InitBltData(
+    _Out_ PBLTDATA pBltData,
+    _In_ ULONG iFormat,
+    _In_ BOOL bEqSurf,
+    _In_ PBYTE pjDst,
+    _In_ PBYTE pjSrc,
+    _In_ LONG lDelta,
+    _In_ ULONG cx,
+    _In_ ULONG cy,
+    _In_ ULONG flSimd)
+{
+    ZeroMemory(pBltData, sizeof(*pBltData));
+
+    pBltData->siDst.iFormat = iFormat;
+    pBltData->siDst.pvScan0 = pjDst;
+    pBltData->siDst.pjBase = pjDst;
+    pBltData->siDst.lDelta = lDelta;
+    pBltData->siDst.cjAdvanceY = lDelta;
+    pBltData->siDst.jBpp = gajBpp[iFormat];
+
+    /* Source format 0 selects the equal surface versions */
+    pBltData->siSrc.iFormat = bEqSurf ? 0 : iFormat;
+    pBltData->siSrc.pvScan0 = pjSrc;
+    pBltData->siSrc.pjBase = pjSrc;
+    pBltData->siSrc.lDelta = lDelta;
+    pBltData->siSrc.cjAdvanceY = lDelta;
+    pBltData->siSrc.jBpp = gajBpp[iFormat];
+
+    pBltData->ulWidth = cx;
+    pBltData->ulHeight = cy;
+    pBltData->pxlo = &gxloTrivial;
+    pBltData->pfnXlate = XlateTrivial;
+    pBltData->ulSolidColor = 0xFFFFFFFF;
+    pBltData->dy = 1;
+    pBltData->flSimd = flSimd;
+}
+
+#define TEST_LINES 3
+#define TEST_MAX_WIDTH 200
+#define TEST_DELTA (TEST_MAX_WIDTH * 4 + 64)
+#define TEST_SIZE (TEST_LINES * TEST_DELTA)
+
+static BYTE gajSrc[TEST_SIZE], gajDst[TEST_SIZE], gajRef[TEST_SIZE], gajInit[TEST_SIZE];
+
+static
+VOID
+FillRandom(PBYTE pj, SIZE_T cj)
+{
+    while (cj--)
+        *pj++ = (BYTE)rand();
+}
+
+static
+VOID
+TestRopRows(PFN_DIBFUNCTION pfnRop, PCSTR pszRop, ULONG flSimd)
+{
+    BLTDATA BltData;
+    ULONG i, iFormat, cx, jOffset;
+
+    for (i = 0; i < TEST_FORMATS; i++)
+    {
+        iFormat = gaiTestFormat[i];
+
+        for (jOffset = 0; jOffset < 4; jOffset++)
+        {
+            for (cx = 1; cx <= TEST_MAX_WIDTH; cx++)
+            {
+                /* Generic per pixel version */
+                memcpy(gajRef, gajInit, TEST_SIZE);
+                InitBltData(&BltData, iFormat, FALSE, gajRef + jOffset, gajSrc + jOffset,
+                            TEST_DELTA, cx, TEST_LINES, 0);
+                pfnRop(&BltData);
+
+                /* Row version */
+                memcpy(gajDst, gajInit, TEST_SIZE);
+                InitBltData(&BltData, iFormat, TRUE, gajDst + jOffset, gajSrc + jOffset,
+                            TEST_DELTA, cx, TEST_LINES, flSimd);
+                pfnRop(&BltData);
+
+                if (memcmp(gajDst, gajRef, TEST_SIZE) != 0)
+                {
+                    ok(0, "%s: mismatch for format %lu, width %lu, offset %lu, flSimd 0x%lx\n",
+                       pszRop, iFormat, cx, jOffset, flSimd);
+                    return;
+                }
+            }
+        }
+    }
+}
+
+static
+VOID
+TestSolidFill(ULONG flSimd)
+{
+    BLTDATA BltData;
+    ULONG i, iFormat, cx, x, y, jOffset, cjPixel;
+    ULONG ulColor = 0x00A1B2C3;
+    PBYTE pjPixel;
+
+    for (i = 0; i < TEST_FORMATS; i++)
+    {
+        iFormat = gaiTestFormat[i];
+
+        for (jOffset = 0; jOffset < 4; jOffset++)
+        {
+            for (cx = 1; cx <= TEST_MAX_WIDTH; cx++)
+            {
+                InitBltData(&BltData, iFormat, FALSE, gajDst + jOffset, NULL,
+                            TEST_DELTA, cx, TEST_LINES, flSimd);
+                BltData.ulSolidColor = ulColor;
+                cjPixel = BltData.siDst.jBpp / 8;
+
+                /* Expected result, pixels are little endian */
+                memcpy(gajRef, gajInit, TEST_SIZE);
+                for (y = 0; y < TEST_LINES; y++)
+                {
+                    pjPixel = gajRef + jOffset + y * TEST_DELTA;
+                    for (x = 0; x < cx * cjPixel; x++)
+                        pjPixel[x] = (BYTE)(ulColor >> ((x % cjPixel) * 8));
+                }
+
+                memcpy(gajDst, gajInit, TEST_SIZE);
+                Dib_BitBlt_PATCOPY(&BltData);
+
+                if (memcmp(gajDst, gajRef, TEST_SIZE) != 0)
+                {
+                    ok(0, "PATCOPY: mismatch for format %lu, width %lu, offset %lu, flSimd 0x%lx\n",
+                       iFormat, cx, jOffset, flSimd);
+                    return;
+                }
+            }
+        }
+    }
+}
+
+START_TEST(RowFunctions)
+{
+    static const ULONG aflSimd[] = {0, DIBLIB_SIMD_SSE2, DIBLIB_SIMD_SSE2 | DIBLIB_SIMD_AVX2};
+    ULONG i;
+
+    DibLib_Initialize(DIBLIB_SIMD_SSE2 | DIBLIB_SIMD_AVX2);
+    trace("Vector units: 0x%lx\n", gflDibSimd);
+
+    srand(0x5EED);
+    FillRandom(gajSrc, TEST_SIZE);
+    FillRandom(gajInit, TEST_SIZE);
+
+    for (i = 0; i < _countof(aflSimd); i++)
+    {
+        /* Only test what this processor has */
+        if ((aflSimd[i] & gflDibSimd) != aflSimd[i])
+        {
+            skip("Vector units 0x%lx not available\n", aflSimd[i]);
+            continue;
+        }
+
+        TestRopRows(Dib_BitBlt_SRCCOPY, "SRCCOPY", aflSimd[i]);
+        TestRopRows(Dib_BitBlt_SRCAND, "SRCAND", aflSimd[i]);
+        TestRopRows(Dib_BitBlt_SRCPAINT, "SRCPAINT", aflSimd[i]);
+        TestRopRows(Dib_BitBlt_SRCINVERT, "SRCINVERT", aflSimd[i]);
+        TestSolidFill(aflSimd[i]);
+    }
+}
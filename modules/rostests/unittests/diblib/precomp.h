@@ -0,0 +1,30 @@
+/*
+ * PROJECT:     ReactOS DIB Library - Unit-tests
+ * LICENSE:     GPL-2.0-or-later (https://spdx.org/licenses/GPL-2.0-or-later)
+ * PURPOSE:     Precompiled header
+ */
+
+#pragma once
+
+#include <apitest.h>
+
+#include <DibLib.h>
+
+#define TEST_FORMATS 4
+
+/* 8, 16, 24 and 32 bpp, the formats with row functions */
+extern const ULONG gaiTestFormat[TEST_FORMATS];
+
+VOID
+InitBltData(
+    _Out_ PBLTDATA pBltData,
+    _In_ ULONG iFormat,
+    _In_ BOOL bEqSurf,
+    _In_ PBYTE pjDst,
+    _In_ PBYTE pjSrc,
+    _In_ LONG lDelta,
+    _In_ ULONG cx,
+    _In_ ULONG cy,
+    _In_ ULONG flSimd);
+
+/* EOF */
@@ -0,0 +1,12 @@
+#define STANDALONE
+#include <apitest.h>
+
+extern void func_BitBltBench(void);
+extern void func_RowFunctions(void);
+
+const struct test winetest_testlist[] =
+{
+    { "BitBltBench", func_BitBltBench },
+    { "RowFunctions", func_RowFunctions },
+    { 0, 0 }
+};
@@ -34,10 +34,12 @@ CcPfInitializePrefetcher(VOID)
 
     /* Setup the Prefetcher Data */
     InitializeListHead(&CcPfGlobals.ActiveTraces);
+    KeInitializeSpinLock(&CcPfGlobals.ActiveTracesLock);
     InitializeListHead(&CcPfGlobals.CompletedTraces);
     ExInitializeFastMutex(&CcPfGlobals.CompletedTracesLock);
 
-    /* FIXME: Setup the rest of the prefetecher */
+    /* Enable it if any scenario is to be traced, see prefetch.c */
+    CcPfEnablePrefetcher = (CcPfEnablePrefetcherMode & (PF_ENABLE_APP_LAUNCH | PF_ENABLE_BOOT)) != 0;
 }
 
 CODE_SEG("INIT")
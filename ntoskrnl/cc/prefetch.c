@@ -0,0 +1,1143 @@
+/*
+ * COPYRIGHT:       See COPYING in the top level directory
+ * PROJECT:         ReactOS kernel
+ * FILE:            ntoskrnl/cc/prefetch.c
+ * PURPOSE:         Boot and application launch prefetcher
+ */
+
+/*
+ * While a scenario (the boot, or the first seconds of a process) runs, the
+ * file pages read in by page faults and cached reads are logged. When the
+ * trace ends, a system worker sorts the log and saves it as
+ * \SystemRoot\Prefetch\<NAME>-<HASH>.pf. The next time the scenario starts,
+ * a worker opens the files of that log and reads the pages back in, file by
+ * file in ascending offset order and merged into large runs, instead of the
+ * scattered single page reads of the faults. The sections created for this
+ * are kept until the trace of the scenario ends, so that the pages stay
+ * attached to their segments until the scenario maps them.
+ */
+
+/* INCLUDES *****************************************************************/
+
+#include <ntoskrnl.h>
+#define NDEBUG
+#include <debug.h>
+
+/* GLOBALS ******************************************************************/
+
+#define PF_ROS_TRACE_MAGIC          'SORP'
+#define PF_ROS_TRACE_VERSION        2
+#define PFSN_TRACE_MAGIC            'hTfP'
+
+/* How long the page faults of a scenario are logged */
+#define PF_APP_LAUNCH_TRACE_SECONDS 10
+#define PF_BOOT_TRACE_SECONDS       120
+
+#define PF_MAX_APP_LAUNCH_FAULTS    16384
+#define PF_MAX_BOOT_FAULTS          131072
+#define PF_MAX_FILES                1024
+#define PF_FILE_HASH_BUCKETS        256
+#define PF_MAX_ACTIVE_TRACES        8
+#define PF_LOG_BUFFER_ENTRIES       1024
+#define PF_MAX_SCENARIO_SIZE        (4 * 1024 * 1024)
+#define PF_MAX_FILE_NAME_LENGTH     (1024 * sizeof(WCHAR))
+
+/* Pages this close are read together, but never more than a run at once */
+#define PF_MAX_RUN_GAP_PAGES        16
+#define PF_MAX_RUN_PAGES            256
+
+/* PF_LOG_ENTRY::Type */
+#define PF_LOG_ENTRY_DATA           0
+#define PF_LOG_ENTRY_IMAGE          1
+
+/* PF_LOG_ENTRY::FileOffset holds a page index */
+#define PF_MAX_PAGE_INDEX           ((1UL << 30) - 1)
+
+/*
+ * Prefetched pages don't fault, so they are carried over from the replayed
+ * scenario. Each entry counts the traces since it last faulted, and is
+ * dropped after this many. Pages which are still needed then fault again
+ * and come back with the next trace.
+ */
+#define PF_MAX_ENTRY_AGE            8
+
+/* The age of each log entry follows the entries in a scenario file */
+#define PF_SCENARIO_AGES(Scenario) \
+    ((PUCHAR)((ULONG_PTR)(Scenario) + (Scenario)->TraceBufferOffset + \
+              (Scenario)->NumEntries * sizeof(PF_LOG_ENTRY)))
+
+/* Describes one file of a scenario file, the names come after the log entries */
+typedef struct _PF_ROS_FILE_INFO
+{
+    ULONG NameOffset;
+    USHORT NameLength;
+    USHORT Reserved;
+} PF_ROS_FILE_INFO, *PPF_ROS_FILE_INFO;
+
+/* A log entry along with its age, while a scenario is being saved */
+typedef struct _PF_AGED_LOG_ENTRY
+{
+    PF_LOG_ENTRY Entry;
+    ULONG Age;
+} PF_AGED_LOG_ENTRY, *PPF_AGED_LOG_ENTRY;
+
+typedef struct _PF_PREFETCH_CONTEXT
+{
+    WORK_QUEUE_ITEM WorkItem;
+    PPFSN_TRACE_HEADER Trace;
+    PPF_TRACE_HEADER Scenario;
+    /* Both protected by the active traces lock */
+    BOOLEAN Done;
+    BOOLEAN TraceEnded;
+    ULONG SectionCount;
+    PVOID Sections[ANYSIZE_ARRAY];
+} PF_PREFETCH_CONTEXT, *PPF_PREFETCH_CONTEXT;
+
+ULONG CcPfEnablePrefetcherMode = PF_ENABLE_APP_LAUNCH | PF_ENABLE_BOOT;
+static LONG CcPfNumActiveTraces;
+
+static const PF_SCENARIO_ID CcPfBootScenarioId = { L"NTOSBOOT", 0xB00DFAAD };
+static UNICODE_STRING CcPfPrefetchDirectory = RTL_CONSTANT_STRING(L"\\SystemRoot\\Prefetch");
+
+/* FUNCTIONS *****************************************************************/
+
+static
+int
+__cdecl
+CcPfCompareLogEntries(const void * x,
+                      const void * y)
+{
+    const PF_LOG_ENTRY *Entry1 = (const PF_LOG_ENTRY *)x;
+    const PF_LOG_ENTRY *Entry2 = (const PF_LOG_ENTRY *)y;
+
+    if (Entry1->FileKey != Entry2->FileKey)
+        return (Entry1->FileKey > Entry2->FileKey) ? 1 : -1;
+    if (Entry1->Type != Entry2->Type)
+        return (Entry1->Type > Entry2->Type) ? 1 : -1;
+    if (Entry1->FileOffset != Entry2->FileOffset)
+        return (Entry1->FileOffset > Entry2->FileOffset) ? 1 : -1;
+    return 0;
+}
+
+static
+int
+__cdecl
+CcPfCompareAgedLogEntries(const void * x,
+                          const void * y)
+{
+    const PF_AGED_LOG_ENTRY *Entry1 = (const PF_AGED_LOG_ENTRY *)x;
+    const PF_AGED_LOG_ENTRY *Entry2 = (const PF_AGED_LOG_ENTRY *)y;
+    int Result;
+
+    /* The youngest of the same pages comes first */
+    Result = CcPfCompareLogEntries(&Entry1->Entry, &Entry2->Entry);
+    if (Result == 0 && Entry1->Age != Entry2->Age)
+        Result = (Entry1->Age > Entry2->Age) ? 1 : -1;
+    return Result;
+}
+
+static
+ULONG
+CcPfHashFileObject(
+    IN PFILE_OBJECT FileObject)
+{
+    ULONG_PTR Value = (ULONG_PTR)FileObject;
+
+    /* Pool blocks are aligned, skip the low bits */
+    return (ULONG)((Value >> 4) ^ (Value >> 12)) & (PF_FILE_HASH_BUCKETS - 1);
+}
+
+static
+VOID
+CcPfMakeScenarioId(
+    IN PUNICODE_STRING ImageName,
+    OUT PPF_SCENARIO_ID ScenarioId)
+{
+    ULONG Start = 0, Length, i;
+
+    RtlZeroMemory(ScenarioId, sizeof(*ScenarioId));
+
+    /* The name is the one of the executable, the hash tells apart its paths */
+    for (i = 0; i < ImageName->Length / sizeof(WCHAR); i++)
+    {
+        if (ImageName->Buffer[i] == L'\\')
+            Start = i + 1;
+    }
+
+    Length = min(ImageName->Length / sizeof(WCHAR) - Start,
+                 RTL_NUMBER_OF(ScenarioId->ScenName) - 1);
+    for (i = 0; i < Length; i++)
+        ScenarioId->ScenName[i] = RtlUpcaseUnicodeChar(ImageName->Buffer[Start + i]);
+
+    RtlHashUnicodeString(ImageName, TRUE, HASH_STRING_ALGORITHM_X65599, &ScenarioId->HashId);
+}
+
+static
+NTSTATUS
+CcPfOpenScenarioFile(
+    IN PPF_SCENARIO_ID ScenarioId,
+    IN BOOLEAN Write,
+    OUT PHANDLE FileHandle)
+{
+    OBJECT_ATTRIBUTES ObjectAttributes;
+    IO_STATUS_BLOCK IoStatusBlock;
+    UNICODE_STRING FileName;
+    HANDLE DirectoryHandle;
+    WCHAR Buffer[64];
+    NTSTATUS Status;
+
+    /* The directory gets created along with the first scenario file */
+    InitializeObjectAttributes(&ObjectAttributes,
+                               &CcPfPrefetchDirectory,
+                               OBJ_CASE_INSENSITIVE | OBJ_KERNEL_HANDLE,
+                               NULL,
+                               NULL);
+    Status = ZwCreateFile(&DirectoryHandle,
+                          FILE_TRAVERSE | SYNCHRONIZE,
+                          &ObjectAttributes,
+                          &IoStatusBlock,
+                          NULL,
+                          FILE_ATTRIBUTE_NORMAL,
+                          FILE_SHARE_READ | FILE_SHARE_WRITE,
+                          Write ? FILE_OPEN_IF : FILE_OPEN,
+                          FILE_DIRECTORY_FILE | FILE_SYNCHRONOUS_IO_NONALERT,
+                          NULL,
+                          0);
+    if (!NT_SUCCESS(Status))
+        return Status;
+
+    swprintf(Buffer, L"%.29ls-%08lX.pf", ScenarioId->ScenName, ScenarioId->HashId);
+    RtlInitUnicodeString(&FileName, Buffer);
+
+    InitializeObjectAttributes(&ObjectAttributes,
+                               &FileName,
+                               OBJ_CASE_INSENSITIVE | OBJ_KERNEL_HANDLE,
+                               DirectoryHandle,
+                               NULL);
+    Status = ZwCreateFile(FileHandle,
+                          (Write ? GENERIC_WRITE : GENERIC_READ) | SYNCHRONIZE,
+                          &ObjectAttributes,
+                          &IoStatusBlock,
+                          NULL,
+                          FILE_ATTRIBUTE_NORMAL,
+                          Write ? 0 : FILE_SHARE_READ,
+                          Write ? FILE_OVERWRITE_IF : FILE_OPEN,
+                          FILE_NON_DIRECTORY_FILE | FILE_SYNCHRONOUS_IO_NONALERT | FILE_SEQUENTIAL_ONLY,
+                          NULL,
+                          0);
+
+    ZwClose(DirectoryHandle);
+    return Status;
+}
+
+static
+BOOLEAN
+CcPfVerifyScenario(
+    IN PPF_TRACE_HEADER Scenario,
+    IN ULONG Size,
+    IN PPF_SCENARIO_ID ScenarioId,
+    IN PF_SCENARIO_TYPE ScenarioType)
+{
+    PPF_ROS_FILE_INFO FileInfo;
+    PPF_LOG_ENTRY Entries;
+    ULONG i;
+
+    if ((Scenario->MagicNumber != PF_ROS_TRACE_MAGIC) ||
+        (Scenario->Version != PF_ROS_TRACE_VERSION) ||
+        (Scenario->Size != Size) ||
+        (Scenario->ScenarioType != ScenarioType) ||
+        (Scenario->ScenarioId.HashId != ScenarioId->HashId))
+    {
+        return FALSE;
+    }
+
+    /* Both tables must be aligned and within the file */
+    if ((Scenario->SectionInfoOffset % sizeof(ULONG)) ||
+        (Scenario->SectionInfoOffset > Size) ||
+        (Scenario->NumSections > PF_MAX_FILES) ||
+        (Scenario->NumSections > (Size - Scenario->SectionInfoOffset) / sizeof(PF_ROS_FILE_INFO)) ||
+        (Scenario->TraceBufferOffset % sizeof(ULONG)) ||
+        (Scenario->TraceBufferOffset > Size) ||
+        (Scenario->NumEntries > (Size - Scenario->TraceBufferOffset) /
+                                (sizeof(PF_LOG_ENTRY) + sizeof(UCHAR))))
+    {
+        return FALSE;
+    }
+
+    FileInfo = (PPF_ROS_FILE_INFO)((ULONG_PTR)Scenario + Scenario->SectionInfoOffset);
+    for (i = 0; i < Scenario->NumSections; i++)
+    {
+        if ((FileInfo[i].NameLength == 0) ||
+            (FileInfo[i].NameLength % sizeof(WCHAR)) ||
+            (FileInfo[i].NameOffset % sizeof(WCHAR)) ||
+            (FileInfo[i].NameOffset > Size) ||
+            (FileInfo[i].NameLength > Size - FileInfo[i].NameOffset))
+        {
+            return FALSE;
+        }
+    }
+
+    /* The replay relies on the entries being sorted */
+    Entries = (PPF_LOG_ENTRY)((ULONG_PTR)Scenario + Scenario->TraceBufferOffset);
+    for (i = 0; i < Scenario->NumEntries; i++)
+    {
+        if (Entries[i].FileKey >= Scenario->NumSections)
+            return FALSE;
+        if ((i > 0) && (CcPfCompareLogEntries(&Entries[i - 1], &Entries[i]) >= 0))
+            return FALSE;
+    }
+
+    return TRUE;
+}
+
+static
+NTSTATUS
+CcPfLoadScenario(
+    IN PPF_SCENARIO_ID ScenarioId,
+    IN PF_SCENARIO_TYPE ScenarioType,
+    OUT PPF_TRACE_HEADER *Scenario)
+{
+    FILE_STANDARD_INFORMATION StandardInfo;
+    IO_STATUS_BLOCK IoStatusBlock;
+    PPF_TRACE_HEADER Buffer;
+    HANDLE FileHandle;
+    ULONG Size;
+    NTSTATUS Status;
+
+    *Scenario = NULL;
+
+    Status = CcPfOpenScenarioFile(ScenarioId, FALSE, &FileHandle);
+    if (!NT_SUCCESS(Status))
+        return Status;
+
+    Status = ZwQueryInformationFile(FileHandle,
+                                    &IoStatusBlock,
+                                    &StandardInfo,
+                                    sizeof(StandardInfo),
+                                    FileStandardInformation);
+    if (!NT_SUCCESS(Status))
+        goto Quit;
+
+    if ((StandardInfo.EndOfFile.QuadPart < sizeof(PF_TRACE_HEADER)) ||
+        (StandardInfo.EndOfFile.QuadPart > PF_MAX_SCENARIO_SIZE))
+    {
+        Status = STATUS_FILE_CORRUPT_ERROR;
+        goto Quit;
+    }
+
+    Size = StandardInfo.EndOfFile.LowPart;
+    Buffer = ExAllocatePoolWithTag(PagedPool, Size, TAG_PF_SCENARIO);
+    if (!Buffer)
+    {
+        Status = STATUS_INSUFFICIENT_RESOURCES;
+        goto Quit;
+    }
+
+    Status = ZwReadFile(FileHandle,
+                        NULL,
+                        NULL,
+                        NULL,
+                        &IoStatusBlock,
+                        Buffer,
+                        Size,
+                        NULL,
+                        NULL);
+    if (NT_SUCCESS(Status) &&
+        ((IoStatusBlock.Information != Size) ||
+         !CcPfVerifyScenario(Buffer, Size, ScenarioId, ScenarioType)))
+    {
+        DPRINT1("Ignoring corrupted scenario %S-%08lX\n", ScenarioId->ScenName, ScenarioId->HashId);
+        Status = STATUS_FILE_CORRUPT_ERROR;
+    }
+
+    if (!NT_SUCCESS(Status))
+    {
+        ExFreePoolWithTag(Buffer, TAG_PF_SCENARIO);
+        goto Quit;
+    }
+
+    *Scenario = Buffer;
+
+Quit:
+    ZwClose(FileHandle);
+    return Status;
+}
+
+static
+VOID
+CcPfReleaseSections(
+    IN PPF_PREFETCH_CONTEXT Prefetch)
+{
+    while (Prefetch->SectionCount > 0)
+        ObDereferenceObject(Prefetch->Sections[--Prefetch->SectionCount]);
+}
+
+static
+VOID
+CcPfDereferenceTrace(
+    IN PPFSN_TRACE_HEADER Trace)
+{
+    PPF_PREFETCH_CONTEXT Prefetch = Trace->Prefetch;
+    PPFSN_LOG_ENTRIES Buffer;
+    ULONG i;
+
+    if (InterlockedDecrement(&Trace->ReferenceCount) != 0)
+        return;
+
+    if (Prefetch)
+    {
+        CcPfReleaseSections(Prefetch);
+        ExFreePoolWithTag(Prefetch->Scenario, TAG_PF_SCENARIO);
+        ExFreePoolWithTag(Prefetch, TAG_PF_SCENARIO);
+    }
+
+    while (!IsListEmpty(&Trace->TraceBuffersList))
+    {
+        Buffer = CONTAINING_RECORD(RemoveHeadList(&Trace->TraceBuffersList),
+                                   PFSN_LOG_ENTRIES,
+                                   TraceBuffersLink);
+        ExFreePoolWithTag(Buffer, TAG_PF_TRACE);
+    }
+
+    for (i = 0; i < Trace->FileTableCount; i++)
+        ObDereferenceObject(Trace->FileTable[i]);
+    ExFreePoolWithTag(Trace->FileTable, TAG_PF_TRACE);
+
+    if (Trace->Process)
+        ObDereferenceObject(Trace->Process);
+
+    ExFreePoolWithTag(Trace, TAG_PF_TRACE);
+}
+
+static
+VOID
+CcPfQueryFileName(
+    IN PFILE_OBJECT FileObject,
+    OUT PUNICODE_STRING FileName)
+{
+    POBJECT_NAME_INFORMATION NameInfo;
+    ULONG ReturnLength;
+    NTSTATUS Status;
+
+    RtlInitEmptyUnicodeString(FileName, NULL, 0);
+
+    NameInfo = ExAllocatePoolWithTag(PagedPool,
+                                     sizeof(OBJECT_NAME_INFORMATION) + PF_MAX_FILE_NAME_LENGTH,
+                                     TAG_PF_TRACE);
+    if (!NameInfo)
+        return;
+
+    Status = ObQueryNameString(FileObject,
+                               NameInfo,
+                               sizeof(OBJECT_NAME_INFORMATION) + PF_MAX_FILE_NAME_LENGTH,
+                               &ReturnLength);
+    if (NT_SUCCESS(Status) && (NameInfo->Name.Length != 0))
+    {
+        FileName->Buffer = ExAllocatePoolWithTag(PagedPool, NameInfo->Name.Length, TAG_PF_TRACE);
+        if (FileName->Buffer)
+        {
+            FileName->MaximumLength = NameInfo->Name.Length;
+            RtlCopyUnicodeString(FileName, &NameInfo->Name);
+        }
+    }
+
+    ExFreePoolWithTag(NameInfo, TAG_PF_TRACE);
+}
+
+static
+NTSTATUS
+CcPfWriteScenario(
+    IN PPFSN_TRACE_HEADER Trace,
+    IN PPF_TRACE_HEADER OldScenario OPTIONAL)
+{
+    PUNICODE_STRING FileNames = NULL;
+    PULONG KeyMap = NULL;
+    PPF_AGED_LOG_ENTRY Entries = NULL;
+    PPF_TRACE_HEADER Scenario = NULL;
+    PPF_LOG_ENTRY ScenarioEntries;
+    PUCHAR Ages;
+    PPF_ROS_FILE_INFO FileInfo;
+    PPFSN_LOG_ENTRIES Buffer;
+    PLIST_ENTRY ListEntry;
+    IO_STATUS_BLOCK IoStatusBlock;
+    HANDLE FileHandle;
+    ULONG MaxFiles, MaxEntries, NumFiles, NumEntries, NumUsed;
+    ULONG NameOffset, Size, i, j;
+    NTSTATUS Status = STATUS_SUCCESS;
+
+    PAGED_CODE();
+
+    MaxFiles = Trace->FileTableCount + (OldScenario ? OldScenario->NumSections : 0);
+    MaxEntries = Trace->NumFaults + (OldScenario ? OldScenario->NumEntries : 0);
+    if (MaxEntries == 0)
+        return STATUS_SUCCESS;
+
+    FileNames = ExAllocatePoolZero(PagedPool, MaxFiles * sizeof(UNICODE_STRING), TAG_PF_TRACE);
+    KeyMap = ExAllocatePoolWithTag(PagedPool, MaxFiles * sizeof(ULONG), TAG_PF_TRACE);
+    Entries = ExAllocatePoolWithTag(PagedPool, MaxEntries * sizeof(PF_AGED_LOG_ENTRY), TAG_PF_TRACE);
+    if (!FileNames || !KeyMap || !Entries)
+    {
+        Status = STATUS_INSUFFICIENT_RESOURCES;
+        goto Quit;
+    }
+
+    /* The files are saved by name, the ones without one are dropped */
+    for (i = 0; i < Trace->FileTableCount; i++)
+        CcPfQueryFileName(Trace->FileTable[i], &FileNames[i]);
+    NumFiles = Trace->FileTableCount;
+
+    NumEntries = 0;
+    for (ListEntry = Trace->TraceBuffersList.Flink;
+         ListEntry != &Trace->TraceBuffersList;
+         ListEntry = ListEntry->Flink)
+    {
+        Buffer = CONTAINING_RECORD(ListEntry, PFSN_LOG_ENTRIES, TraceBuffersLink);
+        for (i = 0; i < (ULONG)Buffer->NumEntries; i++)
+        {
+            if (FileNames[Buffer->Entries[i].FileKey].Length != 0)
+            {
+                Entries[NumEntries].Entry = Buffer->Entries[i];
+                Entries[NumEntries].Age = 0;
+                NumEntries++;
+            }
+        }
+    }
+
+    /*
+     * The pages which were prefetched didn't fault this time, keep them from
+     * the replayed scenario, as long as the trace isn't full and they aren't
+     * too old.
+     */
+    if (OldScenario)
+    {
+        PPF_ROS_FILE_INFO OldFileInfo;
+        PPF_LOG_ENTRY OldEntries;
+        PUCHAR OldAges;
+        UNICODE_STRING Name;
+
+        OldFileInfo = (PPF_ROS_FILE_INFO)((ULONG_PTR)OldScenario + OldScenario->SectionInfoOffset);
+        for (i = 0; i < OldScenario->NumSections; i++)
+        {
+            Name.Buffer = (PWCH)((ULONG_PTR)OldScenario + OldFileInfo[i].NameOffset);
+            Name.Length = Name.MaximumLength = OldFileInfo[i].NameLength;
+
+            for (j = 0; j < NumFiles; j++)
+            {
+                if (RtlEqualUnicodeString(&FileNames[j], &Name, TRUE))
+                    break;
+            }
+
+            if (j == NumFiles)
+            {
+                if (NumFiles == PF_MAX_FILES)
+                {
+                    KeyMap[i] = MAXULONG;
+                    continue;
+                }
+                FileNames[NumFiles++] = Name;
+            }
+            KeyMap[i] = j;
+        }
+
+        OldEntries = (PPF_LOG_ENTRY)((ULONG_PTR)OldScenario + OldScenario->TraceBufferOffset);
+        OldAges = PF_SCENARIO_AGES(OldScenario);
+        for (i = 0; (i < OldScenario->NumEntries) && (NumEntries < (ULONG)Trace->MaxFaults); i++)
+        {
+            if ((KeyMap[OldEntries[i].FileKey] == MAXULONG) ||
+                (OldAges[i] + 1 >= PF_MAX_ENTRY_AGE))
+            {
+                continue;
+            }
+
+            Entries[NumEntries].Entry = OldEntries[i];
+            Entries[NumEntries].Entry.FileKey = KeyMap[OldEntries[i].FileKey];
+            Entries[NumEntries].Age = OldAges[i] + 1;
+            NumEntries++;
+        }
+    }
+
+    /* Sort by file, type and offset, and drop the pages read more than once */
+    qsort(Entries, NumEntries, sizeof(PF_AGED_LOG_ENTRY), CcPfCompareAgedLogEntries);
+    for (i = 0, j = 0; i < NumEntries; i++)
+    {
+        if ((j == 0) || (CcPfCompareLogEntries(&Entries[j - 1].Entry, &Entries[i].Entry) != 0))
+            Entries[j++] = Entries[i];
+    }
+    NumEntries = j;
+
+    if (NumEntries == 0)
+        goto Quit;
+
+    /* Number the files which have entries left, in the same order */
+    for (i = 0; i < NumFiles; i++)
+        KeyMap[i] = MAXULONG;
+    NumUsed = 0;
+    Size = 0;
+    for (i = 0; i < NumEntries; i++)
+    {
+        if (KeyMap[Entries[i].Entry.FileKey] == MAXULONG)
+        {
+            KeyMap[Entries[i].Entry.FileKey] = NumUsed++;
+            Size += FileNames[Entries[i].Entry.FileKey].Length;
+        }
+        Entries[i].Entry.FileKey = KeyMap[Entries[i].Entry.FileKey];
+    }
+
+    NameOffset = ALIGN_UP_BY(sizeof(PF_TRACE_HEADER) +
+                             NumUsed * sizeof(PF_ROS_FILE_INFO) +
+                             NumEntries * (sizeof(PF_LOG_ENTRY) + sizeof(UCHAR)),
+                             sizeof(WCHAR));
+    Size += NameOffset;
+
+    Scenario = ExAllocatePoolZero(PagedPool, Size, TAG_PF_TRACE);
+    if (!Scenario)
+    {
+        Status = STATUS_INSUFFICIENT_RESOURCES;
+        goto Quit;
+    }
+
+    Scenario->Version = PF_ROS_TRACE_VERSION;
+    Scenario->MagicNumber = PF_ROS_TRACE_MAGIC;
+    Scenario->Size = Size;
+    Scenario->ScenarioId = Trace->ScenarioId;
+    Scenario->ScenarioType = Trace->ScenarioType;
+    Scenario->SectionInfoOffset = sizeof(PF_TRACE_HEADER);
+    Scenario->NumSections = NumUsed;
+    Scenario->TraceBufferOffset = sizeof(PF_TRACE_HEADER) + NumUsed * sizeof(PF_ROS_FILE_INFO);
+    Scenario->NumEntries = NumEntries;
+    Scenario->LaunchTime = Trace->LaunchTime;
+
+    FileInfo = (PPF_ROS_FILE_INFO)((ULONG_PTR)Scenario + Scenario->SectionInfoOffset);
+    for (i = 0; i < NumFiles; i++)
+    {
+        if (KeyMap[i] == MAXULONG)
+            continue;
+
+        FileInfo[KeyMap[i]].NameOffset = NameOffset;
+        FileInfo[KeyMap[i]].NameLength = FileNames[i].Length;
+        RtlCopyMemory((PVOID)((ULONG_PTR)Scenario + NameOffset), FileNames[i].Buffer, FileNames[i].Length);
+        NameOffset += FileNames[i].Length;
+    }
+
+    ScenarioEntries = (PPF_LOG_ENTRY)((ULONG_PTR)Scenario + Scenario->TraceBufferOffset);
+    Ages = PF_SCENARIO_AGES(Scenario);
+    for (i = 0; i < NumEntries; i++)
+    {
+        ScenarioEntries[i] = Entries[i].Entry;
+        Ages[i] = (UCHAR)Entries[i].Age;
+    }
+
+    Status = CcPfOpenScenarioFile(&Trace->ScenarioId, TRUE, &FileHandle);
+    if (NT_SUCCESS(Status))
+    {
+        Status = ZwWriteFile(FileHandle,
+                             NULL,
+                             NULL,
+                             NULL,
+                             &IoStatusBlock,
+                             Scenario,
+                             Size,
+                             NULL,
+                             NULL);
+        ZwClose(FileHandle);
+    }
+
+    DPRINT("Saved scenario %S-%08lX, %lu files, %lu pages: %lx\n",
+           Trace->ScenarioId.ScenName, Trace->ScenarioId.HashId, NumUsed, NumEntries, Status);
+
+Quit:
+    if (Scenario)
+        ExFreePoolWithTag(Scenario, TAG_PF_TRACE);
+    if (FileNames)
+    {
+        /* Names past the ones of the trace point into the old scenario */
+        for (i = 0; i < Trace->FileTableCount; i++)
+        {
+            if (FileNames[i].Buffer)
+                ExFreePoolWithTag(FileNames[i].Buffer, TAG_PF_TRACE);
+        }
+        ExFreePoolWithTag(FileNames, TAG_PF_TRACE);
+    }
+    if (KeyMap)
+        ExFreePoolWithTag(KeyMap, TAG_PF_TRACE);
+    if (Entries)
+        ExFreePoolWithTag(Entries, TAG_PF_TRACE);
+
+    return Status;
+}
+
+static
+VOID
+NTAPI
+CcPfEndTraceWorker(
+    IN PVOID Context)
+{
+    PPFSN_TRACE_HEADER Trace = Context;
+    PPF_PREFETCH_CONTEXT Prefetch = Trace->Prefetch;
+    BOOLEAN ReleaseSections = FALSE;
+    KIRQL OldIrql;
+
+    /* Once off the list, nothing logs into the trace anymore */
+    KeAcquireSpinLock(&CcPfGlobals.ActiveTracesLock, &OldIrql);
+    RemoveEntryList(&Trace->ActiveTracesLink);
+    CcPfNumActiveTraces--;
+    if (CcPfGlobals.SystemWideTrace == Trace)
+        CcPfGlobals.SystemWideTrace = NULL;
+    if (Prefetch)
+    {
+        Prefetch->TraceEnded = TRUE;
+        ReleaseSections = Prefetch->Done;
+    }
+    KeReleaseSpinLock(&CcPfGlobals.ActiveTracesLock, OldIrql);
+
+    /* The scenario is done with the prefetched pages, they can be trimmed */
+    if (ReleaseSections)
+        CcPfReleaseSections(Prefetch);
+
+    Trace->TraceDumpStatus = CcPfWriteScenario(Trace, Prefetch ? Prefetch->Scenario : NULL);
+    if (!NT_SUCCESS(Trace->TraceDumpStatus))
+    {
+        DPRINT1("Failed to save scenario %S-%08lX: %lx\n",
+                Trace->ScenarioId.ScenName, Trace->ScenarioId.HashId, Trace->TraceDumpStatus);
+    }
+
+    CcPfDereferenceTrace(Trace);
+}
+
+static
+VOID
+NTAPI
+CcPfTraceTimerDpc(
+    IN PKDPC Dpc,
+    IN PVOID DeferredContext,
+    IN PVOID SystemArgument1,
+    IN PVOID SystemArgument2)
+{
+    PPFSN_TRACE_HEADER Trace = DeferredContext;
+
+    UNREFERENCED_PARAMETER(Dpc);
+    UNREFERENCED_PARAMETER(SystemArgument1);
+    UNREFERENCED_PARAMETER(SystemArgument2);
+
+    /* Saving the trace needs a thread */
+    if (!InterlockedExchange(&Trace->EndTraceCalled, TRUE))
+        ExQueueWorkItem(&Trace->EndTraceWorkItem, DelayedWorkQueue);
+}
+
+static
+HANDLE
+CcPfOpenPrefetchFile(
+    IN PPF_TRACE_HEADER Scenario,
+    IN PPF_ROS_FILE_INFO FileInfo)
+{
+    OBJECT_ATTRIBUTES ObjectAttributes;
+    IO_STATUS_BLOCK IoStatusBlock;
+    UNICODE_STRING FileName;
+    HANDLE FileHandle;
+    NTSTATUS Status;
+
+    FileName.Buffer = (PWCH)((ULONG_PTR)Scenario + FileInfo->NameOffset);
+    FileName.Length = FileName.MaximumLength = FileInfo->NameLength;
+
+    InitializeObjectAttributes(&ObjectAttributes,
+                               &FileName,
+                               OBJ_CASE_INSENSITIVE | OBJ_KERNEL_HANDLE,
+                               NULL,
+                               NULL);
+    Status = ZwOpenFile(&FileHandle,
+                        FILE_READ_DATA | FILE_EXECUTE | SYNCHRONIZE,
+                        &ObjectAttributes,
+                        &IoStatusBlock,
+                        FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                        FILE_NON_DIRECTORY_FILE | FILE_SYNCHRONOUS_IO_NONALERT);
+    if (!NT_SUCCESS(Status))
+    {
+        /* The file may be gone since the scenario was saved */
+        DPRINT("Failed to open %wZ: %lx\n", &FileName, Status);
+        return NULL;
+    }
+
+    return FileHandle;
+}
+
+static
+VOID
+CcPfPrefetchRuns(
+    IN PVOID Section,
+    IN PPF_LOG_ENTRY Entries,
+    IN ULONG Count)
+{
+    ULONG First, Last, i = 0;
+    NTSTATUS Status;
+
+    while (i < Count)
+    {
+        First = Last = Entries[i++].FileOffset;
+        while ((i < Count) &&
+               (Entries[i].FileOffset - Last <= PF_MAX_RUN_GAP_PAGES) &&
+               (Entries[i].FileOffset - First < PF_MAX_RUN_PAGES))
+        {
+            Last = Entries[i++].FileOffset;
+        }
+
+        Status = MmPrefetchSectionPages(Section,
+                                        (LONGLONG)First << PAGE_SHIFT,
+                                        (Last - First + 1) << PAGE_SHIFT);
+        if (!NT_SUCCESS(Status))
+        {
+            DPRINT("Failed to prefetch pages %lu-%lu: %lx\n", First, Last, Status);
+            return;
+        }
+    }
+}
+
+static
+VOID
+NTAPI
+CcPfPrefetchWorker(
+    IN PVOID Context)
+{
+    PPF_PREFETCH_CONTEXT Prefetch = Context;
+    PPF_TRACE_HEADER Scenario = Prefetch->Scenario;
+    PPF_ROS_FILE_INFO FileInfo;
+    PPF_LOG_ENTRY Entries;
+    HANDLE FileHandle = NULL;
+    ULONG FileKey = MAXULONG;
+    ULONG First, Next;
+    BOOLEAN ReleaseSections;
+    PVOID Section;
+    KIRQL OldIrql;
+    NTSTATUS Status;
+
+    FileInfo = (PPF_ROS_FILE_INFO)((ULONG_PTR)Scenario + Scenario->SectionInfoOffset);
+    Entries = (PPF_LOG_ENTRY)((ULONG_PTR)Scenario + Scenario->TraceBufferOffset);
+
+    /* The entries are sorted by file, then type, then offset */
+    for (First = 0; First < Scenario->NumEntries; First = Next)
+    {
+        for (Next = First + 1; Next < Scenario->NumEntries; Next++)
+        {
+            if ((Entries[Next].FileKey != Entries[First].FileKey) ||
+                (Entries[Next].Type != Entries[First].Type))
+            {
+                break;
+            }
+        }
+
+        if (Entries[First].FileKey != FileKey)
+        {
+            if (FileHandle)
+                ZwClose(FileHandle);
+            FileKey = Entries[First].FileKey;
+            FileHandle = CcPfOpenPrefetchFile(Scenario, &FileInfo[FileKey]);
+        }
+
+        if (!FileHandle)
+            continue;
+
+        /* Read through the same segments as the faults of the scenario will */
+        if (Entries[First].Type == PF_LOG_ENTRY_IMAGE)
+        {
+            Status = MmCreateSection(&Section,
+                                     SECTION_MAP_READ | SECTION_MAP_EXECUTE,
+                                     NULL,
+                                     NULL,
+                                     PAGE_EXECUTE,
+                                     SEC_IMAGE,
+                                     FileHandle,
+                                     NULL);
+        }
+        else
+        {
+            Status = MmCreateSection(&Section,
+                                     SECTION_MAP_READ,
+                                     NULL,
+                                     NULL,
+                                     PAGE_READONLY,
+                                     SEC_COMMIT,
+                                     FileHandle,
+                                     NULL);
+        }
+
+        if (!NT_SUCCESS(Status))
+        {
+            DPRINT("Failed to create section for file %lu: %lx\n", FileKey, Status);
+            continue;
+        }
+
+        /* A file has at most one image and one data run of entries */
+        ASSERT(Prefetch->SectionCount < 2 * Scenario->NumSections);
+        Prefetch->Sections[Prefetch->SectionCount++] = Section;
+
+        CcPfPrefetchRuns(Section, &Entries[First], Next - First);
+    }
+
+    if (FileHandle)
+        ZwClose(FileHandle);
+
+    KeAcquireSpinLock(&CcPfGlobals.ActiveTracesLock, &OldIrql);
+    Prefetch->Done = TRUE;
+    ReleaseSections = Prefetch->TraceEnded;
+    KeReleaseSpinLock(&CcPfGlobals.ActiveTracesLock, OldIrql);
+
+    /* The trace ended before we were done, nobody needs the sections anymore */
+    if (ReleaseSections)
+        CcPfReleaseSections(Prefetch);
+
+    CcPfDereferenceTrace(Prefetch->Trace);
+}
+
+static
+VOID
+CcPfStartTrace(
+    IN PF_SCENARIO_TYPE ScenarioType,
+    IN PPF_SCENARIO_ID ScenarioId,
+    IN PEPROCESS Process OPTIONAL)
+{
+    PPF_PREFETCH_CONTEXT Prefetch = NULL;
+    PPFSN_TRACE_HEADER Trace;
+    PPF_TRACE_HEADER Scenario;
+    PFILE_OBJECT *FileTable;
+    ULONG Seconds;
+    KIRQL OldIrql;
+
+    PAGED_CODE();
+
+    /* Don't slow down a burst of launches, this is checked again below */
+    if (CcPfNumActiveTraces >= PF_MAX_ACTIVE_TRACES)
+        return;
+
+    /* Replay the previous run of the scenario, if it was saved */
+    if (NT_SUCCESS(CcPfLoadScenario(ScenarioId, ScenarioType, &Scenario)))
+    {
+        Prefetch = ExAllocatePoolZero(NonPagedPool,
+                                      FIELD_OFFSET(PF_PREFETCH_CONTEXT,
+                                                   Sections[2 * Scenario->NumSections + 1]),
+                                      TAG_PF_SCENARIO);
+        if (!Prefetch)
+        {
+            ExFreePoolWithTag(Scenario, TAG_PF_SCENARIO);
+            return;
+        }
+        Prefetch->Scenario = Scenario;
+    }
+
+    Trace = ExAllocatePoolZero(NonPagedPool, sizeof(PFSN_TRACE_HEADER), TAG_PF_TRACE);
+    /* The hash buckets and chains live behind the table */
+    FileTable = ExAllocatePoolWithTag(NonPagedPool,
+                                      PF_MAX_FILES * sizeof(PFILE_OBJECT) +
+                                      (PF_FILE_HASH_BUCKETS + PF_MAX_FILES) * sizeof(ULONG),
+                                      TAG_PF_TRACE);
+    if (!Trace || !FileTable)
+    {
+        if (Trace)
+            ExFreePoolWithTag(Trace, TAG_PF_TRACE);
+        if (FileTable)
+            ExFreePoolWithTag(FileTable, TAG_PF_TRACE);
+        if (Prefetch)
+        {
+            ExFreePoolWithTag(Prefetch->Scenario, TAG_PF_SCENARIO);
+            ExFreePoolWithTag(Prefetch, TAG_PF_SCENARIO);
+        }
+        return;
+    }
+
+    Trace->Magic = PFSN_TRACE_MAGIC;
+    Trace->ScenarioId = *ScenarioId;
+    Trace->ScenarioType = ScenarioType;
+    InitializeListHead(&Trace->TraceBuffersList);
+    KeInitializeTimer(&Trace->TraceTimer);
+    KeInitializeDpc(&Trace->TraceTimerDpc, CcPfTraceTimerDpc, Trace);
+    ExInitializeWorkItem(&Trace->EndTraceWorkItem, CcPfEndTraceWorker, Trace);
+    Trace->MaxFaults = (ScenarioType == PfSystemBootScenarioType) ? PF_MAX_BOOT_FAULTS
+                                                                  : PF_MAX_APP_LAUNCH_FAULTS;
+    Trace->Process = Process;
+    if (Process)
+        ObReferenceObject(Process);
+    KeQuerySystemTime(&Trace->LaunchTime);
+    Trace->FileTable = FileTable;
+    Trace->FileHash = (PULONG)&FileTable[PF_MAX_FILES];
+    RtlFillMemory(Trace->FileHash, PF_FILE_HASH_BUCKETS * sizeof(ULONG), 0xFF);
+    Trace->ReferenceCount = 1;
+    Trace->Prefetch = Prefetch;
+
+    KeAcquireSpinLock(&CcPfGlobals.ActiveTracesLock, &OldIrql);
+    if (CcPfNumActiveTraces >= PF_MAX_ACTIVE_TRACES)
+    {
+        KeReleaseSpinLock(&CcPfGlobals.ActiveTracesLock, OldIrql);
+        CcPfDereferenceTrace(Trace);
+        return;
+    }
+    CcPfNumActiveTraces++;
+    InsertTailList(&CcPfGlobals.ActiveTraces, &Trace->ActiveTracesLink);
+    if (ScenarioType == PfSystemBootScenarioType)
+        CcPfGlobals.SystemWideTrace = Trace;
+    KeReleaseSpinLock(&CcPfGlobals.ActiveTracesLock, OldIrql);
+
+    Seconds = (ScenarioType == PfSystemBootScenarioType) ? PF_BOOT_TRACE_SECONDS
+                                                         : PF_APP_LAUNCH_TRACE_SECONDS;
+    Trace->TraceTimerPeriod.QuadPart = -(LONGLONG)Seconds * 10 * 1000 * 1000;
+    KeSetTimer(&Trace->TraceTimer, Trace->TraceTimerPeriod, &Trace->TraceTimerDpc);
+
+    if (Prefetch)
+    {
+        /* The prefetch worker keeps the trace alive */
+        InterlockedIncrement(&Trace->ReferenceCount);
+        Prefetch->Trace = Trace;
+        ExInitializeWorkItem(&Prefetch->WorkItem, CcPfPrefetchWorker, Prefetch);
+        ExQueueWorkItem(&Prefetch->WorkItem, DelayedWorkQueue);
+    }
+}
+
+VOID
+NTAPI
+CcPfBeginAppLaunch(
+    IN PEPROCESS Process)
+{
+    PUNICODE_STRING ImageName;
+    PF_SCENARIO_ID ScenarioId;
+
+    PAGED_CODE();
+
+    if (!(CcPfEnablePrefetcherMode & PF_ENABLE_APP_LAUNCH))
+        return;
+
+    if (!NT_SUCCESS(SeLocateProcessImageName(Process, &ImageName)))
+        return;
+
+    if (ImageName->Length != 0)
+    {
+        CcPfMakeScenarioId(ImageName, &ScenarioId);
+        CcPfStartTrace(PfApplicationLaunchScenarioType, &ScenarioId, Process);
+    }
+
+    ExFreePoolWithTag(ImageName, TAG_SEPA);
+}
+
+VOID
+NTAPI
+CcPfBeginBootPhase(
+    IN PF_BOOT_PHASE_ID Phase)
+{
+    PAGED_CODE();
+
+    if (!CcPfEnablePrefetcher || !(CcPfEnablePrefetcherMode & PF_ENABLE_BOOT))
+        return;
+
+    /* The boot is traced from the start of the session manager on */
+    if (Phase == PfSessionManagerInitPhase)
+    {
+        CcPfStartTrace(PfSystemBootScenarioType,
+                       (PPF_SCENARIO_ID)&CcPfBootScenarioId,
+                       NULL);
+    }
+}
+
+static
+VOID
+CcPfLogEntries(
+    IN PPFSN_TRACE_HEADER Trace,
+    IN PFILE_OBJECT FileObject,
+    IN ULONG PageIndex,
+    IN ULONG PageCount,
+    IN BOOLEAN Image)
+{
+    PPFSN_LOG_ENTRIES Buffer;
+    PPF_LOG_ENTRY Entry;
+    PULONG FileChain = &Trace->FileHash[PF_FILE_HASH_BUCKETS];
+    ULONG FileKey, Bucket;
+
+    if (Trace->NumFaults >= Trace->MaxFaults)
+        return;
+
+    Bucket = CcPfHashFileObject(FileObject);
+    for (FileKey = Trace->FileHash[Bucket]; FileKey != MAXULONG; FileKey = FileChain[FileKey])
+    {
+        if (Trace->FileTable[FileKey] == FileObject)
+            break;
+    }
+
+    if (FileKey == MAXULONG)
+    {
+        if (Trace->FileTableCount == PF_MAX_FILES)
+            return;
+
+        /* Keep the file object around for naming it when the trace ends */
+        ObReferenceObject(FileObject);
+        FileKey = Trace->FileTableCount++;
+        Trace->FileTable[FileKey] = FileObject;
+        FileChain[FileKey] = Trace->FileHash[Bucket];
+        Trace->FileHash[Bucket] = FileKey;
+    }
+
+    for (; PageCount != 0 && Trace->NumFaults < Trace->MaxFaults; PageCount--, PageIndex++)
+    {
+        Buffer = Trace->CurrentTraceBuffer;
+        if (!Buffer || (Buffer->NumEntries == Buffer->MaxEntries))
+        {
+            Buffer = ExAllocatePoolWithTag(NonPagedPool,
+                                           FIELD_OFFSET(PFSN_LOG_ENTRIES, Entries[PF_LOG_BUFFER_ENTRIES]),
+                                           TAG_PF_TRACE);
+            if (!Buffer)
+                return;
+
+            Buffer->NumEntries = 0;
+            Buffer->MaxEntries = PF_LOG_BUFFER_ENTRIES;
+            InsertTailList(&Trace->TraceBuffersList, &Buffer->TraceBuffersLink);
+            Trace->NumTraceBuffers++;
+            Trace->CurrentTraceBuffer = Buffer;
+        }
+
+        Entry = &Buffer->Entries[Buffer->NumEntries++];
+        Entry->FileOffset = PageIndex;
+        Entry->Type = Image ? PF_LOG_ENTRY_IMAGE : PF_LOG_ENTRY_DATA;
+        Entry->FileKey = FileKey;
+        Trace->NumFaults++;
+    }
+}
+
+VOID
+NTAPI
+CcPfLogPageFault(
+    IN PFILE_OBJECT FileObject,
+    IN LONGLONG FileOffset,
+    IN ULONG Length,
+    IN BOOLEAN Image)
+{
+    PEPROCESS Process = PsGetCurrentProcess();
+    PPFSN_TRACE_HEADER Trace;
+    PLIST_ENTRY ListEntry;
+    ULONGLONG FirstPage, LastPage;
+    KIRQL OldIrql;
+
+    /* Don't bother with the lock when nothing is traced */
+    if (!CcPfEnablePrefetcher || IsListEmpty(&CcPfGlobals.ActiveTraces))
+        return;
+
+    if (!FileObject || (FileOffset < 0) || (Length == 0))
+        return;
+
+    /* Every page of the range was read in */
+    FirstPage = (ULONGLONG)FileOffset >> PAGE_SHIFT;
+    LastPage = ((ULONGLONG)FileOffset + Length - 1) >> PAGE_SHIFT;
+    if (FirstPage > PF_MAX_PAGE_INDEX)
+        return;
+    LastPage = min(LastPage, PF_MAX_PAGE_INDEX);
+
+    KeAcquireSpinLock(&CcPfGlobals.ActiveTracesLock, &OldIrql);
+    for (ListEntry = CcPfGlobals.ActiveTraces.Flink;
+         ListEntry != &CcPfGlobals.ActiveTraces;
+         ListEntry = ListEntry->Flink)
+    {
+        Trace = CONTAINING_RECORD(ListEntry, PFSN_TRACE_HEADER, ActiveTracesLink);
+
+        /* The boot trace takes the faults of everyone */
+        if ((Trace->ScenarioType == PfApplicationLaunchScenarioType) && (Trace->Process != Process))
+            continue;
+
+        CcPfLogEntries(Trace, FileObject, (ULONG)FirstPage, (ULONG)(LastPage - FirstPage + 1), Image);
+    }
+    KeReleaseSpinLock(&CcPfGlobals.ActiveTracesLock, OldIrql);
+}
+
+/* EOF */
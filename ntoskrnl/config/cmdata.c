@@ -274,6 +274,13 @@ DATA_SEG("INITDATA") CM_SYSTEM_CONTROL_VECTOR CmControlVector[] =
         NULL,
         NULL
     },
+    {
+        L"Session Manager\\Memory Management\\PrefetchParameters",
+        L"EnablePrefetcher",
+        &CcPfEnablePrefetcherMode,
+        NULL,
+        NULL
+    },
     {
         L"Session Manager\\Memory Management",
         L"PoolUsageMaximum",
@@ -16,41 +16,38 @@
 
 PAGED_LOOKASIDE_LIST FsRtlFileLockLookasideList;
 
-/* Note: this aligns the two types of lock entry structs so we can access the
-   FILE_LOCK_INFO part in common.  Add elements after Shared if new stuff is needed.
+/* Every lock, shared or exclusive, is a node of an interval tree. The tree is
+   a treap ordered on the starting byte, then the owner and the ending byte,
+   with a sequence number telling identical locks apart. Each node also keeps the highest
+   last byte of its subtree so that overlap queries can skip whole subtrees.
 */
-typedef union _COMBINED_LOCK_ELEMENT
+typedef struct _LOCK_RANGE
 {
-    struct
-    {
-        LIST_ENTRY dummy;
-        FILE_SHARED_LOCK_ENTRY Shared;
-    };
-    FILE_EXCLUSIVE_LOCK_ENTRY Exclusive;
+    struct _LOCK_RANGE *Parent;
+    struct _LOCK_RANGE *Left;
+    struct _LOCK_RANGE *Right;
+    ULONG Priority;
+    ULONG Sequence;
+    LONGLONG MaxLast;
+    FILE_LOCK_INFO Lock;
 }
-    COMBINED_LOCK_ELEMENT, *PCOMBINED_LOCK_ELEMENT;
+    LOCK_RANGE, *PLOCK_RANGE;
 
 typedef struct _LOCK_INFORMATION
 {
-    RTL_GENERIC_TABLE RangeTable;
+    EX_PUSH_LOCK TreeLock;
+    PLOCK_RANGE Root;
+    ULONG LockCount;
+    ULONG Seed;
+    ULONG NextSequence;
     IO_CSQ Csq;
     KSPIN_LOCK CsqLock;
     LIST_ENTRY CsqList;
     PFILE_LOCK BelongsTo;
-    LIST_ENTRY SharedLocks;
     ULONG Generation;
 }
     LOCK_INFORMATION, *PLOCK_INFORMATION;
 
-typedef struct _LOCK_SHARED_RANGE
-{
-    LIST_ENTRY Entry;
-    LARGE_INTEGER Start, End;
-    ULONG Key;
-    PVOID ProcessId;
-}
-    LOCK_SHARED_RANGE, *PLOCK_SHARED_RANGE;
-
 /* PRIVATE FUNCTIONS *********************************************************/
 
 VOID
@@ -62,57 +59,335 @@ FsRtlCompleteLockIrpReal(IN PCOMPLETE_LOCK_IRP_ROUTINE CompleteRoutine,
                          OUT PNTSTATUS NewStatus,
                          IN PFILE_OBJECT FileObject OPTIONAL);
 
-/* Generic table methods */
+/* Tree lock helpers */
 
-static PVOID NTAPI LockAllocate(PRTL_GENERIC_TABLE Table, CLONG Bytes)
+FORCEINLINE
+VOID
+FsRtlpAcquireLockTreeShared(IN PLOCK_INFORMATION LockInfo)
 {
-    PVOID Result;
-    Result = ExAllocatePoolWithTag(NonPagedPool, Bytes, TAG_TABLE);
-    DPRINT("LockAllocate(%lu) => %p\n", Bytes, Result);
-    return Result;
+    KeEnterCriticalRegion();
+    ExAcquirePushLockShared(&LockInfo->TreeLock);
 }
 
-static VOID NTAPI LockFree(PRTL_GENERIC_TABLE Table, PVOID Buffer)
+FORCEINLINE
+VOID
+FsRtlpReleaseLockTreeShared(IN PLOCK_INFORMATION LockInfo)
 {
-    DPRINT("LockFree(%p)\n", Buffer);
-    ExFreePoolWithTag(Buffer, TAG_TABLE);
+    ExReleasePushLockShared(&LockInfo->TreeLock);
+    KeLeaveCriticalRegion();
 }
 
-static RTL_GENERIC_COMPARE_RESULTS NTAPI LockCompare
-(PRTL_GENERIC_TABLE Table, PVOID PtrA, PVOID PtrB)
+FORCEINLINE
+VOID
+FsRtlpAcquireLockTreeExclusive(IN PLOCK_INFORMATION LockInfo)
 {
-    PCOMBINED_LOCK_ELEMENT A = PtrA, B = PtrB;
-    RTL_GENERIC_COMPARE_RESULTS Result;
-#if 0
-    DPRINT("Starting to compare element %x to element %x\n", PtrA, PtrB);
-#endif
-    /* Match if we overlap */
-    if (((A->Exclusive.FileLock.StartingByte.QuadPart <
-          B->Exclusive.FileLock.EndingByte.QuadPart) &&
-         (A->Exclusive.FileLock.StartingByte.QuadPart >=
-          B->Exclusive.FileLock.StartingByte.QuadPart)) ||
-        ((B->Exclusive.FileLock.StartingByte.QuadPart <
-          A->Exclusive.FileLock.EndingByte.QuadPart) &&
-         (B->Exclusive.FileLock.StartingByte.QuadPart >=
-          A->Exclusive.FileLock.StartingByte.QuadPart)))
-        return GenericEqual;
-    /* Otherwise, key on the starting byte */
-    Result =
-        (A->Exclusive.FileLock.StartingByte.QuadPart <
-         B->Exclusive.FileLock.StartingByte.QuadPart) ? GenericLessThan :
-        (A->Exclusive.FileLock.StartingByte.QuadPart >
-         B->Exclusive.FileLock.StartingByte.QuadPart) ? GenericGreaterThan :
-        GenericEqual;
-#if 0
-    DPRINT("Compare(%x:%x) %x-%x to %x-%x => %d\n",
-           A,B,
-           A->Exclusive.FileLock.StartingByte.LowPart,
-           A->Exclusive.FileLock.EndingByte.LowPart,
-           B->Exclusive.FileLock.StartingByte.LowPart,
-           B->Exclusive.FileLock.EndingByte.LowPart,
-           Result);
-#endif
-    return Result;
+    KeEnterCriticalRegion();
+    ExAcquirePushLockExclusive(&LockInfo->TreeLock);
+}
+
+FORCEINLINE
+VOID
+FsRtlpReleaseLockTreeExclusive(IN PLOCK_INFORMATION LockInfo)
+{
+    ExReleasePushLockExclusive(&LockInfo->TreeLock);
+    KeLeaveCriticalRegion();
+}
+
+/* Range methods */
+
+/* An empty range is a point at its starting byte */
+FORCEINLINE
+LONGLONG
+FsRtlpLastByte(IN PFILE_LOCK_INFO Lock)
+{
+    if (Lock->EndingByte.QuadPart > Lock->StartingByte.QuadPart)
+        return Lock->EndingByte.QuadPart - 1;
+    return Lock->StartingByte.QuadPart;
+}
+
+static BOOLEAN FsRtlpRangesOverlap(PFILE_LOCK_INFO A, PFILE_LOCK_INFO B)
+{
+    /* Two empty ranges never overlap */
+    if (A->EndingByte.QuadPart == A->StartingByte.QuadPart &&
+        B->EndingByte.QuadPart == B->StartingByte.QuadPart)
+        return FALSE;
+    return A->StartingByte.QuadPart <= FsRtlpLastByte(B) &&
+        B->StartingByte.QuadPart <= FsRtlpLastByte(A);
+}
+
+/* A lock belongs to the file object, process and key that took it */
+FORCEINLINE
+BOOLEAN
+FsRtlpIsLockOwner(IN PFILE_LOCK_INFO Lock,
+                  IN PFILE_OBJECT FileObject,
+                  IN PVOID ProcessId,
+                  IN ULONG Key)
+{
+    return Lock->FileObject == FileObject &&
+        Lock->ProcessId == ProcessId &&
+        Lock->Key == Key;
+}
+
+/* Interval tree methods */
+
+/* Orders the locks on their starting byte first, so that the overlap queries
+   only need to look at that, then on the owner, the ending byte and the order
+   they were taken in */
+static LONG FsRtlpCompareLocks(PFILE_LOCK_INFO A, ULONG SequenceA,
+                               PFILE_LOCK_INFO B, ULONG SequenceB)
+{
+    if (A->StartingByte.QuadPart != B->StartingByte.QuadPart)
+        return A->StartingByte.QuadPart < B->StartingByte.QuadPart ? -1 : 1;
+    if (A->ProcessId != B->ProcessId)
+        return (ULONG_PTR)A->ProcessId < (ULONG_PTR)B->ProcessId ? -1 : 1;
+    if (A->FileObject != B->FileObject)
+        return (ULONG_PTR)A->FileObject < (ULONG_PTR)B->FileObject ? -1 : 1;
+    if (A->Key != B->Key)
+        return A->Key < B->Key ? -1 : 1;
+    if (A->EndingByte.QuadPart != B->EndingByte.QuadPart)
+        return A->EndingByte.QuadPart < B->EndingByte.QuadPart ? -1 : 1;
+    if (SequenceA != SequenceB)
+        return SequenceA < SequenceB ? -1 : 1;
+    return 0;
+}
+
+static VOID FsRtlpUpdateMaxLast(PLOCK_RANGE Range)
+{
+    Range->MaxLast = FsRtlpLastByte(&Range->Lock);
+    if (Range->Left && Range->Left->MaxLast > Range->MaxLast)
+        Range->MaxLast = Range->Left->MaxLast;
+    if (Range->Right && Range->Right->MaxLast > Range->MaxLast)
+        Range->MaxLast = Range->Right->MaxLast;
+}
+
+/* Swaps a range with its parent, keeping the order of the tree */
+static VOID FsRtlpRotateUp(PLOCK_INFORMATION LockInfo, PLOCK_RANGE Range)
+{
+    PLOCK_RANGE Parent = Range->Parent;
+    PLOCK_RANGE GrandParent = Parent->Parent;
+
+    if (Parent->Left == Range)
+    {
+        Parent->Left = Range->Right;
+        if (Range->Right) Range->Right->Parent = Parent;
+        Range->Right = Parent;
+    }
+    else
+    {
+        Parent->Right = Range->Left;
+        if (Range->Left) Range->Left->Parent = Parent;
+        Range->Left = Parent;
+    }
+    Parent->Parent = Range;
+    Range->Parent = GrandParent;
+
+    if (!GrandParent)
+        LockInfo->Root = Range;
+    else if (GrandParent->Left == Parent)
+        GrandParent->Left = Range;
+    else
+        GrandParent->Right = Range;
+
+    FsRtlpUpdateMaxLast(Parent);
+    FsRtlpUpdateMaxLast(Range);
+}
+
+static VOID FsRtlpInsertRange(PLOCK_INFORMATION LockInfo, PLOCK_RANGE Range)
+{
+    PLOCK_RANGE Parent = NULL;
+    PLOCK_RANGE *Link = &LockInfo->Root;
+    LONGLONG Last = FsRtlpLastByte(&Range->Lock);
+
+    Range->Left = Range->Right = NULL;
+    Range->MaxLast = Last;
+    Range->Priority = RtlRandomEx(&LockInfo->Seed);
+
+    /* Zero is left for "nothing returned yet" in FsRtlGetNextFileLock */
+    Range->Sequence = ++LockInfo->NextSequence;
+    if (!Range->Sequence) Range->Sequence = ++LockInfo->NextSequence;
+
+    /* Go down to the leaf where the range belongs, its ancestors now cover it */
+    while (*Link)
+    {
+        Parent = *Link;
+        if (Parent->MaxLast < Last) Parent->MaxLast = Last;
+        if (FsRtlpCompareLocks(&Range->Lock, Range->Sequence,
+                               &Parent->Lock, Parent->Sequence) < 0)
+            Link = &Parent->Left;
+        else
+            Link = &Parent->Right;
+    }
+    Range->Parent = Parent;
+    *Link = Range;
+
+    /* Then bring it up until the priorities are back in heap order */
+    while (Range->Parent && Range->Parent->Priority < Range->Priority)
+        FsRtlpRotateUp(LockInfo, Range);
+}
+
+static VOID FsRtlpRemoveRange(PLOCK_INFORMATION LockInfo, PLOCK_RANGE Range)
+{
+    PLOCK_RANGE Child, Parent;
+
+    /* Push the range down until it has at most one child */
+    while (Range->Left && Range->Right)
+    {
+        if (Range->Left->Priority > Range->Right->Priority)
+            FsRtlpRotateUp(LockInfo, Range->Left);
+        else
+            FsRtlpRotateUp(LockInfo, Range->Right);
+    }
+
+    Child = Range->Left ? Range->Left : Range->Right;
+    Parent = Range->Parent;
+    if (Child) Child->Parent = Parent;
+    if (!Parent)
+        LockInfo->Root = Child;
+    else if (Parent->Left == Range)
+        Parent->Left = Child;
+    else
+        Parent->Right = Child;
+
+    /* The ancestors may not reach as far anymore */
+    for (; Parent; Parent = Parent->Parent)
+        FsRtlpUpdateMaxLast(Parent);
+}
+
+/* Frees the whole tree from the leaves up */
+static VOID FsRtlpFreeAllRanges(PLOCK_INFORMATION LockInfo)
+{
+    PLOCK_RANGE Range = LockInfo->Root, Parent;
+    while (Range)
+    {
+        if (Range->Left)
+        {
+            Range = Range->Left;
+            continue;
+        }
+        if (Range->Right)
+        {
+            Range = Range->Right;
+            continue;
+        }
+        Parent = Range->Parent;
+        if (Parent)
+        {
+            if (Parent->Left == Range) Parent->Left = NULL;
+            else Parent->Right = NULL;
+        }
+        ExFreePoolWithTag(Range, TAG_RANGE);
+        Range = Parent;
+    }
+    LockInfo->Root = NULL;
+    LockInfo->LockCount = 0;
+}
+
+static PLOCK_RANGE FsRtlpFirstRange(PLOCK_INFORMATION LockInfo)
+{
+    PLOCK_RANGE Range = LockInfo->Root;
+    if (!Range) return NULL;
+    while (Range->Left) Range = Range->Left;
+    return Range;
+}
+
+static PLOCK_RANGE FsRtlpNextRange(PLOCK_RANGE Range)
+{
+    if (Range->Right)
+    {
+        Range = Range->Right;
+        while (Range->Left) Range = Range->Left;
+        return Range;
+    }
+    while (Range->Parent && Range->Parent->Right == Range)
+        Range = Range->Parent;
+    return Range->Parent;
+}
+
+/* Returns the first range starting at or after Start */
+static PLOCK_RANGE FsRtlpLowerBoundRange(PLOCK_INFORMATION LockInfo, LONGLONG Start)
+{
+    PLOCK_RANGE Range = LockInfo->Root, Found = NULL;
+    while (Range)
+    {
+        if (Range->Lock.StartingByte.QuadPart >= Start)
+        {
+            Found = Range;
+            Range = Range->Left;
+        }
+        else
+        {
+            Range = Range->Right;
+        }
+    }
+    return Found;
+}
+
+/* Returns the first range that sorts after the given lock, which need not be
+   in the tree anymore */
+static PLOCK_RANGE FsRtlpUpperBoundRange(PLOCK_INFORMATION LockInfo,
+                                         PFILE_LOCK_INFO Lock,
+                                         ULONG Sequence)
+{
+    PLOCK_RANGE Range = LockInfo->Root, Found = NULL;
+    while (Range)
+    {
+        if (FsRtlpCompareLocks(&Range->Lock, Range->Sequence, Lock, Sequence) > 0)
+        {
+            Found = Range;
+            Range = Range->Left;
+        }
+        else
+        {
+            Range = Range->Right;
+        }
+    }
+    return Found;
+}
+
+/* Returns the first range of the subtree that may reach Start, skipping the
+   left subtrees that all end before it */
+static PLOCK_RANGE FsRtlpFirstCandidateRange(PLOCK_RANGE Range, LONGLONG Start)
+{
+    if (!Range || Range->MaxLast < Start) return NULL;
+    while (Range->Left && Range->Left->MaxLast >= Start)
+        Range = Range->Left;
+    return Range;
+}
+
+static PLOCK_RANGE FsRtlpNextCandidateRange(PLOCK_RANGE Range, LONGLONG Start)
+{
+    PLOCK_RANGE Next = FsRtlpFirstCandidateRange(Range->Right, Start);
+    if (Next) return Next;
+    while (Range->Parent && Range->Parent->Right == Range)
+        Range = Range->Parent;
+    return Range->Parent;
+}
+
+/* Enumerates the ranges overlapping ToFind in order, in O(log n) per range */
+static PLOCK_RANGE FsRtlpNextOverlappingRange
+(PLOCK_INFORMATION LockInfo,
+ PLOCK_RANGE Previous,
+ PFILE_LOCK_INFO ToFind)
+{
+    PLOCK_RANGE Range;
+    LONGLONG Start = ToFind->StartingByte.QuadPart;
+    LONGLONG Last = FsRtlpLastByte(ToFind);
+
+    if (!Previous)
+        Range = FsRtlpFirstCandidateRange(LockInfo->Root, Start);
+    else
+        Range = FsRtlpNextCandidateRange(Previous, Start);
+
+    while (Range)
+    {
+        /* All the following ranges start after ToFind */
+        if (Range->Lock.StartingByte.QuadPart > Last)
+            return NULL;
+        if (FsRtlpRangesOverlap(&Range->Lock, ToFind))
+            return Range;
+        Range = FsRtlpNextCandidateRange(Range, Start);
+    }
+    return NULL;
 }
 
 /* CSQ methods */
@@ -134,11 +409,11 @@ static VOID NTAPI LockRemoveIrp(PIO_CSQ Csq, PIRP Irp)
 
 static PIRP NTAPI LockPeekNextIrp(PIO_CSQ Csq, PIRP Irp, PVOID PeekContext)
 {
-    // Context will be a COMBINED_LOCK_ELEMENT.  We're looking for a
+    // Context will be a FILE_LOCK_INFO.  We're looking for a
     // lock that can be acquired, now that the lock matching PeekContext
     // has been removed.
-    COMBINED_LOCK_ELEMENT LockElement;
-    PCOMBINED_LOCK_ELEMENT WhereUnlock = PeekContext;
+    FILE_LOCK_INFO LockElement;
+    PFILE_LOCK_INFO WhereUnlock = PeekContext;
     PLOCK_INFORMATION LockInfo = CONTAINING_RECORD(Csq, LOCK_INFORMATION, Csq);
     PLIST_ENTRY Following;
     DPRINT("PeekNextIrp(IRP %p, Context %p)\n", Irp, PeekContext);
@@ -159,16 +434,15 @@ static PIRP NTAPI LockPeekNextIrp(PIO_CSQ Csq, PIRP Irp, PVOID PeekContext)
         Irp = CONTAINING_RECORD(Following, IRP, Tail.Overlay.ListEntry);
         DPRINT("Irp %p\n", Irp);
         IoStack = IoGetCurrentIrpStackLocation(Irp);
-        LockElement.Exclusive.FileLock.StartingByte =
+        LockElement.StartingByte =
             IoStack->Parameters.LockControl.ByteOffset;
-        LockElement.Exclusive.FileLock.EndingByte.QuadPart =
-            LockElement.Exclusive.FileLock.StartingByte.QuadPart +
+        LockElement.EndingByte.QuadPart =
+            LockElement.StartingByte.QuadPart +
             IoStack->Parameters.LockControl.Length->QuadPart;
         /* If a context was specified, it's a range to check to unlock */
         if (WhereUnlock)
         {
-            Matching = LockCompare
-                (&LockInfo->RangeTable, &LockElement, WhereUnlock) != GenericEqual;
+            Matching = !FsRtlpRangesOverlap(&LockElement, WhereUnlock);
         }
         /* Else get any completable IRP */
         else
@@ -245,6 +519,186 @@ FsRtlCompleteLockIrpReal(IN PCOMPLETE_LOCK_IRP_ROUTINE CompleteRoutine,
     }
 }
 
+static
+PLOCK_INFORMATION
+FsRtlpGetLockInformation(IN PFILE_LOCK FileLock)
+{
+    PLOCK_INFORMATION LockInfo, Existing;
+
+    LockInfo = FileLock->LockInformation;
+    if (LockInfo) return LockInfo;
+
+    LockInfo = ExAllocatePoolWithTag(NonPagedPool, sizeof(LOCK_INFORMATION), TAG_FLOCK);
+    if (!LockInfo) return NULL;
+
+    ExInitializePushLock(&LockInfo->TreeLock);
+    LockInfo->Root = NULL;
+    LockInfo->LockCount = 0;
+    LockInfo->Seed = (ULONG)(ULONG_PTR)LockInfo;
+    LockInfo->NextSequence = 0;
+    LockInfo->BelongsTo = FileLock;
+    LockInfo->Generation = 0;
+
+    KeInitializeSpinLock(&LockInfo->CsqLock);
+    InitializeListHead(&LockInfo->CsqList);
+
+    IoCsqInitializeEx
+        (&LockInfo->Csq,
+         LockInsertIrpEx,
+         LockRemoveIrp,
+         LockPeekNextIrp,
+         LockAcquireQueueLock,
+         LockReleaseQueueLock,
+         LockCompleteCanceledIrp);
+
+    /* Somebody else may have set it up in the meantime */
+    Existing = InterlockedCompareExchangePointer(&FileLock->LockInformation,
+                                                 LockInfo,
+                                                 NULL);
+    if (Existing)
+    {
+        ExFreePoolWithTag(LockInfo, TAG_FLOCK);
+        return Existing;
+    }
+
+    return LockInfo;
+}
+
+static
+BOOLEAN
+FsRtlpCheckLockForAccess(IN PFILE_LOCK FileLock,
+                         IN PLARGE_INTEGER FileOffset,
+                         IN LONGLONG Length,
+                         IN ULONG Key,
+                         IN PFILE_OBJECT FileObject,
+                         IN PVOID Process,
+                         IN BOOLEAN Write)
+{
+    PLOCK_INFORMATION LockInfo = FileLock->LockInformation;
+    FILE_LOCK_INFO ToFind;
+    PLOCK_RANGE Range;
+    BOOLEAN Result = TRUE;
+
+    /* Nothing can conflict when no lock is held, don't even take the tree lock */
+    if (!LockInfo || !LockInfo->LockCount) return TRUE;
+
+    ToFind.StartingByte = *FileOffset;
+    ToFind.EndingByte.QuadPart = FileOffset->QuadPart + Length;
+
+    /* Checks only read the tree, so they can run alongside each other */
+    FsRtlpAcquireLockTreeShared(LockInfo);
+    for (Range = FsRtlpNextOverlappingRange(LockInfo, NULL, &ToFind);
+         Range;
+         Range = FsRtlpNextOverlappingRange(LockInfo, Range, &ToFind))
+    {
+        /* Exclusive locks only let their owner in, shared locks let nobody write */
+        if ((Range->Lock.ExclusiveLock &&
+             !FsRtlpIsLockOwner(&Range->Lock, FileObject, Process, Key)) ||
+            (!Range->Lock.ExclusiveLock && Write))
+        {
+            DPRINT("Conflict %08x%08x:%08x%08x Exc %u\n",
+                   Range->Lock.StartingByte.HighPart,
+                   Range->Lock.StartingByte.LowPart,
+                   Range->Lock.EndingByte.HighPart,
+                   Range->Lock.EndingByte.LowPart,
+                   Range->Lock.ExclusiveLock);
+            Result = FALSE;
+            break;
+        }
+    }
+    FsRtlpReleaseLockTreeShared(LockInfo);
+
+    return Result;
+}
+
+/* Retries the pending lock IRPs that the unlocked range (or any range if
+   none is given) was blocking */
+static
+NTSTATUS
+FsRtlpRetryPendingLocks(IN PFILE_LOCK FileLock,
+                        IN PFILE_LOCK_INFO Unlocked OPTIONAL)
+{
+    PIRP NextMatchingLockIrp;
+    PLOCK_INFORMATION InternalInfo = FileLock->LockInformation;
+
+    while ((NextMatchingLockIrp = IoCsqRemoveNextIrp(&InternalInfo->Csq, Unlocked)))
+    {
+        NTSTATUS Status;
+        if (NextMatchingLockIrp->IoStatus.Information == InternalInfo->Generation)
+        {
+            // We've already looked at this one, meaning that we looped.
+            // Put it back and exit.
+            IoCsqInsertIrpEx
+                (&InternalInfo->Csq,
+                 NextMatchingLockIrp,
+                 NULL,
+                 NULL);
+            break;
+        }
+        // Got a new lock irp... try to do the new lock operation
+        // Note that we pick an operation that would succeed at the time
+        // we looked, but can't guarantee that it won't just be re-queued
+        // because somebody else snatched part of the range in a new thread.
+        DPRINT("Locking another IRP %p for %p\n", NextMatchingLockIrp, FileLock);
+        Status = FsRtlProcessFileLock(FileLock, NextMatchingLockIrp, NULL);
+        if (!NT_SUCCESS(Status))
+            return Status;
+    }
+
+    return STATUS_SUCCESS;
+}
+
+static
+NTSTATUS
+FsRtlpFastUnlockAllMatching(IN PFILE_LOCK FileLock,
+                            IN PFILE_OBJECT FileObject,
+                            IN PEPROCESS Process,
+                            IN ULONG Key,
+                            IN BOOLEAN MatchKey)
+{
+    PLOCK_RANGE Range, Next;
+    ULONG Unlocked = 0;
+    PLOCK_INFORMATION InternalInfo = FileLock->LockInformation;
+
+    if (!InternalInfo) return STATUS_RANGE_NOT_LOCKED; // no locks
+
+    FsRtlpAcquireLockTreeExclusive(InternalInfo);
+
+    /* Removing a range keeps the order of the others, so the walk can go on from its successor */
+    for (Range = FsRtlpFirstRange(InternalInfo); Range; Range = Next)
+    {
+        Next = FsRtlpNextRange(Range);
+        if (Range->Lock.FileObject != FileObject ||
+            Range->Lock.ProcessId != Process ||
+            (MatchKey && Range->Lock.Key != Key))
+            continue;
+
+        DPRINT("Unlocking %08x%08x:%08x%08x Key %x\n",
+               Range->Lock.StartingByte.HighPart,
+               Range->Lock.StartingByte.LowPart,
+               Range->Lock.EndingByte.HighPart,
+               Range->Lock.EndingByte.LowPart,
+               Range->Lock.Key);
+        FsRtlpRemoveRange(InternalInfo, Range);
+        ExFreePoolWithTag(Range, TAG_RANGE);
+        Unlocked++;
+    }
+
+    if (Unlocked)
+    {
+        InternalInfo->LockCount -= Unlocked;
+        if (!InternalInfo->LockCount) FileLock->FastIoIsQuestionable = FALSE;
+        InternalInfo->Generation++;
+    }
+
+    FsRtlpReleaseLockTreeExclusive(InternalInfo);
+
+    if (Unlocked)
+        FsRtlpRetryPendingLocks(FileLock, NULL);
+
+    return STATUS_SUCCESS;
+}
+
 /* PUBLIC FUNCTIONS **********************************************************/
 
 /*
@@ -255,65 +709,34 @@ NTAPI
 FsRtlGetNextFileLock(IN PFILE_LOCK FileLock,
                      IN BOOLEAN Restart)
 {
-    PCOMBINED_LOCK_ELEMENT Entry;
-    if (!FileLock->LockInformation) return NULL;
-    Entry = RtlEnumerateGenericTable(FileLock->LockInformation, Restart);
-    if (!Entry) return NULL;
-    else return &Entry->Exclusive.FileLock;
-}
+    PLOCK_RANGE Range;
+    PLOCK_INFORMATION LockInfo = FileLock->LockInformation;
+    if (!LockInfo) return NULL;
 
-VOID
-NTAPI
-FsRtlpExpandLockElement
-(PCOMBINED_LOCK_ELEMENT ToExpand,
- PCOMBINED_LOCK_ELEMENT Conflict)
-{
-    if (ToExpand->Exclusive.FileLock.StartingByte.QuadPart >
-        Conflict->Exclusive.FileLock.StartingByte.QuadPart)
+    FsRtlpAcquireLockTreeShared(LockInfo);
+    if (Restart || !FileLock->LastReturnedLock)
     {
-        ToExpand->Exclusive.FileLock.StartingByte =
-            Conflict->Exclusive.FileLock.StartingByte;
+        Range = FsRtlpFirstRange(LockInfo);
     }
-    if (ToExpand->Exclusive.FileLock.EndingByte.QuadPart <
-        Conflict->Exclusive.FileLock.EndingByte.QuadPart)
+    else
     {
-        ToExpand->Exclusive.FileLock.EndingByte =
-            Conflict->Exclusive.FileLock.EndingByte;
+        /* Resume after the lock we returned, by its place in the order
+           rather than by its range, which may be gone or reused by now */
+        Range = FsRtlpUpperBoundRange(LockInfo,
+                                      &FileLock->LastReturnedLockInfo,
+                                      (ULONG)(ULONG_PTR)FileLock->LastReturnedLock);
     }
-}
 
-/* This function expands the conflicting range Conflict by removing and reinserting it,
-   then adds a shared range of the same size */
-PCOMBINED_LOCK_ELEMENT
-NTAPI
-FsRtlpRebuildSharedLockRange
-(PFILE_LOCK FileLock,
- PLOCK_INFORMATION LockInfo,
- PCOMBINED_LOCK_ELEMENT Conflict)
-{
-    /* Starting at Conflict->StartingByte and going to Conflict->EndingByte
-     * capture and expand a shared range from the shared range list.
-     * Finish when we've incorporated all overlapping shared regions.
-     */
-    BOOLEAN InsertedNew = FALSE, RemovedOld;
-    COMBINED_LOCK_ELEMENT NewElement = *Conflict;
-    PCOMBINED_LOCK_ELEMENT Entry;
-    while ((Entry = RtlLookupElementGenericTable
-            (FileLock->LockInformation, &NewElement)))
+    /* Hand out a copy, the range can be unlocked as soon as we let go of the
+       tree, and keep its sequence number instead of a pointer to it */
+    if (Range)
     {
-        FsRtlpExpandLockElement(&NewElement, Entry);
-        RemovedOld = RtlDeleteElementGenericTable
-            (&LockInfo->RangeTable,
-             Entry);
-        ASSERT(RemovedOld);
+        FileLock->LastReturnedLockInfo = Range->Lock;
+        FileLock->LastReturnedLock = (PVOID)(ULONG_PTR)Range->Sequence;
     }
-    Conflict = RtlInsertElementGenericTable
-        (&LockInfo->RangeTable,
-         &NewElement,
-         sizeof(NewElement),
-         &InsertedNew);
-    ASSERT(InsertedNew);
-    return Conflict;
+    FsRtlpReleaseLockTreeShared(LockInfo);
+
+    return Range ? &FileLock->LastReturnedLockInfo : NULL;
 }
 
 /*
@@ -335,11 +758,8 @@ FsRtlPrivateLock(IN PFILE_LOCK FileLock,
                  IN BOOLEAN AlreadySynchronized)
 {
     NTSTATUS Status;
-    COMBINED_LOCK_ELEMENT ToInsert;
-    PCOMBINED_LOCK_ELEMENT Conflict;
     PLOCK_INFORMATION LockInfo;
-    PLOCK_SHARED_RANGE NewSharedRange;
-    BOOLEAN InsertedNew;
+    PLOCK_RANGE NewRange, Conflict;
     ULARGE_INTEGER UnsignedStart;
     ULARGE_INTEGER UnsignedEnd;
 
@@ -362,286 +782,58 @@ FsRtlPrivateLock(IN PFILE_LOCK FileLock,
     {
         DPRINT("File offset out of range\n");
         IoStatus->Status = STATUS_INVALID_PARAMETER;
-        if (Irp)
-        {
-            DPRINT("Complete lock %p Status %x\n", Irp, IoStatus->Status);
-            FsRtlCompleteLockIrpReal
-                (FileLock->CompleteLockIrpRoutine,
-                 Context,
-                 Irp,
-                 IoStatus->Status,
-                 &Status,
-                 FileObject);
-        }
-        return FALSE;
+        goto Complete;
     }
 
     /* Initialize the lock, if necessary */
-    if (!FileLock->LockInformation)
+    LockInfo = FsRtlpGetLockInformation(FileLock);
+    if (!LockInfo)
     {
-        LockInfo = ExAllocatePoolWithTag(NonPagedPool, sizeof(LOCK_INFORMATION), TAG_FLOCK);
-        if (!LockInfo)
-        {
-            IoStatus->Status = STATUS_NO_MEMORY;
-            return FALSE;
-        }
-        FileLock->LockInformation = LockInfo;
-
-        LockInfo->BelongsTo = FileLock;
-        InitializeListHead(&LockInfo->SharedLocks);
-
-        RtlInitializeGenericTable
-            (&LockInfo->RangeTable,
-             LockCompare,
-             LockAllocate,
-             LockFree,
-             NULL);
-
-        KeInitializeSpinLock(&LockInfo->CsqLock);
-        InitializeListHead(&LockInfo->CsqList);
-
-        IoCsqInitializeEx
-            (&LockInfo->Csq,
-             LockInsertIrpEx,
-             LockRemoveIrp,
-             LockPeekNextIrp,
-             LockAcquireQueueLock,
-             LockReleaseQueueLock,
-             LockCompleteCanceledIrp);
+        IoStatus->Status = STATUS_NO_MEMORY;
+        goto Complete;
     }
 
-    LockInfo = FileLock->LockInformation;
-    ToInsert.Exclusive.FileLock.FileObject = FileObject;
-    ToInsert.Exclusive.FileLock.StartingByte = *FileOffset;
-    ToInsert.Exclusive.FileLock.EndingByte.QuadPart = FileOffset->QuadPart + Length->QuadPart;
-    ToInsert.Exclusive.FileLock.ProcessId = Process;
-    ToInsert.Exclusive.FileLock.Key = Key;
-    ToInsert.Exclusive.FileLock.ExclusiveLock = ExclusiveLock;
-
-    Conflict = RtlInsertElementGenericTable
-        (FileLock->LockInformation,
-         &ToInsert,
-         sizeof(ToInsert),
-         &InsertedNew);
-
-    if (Conflict && !InsertedNew)
+    NewRange = ExAllocatePoolWithTag(NonPagedPool, sizeof(*NewRange), TAG_RANGE);
+    if (!NewRange)
     {
-        if (Conflict->Exclusive.FileLock.ExclusiveLock || ExclusiveLock)
-        {
-            DPRINT("Conflict %08x%08x:%08x%08x Exc %u (Want Exc %u)\n",
-                   Conflict->Exclusive.FileLock.StartingByte.HighPart,
-                   Conflict->Exclusive.FileLock.StartingByte.LowPart,
-                   Conflict->Exclusive.FileLock.EndingByte.HighPart,
-                   Conflict->Exclusive.FileLock.EndingByte.LowPart,
-                   Conflict->Exclusive.FileLock.ExclusiveLock,
-                   ExclusiveLock);
-            if (FailImmediately)
-            {
-                DPRINT("STATUS_FILE_LOCK_CONFLICT\n");
-                IoStatus->Status = STATUS_FILE_LOCK_CONFLICT;
-                if (Irp)
-                {
-                    DPRINT("STATUS_FILE_LOCK_CONFLICT: Complete\n");
-                    FsRtlCompleteLockIrpReal
-                        (FileLock->CompleteLockIrpRoutine,
-                         Context,
-                         Irp,
-                         IoStatus->Status,
-                         &Status,
-                         FileObject);
-                }
-                return FALSE;
-            }
-            else
-            {
-                IoStatus->Status = STATUS_PENDING;
-                if (Irp)
-                {
-                    Irp->IoStatus.Information = LockInfo->Generation;
-                    IoMarkIrpPending(Irp);
-                    IoCsqInsertIrpEx
-                        (&LockInfo->Csq,
-                         Irp,
-                         NULL,
-                         NULL);
-                }
-            }
-            return FALSE;
-        }
-        else
-        {
-            ULONG i;
-            /* We know of at least one lock in range that's shared.  We need to
-             * find out if any more exist and any are exclusive. */
-            for (i = 0; i < RtlNumberGenericTableElements(&LockInfo->RangeTable); i++)
-            {
-                Conflict = RtlGetElementGenericTable(&LockInfo->RangeTable, i);
-
-                /* The first argument will be inserted as a shared range */
-                if (Conflict && (LockCompare(&LockInfo->RangeTable, Conflict, &ToInsert) == GenericEqual))
-                {
-                    if (Conflict->Exclusive.FileLock.ExclusiveLock)
-                    {
-                        /* Found an exclusive match */
-                        if (FailImmediately)
-                        {
-                            IoStatus->Status = STATUS_FILE_LOCK_CONFLICT;
-                            DPRINT("STATUS_FILE_LOCK_CONFLICT\n");
-                            if (Irp)
-                            {
-                                DPRINT("STATUS_FILE_LOCK_CONFLICT: Complete\n");
-                                FsRtlCompleteLockIrpReal
-                                    (FileLock->CompleteLockIrpRoutine,
-                                     Context,
-                                     Irp,
-                                     IoStatus->Status,
-                                     &Status,
-                                     FileObject);
-                            }
-                        }
-                        else
-                        {
-                            IoStatus->Status = STATUS_PENDING;
-                            if (Irp)
-                            {
-                                IoMarkIrpPending(Irp);
-                                IoCsqInsertIrpEx
-                                    (&LockInfo->Csq,
-                                     Irp,
-                                     NULL,
-                                     NULL);
-                            }
-                        }
-                        return FALSE;
-                    }
-                }
-            }
-
-            DPRINT("Overlapping shared lock %wZ %08x%08x %08x%08x\n",
-                   &FileObject->FileName,
-                   Conflict->Exclusive.FileLock.StartingByte.HighPart,
-                   Conflict->Exclusive.FileLock.StartingByte.LowPart,
-                   Conflict->Exclusive.FileLock.EndingByte.HighPart,
-                   Conflict->Exclusive.FileLock.EndingByte.LowPart);
-            Conflict = FsRtlpRebuildSharedLockRange(FileLock,
-                                                    LockInfo,
-                                                    &ToInsert);
-            if (!Conflict)
-            {
-                IoStatus->Status = STATUS_NO_MEMORY;
-                if (Irp)
-                {
-                    FsRtlCompleteLockIrpReal
-                        (FileLock->CompleteLockIrpRoutine,
-                         Context,
-                         Irp,
-                         IoStatus->Status,
-                         &Status,
-                         FileObject);
-                }
-            }
-
-            /* We got here because there were only overlapping shared locks */
-            /* A shared lock is both a range *and* a list entry.  Insert the
-               entry here. */
-
-            DPRINT("Adding shared lock %wZ\n", &FileObject->FileName);
-            NewSharedRange =
-                ExAllocatePoolWithTag(NonPagedPool, sizeof(*NewSharedRange), TAG_RANGE);
-            if (!NewSharedRange)
-            {
-                IoStatus->Status = STATUS_NO_MEMORY;
-                if (Irp)
-                {
-                    FsRtlCompleteLockIrpReal
-                        (FileLock->CompleteLockIrpRoutine,
-                         Context,
-                         Irp,
-                         IoStatus->Status,
-                         &Status,
-                         FileObject);
-                }
-                return FALSE;
-            }
-            DPRINT("Adding shared lock %wZ\n", &FileObject->FileName);
-            NewSharedRange->Start = *FileOffset;
-            NewSharedRange->End.QuadPart = FileOffset->QuadPart + Length->QuadPart;
-            NewSharedRange->Key = Key;
-            NewSharedRange->ProcessId = ToInsert.Exclusive.FileLock.ProcessId;
-            InsertTailList(&LockInfo->SharedLocks, &NewSharedRange->Entry);
-
-            DPRINT("Acquired shared lock %wZ %08x%08x %08x%08x\n",
-                   &FileObject->FileName,
-                   Conflict->Exclusive.FileLock.StartingByte.HighPart,
-                   Conflict->Exclusive.FileLock.StartingByte.LowPart,
-                   Conflict->Exclusive.FileLock.EndingByte.HighPart,
-                   Conflict->Exclusive.FileLock.EndingByte.LowPart);
-            IoStatus->Status = STATUS_SUCCESS;
-            if (Irp)
-            {
-                FsRtlCompleteLockIrpReal
-                    (FileLock->CompleteLockIrpRoutine,
-                     Context,
-                     Irp,
-                     IoStatus->Status,
-                     &Status,
-                     FileObject);
-            }
-            return TRUE;
-        }
+        IoStatus->Status = STATUS_NO_MEMORY;
+        goto Complete;
     }
-    else if (!Conflict)
+    NewRange->Lock.FileObject = FileObject;
+    NewRange->Lock.StartingByte = *FileOffset;
+    NewRange->Lock.Length = *Length;
+    NewRange->Lock.EndingByte.QuadPart = FileOffset->QuadPart + Length->QuadPart;
+    NewRange->Lock.ProcessId = Process;
+    NewRange->Lock.Key = Key;
+    NewRange->Lock.ExclusiveLock = ExclusiveLock;
+
+    FsRtlpAcquireLockTreeExclusive(LockInfo);
+
+    /* An exclusive lock conflicts with any other lock, a shared one only with
+       the exclusive locks of other owners */
+    for (Conflict = FsRtlpNextOverlappingRange(LockInfo, NULL, &NewRange->Lock);
+         Conflict;
+         Conflict = FsRtlpNextOverlappingRange(LockInfo, Conflict, &NewRange->Lock))
     {
-        /* Conflict here is (or would be) the newly inserted element, but we ran
-         * out of space probably. */
-        IoStatus->Status = STATUS_NO_MEMORY;
-        if (Irp)
-        {
-            FsRtlCompleteLockIrpReal
-                (FileLock->CompleteLockIrpRoutine,
-                 Context,
-                 Irp,
-                 IoStatus->Status,
-                 &Status,
-                 FileObject);
-        }
-        return FALSE;
+        if (ExclusiveLock ||
+            (Conflict->Lock.ExclusiveLock &&
+             !FsRtlpIsLockOwner(&Conflict->Lock, FileObject, Process, Key)))
+            break;
     }
-    else
+
+    if (!Conflict)
     {
         DPRINT("Inserted new lock %wZ %08x%08x %08x%08x exclusive %u\n",
                &FileObject->FileName,
-               Conflict->Exclusive.FileLock.StartingByte.HighPart,
-               Conflict->Exclusive.FileLock.StartingByte.LowPart,
-               Conflict->Exclusive.FileLock.EndingByte.HighPart,
-               Conflict->Exclusive.FileLock.EndingByte.LowPart,
-               Conflict->Exclusive.FileLock.ExclusiveLock);
-        if (!ExclusiveLock)
-        {
-            NewSharedRange =
-                ExAllocatePoolWithTag(NonPagedPool, sizeof(*NewSharedRange), TAG_RANGE);
-            if (!NewSharedRange)
-            {
-                IoStatus->Status = STATUS_NO_MEMORY;
-                if (Irp)
-                {
-                    FsRtlCompleteLockIrpReal
-                        (FileLock->CompleteLockIrpRoutine,
-                         Context,
-                         Irp,
-                         IoStatus->Status,
-                         &Status,
-                         FileObject);
-                }
-                return FALSE;
-            }
-            DPRINT("Adding shared lock %wZ\n", &FileObject->FileName);
-            NewSharedRange->Start = *FileOffset;
-            NewSharedRange->End.QuadPart = FileOffset->QuadPart + Length->QuadPart;
-            NewSharedRange->Key = Key;
-            NewSharedRange->ProcessId = Process;
-            InsertTailList(&LockInfo->SharedLocks, &NewSharedRange->Entry);
-        }
+               NewRange->Lock.StartingByte.HighPart,
+               NewRange->Lock.StartingByte.LowPart,
+               NewRange->Lock.EndingByte.HighPart,
+               NewRange->Lock.EndingByte.LowPart,
+               NewRange->Lock.ExclusiveLock);
+        FsRtlpInsertRange(LockInfo, NewRange);
+        LockInfo->LockCount++;
+        FileLock->FastIoIsQuestionable = TRUE;
+        FsRtlpReleaseLockTreeExclusive(LockInfo);
 
         /* Assume all is cool, and lock is set */
         IoStatus->Status = STATUS_SUCCESS;
@@ -659,9 +851,55 @@ FsRtlPrivateLock(IN PFILE_LOCK FileLock,
             /* Update the status */
             IoStatus->Status = Status;
         }
+
+        return TRUE;
     }
 
-    return TRUE;
+    DPRINT("Conflict %08x%08x:%08x%08x Exc %u (Want Exc %u)\n",
+           Conflict->Lock.StartingByte.HighPart,
+           Conflict->Lock.StartingByte.LowPart,
+           Conflict->Lock.EndingByte.HighPart,
+           Conflict->Lock.EndingByte.LowPart,
+           Conflict->Lock.ExclusiveLock,
+           ExclusiveLock);
+    ExFreePoolWithTag(NewRange, TAG_RANGE);
+
+    if (FailImmediately)
+    {
+        FsRtlpReleaseLockTreeExclusive(LockInfo);
+        DPRINT("STATUS_FILE_LOCK_CONFLICT\n");
+        IoStatus->Status = STATUS_FILE_LOCK_CONFLICT;
+        goto Complete;
+    }
+
+    /* Queue the IRP before letting go of the tree, so that it can't miss the unlock it waits for */
+    IoStatus->Status = STATUS_PENDING;
+    if (Irp)
+    {
+        Irp->IoStatus.Information = LockInfo->Generation;
+        IoMarkIrpPending(Irp);
+        IoCsqInsertIrpEx
+            (&LockInfo->Csq,
+             Irp,
+             NULL,
+             NULL);
+    }
+    FsRtlpReleaseLockTreeExclusive(LockInfo);
+    return FALSE;
+
+Complete:
+    if (Irp)
+    {
+        DPRINT("Complete lock %p Status %x\n", Irp, IoStatus->Status);
+        FsRtlCompleteLockIrpReal
+            (FileLock->CompleteLockIrpRoutine,
+             Context,
+             Irp,
+             IoStatus->Status,
+             &Status,
+             FileObject);
+    }
+    return FALSE;
 }
 
 /*
@@ -674,30 +912,18 @@ FsRtlCheckLockForReadAccess(IN PFILE_LOCK FileLock,
 {
     BOOLEAN Result;
     PIO_STACK_LOCATION IoStack = IoGetCurrentIrpStackLocation(Irp);
-    COMBINED_LOCK_ELEMENT ToFind;
-    PCOMBINED_LOCK_ELEMENT Found;
     DPRINT("CheckLockForReadAccess(%wZ, Offset %08x%08x, Length %x)\n",
            &IoStack->FileObject->FileName,
            IoStack->Parameters.Read.ByteOffset.HighPart,
            IoStack->Parameters.Read.ByteOffset.LowPart,
            IoStack->Parameters.Read.Length);
-    if (!FileLock->LockInformation) {
-        DPRINT("CheckLockForReadAccess(%wZ) => TRUE\n", &IoStack->FileObject->FileName);
-        return TRUE;
-    }
-    ToFind.Exclusive.FileLock.StartingByte = IoStack->Parameters.Read.ByteOffset;
-    ToFind.Exclusive.FileLock.EndingByte.QuadPart =
-        ToFind.Exclusive.FileLock.StartingByte.QuadPart +
-        IoStack->Parameters.Read.Length;
-    Found = RtlLookupElementGenericTable
-        (FileLock->LockInformation,
-         &ToFind);
-    if (!Found) {
-        DPRINT("CheckLockForReadAccess(%wZ) => TRUE\n", &IoStack->FileObject->FileName);
-        return TRUE;
-    }
-    Result = !Found->Exclusive.FileLock.ExclusiveLock ||
-        IoStack->Parameters.Read.Key == Found->Exclusive.FileLock.Key;
+    Result = FsRtlpCheckLockForAccess(FileLock,
+                                      &IoStack->Parameters.Read.ByteOffset,
+                                      IoStack->Parameters.Read.Length,
+                                      IoStack->Parameters.Read.Key,
+                                      IoStack->FileObject,
+                                      IoGetRequestorProcess(Irp),
+                                      FALSE);
     DPRINT("CheckLockForReadAccess(%wZ) => %s\n", &IoStack->FileObject->FileName, Result ? "TRUE" : "FALSE");
     return Result;
 }
@@ -712,30 +938,18 @@ FsRtlCheckLockForWriteAccess(IN PFILE_LOCK FileLock,
 {
     BOOLEAN Result;
     PIO_STACK_LOCATION IoStack = IoGetCurrentIrpStackLocation(Irp);
-    COMBINED_LOCK_ELEMENT ToFind;
-    PCOMBINED_LOCK_ELEMENT Found;
-    PEPROCESS Process = Irp->Tail.Overlay.Thread->ThreadsProcess;
     DPRINT("CheckLockForWriteAccess(%wZ, Offset %08x%08x, Length %x)\n",
            &IoStack->FileObject->FileName,
            IoStack->Parameters.Write.ByteOffset.HighPart,
            IoStack->Parameters.Write.ByteOffset.LowPart,
            IoStack->Parameters.Write.Length);
-    if (!FileLock->LockInformation) {
-        DPRINT("CheckLockForWriteAccess(%wZ) => TRUE\n", &IoStack->FileObject->FileName);
-        return TRUE;
-    }
-    ToFind.Exclusive.FileLock.StartingByte = IoStack->Parameters.Write.ByteOffset;
-    ToFind.Exclusive.FileLock.EndingByte.QuadPart =
-        ToFind.Exclusive.FileLock.StartingByte.QuadPart +
-        IoStack->Parameters.Write.Length;
-    Found = RtlLookupElementGenericTable
-        (FileLock->LockInformation,
-         &ToFind);
-    if (!Found) {
-        DPRINT("CheckLockForWriteAccess(%wZ) => TRUE\n", &IoStack->FileObject->FileName);
-        return TRUE;
-    }
-    Result = Process == Found->Exclusive.FileLock.ProcessId;
+    Result = FsRtlpCheckLockForAccess(FileLock,
+                                      &IoStack->Parameters.Write.ByteOffset,
+                                      IoStack->Parameters.Write.Length,
+                                      IoStack->Parameters.Write.Key,
+                                      IoStack->FileObject,
+                                      IoGetRequestorProcess(Irp),
+                                      TRUE);
     DPRINT("CheckLockForWriteAccess(%wZ) => %s\n", &IoStack->FileObject->FileName, Result ? "TRUE" : "FALSE");
     return Result;
 }
@@ -752,9 +966,6 @@ FsRtlFastCheckLockForRead(IN PFILE_LOCK FileLock,
                           IN PFILE_OBJECT FileObject,
                           IN PVOID Process)
 {
-    PEPROCESS EProcess = Process;
-    COMBINED_LOCK_ELEMENT ToFind;
-    PCOMBINED_LOCK_ELEMENT Found;
     DPRINT("FsRtlFastCheckLockForRead(%wZ, Offset %08x%08x, Length %08x%08x, Key %x)\n",
            &FileObject->FileName,
            FileOffset->HighPart,
@@ -762,16 +973,13 @@ FsRtlFastCheckLockForRead(IN PFILE_LOCK FileLock,
            Length->HighPart,
            Length->LowPart,
            Key);
-    ToFind.Exclusive.FileLock.StartingByte = *FileOffset;
-    ToFind.Exclusive.FileLock.EndingByte.QuadPart =
-        FileOffset->QuadPart + Length->QuadPart;
-    if (!FileLock->LockInformation) return TRUE;
-    Found = RtlLookupElementGenericTable
-        (FileLock->LockInformation,
-         &ToFind);
-    if (!Found || !Found->Exclusive.FileLock.ExclusiveLock) return TRUE;
-    return Found->Exclusive.FileLock.Key == Key &&
-        Found->Exclusive.FileLock.ProcessId == EProcess;
+    return FsRtlpCheckLockForAccess(FileLock,
+                                    FileOffset,
+                                    Length->QuadPart,
+                                    Key,
+                                    FileObject,
+                                    Process,
+                                    FALSE);
 }
 
 /*
@@ -787,9 +995,6 @@ FsRtlFastCheckLockForWrite(IN PFILE_LOCK FileLock,
                            IN PVOID Process)
 {
     BOOLEAN Result;
-    PEPROCESS EProcess = Process;
-    COMBINED_LOCK_ELEMENT ToFind;
-    PCOMBINED_LOCK_ELEMENT Found;
     DPRINT("FsRtlFastCheckLockForWrite(%wZ, Offset %08x%08x, Length %08x%08x, Key %x)\n",
            &FileObject->FileName,
            FileOffset->HighPart,
@@ -797,22 +1002,13 @@ FsRtlFastCheckLockForWrite(IN PFILE_LOCK FileLock,
            Length->HighPart,
            Length->LowPart,
            Key);
-    ToFind.Exclusive.FileLock.StartingByte = *FileOffset;
-    ToFind.Exclusive.FileLock.EndingByte.QuadPart =
-        FileOffset->QuadPart + Length->QuadPart;
-    if (!FileLock->LockInformation) {
-        DPRINT("CheckForWrite(%wZ) => TRUE\n", &FileObject->FileName);
-        return TRUE;
-    }
-    Found = RtlLookupElementGenericTable
-        (FileLock->LockInformation,
-         &ToFind);
-    if (!Found) {
-        DPRINT("CheckForWrite(%wZ) => TRUE\n", &FileObject->FileName);
-        return TRUE;
-    }
-    Result = Found->Exclusive.FileLock.Key == Key &&
-        Found->Exclusive.FileLock.ProcessId == EProcess;
+    Result = FsRtlpCheckLockForAccess(FileLock,
+                                      FileOffset,
+                                      Length->QuadPart,
+                                      Key,
+                                      FileObject,
+                                      Process,
+                                      TRUE);
     DPRINT("CheckForWrite(%wZ) => %s\n", &FileObject->FileName, Result ? "TRUE" : "FALSE");
     return Result;
 }
@@ -831,12 +1027,9 @@ FsRtlFastUnlockSingle(IN PFILE_LOCK FileLock,
                       IN PVOID Context OPTIONAL,
                       IN BOOLEAN AlreadySynchronized)
 {
-    BOOLEAN FoundShared = FALSE;
-    PLIST_ENTRY SharedEntry;
-    PLOCK_SHARED_RANGE SharedRange = NULL;
-    COMBINED_LOCK_ELEMENT Find;
-    PCOMBINED_LOCK_ELEMENT Entry;
-    PIRP NextMatchingLockIrp;
+    PLOCK_RANGE Range, Found = NULL;
+    FILE_LOCK_INFO Unlocked;
+    LARGE_INTEGER EndingByte;
     PLOCK_INFORMATION InternalInfo = FileLock->LockInformation;
     DPRINT("FsRtlFastUnlockSingle(%wZ, Offset %08x%08x (%d), Length %08x%08x (%d), Key %x)\n",
            &FileObject->FileName,
@@ -851,170 +1044,55 @@ FsRtlFastUnlockSingle(IN PFILE_LOCK FileLock,
     // -- msdn
     // But Windows 2003 doesn't assert on it and simply ignores that parameter
     // ASSERT(AlreadySynchronized);
-    Find.Exclusive.FileLock.StartingByte = *FileOffset;
-    Find.Exclusive.FileLock.EndingByte.QuadPart =
-        FileOffset->QuadPart + Length->QuadPart;
     if (!InternalInfo) {
         DPRINT("File not previously locked (ever)\n");
         return STATUS_RANGE_NOT_LOCKED;
     }
-    Entry = RtlLookupElementGenericTable(&InternalInfo->RangeTable, &Find);
-    if (!Entry) {
+    EndingByte.QuadPart = FileOffset->QuadPart + Length->QuadPart;
+
+    FsRtlpAcquireLockTreeExclusive(InternalInfo);
+    for (Range = FsRtlpLowerBoundRange(InternalInfo, FileOffset->QuadPart);
+         Range && Range->Lock.StartingByte.QuadPart == FileOffset->QuadPart;
+         Range = FsRtlpNextRange(Range))
+    {
+        if (Range->Lock.EndingByte.QuadPart != EndingByte.QuadPart ||
+            !FsRtlpIsLockOwner(&Range->Lock, FileObject, Process, Key))
+            continue;
+
+        /* The owner may hold shared locks over its exclusive one, release that first */
+        Found = Range;
+        if (Range->Lock.ExclusiveLock)
+            break;
+    }
+    Range = Found;
+    if (!Range)
+    {
+        FsRtlpReleaseLockTreeExclusive(InternalInfo);
         DPRINT("Range not locked %wZ\n", &FileObject->FileName);
         return STATUS_RANGE_NOT_LOCKED;
     }
 
     DPRINT("Found lock entry: Exclusive %u %08x%08x:%08x%08x %wZ\n",
-           Entry->Exclusive.FileLock.ExclusiveLock,
-           Entry->Exclusive.FileLock.StartingByte.HighPart,
-           Entry->Exclusive.FileLock.StartingByte.LowPart,
-           Entry->Exclusive.FileLock.EndingByte.HighPart,
-           Entry->Exclusive.FileLock.EndingByte.LowPart,
+           Range->Lock.ExclusiveLock,
+           Range->Lock.StartingByte.HighPart,
+           Range->Lock.StartingByte.LowPart,
+           Range->Lock.EndingByte.HighPart,
+           Range->Lock.EndingByte.LowPart,
            &FileObject->FileName);
 
-    if (Entry->Exclusive.FileLock.ExclusiveLock)
-    {
-        if (Entry->Exclusive.FileLock.Key != Key ||
-            Entry->Exclusive.FileLock.ProcessId != Process ||
-            Entry->Exclusive.FileLock.StartingByte.QuadPart != FileOffset->QuadPart ||
-            Entry->Exclusive.FileLock.EndingByte.QuadPart !=
-            FileOffset->QuadPart + Length->QuadPart)
-        {
-            DPRINT("Range not locked %wZ\n", &FileObject->FileName);
-            return STATUS_RANGE_NOT_LOCKED;
-        }
-        RtlCopyMemory(&Find, Entry, sizeof(Find));
-        // Remove the old exclusive lock region
-        RtlDeleteElementGenericTable(&InternalInfo->RangeTable, Entry);
-    }
-    else
-    {
-        DPRINT("Shared lock %wZ Start %08x%08x End %08x%08x\n",
-               &FileObject->FileName,
-               Entry->Exclusive.FileLock.StartingByte.HighPart,
-               Entry->Exclusive.FileLock.StartingByte.LowPart,
-               Entry->Exclusive.FileLock.EndingByte.HighPart,
-               Entry->Exclusive.FileLock.EndingByte.LowPart);
-        for (SharedEntry = InternalInfo->SharedLocks.Flink;
-             SharedEntry != &InternalInfo->SharedLocks;
-             SharedEntry = SharedEntry->Flink)
-        {
-            SharedRange = CONTAINING_RECORD(SharedEntry, LOCK_SHARED_RANGE, Entry);
-            if (SharedRange->Start.QuadPart == FileOffset->QuadPart &&
-                SharedRange->End.QuadPart == FileOffset->QuadPart + Length->QuadPart &&
-                SharedRange->Key == Key &&
-                SharedRange->ProcessId == Process)
-            {
-                FoundShared = TRUE;
-                DPRINT("Found shared element to delete %wZ Start %08x%08x End %08x%08x Key %x\n",
-                       &FileObject->FileName,
-                       SharedRange->Start.HighPart,
-                       SharedRange->Start.LowPart,
-                       SharedRange->End.HighPart,
-                       SharedRange->End.LowPart,
-                       SharedRange->Key);
-                break;
-            }
-        }
-        if (FoundShared)
-        {
-            /* Remove the found range from the shared range lists */
-            RemoveEntryList(&SharedRange->Entry);
-            ExFreePoolWithTag(SharedRange, TAG_RANGE);
-            /* We need to rebuild the list of shared ranges. */
-            DPRINT("Removing the lock entry %wZ (%08x%08x:%08x%08x)\n",
-                   &FileObject->FileName,
-                   Entry->Exclusive.FileLock.StartingByte.HighPart,
-                   Entry->Exclusive.FileLock.StartingByte.LowPart,
-                   Entry->Exclusive.FileLock.EndingByte.HighPart,
-                   Entry->Exclusive.FileLock.EndingByte.LowPart);
-
-            /* Remember what was in there and remove it from the table */
-            Find = *Entry;
-            RtlDeleteElementGenericTable(&InternalInfo->RangeTable, &Find);
-            /* Put shared locks back in place */
-            for (SharedEntry = InternalInfo->SharedLocks.Flink;
-                 SharedEntry != &InternalInfo->SharedLocks;
-                 SharedEntry = SharedEntry->Flink)
-            {
-                COMBINED_LOCK_ELEMENT LockElement;
-                SharedRange = CONTAINING_RECORD(SharedEntry, LOCK_SHARED_RANGE, Entry);
-                LockElement.Exclusive.FileLock.FileObject = FileObject;
-                LockElement.Exclusive.FileLock.StartingByte = SharedRange->Start;
-                LockElement.Exclusive.FileLock.EndingByte = SharedRange->End;
-                LockElement.Exclusive.FileLock.ProcessId = SharedRange->ProcessId;
-                LockElement.Exclusive.FileLock.Key = SharedRange->Key;
-                LockElement.Exclusive.FileLock.ExclusiveLock = FALSE;
-
-                if (LockCompare(&InternalInfo->RangeTable, &Find, &LockElement) != GenericEqual)
-                {
-                    DPRINT("Skipping range %08x%08x:%08x%08x\n",
-                           LockElement.Exclusive.FileLock.StartingByte.HighPart,
-                           LockElement.Exclusive.FileLock.StartingByte.LowPart,
-                           LockElement.Exclusive.FileLock.EndingByte.HighPart,
-                           LockElement.Exclusive.FileLock.EndingByte.LowPart);
-                    continue;
-                }
-                DPRINT("Re-creating range %08x%08x:%08x%08x\n",
-                       LockElement.Exclusive.FileLock.StartingByte.HighPart,
-                       LockElement.Exclusive.FileLock.StartingByte.LowPart,
-                       LockElement.Exclusive.FileLock.EndingByte.HighPart,
-                       LockElement.Exclusive.FileLock.EndingByte.LowPart);
-                FsRtlpRebuildSharedLockRange(FileLock, InternalInfo, &LockElement);
-            }
-        }
-        else
-        {
-            return STATUS_RANGE_NOT_LOCKED;
-        }
-    }
-
-#ifndef NDEBUG
-    DPRINT("Lock still has:\n");
-    for (SharedEntry = InternalInfo->SharedLocks.Flink;
-         SharedEntry != &InternalInfo->SharedLocks;
-         SharedEntry = SharedEntry->Flink)
-    {
-        SharedRange = CONTAINING_RECORD(SharedEntry, LOCK_SHARED_RANGE, Entry);
-        DPRINT("Shared element %wZ Offset %08x%08x Length %08x%08x Key %x\n",
-               &FileObject->FileName,
-               SharedRange->Start.HighPart,
-               SharedRange->Start.LowPart,
-               SharedRange->End.HighPart,
-               SharedRange->End.LowPart,
-               SharedRange->Key);
-    }
-#endif
+    FsRtlpRemoveRange(InternalInfo, Range);
+    InternalInfo->LockCount--;
+    if (!InternalInfo->LockCount) FileLock->FastIoIsQuestionable = FALSE;
 
     // this is definitely the thing we want
     InternalInfo->Generation++;
-    while ((NextMatchingLockIrp = IoCsqRemoveNextIrp(&InternalInfo->Csq, &Find)))
-    {
-        NTSTATUS Status;
-        if (NextMatchingLockIrp->IoStatus.Information == InternalInfo->Generation)
-        {
-            // We've already looked at this one, meaning that we looped.
-            // Put it back and exit.
-            IoCsqInsertIrpEx
-                (&InternalInfo->Csq,
-                 NextMatchingLockIrp,
-                 NULL,
-                 NULL);
-            break;
-        }
-        // Got a new lock irp... try to do the new lock operation
-        // Note that we pick an operation that would succeed at the time
-        // we looked, but can't guarantee that it won't just be re-queued
-        // because somebody else snatched part of the range in a new thread.
-        DPRINT("Locking another IRP %p for %p %wZ\n",
-               NextMatchingLockIrp, FileLock, &FileObject->FileName);
-        Status = FsRtlProcessFileLock(InternalInfo->BelongsTo, NextMatchingLockIrp, NULL);
-        if (!NT_SUCCESS(Status))
-            return Status;
-    }
+    FsRtlpReleaseLockTreeExclusive(InternalInfo);
+
+    Unlocked = Range->Lock;
+    ExFreePoolWithTag(Range, TAG_RANGE);
 
     DPRINT("Success %wZ\n", &FileObject->FileName);
-    return STATUS_SUCCESS;
+    return FsRtlpRetryPendingLocks(FileLock, &Unlocked);
 }
 
 /*
@@ -1027,55 +1105,8 @@ FsRtlFastUnlockAll(IN PFILE_LOCK FileLock,
                    IN PEPROCESS Process,
                    IN PVOID Context OPTIONAL)
 {
-    PLIST_ENTRY ListEntry;
-    PCOMBINED_LOCK_ELEMENT Entry;
-    PLOCK_INFORMATION InternalInfo = FileLock->LockInformation;
     DPRINT("FsRtlFastUnlockAll(%wZ)\n", &FileObject->FileName);
-    // XXX Synchronize somehow
-    if (!FileLock->LockInformation) {
-        DPRINT("Not locked %wZ\n", &FileObject->FileName);
-        return STATUS_RANGE_NOT_LOCKED; // no locks
-    }
-    for (ListEntry = InternalInfo->SharedLocks.Flink;
-         ListEntry != &InternalInfo->SharedLocks;)
-    {
-        LARGE_INTEGER Length;
-        PLOCK_SHARED_RANGE Range = CONTAINING_RECORD(ListEntry, LOCK_SHARED_RANGE, Entry);
-        Length.QuadPart = Range->End.QuadPart - Range->Start.QuadPart;
-        ListEntry = ListEntry->Flink;
-        if (Range->ProcessId != Process)
-            continue;
-        FsRtlFastUnlockSingle
-            (FileLock,
-             FileObject,
-             &Range->Start,
-             &Length,
-             Range->ProcessId,
-             Range->Key,
-             Context,
-             TRUE);
-    }
-    for (Entry = RtlEnumerateGenericTable(&InternalInfo->RangeTable, TRUE);
-         Entry;
-         Entry = RtlEnumerateGenericTable(&InternalInfo->RangeTable, FALSE))
-    {
-        LARGE_INTEGER Length;
-        // We'll take the first one to be the list head, and free the others first...
-        Length.QuadPart =
-            Entry->Exclusive.FileLock.EndingByte.QuadPart -
-            Entry->Exclusive.FileLock.StartingByte.QuadPart;
-        FsRtlFastUnlockSingle
-            (FileLock,
-             Entry->Exclusive.FileLock.FileObject,
-             &Entry->Exclusive.FileLock.StartingByte,
-             &Length,
-             Entry->Exclusive.FileLock.ProcessId,
-             Entry->Exclusive.FileLock.Key,
-             Context,
-             TRUE);
-    }
-    DPRINT("Done %wZ\n", &FileObject->FileName);
-    return STATUS_SUCCESS;
+    return FsRtlpFastUnlockAllMatching(FileLock, FileObject, Process, 0, FALSE);
 }
 
 /*
@@ -1089,59 +1120,8 @@ FsRtlFastUnlockAllByKey(IN PFILE_LOCK FileLock,
                         IN ULONG Key,
                         IN PVOID Context OPTIONAL)
 {
-    PLIST_ENTRY ListEntry;
-    PCOMBINED_LOCK_ELEMENT Entry;
-    PLOCK_INFORMATION InternalInfo = FileLock->LockInformation;
-
     DPRINT("FsRtlFastUnlockAllByKey(%wZ,Key %x)\n", &FileObject->FileName, Key);
-
-    // XXX Synchronize somehow
-    if (!FileLock->LockInformation) return STATUS_RANGE_NOT_LOCKED; // no locks
-    for (ListEntry = InternalInfo->SharedLocks.Flink;
-         ListEntry != &InternalInfo->SharedLocks;)
-    {
-        PLOCK_SHARED_RANGE Range = CONTAINING_RECORD(ListEntry, LOCK_SHARED_RANGE, Entry);
-        LARGE_INTEGER Length;
-        Length.QuadPart = Range->End.QuadPart - Range->Start.QuadPart;
-        ListEntry = ListEntry->Flink;
-        if (Range->ProcessId != Process ||
-            Range->Key != Key)
-            continue;
-        FsRtlFastUnlockSingle
-            (FileLock,
-             FileObject,
-             &Range->Start,
-             &Length,
-             Range->ProcessId,
-             Range->Key,
-             Context,
-             TRUE);
-    }
-    for (Entry = RtlEnumerateGenericTable(&InternalInfo->RangeTable, TRUE);
-         Entry;
-         Entry = RtlEnumerateGenericTable(&InternalInfo->RangeTable, FALSE))
-    {
-        LARGE_INTEGER Length;
-        // We'll take the first one to be the list head, and free the others first...
-        Length.QuadPart =
-            Entry->Exclusive.FileLock.EndingByte.QuadPart -
-            Entry->Exclusive.FileLock.StartingByte.QuadPart;
-        if (Entry->Exclusive.FileLock.Key == Key &&
-            Entry->Exclusive.FileLock.ProcessId == Process)
-        {
-            FsRtlFastUnlockSingle
-                (FileLock,
-                 Entry->Exclusive.FileLock.FileObject,
-                 &Entry->Exclusive.FileLock.StartingByte,
-                 &Length,
-                 Entry->Exclusive.FileLock.ProcessId,
-                 Entry->Exclusive.FileLock.Key,
-                 Context,
-                 TRUE);
-        }
-    }
-
-    return STATUS_SUCCESS;
+    return FsRtlpFastUnlockAllMatching(FileLock, FileObject, Process, Key, TRUE);
 }
 
 /*
@@ -1282,22 +1262,8 @@ FsRtlUninitializeFileLock(IN PFILE_LOCK FileLock)
     {
         PIRP Irp;
         PLOCK_INFORMATION InternalInfo = FileLock->LockInformation;
-        PCOMBINED_LOCK_ELEMENT Entry;
-        PLIST_ENTRY SharedEntry;
-        PLOCK_SHARED_RANGE SharedRange;
+        FsRtlpFreeAllRanges(InternalInfo);
         // MSDN: this completes any remaining lock IRPs
-        for (SharedEntry = InternalInfo->SharedLocks.Flink;
-             SharedEntry != &InternalInfo->SharedLocks;)
-        {
-            SharedRange = CONTAINING_RECORD(SharedEntry, LOCK_SHARED_RANGE, Entry);
-            SharedEntry = SharedEntry->Flink;
-            RemoveEntryList(&SharedRange->Entry);
-            ExFreePoolWithTag(SharedRange, TAG_RANGE);
-        }
-        while ((Entry = RtlGetElementGenericTable(&InternalInfo->RangeTable, 0)) != NULL)
-        {
-            RtlDeleteElementGenericTable(&InternalInfo->RangeTable, Entry);
-        }
         while ((Irp = IoCsqRemoveNextIrp(&InternalInfo->Csq, NULL)) != NULL)
         {
             NTSTATUS Status = FsRtlProcessFileLock(FileLock, Irp, NULL);
@@ -1305,6 +1271,9 @@ FsRtlUninitializeFileLock(IN PFILE_LOCK FileLock)
             NT_ASSERT(NT_SUCCESS(Status));
             (void)Status;
         }
+        /* Drop the locks these IRPs got as well */
+        FsRtlpFreeAllRanges(InternalInfo);
+        FileLock->FastIoIsQuestionable = FALSE;
         ExFreePoolWithTag(InternalInfo, TAG_FLOCK);
         FileLock->LockInformation = NULL;
     }
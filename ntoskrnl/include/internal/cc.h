@@ -65,6 +65,33 @@ extern ULONG CcPinReadNoWait;
 extern ULONG CcPinMappedDataCount;
 extern ULONG CcDataPages;
 extern ULONG CcDataFlushes;
+extern BOOLEAN CcPfEnablePrefetcher;
+extern ULONG CcPfEnablePrefetcherMode;
+
+typedef enum _PF_SCENARIO_TYPE
+{
+    PfApplicationLaunchScenarioType,
+    PfSystemBootScenarioType,
+    PfMaxScenarioType
+} PF_SCENARIO_TYPE;
+
+typedef enum _PF_BOOT_PHASE_ID
+{
+    PfKernelInitPhase = 0,
+    PfBootDriverInitPhase = 90,
+    PfSystemDriverInitPhase = 120,
+    PfSessionManagerInitPhase = 150,
+    PfSMRegistryInitPhase = 175,
+    PfVideoInitPhase = 200,
+    PfPostVideoInitPhase = 250,
+    PfBootAcceptedRegistryInitPhase = 300,
+    PfUserShellReadyPhase = 350,
+    PfMaxBootPhaseId = 900
+} PF_BOOT_PHASE_ID;
+
+/* Values of the EnablePrefetcher registry setting */
+#define PF_ENABLE_APP_LAUNCH    0x1
+#define PF_ENABLE_BOOT          0x2
 
 typedef struct _PF_SCENARIO_ID
 {
@@ -153,6 +180,13 @@ typedef struct _PFSN_TRACE_HEADER
     LARGE_INTEGER LaunchTime;
     PPF_SECTION_INFO SectionInfo;
     ULONG SectionInfoCount;
+    /* ReactOS specific: files referenced by the log entries, indexed by FileKey */
+    PFILE_OBJECT *FileTable;
+    ULONG FileTableCount;
+    PULONG FileHash; // Buckets of FileKeys, then the chain of each FileKey
+    LONG ReferenceCount;
+    /* ReactOS specific: scenario replayed for this trace, if any */
+    PVOID Prefetch;
 } PFSN_TRACE_HEADER, *PPFSN_TRACE_HEADER;
 
 typedef struct _PFSN_PREFETCHER_GLOBALS
@@ -295,6 +329,27 @@ CcPfInitializePrefetcher(
     VOID
 );
 
+VOID
+NTAPI
+CcPfBeginAppLaunch(
+    IN PEPROCESS Process
+);
+
+VOID
+NTAPI
+CcPfBeginBootPhase(
+    IN PF_BOOT_PHASE_ID Phase
+);
+
+VOID
+NTAPI
+CcPfLogPageFault(
+    IN PFILE_OBJECT FileObject,
+    IN LONGLONG FileOffset,
+    IN ULONG Length,
+    IN BOOLEAN Image
+);
+
 VOID
 NTAPI
 CcMdlReadComplete2(
@@ -63,6 +63,31 @@
 #define LPCP_LOCK_HELD      1
 #define LPCP_LOCK_RELEASE   2
 
+//
+// Number of locks the LPC state of the threads is spread over
+//
+#define LPCP_THREAD_LOCK_COUNT                              64
+
+//
+// LPC Port Lock
+//
+// A connection port and all the communication ports connected through it
+// share one lock, which protects their queues, reply chains, data info
+// chains and links to each other. The LPC fields of a thread are protected
+// by one of the thread locks, picked by hashing the thread pointer.
+//
+// Lock order: a port lock, then a thread lock. Only one thread lock is ever
+// held. Two port locks are only held together to unlink a thread from the
+// reply chain of another connection (see LpcpAcquireReplyChainLocks), and
+// are then taken in address order. No lock is held while dereferencing a
+// port, since the deletion of a port acquires its lock.
+//
+typedef struct _LPCP_PORT_LOCK
+{
+    KGUARDED_MUTEX Mutex;
+    LONG ReferenceCount;
+} LPCP_PORT_LOCK, *PLPCP_PORT_LOCK;
+
 
 typedef struct _LPCP_DATA_INFO
 {
@@ -100,10 +125,48 @@ LpcpInitializePortQueue(
     IN PLPCP_PORT_OBJECT Port
 );
 
+NTSTATUS
+NTAPI
+LpcpCreatePortLock(
+    IN PLPCP_PORT_OBJECT Port
+);
+
+VOID
+NTAPI
+LpcpSharePortLock(
+    IN PLPCP_PORT_OBJECT Port,
+    IN PLPCP_PORT_OBJECT ConnectionPort
+);
+
+VOID
+NTAPI
+LpcpDereferencePortLock(
+    IN PLPCP_PORT_OBJECT Port
+);
+
+//
+// Acquires the given port lock, the lock of the reply chain the thread is
+// on when it's another one, and the thread lock. The extra lock is returned
+// referenced, to be released with LpcpReleaseReplyChainLock.
+//
+PLPCP_PORT_LOCK
+NTAPI
+LpcpAcquireReplyChainLocks(
+    IN PLPCP_PORT_LOCK PortLock OPTIONAL,
+    IN PETHREAD Thread
+);
+
+VOID
+NTAPI
+LpcpReleaseReplyChainLock(
+    IN PLPCP_PORT_LOCK ChainLock OPTIONAL
+);
+
 VOID
 NTAPI
 LpcpFreeToPortZone(
     IN PLPCP_MESSAGE Message,
+    IN PLPCP_PORT_LOCK Lock OPTIONAL,
     IN ULONG LockFlags
 );
 
@@ -156,7 +219,7 @@ LpcpValidateClientPort(
 //
 extern POBJECT_TYPE LpcPortObjectType;
 extern ULONG LpcpNextMessageId, LpcpNextCallbackId;
-extern KGUARDED_MUTEX LpcpLock;
+extern KGUARDED_MUTEX LpcpThreadLocks[LPCP_THREAD_LOCK_COUNT];
 extern PAGED_LOOKASIDE_LIST LpcpMessagesLookaside;
 extern ULONG LpcpMaxMessageSize;
 extern ULONG LpcpTraceLevel;
@@ -92,6 +92,27 @@
     KeReleaseSemaphore(s, 1, 1, FALSE);                     \
 }
 
+//
+// Acquires and releases the lock of a port and its connection port
+//
+#define LpcpAcquirePortLock(p)                              \
+    KeAcquireGuardedMutex(&(p)->Lock->Mutex)
+
+#define LpcpReleasePortLock(p)                              \
+    KeReleaseGuardedMutex(&(p)->Lock->Mutex)
+
+//
+// Acquires and releases the lock of the LPC state of a thread
+//
+#define LpcpGetThreadLock(t)                                \
+    (&LpcpThreadLocks[((ULONG_PTR)(t) >> 8) % LPCP_THREAD_LOCK_COUNT])
+
+#define LpcpAcquireThreadLock(t)                            \
+    KeAcquireGuardedMutex(LpcpGetThreadLock(t))
+
+#define LpcpReleaseThreadLock(t)                            \
+    KeReleaseGuardedMutex(LpcpGetThreadLock(t))
+
 //
 // Allocates a new message
 //
@@ -101,13 +122,11 @@ LpcpAllocateFromPortZone(VOID)
 {
     PLPCP_MESSAGE Message;
 
-    /* Allocate a message from the port zone while holding the lock */
-    KeAcquireGuardedMutex(&LpcpLock);
+    /* Allocate a message from the port zone, the lookaside list is interlocked */
     Message = (PLPCP_MESSAGE)ExAllocateFromPagedLookasideList(&LpcpMessagesLookaside);
     if (!Message)
     {
         /* Fail, and let caller cleanup */
-        KeReleaseGuardedMutex(&LpcpLock);
         return NULL;
     }
 
@@ -115,12 +134,26 @@ LpcpAllocateFromPortZone(VOID)
     InitializeListHead(&Message->Entry);
     Message->RepliedToThread = NULL;
     Message->Request.u2.ZeroInit = 0;
-
-    /* Release the lock */
-    KeReleaseGuardedMutex(&LpcpLock);
     return Message;
 }
 
+//
+// Generates a new message ID, never zero
+//
+FORCEINLINE
+ULONG
+LpcpGenerateMessageId(VOID)
+{
+    ULONG MessageId;
+
+    do
+    {
+        MessageId = (ULONG)InterlockedIncrement((PLONG)&LpcpNextMessageId) - 1;
+    } while (!MessageId);
+
+    return MessageId;
+}
+
 //
 // Get the LPC Message associated to the Thread
 //
@@ -165,6 +198,30 @@ LpcpSetPortToThread(IN PETHREAD Thread,
                                        LPCP_THREAD_FLAG_IS_PORT);
 }
 
+//
+// Links a thread to and unlinks it from the reply chain of a port. The port
+// of the chain is remembered for as long as the thread is on it, so holding
+// either the lock of that port or the lock of the thread is enough to read it.
+// The caller holds both.
+//
+FORCEINLINE
+VOID
+LpcpInsertReplyChain(IN PLPCP_PORT_OBJECT Port,
+                     IN PETHREAD Thread)
+{
+    InsertTailList(&Port->LpcReplyChainHead, &Thread->LpcReplyChain);
+    Thread->LpcReplyChainPort = Port;
+}
+
+FORCEINLINE
+VOID
+LpcpRemoveReplyChain(IN PETHREAD Thread)
+{
+    RemoveEntryList(&Thread->LpcReplyChain);
+    InitializeListHead(&Thread->LpcReplyChain);
+    Thread->LpcReplyChainPort = NULL;
+}
+
 FORCEINLINE
 PLPCP_DATA_INFO
 LpcpGetDataInfoFromMessage(PPORT_MESSAGE Message)
@@ -1530,6 +1530,13 @@ MmMakeDataSectionResident(
     _In_ ULONG Length,
     _In_ PLARGE_INTEGER ValidDataLength);
 
+NTSTATUS
+NTAPI
+MmPrefetchSectionPages(
+    _In_ PVOID SectionObject,
+    _In_ LONGLONG FileOffset,
+    _In_ ULONG Length);
+
 BOOLEAN
 NTAPI
 MmPurgeSegment(
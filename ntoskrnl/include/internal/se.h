@@ -74,6 +74,23 @@ typedef struct _TOKEN_AUDIT_POLICY_INFORMATION
     } Policies[1];
 } TOKEN_AUDIT_POLICY_INFORMATION, *PTOKEN_AUDIT_POLICY_INFORMATION;
 
+//
+// Token SID hash index, used to look up the user and group SIDs
+// of a token in access checks without scanning the whole array.
+// Buckets and chains hold SID indexes plus one, 0 ends a chain.
+//
+#define SEP_SID_HASH_MINIMUM_COUNT  8
+#define SEP_SID_HASH_MAXIMUM_COUNT  0xFFFE
+
+typedef struct _SEP_SID_HASH
+{
+    ULONG SidCount;
+    ULONG Shift;
+    PUSHORT Buckets;
+    PUSHORT Next;
+    USHORT Entries[ANYSIZE_ARRAY];
+} SEP_SID_HASH, *PSEP_SID_HASH;
+
 //
 // Token creation method defines (for debugging purposes)
 //
@@ -622,6 +639,14 @@ SepSidInToken(
     _In_ PACCESS_TOKEN _Token,
     _In_ PSID Sid);
 
+VOID
+SepBuildTokenSidHash(
+    _Inout_ PTOKEN Token);
+
+VOID
+SepFreeTokenSidHash(
+    _Inout_ PTOKEN Token);
+
 BOOLEAN
 NTAPI
 SepSidInTokenEx(
@@ -16,6 +16,8 @@
 #define TAG_SHARED_CACHE_MAP        'cScC'
 #define TAG_PRIVATE_CACHE_MAP       'cPcC'
 #define TAG_BCB                     'cBcC'
+#define TAG_PF_TRACE                'tTfP'
+#define TAG_PF_SCENARIO             'cSfP'
 
 /* Executive Tags */
 #define TAG_CALLBACK_ROUTINE_BLOCK  'brbC'
@@ -164,11 +166,13 @@
 #define TAG_LOGON_NOTIFICATION  'nLeS'
 #define TAG_SID_AND_ATTRIBUTES  'aSeS'
 #define TAG_SID_VALIDATE        'vSeS'
+#define TAG_SID_HASH            'hSeS'
 #define TAG_DACL                'lcaD'
 
 /* LPC Tags */
 #define TAG_LPC_MESSAGE         'McpL'
 #define TAG_LPC_ZONE            'ZcpL'
 #define TAG_LPC_CONNECT_MESSAGE 'CCPL'
+#define TAG_LPC_PORT_LOCK       'kLpL'
 
 /* EOF */
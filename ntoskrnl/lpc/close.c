@@ -19,16 +19,23 @@ NTAPI
 LpcExitThread(IN PETHREAD Thread)
 {
     PLPCP_MESSAGE Message;
+    PLPCP_PORT_LOCK ChainLock;
     ASSERT(Thread == PsGetCurrentThread());
 
-    /* Acquire the lock */
-    KeAcquireGuardedMutex(&LpcpLock);
+    /*
+     * If the thread is terminated while waiting for a reply, it is still on
+     * the reply chain of a port, which is protected by the lock of the port.
+     * Take that lock directly: a port being deleted meanwhile needs it as
+     * well to unlink the thread, so there is nothing to wait for.
+     */
+    ChainLock = LpcpAcquireReplyChainLocks(NULL, Thread);
 
     /* Make sure that the Reply Chain is empty */
     if (!IsListEmpty(&Thread->LpcReplyChain))
     {
-        /* It's not, remove the entry */
-        RemoveEntryList(&Thread->LpcReplyChain);
+        /* It's not, remove the entry. Nobody links an exiting thread again */
+        ASSERT(Thread->LpcReplyChainPort->Lock == ChainLock);
+        LpcpRemoveReplyChain(Thread);
     }
 
     /* Set the thread in exit mode */
@@ -43,13 +50,15 @@ LpcExitThread(IN PETHREAD Thread)
         ASSERT(FALSE);
     }
 
-    /* Release the lock */
-    KeReleaseGuardedMutex(&LpcpLock);
+    /* Release the locks */
+    LpcpReleaseThreadLock(Thread);
+    LpcpReleaseReplyChainLock(ChainLock);
 }
 
 VOID
 NTAPI
 LpcpFreeToPortZone(IN PLPCP_MESSAGE Message,
+                   IN PLPCP_PORT_LOCK Lock OPTIONAL,
                    IN ULONG LockFlags)
 {
     PLPCP_CONNECTION_MESSAGE ConnectMessage;
@@ -62,8 +71,11 @@ LpcpFreeToPortZone(IN PLPCP_MESSAGE Message,
 
     LPCTRACE(LPC_CLOSE_DEBUG, "Message: %p. LockFlags: %lx\n", Message, LockFlags);
 
+    /* Without a lock, the message must not be on any port list */
+    ASSERT(Lock || (!LockHeld && IsListEmpty(&Message->Entry)));
+
     /* Acquire the lock if not already */
-    if (!LockHeld) KeAcquireGuardedMutex(&LpcpLock);
+    if ((Lock) && !(LockHeld)) KeAcquireGuardedMutex(&Lock->Mutex);
 
     /* Check if the queue list is empty */
     if (!IsListEmpty(&Message->Entry))
@@ -93,7 +105,7 @@ LpcpFreeToPortZone(IN PLPCP_MESSAGE Message,
     }
 
     /* Release the lock */
-    KeReleaseGuardedMutex(&LpcpLock);
+    if (Lock) KeReleaseGuardedMutex(&Lock->Mutex);
 
     /* Check if we had anything to dereference */
     if (Thread) ObDereferenceObject(Thread);
@@ -103,7 +115,7 @@ LpcpFreeToPortZone(IN PLPCP_MESSAGE Message,
     ExFreeToPagedLookasideList(&LpcpMessagesLookaside, Message);
 
     /* Reacquire the lock if needed */
-    if ((LockHeld) && !(ReleaseLock)) KeAcquireGuardedMutex(&LpcpLock);
+    if ((LockHeld) && !(ReleaseLock)) KeAcquireGuardedMutex(&Lock->Mutex);
 }
 
 VOID
@@ -122,7 +134,7 @@ LpcpDestroyPortQueue(IN PLPCP_PORT_OBJECT Port,
     LPCTRACE(LPC_CLOSE_DEBUG, "Port: %p. Flags: %lx\n", Port, Port->Flags);
 
     /* Hold the lock */
-    KeAcquireGuardedMutex(&LpcpLock);
+    LpcpAcquirePortLock(Port);
 
     /* Check if we have a connected port */
     if (((Port->Flags & LPCP_PORT_TYPE_MASK) != LPCP_UNCONNECTED_PORT) &&
@@ -152,22 +164,30 @@ LpcpDestroyPortQueue(IN PLPCP_PORT_OBJECT Port,
     {
         /* Get the Thread */
         Thread = CONTAINING_RECORD(NextEntry, ETHREAD, LpcReplyChain);
+        LpcpAcquireThreadLock(Thread);
 
         /* Make sure we're not in exit */
-        if (Thread->LpcExitThreadCalled) break;
+        if (Thread->LpcExitThreadCalled)
+        {
+            LpcpReleaseThreadLock(Thread);
+            break;
+        }
 
         /* Move to the next entry */
         NextEntry = NextEntry->Flink;
 
         /* Remove and reinitialize the List */
-        RemoveEntryList(&Thread->LpcReplyChain);
-        InitializeListHead(&Thread->LpcReplyChain);
+        LpcpRemoveReplyChain(Thread);
 
         /* Check if someone is waiting */
         if (!KeReadStateSemaphore(&Thread->LpcReplySemaphore))
         {
-            /* Get the message */
+            /* Get and clear the reply message, and reset message id count */
             Message = LpcpGetMessageFromThread(Thread);
+            if (Message) Thread->LpcReplyMessage = NULL;
+            Thread->LpcReplyMessageId = 0;
+            LpcpReleaseThreadLock(Thread);
+
             if (Message)
             {
                 /* Check if it's a connection request */
@@ -184,18 +204,18 @@ LpcpDestroyPortQueue(IN PLPCP_PORT_OBJECT Port,
                     }
                 }
 
-                /* Clear the reply message */
-                Thread->LpcReplyMessage = NULL;
-
                 /* And remove the message from the port zone */
-                LpcpFreeToPortZone(Message, LPCP_LOCK_HELD);
+                LpcpFreeToPortZone(Message, Port->Lock, LPCP_LOCK_HELD);
                 NextEntry = Port->LpcReplyChainHead.Flink;
             }
 
-            /* Release the semaphore and reset message id count */
-            Thread->LpcReplyMessageId = 0;
+            /* Release the semaphore */
             KeReleaseSemaphore(&Thread->LpcReplySemaphore, 0, 1, FALSE);
         }
+        else
+        {
+            LpcpReleaseThreadLock(Thread);
+        }
     }
 
     /* Reinitialize the list head */
@@ -215,11 +235,11 @@ LpcpDestroyPortQueue(IN PLPCP_PORT_OBJECT Port,
         InitializeListHead(&Message->Entry);
 
         /* Remove it from the port zone */
-        LpcpFreeToPortZone(Message, LPCP_LOCK_HELD);
+        LpcpFreeToPortZone(Message, Port->Lock, LPCP_LOCK_HELD);
     }
 
     /* Release the lock */
-    KeReleaseGuardedMutex(&LpcpLock);
+    LpcpReleasePortLock(Port);
 
     /* Dereference the connection port */
     if (ConnectionPort) ObDereferenceObject(ConnectionPort);
@@ -315,11 +335,14 @@ LpcpDeletePort(IN PVOID ObjectBody)
 
     Timeout.QuadPart = -1000000;
 
+    /* A port which failed to get its lock was never set up */
+    if (!Port->Lock) return;
+
     /* Check if this is a communication port */
     if ((Port->Flags & LPCP_PORT_TYPE_MASK) == LPCP_COMMUNICATION_PORT)
     {
         /* Acquire the lock */
-        KeAcquireGuardedMutex(&LpcpLock);
+        LpcpAcquirePortLock(Port);
 
         /* Get the thread */
         Thread = Port->ClientThread;
@@ -329,13 +352,13 @@ LpcpDeletePort(IN PVOID ObjectBody)
             Port->ClientThread = NULL;
 
             /* Release the lock and dereference */
-            KeReleaseGuardedMutex(&LpcpLock);
+            LpcpReleasePortLock(Port);
             ObDereferenceObject(Thread);
         }
         else
         {
             /* Release the lock */
-            KeReleaseGuardedMutex(&LpcpLock);
+            LpcpReleasePortLock(Port);
         }
     }
 
@@ -389,7 +412,7 @@ LpcpDeletePort(IN PVOID ObjectBody)
     }
 
     /* Acquire the lock */
-    KeAcquireGuardedMutex(&LpcpLock);
+    LpcpAcquirePortLock(Port);
 
     /* Get the connection port */
     ConnectionPort = Port->ConnectionPort;
@@ -413,7 +436,7 @@ LpcpDeletePort(IN PVOID ObjectBody)
                 /* Free queued messages */
                 RemoveEntryList(&Message->Entry);
                 InitializeListHead(&Message->Entry);
-                LpcpFreeToPortZone(Message, LPCP_LOCK_HELD);
+                LpcpFreeToPortZone(Message, Port->Lock, LPCP_LOCK_HELD);
 
                 /* Restart at the head */
                 NextEntry = ListHead->Flink;
@@ -426,7 +449,7 @@ LpcpDeletePort(IN PVOID ObjectBody)
                 /* Remove it */
                 RemoveEntryList(&Message->Entry);
                 InitializeListHead(&Message->Entry);
-                LpcpFreeToPortZone(Message, LPCP_LOCK_HELD);
+                LpcpFreeToPortZone(Message, Port->Lock, LPCP_LOCK_HELD);
 
                 /* Restart at the head */
                 NextEntry = ListHead->Flink;
@@ -434,7 +457,7 @@ LpcpDeletePort(IN PVOID ObjectBody)
         }
 
         /* Release the lock */
-        KeReleaseGuardedMutex(&LpcpLock);
+        LpcpReleasePortLock(Port);
 
         /* Dereference the object unless it's the same port */
         if (ConnectionPort != Port) ObDereferenceObject(ConnectionPort);
@@ -451,11 +474,14 @@ LpcpDeletePort(IN PVOID ObjectBody)
     else
     {
         /* Release the lock */
-        KeReleaseGuardedMutex(&LpcpLock);
+        LpcpReleasePortLock(Port);
     }
 
     /* Free client security */
     LpcpFreePortClientSecurity(Port);
+
+    /* Drop our reference on the lock */
+    LpcpDereferencePortLock(Port);
     LPCTRACE(LPC_CLOSE_DEBUG, "Port: %p deleted\n", Port);
 }
 
@@ -20,13 +20,14 @@ LpcpPrepareToWakeClient(IN PETHREAD Thread)
 {
     PAGED_CODE();
 
+    /* The caller holds the lock of the port and of the thread */
+
     /* Make sure the thread isn't dying and it has a valid chain */
     if (!(Thread->LpcExitThreadCalled) &&
         !(IsListEmpty(&Thread->LpcReplyChain)))
     {
         /* Remove it from the list and reinitialize it */
-        RemoveEntryList(&Thread->LpcReplyChain);
-        InitializeListHead(&Thread->LpcReplyChain);
+        LpcpRemoveReplyChain(Thread);
     }
 }
 
@@ -53,6 +54,7 @@ NtAcceptConnectPort(OUT PHANDLE PortHandle,
     PLPCP_CONNECTION_MESSAGE ConnectMessage;
     PLPCP_MESSAGE Message;
     PVOID ClientSectionToMap = NULL;
+    PVOID ServerSectionToMap = NULL;
     HANDLE Handle;
     PEPROCESS ClientProcess;
     PETHREAD ClientThread;
@@ -155,34 +157,55 @@ NtAcceptConnectPort(OUT PHANDLE PortHandle,
                                         &ClientThread);
     if (!NT_SUCCESS(Status)) return Status;
 
-    /* Acquire the LPC Lock */
-    KeAcquireGuardedMutex(&LpcpLock);
+    /* Acquire the lock of the client thread to find the port it connects to */
+    LpcpAcquireThreadLock(ClientThread);
 
     /* Make sure that the client wants a reply, and this is the right one */
-    if (!(LpcpGetMessageFromThread(ClientThread)) ||
+    Message = LpcpGetMessageFromThread(ClientThread);
+    if (!(Message) ||
         !(CapturedReplyMessage.MessageId) ||
-        (ClientThread->LpcReplyMessageId != CapturedReplyMessage.MessageId))
+        (ClientThread->LpcReplyMessageId != CapturedReplyMessage.MessageId) ||
+        (LpcpGetMessageType(&Message->Request) != LPC_CONNECTION_REQUEST))
     {
         /* Not the reply asked for, or no reply wanted, fail */
-        KeReleaseGuardedMutex(&LpcpLock);
+        LpcpReleaseThreadLock(ClientThread);
         ObDereferenceObject(ClientProcess);
         ObDereferenceObject(ClientThread);
         return STATUS_REPLY_MESSAGE_MISMATCH;
     }
 
-    /* Now get the message and connection message */
-    Message = LpcpGetMessageFromThread(ClientThread);
+    /* Reference the client port, it holds the lock of the connection */
     ConnectMessage = (PLPCP_CONNECTION_MESSAGE)(Message + 1);
-
-    /* Get the client and connection port as well */
     ClientPort = ConnectMessage->ClientPort;
+    ObReferenceObject(ClientPort);
+    LpcpReleaseThreadLock(ClientThread);
+
+    /* Acquire the locks in order, and check that nobody answered meanwhile */
+    LpcpAcquirePortLock(ClientPort);
+    LpcpAcquireThreadLock(ClientThread);
+    if ((LpcpGetMessageFromThread(ClientThread) != Message) ||
+        (ClientThread->LpcReplyMessageId != CapturedReplyMessage.MessageId))
+    {
+        /* Someone else did, fail */
+        LpcpReleaseThreadLock(ClientThread);
+        LpcpReleasePortLock(ClientPort);
+        ObDereferenceObject(ClientPort);
+        ObDereferenceObject(ClientProcess);
+        ObDereferenceObject(ClientThread);
+        return STATUS_REPLY_MESSAGE_MISMATCH;
+    }
+
+    /* Get the connection port as well */
+    ASSERT(ConnectMessage->ClientPort == ClientPort);
     ConnectionPort = ClientPort->ConnectionPort;
 
     /* Make sure that the reply is being sent to the proper server process */
     if (ConnectionPort->ServerProcess != PsGetCurrentProcess())
     {
         /* It's not, so fail */
-        KeReleaseGuardedMutex(&LpcpLock);
+        LpcpReleaseThreadLock(ClientThread);
+        LpcpReleasePortLock(ClientPort);
+        ObDereferenceObject(ClientPort);
         ObDereferenceObject(ClientProcess);
         ObDereferenceObject(ClientThread);
         return STATUS_REPLY_MESSAGE_MISMATCH;
@@ -192,9 +215,13 @@ NtAcceptConnectPort(OUT PHANDLE PortHandle,
     ClientThread->LpcReplyMessage = NULL;
     ClientThread->LpcReplyMessageId = 0;
 
-    /* Clear the client port for now as well, then release the lock */
+    /* Clear the client port for now as well, then release the locks */
     ConnectMessage->ClientPort = NULL;
-    KeReleaseGuardedMutex(&LpcpLock);
+    LpcpReleaseThreadLock(ClientThread);
+    LpcpReleasePortLock(ClientPort);
+
+    /* We now own the reference of the message, drop ours */
+    ObDereferenceObject(ClientPort);
 
     /* Check the connection information length */
     if (ConnectionInfoLength > ConnectionPort->MaxConnectionInfoLength)
@@ -248,6 +275,7 @@ NtAcceptConnectPort(OUT PHANDLE PortHandle,
 
     /* Set it up */
     RtlZeroMemory(ServerPort, sizeof(LPCP_PORT_OBJECT));
+    LpcpSharePortLock(ServerPort, ConnectionPort);
     ServerPort->PortContext = PortContext;
     ServerPort->Flags = LPCP_COMMUNICATION_PORT;
     ServerPort->MaxMessageLength = ConnectionPort->MaxMessageLength;
@@ -267,10 +295,10 @@ NtAcceptConnectPort(OUT PHANDLE PortHandle,
     ClientPort->Creator = Message->Request.ClientId;
 
     /* Get the section associated and then clear it, while inside the lock */
-    KeAcquireGuardedMutex(&LpcpLock);
+    LpcpAcquirePortLock(ClientPort);
     ClientSectionToMap = ConnectMessage->SectionToMap;
     ConnectMessage->SectionToMap = NULL;
-    KeReleaseGuardedMutex(&LpcpLock);
+    LpcpReleasePortLock(ClientPort);
 
     /* Now check if there's a client section */
     if (ClientSectionToMap)
@@ -316,12 +344,90 @@ NtAcceptConnectPort(OUT PHANDLE PortHandle,
         }
     }
 
-    /* Check if there's a server section */
+    /*
+     * Check if there's a server section. Along with the client one, this is
+     * how large payloads travel without copies. ALPC port sections are not
+     * implemented, the NtAlpc* services are still stubs.
+     */
     if (ServerView)
     {
-        /* FIXME: TODO */
-        UNREFERENCED_PARAMETER(CapturedServerView);
-        ASSERT(FALSE);
+        /* Get the section handle */
+        Status = ObReferenceObjectByHandle(CapturedServerView.SectionHandle,
+                                           SECTION_MAP_READ |
+                                           SECTION_MAP_WRITE,
+                                           MmSectionObjectType,
+                                           PreviousMode,
+                                           &ServerSectionToMap,
+                                           NULL);
+        if (!NT_SUCCESS(Status))
+        {
+            /* Fail */
+            DPRINT1("Failed to reference server section handle: 0x%lx\n", Status);
+            ServerSectionToMap = NULL;
+            ObDereferenceObject(ServerPort);
+            goto Cleanup;
+        }
+
+        /* Setup the offset */
+        SectionOffset.QuadPart = CapturedServerView.SectionOffset;
+
+        /* Map the section in our own process */
+        Status = MmMapViewOfSection(ServerSectionToMap,
+                                    PsGetCurrentProcess(),
+                                    &ServerPort->ServerSectionBase,
+                                    0,
+                                    0,
+                                    &SectionOffset,
+                                    &CapturedServerView.ViewSize,
+                                    ViewUnmap,
+                                    0,
+                                    PAGE_READWRITE);
+        if (NT_SUCCESS(Status))
+        {
+            /* Save and reference the mapping process if not done yet */
+            if (!ServerPort->MappingProcess)
+            {
+                ServerPort->MappingProcess = PsGetCurrentProcess();
+                ObReferenceObject(ServerPort->MappingProcess);
+            }
+
+            /* Now map the same range in the client process */
+            Status = MmMapViewOfSection(ServerSectionToMap,
+                                        ClientProcess,
+                                        &ClientPort->ServerSectionBase,
+                                        0,
+                                        0,
+                                        &SectionOffset,
+                                        &CapturedServerView.ViewSize,
+                                        ViewUnmap,
+                                        0,
+                                        PAGE_READWRITE);
+            if (NT_SUCCESS(Status) && !(ClientPort->MappingProcess))
+            {
+                /* The client port unmaps it when it goes away */
+                ClientPort->MappingProcess = ClientProcess;
+                ObReferenceObject(ClientPort->MappingProcess);
+            }
+        }
+
+        /* Check the mapping status */
+        if (!NT_SUCCESS(Status))
+        {
+            /* Quit, deleting the server port unmaps our view */
+            DPRINT1("Server section mapping failed: %lx\n", Status);
+            ObDereferenceObject(ServerPort);
+            goto Cleanup;
+        }
+
+        /* Update the view for the server */
+        CapturedServerView.SectionOffset = SectionOffset.LowPart;
+        CapturedServerView.ViewBase = ServerPort->ServerSectionBase;
+        CapturedServerView.ViewRemoteBase = ClientPort->ServerSectionBase;
+
+        /* And tell the client where it sees the view */
+        ConnectMessage->ServerView.Length = sizeof(REMOTE_PORT_VIEW);
+        ConnectMessage->ServerView.ViewSize = CapturedServerView.ViewSize;
+        ConnectMessage->ServerView.ViewBase = ClientPort->ServerSectionBase;
     }
 
     /* Reference the server port until it's fully inserted */
@@ -352,6 +458,16 @@ NtAcceptConnectPort(OUT PHANDLE PortHandle,
             ClientView->ViewSize = ConnectMessage->ClientView.ViewSize;
         }
 
+        /* Check if the caller gave a server view */
+        if (ServerView)
+        {
+            /* Return where both sides see it */
+            ServerView->SectionOffset = CapturedServerView.SectionOffset;
+            ServerView->ViewSize = CapturedServerView.ViewSize;
+            ServerView->ViewBase = CapturedServerView.ViewBase;
+            ServerView->ViewRemoteBase = CapturedServerView.ViewRemoteBase;
+        }
+
         /* Return the handle to user mode */
         *PortHandle = Handle;
     }
@@ -379,9 +495,9 @@ NtAcceptConnectPort(OUT PHANDLE PortHandle,
     ServerPort->ClientThread = ClientThread;
 
     /* Set this message as the LPC Reply message while holding the lock */
-    KeAcquireGuardedMutex(&LpcpLock);
+    LpcpAcquireThreadLock(ClientThread);
     ClientThread->LpcReplyMessage = Message;
-    KeReleaseGuardedMutex(&LpcpLock);
+    LpcpReleaseThreadLock(ClientThread);
 
     /* Clear the thread pointer so it doesn't get cleaned later */
     ClientThread = NULL;
@@ -390,16 +506,19 @@ NtAcceptConnectPort(OUT PHANDLE PortHandle,
     ObDereferenceObject(ServerPort);
 
 Cleanup:
-    /* If there was a section, dereference it */
+    /* If there were sections, dereference them, the views keep them alive */
     if (ClientSectionToMap) ObDereferenceObject(ClientSectionToMap);
+    if (ServerSectionToMap) ObDereferenceObject(ServerSectionToMap);
 
     /* Check if we got here while still having a client thread */
     if (ClientThread)
     {
-        KeAcquireGuardedMutex(&LpcpLock);
+        LpcpAcquirePortLock(ClientPort);
+        LpcpAcquireThreadLock(ClientThread);
         ClientThread->LpcReplyMessage = Message;
         LpcpPrepareToWakeClient(ClientThread);
-        KeReleaseGuardedMutex(&LpcpLock);
+        LpcpReleaseThreadLock(ClientThread);
+        LpcpReleasePortLock(ClientPort);
         LpcpCompleteWait(&ClientThread->LpcReplySemaphore);
         ObDereferenceObject(ClientThread);
     }
@@ -448,25 +567,27 @@ NtCompleteConnectPort(IN HANDLE PortHandle)
     }
 
     /* Acquire the lock */
-    KeAcquireGuardedMutex(&LpcpLock);
+    LpcpAcquirePortLock(Port);
 
     /* Make sure we have a client thread */
     if (!Port->ClientThread)
     {
         /* We don't, fail */
-        KeReleaseGuardedMutex(&LpcpLock);
+        LpcpReleasePortLock(Port);
         ObDereferenceObject(Port);
         return STATUS_INVALID_PARAMETER;
     }
 
-    /* Get the thread */
+    /* Get the thread and acquire its lock */
     Thread = Port->ClientThread;
+    LpcpAcquireThreadLock(Thread);
 
     /* Make sure it has a reply message */
     if (!LpcpGetMessageFromThread(Thread))
     {
         /* It doesn't, quit */
-        KeReleaseGuardedMutex(&LpcpLock);
+        LpcpReleaseThreadLock(Thread);
+        LpcpReleasePortLock(Port);
         ObDereferenceObject(Port);
         return STATUS_SUCCESS;
     }
@@ -475,8 +596,9 @@ NtCompleteConnectPort(IN HANDLE PortHandle)
     Port->ClientThread = NULL;
     LpcpPrepareToWakeClient(Thread);
 
-    /* Release the lock and wait for an answer */
-    KeReleaseGuardedMutex(&LpcpLock);
+    /* Release the locks and wait for an answer */
+    LpcpReleaseThreadLock(Thread);
+    LpcpReleasePortLock(Port);
     LpcpCompleteWait(&Thread->LpcReplySemaphore);
 
     /* Dereference the Thread and Port and return */
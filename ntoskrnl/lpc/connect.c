@@ -18,20 +18,21 @@ PVOID
 NTAPI
 LpcpFreeConMsg(IN OUT PLPCP_MESSAGE *Message,
                IN OUT PLPCP_CONNECTION_MESSAGE *ConnectMessage,
+               IN PLPCP_PORT_OBJECT Port,
                IN PETHREAD CurrentThread)
 {
     PVOID SectionToMap;
     PLPCP_MESSAGE ReplyMessage;
 
-    /* Acquire the LPC lock */
-    KeAcquireGuardedMutex(&LpcpLock);
+    /* Acquire the port and thread locks */
+    LpcpAcquirePortLock(Port);
+    LpcpAcquireThreadLock(CurrentThread);
 
     /* Check if the reply chain is not empty */
     if (!IsListEmpty(&CurrentThread->LpcReplyChain))
     {
         /* Remove this entry and re-initialize it */
-        RemoveEntryList(&CurrentThread->LpcReplyChain);
-        InitializeListHead(&CurrentThread->LpcReplyChain);
+        LpcpRemoveReplyChain(CurrentThread);
     }
 
     /* Check if there's a reply message */
@@ -65,8 +66,9 @@ LpcpFreeConMsg(IN OUT PLPCP_MESSAGE *Message,
         SectionToMap = NULL;
     }
 
-    /* Release the lock and return the section */
-    KeReleaseGuardedMutex(&LpcpLock);
+    /* Release the locks and return the section */
+    LpcpReleaseThreadLock(CurrentThread);
+    LpcpReleasePortLock(Port);
     return SectionToMap;
 }
 
@@ -357,6 +359,7 @@ NtSecureConnectPort(OUT PHANDLE PortHandle,
      * will automatically dereference the connection port too.
      */
     RtlZeroMemory(ClientPort, sizeof(LPCP_PORT_OBJECT));
+    LpcpSharePortLock(ClientPort, Port);
     ClientPort->Flags = LPCP_CLIENT_PORT;
     ClientPort->ConnectionPort = Port;
     ClientPort->MaxMessageLength = Port->MaxMessageLength;
@@ -526,7 +529,7 @@ NtSecureConnectPort(OUT PHANDLE PortHandle,
             /* Cleanup and return the exception code */
 
             /* Free the message we have */
-            LpcpFreeToPortZone(Message, 0);
+            LpcpFreeToPortZone(Message, NULL, 0);
 
             /* Dereference other objects */
             if (SectionToMap) ObDereferenceObject(SectionToMap);
@@ -542,7 +545,7 @@ NtSecureConnectPort(OUT PHANDLE PortHandle,
     Status = STATUS_SUCCESS;
 
     /* Acquire the port lock */
-    KeAcquireGuardedMutex(&LpcpLock);
+    LpcpAcquirePortLock(Port);
 
     /* Check if someone already deleted the port name */
     if (Port->Flags & LPCP_NAME_DELETED)
@@ -552,23 +555,25 @@ NtSecureConnectPort(OUT PHANDLE PortHandle,
     }
     else
     {
-        /* Associate no thread yet */
+        /* Associate no thread yet, and remember the port for LpcExitThread */
         Message->RepliedToThread = NULL;
+        Message->SenderPort = Port;
 
         /* Generate the Message ID and set it */
-        Message->Request.MessageId =  LpcpNextMessageId++;
-        if (!LpcpNextMessageId) LpcpNextMessageId = 1;
-        Thread->LpcReplyMessageId = Message->Request.MessageId;
-
-        /* Insert the message into the queue and thread chain */
-        InsertTailList(&Port->MsgQueue.ReceiveHead, &Message->Entry);
-        InsertTailList(&Port->LpcReplyChainHead, &Thread->LpcReplyChain);
-        Thread->LpcReplyMessage = Message;
+        Message->Request.MessageId = LpcpGenerateMessageId();
 
         /* Now we can finally reference the client port and link it */
         ObReferenceObject(ClientPort);
         ConnectMessage->ClientPort = ClientPort;
 
+        /* Insert the message into the queue and thread chain */
+        LpcpAcquireThreadLock(Thread);
+        Thread->LpcReplyMessageId = Message->Request.MessageId;
+        InsertTailList(&Port->MsgQueue.ReceiveHead, &Message->Entry);
+        LpcpInsertReplyChain(Port, Thread);
+        Thread->LpcReplyMessage = Message;
+        LpcpReleaseThreadLock(Thread);
+
         /* Enter a critical region */
         KeEnterCriticalRegion();
     }
@@ -577,7 +582,7 @@ NtSecureConnectPort(OUT PHANDLE PortHandle,
     ObReferenceObject(Port);
 
     /* Release the lock */
-    KeReleaseGuardedMutex(&LpcpLock);
+    LpcpReleasePortLock(Port);
 
     /* Check for success */
     if (NT_SUCCESS(Status))
@@ -603,7 +608,7 @@ NtSecureConnectPort(OUT PHANDLE PortHandle,
     }
 
     /* Now, always free the connection message */
-    SectionToMap = LpcpFreeConMsg(&Message, &ConnectMessage, Thread);
+    SectionToMap = LpcpFreeConMsg(&Message, &ConnectMessage, Port, Thread);
 
     /* Check for failure */
     if (!NT_SUCCESS(Status))
@@ -719,7 +724,7 @@ NtSecureConnectPort(OUT PHANDLE PortHandle,
             if (SectionToMap) ObDereferenceObject(SectionToMap);
 
             /* Acquire the lock */
-            KeAcquireGuardedMutex(&LpcpLock);
+            LpcpAcquirePortLock(Port);
 
             /* Check if it's because the name got deleted */
             if (!(ClientPort->ConnectionPort) ||
@@ -735,14 +740,14 @@ NtSecureConnectPort(OUT PHANDLE PortHandle,
             }
 
             /* Release the lock */
-            KeReleaseGuardedMutex(&LpcpLock);
+            LpcpReleasePortLock(Port);
 
             /* Kill the port */
             ObDereferenceObject(ClientPort);
         }
 
         /* Free the message */
-        LpcpFreeToPortZone(Message, 0);
+        LpcpFreeToPortZone(Message, NULL, 0);
     }
     else
     {
@@ -758,7 +763,7 @@ NtSecureConnectPort(OUT PHANDLE PortHandle,
 
 Failure:
     /* Check if we had a message and free it */
-    if (Message) LpcpFreeToPortZone(Message, 0);
+    if (Message) LpcpFreeToPortZone(Message, NULL, 0);
 
     /* Dereference other objects */
     if (SectionToMap) ObDereferenceObject(SectionToMap);
@@ -38,6 +38,112 @@ LpcpInitializePortQueue(IN PLPCP_PORT_OBJECT Port)
     return STATUS_SUCCESS;
 }
 
+NTSTATUS
+NTAPI
+LpcpCreatePortLock(IN PLPCP_PORT_OBJECT Port)
+{
+    PLPCP_PORT_LOCK Lock;
+
+    PAGED_CODE();
+
+    /* Allocate the lock, it must be non-paged */
+    Lock = ExAllocatePoolWithTag(NonPagedPool, sizeof(*Lock), TAG_LPC_PORT_LOCK);
+    if (!Lock) return STATUS_INSUFFICIENT_RESOURCES;
+
+    /* Set it up, owned by this port only for now */
+    KeInitializeGuardedMutex(&Lock->Mutex);
+    Lock->ReferenceCount = 1;
+    Port->Lock = Lock;
+    return STATUS_SUCCESS;
+}
+
+VOID
+NTAPI
+LpcpSharePortLock(IN PLPCP_PORT_OBJECT Port,
+                  IN PLPCP_PORT_OBJECT ConnectionPort)
+{
+    PAGED_CODE();
+
+    /* The lock outlives the connection port if the communication port does */
+    InterlockedIncrement(&ConnectionPort->Lock->ReferenceCount);
+    Port->Lock = ConnectionPort->Lock;
+}
+
+VOID
+NTAPI
+LpcpDereferencePortLock(IN PLPCP_PORT_OBJECT Port)
+{
+    PAGED_CODE();
+
+    /* Free the lock with the last port using it */
+    if (!InterlockedDecrement(&Port->Lock->ReferenceCount))
+    {
+        ExFreePoolWithTag(Port->Lock, TAG_LPC_PORT_LOCK);
+    }
+    Port->Lock = NULL;
+}
+
+PLPCP_PORT_LOCK
+NTAPI
+LpcpAcquireReplyChainLocks(IN PLPCP_PORT_LOCK PortLock OPTIONAL,
+                           IN PETHREAD Thread)
+{
+    PLPCP_PORT_OBJECT ChainPort;
+    PLPCP_PORT_LOCK ChainLock = NULL, NewLock;
+    BOOLEAN ChainFirst;
+
+    PAGED_CODE();
+
+    for (;;)
+    {
+        /* Two port locks are taken in address order */
+        ChainFirst = (ChainLock) && (!(PortLock) || (ChainLock < PortLock));
+        if (ChainFirst) KeAcquireGuardedMutex(&ChainLock->Mutex);
+        if (PortLock) KeAcquireGuardedMutex(&PortLock->Mutex);
+        if ((ChainLock) && !(ChainFirst)) KeAcquireGuardedMutex(&ChainLock->Mutex);
+        LpcpAcquireThreadLock(Thread);
+
+        /* Done if the thread is on no chain, or on one whose lock we hold */
+        ChainPort = Thread->LpcReplyChainPort;
+        if (!(ChainPort) ||
+            (ChainPort->Lock == PortLock) ||
+            (ChainPort->Lock == ChainLock))
+        {
+            return ChainLock;
+        }
+
+        /*
+         * The port can't go away while the thread is on its chain, since
+         * unlinking it takes the thread lock. Keep its lock around, the port
+         * itself may already be on its way out.
+         */
+        NewLock = ChainPort->Lock;
+        InterlockedIncrement(&NewLock->ReferenceCount);
+
+        /* And start over with it */
+        LpcpReleaseThreadLock(Thread);
+        if (PortLock) KeReleaseGuardedMutex(&PortLock->Mutex);
+        LpcpReleaseReplyChainLock(ChainLock);
+        ChainLock = NewLock;
+    }
+}
+
+VOID
+NTAPI
+LpcpReleaseReplyChainLock(IN PLPCP_PORT_LOCK ChainLock OPTIONAL)
+{
+    PAGED_CODE();
+
+    if (!ChainLock) return;
+
+    /* Release it, and free it if its last port went away meanwhile */
+    KeReleaseGuardedMutex(&ChainLock->Mutex);
+    if (!InterlockedDecrement(&ChainLock->ReferenceCount))
+    {
+        ExFreePoolWithTag(ChainLock, TAG_LPC_PORT_LOCK);
+    }
+}
+
 NTSTATUS
 NTAPI
 LpcpCreatePort(OUT PHANDLE PortHandle,
@@ -116,6 +222,16 @@ LpcpCreatePort(OUT PHANDLE PortHandle,
 
     /* Set up the Object */
     RtlZeroMemory(Port, sizeof(LPCP_PORT_OBJECT));
+
+    /* Give it a lock of its own, shared with the ports connecting to it */
+    Status = LpcpCreatePortLock(Port);
+    if (!NT_SUCCESS(Status))
+    {
+        /* Fail */
+        ObDereferenceObject(Port);
+        return Status;
+    }
+
     Port->ConnectionPort = Port;
     Port->Creator = PsGetCurrentThread()->Cid;
     InitializeListHead(&Port->LpcDataInfoChainHead);
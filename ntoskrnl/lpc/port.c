@@ -17,7 +17,7 @@
 POBJECT_TYPE LpcPortObjectType, LpcWaitablePortObjectType;
 ULONG LpcpMaxMessageSize;
 PAGED_LOOKASIDE_LIST LpcpMessagesLookaside;
-KGUARDED_MUTEX LpcpLock;
+KGUARDED_MUTEX LpcpThreadLocks[LPCP_THREAD_LOCK_COUNT];
 ULONG LpcpTraceLevel = 0;
 ULONG LpcpNextMessageId = 1, LpcpNextCallbackId = 1;
 
@@ -38,9 +38,13 @@ LpcInitSystem(VOID)
 {
     OBJECT_TYPE_INITIALIZER ObjectTypeInitializer;
     UNICODE_STRING Name;
+    ULONG i;
 
-    /* Setup the LPC Lock */
-    KeInitializeGuardedMutex(&LpcpLock);
+    /* Setup the thread locks, the port locks come with the ports */
+    for (i = 0; i < LPCP_THREAD_LOCK_COUNT; i++)
+    {
+        KeInitializeGuardedMutex(&LpcpThreadLocks[i]);
+    }
 
     /* Create the Port Object Type */
     RtlZeroMemory(&ObjectTypeInitializer, sizeof(ObjectTypeInitializer));
@@ -187,8 +191,9 @@ NtImpersonateClientOfPort(IN HANDLE PortHandle,
         goto Cleanup;
     }
 
-    /* Acquire the lock */
-    KeAcquireGuardedMutex(&LpcpLock);
+    /* Acquire the locks */
+    LpcpAcquirePortLock(Port);
+    LpcpAcquireThreadLock(ClientThread);
 
     /* Get the connected port and try to reference it */
     ConnectedPort = Port->ConnectedPort;
@@ -225,8 +230,9 @@ NtImpersonateClientOfPort(IN HANDLE PortHandle,
         goto CleanupWithLock;
     }
 
-    /* Release the lock */
-    KeReleaseGuardedMutex(&LpcpLock);
+    /* Release the locks */
+    LpcpReleaseThreadLock(ClientThread);
+    LpcpReleasePortLock(Port);
 
     /* Check if security is static */
     if (!(ConnectedPort->Flags & LPCP_SECURITY_DYNAMIC))
@@ -267,8 +273,9 @@ Cleanup:
 
 CleanupWithLock:
 
-    /* Release the lock */
-    KeReleaseGuardedMutex(&LpcpLock);
+    /* Release the locks */
+    LpcpReleaseThreadLock(ClientThread);
+    LpcpReleasePortLock(Port);
     goto Cleanup;
 }
 
@@ -48,7 +48,7 @@ LpcpFreeDataInfoMessage(IN PLPCP_PORT_OBJECT Port,
             /* Unlink and free it */
             RemoveEntryList(&Message->Entry);
             InitializeListHead(&Message->Entry);
-            LpcpFreeToPortZone(Message, LPCP_LOCK_HELD);
+            LpcpFreeToPortZone(Message, Port->Lock, LPCP_LOCK_HELD);
             break;
         }
 
@@ -63,31 +63,32 @@ LpcpSaveDataInfoMessage(IN PLPCP_PORT_OBJECT Port,
                         IN PLPCP_MESSAGE Message,
                         IN ULONG LockFlags)
 {
+    PLPCP_PORT_OBJECT ConnectionPort = Port;
     BOOLEAN LockHeld = (LockFlags & LPCP_LOCK_HELD);
 
     PAGED_CODE();
 
     /* Acquire the lock */
-    if (!LockHeld) KeAcquireGuardedMutex(&LpcpLock);
+    if (!LockHeld) LpcpAcquirePortLock(Port);
 
     /* Check if the port we want is the connection port */
     if ((Port->Flags & LPCP_PORT_TYPE_MASK) > LPCP_UNCONNECTED_PORT)
     {
-        /* Use it */
-        Port = Port->ConnectionPort;
-        if (!Port)
+        /* Use it, it shares our lock */
+        ConnectionPort = Port->ConnectionPort;
+        if (!ConnectionPort)
         {
             /* Release the lock and return */
-            if (!LockHeld) KeReleaseGuardedMutex(&LpcpLock);
+            if (!LockHeld) LpcpReleasePortLock(Port);
             return;
         }
     }
 
     /* Link the message */
-    InsertTailList(&Port->LpcDataInfoChainHead, &Message->Entry);
+    InsertTailList(&ConnectionPort->LpcDataInfoChainHead, &Message->Entry);
 
     /* Release the lock */
-    if (!LockHeld) KeReleaseGuardedMutex(&LpcpLock);
+    if (!LockHeld) LpcpReleasePortLock(Port);
 }
 
 PLPCP_MESSAGE
@@ -194,6 +195,7 @@ NtReplyPort(IN HANDLE PortHandle,
     KPROCESSOR_MODE PreviousMode = KeGetPreviousMode();
     PORT_MESSAGE CapturedReplyMessage;
     PLPCP_PORT_OBJECT Port;
+    PLPCP_PORT_LOCK ChainLock;
     PLPCP_MESSAGE Message;
     PETHREAD Thread = PsGetCurrentThread(), WakeupThread;
 
@@ -273,23 +275,7 @@ NtReplyPort(IN HANDLE PortHandle,
         return STATUS_NO_MEMORY;
     }
 
-    /* Keep the lock acquired */
-    KeAcquireGuardedMutex(&LpcpLock);
-
-    /* Make sure this is the reply the thread is waiting for */
-    if ((WakeupThread->LpcReplyMessageId != CapturedReplyMessage.MessageId) ||
-        ((LpcpGetMessageFromThread(WakeupThread)) &&
-        (LpcpGetMessageType(&LpcpGetMessageFromThread(WakeupThread)-> Request)
-            != LPC_REQUEST)))
-    {
-        /* It isn't, fail */
-        LpcpFreeToPortZone(Message, LPCP_LOCK_HELD | LPCP_LOCK_RELEASE);
-        ObDereferenceObject(WakeupThread);
-        ObDereferenceObject(Port);
-        return STATUS_REPLY_MESSAGE_MISMATCH;
-    }
-
-    /* Copy the message */
+    /* Copy the message before taking the locks */
     _SEH2_TRY
     {
         LpcpMoveMessage(&Message->Request,
@@ -301,13 +287,31 @@ NtReplyPort(IN HANDLE PortHandle,
     _SEH2_EXCEPT(EXCEPTION_EXECUTE_HANDLER)
     {
         /* Cleanup and return the exception code */
-        LpcpFreeToPortZone(Message, LPCP_LOCK_HELD | LPCP_LOCK_RELEASE);
+        LpcpFreeToPortZone(Message, NULL, 0);
         ObDereferenceObject(WakeupThread);
         ObDereferenceObject(Port);
         _SEH2_YIELD(return _SEH2_GetExceptionCode());
     }
     _SEH2_END;
 
+    /* Acquire the locks of the port, of the reply chain and of the thread */
+    ChainLock = LpcpAcquireReplyChainLocks(Port->Lock, WakeupThread);
+
+    /* Make sure this is the reply the thread is waiting for */
+    if ((WakeupThread->LpcReplyMessageId != CapturedReplyMessage.MessageId) ||
+        ((LpcpGetMessageFromThread(WakeupThread)) &&
+        (LpcpGetMessageType(&LpcpGetMessageFromThread(WakeupThread)-> Request)
+            != LPC_REQUEST)))
+    {
+        /* It isn't, fail */
+        LpcpReleaseThreadLock(WakeupThread);
+        LpcpReleaseReplyChainLock(ChainLock);
+        LpcpFreeToPortZone(Message, Port->Lock, LPCP_LOCK_HELD | LPCP_LOCK_RELEASE);
+        ObDereferenceObject(WakeupThread);
+        ObDereferenceObject(Port);
+        return STATUS_REPLY_MESSAGE_MISMATCH;
+    }
+
     /* Reference the thread while we use it */
     ObReferenceObject(WakeupThread);
     Message->RepliedToThread = WakeupThread;
@@ -321,10 +325,13 @@ NtReplyPort(IN HANDLE PortHandle,
         !(IsListEmpty(&WakeupThread->LpcReplyChain)))
     {
         /* Remove us from it and reinitialize it */
-        RemoveEntryList(&WakeupThread->LpcReplyChain);
-        InitializeListHead(&WakeupThread->LpcReplyChain);
+        LpcpRemoveReplyChain(WakeupThread);
     }
 
+    /* We are done with the thread and its reply chain */
+    LpcpReleaseThreadLock(WakeupThread);
+    LpcpReleaseReplyChainLock(ChainLock);
+
     /* Check if this is the message the thread had received */
     if ((Thread->LpcReceivedMsgIdValid) &&
         (Thread->LpcReceivedMessageId == CapturedReplyMessage.MessageId))
@@ -341,7 +348,7 @@ NtReplyPort(IN HANDLE PortHandle,
                             CapturedReplyMessage.ClientId);
 
     /* Release the lock and release the LPC semaphore to wake up waiters */
-    KeReleaseGuardedMutex(&LpcpLock);
+    LpcpReleasePortLock(Port);
     LpcpCompleteWait(&WakeupThread->LpcReplySemaphore);
 
     /* Now we can let go of the thread */
@@ -368,6 +375,7 @@ NtReplyWaitReceivePortEx(IN HANDLE PortHandle,
     PORT_MESSAGE CapturedReplyMessage;
     LARGE_INTEGER CapturedTimeout;
     PLPCP_PORT_OBJECT Port, ReceivePort, ConnectionPort = NULL;
+    PLPCP_PORT_LOCK ChainLock;
     PLPCP_MESSAGE Message;
     PETHREAD Thread = PsGetCurrentThread(), WakeupThread;
     PLPCP_CONNECTION_MESSAGE ConnectMessage;
@@ -468,21 +476,21 @@ NtReplyWaitReceivePortEx(IN HANDLE PortHandle,
         else
         {
             /* Acquire the lock */
-            KeAcquireGuardedMutex(&LpcpLock);
+            LpcpAcquirePortLock(Port);
 
             /* Get the port */
             ConnectionPort = ReceivePort = Port->ConnectionPort;
             if (!ConnectionPort)
             {
                 /* Fail */
-                KeReleaseGuardedMutex(&LpcpLock);
+                LpcpReleasePortLock(Port);
                 ObDereferenceObject(Port);
                 return STATUS_PORT_DISCONNECTED;
             }
 
             /* Release lock and reference */
             ObReferenceObject(ConnectionPort);
-            KeReleaseGuardedMutex(&LpcpLock);
+            LpcpReleasePortLock(Port);
         }
     }
     else
@@ -517,24 +525,7 @@ NtReplyWaitReceivePortEx(IN HANDLE PortHandle,
             return STATUS_NO_MEMORY;
         }
 
-        /* Keep the lock acquired */
-        KeAcquireGuardedMutex(&LpcpLock);
-
-        /* Make sure this is the reply the thread is waiting for */
-        if ((WakeupThread->LpcReplyMessageId != CapturedReplyMessage.MessageId) ||
-            ((LpcpGetMessageFromThread(WakeupThread)) &&
-             (LpcpGetMessageType(&LpcpGetMessageFromThread(WakeupThread)->Request)
-                != LPC_REQUEST)))
-        {
-            /* It isn't, fail */
-            LpcpFreeToPortZone(Message, LPCP_LOCK_HELD | LPCP_LOCK_RELEASE);
-            if (ConnectionPort) ObDereferenceObject(ConnectionPort);
-            ObDereferenceObject(WakeupThread);
-            ObDereferenceObject(Port);
-            return STATUS_REPLY_MESSAGE_MISMATCH;
-        }
-
-        /* Copy the message */
+        /* Copy the message before taking the locks */
         _SEH2_TRY
         {
             LpcpMoveMessage(&Message->Request,
@@ -546,7 +537,7 @@ NtReplyWaitReceivePortEx(IN HANDLE PortHandle,
         _SEH2_EXCEPT(EXCEPTION_EXECUTE_HANDLER)
         {
             /* Cleanup and return the exception code */
-            LpcpFreeToPortZone(Message, LPCP_LOCK_HELD | LPCP_LOCK_RELEASE);
+            LpcpFreeToPortZone(Message, NULL, 0);
             if (ConnectionPort) ObDereferenceObject(ConnectionPort);
             ObDereferenceObject(WakeupThread);
             ObDereferenceObject(Port);
@@ -554,6 +545,25 @@ NtReplyWaitReceivePortEx(IN HANDLE PortHandle,
         }
         _SEH2_END;
 
+        /* Acquire the locks of the port, of the reply chain and of the thread */
+        ChainLock = LpcpAcquireReplyChainLocks(Port->Lock, WakeupThread);
+
+        /* Make sure this is the reply the thread is waiting for */
+        if ((WakeupThread->LpcReplyMessageId != CapturedReplyMessage.MessageId) ||
+            ((LpcpGetMessageFromThread(WakeupThread)) &&
+             (LpcpGetMessageType(&LpcpGetMessageFromThread(WakeupThread)->Request)
+                != LPC_REQUEST)))
+        {
+            /* It isn't, fail */
+            LpcpReleaseThreadLock(WakeupThread);
+            LpcpReleaseReplyChainLock(ChainLock);
+            LpcpFreeToPortZone(Message, Port->Lock, LPCP_LOCK_HELD | LPCP_LOCK_RELEASE);
+            if (ConnectionPort) ObDereferenceObject(ConnectionPort);
+            ObDereferenceObject(WakeupThread);
+            ObDereferenceObject(Port);
+            return STATUS_REPLY_MESSAGE_MISMATCH;
+        }
+
         /* Reference the thread while we use it */
         ObReferenceObject(WakeupThread);
         Message->RepliedToThread = WakeupThread;
@@ -567,10 +577,13 @@ NtReplyWaitReceivePortEx(IN HANDLE PortHandle,
             !(IsListEmpty(&WakeupThread->LpcReplyChain)))
         {
             /* Remove us from it and reinitialize it */
-            RemoveEntryList(&WakeupThread->LpcReplyChain);
-            InitializeListHead(&WakeupThread->LpcReplyChain);
+            LpcpRemoveReplyChain(WakeupThread);
         }
 
+        /* We are done with the thread and its reply chain */
+        LpcpReleaseThreadLock(WakeupThread);
+        LpcpReleaseReplyChainLock(ChainLock);
+
         /* Check if this is the message the thread had received */
         if ((Thread->LpcReceivedMsgIdValid) &&
             (Thread->LpcReceivedMessageId == CapturedReplyMessage.MessageId))
@@ -587,7 +600,7 @@ NtReplyWaitReceivePortEx(IN HANDLE PortHandle,
                                 CapturedReplyMessage.ClientId);
 
         /* Release the lock and release the LPC semaphore to wake up waiters */
-        KeReleaseGuardedMutex(&LpcpLock);
+        LpcpReleasePortLock(Port);
         LpcpCompleteWait(&WakeupThread->LpcReplySemaphore);
 
         /* Now we can let go of the thread */
@@ -598,8 +611,8 @@ NtReplyWaitReceivePortEx(IN HANDLE PortHandle,
     LpcpReceiveWait(ReceivePort->MsgQueue.Semaphore, WaitMode);
     if (Status != STATUS_SUCCESS) goto Cleanup;
 
-    /* Wait done, get the LPC lock */
-    KeAcquireGuardedMutex(&LpcpLock);
+    /* Wait done, get the port lock */
+    LpcpAcquirePortLock(Port);
 
     /* Check if we've received nothing */
     if (IsListEmpty(&ReceivePort->MsgQueue.ReceiveHead))
@@ -612,7 +625,7 @@ NtReplyWaitReceivePortEx(IN HANDLE PortHandle,
         }
 
         /* Release the lock and fail */
-        KeReleaseGuardedMutex(&LpcpLock);
+        LpcpReleasePortLock(Port);
         if (ConnectionPort) ObDereferenceObject(ConnectionPort);
         ObDereferenceObject(Port);
         return STATUS_UNSUCCESSFUL;
@@ -716,12 +729,12 @@ NtReplyWaitReceivePortEx(IN HANDLE PortHandle,
     if (Message)
     {
         /* Free it and release the lock */
-        LpcpFreeToPortZone(Message, LPCP_LOCK_HELD | LPCP_LOCK_RELEASE);
+        LpcpFreeToPortZone(Message, Port->Lock, LPCP_LOCK_HELD | LPCP_LOCK_RELEASE);
     }
     else
     {
         /* Just release the lock */
-        KeReleaseGuardedMutex(&LpcpLock);
+        LpcpReleasePortLock(Port);
     }
 
 Cleanup:
@@ -838,8 +851,9 @@ LpcpCopyRequestData(
         goto Cleanup;
     }
 
-    /* Acquire the global LPC lock */
-    KeAcquireGuardedMutex(&LpcpLock);
+    /* Acquire the lock of the port, then of the client thread */
+    LpcpAcquirePortLock(Port);
+    LpcpAcquireThreadLock(ClientThread);
 
     /* Check for message id mismatch */
     if ((ClientThread->LpcReplyMessageId != CapturedMessage.MessageId) ||
@@ -894,8 +908,9 @@ LpcpCopyRequestData(
     /* Get the data pointer */
     DataInfoBaseAddress = DataInfo->Entries[Index].BaseAddress;
 
-    /* Release the lock */
-    KeReleaseGuardedMutex(&LpcpLock);
+    /* Release the locks */
+    LpcpReleaseThreadLock(ClientThread);
+    LpcpReleasePortLock(Port);
 
     if (Write)
     {
@@ -952,8 +967,9 @@ Cleanup:
 
 CleanupWithLock:
 
-    /* Release the lock */
-    KeReleaseGuardedMutex(&LpcpLock);
+    /* Release the locks */
+    LpcpReleaseThreadLock(ClientThread);
+    LpcpReleasePortLock(Port);
     goto Cleanup;
 }
 
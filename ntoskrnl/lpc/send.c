@@ -85,8 +85,8 @@ LpcRequestPort(IN PVOID PortObject,
                     MessageType,
                     &Thread->Cid);
 
-    /* Acquire the LPC lock */
-    KeAcquireGuardedMutex(&LpcpLock);
+    /* Acquire the port lock */
+    LpcpAcquirePortLock(Port);
 
     /* Check if this is anything but a connection port */
     if ((Port->Flags & LPCP_PORT_TYPE_MASK) != LPCP_CONNECTION_PORT)
@@ -104,7 +104,7 @@ LpcRequestPort(IN PVOID PortObject,
                 if (!ConnectionPort)
                 {
                     /* Fail */
-                    LpcpFreeToPortZone(Message, LPCP_LOCK_HELD | LPCP_LOCK_RELEASE);
+                    LpcpFreeToPortZone(Message, Port->Lock, LPCP_LOCK_HELD | LPCP_LOCK_RELEASE);
                     return STATUS_PORT_DISCONNECTED;
                 }
             }
@@ -115,7 +115,7 @@ LpcRequestPort(IN PVOID PortObject,
                 if (!ConnectionPort)
                 {
                     /* Fail */
-                    LpcpFreeToPortZone(Message, LPCP_LOCK_HELD | LPCP_LOCK_RELEASE);
+                    LpcpFreeToPortZone(Message, Port->Lock, LPCP_LOCK_HELD | LPCP_LOCK_RELEASE);
                     return STATUS_PORT_DISCONNECTED;
                 }
             }
@@ -134,19 +134,20 @@ LpcRequestPort(IN PVOID PortObject,
     if (QueuePort)
     {
         /* Generate the Message ID and set it */
-        Message->Request.MessageId = LpcpNextMessageId++;
-        if (!LpcpNextMessageId) LpcpNextMessageId = 1;
+        Message->Request.MessageId = LpcpGenerateMessageId();
         Message->Request.CallbackId = 0;
 
         /* No Message ID for the thread */
+        LpcpAcquireThreadLock(Thread);
         Thread->LpcReplyMessageId = 0;
+        LpcpReleaseThreadLock(Thread);
 
         /* Insert the message in our chain */
         InsertTailList(&QueuePort->MsgQueue.ReceiveHead, &Message->Entry);
 
         /* Release the lock and the semaphore */
         KeEnterCriticalRegion();
-        KeReleaseGuardedMutex(&LpcpLock);
+        LpcpReleasePortLock(Port);
         LpcpCompleteWait(QueuePort->MsgQueue.Semaphore);
 
         /* If this is a waitable port, wake it up */
@@ -165,7 +166,7 @@ LpcRequestPort(IN PVOID PortObject,
     }
 
     /* If we got here, then free the message and fail */
-    LpcpFreeToPortZone(Message, LPCP_LOCK_HELD | LPCP_LOCK_RELEASE);
+    LpcpFreeToPortZone(Message, Port->Lock, LPCP_LOCK_HELD | LPCP_LOCK_RELEASE);
     if (ConnectionPort) ObDereferenceObject(ConnectionPort);
     return STATUS_PORT_DISCONNECTED;
 }
@@ -264,8 +265,8 @@ LpcRequestWaitReplyPort(IN PVOID PortObject,
                         0,
                         &Thread->Cid);
 
-        /* Acquire the LPC lock */
-        KeAcquireGuardedMutex(&LpcpLock);
+        /* Acquire the port lock */
+        LpcpAcquirePortLock(Port);
 
         /* Right now clear the port context */
         Message->PortContext = NULL;
@@ -278,7 +279,7 @@ LpcRequestWaitReplyPort(IN PVOID PortObject,
             if (!QueuePort)
             {
                 /* We have no connected port, fail */
-                LpcpFreeToPortZone(Message, LPCP_LOCK_HELD | LPCP_LOCK_RELEASE);
+                LpcpFreeToPortZone(Message, Port->Lock, LPCP_LOCK_HELD | LPCP_LOCK_RELEASE);
                 return STATUS_PORT_DISCONNECTED;
             }
 
@@ -294,7 +295,7 @@ LpcRequestWaitReplyPort(IN PVOID PortObject,
                 if (!ConnectionPort)
                 {
                     /* Fail */
-                    LpcpFreeToPortZone(Message, LPCP_LOCK_HELD | LPCP_LOCK_RELEASE);
+                    LpcpFreeToPortZone(Message, Port->Lock, LPCP_LOCK_HELD | LPCP_LOCK_RELEASE);
                     return STATUS_PORT_DISCONNECTED;
                 }
             }
@@ -306,7 +307,7 @@ LpcRequestWaitReplyPort(IN PVOID PortObject,
                 if (!ConnectionPort)
                 {
                     /* Fail */
-                    LpcpFreeToPortZone(Message, LPCP_LOCK_HELD | LPCP_LOCK_RELEASE);
+                    LpcpFreeToPortZone(Message, Port->Lock, LPCP_LOCK_HELD | LPCP_LOCK_RELEASE);
                     return STATUS_PORT_DISCONNECTED;
                 }
             }
@@ -325,22 +326,23 @@ LpcRequestWaitReplyPort(IN PVOID PortObject,
         Message->SenderPort = Port;
 
         /* Generate the Message ID and set it */
-        Message->Request.MessageId = LpcpNextMessageId++;
-        if (!LpcpNextMessageId) LpcpNextMessageId = 1;
+        Message->Request.MessageId = LpcpGenerateMessageId();
         Message->Request.CallbackId = 0;
 
         /* Set the message ID for our thread now */
+        LpcpAcquireThreadLock(Thread);
         Thread->LpcReplyMessageId = Message->Request.MessageId;
         Thread->LpcReplyMessage = NULL;
 
         /* Insert the message in our chain */
         InsertTailList(&QueuePort->MsgQueue.ReceiveHead, &Message->Entry);
-        InsertTailList(&ReplyPort->LpcReplyChainHead, &Thread->LpcReplyChain);
+        LpcpInsertReplyChain(ReplyPort, Thread);
         LpcpSetPortToThread(Thread, Port);
+        LpcpReleaseThreadLock(Thread);
 
         /* Release the lock and get the semaphore we'll use later */
         KeEnterCriticalRegion();
-        KeReleaseGuardedMutex(&LpcpLock);
+        LpcpReleasePortLock(Port);
         Semaphore = QueuePort->MsgQueue.Semaphore;
 
         /* If this is a waitable port, wake it up */
@@ -358,8 +360,9 @@ LpcRequestWaitReplyPort(IN PVOID PortObject,
     /* And let's wait for the reply */
     LpcpReplyWait(&Thread->LpcReplySemaphore, PreviousMode);
 
-    /* Acquire the LPC lock */
-    KeAcquireGuardedMutex(&LpcpLock);
+    /* Acquire the port and thread locks */
+    LpcpAcquirePortLock(Port);
+    LpcpAcquireThreadLock(Thread);
 
     /* Get the LPC Message and clear our thread's reply data */
     Message = LpcpGetMessageFromThread(Thread);
@@ -370,12 +373,12 @@ LpcRequestWaitReplyPort(IN PVOID PortObject,
     if (!IsListEmpty(&Thread->LpcReplyChain))
     {
         /* Remove this thread and reinitialize the list */
-        RemoveEntryList(&Thread->LpcReplyChain);
-        InitializeListHead(&Thread->LpcReplyChain);
+        LpcpRemoveReplyChain(Thread);
     }
 
-    /* Release the lock */
-    KeReleaseGuardedMutex(&LpcpLock);
+    /* Release the locks */
+    LpcpReleaseThreadLock(Thread);
+    LpcpReleasePortLock(Port);
 
     /* Check if we got a reply */
     if (Status == STATUS_SUCCESS)
@@ -396,7 +399,7 @@ LpcRequestWaitReplyPort(IN PVOID PortObject,
                             NULL);
 
             /* Acquire the lock */
-            KeAcquireGuardedMutex(&LpcpLock);
+            LpcpAcquirePortLock(Port);
 
             /* Check if we replied to a thread */
             if (Message->RepliedToThread)
@@ -407,7 +410,7 @@ LpcRequestWaitReplyPort(IN PVOID PortObject,
             }
 
             /* Free the message */
-            LpcpFreeToPortZone(Message, LPCP_LOCK_HELD | LPCP_LOCK_RELEASE);
+            LpcpFreeToPortZone(Message, Port->Lock, LPCP_LOCK_HELD | LPCP_LOCK_RELEASE);
         }
         else
         {
@@ -418,7 +421,7 @@ LpcRequestWaitReplyPort(IN PVOID PortObject,
     else
     {
         /* The wait failed, free the message */
-        if (Message) LpcpFreeToPortZone(Message, 0);
+        if (Message) LpcpFreeToPortZone(Message, NULL, 0);
     }
 
     /* All done */
@@ -531,14 +534,14 @@ NtRequestPort(IN HANDLE PortHandle,
     _SEH2_EXCEPT(EXCEPTION_EXECUTE_HANDLER)
     {
         /* Cleanup and return the exception code */
-        LpcpFreeToPortZone(Message, 0);
+        LpcpFreeToPortZone(Message, NULL, 0);
         ObDereferenceObject(Port);
         _SEH2_YIELD(return _SEH2_GetExceptionCode());
     }
     _SEH2_END;
 
-    /* Acquire the LPC lock */
-    KeAcquireGuardedMutex(&LpcpLock);
+    /* Acquire the port lock */
+    LpcpAcquirePortLock(Port);
 
     /* Right now clear the port context */
     Message->PortContext = NULL;
@@ -551,7 +554,7 @@ NtRequestPort(IN HANDLE PortHandle,
         if (!QueuePort)
         {
             /* We have no connected port, fail */
-            LpcpFreeToPortZone(Message, LPCP_LOCK_HELD | LPCP_LOCK_RELEASE);
+            LpcpFreeToPortZone(Message, Port->Lock, LPCP_LOCK_HELD | LPCP_LOCK_RELEASE);
             ObDereferenceObject(Port);
             return STATUS_PORT_DISCONNECTED;
         }
@@ -565,7 +568,7 @@ NtRequestPort(IN HANDLE PortHandle,
             if (!ConnectionPort)
             {
                 /* Fail */
-                LpcpFreeToPortZone(Message, LPCP_LOCK_HELD | LPCP_LOCK_RELEASE);
+                LpcpFreeToPortZone(Message, Port->Lock, LPCP_LOCK_HELD | LPCP_LOCK_RELEASE);
                 ObDereferenceObject(Port);
                 return STATUS_PORT_DISCONNECTED;
             }
@@ -577,7 +580,7 @@ NtRequestPort(IN HANDLE PortHandle,
             if (!ConnectionPort)
             {
                 /* Fail */
-                LpcpFreeToPortZone(Message, LPCP_LOCK_HELD | LPCP_LOCK_RELEASE);
+                LpcpFreeToPortZone(Message, Port->Lock, LPCP_LOCK_HELD | LPCP_LOCK_RELEASE);
                 ObDereferenceObject(Port);
                 return STATUS_PORT_DISCONNECTED;
             }
@@ -599,19 +602,20 @@ NtRequestPort(IN HANDLE PortHandle,
         Message->SenderPort = Port;
 
         /* Generate the Message ID and set it */
-        Message->Request.MessageId = LpcpNextMessageId++;
-        if (!LpcpNextMessageId) LpcpNextMessageId = 1;
+        Message->Request.MessageId = LpcpGenerateMessageId();
         Message->Request.CallbackId = 0;
 
         /* No Message ID for the thread */
+        LpcpAcquireThreadLock(Thread);
         Thread->LpcReplyMessageId = 0;
+        LpcpReleaseThreadLock(Thread);
 
         /* Insert the message in our chain */
         InsertTailList(&QueuePort->MsgQueue.ReceiveHead, &Message->Entry);
 
         /* Release the lock and the semaphore */
         KeEnterCriticalRegion();
-        KeReleaseGuardedMutex(&LpcpLock);
+        LpcpReleasePortLock(Port);
         LpcpCompleteWait(QueuePort->MsgQueue.Semaphore);
 
         /* If this is a waitable port, wake it up */
@@ -640,7 +644,7 @@ NtRequestPort(IN HANDLE PortHandle,
              Status);
 
     /* The wait failed, free the message */
-    if (Message) LpcpFreeToPortZone(Message, LPCP_LOCK_HELD | LPCP_LOCK_RELEASE);
+    if (Message) LpcpFreeToPortZone(Message, Port->Lock, LPCP_LOCK_HELD | LPCP_LOCK_RELEASE);
 
     ObDereferenceObject(Port);
     if (ConnectionPort) ObDereferenceObject(ConnectionPort);
@@ -850,7 +854,7 @@ NtRequestWaitReplyPort(IN HANDLE PortHandle,
                 DataInfo = LpcpGetDataInfoFromMessage(LpcRequest);
                 if (DataInfo->NumberOfEntries != NumberOfDataEntries)
                 {
-                    LpcpFreeToPortZone(Message, 0);
+                    LpcpFreeToPortZone(Message, NULL, 0);
                     ObDereferenceObject(Port);
                     DPRINT1("NumberOfEntries has changed: %u, %u\n",
                             DataInfo->NumberOfEntries, NumberOfDataEntries);
@@ -869,14 +873,14 @@ NtRequestWaitReplyPort(IN HANDLE PortHandle,
         {
             /* Cleanup and return the exception code */
             DPRINT1("Got exception!\n");
-            LpcpFreeToPortZone(Message, 0);
+            LpcpFreeToPortZone(Message, NULL, 0);
             ObDereferenceObject(Port);
             _SEH2_YIELD(return _SEH2_GetExceptionCode());
         }
         _SEH2_END;
 
-        /* Acquire the LPC lock */
-        KeAcquireGuardedMutex(&LpcpLock);
+        /* Acquire the port lock */
+        LpcpAcquirePortLock(Port);
 
         /* Right now clear the port context */
         Message->PortContext = NULL;
@@ -890,7 +894,7 @@ NtRequestWaitReplyPort(IN HANDLE PortHandle,
             {
                 /* We have no connected port, fail */
                 DPRINT1("No connected port\n");
-                LpcpFreeToPortZone(Message, LPCP_LOCK_HELD | LPCP_LOCK_RELEASE);
+                LpcpFreeToPortZone(Message, Port->Lock, LPCP_LOCK_HELD | LPCP_LOCK_RELEASE);
                 ObDereferenceObject(Port);
                 return STATUS_PORT_DISCONNECTED;
             }
@@ -913,7 +917,7 @@ NtRequestWaitReplyPort(IN HANDLE PortHandle,
                 {
                     /* Fail */
                     DPRINT1("No connection port\n");
-                    LpcpFreeToPortZone(Message, LPCP_LOCK_HELD | LPCP_LOCK_RELEASE);
+                    LpcpFreeToPortZone(Message, Port->Lock, LPCP_LOCK_HELD | LPCP_LOCK_RELEASE);
                     ObDereferenceObject(Port);
                     return STATUS_PORT_DISCONNECTED;
                 }
@@ -933,22 +937,23 @@ NtRequestWaitReplyPort(IN HANDLE PortHandle,
         Message->SenderPort = Port;
 
         /* Generate the Message ID and set it */
-        Message->Request.MessageId = LpcpNextMessageId++;
-        if (!LpcpNextMessageId) LpcpNextMessageId = 1;
+        Message->Request.MessageId = LpcpGenerateMessageId();
         Message->Request.CallbackId = 0;
 
         /* Set the message ID for our thread now */
+        LpcpAcquireThreadLock(Thread);
         Thread->LpcReplyMessageId = Message->Request.MessageId;
         Thread->LpcReplyMessage = NULL;
 
         /* Insert the message in our chain */
         InsertTailList(&QueuePort->MsgQueue.ReceiveHead, &Message->Entry);
-        InsertTailList(&ReplyPort->LpcReplyChainHead, &Thread->LpcReplyChain);
+        LpcpInsertReplyChain(ReplyPort, Thread);
         LpcpSetPortToThread(Thread, Port);
+        LpcpReleaseThreadLock(Thread);
 
         /* Release the lock and get the semaphore we'll use later */
         KeEnterCriticalRegion();
-        KeReleaseGuardedMutex(&LpcpLock);
+        LpcpReleasePortLock(Port);
         Semaphore = QueuePort->MsgQueue.Semaphore;
 
         /* If this is a waitable port, wake it up */
@@ -966,8 +971,9 @@ NtRequestWaitReplyPort(IN HANDLE PortHandle,
     /* And let's wait for the reply */
     LpcpReplyWait(&Thread->LpcReplySemaphore, PreviousMode);
 
-    /* Acquire the LPC lock */
-    KeAcquireGuardedMutex(&LpcpLock);
+    /* Acquire the port and thread locks */
+    LpcpAcquirePortLock(Port);
+    LpcpAcquireThreadLock(Thread);
 
     /* Get the LPC Message and clear our thread's reply data */
     Message = LpcpGetMessageFromThread(Thread);
@@ -978,12 +984,12 @@ NtRequestWaitReplyPort(IN HANDLE PortHandle,
     if (!IsListEmpty(&Thread->LpcReplyChain))
     {
         /* Remove this thread and reinitialize the list */
-        RemoveEntryList(&Thread->LpcReplyChain);
-        InitializeListHead(&Thread->LpcReplyChain);
+        LpcpRemoveReplyChain(Thread);
     }
 
-    /* Release the lock */
-    KeReleaseGuardedMutex(&LpcpLock);
+    /* Release the locks */
+    LpcpReleaseThreadLock(Thread);
+    LpcpReleasePortLock(Port);
 
     /* Check if we got a reply */
     if (Status == STATUS_SUCCESS)
@@ -1022,7 +1028,7 @@ NtRequestWaitReplyPort(IN HANDLE PortHandle,
             else
             {
                 /* Otherwise, just free it */
-                LpcpFreeToPortZone(Message, 0);
+                LpcpFreeToPortZone(Message, NULL, 0);
             }
         }
         else
@@ -1034,7 +1040,7 @@ NtRequestWaitReplyPort(IN HANDLE PortHandle,
     else
     {
         /* The wait failed, free the message */
-        if (Message) LpcpFreeToPortZone(Message, 0);
+        if (Message) LpcpFreeToPortZone(Message, NULL, 0);
     }
 
     /* All done */
@@ -1780,6 +1780,12 @@ MmNotPresentFaultSectionView(PMMSUPPORT AddressSpace,
 
         PFSRTL_COMMON_FCB_HEADER FcbHeader = Segment->FileObject->FsContext;
 
+        /* Let the prefetcher know which page of the file this process needed */
+        CcPfLogPageFault(Segment->FileObject,
+                         Segment->Image.FileOffset + Offset.QuadPart,
+                         PAGE_SIZE,
+                         !(*Segment->Flags & MM_DATAFILE_SEGMENT));
+
         Status = MmMakeSegmentResident(Segment, Offset.QuadPart, PAGE_SIZE, &FcbHeader->ValidDataLength, FALSE);
 
         FsRtlReleaseFile(Segment->FileObject);
@@ -4933,6 +4939,8 @@ MmMakeDataSectionResident(
     /* There must be a segment for this call */
     ASSERT(Segment);
 
+    CcPfLogPageFault(Segment->FileObject, Offset, Length, FALSE);
+
     NTSTATUS Status = MmMakeSegmentResident(Segment, Offset, Length, ValidDataLength, FALSE);
 
     MmDereferenceSegment(Segment);
@@ -4940,6 +4948,89 @@ MmMakeDataSectionResident(
     return Status;
 }
 
+NTSTATUS
+NTAPI
+MmPrefetchSectionPages(
+    _In_ PVOID SectionObject,
+    _In_ LONGLONG FileOffset,
+    _In_ ULONG Length)
+{
+    PSECTION Section = SectionObject;
+    PFILE_OBJECT FileObject;
+    PFSRTL_COMMON_FCB_HEADER FcbHeader;
+    LARGE_INTEGER ValidDataLength;
+    LONGLONG FileEnd;
+    NTSTATUS Status = STATUS_SUCCESS;
+
+    PAGED_CODE();
+
+    if (!MiIsRosSectionObject(Section) || !Section->Segment)
+        return STATUS_INVALID_PARAMETER;
+
+    Status = RtlLongLongAdd(FileOffset, Length, &FileEnd);
+    if (!NT_SUCCESS(Status))
+        return Status;
+
+    if (Section->u.Flags.Image)
+    {
+        PMM_IMAGE_SECTION_OBJECT ImageSectionObject = (PMM_IMAGE_SECTION_OBJECT)Section->Segment;
+
+        FileObject = ImageSectionObject->FileObject;
+        FsRtlAcquireFileExclusive(FileObject);
+        FcbHeader = FileObject->FsContext;
+        ValidDataLength = FcbHeader->ValidDataLength;
+
+        /* Read the part of the range backing each segment of the image */
+        for (ULONG i = 0; i < ImageSectionObject->NrSegments; i++)
+        {
+            PMM_SECTION_SEGMENT Segment = &ImageSectionObject->Segments[i];
+            LONGLONG SegmentStart = Segment->Image.FileOffset;
+            LONGLONG SegmentEnd = SegmentStart + Segment->RawLength.QuadPart;
+            LONGLONG Start = max(SegmentStart, FileOffset);
+            LONGLONG End = min(SegmentEnd, FileEnd);
+
+            if (Start >= End)
+                continue;
+
+            Status = MmMakeSegmentResident(Segment,
+                                           Start - SegmentStart,
+                                           (ULONG)(End - Start),
+                                           &ValidDataLength,
+                                           FALSE);
+            if (!NT_SUCCESS(Status))
+                break;
+        }
+
+        FsRtlReleaseFile(FileObject);
+    }
+    else
+    {
+        PMM_SECTION_SEGMENT Segment = (PMM_SECTION_SEGMENT)Section->Segment;
+
+        FileObject = Segment->FileObject;
+        FsRtlAcquireFileExclusive(FileObject);
+        FcbHeader = FileObject->FsContext;
+        ValidDataLength = FcbHeader->ValidDataLength;
+
+        /* Don't create pages past the end of the file */
+        if (FileEnd > FcbHeader->FileSize.QuadPart)
+            FileEnd = FcbHeader->FileSize.QuadPart;
+
+        if (FileOffset < FileEnd)
+        {
+            Status = MmMakeSegmentResident(Segment,
+                                           FileOffset,
+                                           (ULONG)(FileEnd - FileOffset),
+                                           &ValidDataLength,
+                                           FALSE);
+        }
+
+        FsRtlReleaseFile(FileObject);
+    }
+
+    return Status;
+}
+
 NTSTATUS
 NTAPI
 MmFlushSegment(
@@ -412,6 +412,161 @@ SepReleaseSid(
     }
 }
 
+/**
+ * @brief
+ * Computes the hash bucket of a SID. SIDs of the same token mostly
+ * share their authority and all but the last sub-authority, so the
+ * relative identifier is what tells them apart.
+ *
+ * @param[in] Sid
+ * A valid SID.
+ *
+ * @param[in] Shift
+ * The shift that reduces the hash to the bucket count of the table.
+ *
+ * @return
+ * Returns the bucket index of the SID.
+ */
+static
+ULONG
+SepHashSid(
+    _In_ PISID Sid,
+    _In_ ULONG Shift)
+{
+    ULONG Key;
+
+    Key = Sid->IdentifierAuthority.Value[5] | (Sid->SubAuthorityCount << 8);
+    if (Sid->SubAuthorityCount > 0)
+        Key ^= Sid->SubAuthority[Sid->SubAuthorityCount - 1];
+
+    return (Key * 0x9E3779B1) >> Shift;
+}
+
+/**
+ * @brief
+ * Creates a hash index over an array of SIDs.
+ *
+ * @param[in] SidAndAttributes
+ * The array of SIDs to index.
+ *
+ * @param[in] SidCount
+ * The number of SIDs in the array.
+ *
+ * @return
+ * Returns the hash index, or NULL if the array is too small to
+ * be worth one or if the index could not be allocated. Lookups
+ * then scan the array instead.
+ */
+static
+PSEP_SID_HASH
+SepCreateSidHash(
+    _In_reads_(SidCount) PSID_AND_ATTRIBUTES SidAndAttributes,
+    _In_ ULONG SidCount)
+{
+    PSEP_SID_HASH SidHash;
+    ULONG BucketCount, Bits, Bucket, SidIndex;
+
+    if ((SidCount < SEP_SID_HASH_MINIMUM_COUNT) ||
+        (SidCount > SEP_SID_HASH_MAXIMUM_COUNT))
+    {
+        return NULL;
+    }
+
+    /* Keep the chains short with at least one bucket per SID */
+    for (Bits = 4, BucketCount = 16; BucketCount < SidCount; Bits++)
+        BucketCount <<= 1;
+
+    SidHash = ExAllocatePoolWithTag(PagedPool,
+                                    FIELD_OFFSET(SEP_SID_HASH, Entries[BucketCount + SidCount]),
+                                    TAG_SID_HASH);
+    if (SidHash == NULL)
+    {
+        DPRINT1("Failed to allocate the hash of %lu SIDs\n", SidCount);
+        return NULL;
+    }
+
+    SidHash->SidCount = SidCount;
+    SidHash->Shift = 32 - Bits;
+    SidHash->Buckets = &SidHash->Entries[0];
+    SidHash->Next = &SidHash->Entries[BucketCount];
+    RtlZeroMemory(SidHash->Buckets, BucketCount * sizeof(USHORT));
+
+    /*
+     * Insert from the last SID to the first one so that every chain
+     * is sorted by index. Lookups then find the same SID first as a
+     * scan of the array would, which matters for duplicate SIDs.
+     */
+    for (SidIndex = SidCount; SidIndex-- > 0;)
+    {
+        Bucket = SepHashSid((PISID)SidAndAttributes[SidIndex].Sid, SidHash->Shift);
+        SidHash->Next[SidIndex] = SidHash->Buckets[Bucket];
+        SidHash->Buckets[Bucket] = (USHORT)(SidIndex + 1);
+    }
+
+    return SidHash;
+}
+
+/**
+ * @brief
+ * Builds the hash indexes of the user and group SIDs and of the
+ * restricted SIDs of a token. This must be called whenever these
+ * arrays are set up or reordered, changing the attributes of the
+ * SIDs does not invalidate the indexes.
+ *
+ * @param[in,out] Token
+ * The token whose SIDs are to be indexed.
+ *
+ * @return
+ * Nothing.
+ */
+VOID
+SepBuildTokenSidHash(
+    _Inout_ PTOKEN Token)
+{
+    PAGED_CODE();
+
+    SepFreeTokenSidHash(Token);
+
+    if (Token->UserAndGroups)
+    {
+        Token->UserAndGroupsHash = SepCreateSidHash(Token->UserAndGroups,
+                                                    Token->UserAndGroupCount);
+    }
+
+    if (Token->RestrictedSids)
+    {
+        Token->RestrictedSidsHash = SepCreateSidHash(Token->RestrictedSids,
+                                                     Token->RestrictedSidCount);
+    }
+}
+
+/**
+ * @brief
+ * Frees the SID hash indexes of a token.
+ *
+ * @param[in,out] Token
+ * The token whose SID hash indexes are to be freed.
+ *
+ * @return
+ * Nothing.
+ */
+VOID
+SepFreeTokenSidHash(
+    _Inout_ PTOKEN Token)
+{
+    if (Token->UserAndGroupsHash)
+    {
+        ExFreePoolWithTag(Token->UserAndGroupsHash, TAG_SID_HASH);
+        Token->UserAndGroupsHash = NULL;
+    }
+
+    if (Token->RestrictedSidsHash)
+    {
+        ExFreePoolWithTag(Token->RestrictedSidsHash, TAG_SID_HASH);
+        Token->RestrictedSidsHash = NULL;
+    }
+}
+
 /**
  * @brief
  * Checks if a SID is present in a token.
@@ -451,6 +606,7 @@ SepSidInTokenEx(
     PTOKEN Token = (PTOKEN)_Token;
     PISID TokenSid, Sid = (PISID)_Sid;
     PSID_AND_ATTRIBUTES SidAndAttributes;
+    PSEP_SID_HASH SidHash;
     ULONG SidCount, SidLength;
     USHORT SidMetadata;
     PAGED_CODE();
@@ -468,12 +624,14 @@ SepSidInTokenEx(
         /* Use the restricted SIDs and count */
         SidAndAttributes = Token->RestrictedSids;
         SidCount = Token->RestrictedSidCount;
+        SidHash = Token->RestrictedSidsHash;
     }
     else
     {
         /* Use the normal SIDs and count */
         SidAndAttributes = Token->UserAndGroups;
         SidCount = Token->UserAndGroupCount;
+        SidHash = Token->UserAndGroupsHash;
     }
 
     /* Do checks here by hand instead of the usual 4 function calls */
@@ -481,10 +639,19 @@ SepSidInTokenEx(
                              SubAuthority[Sid->SubAuthorityCount]);
     SidMetadata = *(PUSHORT)&Sid->Revision;
 
-    /* Loop every SID */
-    for (SidIndex = 0; SidIndex < SidCount; SidIndex++)
+    /* Only walk the SIDs of the same bucket if the token has a hash of them */
+    if (SidHash && (SidHash->SidCount != SidCount))
+        SidHash = NULL;
+
+    if (SidHash)
+        SidIndex = SidHash->Buckets[SepHashSid(Sid, SidHash->Shift)];
+    else
+        SidIndex = (SidCount > 0) ? 1 : 0;
+
+    /* Loop every candidate SID, the index is biased by one so that 0 ends the loop */
+    while (SidIndex != 0)
     {
-        TokenSid = (PISID)SidAndAttributes->Sid;
+        TokenSid = (PISID)SidAndAttributes[SidIndex - 1].Sid;
 #if SE_SID_DEBUG
         UNICODE_STRING sidString;
         RtlConvertSidToUnicodeString(&sidString, TokenSid, TRUE);
@@ -505,9 +672,9 @@ SepSidInTokenEx(
                  * and that it doesn't have SE_GROUP_USE_FOR_DENY_ONLY
                  * attribute.
                  */
-                if ((!Restricted && (SidIndex == 0) && !(SidAndAttributes->Attributes & SE_GROUP_USE_FOR_DENY_ONLY)) ||
-                    (SidAndAttributes->Attributes & SE_GROUP_ENABLED) ||
-                    ((Deny) && (SidAndAttributes->Attributes & SE_GROUP_USE_FOR_DENY_ONLY)))
+                if ((!Restricted && (SidIndex == 1) && !(SidAndAttributes[0].Attributes & SE_GROUP_USE_FOR_DENY_ONLY)) ||
+                    (SidAndAttributes[SidIndex - 1].Attributes & SE_GROUP_ENABLED) ||
+                    ((Deny) && (SidAndAttributes[SidIndex - 1].Attributes & SE_GROUP_USE_FOR_DENY_ONLY)))
                 {
                     /* SID is present */
                     return TRUE;
@@ -521,7 +688,10 @@ SepSidInTokenEx(
         }
 
         /* Move to the next SID */
-        SidAndAttributes++;
+        if (SidHash)
+            SidIndex = SidHash->Next[SidIndex - 1];
+        else
+            SidIndex = (SidIndex < SidCount) ? SidIndex + 1 : 0;
     }
 
     /* SID is not present */
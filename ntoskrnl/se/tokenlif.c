@@ -359,6 +359,9 @@ SepCreateToken(
         goto Quit;
     }
 
+    /* Index the user and groups for access checks */
+    SepBuildTokenSidHash(AccessToken);
+
     /*
      * Now allocate the token's dynamic information area
      * and set the data. The dynamic part consists of two
@@ -780,6 +783,9 @@ SepDuplicateToken(
         }
     }
 
+    /* Index the remaining user and groups and the restricted SIDs */
+    SepBuildTokenSidHash(AccessToken);
+
     /* Return the token to the caller */
     *NewAccessToken = AccessToken;
     Status = STATUS_SUCCESS;
@@ -1380,6 +1386,9 @@ SepPerformTokenFiltering(
         }
     }
 
+    /* Index the user and groups and the restricted SIDs */
+    SepBuildTokenSidHash(AccessToken);
+
     /* We've finally filtered the token, return it to the caller */
     *FilteredToken = AccessToken;
     Status = STATUS_SUCCESS;
@@ -228,6 +228,9 @@ typedef struct _LPCP_PORT_OBJECT
     ULONG MaxMessageLength;
     ULONG MaxConnectionInfoLength;
     ULONG Flags;
+#ifdef __REACTOS__
+    struct _LPCP_PORT_LOCK *Lock;
+#endif
     KEVENT WaitEvent;
 } LPCP_PORT_OBJECT, *PLPCP_PORT_OBJECT;
 
@@ -1253,6 +1253,9 @@ typedef struct _ETHREAD
     KSEMAPHORE AlpcWaitSemaphore;
     ULONG CacheManagerCount;
 #endif
+#ifdef __REACTOS__
+    PVOID LpcReplyChainPort;
+#endif
 } ETHREAD;
 
 //
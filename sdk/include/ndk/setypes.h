@@ -249,6 +249,10 @@ typedef struct _TOKEN
     HANDLE ProcessCid;                                /* 0xB4 */
     HANDLE ThreadCid;                                 /* 0xB8 */
     ULONG CreateMethod;                               /* 0xBC */
+#endif
+#ifdef __REACTOS__
+    struct _SEP_SID_HASH *UserAndGroupsHash;
+    struct _SEP_SID_HASH *RestrictedSidsHash;
 #endif
     ULONG VariablePart;                               /* 0xC0 */
 } TOKEN, *PTOKEN;
@@ -71,6 +71,9 @@ DWORD WINAPI AllocateAndGetUdpExTable2FromStack(PVOID*,BOOL,HANDLE,DWORD,DWORD,U
 
 #if (NTDDI_VERSION >= NTDDI_VISTA)
 #include <netioapi.h>
+#include <tcpestats.h>
+
+ULONG WINAPI GetPerTcpConnectionEStats(PMIB_TCPROW,TCP_ESTATS_TYPE,PUCHAR,ULONG,ULONG,PUCHAR,ULONG,ULONG,PUCHAR,ULONG,ULONG);
 #endif
 
 #ifdef __cplusplus
@@ -0,0 +1,185 @@
+/*
+ * PROJECT:     ReactOS PSDK
+ * LICENSE:     LGPL-2.1-or-later (https://spdx.org/licenses/LGPL-2.1-or-later)
+ * PURPOSE:     TCP extended statistics (GetPerTcpConnectionEStats)
+ */
+
+#ifndef _TCPESTATS_
+#define _TCPESTATS_
+
+typedef enum
+{
+    TcpConnectionEstatsSynOpts,
+    TcpConnectionEstatsData,
+    TcpConnectionEstatsSndCong,
+    TcpConnectionEstatsPath,
+    TcpConnectionEstatsSendBuff,
+    TcpConnectionEstatsRec,
+    TcpConnectionEstatsObsRec,
+    TcpConnectionEstatsBandwidth,
+    TcpConnectionEstatsFineRtt,
+    TcpConnectionEstatsMaximum,
+} TCP_ESTATS_TYPE, *PTCP_ESTATS_TYPE;
+
+typedef enum
+{
+    TcpBoolOptDisabled = 0,
+    TcpBoolOptEnabled,
+    TcpBoolOptUnchanged = -1
+} TCP_BOOLEAN_OPTIONAL, *PTCP_BOOLEAN_OPTIONAL;
+
+typedef struct _TCP_ESTATS_SYN_OPTS_ROS_v0
+{
+    BOOLEAN ActiveOpen;
+    ULONG MssRcvd;
+    ULONG MssSent;
+} TCP_ESTATS_SYN_OPTS_ROS_v0, *PTCP_ESTATS_SYN_OPTS_ROS_v0;
+
+typedef struct _TCP_ESTATS_DATA_ROD_v0
+{
+    ULONG64 DataBytesOut;
+    ULONG64 DataSegsOut;
+    ULONG64 DataBytesIn;
+    ULONG64 DataSegsIn;
+    ULONG64 SegsOut;
+    ULONG64 SegsIn;
+    ULONG SoftErrors;
+    ULONG SoftErrorReason;
+    ULONG SndUna;
+    ULONG SndNxt;
+    ULONG SndMax;
+    ULONG64 ThruBytesAcked;
+    ULONG RcvNxt;
+    ULONG64 ThruBytesReceived;
+} TCP_ESTATS_DATA_ROD_v0, *PTCP_ESTATS_DATA_ROD_v0;
+
+typedef struct _TCP_ESTATS_DATA_RW_v0
+{
+    BOOLEAN EnableCollection;
+} TCP_ESTATS_DATA_RW_v0, *PTCP_ESTATS_DATA_RW_v0;
+
+typedef struct _TCP_ESTATS_SND_CONG_ROD_v0
+{
+    ULONG SndLimTransRwin;
+    ULONG SndLimTimeRwin;
+    SIZE_T SndLimBytesRwin;
+    ULONG SndLimTransCwnd;
+    ULONG SndLimTimeCwnd;
+    SIZE_T SndLimBytesCwnd;
+    ULONG SndLimTransSnd;
+    ULONG SndLimTimeSnd;
+    SIZE_T SndLimBytesSnd;
+    ULONG SlowStart;
+    ULONG CongAvoid;
+    ULONG OtherReductions;
+    ULONG CurCwnd;
+    ULONG MaxSsCwnd;
+    ULONG MaxCaCwnd;
+    ULONG CurSsthresh;
+    ULONG MaxSsthresh;
+    ULONG MinSsthresh;
+} TCP_ESTATS_SND_CONG_ROD_v0, *PTCP_ESTATS_SND_CONG_ROD_v0;
+
+typedef struct _TCP_ESTATS_SND_CONG_RW_v0
+{
+    BOOLEAN EnableCollection;
+} TCP_ESTATS_SND_CONG_RW_v0, *PTCP_ESTATS_SND_CONG_RW_v0;
+
+typedef struct _TCP_ESTATS_PATH_ROD_v0
+{
+    ULONG FastRetran;
+    ULONG Timeouts;
+    ULONG SubsequentTimeouts;
+    ULONG CurTimeoutCount;
+    ULONG AbruptTimeouts;
+    ULONG PktsRetrans;
+    ULONG BytesRetrans;
+    ULONG DupAcksIn;
+    ULONG SacksRcvd;
+    ULONG SackBlocksRcvd;
+    ULONG CongSignals;
+    ULONG PreCongSumCwnd;
+    ULONG PreCongSumRtt;
+    ULONG PostCongSumRtt;
+    ULONG PostCongCountRtt;
+    ULONG EcnSignals;
+    ULONG EceRcvd;
+    ULONG SendStall;
+    ULONG QuenchRcvd;
+    ULONG RetranThresh;
+    ULONG SndDupAckEpisodes;
+    ULONG SumBytesReordered;
+    ULONG NonRecovDa;
+    ULONG NonRecovDaEpisodes;
+    ULONG AckAfterFr;
+    ULONG DsackDups;
+    ULONG SampleRtt;
+    ULONG SmoothedRtt;
+    ULONG RttVar;
+    ULONG MaxRtt;
+    ULONG MinRtt;
+    ULONG SumRtt;
+    ULONG CountRtt;
+    ULONG CurRto;
+    ULONG MaxRto;
+    ULONG MinRto;
+    ULONG CurMss;
+    ULONG MaxMss;
+    ULONG MinMss;
+    ULONG SpuriousRtoDetections;
+} TCP_ESTATS_PATH_ROD_v0, *PTCP_ESTATS_PATH_ROD_v0;
+
+typedef struct _TCP_ESTATS_PATH_RW_v0
+{
+    BOOLEAN EnableCollection;
+} TCP_ESTATS_PATH_RW_v0, *PTCP_ESTATS_PATH_RW_v0;
+
+typedef struct _TCP_ESTATS_REC_ROD_v0
+{
+    ULONG CurRwinSent;
+    ULONG MaxRwinSent;
+    ULONG MinRwinSent;
+    ULONG LimRwin;
+    ULONG DupAckEpisodes;
+    ULONG DupAcksOut;
+    ULONG CeRcvd;
+    ULONG EcnSent;
+    ULONG EcnNoncesRcvd;
+    ULONG CurReasmQueue;
+    ULONG MaxReasmQueue;
+    SIZE_T CurAppRQueue;
+    SIZE_T MaxAppRQueue;
+    UCHAR WinScaleSent;
+} TCP_ESTATS_REC_ROD_v0, *PTCP_ESTATS_REC_ROD_v0;
+
+typedef struct _TCP_ESTATS_REC_RW_v0
+{
+    BOOLEAN EnableCollection;
+} TCP_ESTATS_REC_RW_v0, *PTCP_ESTATS_REC_RW_v0;
+
+typedef struct _TCP_ESTATS_OBS_REC_ROD_v0
+{
+    ULONG CurRwinRcvd;
+    ULONG MaxRwinRcvd;
+    ULONG MinRwinRcvd;
+    UCHAR WinScaleRcvd;
+} TCP_ESTATS_OBS_REC_ROD_v0, *PTCP_ESTATS_OBS_REC_ROD_v0;
+
+typedef struct _TCP_ESTATS_OBS_REC_RW_v0
+{
+    BOOLEAN EnableCollection;
+} TCP_ESTATS_OBS_REC_RW_v0, *PTCP_ESTATS_OBS_REC_RW_v0;
+
+#ifdef __REACTOS__
+/* Returned by tcpip.sys for TCP_ESTATS_ENTRY_ID (see tcpioctl.h) */
+typedef struct _TCP_ESTATS_ENTRY
+{
+    TCP_ESTATS_DATA_ROD_v0 Data;
+    TCP_ESTATS_SND_CONG_ROD_v0 SndCong;
+    TCP_ESTATS_PATH_ROD_v0 Path;
+    TCP_ESTATS_REC_ROD_v0 Rec;
+    TCP_ESTATS_OBS_REC_ROD_v0 ObsRec;
+} TCP_ESTATS_ENTRY, *PTCP_ESTATS_ENTRY;
+#endif
+
+#endif /* _TCPESTATS_ */
@@ -57,6 +57,8 @@
 /* Non public TOIID used to query modules info */
 #ifdef __REACTOS__
 #define IP_SPECIFIC_MODULE_ENTRY_ID     0x110
+/* Non public TOIID used to query a TCP_ESTATS_ENTRY (see tcpestats.h) */
+#define TCP_ESTATS_ENTRY_ID             0x111
 #endif
 #define MAX_PHYSADDR_SIZE               8
 
@@ -102,6 +104,9 @@
 
 /* TCP connection options */
 #define TCP_SOCKET_NODELAY 1
+#define TCP_SOCKET_WINDOW  6
+/* ReactOS extension */
+#define TCP_SOCKET_SNDBUF  7
 
 typedef struct IFEntry
 {
@@ -116,6 +116,14 @@
 C_ASSERT((FAST486_CACHE_SIZE >= sizeof(ULONG))
          && (FAST486_CACHE_SIZE <= FAST486_PAGE_SIZE));
 
+/* The block cache checks the cached code against the prefetch */
+#ifdef FAST486_NO_PREFETCH
+#define FAST486_NO_BLOCK_CACHE
+#endif
+
+#define FAST486_BLOCK_CACHE_ENTRIES     1024
+#define FAST486_BLOCK_MAX_INSTRUCTIONS  16
+
 struct _FAST486_STATE;
 typedef struct _FAST486_STATE FAST486_STATE, *PFAST486_STATE;
 
@@ -459,6 +467,30 @@ typedef union _FAST486_FLAGS_REG
     };
 } FAST486_FLAGS_REG, *PFAST486_FLAGS_REG;
 
+typedef enum _FAST486_LAZY_OPERATION
+{
+    FAST486_LAZY_NONE,
+    FAST486_LAZY_ADD,
+    FAST486_LAZY_SUB,
+    FAST486_LAZY_LOGIC,
+    FAST486_LAZY_INC,
+    FAST486_LAZY_DEC
+} FAST486_LAZY_OPERATION, *PFAST486_LAZY_OPERATION;
+
+/*
+ * The last arithmetic or logical operation, whose CF, PF, AF, ZF, SF and OF
+ * have not been computed yet. They are only written to the flags register
+ * when an instruction needs them, and always before Fast486 returns.
+ */
+typedef struct _FAST486_LAZY_FLAGS
+{
+    FAST486_LAZY_OPERATION Operation;
+    ULONG FirstValue;
+    ULONG SecondValue;
+    ULONG Result;
+    ULONG SignFlag;
+} FAST486_LAZY_FLAGS, *PFAST486_LAZY_FLAGS;
+
 typedef struct _FAST486_FPU_DATA_REG
 {
     ULONGLONG Mantissa;
@@ -511,6 +543,39 @@ typedef union _FAST486_FPU_CONTROL_REG
     };
 } FAST486_FPU_CONTROL_REG, *PFAST486_FPU_CONTROL_REG;
 
+#ifndef FAST486_NO_BLOCK_CACHE
+
+typedef struct _FAST486_CACHED_INST
+{
+    ULONG OpcodePtr;
+    ULONG NextInstPtr;
+    UCHAR Opcode;
+    UCHAR PrefixFlags;
+    UCHAR SegmentOverride;
+} FAST486_CACHED_INST, *PFAST486_CACHED_INST;
+
+typedef struct _FAST486_BLOCK
+{
+    ULONG Generation;
+    ULONG Address;
+    ULONG InstPtr;
+    ULONG PagingState;
+    BOOLEAN Code32;
+    UCHAR Size;
+    UCHAR Count;
+    UCHAR Code[FAST486_CACHE_SIZE];
+    FAST486_CACHED_INST Instructions[FAST486_BLOCK_MAX_INSTRUCTIONS];
+} FAST486_BLOCK, *PFAST486_BLOCK;
+
+typedef struct _FAST486_BLOCK_CACHE
+{
+    ULONG Generation;
+    BOOLEAN CodeModified;
+    FAST486_BLOCK Blocks[FAST486_BLOCK_CACHE_ENTRIES];
+} FAST486_BLOCK_CACHE, *PFAST486_BLOCK_CACHE;
+
+#endif
+
 struct _FAST486_STATE
 {
     FAST486_MEM_READ_PROC MemReadCallback;
@@ -525,6 +590,7 @@ struct _FAST486_STATE
     FAST486_REG InstPtr, SavedInstPtr;
     FAST486_REG SavedStackPtr;
     FAST486_FLAGS_REG Flags;
+    FAST486_LAZY_FLAGS LazyFlags;
     FAST486_TABLE_REG Gdtr, Idtr;
     FAST486_LDT_REG Ldtr;
     FAST486_TASK_REG TaskReg;
@@ -544,6 +610,9 @@ struct _FAST486_STATE
     ULONG PrefetchAddress;
     UCHAR PrefetchCache[FAST486_CACHE_SIZE];
 #endif
+#ifndef FAST486_NO_BLOCK_CACHE
+    PFAST486_BLOCK_CACHE BlockCache;
+#endif
 #ifndef FAST486_NO_FPU
     FAST486_FPU_DATA_REG FpuRegisters[FAST486_NUM_FPU_REGS];
     FAST486_FPU_STATUS_REG FpuStatus;
@@ -586,6 +655,18 @@ VOID
 NTAPI
 Fast486StepOver(PFAST486_STATE State);
 
+#ifndef FAST486_NO_BLOCK_CACHE
+
+VOID
+NTAPI
+Fast486SetBlockCache(PFAST486_STATE State, PFAST486_BLOCK_CACHE BlockCache);
+
+ULONG
+NTAPI
+Fast486StepBlock(PFAST486_STATE State);
+
+#endif
+
 VOID
 NTAPI
 Fast486StepOut(PFAST486_STATE State);
@@ -33,6 +33,7 @@ typedef short __v16hi __attribute__ ((__vector_size__ (32)));
 typedef long long __v4di __attribute__ ((__vector_size__ (32)));
 
 typedef long long __m256i __attribute__((__vector_size__(32), __may_alias__));
+typedef long long __m256i_u __attribute__((__vector_size__(32), __may_alias__, __aligned__(1)));
 
 #endif /* _MSC_VER */
 
@@ -45,6 +46,13 @@ extern __m256i __cdecl _mm256_cmpeq_epi16(__m256i, __m256i);
 extern int __cdecl _mm256_movemask_epi8(__m256i);
 extern __m256i __cdecl _mm256_setzero_si256(void);
 extern void __cdecl _mm256_zeroupper(void);
+extern __m256i __cdecl _mm256_loadu_si256(__m256i const *);
+extern void __cdecl _mm256_storeu_si256(__m256i *, __m256i);
+extern __m256i __cdecl _mm256_and_si256(__m256i, __m256i);
+extern __m256i __cdecl _mm256_or_si256(__m256i, __m256i);
+extern __m256i __cdecl _mm256_xor_si256(__m256i, __m256i);
+
+extern unsigned __int64 __cdecl _xgetbv(unsigned int);
 
 extern int __cdecl _rdrand16_step(unsigned short *random_val);
 extern int __cdecl _rdrand32_step(unsigned int *random_val);
@@ -66,6 +74,13 @@ extern int __cdecl _rdseed64_step(unsigned __int64 *random_val);
 #pragma intrinsic(_mm256_movemask_epi8)
 #pragma intrinsic(_mm256_setzero_si256)
 #pragma intrinsic(_mm256_zeroupper)
+#pragma intrinsic(_mm256_loadu_si256)
+#pragma intrinsic(_mm256_storeu_si256)
+#pragma intrinsic(_mm256_and_si256)
+#pragma intrinsic(_mm256_or_si256)
+#pragma intrinsic(_mm256_xor_si256)
+
+#pragma intrinsic(_xgetbv)
 
 #pragma intrinsic(_rdrand16_step)
 #pragma intrinsic(_rdrand32_step)
@@ -118,6 +133,39 @@ __INTRIN_INLINE void __cdecl _mm256_zeroupper(void)
     __asm__ __volatile__("vzeroupper");
 }
 
+__INTRIN_INLINE_AVX __m256i __cdecl _mm256_loadu_si256(__m256i const *__P)
+{
+    return *(__m256i_u const *)__P;
+}
+
+__INTRIN_INLINE_AVX void __cdecl _mm256_storeu_si256(__m256i *__P, __m256i __A)
+{
+    *(__m256i_u *)__P = __A;
+}
+
+__INTRIN_INLINE_AVX2 __m256i __cdecl _mm256_and_si256(__m256i __A, __m256i __B)
+{
+    return __A & __B;
+}
+
+__INTRIN_INLINE_AVX2 __m256i __cdecl _mm256_or_si256(__m256i __A, __m256i __B)
+{
+    return __A | __B;
+}
+
+__INTRIN_INLINE_AVX2 __m256i __cdecl _mm256_xor_si256(__m256i __A, __m256i __B)
+{
+    return __A ^ __B;
+}
+
+__INTRIN_INLINE unsigned __int64 __cdecl _xgetbv(unsigned int __index)
+{
+    unsigned int __eax, __edx;
+    /* xgetbv, spelled out for older assemblers */
+    __asm__ __volatile__(".byte 0x0f, 0x01, 0xd0" : "=a"(__eax), "=d"(__edx) : "c"(__index));
+    return ((unsigned __int64)__edx << 32) | __eax;
+}
+
 __INTRIN_INLINE int _rdrand16_step(unsigned short* random_val)
 {
     unsigned char ok;
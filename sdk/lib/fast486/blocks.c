@@ -0,0 +1,355 @@
+/*
+ * Fast486 386/486 CPU Emulation Library
+ * blocks.c
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+/* INCLUDES *******************************************************************/
+
+#include <windef.h>
+
+// #define NDEBUG
+#include <debug.h>
+
+#include <fast486.h>
+#include "common.h"
+#include "opcodes.h"
+
+#ifndef FAST486_NO_BLOCK_CACHE
+
+/*
+ * A block is a run of instructions that lie in one prefetch window, recorded
+ * while the interpreter executes them. For each instruction it keeps the
+ * prefixes and the opcode, so running the block again skips the fetching and
+ * decoding of those. The operands are still fetched by the opcode handlers.
+ *
+ * The code bytes of a block are compared with the prefetch before it runs,
+ * so a block never runs code that changed since it was recorded. The block
+ * is left as soon as an instruction does not continue where it did when it
+ * was recorded.
+ */
+
+/* DEFINES ********************************************************************/
+
+#define BLOCK_CACHE_INDEX(Address) \
+    ((((Address) >> 10) ^ (Address)) & (FAST486_BLOCK_CACHE_ENTRIES - 1))
+
+/* PRIVATE FUNCTIONS **********************************************************/
+
+static inline
+BOOLEAN
+FASTCALL
+Fast486EndsBlock(UCHAR Opcode)
+{
+    /*
+     * Blocks end after control transfers and after the instructions that call
+     * the host (which may run the CPU recursively or change its memory) or
+     * change the interrupt flag.
+     */
+    switch (Opcode)
+    {
+        case 0x6C: case 0x6D: case 0x6E: case 0x6F: /* INS/OUTS */
+        case 0x70: case 0x71: case 0x72: case 0x73: /* Jcc */
+        case 0x74: case 0x75: case 0x76: case 0x77:
+        case 0x78: case 0x79: case 0x7A: case 0x7B:
+        case 0x7C: case 0x7D: case 0x7E: case 0x7F:
+        case 0x9A:                                  /* CALL FAR */
+        case 0x9D:                                  /* POPF */
+        case 0xC2: case 0xC3: case 0xCA: case 0xCB: /* RET */
+        case 0xC4:                                  /* LES/BOP */
+        case 0xCC: case 0xCD: case 0xCE: case 0xCF: /* INT/IRET */
+        case 0xE0: case 0xE1: case 0xE2: case 0xE3: /* LOOP/JCXZ */
+        case 0xE4: case 0xE5: case 0xE6: case 0xE7: /* IN/OUT */
+        case 0xE8: case 0xE9: case 0xEA: case 0xEB: /* CALL/JMP */
+        case 0xEC: case 0xED: case 0xEE: case 0xEF: /* IN/OUT */
+        case 0xF4:                                  /* HLT */
+        case 0xFA: case 0xFB:                       /* CLI/STI */
+            return TRUE;
+
+        default:
+            return FALSE;
+    }
+}
+
+static inline
+BOOLEAN
+FASTCALL
+Fast486PrefetchHolds(PFAST486_STATE State, ULONG Address, ULONG Size)
+{
+    return State->PrefetchValid
+           && (Address >= State->PrefetchAddress)
+           && ((Address + Size) <= (State->PrefetchAddress + FAST486_CACHE_SIZE));
+}
+
+static inline
+ULONG
+FASTCALL
+Fast486GetPagingState(PFAST486_STATE State)
+{
+    return (State->ControlRegisters[FAST486_REG_CR0] & FAST486_CR0_PG)
+           ? State->ControlRegisters[FAST486_REG_CR3] : 0;
+}
+
+static inline
+BOOLEAN
+FASTCALL
+Fast486StaysInBlock(PFAST486_STATE State, ULONG CodeBase, ULONG Generation)
+{
+    return (State->SegmentRegs[FAST486_REG_CS].Base == CodeBase)
+           && State->PrefetchValid
+           && !State->Halted
+           && !State->Flags.Tf
+           && !State->BlockCache->CodeModified
+           && (State->BlockCache->Generation == Generation);
+}
+
+static
+ULONG
+FASTCALL
+Fast486RunBlock(PFAST486_STATE State, PFAST486_BLOCK Block)
+{
+    PFAST486_BLOCK_CACHE BlockCache = State->BlockCache;
+    PFAST486_CACHED_INST Inst = Block->Instructions;
+    ULONG CodeBase = State->SegmentRegs[FAST486_REG_CS].Base;
+    ULONG Generation = BlockCache->Generation;
+    ULONG Count = Block->Count;
+    ULONG i;
+
+    BlockCache->CodeModified = FALSE;
+
+    for (i = 0; i < Count; i++, Inst++)
+    {
+        State->SavedInstPtr = State->InstPtr;
+        State->SavedStackPtr = State->GeneralRegs[FAST486_REG_ESP];
+
+        /* Resume right after the opcode, with the prefixes already applied */
+        State->PrefixFlags = Inst->PrefixFlags;
+        State->SegmentOverride = Inst->SegmentOverride;
+        State->InstPtr.Long = Inst->OpcodePtr;
+
+        /* Compute the flags of the last operation if the opcode needs them */
+        if (!Fast486OpcodeKeepsLazyFlags[Inst->Opcode]) Fast486MaterializeFlags(State);
+
+        /* Call the opcode handler */
+        Fast486OpcodeHandlers[Inst->Opcode](State, Inst->Opcode);
+        State->PrefixFlags = 0;
+
+        /* Check for interrupts between the instructions */
+        Fast486CheckInterrupts(State, FALSE);
+
+        if ((State->InstPtr.Long != Inst->NextInstPtr)
+            || !Fast486StaysInBlock(State, CodeBase, Generation))
+        {
+            /* Continue in the interpreter or in another block */
+            return i + 1;
+        }
+    }
+
+    return Count;
+}
+
+static
+ULONG
+FASTCALL
+Fast486RecordBlock(PFAST486_STATE State, PFAST486_BLOCK CacheEntry)
+{
+    PFAST486_BLOCK_CACHE BlockCache = State->BlockCache;
+    PFAST486_SEG_REG CodeSegment = &State->SegmentRegs[FAST486_REG_CS];
+    FAST486_OPCODE_HANDLER_PROC CurrentHandler;
+    PFAST486_CACHED_INST Inst;
+    FAST486_BLOCK Block;
+    ULONG CodeBase = CodeSegment->Base;
+    ULONG Generation = BlockCache->Generation;
+    ULONG OpcodeEnd, Count = 0;
+    UCHAR Opcode;
+
+    /*
+     * The block is recorded on the stack and only goes to the cache when it is
+     * complete, since the opcode handlers may run the CPU recursively.
+     */
+    Block.Address = CodeBase + (CodeSegment->Size ? State->InstPtr.Long
+                                                  : State->InstPtr.LowWord);
+    Block.InstPtr = State->InstPtr.Long;
+    Block.PagingState = Fast486GetPagingState(State);
+    Block.Code32 = CodeSegment->Size;
+    Block.Size = 0;
+    Block.Count = 0;
+
+    BlockCache->CodeModified = FALSE;
+
+    while (TRUE)
+    {
+        Inst = &Block.Instructions[Block.Count];
+
+        State->SavedInstPtr = State->InstPtr;
+        State->SavedStackPtr = State->GeneralRegs[FAST486_REG_ESP];
+
+        /* Fetch the prefixes and the opcode */
+        while (TRUE)
+        {
+            if (!Fast486FetchByte(State, &Opcode))
+            {
+                /* Exception occurred */
+                State->PrefixFlags = 0;
+                Count++;
+                goto Done;
+            }
+
+            CurrentHandler = Fast486OpcodeHandlers[Opcode];
+            if (CurrentHandler != Fast486OpcodePrefix) break;
+
+            CurrentHandler(State, Opcode);
+        }
+
+        /* The prefixes and the opcode must come from the code of the block */
+        OpcodeEnd = CodeBase + (CodeSegment->Size ? State->InstPtr.Long
+                                                  : State->InstPtr.LowWord);
+        if ((OpcodeEnd <= Block.Address)
+            || !Fast486PrefetchHolds(State, Block.Address, OpcodeEnd - Block.Address))
+        {
+            /* Execute it, but end the block before it */
+            if (!Fast486OpcodeKeepsLazyFlags[Opcode]) Fast486MaterializeFlags(State);
+            CurrentHandler(State, Opcode);
+            State->PrefixFlags = 0;
+            Fast486CheckInterrupts(State, FALSE);
+            Count++;
+            break;
+        }
+
+        Inst->OpcodePtr = State->InstPtr.Long;
+        Inst->Opcode = Opcode;
+        Inst->PrefixFlags = (UCHAR)State->PrefixFlags;
+        Inst->SegmentOverride = (UCHAR)State->SegmentOverride;
+
+        Block.Size = (UCHAR)(OpcodeEnd - Block.Address);
+        RtlCopyMemory(Block.Code,
+                      &State->PrefetchCache[Block.Address - State->PrefetchAddress],
+                      Block.Size);
+
+        /* Compute the flags of the last operation if the opcode needs them */
+        if (!Fast486OpcodeKeepsLazyFlags[Opcode]) Fast486MaterializeFlags(State);
+
+        /* Call the opcode handler */
+        CurrentHandler(State, Opcode);
+        State->PrefixFlags = 0;
+        Count++;
+
+        Inst->NextInstPtr = State->InstPtr.Long;
+        Block.Count++;
+
+        /* Check for interrupts between the instructions */
+        Fast486CheckInterrupts(State, FALSE);
+
+        if (Fast486EndsBlock(Opcode)
+            || (Block.Count == FAST486_BLOCK_MAX_INSTRUCTIONS)
+            || (State->InstPtr.Long != Inst->NextInstPtr)
+            || !Fast486StaysInBlock(State, CodeBase, Generation))
+        {
+            break;
+        }
+    }
+
+Done:
+    if ((Block.Count > 0) && (BlockCache->Generation == Generation))
+    {
+        /* The block can be used from now on */
+        Block.Generation = Generation;
+        RtlCopyMemory(CacheEntry, &Block, sizeof(Block));
+    }
+
+    return Count;
+}
+
+/* PUBLIC FUNCTIONS ***********************************************************/
+
+VOID
+NTAPI
+Fast486SetBlockCache(PFAST486_STATE State, PFAST486_BLOCK_CACHE BlockCache)
+{
+    if (BlockCache)
+    {
+        /* Generation zero marks the unused entries */
+        RtlZeroMemory(BlockCache, sizeof(*BlockCache));
+        BlockCache->Generation = 1;
+    }
+
+    State->BlockCache = BlockCache;
+}
+
+ULONG
+NTAPI
+Fast486StepBlock(PFAST486_STATE State)
+{
+    PFAST486_BLOCK_CACHE BlockCache = State->BlockCache;
+    PFAST486_SEG_REG CodeSegment = &State->SegmentRegs[FAST486_REG_CS];
+    PFAST486_BLOCK Block;
+    ULONG Offset, Address, Count;
+    UCHAR Opcode;
+
+    if (!BlockCache || State->Halted || State->Flags.Tf || State->PrefixFlags)
+    {
+        /* Execute a single instruction */
+        Fast486StepInto(State);
+        return 1;
+    }
+
+    Offset = CodeSegment->Size ? State->InstPtr.Long : State->InstPtr.LowWord;
+    Address = CodeSegment->Base + Offset;
+    Block = &BlockCache->Blocks[BLOCK_CACHE_INDEX(Address)];
+
+    if ((Block->Generation == BlockCache->Generation)
+        && (Block->Address == Address)
+        && (Block->InstPtr == State->InstPtr.Long)
+        && (Block->Code32 == CodeSegment->Size)
+        && (Block->PagingState == Fast486GetPagingState(State)))
+    {
+        if (!Fast486PrefetchHolds(State, Address, Block->Size))
+        {
+            /* Prefetch the code of the block */
+            if (!Fast486ReadMemory(State,
+                                   FAST486_REG_CS,
+                                   Offset,
+                                   TRUE,
+                                   &Opcode,
+                                   sizeof(UCHAR)))
+            {
+                /* Exception occurred during instruction fetch */
+                return 1;
+            }
+        }
+
+        /* Check that the code did not change since the block was recorded */
+        if (Fast486PrefetchHolds(State, Address, Block->Size)
+            && (RtlCompareMemory(Block->Code,
+                                 &State->PrefetchCache[Address - State->PrefetchAddress],
+                                 Block->Size) == Block->Size))
+        {
+            Count = Fast486RunBlock(State, Block);
+            goto Done;
+        }
+    }
+
+    Count = Fast486RecordBlock(State, Block);
+
+Done:
+    /* The caller may read the flags */
+    Fast486MaterializeFlags(State);
+    return Count;
+}
+
+#endif
+
+/* EOF */
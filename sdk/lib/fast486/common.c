@@ -239,6 +239,11 @@ Fast486WriteMemory(PFAST486_STATE State,
         RtlMoveMemory(&State->PrefetchCache[LinearAddress - State->PrefetchAddress],
                       Buffer,
                       min(Size, FAST486_CACHE_SIZE + State->PrefetchAddress - LinearAddress));
+
+#ifndef FAST486_NO_BLOCK_CACHE
+        /* This may be the code of the block being executed */
+        if (State->BlockCache) State->BlockCache->CodeModified = TRUE;
+#endif
     }
 #endif
 
@@ -304,9 +309,13 @@ Fast486InterruptInternal(PFAST486_STATE State,
                        (IdtEntry->Type == FAST486_IDT_TRAP_GATE_32);
     USHORT OldCs = State->SegmentRegs[FAST486_REG_CS].Selector;
     ULONG OldEip = State->InstPtr.Long;
-    ULONG OldFlags = State->Flags.Long;
+    ULONG OldFlags;
     UCHAR OldCpl = State->Cpl;
 
+    /* Compute the flags of the last operation before pushing them */
+    Fast486MaterializeFlags(State);
+    OldFlags = State->Flags.Long;
+
     /* Check for protected mode */
     if (State->ControlRegisters[FAST486_REG_CR0] & FAST486_CR0_PE)
     {
@@ -803,6 +812,7 @@ Fast486TaskSwitch(PFAST486_STATE State, FAST486_TASK_SWITCH_TYPE Type, USHORT Se
     }
 
     /* Save the current task into the TSS */
+    Fast486MaterializeFlags(State);
     if (State->TaskReg.Modern)
     {
         OldTss.Cr3 = State->ControlRegisters[FAST486_REG_CR3];
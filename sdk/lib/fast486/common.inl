@@ -145,11 +145,27 @@ Fast486GetPageTableEntry(PFAST486_STATE State,
     return TableEntry.Value;
 }
 
+FORCEINLINE
+VOID
+FASTCALL
+Fast486FlushBlockCache(PFAST486_STATE State)
+{
+#ifndef FAST486_NO_BLOCK_CACHE
+    /* Blocks from an older generation are never used again */
+    if (State->BlockCache) State->BlockCache->Generation++;
+#else
+    UNREFERENCED_PARAMETER(State);
+#endif
+}
+
 FORCEINLINE
 VOID
 FASTCALL
 Fast486FlushTlb(PFAST486_STATE State)
 {
+    /* The cached blocks were decoded through the old mappings */
+    Fast486FlushBlockCache(State);
+
     if (!State->Tlb || State->TlbEmpty) return;
     RtlFillMemory(State->Tlb, NUM_TLB_ENTRIES * sizeof(ULONG), 0xFF);
     State->TlbEmpty = TRUE;
@@ -308,6 +324,38 @@ Fast486Exception(PFAST486_STATE State,
     Fast486ExceptionWithErrorCode(State, ExceptionCode, 0);
 }
 
+FORCEINLINE
+VOID
+FASTCALL
+Fast486CheckInterrupts(PFAST486_STATE State, BOOLEAN Trap)
+{
+    /*
+     * Check if there is an interrupt to execute, or a hardware interrupt signal
+     * while interrupts are enabled.
+     */
+    if (State->DoNotInterrupt)
+    {
+        /* Clear the interrupt delay flag */
+        State->DoNotInterrupt = FALSE;
+    }
+    else if (Trap && !State->Halted)
+    {
+        /* Perform the interrupt */
+        Fast486PerformInterrupt(State, FAST486_EXCEPTION_DB);
+    }
+    else if (State->Flags.If && State->IntSignaled)
+    {
+        /* No longer halted */
+        State->Halted = FALSE;
+
+        /* Acknowledge the interrupt and perform it */
+        Fast486PerformInterrupt(State, State->IntAckCallback(State));
+
+        /* Clear the interrupt status */
+        State->IntSignaled = FALSE;
+    }
+}
+
 FORCEINLINE
 BOOLEAN
 FASTCALL
@@ -1013,6 +1061,149 @@ Fast486CalculateParity(UCHAR Number)
     return (0x9669 >> ((Number & 0x0F) ^ (Number >> 4))) & 1;
 }
 
+FORCEINLINE
+BOOLEAN
+FASTCALL
+Fast486GetLazyCarry(PFAST486_STATE State)
+{
+    PFAST486_LAZY_FLAGS LazyFlags = &State->LazyFlags;
+
+    switch (LazyFlags->Operation)
+    {
+        case FAST486_LAZY_ADD:
+            return (LazyFlags->Result < LazyFlags->FirstValue)
+                   && (LazyFlags->Result < LazyFlags->SecondValue);
+
+        case FAST486_LAZY_SUB:
+            return (LazyFlags->FirstValue < LazyFlags->SecondValue);
+
+        case FAST486_LAZY_LOGIC:
+            return FALSE;
+
+        default:
+            /* INC and DEC don't change CF */
+            return State->Flags.Cf;
+    }
+}
+
+FORCEINLINE
+BOOLEAN
+FASTCALL
+Fast486GetLazyAuxCarry(PFAST486_STATE State)
+{
+    PFAST486_LAZY_FLAGS LazyFlags = &State->LazyFlags;
+
+    switch (LazyFlags->Operation)
+    {
+        case FAST486_LAZY_ADD:
+            return ((((LazyFlags->FirstValue & 0x0F)
+                      + (LazyFlags->SecondValue & 0x0F)) & 0x10) != 0);
+
+        case FAST486_LAZY_SUB:
+            return (LazyFlags->FirstValue & 0x0F) < (LazyFlags->SecondValue & 0x0F);
+
+        case FAST486_LAZY_INC:
+            return ((LazyFlags->Result & 0x0F) == 0);
+
+        case FAST486_LAZY_DEC:
+            return ((LazyFlags->Result & 0x0F) == 0x0F);
+
+        default:
+            /* The logical operations don't change AF */
+            return State->Flags.Af;
+    }
+}
+
+FORCEINLINE
+VOID
+FASTCALL
+Fast486MaterializeFlags(PFAST486_STATE State)
+{
+    PFAST486_LAZY_FLAGS LazyFlags = &State->LazyFlags;
+    ULONG FirstValue = LazyFlags->FirstValue;
+    ULONG SecondValue = LazyFlags->SecondValue;
+    ULONG Result = LazyFlags->Result;
+    ULONG SignFlag = LazyFlags->SignFlag;
+
+    if (LazyFlags->Operation == FAST486_LAZY_NONE) return;
+
+    State->Flags.Cf = Fast486GetLazyCarry(State);
+    State->Flags.Af = Fast486GetLazyAuxCarry(State);
+
+    switch (LazyFlags->Operation)
+    {
+        case FAST486_LAZY_ADD:
+        {
+            State->Flags.Of = ((FirstValue & SignFlag) == (SecondValue & SignFlag))
+                              && ((FirstValue & SignFlag) != (Result & SignFlag));
+            break;
+        }
+
+        case FAST486_LAZY_SUB:
+        {
+            State->Flags.Of = ((FirstValue & SignFlag) != (SecondValue & SignFlag))
+                              && ((FirstValue & SignFlag) != (Result & SignFlag));
+            break;
+        }
+
+        case FAST486_LAZY_INC:
+        {
+            State->Flags.Of = (Result == SignFlag);
+            break;
+        }
+
+        case FAST486_LAZY_DEC:
+        {
+            State->Flags.Of = (Result == (SignFlag - 1));
+            break;
+        }
+
+        default:
+        {
+            State->Flags.Of = FALSE;
+            break;
+        }
+    }
+
+    State->Flags.Zf = (Result == 0);
+    State->Flags.Sf = ((Result & SignFlag) != 0);
+    State->Flags.Pf = Fast486CalculateParity(LOBYTE(Result));
+
+    LazyFlags->Operation = FAST486_LAZY_NONE;
+}
+
+FORCEINLINE
+VOID
+FASTCALL
+Fast486SetLazyFlags(PFAST486_STATE State,
+                    FAST486_LAZY_OPERATION Operation,
+                    ULONG FirstValue,
+                    ULONG SecondValue,
+                    ULONG Result,
+                    ULONG SignFlag)
+{
+    PFAST486_LAZY_FLAGS LazyFlags = &State->LazyFlags;
+
+    /*
+     * Only the additions and subtractions use the operands. Save the flags
+     * that the new operation keeps, as the previous operation left them.
+     */
+    if ((Operation == FAST486_LAZY_INC) || (Operation == FAST486_LAZY_DEC))
+    {
+        State->Flags.Cf = Fast486GetLazyCarry(State);
+    }
+    else if (Operation == FAST486_LAZY_LOGIC)
+    {
+        State->Flags.Af = Fast486GetLazyAuxCarry(State);
+    }
+
+    LazyFlags->Operation = Operation;
+    LazyFlags->FirstValue = FirstValue;
+    LazyFlags->SecondValue = SecondValue;
+    LazyFlags->Result = Result;
+    LazyFlags->SignFlag = SignFlag;
+}
+
 FORCEINLINE
 BOOLEAN
 FASTCALL
@@ -78,6 +78,9 @@ NextInst:
 
             // TODO: Check for CALL/RET to update ProcedureCallCount.
 
+            /* Compute the flags of the last operation if the opcode needs them */
+            if (!Fast486OpcodeKeepsLazyFlags[Opcode]) Fast486MaterializeFlags(State);
+
             /* Call the opcode handler */
             CurrentHandler = Fast486OpcodeHandlers[Opcode];
             CurrentHandler(State, Opcode);
@@ -89,35 +92,15 @@ NextInst:
             State->PrefixFlags = 0;
         }
 
-        /*
-         * Check if there is an interrupt to execute, or a hardware interrupt signal
-         * while interrupts are enabled.
-         */
-        if (State->DoNotInterrupt)
-        {
-            /* Clear the interrupt delay flag */
-            State->DoNotInterrupt = FALSE;
-        }
-        else if (Trap && !State->Halted)
-        {
-            /* Perform the interrupt */
-            Fast486PerformInterrupt(State, FAST486_EXCEPTION_DB);
-        }
-        else if (State->Flags.If && State->IntSignaled)
-        {
-            /* No longer halted */
-            State->Halted = FALSE;
-
-            /* Acknowledge the interrupt and perform it */
-            Fast486PerformInterrupt(State, State->IntAckCallback(State));
-
-            /* Clear the interrupt status */
-            State->IntSignaled = FALSE;
-        }
+        /* Check for interrupts between the instructions */
+        Fast486CheckInterrupts(State, Trap);
     }
     while ((Command == FAST486_CONTINUE) ||
            (Command == FAST486_STEP_OVER && ProcedureCallCount > 0) ||
            (Command == FAST486_STEP_OUT && ProcedureCallCount >= 0));
+
+    /* The caller may read the flags */
+    Fast486MaterializeFlags(State);
 }
 
 /* PUBLIC FUNCTIONS ***********************************************************/
@@ -126,6 +109,8 @@ VOID
 NTAPI
 Fast486DumpState(PFAST486_STATE State)
 {
+    Fast486MaterializeFlags(State);
+
     DbgPrint("\nFast486DumpState -->\n");
     DbgPrint("\nCPU currently executing in %s mode at %04X:%08X\n",
             (State->ControlRegisters[FAST486_REG_CR0] & FAST486_CR0_PE) ? "protected" : "real",
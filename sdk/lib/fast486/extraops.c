@@ -645,6 +645,11 @@ FAST486_OPCODE_HANDLER(Fast486ExtOpcodeLoadControlReg)
         /* Flush the TLB */
         Fast486FlushTlb(State);
     }
+    else
+    {
+        /* Mode changes invalidate the decoded blocks too */
+        Fast486FlushBlockCache(State);
+    }
 
     /* Load a value to the control register */
     State->ControlRegisters[ModRegRm.Register] = Value;
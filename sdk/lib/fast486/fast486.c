@@ -122,6 +122,11 @@ Fast486Initialize(PFAST486_STATE         State,
     /* Set the TLB (if given) */
     State->Tlb = Tlb;
 
+#ifndef FAST486_NO_BLOCK_CACHE
+    /* The block cache is set separately */
+    State->BlockCache = NULL;
+#endif
+
     /* Reset the CPU */
     Fast486Reset(State);
 }
@@ -141,6 +146,9 @@ Fast486Reset(PFAST486_STATE State)
     FAST486_INT_ACK_PROC   IntAckCallback   = State->IntAckCallback;
     FAST486_FPU_PROC       FpuCallback      = State->FpuCallback;
     PULONG                 Tlb              = State->Tlb;
+#ifndef FAST486_NO_BLOCK_CACHE
+    PFAST486_BLOCK_CACHE   BlockCache       = State->BlockCache;
+#endif
 
     /* Clear the entire structure */
     RtlZeroMemory(State, sizeof(*State));
@@ -195,6 +203,9 @@ Fast486Reset(PFAST486_STATE State)
     State->IntAckCallback   = IntAckCallback;
     State->FpuCallback      = FpuCallback;
     State->Tlb              = Tlb;
+#ifndef FAST486_NO_BLOCK_CACHE
+    State->BlockCache       = BlockCache;
+#endif
 
     /* Flush the TLB */
     Fast486FlushTlb(State);
@@ -296,6 +296,47 @@ Fast486OpcodeHandlers[FAST486_NUM_OPCODE_HANDLERS] =
     Fast486OpcodeGroupFF,               /* 0xFF */
 };
 
+/*
+ * The opcodes that neither read nor partly update CF, PF, AF, ZF, SF and OF.
+ * They run without computing the flags of the last arithmetic operation.
+ */
+BOOLEAN
+Fast486OpcodeKeepsLazyFlags[FAST486_NUM_OPCODE_HANDLERS] =
+{
+    TRUE,  TRUE,  TRUE,  TRUE,  TRUE,  TRUE,  TRUE,  TRUE,  /* 0x00 - 0x07 */
+    TRUE,  TRUE,  TRUE,  TRUE,  TRUE,  TRUE,  TRUE,  FALSE, /* 0x08 - 0x0F */
+    FALSE, FALSE, FALSE, FALSE, FALSE, FALSE, TRUE,  TRUE,  /* 0x10 - 0x17 */
+    FALSE, FALSE, FALSE, FALSE, FALSE, FALSE, TRUE,  TRUE,  /* 0x18 - 0x1F */
+    TRUE,  TRUE,  TRUE,  TRUE,  TRUE,  TRUE,  TRUE,  FALSE, /* 0x20 - 0x27 */
+    TRUE,  TRUE,  TRUE,  TRUE,  TRUE,  TRUE,  TRUE,  FALSE, /* 0x28 - 0x2F */
+    TRUE,  TRUE,  TRUE,  TRUE,  TRUE,  TRUE,  TRUE,  FALSE, /* 0x30 - 0x37 */
+    TRUE,  TRUE,  TRUE,  TRUE,  TRUE,  TRUE,  TRUE,  FALSE, /* 0x38 - 0x3F */
+    TRUE,  TRUE,  TRUE,  TRUE,  TRUE,  TRUE,  TRUE,  TRUE,  /* 0x40 - 0x47 */
+    TRUE,  TRUE,  TRUE,  TRUE,  TRUE,  TRUE,  TRUE,  TRUE,  /* 0x48 - 0x4F */
+    TRUE,  TRUE,  TRUE,  TRUE,  TRUE,  TRUE,  TRUE,  TRUE,  /* 0x50 - 0x57 */
+    TRUE,  TRUE,  TRUE,  TRUE,  TRUE,  TRUE,  TRUE,  TRUE,  /* 0x58 - 0x5F */
+    TRUE,  TRUE,  FALSE, FALSE, TRUE,  TRUE,  TRUE,  TRUE,  /* 0x60 - 0x67 */
+    TRUE,  FALSE, TRUE,  FALSE, FALSE, FALSE, FALSE, FALSE, /* 0x68 - 0x6F */
+    FALSE, FALSE, FALSE, FALSE, FALSE, FALSE, FALSE, FALSE, /* 0x70 - 0x77 */
+    FALSE, FALSE, FALSE, FALSE, FALSE, FALSE, FALSE, FALSE, /* 0x78 - 0x7F */
+    TRUE,  TRUE,  TRUE,  TRUE,  TRUE,  TRUE,  TRUE,  TRUE,  /* 0x80 - 0x87 */
+    TRUE,  TRUE,  TRUE,  TRUE,  TRUE,  TRUE,  TRUE,  TRUE,  /* 0x88 - 0x8F */
+    TRUE,  TRUE,  TRUE,  TRUE,  TRUE,  TRUE,  TRUE,  TRUE,  /* 0x90 - 0x97 */
+    TRUE,  TRUE,  FALSE, FALSE, FALSE, FALSE, FALSE, FALSE, /* 0x98 - 0x9F */
+    TRUE,  TRUE,  TRUE,  TRUE,  TRUE,  TRUE,  FALSE, FALSE, /* 0xA0 - 0xA7 */
+    TRUE,  TRUE,  TRUE,  TRUE,  TRUE,  TRUE,  FALSE, FALSE, /* 0xA8 - 0xAF */
+    TRUE,  TRUE,  TRUE,  TRUE,  TRUE,  TRUE,  TRUE,  TRUE,  /* 0xB0 - 0xB7 */
+    TRUE,  TRUE,  TRUE,  TRUE,  TRUE,  TRUE,  TRUE,  TRUE,  /* 0xB8 - 0xBF */
+    FALSE, FALSE, TRUE,  TRUE,  FALSE, FALSE, TRUE,  TRUE,  /* 0xC0 - 0xC7 */
+    TRUE,  TRUE,  FALSE, FALSE, FALSE, FALSE, FALSE, FALSE, /* 0xC8 - 0xCF */
+    FALSE, FALSE, FALSE, FALSE, FALSE, FALSE, FALSE, FALSE, /* 0xD0 - 0xD7 */
+    FALSE, FALSE, FALSE, FALSE, FALSE, FALSE, FALSE, FALSE, /* 0xD8 - 0xDF */
+    FALSE, FALSE, TRUE,  TRUE,  FALSE, FALSE, FALSE, FALSE, /* 0xE0 - 0xE7 */
+    TRUE,  TRUE,  FALSE, TRUE,  FALSE, FALSE, FALSE, FALSE, /* 0xE8 - 0xEF */
+    TRUE,  FALSE, TRUE,  TRUE,  FALSE, FALSE, FALSE, FALSE, /* 0xF0 - 0xF7 */
+    FALSE, FALSE, FALSE, FALSE, FALSE, FALSE, TRUE,  TRUE   /* 0xF8 - 0xFF */
+};
+
 /* PUBLIC FUNCTIONS ***********************************************************/
 
 FAST486_OPCODE_HANDLER(Fast486OpcodeInvalid)
@@ -423,20 +464,16 @@ FAST486_OPCODE_HANDLER(Fast486OpcodeIncrement)
     {
         Value = ++State->GeneralRegs[Opcode & 0x07].Long;
 
-        State->Flags.Of = (Value == SIGN_FLAG_LONG);
-        State->Flags.Sf = ((Value & SIGN_FLAG_LONG) != 0);
+        /* Update the flags */
+        Fast486SetLazyFlags(State, FAST486_LAZY_INC, 0, 0, Value, SIGN_FLAG_LONG);
     }
     else
     {
         Value = ++State->GeneralRegs[Opcode & 0x07].LowWord;
 
-        State->Flags.Of = (Value == SIGN_FLAG_WORD);
-        State->Flags.Sf = ((Value & SIGN_FLAG_WORD) != 0);
+        /* Update the flags */
+        Fast486SetLazyFlags(State, FAST486_LAZY_INC, 0, 0, Value, SIGN_FLAG_WORD);
     }
-
-    State->Flags.Zf = (Value == 0);
-    State->Flags.Af = ((Value & 0x0F) == 0);
-    State->Flags.Pf = Fast486CalculateParity(LOBYTE(Value));
 }
 
 FAST486_OPCODE_HANDLER(Fast486OpcodeDecrement)
@@ -454,20 +491,16 @@ FAST486_OPCODE_HANDLER(Fast486OpcodeDecrement)
     {
         Value = --State->GeneralRegs[Opcode & 0x07].Long;
 
-        State->Flags.Of = (Value == (SIGN_FLAG_LONG - 1));
-        State->Flags.Sf = ((Value & SIGN_FLAG_LONG) != 0);
+        /* Update the flags */
+        Fast486SetLazyFlags(State, FAST486_LAZY_DEC, 0, 0, Value, SIGN_FLAG_LONG);
     }
     else
     {
         Value = --State->GeneralRegs[Opcode & 0x07].LowWord;
 
-        State->Flags.Of = (Value == (SIGN_FLAG_WORD - 1));
-        State->Flags.Sf = ((Value & SIGN_FLAG_WORD) != 0);
+        /* Update the flags */
+        Fast486SetLazyFlags(State, FAST486_LAZY_DEC, 0, 0, Value, SIGN_FLAG_WORD);
     }
-
-    State->Flags.Zf = (Value == 0);
-    State->Flags.Af = ((Value & 0x0F) == 0x0F);
-    State->Flags.Pf = Fast486CalculateParity(LOBYTE(Value));
 }
 
 FAST486_OPCODE_HANDLER(Fast486OpcodePushReg)
@@ -1066,13 +1099,7 @@ FAST486_OPCODE_HANDLER(Fast486OpcodeAddByteModrm)
     Result = FirstValue + SecondValue;
 
     /* Update the flags */
-    State->Flags.Cf = (Result < FirstValue) && (Result < SecondValue);
-    State->Flags.Of = ((FirstValue & SIGN_FLAG_BYTE) == (SecondValue & SIGN_FLAG_BYTE))
-                      && ((FirstValue & SIGN_FLAG_BYTE) != (Result & SIGN_FLAG_BYTE));
-    State->Flags.Af = ((((FirstValue & 0x0F) + (SecondValue & 0x0F)) & 0x10) != 0);
-    State->Flags.Zf = (Result == 0);
-    State->Flags.Sf = ((Result & SIGN_FLAG_BYTE) != 0);
-    State->Flags.Pf = Fast486CalculateParity(Result);
+    Fast486SetLazyFlags(State, FAST486_LAZY_ADD, FirstValue, SecondValue, Result, SIGN_FLAG_BYTE);
 
     /* Write back the result */
     Fast486WriteModrmByteOperands(State,
@@ -1119,13 +1146,12 @@ FAST486_OPCODE_HANDLER(Fast486OpcodeAddModrm)
         Result = FirstValue + SecondValue;
 
         /* Update the flags */
-        State->Flags.Cf = (Result < FirstValue) && (Result < SecondValue);
-        State->Flags.Of = ((FirstValue & SIGN_FLAG_LONG) == (SecondValue & SIGN_FLAG_LONG))
-                          && ((FirstValue & SIGN_FLAG_LONG) != (Result & SIGN_FLAG_LONG));
-        State->Flags.Af = ((((FirstValue & 0x0F) + (SecondValue & 0x0F)) & 0x10) != 0);
-        State->Flags.Zf = (Result == 0);
-        State->Flags.Sf = ((Result & SIGN_FLAG_LONG) != 0);
-        State->Flags.Pf = Fast486CalculateParity(Result);
+        Fast486SetLazyFlags(State,
+                            FAST486_LAZY_ADD,
+                            FirstValue,
+                            SecondValue,
+                            Result,
+                            SIGN_FLAG_LONG);
 
         /* Write back the result */
         Fast486WriteModrmDwordOperands(State,
@@ -1150,13 +1176,12 @@ FAST486_OPCODE_HANDLER(Fast486OpcodeAddModrm)
         Result = FirstValue + SecondValue;
 
         /* Update the flags */
-        State->Flags.Cf = (Result < FirstValue) && (Result < SecondValue);
-        State->Flags.Of = ((FirstValue & SIGN_FLAG_WORD) == (SecondValue & SIGN_FLAG_WORD))
-                          && ((FirstValue & SIGN_FLAG_WORD) != (Result & SIGN_FLAG_WORD));
-        State->Flags.Af = ((((FirstValue & 0x0F) + (SecondValue & 0x0F)) & 0x10) != 0);
-        State->Flags.Zf = (Result == 0);
-        State->Flags.Sf = ((Result & SIGN_FLAG_WORD) != 0);
-        State->Flags.Pf = Fast486CalculateParity(Result);
+        Fast486SetLazyFlags(State,
+                            FAST486_LAZY_ADD,
+                            FirstValue,
+                            SecondValue,
+                            Result,
+                            SIGN_FLAG_WORD);
 
         /* Write back the result */
         Fast486WriteModrmWordOperands(State,
@@ -1186,13 +1211,7 @@ FAST486_OPCODE_HANDLER(Fast486OpcodeAddAl)
     Result = FirstValue + SecondValue;
 
     /* Update the flags */
-    State->Flags.Cf = (Result < FirstValue) && (Result < SecondValue);
-    State->Flags.Of = ((FirstValue & SIGN_FLAG_BYTE) == (SecondValue & SIGN_FLAG_BYTE))
-                      && ((FirstValue & SIGN_FLAG_BYTE) != (Result & SIGN_FLAG_BYTE));
-    State->Flags.Af = ((((FirstValue & 0x0F) + (SecondValue & 0x0F)) & 0x10) != 0);
-    State->Flags.Zf = (Result == 0);
-    State->Flags.Sf = ((Result & SIGN_FLAG_BYTE) != 0);
-    State->Flags.Pf = Fast486CalculateParity(Result);
+    Fast486SetLazyFlags(State, FAST486_LAZY_ADD, FirstValue, SecondValue, Result, SIGN_FLAG_BYTE);
 
     /* Write back the result */
     State->GeneralRegs[FAST486_REG_EAX].LowByte = Result;
@@ -1223,13 +1242,12 @@ FAST486_OPCODE_HANDLER(Fast486OpcodeAddEax)
         Result = FirstValue + SecondValue;
 
         /* Update the flags */
-        State->Flags.Cf = (Result < FirstValue) && (Result < SecondValue);
-        State->Flags.Of = ((FirstValue & SIGN_FLAG_LONG) == (SecondValue & SIGN_FLAG_LONG))
-                          && ((FirstValue & SIGN_FLAG_LONG) != (Result & SIGN_FLAG_LONG));
-        State->Flags.Af = ((((FirstValue & 0x0F) + (SecondValue & 0x0F)) & 0x10) != 0);
-        State->Flags.Zf = (Result == 0);
-        State->Flags.Sf = ((Result & SIGN_FLAG_LONG) != 0);
-        State->Flags.Pf = Fast486CalculateParity(Result);
+        Fast486SetLazyFlags(State,
+                            FAST486_LAZY_ADD,
+                            FirstValue,
+                            SecondValue,
+                            Result,
+                            SIGN_FLAG_LONG);
 
         /* Write back the result */
         State->GeneralRegs[FAST486_REG_EAX].Long = Result;
@@ -1249,13 +1267,12 @@ FAST486_OPCODE_HANDLER(Fast486OpcodeAddEax)
         Result = FirstValue + SecondValue;
 
         /* Update the flags */
-        State->Flags.Cf = (Result < FirstValue) && (Result < SecondValue);
-        State->Flags.Of = ((FirstValue & SIGN_FLAG_WORD) == (SecondValue & SIGN_FLAG_WORD))
-                          && ((FirstValue & SIGN_FLAG_WORD) != (Result & SIGN_FLAG_WORD));
-        State->Flags.Af = ((((FirstValue & 0x0F) + (SecondValue & 0x0F)) & 0x10) != 0);
-        State->Flags.Zf = (Result == 0);
-        State->Flags.Sf = ((Result & SIGN_FLAG_WORD) != 0);
-        State->Flags.Pf = Fast486CalculateParity(Result);
+        Fast486SetLazyFlags(State,
+                            FAST486_LAZY_ADD,
+                            FirstValue,
+                            SecondValue,
+                            Result,
+                            SIGN_FLAG_WORD);
 
         /* Write back the result */
         State->GeneralRegs[FAST486_REG_EAX].LowWord = Result;
@@ -1293,11 +1310,7 @@ FAST486_OPCODE_HANDLER(Fast486OpcodeOrByteModrm)
     Result = FirstValue | SecondValue;
 
     /* Update the flags */
-    State->Flags.Cf = FALSE;
-    State->Flags.Of = FALSE;
-    State->Flags.Zf = (Result == 0);
-    State->Flags.Sf = ((Result & SIGN_FLAG_BYTE) != 0);
-    State->Flags.Pf = Fast486CalculateParity(Result);
+    Fast486SetLazyFlags(State, FAST486_LAZY_LOGIC, FirstValue, SecondValue, Result, SIGN_FLAG_BYTE);
 
     /* Write back the result */
     Fast486WriteModrmByteOperands(State,
@@ -1344,11 +1357,12 @@ FAST486_OPCODE_HANDLER(Fast486OpcodeOrModrm)
         Result = FirstValue | SecondValue;
 
         /* Update the flags */
-        State->Flags.Cf = FALSE;
-        State->Flags.Of = FALSE;
-        State->Flags.Zf = (Result == 0);
-        State->Flags.Sf = ((Result & SIGN_FLAG_LONG) != 0);
-        State->Flags.Pf = Fast486CalculateParity(Result);
+        Fast486SetLazyFlags(State,
+                            FAST486_LAZY_LOGIC,
+                            FirstValue,
+                            SecondValue,
+                            Result,
+                            SIGN_FLAG_LONG);
 
         /* Write back the result */
         Fast486WriteModrmDwordOperands(State,
@@ -1373,11 +1387,12 @@ FAST486_OPCODE_HANDLER(Fast486OpcodeOrModrm)
         Result = FirstValue | SecondValue;
 
         /* Update the flags */
-        State->Flags.Cf = FALSE;
-        State->Flags.Of = FALSE;
-        State->Flags.Zf = (Result == 0);
-        State->Flags.Sf = ((Result & SIGN_FLAG_WORD) != 0);
-        State->Flags.Pf = Fast486CalculateParity(Result);
+        Fast486SetLazyFlags(State,
+                            FAST486_LAZY_LOGIC,
+                            FirstValue,
+                            SecondValue,
+                            Result,
+                            SIGN_FLAG_WORD);
 
         /* Write back the result */
         Fast486WriteModrmWordOperands(State,
@@ -1407,11 +1422,7 @@ FAST486_OPCODE_HANDLER(Fast486OpcodeOrAl)
     Result = FirstValue | SecondValue;
 
     /* Update the flags */
-    State->Flags.Cf = FALSE;
-    State->Flags.Of = FALSE;
-    State->Flags.Zf = (Result == 0);
-    State->Flags.Sf = ((Result & SIGN_FLAG_BYTE) != 0);
-    State->Flags.Pf = Fast486CalculateParity(Result);
+    Fast486SetLazyFlags(State, FAST486_LAZY_LOGIC, FirstValue, SecondValue, Result, SIGN_FLAG_BYTE);
 
     /* Write back the result */
     State->GeneralRegs[FAST486_REG_EAX].LowByte = Result;
@@ -1442,11 +1453,12 @@ FAST486_OPCODE_HANDLER(Fast486OpcodeOrEax)
         Result = FirstValue | SecondValue;
 
         /* Update the flags */
-        State->Flags.Cf = FALSE;
-        State->Flags.Of = FALSE;
-        State->Flags.Zf = (Result == 0);
-        State->Flags.Sf = ((Result & SIGN_FLAG_LONG) != 0);
-        State->Flags.Pf = Fast486CalculateParity(Result);
+        Fast486SetLazyFlags(State,
+                            FAST486_LAZY_LOGIC,
+                            FirstValue,
+                            SecondValue,
+                            Result,
+                            SIGN_FLAG_LONG);
 
         /* Write back the result */
         State->GeneralRegs[FAST486_REG_EAX].Long = Result;
@@ -1466,11 +1478,12 @@ FAST486_OPCODE_HANDLER(Fast486OpcodeOrEax)
         Result = FirstValue | SecondValue;
 
         /* Update the flags */
-        State->Flags.Cf = FALSE;
-        State->Flags.Of = FALSE;
-        State->Flags.Zf = (Result == 0);
-        State->Flags.Sf = ((Result & SIGN_FLAG_WORD) != 0);
-        State->Flags.Pf = Fast486CalculateParity(Result);
+        Fast486SetLazyFlags(State,
+                            FAST486_LAZY_LOGIC,
+                            FirstValue,
+                            SecondValue,
+                            Result,
+                            SIGN_FLAG_WORD);
 
         /* Write back the result */
         State->GeneralRegs[FAST486_REG_EAX].LowWord = Result;
@@ -1508,11 +1521,7 @@ FAST486_OPCODE_HANDLER(Fast486OpcodeAndByteModrm)
     Result = FirstValue & SecondValue;
 
     /* Update the flags */
-    State->Flags.Cf = FALSE;
-    State->Flags.Of = FALSE;
-    State->Flags.Zf = (Result == 0);
-    State->Flags.Sf = ((Result & SIGN_FLAG_BYTE) != 0);
-    State->Flags.Pf = Fast486CalculateParity(Result);
+    Fast486SetLazyFlags(State, FAST486_LAZY_LOGIC, FirstValue, SecondValue, Result, SIGN_FLAG_BYTE);
 
     /* Write back the result */
     Fast486WriteModrmByteOperands(State,
@@ -1559,11 +1568,12 @@ FAST486_OPCODE_HANDLER(Fast486OpcodeAndModrm)
         Result = FirstValue & SecondValue;
 
         /* Update the flags */
-        State->Flags.Cf = FALSE;
-        State->Flags.Of = FALSE;
-        State->Flags.Zf = (Result == 0);
-        State->Flags.Sf = ((Result & SIGN_FLAG_LONG) != 0);
-        State->Flags.Pf = Fast486CalculateParity(Result);
+        Fast486SetLazyFlags(State,
+                            FAST486_LAZY_LOGIC,
+                            FirstValue,
+                            SecondValue,
+                            Result,
+                            SIGN_FLAG_LONG);
 
         /* Write back the result */
         Fast486WriteModrmDwordOperands(State,
@@ -1588,11 +1598,12 @@ FAST486_OPCODE_HANDLER(Fast486OpcodeAndModrm)
         Result = FirstValue & SecondValue;
 
         /* Update the flags */
-        State->Flags.Cf = FALSE;
-        State->Flags.Of = FALSE;
-        State->Flags.Zf = (Result == 0);
-        State->Flags.Sf = ((Result & SIGN_FLAG_WORD) != 0);
-        State->Flags.Pf = Fast486CalculateParity(Result);
+        Fast486SetLazyFlags(State,
+                            FAST486_LAZY_LOGIC,
+                            FirstValue,
+                            SecondValue,
+                            Result,
+                            SIGN_FLAG_WORD);
 
         /* Write back the result */
         Fast486WriteModrmWordOperands(State,
@@ -1622,11 +1633,7 @@ FAST486_OPCODE_HANDLER(Fast486OpcodeAndAl)
     Result = FirstValue & SecondValue;
 
     /* Update the flags */
-    State->Flags.Cf = FALSE;
-    State->Flags.Of = FALSE;
-    State->Flags.Zf = (Result == 0);
-    State->Flags.Sf = ((Result & SIGN_FLAG_BYTE) != 0);
-    State->Flags.Pf = Fast486CalculateParity(Result);
+    Fast486SetLazyFlags(State, FAST486_LAZY_LOGIC, FirstValue, SecondValue, Result, SIGN_FLAG_BYTE);
 
     /* Write back the result */
     State->GeneralRegs[FAST486_REG_EAX].LowByte = Result;
@@ -1657,11 +1664,12 @@ FAST486_OPCODE_HANDLER(Fast486OpcodeAndEax)
         Result = FirstValue & SecondValue;
 
         /* Update the flags */
-        State->Flags.Cf = FALSE;
-        State->Flags.Of = FALSE;
-        State->Flags.Zf = (Result == 0);
-        State->Flags.Sf = ((Result & SIGN_FLAG_LONG) != 0);
-        State->Flags.Pf = Fast486CalculateParity(Result);
+        Fast486SetLazyFlags(State,
+                            FAST486_LAZY_LOGIC,
+                            FirstValue,
+                            SecondValue,
+                            Result,
+                            SIGN_FLAG_LONG);
 
         /* Write back the result */
         State->GeneralRegs[FAST486_REG_EAX].Long = Result;
@@ -1681,11 +1689,12 @@ FAST486_OPCODE_HANDLER(Fast486OpcodeAndEax)
         Result = FirstValue & SecondValue;
 
         /* Update the flags */
-        State->Flags.Cf = FALSE;
-        State->Flags.Of = FALSE;
-        State->Flags.Zf = (Result == 0);
-        State->Flags.Sf = ((Result & SIGN_FLAG_WORD) != 0);
-        State->Flags.Pf = Fast486CalculateParity(Result);
+        Fast486SetLazyFlags(State,
+                            FAST486_LAZY_LOGIC,
+                            FirstValue,
+                            SecondValue,
+                            Result,
+                            SIGN_FLAG_WORD);
 
         /* Write back the result */
         State->GeneralRegs[FAST486_REG_EAX].LowWord = Result;
@@ -1723,11 +1732,7 @@ FAST486_OPCODE_HANDLER(Fast486OpcodeXorByteModrm)
     Result = FirstValue ^ SecondValue;
 
     /* Update the flags */
-    State->Flags.Cf = FALSE;
-    State->Flags.Of = FALSE;
-    State->Flags.Zf = (Result == 0);
-    State->Flags.Sf = ((Result & SIGN_FLAG_BYTE) != 0);
-    State->Flags.Pf = Fast486CalculateParity(Result);
+    Fast486SetLazyFlags(State, FAST486_LAZY_LOGIC, FirstValue, SecondValue, Result, SIGN_FLAG_BYTE);
 
     /* Write back the result */
     Fast486WriteModrmByteOperands(State,
@@ -1774,11 +1779,12 @@ FAST486_OPCODE_HANDLER(Fast486OpcodeXorModrm)
         Result = FirstValue ^ SecondValue;
 
         /* Update the flags */
-        State->Flags.Cf = FALSE;
-        State->Flags.Of = FALSE;
-        State->Flags.Zf = (Result == 0);
-        State->Flags.Sf = ((Result & SIGN_FLAG_LONG) != 0);
-        State->Flags.Pf = Fast486CalculateParity(Result);
+        Fast486SetLazyFlags(State,
+                            FAST486_LAZY_LOGIC,
+                            FirstValue,
+                            SecondValue,
+                            Result,
+                            SIGN_FLAG_LONG);
 
         /* Write back the result */
         Fast486WriteModrmDwordOperands(State,
@@ -1803,11 +1809,12 @@ FAST486_OPCODE_HANDLER(Fast486OpcodeXorModrm)
         Result = FirstValue ^ SecondValue;
 
         /* Update the flags */
-        State->Flags.Cf = FALSE;
-        State->Flags.Of = FALSE;
-        State->Flags.Zf = (Result == 0);
-        State->Flags.Sf = ((Result & SIGN_FLAG_WORD) != 0);
-        State->Flags.Pf = Fast486CalculateParity(Result);
+        Fast486SetLazyFlags(State,
+                            FAST486_LAZY_LOGIC,
+                            FirstValue,
+                            SecondValue,
+                            Result,
+                            SIGN_FLAG_WORD);
 
         /* Write back the result */
         Fast486WriteModrmWordOperands(State,
@@ -1837,11 +1844,7 @@ FAST486_OPCODE_HANDLER(Fast486OpcodeXorAl)
     Result = FirstValue ^ SecondValue;
 
     /* Update the flags */
-    State->Flags.Cf = FALSE;
-    State->Flags.Of = FALSE;
-    State->Flags.Zf = (Result == 0);
-    State->Flags.Sf = ((Result & SIGN_FLAG_BYTE) != 0);
-    State->Flags.Pf = Fast486CalculateParity(Result);
+    Fast486SetLazyFlags(State, FAST486_LAZY_LOGIC, FirstValue, SecondValue, Result, SIGN_FLAG_BYTE);
 
     /* Write back the result */
     State->GeneralRegs[FAST486_REG_EAX].LowByte = Result;
@@ -1872,11 +1875,12 @@ FAST486_OPCODE_HANDLER(Fast486OpcodeXorEax)
         Result = FirstValue ^ SecondValue;
 
         /* Update the flags */
-        State->Flags.Cf = FALSE;
-        State->Flags.Of = FALSE;
-        State->Flags.Zf = (Result == 0);
-        State->Flags.Sf = ((Result & SIGN_FLAG_LONG) != 0);
-        State->Flags.Pf = Fast486CalculateParity(Result);
+        Fast486SetLazyFlags(State,
+                            FAST486_LAZY_LOGIC,
+                            FirstValue,
+                            SecondValue,
+                            Result,
+                            SIGN_FLAG_LONG);
 
         /* Write back the result */
         State->GeneralRegs[FAST486_REG_EAX].Long = Result;
@@ -1896,11 +1900,12 @@ FAST486_OPCODE_HANDLER(Fast486OpcodeXorEax)
         Result = FirstValue ^ SecondValue;
 
         /* Update the flags */
-        State->Flags.Cf = FALSE;
-        State->Flags.Of = FALSE;
-        State->Flags.Zf = (Result == 0);
-        State->Flags.Sf = ((Result & SIGN_FLAG_WORD) != 0);
-        State->Flags.Pf = Fast486CalculateParity(Result);
+        Fast486SetLazyFlags(State,
+                            FAST486_LAZY_LOGIC,
+                            FirstValue,
+                            SecondValue,
+                            Result,
+                            SIGN_FLAG_WORD);
 
         /* Write back the result */
         State->GeneralRegs[FAST486_REG_EAX].LowWord = Result;
@@ -1937,11 +1942,7 @@ FAST486_OPCODE_HANDLER(Fast486OpcodeTestByteModrm)
     Result = FirstValue & SecondValue;
 
     /* Update the flags */
-    State->Flags.Cf = FALSE;
-    State->Flags.Of = FALSE;
-    State->Flags.Zf = (Result == 0);
-    State->Flags.Sf = ((Result & SIGN_FLAG_BYTE) != 0);
-    State->Flags.Pf = Fast486CalculateParity(Result);
+    Fast486SetLazyFlags(State, FAST486_LAZY_LOGIC, FirstValue, SecondValue, Result, SIGN_FLAG_BYTE);
 }
 
 FAST486_OPCODE_HANDLER(Fast486OpcodeTestModrm)
@@ -1982,11 +1983,12 @@ FAST486_OPCODE_HANDLER(Fast486OpcodeTestModrm)
         Result = FirstValue & SecondValue;
 
         /* Update the flags */
-        State->Flags.Cf = FALSE;
-        State->Flags.Of = FALSE;
-        State->Flags.Zf = (Result == 0);
-        State->Flags.Sf = ((Result & SIGN_FLAG_LONG) != 0);
-        State->Flags.Pf = Fast486CalculateParity(Result);
+        Fast486SetLazyFlags(State,
+                            FAST486_LAZY_LOGIC,
+                            FirstValue,
+                            SecondValue,
+                            Result,
+                            SIGN_FLAG_LONG);
     }
     else
     {
@@ -2005,11 +2007,12 @@ FAST486_OPCODE_HANDLER(Fast486OpcodeTestModrm)
         Result = FirstValue & SecondValue;
 
         /* Update the flags */
-        State->Flags.Cf = FALSE;
-        State->Flags.Of = FALSE;
-        State->Flags.Zf = (Result == 0);
-        State->Flags.Sf = ((Result & SIGN_FLAG_WORD) != 0);
-        State->Flags.Pf = Fast486CalculateParity(Result);
+        Fast486SetLazyFlags(State,
+                            FAST486_LAZY_LOGIC,
+                            FirstValue,
+                            SecondValue,
+                            Result,
+                            SIGN_FLAG_WORD);
     }
 }
 
@@ -2033,11 +2036,7 @@ FAST486_OPCODE_HANDLER(Fast486OpcodeTestAl)
     Result = FirstValue & SecondValue;
 
     /* Update the flags */
-    State->Flags.Cf = FALSE;
-    State->Flags.Of = FALSE;
-    State->Flags.Zf = (Result == 0);
-    State->Flags.Sf = ((Result & SIGN_FLAG_BYTE) != 0);
-    State->Flags.Pf = Fast486CalculateParity(Result);
+    Fast486SetLazyFlags(State, FAST486_LAZY_LOGIC, FirstValue, SecondValue, Result, SIGN_FLAG_BYTE);
 }
 
 FAST486_OPCODE_HANDLER(Fast486OpcodeTestEax)
@@ -2065,11 +2064,12 @@ FAST486_OPCODE_HANDLER(Fast486OpcodeTestEax)
         Result = FirstValue & SecondValue;
 
         /* Update the flags */
-        State->Flags.Cf = FALSE;
-        State->Flags.Of = FALSE;
-        State->Flags.Zf = (Result == 0);
-        State->Flags.Sf = ((Result & SIGN_FLAG_LONG) != 0);
-        State->Flags.Pf = Fast486CalculateParity(Result);
+        Fast486SetLazyFlags(State,
+                            FAST486_LAZY_LOGIC,
+                            FirstValue,
+                            SecondValue,
+                            Result,
+                            SIGN_FLAG_LONG);
     }
     else
     {
@@ -2086,11 +2086,12 @@ FAST486_OPCODE_HANDLER(Fast486OpcodeTestEax)
         Result = FirstValue & SecondValue;
 
         /* Update the flags */
-        State->Flags.Cf = FALSE;
-        State->Flags.Of = FALSE;
-        State->Flags.Zf = (Result == 0);
-        State->Flags.Sf = ((Result & SIGN_FLAG_WORD) != 0);
-        State->Flags.Pf = Fast486CalculateParity(Result);
+        Fast486SetLazyFlags(State,
+                            FAST486_LAZY_LOGIC,
+                            FirstValue,
+                            SecondValue,
+                            Result,
+                            SIGN_FLAG_WORD);
     }
 }
 
@@ -2872,13 +2873,7 @@ FAST486_OPCODE_HANDLER(Fast486OpcodeCmpSubByteModrm)
     Result = FirstValue - SecondValue;
 
     /* Update the flags */
-    State->Flags.Cf = (FirstValue < SecondValue);
-    State->Flags.Of = ((FirstValue & SIGN_FLAG_BYTE) != (SecondValue & SIGN_FLAG_BYTE))
-                      && ((FirstValue & SIGN_FLAG_BYTE) != (Result & SIGN_FLAG_BYTE));
-    State->Flags.Af = (FirstValue & 0x0F) < (SecondValue & 0x0F);
-    State->Flags.Zf = (Result == 0);
-    State->Flags.Sf = ((Result & SIGN_FLAG_BYTE) != 0);
-    State->Flags.Pf = Fast486CalculateParity(Result);
+    Fast486SetLazyFlags(State, FAST486_LAZY_SUB, FirstValue, SecondValue, Result, SIGN_FLAG_BYTE);
 
     /* Check if this is not a CMP */
     if (!(Opcode & 0x10))
@@ -2936,13 +2931,12 @@ FAST486_OPCODE_HANDLER(Fast486OpcodeCmpSubModrm)
         Result = FirstValue - SecondValue;
 
         /* Update the flags */
-        State->Flags.Cf = (FirstValue < SecondValue);
-        State->Flags.Of = ((FirstValue & SIGN_FLAG_LONG) != (SecondValue & SIGN_FLAG_LONG))
-                          && ((FirstValue & SIGN_FLAG_LONG) != (Result & SIGN_FLAG_LONG));
-        State->Flags.Af = (FirstValue & 0x0F) < (SecondValue & 0x0F);
-        State->Flags.Zf = (Result == 0);
-        State->Flags.Sf = ((Result & SIGN_FLAG_LONG) != 0);
-        State->Flags.Pf = Fast486CalculateParity(Result);
+        Fast486SetLazyFlags(State,
+                            FAST486_LAZY_SUB,
+                            FirstValue,
+                            SecondValue,
+                            Result,
+                            SIGN_FLAG_LONG);
 
         /* Check if this is not a CMP */
         if (!(Opcode & 0x10))
@@ -2978,13 +2972,12 @@ FAST486_OPCODE_HANDLER(Fast486OpcodeCmpSubModrm)
         Result = FirstValue - SecondValue;
 
         /* Update the flags */
-        State->Flags.Cf = (FirstValue < SecondValue);
-        State->Flags.Of = ((FirstValue & SIGN_FLAG_WORD) != (SecondValue & SIGN_FLAG_WORD))
-                          && ((FirstValue & SIGN_FLAG_WORD) != (Result & SIGN_FLAG_WORD));
-        State->Flags.Af = (FirstValue & 0x0F) < (SecondValue & 0x0F);
-        State->Flags.Zf = (Result == 0);
-        State->Flags.Sf = ((Result & SIGN_FLAG_WORD) != 0);
-        State->Flags.Pf = Fast486CalculateParity(Result);
+        Fast486SetLazyFlags(State,
+                            FAST486_LAZY_SUB,
+                            FirstValue,
+                            SecondValue,
+                            Result,
+                            SIGN_FLAG_WORD);
 
         /* Check if this is not a CMP */
         if (!(Opcode & 0x10))
@@ -3018,13 +3011,7 @@ FAST486_OPCODE_HANDLER(Fast486OpcodeCmpSubAl)
     Result = FirstValue - SecondValue;
 
     /* Update the flags */
-    State->Flags.Cf = (FirstValue < SecondValue);
-    State->Flags.Of = ((FirstValue & SIGN_FLAG_BYTE) != (SecondValue & SIGN_FLAG_BYTE))
-                      && ((FirstValue & SIGN_FLAG_BYTE) != (Result & SIGN_FLAG_BYTE));
-    State->Flags.Af = (FirstValue & 0x0F) < (SecondValue & 0x0F);
-    State->Flags.Zf = (Result == 0);
-    State->Flags.Sf = ((Result & SIGN_FLAG_BYTE) != 0);
-    State->Flags.Pf = Fast486CalculateParity(Result);
+    Fast486SetLazyFlags(State, FAST486_LAZY_SUB, FirstValue, SecondValue, Result, SIGN_FLAG_BYTE);
 
     /* Check if this is not a CMP */
     if (!(Opcode & 0x10))
@@ -3059,13 +3046,12 @@ FAST486_OPCODE_HANDLER(Fast486OpcodeCmpSubEax)
         Result = FirstValue - SecondValue;
 
         /* Update the flags */
-        State->Flags.Cf = (FirstValue < SecondValue);
-        State->Flags.Of = ((FirstValue & SIGN_FLAG_LONG) != (SecondValue & SIGN_FLAG_LONG))
-                          && ((FirstValue & SIGN_FLAG_LONG) != (Result & SIGN_FLAG_LONG));
-        State->Flags.Af = (FirstValue & 0x0F) < (SecondValue & 0x0F);
-        State->Flags.Zf = (Result == 0);
-        State->Flags.Sf = ((Result & SIGN_FLAG_LONG) != 0);
-        State->Flags.Pf = Fast486CalculateParity(Result);
+        Fast486SetLazyFlags(State,
+                            FAST486_LAZY_SUB,
+                            FirstValue,
+                            SecondValue,
+                            Result,
+                            SIGN_FLAG_LONG);
 
         /* Check if this is not a CMP */
         if (!(Opcode & 0x10))
@@ -3089,13 +3075,12 @@ FAST486_OPCODE_HANDLER(Fast486OpcodeCmpSubEax)
         Result = FirstValue - SecondValue;
 
         /* Update the flags */
-        State->Flags.Cf = (FirstValue < SecondValue);
-        State->Flags.Of = ((FirstValue & SIGN_FLAG_WORD) != (SecondValue & SIGN_FLAG_WORD))
-                          && ((FirstValue & SIGN_FLAG_WORD) != (Result & SIGN_FLAG_WORD));
-        State->Flags.Af = (FirstValue & 0x0F) < (SecondValue & 0x0F);
-        State->Flags.Zf = (Result == 0);
-        State->Flags.Sf = ((Result & SIGN_FLAG_WORD) != 0);
-        State->Flags.Pf = Fast486CalculateParity(Result);
+        Fast486SetLazyFlags(State,
+                            FAST486_LAZY_SUB,
+                            FirstValue,
+                            SecondValue,
+                            Result,
+                            SIGN_FLAG_WORD);
 
         /* Check if this is not a CMP */
         if (!(Opcode & 0x10))
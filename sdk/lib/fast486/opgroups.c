@@ -56,13 +56,7 @@ Fast486ArithmeticOperation(PFAST486_STATE State,
         case 0:
         {
             Result = (FirstValue + SecondValue) & MaxValue;
-
-            /* Update CF, OF and AF */
-            State->Flags.Cf = (Result < FirstValue) && (Result < SecondValue);
-            State->Flags.Of = ((FirstValue & SignFlag) == (SecondValue & SignFlag))
-                              && ((FirstValue & SignFlag) != (Result & SignFlag));
-            State->Flags.Af = ((((FirstValue & 0x0F) + (SecondValue & 0x0F)) & 0x10) != 0);
-
+            Fast486SetLazyFlags(State, FAST486_LAZY_ADD, FirstValue, SecondValue, Result, SignFlag);
             break;
         }
 
@@ -70,14 +64,18 @@ Fast486ArithmeticOperation(PFAST486_STATE State,
         case 1:
         {
             Result = FirstValue | SecondValue;
-            State->Flags.Cf = State->Flags.Of = FALSE;
+            Fast486SetLazyFlags(State, FAST486_LAZY_LOGIC, FirstValue, SecondValue, Result, SignFlag);
             break;
         }
 
         /* ADC */
         case 2:
         {
-            INT Carry = State->Flags.Cf ? 1 : 0;
+            INT Carry;
+
+            /* Get the carry flag of the previous operation */
+            Fast486MaterializeFlags(State);
+            Carry = State->Flags.Cf ? 1 : 0;
 
             Result = (FirstValue + SecondValue + Carry) & MaxValue;
 
@@ -88,13 +86,22 @@ Fast486ArithmeticOperation(PFAST486_STATE State,
                               && ((FirstValue & SignFlag) != (Result & SignFlag));
             State->Flags.Af = ((FirstValue ^ SecondValue ^ Result) & 0x10) != 0;
 
+            /* Update ZF, SF and PF */
+            State->Flags.Zf = (Result == 0);
+            State->Flags.Sf = ((Result & SignFlag) != 0);
+            State->Flags.Pf = Fast486CalculateParity(LOBYTE(Result));
+
             break;
         }
 
         /* SBB */
         case 3:
         {
-            INT Carry = State->Flags.Cf ? 1 : 0;
+            INT Carry;
+
+            /* Get the carry flag of the previous operation */
+            Fast486MaterializeFlags(State);
+            Carry = State->Flags.Cf ? 1 : 0;
 
             Result = (FirstValue - SecondValue - Carry) & MaxValue;
 
@@ -106,6 +113,11 @@ Fast486ArithmeticOperation(PFAST486_STATE State,
                               && ((FirstValue & SignFlag) != (Result & SignFlag));
             State->Flags.Af = ((FirstValue ^ SecondValue ^ Result) & 0x10) != 0;
 
+            /* Update ZF, SF and PF */
+            State->Flags.Zf = (Result == 0);
+            State->Flags.Sf = ((Result & SignFlag) != 0);
+            State->Flags.Pf = Fast486CalculateParity(LOBYTE(Result));
+
             break;
         }
 
@@ -113,7 +125,7 @@ Fast486ArithmeticOperation(PFAST486_STATE State,
         case 4:
         {
             Result = FirstValue & SecondValue;
-            State->Flags.Cf = State->Flags.Of = FALSE;
+            Fast486SetLazyFlags(State, FAST486_LAZY_LOGIC, FirstValue, SecondValue, Result, SignFlag);
             break;
         }
 
@@ -122,13 +134,7 @@ Fast486ArithmeticOperation(PFAST486_STATE State,
         case 7:
         {
             Result = (FirstValue - SecondValue) & MaxValue;
-
-            /* Update CF, OF and AF */
-            State->Flags.Cf = (FirstValue < SecondValue);
-            State->Flags.Of = ((FirstValue & SignFlag) != (SecondValue & SignFlag))
-                              && ((FirstValue & SignFlag) != (Result & SignFlag));
-            State->Flags.Af = (FirstValue & 0x0F) < (SecondValue & 0x0F);
-
+            Fast486SetLazyFlags(State, FAST486_LAZY_SUB, FirstValue, SecondValue, Result, SignFlag);
             break;
         }
 
@@ -136,7 +142,7 @@ Fast486ArithmeticOperation(PFAST486_STATE State,
         case 6:
         {
             Result = FirstValue ^ SecondValue;
-            State->Flags.Cf = State->Flags.Of = FALSE;
+            Fast486SetLazyFlags(State, FAST486_LAZY_LOGIC, FirstValue, SecondValue, Result, SignFlag);
             break;
         }
 
@@ -144,14 +150,10 @@ Fast486ArithmeticOperation(PFAST486_STATE State,
         {
             /* Shouldn't happen */
             ASSERT(FALSE);
+            Result = 0;
         }
     }
 
-    /* Update ZF, SF and PF */
-    State->Flags.Zf = (Result == 0);
-    State->Flags.Sf = ((Result & SignFlag) != 0);
-    State->Flags.Pf = Fast486CalculateParity(LOBYTE(Result));
-
     /* Return the result */
     return Result;
 }
@@ -1358,24 +1360,17 @@ FAST486_OPCODE_HANDLER(Fast486OpcodeGroupFE)
 
     if (ModRegRm.Register == 0)
     {
-        /* Increment and update OF and AF */
+        /* Increment and update the flags */
         Value++;
-        State->Flags.Of = (Value == SIGN_FLAG_BYTE);
-        State->Flags.Af = ((Value & 0x0F) == 0);
+        Fast486SetLazyFlags(State, FAST486_LAZY_INC, 0, 0, Value, SIGN_FLAG_BYTE);
     }
     else
     {
-        /* Decrement and update OF and AF */
-        State->Flags.Of = (Value == SIGN_FLAG_BYTE);
+        /* Decrement and update the flags */
         Value--;
-        State->Flags.Af = ((Value & 0x0F) == 0x0F);
+        Fast486SetLazyFlags(State, FAST486_LAZY_DEC, 0, 0, Value, SIGN_FLAG_BYTE);
     }
 
-    /* Update flags */
-    State->Flags.Zf = (Value == 0);
-    State->Flags.Sf = ((Value & SIGN_FLAG_BYTE) != 0);
-    State->Flags.Pf = Fast486CalculateParity(Value);
-
     /* Write back the result */
     Fast486WriteModrmByteOperands(State, &ModRegRm, FALSE, Value);
 }
@@ -1416,17 +1411,15 @@ FAST486_OPCODE_HANDLER(Fast486OpcodeGroupFF)
 
         if (ModRegRm.Register == 0)
         {
-            /* Increment and update OF and AF */
+            /* Increment and update the flags */
             Value++;
-            State->Flags.Of = (Value == SIGN_FLAG_LONG);
-            State->Flags.Af = ((Value & 0x0F) == 0);
+            Fast486SetLazyFlags(State, FAST486_LAZY_INC, 0, 0, Value, SIGN_FLAG_LONG);
         }
         else if (ModRegRm.Register == 1)
         {
-            /* Decrement and update OF and AF */
-            State->Flags.Of = (Value == SIGN_FLAG_LONG);
+            /* Decrement and update the flags */
             Value--;
-            State->Flags.Af = ((Value & 0x0F) == 0x0F);
+            Fast486SetLazyFlags(State, FAST486_LAZY_DEC, 0, 0, Value, SIGN_FLAG_LONG);
         }
         else if (ModRegRm.Register == 2)
         {
@@ -1556,11 +1549,6 @@ FAST486_OPCODE_HANDLER(Fast486OpcodeGroupFF)
 
         if (ModRegRm.Register <= 1)
         {
-            /* Update flags */
-            State->Flags.Sf = ((Value & SIGN_FLAG_LONG) != 0);
-            State->Flags.Zf = (Value == 0);
-            State->Flags.Pf = Fast486CalculateParity(Value);
-
             /* Write back the result */
             Fast486WriteModrmDwordOperands(State, &ModRegRm, FALSE, Value);
         }
@@ -1577,17 +1565,15 @@ FAST486_OPCODE_HANDLER(Fast486OpcodeGroupFF)
 
         if (ModRegRm.Register == 0)
         {
-            /* Increment and update OF */
+            /* Increment and update the flags */
             Value++;
-            State->Flags.Of = (Value == SIGN_FLAG_WORD);
-            State->Flags.Af = ((Value & 0x0F) == 0);
+            Fast486SetLazyFlags(State, FAST486_LAZY_INC, 0, 0, Value, SIGN_FLAG_WORD);
         }
         else if (ModRegRm.Register == 1)
         {
-            /* Decrement and update OF */
-            State->Flags.Of = (Value == SIGN_FLAG_WORD);
+            /* Decrement and update the flags */
             Value--;
-            State->Flags.Af = ((Value & 0x0F) == 0x0F);
+            Fast486SetLazyFlags(State, FAST486_LAZY_DEC, 0, 0, Value, SIGN_FLAG_WORD);
         }
         else if (ModRegRm.Register == 2)
         {
@@ -1735,11 +1721,6 @@ FAST486_OPCODE_HANDLER(Fast486OpcodeGroupFF)
 
         if (ModRegRm.Register <= 1)
         {
-            /* Update flags */
-            State->Flags.Sf = ((Value & SIGN_FLAG_WORD) != 0);
-            State->Flags.Zf = (Value == 0);
-            State->Flags.Pf = Fast486CalculateParity(Value);
-
             /* Write back the result */
             Fast486WriteModrmWordOperands(State, &ModRegRm, FALSE, Value);
         }
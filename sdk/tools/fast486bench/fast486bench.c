@@ -0,0 +1,152 @@
+/*
+ * PROJECT:     ReactOS host tools
+ * LICENSE:     GPL-2.0-or-later (https://spdx.org/licenses/GPL-2.0-or-later)
+ * PURPOSE:     Compares the speed of the Fast486 interpreter and block cache
+ */
+
+#include <windef.h>
+#include <time.h>
+#include <fast486.h>
+
+#define MEMORY_SIZE     0x100000
+#define CODE_OFFSET     0x0100
+#define STACK_OFFSET    0xFFF0
+#define EXTRA_SEGMENT   0x2000
+
+/*
+ * Real mode instruction mix, run DX times 256 iterations of
+ * about 20 instructions. Built as a COM-like image at 0000:0100.
+ */
+static const UCHAR Workload[] =
+{
+    0xB9, 0x00, 0x01,       /* 00: mov cx, 0100h        */
+    0xB8, 0x34, 0x12,       /* 03: mov ax, 1234h        */
+    0x01, 0xD8,             /* 06: add ax, bx           */
+    0x43,                   /* 08: inc bx               */
+    0x25, 0xF0, 0x0F,       /* 09: and ax, 0FF0h        */
+    0x31, 0xC6,             /* 0C: xor si, ax           */
+    0x50,                   /* 0E: push ax              */
+    0x56,                   /* 0F: push si              */
+    0x5F,                   /* 10: pop di               */
+    0x58,                   /* 11: pop ax               */
+    0x26, 0x89, 0x05,       /* 12: mov es:[di], ax      */
+    0x66, 0x01, 0xD8,       /* 15: add eax, ebx         */
+    0xD1, 0xE0,             /* 18: shl ax, 1            */
+    0xE8, 0x0B, 0x00,       /* 1A: call 28h             */
+    0x39, 0xFE,             /* 1D: cmp si, di           */
+    0x75, 0x01,             /* 1F: jne 22h              */
+    0x45,                   /* 21: inc bp               */
+    0xE2, 0xDF,             /* 22: loop 03h             */
+    0x4A,                   /* 24: dec dx               */
+    0x75, 0xD9,             /* 25: jnz 00h              */
+    0xF4,                   /* 27: hlt                  */
+    0x83, 0xC7, 0x03,       /* 28: add di, 3            */
+    0x89, 0x3E, 0x00, 0x05, /* 2B: mov [0500h], di      */
+    0xC3,                   /* 2F: ret                  */
+};
+
+static UCHAR Memory[MEMORY_SIZE];
+static UCHAR SavedMemory[MEMORY_SIZE];
+static FAST486_BLOCK_CACHE BlockCache;
+
+static VOID FASTCALL
+ReadMemory(PFAST486_STATE State, ULONG Address, PVOID Buffer, ULONG Size)
+{
+    ULONG i;
+
+    for (i = 0; i < Size; i++)
+        ((PUCHAR)Buffer)[i] = Memory[(Address + i) & (MEMORY_SIZE - 1)];
+}
+
+static VOID FASTCALL
+WriteMemory(PFAST486_STATE State, ULONG Address, PVOID Buffer, ULONG Size)
+{
+    ULONG i;
+
+    for (i = 0; i < Size; i++)
+        Memory[(Address + i) & (MEMORY_SIZE - 1)] = ((PUCHAR)Buffer)[i];
+}
+
+static VOID
+Setup(PFAST486_STATE State, USHORT Iterations, BOOLEAN UseBlocks)
+{
+    memset(Memory, 0, sizeof(Memory));
+    memcpy(&Memory[CODE_OFFSET], Workload, sizeof(Workload));
+
+    Fast486Initialize(State, ReadMemory, WriteMemory, NULL, NULL, NULL, NULL, NULL, NULL);
+    Fast486SetBlockCache(State, UseBlocks ? &BlockCache : NULL);
+
+    Fast486ExecuteAt(State, 0x0000, CODE_OFFSET);
+    Fast486SetStack(State, 0x0000, STACK_OFFSET);
+    Fast486SetSegment(State, FAST486_REG_ES, EXTRA_SEGMENT);
+    State->GeneralRegs[FAST486_REG_EDX].LowWord = Iterations;
+}
+
+static double
+Run(PFAST486_STATE State, BOOLEAN UseBlocks, ULONGLONG *Instructions)
+{
+    clock_t Start = clock();
+    ULONGLONG Count = 0;
+
+    while (!State->Halted)
+    {
+        if (UseBlocks)
+        {
+            Count += Fast486StepBlock(State);
+        }
+        else
+        {
+            Fast486StepInto(State);
+            Count++;
+        }
+    }
+
+    *Instructions = Count;
+    return (double)(clock() - Start) / CLOCKS_PER_SEC;
+}
+
+static BOOLEAN
+SameState(PFAST486_STATE First, PFAST486_STATE Second)
+{
+    return !memcmp(First->GeneralRegs, Second->GeneralRegs, sizeof(First->GeneralRegs))
+           && (First->Flags.Long == Second->Flags.Long)
+           && (First->InstPtr.Long == Second->InstPtr.Long)
+           && !memcmp(Memory, SavedMemory, sizeof(Memory));
+}
+
+int main(int argc, char *argv[])
+{
+    static FAST486_STATE Interpreter, Blocks;
+    USHORT Iterations = (argc > 1) ? (USHORT)atoi(argv[1]) : 2000;
+    ULONGLONG InterpreterCount, BlockCount;
+    double InterpreterTime, BlockTime;
+
+    if (Iterations == 0)
+    {
+        printf("Usage: fast486bench [iterations]\n");
+        return 1;
+    }
+
+    Setup(&Interpreter, Iterations, FALSE);
+    InterpreterTime = Run(&Interpreter, FALSE, &InterpreterCount);
+    memcpy(SavedMemory, Memory, sizeof(Memory));
+
+    Setup(&Blocks, Iterations, TRUE);
+    BlockTime = Run(&Blocks, TRUE, &BlockCount);
+
+    printf("Interpreter: %llu instructions in %.3f s, %.1f MIPS\n",
+           (unsigned long long)InterpreterCount, InterpreterTime,
+           InterpreterCount / InterpreterTime / 1e6);
+    printf("Block cache: %llu instructions in %.3f s, %.1f MIPS\n",
+           (unsigned long long)BlockCount, BlockTime,
+           BlockCount / BlockTime / 1e6);
+
+    if ((InterpreterCount != BlockCount) || !SameState(&Interpreter, &Blocks))
+    {
+        printf("The final states differ!\n");
+        return 1;
+    }
+
+    printf("Speedup: %.2fx\n", InterpreterTime / BlockTime);
+    return 0;
+}
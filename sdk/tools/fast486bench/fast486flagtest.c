@@ -0,0 +1,519 @@
+/*
+ * PROJECT:     ReactOS host tools
+ * LICENSE:     GPL-2.0-or-later (https://spdx.org/licenses/GPL-2.0-or-later)
+ * PURPOSE:     Differential test of the Fast486 flags evaluation
+ */
+
+#include <windef.h>
+#include <fast486.h>
+
+#define MEMORY_SIZE     0x100000
+#define CODE_OFFSET     0x0100
+#define DATA_OFFSET     0x0600
+#define STACK_BOTTOM    0xF000
+#define STACK_OFFSET    0xFFF0
+
+#define SINGLE_RUNS     8192
+#define SEQUENCE_RUNS   8192
+#define SEQUENCE_LENGTH 48
+
+#define ARITH_FLAGS     0x08D5  /* CF PF AF ZF SF OF */
+
+typedef struct _TEST_INST
+{
+    const char *Name;
+    UCHAR Length;
+    UCHAR Code[6];
+    UCHAR ImmSize;
+} TEST_INST;
+
+/*
+ * Operands: AL/AX/EAX, BL/BX/EBX and the memory at DS:0600h. The
+ * immediates are random and follow the listed bytes.
+ */
+static const TEST_INST Instructions[] =
+{
+#define ALU(n, b) \
+    { n " al, bl",        2, { (b) + 0, 0xD8 }, 0 }, \
+    { n " ax, bx",        2, { (b) + 1, 0xD8 }, 0 }, \
+    { n " eax, ebx",      3, { 0x66, (b) + 1, 0xD8 }, 0 }, \
+    { n " al, bl (r)",    2, { (b) + 2, 0xC3 }, 0 }, \
+    { n " ax, bx (r)",    2, { (b) + 3, 0xC3 }, 0 }, \
+    { n " al, imm8",      1, { (b) + 4 }, 1 }, \
+    { n " ax, imm16",     1, { (b) + 5 }, 2 }, \
+    { n " eax, imm32",    2, { 0x66, (b) + 5 }, 4 }, \
+    { n " [mem], al",     4, { (b) + 0, 0x06, 0x00, 0x06 }, 0 }, \
+    { n " [mem], ax",     4, { (b) + 1, 0x06, 0x00, 0x06 }, 0 }, \
+    { n " ax, [mem]",     4, { (b) + 3, 0x06, 0x00, 0x06 }, 0 }, \
+    { n " al, imm8 (g)",  2, { 0x80, 0xC0 | (b) }, 1 }, \
+    { n " ax, imm16 (g)", 2, { 0x81, 0xC0 | (b) }, 2 }, \
+    { n " eax, imm32 (g)",3, { 0x66, 0x81, 0xC0 | (b) }, 4 }, \
+    { n " ax, simm8 (g)", 2, { 0x83, 0xC0 | (b) }, 1 }, \
+    { n " [mem], imm8",   4, { 0x80, 0x06 | (b), 0x00, 0x06 }, 1 }, \
+    { n " [mem], simm8",  4, { 0x83, 0x06 | (b), 0x00, 0x06 }, 1 }
+
+    ALU("add", 0x00),
+    ALU("or",  0x08),
+    ALU("adc", 0x10),
+    ALU("sbb", 0x18),
+    ALU("and", 0x20),
+    ALU("sub", 0x28),
+    ALU("xor", 0x30),
+    ALU("cmp", 0x38),
+#undef ALU
+
+    { "test al, bl",      2, { 0x84, 0xD8 }, 0 },
+    { "test ax, bx",      2, { 0x85, 0xD8 }, 0 },
+    { "test eax, ebx",    3, { 0x66, 0x85, 0xD8 }, 0 },
+    { "test [mem], ax",   4, { 0x85, 0x06, 0x00, 0x06 }, 0 },
+    { "test al, imm8",    1, { 0xA8 }, 1 },
+    { "test ax, imm16",   1, { 0xA9 }, 2 },
+    { "test eax, imm32",  2, { 0x66, 0xA9 }, 4 },
+    { "inc ax",           1, { 0x40 }, 0 },
+    { "inc bx",           1, { 0x43 }, 0 },
+    { "inc eax",          2, { 0x66, 0x40 }, 0 },
+    { "dec ax",           1, { 0x48 }, 0 },
+    { "dec bx",           1, { 0x4B }, 0 },
+    { "dec eax",          2, { 0x66, 0x48 }, 0 },
+    { "inc al",           2, { 0xFE, 0xC0 }, 0 },
+    { "dec al",           2, { 0xFE, 0xC8 }, 0 },
+    { "inc byte [mem]",   4, { 0xFE, 0x06, 0x00, 0x06 }, 0 },
+    { "dec byte [mem]",   4, { 0xFE, 0x0E, 0x00, 0x06 }, 0 },
+    { "inc ax (g)",       2, { 0xFF, 0xC0 }, 0 },
+    { "dec ax (g)",       2, { 0xFF, 0xC8 }, 0 },
+    { "inc eax (g)",      3, { 0x66, 0xFF, 0xC0 }, 0 },
+    { "dec eax (g)",      3, { 0x66, 0xFF, 0xC8 }, 0 },
+    { "inc word [mem]",   4, { 0xFF, 0x06, 0x00, 0x06 }, 0 },
+    { "dec word [mem]",   4, { 0xFF, 0x0E, 0x00, 0x06 }, 0 },
+    { "neg ax",           2, { 0xF7, 0xD8 }, 0 },
+    { "shl ax, 1",        2, { 0xD1, 0xE0 }, 0 },
+    { "rcl ax, 1",        2, { 0xD1, 0xD0 }, 0 },
+    { "daa",              1, { 0x27 }, 0 },
+    { "aaa",              1, { 0x37 }, 0 },
+    { "clc",              1, { 0xF8 }, 0 },
+    { "stc",              1, { 0xF9 }, 0 },
+    { "cmc",              1, { 0xF5 }, 0 },
+    { "lahf",             1, { 0x9F }, 0 },
+    { "sahf",             1, { 0x9E }, 0 },
+};
+
+/* Instructions that consume the flags, only used in the sequences */
+static const TEST_INST Consumers[] =
+{
+    { "jz",               3, { 0x74, 0x01, 0x41 }, 0 },
+    { "jc",               3, { 0x72, 0x01, 0x41 }, 0 },
+    { "jo",               3, { 0x70, 0x01, 0x42 }, 0 },
+    { "js",               3, { 0x78, 0x01, 0x42 }, 0 },
+    { "jp",               3, { 0x7A, 0x01, 0x41 }, 0 },
+    { "jbe",              3, { 0x76, 0x01, 0x42 }, 0 },
+    { "jl",               3, { 0x7C, 0x01, 0x41 }, 0 },
+    { "jg",               3, { 0x7F, 0x01, 0x42 }, 0 },
+    { "setz",             5, { 0x0F, 0x94, 0xC1, 0x01, 0xCE }, 0 },
+    { "setc",             5, { 0x0F, 0x92, 0xC1, 0x01, 0xCE }, 0 },
+    { "seto",             5, { 0x0F, 0x90, 0xC1, 0x01, 0xCE }, 0 },
+    { "setp",             5, { 0x0F, 0x9A, 0xC1, 0x01, 0xCE }, 0 },
+    { "pushf",            4, { 0x9C, 0x5F, 0x31, 0xFD }, 0 },
+    { "lahf",             3, { 0x9F, 0x31, 0xC5 }, 0 },
+};
+
+/*
+ * Results of the eager flags implementation, before the flags were evaluated
+ * lazily. One hash per instruction, then one for all the sequences.
+ */
+static const ULONG Expected[ARRAYSIZE(Instructions) + 1] =
+{
+    0x7767A5E9, /* add al, bl */
+    0x8F286B6D, /* add ax, bx */
+    0x10A15E99, /* add eax, ebx */
+    0xFDDB79E5, /* add al, bl (r) */
+    0xD0D6F2E6, /* add ax, bx (r) */
+    0xEDBB7362, /* add al, imm8 */
+    0x69F0D0CA, /* add ax, imm16 */
+    0xA007E8DD, /* add eax, imm32 */
+    0xF6FFE39D, /* add [mem], al */
+    0x0A0377C5, /* add [mem], ax */
+    0x58B4E70C, /* add ax, [mem] */
+    0x6AABE026, /* add al, imm8 (g) */
+    0x4CA51732, /* add ax, imm16 (g) */
+    0xEE49ACA3, /* add eax, imm32 (g) */
+    0x4FD91FB4, /* add ax, simm8 (g) */
+    0x2BF5B0C7, /* add [mem], imm8 */
+    0x11B7D6C8, /* add [mem], simm8 */
+    0xB9214AFF, /* or al, bl */
+    0xB5CEF279, /* or ax, bx */
+    0x0A5D072B, /* or eax, ebx */
+    0x92407BC6, /* or al, bl (r) */
+    0x0417D8A2, /* or ax, bx (r) */
+    0x523F270F, /* or al, imm8 */
+    0xE5597A9C, /* or ax, imm16 */
+    0x6E8EF54C, /* or eax, imm32 */
+    0x05DD50D5, /* or [mem], al */
+    0x8ED8655B, /* or [mem], ax */
+    0xA996A15B, /* or ax, [mem] */
+    0xC05E0E51, /* or al, imm8 (g) */
+    0xC2B06E61, /* or ax, imm16 (g) */
+    0x42698CFB, /* or eax, imm32 (g) */
+    0x208CCA5A, /* or ax, simm8 (g) */
+    0xDB40B9A7, /* or [mem], imm8 */
+    0x44430916, /* or [mem], simm8 */
+    0xC1B3B0A2, /* adc al, bl */
+    0x59C0099D, /* adc ax, bx */
+    0xFAD74603, /* adc eax, ebx */
+    0x108754B5, /* adc al, bl (r) */
+    0x378EB480, /* adc ax, bx (r) */
+    0x7A3144B4, /* adc al, imm8 */
+    0xA6D89229, /* adc ax, imm16 */
+    0x22CD09C6, /* adc eax, imm32 */
+    0xA607966F, /* adc [mem], al */
+    0xD78FFB2F, /* adc [mem], ax */
+    0x9ED688DB, /* adc ax, [mem] */
+    0x60EABDD8, /* adc al, imm8 (g) */
+    0x73394F5E, /* adc ax, imm16 (g) */
+    0xAF331064, /* adc eax, imm32 (g) */
+    0x528A70F4, /* adc ax, simm8 (g) */
+    0xE00FDC40, /* adc [mem], imm8 */
+    0x74D2ACF3, /* adc [mem], simm8 */
+    0x52995AB6, /* sbb al, bl */
+    0xC2A5B79F, /* sbb ax, bx */
+    0x0679BEEA, /* sbb eax, ebx */
+    0x23E0C6C5, /* sbb al, bl (r) */
+    0x0B730E25, /* sbb ax, bx (r) */
+    0x702AC062, /* sbb al, imm8 */
+    0xB79AFFAB, /* sbb ax, imm16 */
+    0xF86A2AAA, /* sbb eax, imm32 */
+    0x194936D3, /* sbb [mem], al */
+    0x655F9C6F, /* sbb [mem], ax */
+    0xA8F476E7, /* sbb ax, [mem] */
+    0x8824BEF6, /* sbb al, imm8 (g) */
+    0x16375DC3, /* sbb ax, imm16 (g) */
+    0x0C83C206, /* sbb eax, imm32 (g) */
+    0x75B2BADC, /* sbb ax, simm8 (g) */
+    0x3CAB3E01, /* sbb [mem], imm8 */
+    0xD30A12D8, /* sbb [mem], simm8 */
+    0x405B03F7, /* and al, bl */
+    0x2415A509, /* and ax, bx */
+    0xDCBCCAB8, /* and eax, ebx */
+    0xD8E695EC, /* and al, bl (r) */
+    0x274ED1C9, /* and ax, bx (r) */
+    0x2B472ECA, /* and al, imm8 */
+    0x11C1EC75, /* and ax, imm16 */
+    0x91DEC148, /* and eax, imm32 */
+    0x3327B1B6, /* and [mem], al */
+    0xA50FB55E, /* and [mem], ax */
+    0xA17769F5, /* and ax, [mem] */
+    0xE56D5C22, /* and al, imm8 (g) */
+    0x07FC129D, /* and ax, imm16 (g) */
+    0xA7C31AC5, /* and eax, imm32 (g) */
+    0xF9E07BC5, /* and ax, simm8 (g) */
+    0xBDF79079, /* and [mem], imm8 */
+    0xA039C629, /* and [mem], simm8 */
+    0x34402EEC, /* sub al, bl */
+    0x043530F8, /* sub ax, bx */
+    0xF56FB08F, /* sub eax, ebx */
+    0x861EC1AC, /* sub al, bl (r) */
+    0x2037EB0B, /* sub ax, bx (r) */
+    0xCB4FB788, /* sub al, imm8 */
+    0x83F3DEA1, /* sub ax, imm16 */
+    0xECD99684, /* sub eax, imm32 */
+    0x2DDF13D9, /* sub [mem], al */
+    0x93D9E708, /* sub [mem], ax */
+    0x2179F789, /* sub ax, [mem] */
+    0x96224B29, /* sub al, imm8 (g) */
+    0x5BD8AC08, /* sub ax, imm16 (g) */
+    0x13CDBF9D, /* sub eax, imm32 (g) */
+    0x0387BD9E, /* sub ax, simm8 (g) */
+    0xDEAAE848, /* sub [mem], imm8 */
+    0x3483B00D, /* sub [mem], simm8 */
+    0x2D204DD8, /* xor al, bl */
+    0x33D6D8D6, /* xor ax, bx */
+    0xC08801AD, /* xor eax, ebx */
+    0x191DBCFA, /* xor al, bl (r) */
+    0xA2DB1105, /* xor ax, bx (r) */
+    0x67D13F72, /* xor al, imm8 */
+    0x8C500914, /* xor ax, imm16 */
+    0xEDF169B9, /* xor eax, imm32 */
+    0x99A0C2DE, /* xor [mem], al */
+    0xA21FC6A8, /* xor [mem], ax */
+    0xA0804F44, /* xor ax, [mem] */
+    0xE3D9D8A9, /* xor al, imm8 (g) */
+    0x3CA1E8AF, /* xor ax, imm16 (g) */
+    0xADDC2282, /* xor eax, imm32 (g) */
+    0xF37C421F, /* xor ax, simm8 (g) */
+    0x94707143, /* xor [mem], imm8 */
+    0x4FED11FF, /* xor [mem], simm8 */
+    0x3BFBE118, /* cmp al, bl */
+    0x514B5CDB, /* cmp ax, bx */
+    0x62A7D266, /* cmp eax, ebx */
+    0x944D1C1C, /* cmp al, bl (r) */
+    0x88A06E0D, /* cmp ax, bx (r) */
+    0x180F3A99, /* cmp al, imm8 */
+    0x63F5230B, /* cmp ax, imm16 */
+    0x13D1AE43, /* cmp eax, imm32 */
+    0x8F6E4BFC, /* cmp [mem], al */
+    0x8D107275, /* cmp [mem], ax */
+    0x2891C11B, /* cmp ax, [mem] */
+    0xFDBA18A5, /* cmp al, imm8 (g) */
+    0xD90CA9AB, /* cmp ax, imm16 (g) */
+    0xE9B0D94B, /* cmp eax, imm32 (g) */
+    0x8EBE6B12, /* cmp ax, simm8 (g) */
+    0xFC83DB29, /* cmp [mem], imm8 */
+    0x3983E900, /* cmp [mem], simm8 */
+    0x793E3B62, /* test al, bl */
+    0xD9CAEDA9, /* test ax, bx */
+    0xB2675222, /* test eax, ebx */
+    0xE231513E, /* test [mem], ax */
+    0x66F944B1, /* test al, imm8 */
+    0xC3C9472E, /* test ax, imm16 */
+    0x75B618DA, /* test eax, imm32 */
+    0xB5BB122E, /* inc ax */
+    0x4E1FD75E, /* inc bx */
+    0xA53AAB77, /* inc eax */
+    0x72F1E656, /* dec ax */
+    0x9E5E92ED, /* dec bx */
+    0x851724CC, /* dec eax */
+    0xAE29EDB5, /* inc al */
+    0xF8A955D3, /* dec al */
+    0x25B7D871, /* inc byte [mem] */
+    0xA375135B, /* dec byte [mem] */
+    0x60A391FA, /* inc ax (g) */
+    0xDEC6D851, /* dec ax (g) */
+    0x7112E83C, /* inc eax (g) */
+    0x0C750EB0, /* dec eax (g) */
+    0xF8EE7068, /* inc word [mem] */
+    0x02E304A2, /* dec word [mem] */
+    0xA0E9E06E, /* neg ax */
+    0xC4D002DF, /* shl ax, 1 */
+    0x41B9489B, /* rcl ax, 1 */
+    0xCD547BA5, /* daa */
+    0xEFE617F6, /* aaa */
+    0xC86B1E68, /* clc */
+    0x92A4FC6C, /* stc */
+    0xB0B3417F, /* cmc */
+    0x551B0295, /* lahf */
+    0x31A99B99, /* sahf */
+    0x7CFB9C1A, /* sequences */
+};
+
+static UCHAR Memory[MEMORY_SIZE];
+static FAST486_BLOCK_CACHE BlockCache;
+static ULONG Seed = 0x12345678;
+
+static VOID FASTCALL
+ReadMemory(PFAST486_STATE State, ULONG Address, PVOID Buffer, ULONG Size)
+{
+    ULONG i;
+
+    for (i = 0; i < Size; i++)
+        ((PUCHAR)Buffer)[i] = Memory[(Address + i) & (MEMORY_SIZE - 1)];
+}
+
+static VOID FASTCALL
+WriteMemory(PFAST486_STATE State, ULONG Address, PVOID Buffer, ULONG Size)
+{
+    ULONG i;
+
+    for (i = 0; i < Size; i++)
+        Memory[(Address + i) & (MEMORY_SIZE - 1)] = ((PUCHAR)Buffer)[i];
+}
+
+static ULONG
+Random(VOID)
+{
+    Seed ^= Seed << 13;
+    Seed ^= Seed >> 17;
+    Seed ^= Seed << 5;
+    return Seed;
+}
+
+/* Random values, with a bias for the edge cases of the flags */
+static ULONG
+RandomValue(VOID)
+{
+    static const ULONG EdgeValues[] =
+    {
+        0x00000000, 0x00000001, 0x0000000F, 0x00000010, 0x0000007F,
+        0x00000080, 0x000000FF, 0x00007FFF, 0x00008000, 0x0000FFFF,
+        0x7FFFFFFF, 0x80000000, 0xFFFFFFFF, 0xFFFFFF80, 0xFFFF8000
+    };
+    ULONG Value = Random();
+
+    if ((Value & 3) == 0) return EdgeValues[(Value >> 8) % ARRAYSIZE(EdgeValues)];
+    return Random();
+}
+
+static ULONG
+Hash(ULONG Hash, ULONG Value)
+{
+    ULONG i;
+
+    /* FNV-1a */
+    for (i = 0; i < sizeof(Value); i++)
+    {
+        Hash ^= (Value >> (i * 8)) & 0xFF;
+        Hash *= 16777619;
+    }
+
+    return Hash;
+}
+
+static ULONG
+Emit(PUCHAR Code, const TEST_INST *Inst)
+{
+    ULONG i, Length = Inst->Length;
+
+    memcpy(Code, Inst->Code, Length);
+    for (i = 0; i < Inst->ImmSize; i++) Code[Length++] = (UCHAR)RandomValue();
+
+    return Length;
+}
+
+static VOID
+Setup(PFAST486_STATE State, BOOLEAN UseBlocks)
+{
+    Fast486Initialize(State, ReadMemory, WriteMemory, NULL, NULL, NULL, NULL, NULL, NULL);
+
+    /* Keep the blocks of the previous runs, they are checked before use */
+    if (UseBlocks) State->BlockCache = &BlockCache;
+
+    Fast486ExecuteAt(State, 0x0000, CODE_OFFSET);
+    Fast486SetStack(State, 0x0000, STACK_OFFSET);
+
+    State->GeneralRegs[FAST486_REG_EAX].Long = RandomValue();
+    State->GeneralRegs[FAST486_REG_EBX].Long = RandomValue();
+    State->Flags.Long = 0x0002 | (Random() & ARITH_FLAGS);
+    *(PULONG)&Memory[DATA_OFFSET] = RandomValue();
+}
+
+static VOID
+Run(PFAST486_STATE State, BOOLEAN UseBlocks)
+{
+    while (!State->Halted)
+    {
+        if (UseBlocks) Fast486StepBlock(State);
+        else Fast486StepInto(State);
+    }
+}
+
+static ULONG
+HashState(ULONG Value, PFAST486_STATE State)
+{
+    ULONG i;
+
+    for (i = 0; i < FAST486_NUM_GEN_REGS; i++)
+        Value = Hash(Value, State->GeneralRegs[i].Long);
+
+    Value = Hash(Value, State->Flags.Long);
+    Value = Hash(Value, *(PULONG)&Memory[DATA_OFFSET]);
+
+    for (i = STACK_BOTTOM; i < STACK_OFFSET; i += sizeof(ULONG))
+        Value = Hash(Value, *(PULONG)&Memory[i]);
+
+    return Value;
+}
+
+static ULONG
+TestInstruction(const TEST_INST *Inst)
+{
+    FAST486_STATE State;
+    ULONG Value = 2166136261U;
+    ULONG i, Length;
+
+    for (i = 0; i < SINGLE_RUNS; i++)
+    {
+        Length = Emit(&Memory[CODE_OFFSET], Inst);
+        Memory[CODE_OFFSET + Length] = 0xF4;
+
+        Setup(&State, FALSE);
+        Run(&State, FALSE);
+
+        Value = Hash(Value, State.GeneralRegs[FAST486_REG_EAX].Long);
+        Value = Hash(Value, State.GeneralRegs[FAST486_REG_EBX].Long);
+        Value = Hash(Value, State.Flags.Long);
+        Value = Hash(Value, *(PULONG)&Memory[DATA_OFFSET]);
+    }
+
+    return Value;
+}
+
+/*
+ * Runs random sequences of the instructions interleaved with flag consumers,
+ * once one instruction at a time and once in blocks, where the flags of one
+ * instruction are usually overwritten by the next one before being read.
+ */
+static ULONG
+TestSequences(PULONG Failures)
+{
+    static UCHAR SavedStack[STACK_OFFSET - STACK_BOTTOM];
+    FAST486_STATE Single, Blocks;
+    ULONG Value = 2166136261U;
+    ULONG i, j, Offset, Start;
+
+    Fast486SetBlockCache(&Blocks, &BlockCache);
+
+    for (i = 0; i < SEQUENCE_RUNS; i++)
+    {
+        for (j = 0, Offset = CODE_OFFSET; j < SEQUENCE_LENGTH; j++)
+        {
+            if (Random() % 3)
+                Offset += Emit(&Memory[Offset], &Instructions[Random() % ARRAYSIZE(Instructions)]);
+            else
+                Offset += Emit(&Memory[Offset], &Consumers[Random() % ARRAYSIZE(Consumers)]);
+        }
+        Memory[Offset] = 0xF4;
+
+        /* Both runs start from the same state */
+        Start = Seed;
+
+        memset(&Memory[STACK_BOTTOM], 0, sizeof(SavedStack));
+        Setup(&Single, FALSE);
+        Run(&Single, FALSE);
+        Value = HashState(Value, &Single);
+        memcpy(SavedStack, &Memory[STACK_BOTTOM], sizeof(SavedStack));
+
+        Seed = Start;
+
+        memset(&Memory[STACK_BOTTOM], 0, sizeof(SavedStack));
+        Setup(&Blocks, TRUE);
+        Run(&Blocks, TRUE);
+
+        if (memcmp(Single.GeneralRegs, Blocks.GeneralRegs, sizeof(Single.GeneralRegs))
+            || (Single.Flags.Long != Blocks.Flags.Long)
+            || memcmp(SavedStack, &Memory[STACK_BOTTOM], sizeof(SavedStack)))
+        {
+            printf("Sequence %u: the block results differ\n", i);
+            (*Failures)++;
+        }
+    }
+
+    return Value;
+}
+
+int main(int argc, char *argv[])
+{
+    ULONG i, Value, Failures = 0;
+    BOOLEAN Print = (argc > 1) && !strcmp(argv[1], "-p");
+
+    for (i = 0; i < ARRAYSIZE(Instructions); i++)
+    {
+        Value = TestInstruction(&Instructions[i]);
+
+        if (Print) printf("    0x%08X, /* %s */\n", Value, Instructions[i].Name);
+        else if (Value != Expected[i])
+        {
+            printf("%s: the flags or results differ\n", Instructions[i].Name);
+            Failures++;
+        }
+    }
+
+    Value = TestSequences(&Failures);
+
+    if (Print) printf("    0x%08X, /* sequences */\n", Value);
+    else if (Value != Expected[ARRAYSIZE(Instructions)])
+    {
+        printf("Sequences: the flags or results differ\n");
+        Failures++;
+    }
+
+    printf("%u failures\n", Failures);
+    return Failures ? 1 : 0;
+}
@@ -0,0 +1,49 @@
+/*
+ * PROJECT:     ReactOS host tools
+ * LICENSE:     GPL-2.0-or-later (https://spdx.org/licenses/GPL-2.0-or-later)
+ * PURPOSE:     Minimal Windows definitions for building Fast486 on the host
+ */
+
+#pragma once
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <assert.h>
+#include <typedefs.h>
+
+#ifdef _MSC_VER
+#define FORCEINLINE static __forceinline
+#else
+#define FORCEINLINE static inline __attribute__((always_inline))
+#endif
+#define FASTCALL
+
+#define C_ASSERT(e) typedef char __C_ASSERT__[(e) ? 1 : -1]
+#define UNREFERENCED_PARAMETER(P) ((void)(P))
+#define UlongToPtr(ul) ((PVOID)(uintptr_t)(ul))
+
+#ifndef min
+#define min(a, b) (((a) < (b)) ? (a) : (b))
+#define max(a, b) (((a) > (b)) ? (a) : (b))
+#endif
+
+#define ARRAYSIZE(a) (sizeof(a) / sizeof((a)[0]))
+
+typedef signed char SCHAR, *PSCHAR;
+typedef ULONGLONG *PULONGLONG;
+typedef LONGLONG *PLONGLONG;
+
+#define RtlFillMemory(Destination, Length, Fill)      memset(Destination, Fill, Length)
+
+static inline SIZE_T
+RtlCompareMemory(const VOID *Source1, const VOID *Source2, SIZE_T Length)
+{
+    SIZE_T i;
+
+    for (i = 0; (i < Length) && (((PUCHAR)Source1)[i] == ((PUCHAR)Source2)[i]); i++);
+    return i;
+}
+
+#define DbgPrint printf
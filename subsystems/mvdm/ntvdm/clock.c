@@ -76,7 +76,7 @@ static VOID FASTCALL IpsCallback(ULONGLONG ElapsedTime)
 VOID ClockUpdate(VOID)
 {
     extern BOOLEAN CpuRunning;
-    UINT i;
+    UINT i, Steps;
     PLIST_ENTRY Entry;
     PHARDWARE_TIMER Timer;
 
@@ -89,10 +89,10 @@ VOID ClockUpdate(VOID)
         /// SetThreadAffinityMask(GetCurrentThread(), oldmask);
 
         /* Continue CPU emulation */
-        for (i = 0; VdmRunning && CpuRunning && (i < STEPS_PER_CYCLE); i++)
+        for (i = 0; VdmRunning && CpuRunning && (i < STEPS_PER_CYCLE); i += Steps)
         {
-            CpuStep();
-            ++CurrentCycleCount;
+            Steps = CpuStep();
+            CurrentCycleCount += Steps;
         }
 
         Entry = Timers.Flink;
@@ -477,11 +477,7 @@ VOID ScreenEventHandler(PWINDOW_BUFFER_SIZE_RECORD ScreenEvent)
     ResizeTextConsole(&CurrResolution, NULL);
 
     /* Force refresh of all the screen */
-    NeedsUpdate = TRUE;
-    UpdateRectangle.Left = 0;
-    UpdateRectangle.Top  = 0;
-    UpdateRectangle.Right  = CurrResolution.X;
-    UpdateRectangle.Bottom = CurrResolution.Y;
+    VgaMarkScreenForUpdate();
     VgaRefreshDisplay();
 }
 
@@ -39,6 +39,9 @@
 FAST486_STATE EmulatorContext;
 BOOLEAN CpuRunning = FALSE;
 
+/* Decoded blocks of the emulated code */
+static FAST486_BLOCK_CACHE BlockCache;
+
 /* No more than 'MaxCpuCallLevel' recursive CPU calls are allowed */
 static const INT MaxCpuCallLevel = 32;
 static INT CpuCallLevel = 0; // == 0: CPU stopped; >= 1: CPU running or halted
@@ -105,13 +108,13 @@ VOID CpuExecute(WORD Segment, WORD Offset)
     Fast486ExecuteAt(&EmulatorContext, Segment, Offset);
 }
 
-VOID CpuStep(VOID)
+ULONG CpuStep(VOID)
 {
     /* Dump the state for debugging purposes */
     // Fast486DumpState(&EmulatorContext);
 
-    /* Execute the next instruction */
-    Fast486StepInto(&EmulatorContext);
+    /* Execute the next block of instructions, return how many were executed */
+    return Fast486StepBlock(&EmulatorContext);
 }
 
 LONG CpuExceptionFilter(IN PEXCEPTION_POINTERS ExceptionInfo)
@@ -232,6 +235,7 @@ BOOLEAN CpuInitialize(VOID)
                       EmulatorIntAcknowledge,
                       EmulatorFpu,
                       NULL /* TODO: Use a TLB */);
+    Fast486SetBlockCache(&EmulatorContext, &BlockCache);
 
     /* Initialize the software callback system and register the emulator BOPs */
     // RegisterBop(BOP_DEBUGGER  , EmulatorDebugBreakBop);
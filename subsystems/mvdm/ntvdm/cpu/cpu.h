@@ -64,7 +64,7 @@ VOID EmulatorException(BYTE ExceptionNumber, LPWORD Stack);
 #endif
 
 VOID CpuExecute(WORD Segment, WORD Offset);
-VOID CpuStep(VOID);
+ULONG CpuStep(VOID);
 VOID CpuSimulate(VOID);
 VOID CpuUnsimulate(VOID);
 #if 0
@@ -28,6 +28,10 @@
 #define WRAP_OFFSET(x) ((VgaCrtcRegisters[SVGA_CRTC_EXT_DISPLAY_REG] & SVGA_CRTC_EXT_ADDR_WRAP) \
                        ? ((x) & 0xFFFFF) : LOWORD(x))
 
+#define VGA_MAX_SCANLINES       1024
+#define VGA_DIRTY_CHUNK_SHIFT   8
+#define VGA_UPDATE_MAX_GAP      8
+
 static CONST DWORD MemoryBase[] = { 0xA0000, 0xA0000, 0xB0000, 0xB8000 };
 static CONST DWORD MemorySize[] = { 0x20000, 0x10000, 0x08000, 0x08000 };
 
@@ -295,7 +299,45 @@ typedef enum _SCREEN_MODE
 static SCREEN_MODE ScreenMode = TEXT_MODE;
 static COORD CurrResolution   = {0};
 
-static SMALL_RECT UpdateRectangle = { 0, 0, 0, 0 };
+/* The columns to repaint in each row, from UpdateLeft to UpdateRight - 1 */
+static SHORT UpdateLeft[VGA_MAX_SCANLINES];
+static SHORT UpdateRight[VGA_MAX_SCANLINES];
+
+typedef struct _VGA_MEMORY_RANGE
+{
+    DWORD First;
+    DWORD Last;
+} VGA_MEMORY_RANGE, *PVGA_MEMORY_RANGE;
+
+/* The registers that decide which VGA memory a scanline shows, and how */
+typedef struct _VGA_DISPLAY_STATE
+{
+    PVOID Framebuffer;
+    COORD Resolution;
+    BOOLEAN DoubleWidth;
+    BOOLEAN DoubleHeight;
+    BOOLEAN AcPalDisable;
+    BYTE SeqExtMode;
+    BYTE GcMode;
+    BYTE GcMisc;
+    DWORD StartAddress;
+    DWORD ScanlineSize;
+    BYTE CrtcRegisters[SVGA_CRTC_MAX_REG];
+    BYTE AcRegisters[VGA_AC_MAX_REG];
+} VGA_DISPLAY_STATE, *PVGA_DISPLAY_STATE;
+
+/*
+ * The chunks of the VGA memory written since the last framebuffer update,
+ * and the part of the VGA memory that each graphics scanline showed then.
+ * A scanline is only converted again when its memory or the display state
+ * changed.
+ */
+static BOOLEAN VgaMemoryDirty = TRUE;
+static BOOLEAN VgaDirtyChunks[sizeof(VgaMemory) >> VGA_DIRTY_CHUNK_SHIFT];
+static VGA_MEMORY_RANGE ScanlineRanges[VGA_MAX_SCANLINES];
+static VGA_DISPLAY_STATE DisplayState;
+
+static VOID VgaMarkScreenForUpdate(VOID);
 
 
 
@@ -703,12 +745,9 @@ static VOID VgaChangeMode(VOID)
 
 Quit:
 
-    /* Trigger a full update of the screen */
-    NeedsUpdate = TRUE;
-    UpdateRectangle.Left = 0;
-    UpdateRectangle.Top  = 0;
-    UpdateRectangle.Right  = CurrResolution.X;
-    UpdateRectangle.Bottom = CurrResolution.Y;
+    /* Trigger a full conversion and update of the screen */
+    RtlZeroMemory(&DisplayState, sizeof(DisplayState));
+    VgaMarkScreenForUpdate();
 
     /* Reset the mode change flag */
     ModeChanged = FALSE;
@@ -716,23 +755,148 @@ Quit:
 
 static inline VOID VgaMarkForUpdate(SHORT Row, SHORT Column)
 {
-    /* Check if this is the first time the rectangle is updated */
-    if (!NeedsUpdate)
+    ASSERT(Row < VGA_MAX_SCANLINES);
+
+    /* Check if this is the first change in the row */
+    if (UpdateLeft[Row] >= UpdateRight[Row])
     {
-        UpdateRectangle.Left = UpdateRectangle.Top = MAXSHORT;
-        UpdateRectangle.Right = UpdateRectangle.Bottom = MINSHORT;
+        UpdateLeft[Row] = Column;
+        UpdateRight[Row] = Column + 1;
     }
+    else
+    {
+        /* Expand the span of the row to include the point */
+        UpdateLeft[Row] = min(UpdateLeft[Row], Column);
+        UpdateRight[Row] = max(UpdateRight[Row], Column + 1);
+    }
+
+    /* Set the update request flag */
+    NeedsUpdate = TRUE;
+}
+
+static VOID VgaMarkScreenForUpdate(VOID)
+{
+    SHORT i;
 
-    /* Expand the rectangle to include the point */
-    UpdateRectangle.Left = min(UpdateRectangle.Left, Column);
-    UpdateRectangle.Right = max(UpdateRectangle.Right, Column);
-    UpdateRectangle.Top = min(UpdateRectangle.Top, Row);
-    UpdateRectangle.Bottom = max(UpdateRectangle.Bottom, Row);
+    for (i = 0; i < min(CurrResolution.Y, VGA_MAX_SCANLINES); i++)
+    {
+        UpdateLeft[i] = 0;
+        UpdateRight[i] = CurrResolution.X;
+    }
 
     /* Set the update request flag */
     NeedsUpdate = TRUE;
 }
 
+static VOID VgaRepaintUpdatedRows(VOID)
+{
+    SHORT i, LastRow = -1;
+    SMALL_RECT Rectangle;
+
+    for (i = 0; i < min(CurrResolution.Y, VGA_MAX_SCANLINES); i++)
+    {
+        if (UpdateLeft[i] >= UpdateRight[i]) continue;
+
+        if ((LastRow >= 0) && ((i - LastRow) > VGA_UPDATE_MAX_GAP))
+        {
+            /* Repaint the previous rows, they are too far from this one */
+            VgaConsoleRepaintScreen(&Rectangle);
+            LastRow = -1;
+        }
+
+        if (LastRow < 0)
+        {
+            /* Start a new rectangle */
+            Rectangle.Left   = UpdateLeft[i];
+            Rectangle.Right  = UpdateRight[i] - 1;
+            Rectangle.Top    = i;
+        }
+        else
+        {
+            /* Expand the rectangle to include the row */
+            Rectangle.Left   = min(Rectangle.Left, UpdateLeft[i]);
+            Rectangle.Right  = max(Rectangle.Right, UpdateRight[i] - 1);
+        }
+
+        Rectangle.Bottom = i;
+        LastRow = i;
+
+        /* The row is up to date */
+        UpdateLeft[i] = UpdateRight[i] = 0;
+    }
+
+    if (LastRow >= 0) VgaConsoleRepaintScreen(&Rectangle);
+}
+
+static inline VOID VgaMarkMemoryDirty(DWORD Index, DWORD Size)
+{
+    DWORD Chunk = Index >> VGA_DIRTY_CHUNK_SHIFT;
+    DWORD LastChunk = min((Index + Size - 1) >> VGA_DIRTY_CHUNK_SHIFT,
+                          ARRAYSIZE(VgaDirtyChunks) - 1);
+
+    while (Chunk <= LastChunk) VgaDirtyChunks[Chunk++] = TRUE;
+    VgaMemoryDirty = TRUE;
+}
+
+static inline BOOLEAN VgaIsMemoryDirty(PVGA_MEMORY_RANGE Range)
+{
+    DWORD Chunk;
+
+    if (!VgaMemoryDirty || (Range->First > Range->Last)) return FALSE;
+
+    for (Chunk = Range->First >> VGA_DIRTY_CHUNK_SHIFT;
+         Chunk <= (Range->Last >> VGA_DIRTY_CHUNK_SHIFT);
+         Chunk++)
+    {
+        if (VgaDirtyChunks[Chunk]) return TRUE;
+    }
+
+    return FALSE;
+}
+
+static inline BYTE VgaReadDisplayMemory(DWORD Index, PVGA_MEMORY_RANGE Range)
+{
+    /* Remember which part of the memory the scanline shows */
+    Range->First = min(Range->First, Index);
+    Range->Last  = max(Range->Last, Index);
+
+    return VgaMemory[Index];
+}
+
+static BOOLEAN VgaDisplayStateChanged(VOID)
+{
+    VGA_DISPLAY_STATE NewState;
+
+    RtlZeroMemory(&NewState, sizeof(NewState));
+    NewState.Framebuffer  = ActiveFramebuffer;
+    NewState.Resolution   = CurrResolution;
+    NewState.DoubleWidth  = DoubleWidth;
+    NewState.DoubleHeight = DoubleHeight;
+    NewState.AcPalDisable = VgaAcPalDisable;
+    NewState.SeqExtMode   = VgaSeqRegisters[SVGA_SEQ_EXT_MODE_REG];
+    NewState.GcMode       = VgaGcRegisters[VGA_GC_MODE_REG]
+                            & (VGA_GC_MODE_OE | VGA_GC_MODE_SHIFTREG | VGA_GC_MODE_SHIFT256);
+    NewState.GcMisc       = VgaGcRegisters[VGA_GC_MISC_REG];
+    NewState.StartAddress = StartAddressLatch;
+    NewState.ScanlineSize = ScanlineSizeLatch;
+    RtlCopyMemory(NewState.CrtcRegisters, VgaCrtcRegisters, sizeof(VgaCrtcRegisters));
+    RtlCopyMemory(NewState.AcRegisters, VgaAcRegisters, sizeof(VgaAcRegisters));
+
+    /* The cursor does not change the framebuffer */
+    NewState.CrtcRegisters[VGA_CRTC_CURSOR_START_REG]    = 0;
+    NewState.CrtcRegisters[VGA_CRTC_CURSOR_END_REG]      = 0;
+    NewState.CrtcRegisters[VGA_CRTC_CURSOR_LOC_LOW_REG]  = 0;
+    NewState.CrtcRegisters[VGA_CRTC_CURSOR_LOC_HIGH_REG] = 0;
+
+    if (RtlCompareMemory(&NewState, &DisplayState, sizeof(NewState)) == sizeof(NewState))
+    {
+        return FALSE;
+    }
+
+    DisplayState = NewState;
+    return TRUE;
+}
+
 static VOID VgaUpdateFramebuffer(VOID)
 {
     SHORT i, j, k;
@@ -756,6 +920,7 @@ static VOID VgaUpdateFramebuffer(VOID)
         /* Graphics mode */
         PBYTE GraphicsBuffer = (PBYTE)ActiveFramebuffer;
         DWORD InterlaceHighBit = VGA_INTERLACE_HIGH_BIT;
+        BOOLEAN FullConversion;
         SHORT X;
 
         /*
@@ -781,9 +946,14 @@ static VOID VgaUpdateFramebuffer(VOID)
             LineCompare /= 1 + (VgaCrtcRegisters[VGA_CRTC_MAX_SCAN_LINE_REG] & 0x1F);
         }
 
+        /* Convert all the scanlines if the memory is now shown differently */
+        FullConversion = VgaDisplayStateChanged();
+
         /* Loop through the scanlines */
         for (i = 0; i < CurrResolution.Y; i++)
         {
+            PVGA_MEMORY_RANGE Range = &ScanlineRanges[i];
+
             if (i == LineCompare)
             {
                 if (VgaAcRegisters[VGA_AC_CONTROL_REG] & VGA_AC_CONTROL_PPM)
@@ -806,6 +976,12 @@ static VOID VgaUpdateFramebuffer(VOID)
                 Address |= InterlaceHighBit;
             }
 
+            /* Skip the scanline if the memory it shows was not written to */
+            if (!FullConversion && !VgaIsMemoryDirty(Range)) goto NextScanline;
+
+            Range->First = MAXDWORD;
+            Range->Last  = 0;
+
             /* Loop through the pixels */
             for (j = 0; j < CurrResolution.X; j++)
             {
@@ -826,7 +1002,7 @@ static VOID VgaUpdateFramebuffer(VOID)
                     // TODO: Check for high color modes
 
                     /* 256 color mode */
-                    PixelData = VgaMemory[Address + X];
+                    PixelData = VgaReadDisplayMemory(Address + X, Range);
                 }
                 else
                 {
@@ -839,15 +1015,15 @@ static VOID VgaUpdateFramebuffer(VOID)
                         if (VgaAcRegisters[VGA_AC_CONTROL_REG] & VGA_AC_CONTROL_8BIT)
                         {
                             /* One byte per pixel */
-                            PixelData = VgaMemory[WRAP_OFFSET((Address + (X / VGA_NUM_BANKS)) * AddressSize)
-                                                  * VGA_NUM_BANKS + (X % VGA_NUM_BANKS)];
+                            PixelData = VgaReadDisplayMemory(WRAP_OFFSET((Address + (X / VGA_NUM_BANKS)) * AddressSize)
+                                                             * VGA_NUM_BANKS + (X % VGA_NUM_BANKS), Range);
                         }
                         else
                         {
                             /* 4-bits per pixel */
 
-                            PixelData = VgaMemory[WRAP_OFFSET((Address + (X / (VGA_NUM_BANKS * 2))) * AddressSize)
-                                                  * VGA_NUM_BANKS + ((X / 2) % VGA_NUM_BANKS)];
+                            PixelData = VgaReadDisplayMemory(WRAP_OFFSET((Address + (X / (VGA_NUM_BANKS * 2))) * AddressSize)
+                                                             * VGA_NUM_BANKS + ((X / 2) % VGA_NUM_BANKS), Range);
 
                             /* Check if we should use the highest 4 bits or lowest 4 */
                             if ((X % 2) == 0)
@@ -878,8 +1054,8 @@ static VOID VgaUpdateFramebuffer(VOID)
                              */
                             DWORD BankNumber = (X / 4) % 2;
                             DWORD Offset = Address + (X / 8);
-                            BYTE LowPlaneData = VgaMemory[WRAP_OFFSET(Offset * AddressSize) * VGA_NUM_BANKS + BankNumber];
-                            BYTE HighPlaneData = VgaMemory[WRAP_OFFSET(Offset * AddressSize) * VGA_NUM_BANKS + (BankNumber + 2)];
+                            BYTE LowPlaneData = VgaReadDisplayMemory(WRAP_OFFSET(Offset * AddressSize) * VGA_NUM_BANKS + BankNumber, Range);
+                            BYTE HighPlaneData = VgaReadDisplayMemory(WRAP_OFFSET(Offset * AddressSize) * VGA_NUM_BANKS + (BankNumber + 2), Range);
 
                             /* Extract the two bits from each plane */
                             LowPlaneData  = (LowPlaneData  >> (6 - ((X % 4) * 2))) & 0x03;
@@ -901,7 +1077,7 @@ static VOID VgaUpdateFramebuffer(VOID)
                             for (k = 0; k < VGA_NUM_BANKS; k++)
                             {
                                 /* The data is on plane k, 4 pixels per byte */
-                                BYTE PlaneData = VgaMemory[WRAP_OFFSET((Address + (X >> 2)) * AddressSize) * VGA_NUM_BANKS + k];
+                                BYTE PlaneData = VgaReadDisplayMemory(WRAP_OFFSET((Address + (X >> 2)) * AddressSize) * VGA_NUM_BANKS + k, Range);
 
                                 /* The mask of the first bit in the pair */
                                 BYTE BitMask = 1 << (((3 - (X % VGA_NUM_BANKS)) * 2) + 1);
@@ -919,7 +1095,7 @@ static VOID VgaUpdateFramebuffer(VOID)
 
                             for (k = 0; k < VGA_NUM_BANKS; k++)
                             {
-                                BYTE PlaneData = VgaMemory[WRAP_OFFSET((Address + (X >> 3)) * AddressSize) * VGA_NUM_BANKS + k];
+                                BYTE PlaneData = VgaReadDisplayMemory(WRAP_OFFSET((Address + (X >> 3)) * AddressSize) * VGA_NUM_BANKS + k, Range);
 
                                 /* If the bit on that plane is set, set it */
                                 if (PlaneData & (1 << (7 - (X % 8)))) PixelData |= 1 << k;
@@ -1013,6 +1189,7 @@ static VOID VgaUpdateFramebuffer(VOID)
                 }
             }
 
+NextScanline:
             if ((VgaGcRegisters[VGA_GC_MISC_REG] & VGA_GC_MISC_OE) && (i & 1))
             {
                 /* Clear the high bit */
@@ -1075,6 +1252,13 @@ static VOID VgaUpdateFramebuffer(VOID)
             Address += ScanlineSizeLatch;
         }
     }
+
+    /* The framebuffer now reflects all the writes to the VGA memory */
+    if (VgaMemoryDirty)
+    {
+        RtlZeroMemory(VgaDirtyChunks, sizeof(VgaDirtyChunks));
+        VgaMemoryDirty = FALSE;
+    }
 }
 
 static VOID VgaUpdateTextCursor(VOID)
@@ -1625,11 +1809,7 @@ static inline VOID VgaVerticalRetrace(VOID)
     if (PaletteChanged)
     {
         /* Trigger a full update of the screen */
-        NeedsUpdate = TRUE;
-        UpdateRectangle.Left = 0;
-        UpdateRectangle.Top  = 0;
-        UpdateRectangle.Right  = CurrResolution.X;
-        UpdateRectangle.Bottom = CurrResolution.Y;
+        VgaMarkScreenForUpdate();
 
         PaletteChanged = FALSE;
     }
@@ -1640,13 +1820,8 @@ static inline VOID VgaVerticalRetrace(VOID)
     /* Ignore if there's nothing to update */
     if (!NeedsUpdate) return;
 
-    DPRINT("Updating screen rectangle (%d, %d, %d, %d)\n",
-           UpdateRectangle.Left,
-           UpdateRectangle.Top,
-           UpdateRectangle.Right,
-           UpdateRectangle.Bottom);
-
-    VgaConsoleRepaintScreen(&UpdateRectangle);
+    /* Repaint only the changed spans of the rows */
+    VgaRepaintUpdatedRows();
 
     /* Clear the update flag */
     NeedsUpdate = FALSE;
@@ -1999,6 +2174,7 @@ BOOLEAN FASTCALL VgaWriteMemory(ULONG Address, PVOID Buffer, ULONG Size)
         for (i = 0; i < Size; i++)
         {
             VideoAddress = VgaTranslateAddress(Address + i);
+            VgaMarkMemoryDirty(VideoAddress * VGA_NUM_BANKS, VGA_NUM_BANKS);
 
             for (j = 0; j < VGA_NUM_BANKS; j++)
             {
@@ -2040,6 +2216,7 @@ BOOLEAN FASTCALL VgaWriteMemory(ULONG Address, PVOID Buffer, ULONG Size)
         /* Just copy to the video memory */
         VideoAddress = VgaTranslateAddress(Address);
         VideoMemory = &VgaMemory[VideoAddress + (Address & 3)];
+        VgaMarkMemoryDirty(VideoAddress + (Address & 3), Size);
 
         switch (Size)
         {
@@ -2074,6 +2251,7 @@ BOOLEAN FASTCALL VgaWriteMemory(ULONG Address, PVOID Buffer, ULONG Size)
 VOID VgaClearMemory(VOID)
 {
     RtlZeroMemory(VgaMemory, sizeof(VgaMemory));
+    VgaMarkMemoryDirty(0, sizeof(VgaMemory));
 }
 
 VOID VgaWriteTextModeFont(UINT FontNumber, CONST UCHAR* FontData, UINT Height)
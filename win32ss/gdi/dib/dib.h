@@ -127,6 +127,12 @@ BOOLEAN DIB_XXBPP_StretchBlt(SURFOBJ*,SURFOBJ*,SURFOBJ*,SURFOBJ*,RECTL*,RECTL*,P
 BOOLEAN DIB_XXBPP_FloodFillSolid(SURFOBJ*, BRUSHOBJ*, RECTL*, POINTL*, ULONG, UINT);
 BOOLEAN DIB_XXBPP_AlphaBlend(SURFOBJ*, SURFOBJ*, RECTL*, RECTL*, CLIPOBJ*, XLATEOBJ*, BLENDOBJ*);
 
+BOOLEAN DIB_bBeginSse2(PKFLOATING_SAVE);
+VOID DIB_vEndSse2(PKFLOATING_SAVE);
+VOID DIB_32BPP_AlphaBlendRow(PULONG, const ULONG*, ULONG, BLENDFUNCTION, BOOLEAN);
+VOID DIB_StretchRow(PVOID, const VOID*, ULONG, ULONG, ULONG, ULONG);
+VOID DIB_vFillRectFromRow(SURFOBJ*, LONG, LONG, LONG, const VOID*, ULONG);
+
 extern unsigned char notmask[2];
 extern unsigned char altnotmask[2];
 #define MASK1BPP(x) (1<<(7-((x)&7)))
@@ -759,6 +759,69 @@ Clamp8(ULONG val)
   return (val > 255) ? 255 : (UCHAR)val;
 }
 
+#define ALPHABLEND_CHUNK 128
+
+static BOOLEAN
+DIB_32BPP_AlphaBlendRows(SURFOBJ* Dest, SURFOBJ* Source, RECTL* DestRect,
+                         RECTL* SourceRect, BLENDFUNCTION BlendFunc)
+{
+  ULONG Row, Col, Count, DstWidth, DstHeight, SrcWidth, SrcHeight;
+  ULONG SrcX, Step, Remainder, Error;
+  ULONG Chunk[ALPHABLEND_CHUNK];
+  const ULONG *SrcLine;
+  PULONG DstLine;
+  KFLOATING_SAVE FloatSave;
+  BOOLEAN bSse2;
+
+  DstWidth = DestRect->right - DestRect->left;
+  DstHeight = DestRect->bottom - DestRect->top;
+  SrcWidth = SourceRect->right - SourceRect->left;
+  SrcHeight = SourceRect->bottom - SourceRect->top;
+  Step = SrcWidth / DstWidth;
+  Remainder = SrcWidth % DstWidth;
+
+  bSse2 = DIB_bBeginSse2(&FloatSave);
+
+  for (Row = 0; Row < DstHeight; Row++)
+  {
+    DstLine = (PULONG)((ULONG_PTR)Dest->pvScan0 + (DestRect->top + Row) * Dest->lDelta) +
+              DestRect->left;
+    SrcLine = (PULONG)((ULONG_PTR)Source->pvScan0 +
+                       (SourceRect->top + (Row * SrcHeight) / DstHeight) * Source->lDelta) +
+              SourceRect->left;
+
+    if (SrcWidth == DstWidth)
+    {
+      DIB_32BPP_AlphaBlendRow(DstLine, SrcLine, DstWidth, BlendFunc, bSse2);
+      continue;
+    }
+
+    /* Gather the stretched source pixels, then blend them */
+    SrcX = 0;
+    Error = 0;
+    for (Col = 0; Col < DstWidth; Col += Count)
+    {
+      for (Count = 0; Count < ALPHABLEND_CHUNK && Col + Count < DstWidth; Count++)
+      {
+        Chunk[Count] = SrcLine[SrcX];
+        SrcX += Step;
+        Error += Remainder;
+        if (Error >= DstWidth)
+        {
+          Error -= DstWidth;
+          SrcX++;
+        }
+      }
+      DIB_32BPP_AlphaBlendRow(DstLine + Col, Chunk, Count, BlendFunc, bSse2);
+    }
+  }
+
+  if (bSse2)
+    DIB_vEndSse2(&FloatSave);
+
+  return TRUE;
+}
+
 BOOLEAN
 DIB_32BPP_AlphaBlend(SURFOBJ* Dest, SURFOBJ* Source, RECTL* DestRect,
                      RECTL* SourceRect, CLIPOBJ* ClipRegion,
@@ -801,6 +864,15 @@ DIB_32BPP_AlphaBlend(SURFOBJ* Dest, SURFOBJ* Source, RECTL* DestRect,
     (DestRect->left << 2));
   SrcBpp = BitsPerFormat(Source->iBitmapFormat);
 
+  /* 32bpp sources that need no translation are blended a row at a time */
+  if (SrcBpp == 32 &&
+      (!ColorTranslation || (ColorTranslation->flXlate & XO_TRIVIAL)) &&
+      DestRect->right > DestRect->left && DestRect->bottom > DestRect->top &&
+      SourceRect->right > SourceRect->left && SourceRect->bottom > SourceRect->top)
+  {
+    return DIB_32BPP_AlphaBlendRows(Dest, Source, DestRect, SourceRect, BlendFunc);
+  }
+
   Rows = 0;
    SrcY = SourceRect->top;
    while (++Rows <= DestRect->bottom - DestRect->top)
@@ -0,0 +1,229 @@
+/*
+ * PROJECT:         Win32 subsystem
+ * LICENSE:         See COPYING in the top level directory
+ * FILE:            win32ss/gdi/dib/dibrows.c
+ * PURPOSE:         Row kernels for alpha blending, stretching and gradients
+ */
+
+#include <win32k.h>
+
+#if defined(_M_IX86) || defined(_M_AMD64)
+#define _DIB_SSE2_
+#include <emmintrin.h>
+#ifdef __GNUC__
+#define DIB_TARGET_SSE2 __attribute__((target("sse2")))
+#else
+#define DIB_TARGET_SSE2
+#endif
+#endif
+
+#define NDEBUG
+#include <debug.h>
+
+/*
+ * Kernel code may always use SSE2 on x64. On x86 the FPU state of the
+ * thread is only saved for user mode, so it has to be saved around it.
+ */
+BOOLEAN
+DIB_bBeginSse2(PKFLOATING_SAVE pFloatSave)
+{
+#if defined(_M_AMD64)
+  UNREFERENCED_PARAMETER(pFloatSave);
+  return TRUE;
+#elif defined(_M_IX86)
+  if (!ExIsProcessorFeaturePresent(PF_XMMI64_INSTRUCTIONS_AVAILABLE))
+    return FALSE;
+  return NT_SUCCESS(KeSaveFloatingPointState(pFloatSave));
+#else
+  UNREFERENCED_PARAMETER(pFloatSave);
+  return FALSE;
+#endif
+}
+
+VOID
+DIB_vEndSse2(PKFLOATING_SAVE pFloatSave)
+{
+#if defined(_M_IX86)
+  KeRestoreFloatingPointState(pFloatSave);
+#else
+  UNREFERENCED_PARAMETER(pFloatSave);
+#endif
+}
+
+/* x / 255 rounded down, exact for x <= 255 * 255 */
+#define DIV255(x) ((((x) + 1) + (((x) + 1) >> 8)) >> 8)
+
+static __inline ULONG
+BlendChannel(ULONG Dst, ULONG Src, ULONG InvAlpha)
+{
+  ULONG Val = DIV255(Dst * InvAlpha) + Src;
+  return (Val > 255) ? 255 : Val;
+}
+
+static VOID
+AlphaBlendRow_C(PULONG pulDest, const ULONG *pulSource, ULONG cx, ULONG ConstAlpha, BOOLEAN SrcAlpha)
+{
+  ULONG Src, Dst, Alpha, InvAlpha, Shift, Result, SrcChannel[4];
+
+  while (cx--)
+  {
+    Src = *pulSource++;
+    Dst = *pulDest;
+
+    /* Scale the source by the constant alpha, including its alpha channel */
+    for (Shift = 0; Shift < 4; Shift++)
+      SrcChannel[Shift] = DIV255(((Src >> (Shift * 8)) & 0xFF) * ConstAlpha);
+
+    Alpha = SrcAlpha ? SrcChannel[3] : ConstAlpha;
+    InvAlpha = 255 - Alpha;
+
+    Result = 0;
+    for (Shift = 0; Shift < 4; Shift++)
+      Result |= BlendChannel((Dst >> (Shift * 8)) & 0xFF, SrcChannel[Shift], InvAlpha) << (Shift * 8);
+
+    *pulDest++ = Result;
+  }
+}
+
+#ifdef _DIB_SSE2_
+
+static DIB_TARGET_SSE2 __inline __m128i
+Div255_SSE2(__m128i x)
+{
+  x = _mm_add_epi16(x, _mm_set1_epi16(1));
+  return _mm_srli_epi16(_mm_add_epi16(x, _mm_srli_epi16(x, 8)), 8);
+}
+
+static DIB_TARGET_SSE2 VOID
+AlphaBlendRow_SSE2(PULONG pulDest, const ULONG *pulSource, ULONG cx, ULONG ConstAlpha, BOOLEAN SrcAlpha)
+{
+  const __m128i Zero = _mm_setzero_si128();
+  const __m128i Max = _mm_set1_epi16(255);
+  const __m128i Const = _mm_set1_epi16((SHORT)ConstAlpha);
+  __m128i Src, Dst, SrcLo, SrcHi, DstLo, DstHi, AlphaLo, AlphaHi;
+
+  /* Four pixels at once, two per 16 bit half */
+  for (; cx >= 4; cx -= 4)
+  {
+    Src = _mm_loadu_si128((const __m128i *)pulSource);
+    Dst = _mm_loadu_si128((const __m128i *)pulDest);
+
+    SrcLo = Div255_SSE2(_mm_mullo_epi16(_mm_unpacklo_epi8(Src, Zero), Const));
+    SrcHi = Div255_SSE2(_mm_mullo_epi16(_mm_unpackhi_epi8(Src, Zero), Const));
+
+    if (SrcAlpha)
+    {
+      /* Spread the alpha channel of each pixel over its 4 channels */
+      AlphaLo = _mm_shufflehi_epi16(_mm_shufflelo_epi16(SrcLo, 0xFF), 0xFF);
+      AlphaHi = _mm_shufflehi_epi16(_mm_shufflelo_epi16(SrcHi, 0xFF), 0xFF);
+    }
+    else
+    {
+      AlphaLo = AlphaHi = Const;
+    }
+
+    DstLo = _mm_mullo_epi16(_mm_unpacklo_epi8(Dst, Zero), _mm_sub_epi16(Max, AlphaLo));
+    DstHi = _mm_mullo_epi16(_mm_unpackhi_epi8(Dst, Zero), _mm_sub_epi16(Max, AlphaHi));
+    DstLo = _mm_add_epi16(Div255_SSE2(DstLo), SrcLo);
+    DstHi = _mm_add_epi16(Div255_SSE2(DstHi), SrcHi);
+
+    /* Saturating pack does the clamping */
+    _mm_storeu_si128((__m128i *)pulDest, _mm_packus_epi16(DstLo, DstHi));
+
+    pulSource += 4;
+    pulDest += 4;
+  }
+
+  AlphaBlendRow_C(pulDest, pulSource, cx, ConstAlpha, SrcAlpha);
+}
+
+#endif /* _DIB_SSE2_ */
+
+/*
+ * Blends a row of 32bpp source pixels, in the destination format, onto a
+ * 32bpp destination row. Gives the same results as the per pixel code.
+ */
+VOID
+DIB_32BPP_AlphaBlendRow(PULONG pulDest, const ULONG *pulSource, ULONG cx,
+                        BLENDFUNCTION BlendFunc, BOOLEAN bSse2)
+{
+  BOOLEAN SrcAlpha = (BlendFunc.AlphaFormat & AC_SRC_ALPHA) != 0;
+
+#ifdef _DIB_SSE2_
+  if (bSse2)
+  {
+    AlphaBlendRow_SSE2(pulDest, pulSource, cx, BlendFunc.SourceConstantAlpha, SrcAlpha);
+    return;
+  }
+#else
+  UNREFERENCED_PARAMETER(bSse2);
+#endif
+
+  AlphaBlendRow_C(pulDest, pulSource, cx, BlendFunc.SourceConstantAlpha, SrcAlpha);
+}
+
+/*
+ * Nearest neighbour stretch of a 16 or 32bpp row, pixel i of the
+ * destination is pixel (i * SrcWidth / DstWidth) of the source.
+ */
+VOID
+DIB_StretchRow(PVOID pvDest, const VOID *pvSource, ULONG cx,
+               ULONG SrcWidth, ULONG DstWidth, ULONG cjPixel)
+{
+  ULONG Step = SrcWidth / DstWidth, Remainder = SrcWidth % DstWidth;
+  ULONG Error = 0, SrcX = 0;
+
+  if (cjPixel == 4)
+  {
+    PULONG pulDest = pvDest;
+    const ULONG *pulSource = pvSource;
+
+    while (cx--)
+    {
+      *pulDest++ = pulSource[SrcX];
+      SrcX += Step;
+      Error += Remainder;
+      if (Error >= DstWidth)
+      {
+        Error -= DstWidth;
+        SrcX++;
+      }
+    }
+  }
+  else
+  {
+    PUSHORT pusDest = pvDest;
+    const USHORT *pusSource = pvSource;
+
+    ASSERT(cjPixel == 2);
+    while (cx--)
+    {
+      *pusDest++ = pusSource[SrcX];
+      SrcX += Step;
+      Error += Remainder;
+      if (Error >= DstWidth)
+      {
+        Error -= DstWidth;
+        SrcX++;
+      }
+    }
+  }
+}
+
+/* Copies the same row of pixels to the lines [top, bottom) starting at x */
+VOID
+DIB_vFillRectFromRow(SURFOBJ *pso, LONG x, LONG top, LONG bottom,
+                     const VOID *pvRow, ULONG cjRow)
+{
+  PBYTE pjDest;
+  ULONG cjPixel = BitsPerFormat(pso->iBitmapFormat) / 8;
+
+  pjDest = (PBYTE)pso->pvScan0 + top * pso->lDelta + x * cjPixel;
+  for (; top < bottom; top++)
+  {
+    RtlCopyMemory(pjDest, pvRow, cjRow);
+    pjDest += pso->lDelta;
+  }
+}
+
+/* EOF */
@@ -99,6 +99,30 @@ BOOLEAN DIB_XXBPP_StretchBlt(SURFOBJ *DestSurf, SURFOBJ *SourceSurf, SURFOBJ *Ma
 
   /* FIXME: MaskOrigin? */
 
+  /* Plain copies between 16 or 32bpp surfaces of the same format are
+     stretched a row at a time */
+  if (UsesSource && !MaskSurf && ROP == ROP4_SRCCOPY &&
+      !bLeftToRight && !bTopToBottom &&
+      SourceSurf->iBitmapFormat == DestSurf->iBitmapFormat &&
+      (DestSurf->iBitmapFormat == BMF_16BPP || DestSurf->iBitmapFormat == BMF_32BPP) &&
+      (!ColorTranslation || (ColorTranslation->flXlate & XO_TRIVIAL)) &&
+      SrcWidth > 0 && SrcHeight > 0 && DstWidth > 0 && DstHeight > 0 &&
+      SourceRect->left >= 0 && SourceRect->top >= 0 &&
+      SourceRect->right <= SourceSurf->sizlBitmap.cx && SourceRect->bottom <= SourceCy)
+  {
+    ULONG cjPixel = BitsPerFormat(DestSurf->iBitmapFormat) / 8;
+
+    for (DesY = DestRect->top; DesY < DestRect->bottom; DesY++)
+    {
+      sy = SourceRect->top + (DesY - DestRect->top) * SrcHeight / DstHeight;
+      DIB_StretchRow((PBYTE)DestSurf->pvScan0 + DesY * DestSurf->lDelta + DestRect->left * cjPixel,
+                     (PBYTE)SourceSurf->pvScan0 + sy * SourceSurf->lDelta + SourceRect->left * cjPixel,
+                     DstWidth, SrcWidth, DstWidth, cjPixel);
+    }
+
+    return TRUE;
+  }
+
   switch(DestSurf->iBitmapFormat)
   {
   case BMF_1BPP: xxBPPMask = 0x1; break;
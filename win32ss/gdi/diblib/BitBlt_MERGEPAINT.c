@@ -16,7 +16,6 @@ VOID
 FASTCALL
 Dib_BitBlt_MERGEPAINT(PBLTDATA pBltData)
 {
-    // TODO: XLATEless same-surface variants
     gapfnBitBlt_MERGEPAINT[pBltData->siDst.iFormat][pBltData->siSrc.iFormat](pBltData);
 }
 
@@ -16,7 +16,6 @@ VOID
 FASTCALL
 Dib_BitBlt_NOTSRCCOPY(PBLTDATA pBltData)
 {
-    // TODO: XLATEless same-surface variants
     gapfnBitBlt_NOTSRCCOPY[pBltData->siDst.iFormat][pBltData->siSrc.iFormat](pBltData);
 }
 
@@ -16,7 +16,6 @@ VOID
 FASTCALL
 Dib_BitBlt_NOTSRCERASE(PBLTDATA pBltData)
 {
-    // TODO: XLATEless same-surface variants
     gapfnBitBlt_NOTSRCERASE[pBltData->siDst.iFormat][pBltData->siSrc.iFormat](pBltData);
 }
 
@@ -12,6 +12,13 @@
 
 #include "DibLib_AllDstBPP.h"
 
+/* Solid fills of byte sized pixels are done a whole row at once */
+#define Dib_BitBlt_PATCOPY_Solid_D8 Dib_RowFill
+#define Dib_BitBlt_PATCOPY_Solid_D16 Dib_RowFill
+#define Dib_BitBlt_PATCOPY_Solid_D24 Dib_RowFill
+#define Dib_BitBlt_PATCOPY_Solid_D32 Dib_RowFill
+#define Dib_RowFill_manual 1
+
 #undef __FUNCTIONNAME
 #define __FUNCTIONNAME BitBlt_PATCOPY_Solid
 #define __USES_SOLID_BRUSH 1
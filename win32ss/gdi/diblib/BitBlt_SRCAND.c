@@ -1,6 +1,20 @@
 
 #include "DibLib.h"
 
+VOID
+FASTCALL
+Dib_BitBlt_SRCAND_EqSurf(PBLTDATA pBltData)
+{
+    /* Same format and no color translation, combine the bytes directly */
+    Dib_RowOperation(pBltData, DIBROW_AND);
+}
+
+#define Dib_BitBlt_SRCAND_S8_D8_EqSurf Dib_BitBlt_SRCAND_EqSurf
+#define Dib_BitBlt_SRCAND_S16_D16_EqSurf Dib_BitBlt_SRCAND_EqSurf
+#define Dib_BitBlt_SRCAND_S24_D24_EqSurf Dib_BitBlt_SRCAND_EqSurf
+#define Dib_BitBlt_SRCAND_S32_D32_EqSurf Dib_BitBlt_SRCAND_EqSurf
+#define Dib_BitBlt_SRCAND_EqSurf_manual 1
+
 #define __USES_SOURCE 1
 #define __USES_PATTERN 0
 #define __USES_DEST 1
@@ -16,7 +30,6 @@ VOID
 FASTCALL
 Dib_BitBlt_SRCAND(PBLTDATA pBltData)
 {
-    // TODO: XLATEless same-surface variants
     gapfnBitBlt_SRCAND[pBltData->siDst.iFormat][pBltData->siSrc.iFormat](pBltData);
 }
 
@@ -16,7 +16,6 @@ VOID
 FASTCALL
 Dib_BitBlt_SRCERASE(PBLTDATA pBltData)
 {
-    // TODO: XLATEless same-surface variants
     gapfnBitBlt_SRCERASE[pBltData->siDst.iFormat][pBltData->siSrc.iFormat](pBltData);
 }
 
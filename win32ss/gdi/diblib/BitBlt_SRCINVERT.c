@@ -1,6 +1,20 @@
 
 #include "DibLib.h"
 
+VOID
+FASTCALL
+Dib_BitBlt_SRCINVERT_EqSurf(PBLTDATA pBltData)
+{
+    /* Same format and no color translation, combine the bytes directly */
+    Dib_RowOperation(pBltData, DIBROW_XOR);
+}
+
+#define Dib_BitBlt_SRCINVERT_S8_D8_EqSurf Dib_BitBlt_SRCINVERT_EqSurf
+#define Dib_BitBlt_SRCINVERT_S16_D16_EqSurf Dib_BitBlt_SRCINVERT_EqSurf
+#define Dib_BitBlt_SRCINVERT_S24_D24_EqSurf Dib_BitBlt_SRCINVERT_EqSurf
+#define Dib_BitBlt_SRCINVERT_S32_D32_EqSurf Dib_BitBlt_SRCINVERT_EqSurf
+#define Dib_BitBlt_SRCINVERT_EqSurf_manual 1
+
 #define __USES_SOURCE 1
 #define __USES_PATTERN 0
 #define __USES_DEST 1
@@ -16,7 +30,6 @@ VOID
 FASTCALL
 Dib_BitBlt_SRCINVERT(PBLTDATA pBltData)
 {
-    // TODO: XLATEless same-surface variants
     gapfnBitBlt_SRCINVERT[pBltData->siDst.iFormat][pBltData->siSrc.iFormat](pBltData);
 }
 
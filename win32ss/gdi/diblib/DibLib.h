@@ -26,6 +26,17 @@ extern const BYTE ajShift4[2];
 
 #include "DibLib_interface.h"
 
+/* Byte wise operations on whole rows, see RowFunctions.c */
+#define DIBROW_COPY 0
+#define DIBROW_AND 1
+#define DIBROW_OR 2
+#define DIBROW_XOR 3
+#define DIBROW_FILL 4
+#define DIBROW_COUNT 5
+
+VOID FASTCALL Dib_RowOperation(PBLTDATA pBltData, ULONG iRowOp);
+VOID FASTCALL Dib_RowFill(PBLTDATA pBltData);
+
 #define _DibXlate(pBltData, ulColor) (pBltData->pfnXlate(pBltData->pxlo, ulColor))
 
 #define __PASTE_(s1,s2) s1##s2
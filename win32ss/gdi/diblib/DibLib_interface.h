@@ -1,6 +1,10 @@
 
 #include "RopFunctions.h"
 
+/* Vector units the row functions may use, see DibLib_Initialize */
+#define DIBLIB_SIMD_SSE2 0x00000001
+#define DIBLIB_SIMD_AVX2 0x00000002
+
 typedef struct
 {
     ULONG iFormat;
@@ -29,6 +33,7 @@ typedef struct
     PFN_DOROP apfnDoRop[2];
     ULONG ulSolidColor;
     LONG dy;
+    ULONG flSimd;
 } BLTDATA, *PBLTDATA;
 
 typedef
@@ -68,6 +73,9 @@ VOID FASTCALL Dib_MaskPatPaint(PBLTDATA pBltData);
 VOID FASTCALL Dib_MaskSrcPaint(PBLTDATA pBltData);
 VOID FASTCALL Dib_MaskBlt(PBLTDATA pBltData);
 
+VOID FASTCALL DibLib_Initialize(ULONG flSimdAllowed);
+
+extern ULONG gflDibSimd;
 extern const UCHAR gajIndexPerRop[256];
 extern const PFN_DIBFUNCTION gapfnDibFunction[];
 extern const PFN_DIBFUNCTION gapfnMaskFunction[8];
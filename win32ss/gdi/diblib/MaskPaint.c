@@ -16,7 +16,6 @@ VOID
 FASTCALL
 Dib_MaskPaint(PBLTDATA pBltData)
 {
-    // TODO: XLATEless same-surface variants
     gapfnMaskPaint[pBltData->siDst.iFormat](pBltData);
 }
 
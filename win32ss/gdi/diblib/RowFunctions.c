@@ -0,0 +1,341 @@
+
+#include "DibLib.h"
+
+/*
+ * Row functions work on the raw bytes of a line, they are used for blits
+ * between surfaces of the same format without color translation (the
+ * "EqSurf" variants) and for solid fills. Each operation has a portable
+ * version and, on x86 / x64, SSE2 and AVX2 versions selected at runtime.
+ */
+
+#if defined(_M_IX86) || defined(_M_AMD64)
+#define _DIBLIB_SIMD_
+#include <immintrin.h>
+#endif
+
+#ifdef __GNUC__
+#define DIB_TARGET(x) __attribute__((target(x)))
+#else
+#define DIB_TARGET(x)
+#endif
+
+/* A solid fill repeats every 96 bytes for 8, 16, 24 and 32 bpp, which is
+   also a multiple of the 16 and 32 byte vector registers */
+#define DIB_FILL_PERIOD 96
+
+typedef
+VOID
+(*PFN_DIBROW)(PBYTE pjDest, const BYTE *pjSrc, SIZE_T cj);
+
+ULONG gflDibSimd = 0;
+
+static
+VOID
+DibRow_Copy_C(PBYTE pjDest, const BYTE *pjSrc, SIZE_T cj)
+{
+    memcpy(pjDest, pjSrc, cj);
+}
+
+#define DIBROW_C(name, op) \
+static \
+VOID \
+DibRow_##name##_C(PBYTE pjDest, const BYTE *pjSrc, SIZE_T cj) \
+{ \
+    for (; cj >= sizeof(ULONG_PTR); cj -= sizeof(ULONG_PTR)) \
+    { \
+        *(ULONG_PTR UNALIGNED *)pjDest op *(const ULONG_PTR UNALIGNED *)pjSrc; \
+        pjDest += sizeof(ULONG_PTR); \
+        pjSrc += sizeof(ULONG_PTR); \
+    } \
+    while (cj--) *pjDest++ op *pjSrc++; \
+}
+
+DIBROW_C(And, &=)
+DIBROW_C(Or, |=)
+DIBROW_C(Xor, ^=)
+
+/* pjSrc is one period of the fill pattern */
+static
+VOID
+DibRow_Fill_C(PBYTE pjDest, const BYTE *pjSrc, SIZE_T cj)
+{
+    for (; cj >= DIB_FILL_PERIOD; cj -= DIB_FILL_PERIOD)
+    {
+        memcpy(pjDest, pjSrc, DIB_FILL_PERIOD);
+        pjDest += DIB_FILL_PERIOD;
+    }
+    memcpy(pjDest, pjSrc, cj);
+}
+
+#ifdef _DIBLIB_SIMD_
+
+static
+DIB_TARGET("sse2")
+VOID
+DibRow_Copy_SSE2(PBYTE pjDest, const BYTE *pjSrc, SIZE_T cj)
+{
+    __m128i x0, x1, x2, x3;
+
+    for (; cj >= 64; cj -= 64)
+    {
+        x0 = _mm_loadu_si128((const __m128i *)pjSrc);
+        x1 = _mm_loadu_si128((const __m128i *)(pjSrc + 16));
+        x2 = _mm_loadu_si128((const __m128i *)(pjSrc + 32));
+        x3 = _mm_loadu_si128((const __m128i *)(pjSrc + 48));
+        _mm_storeu_si128((__m128i *)pjDest, x0);
+        _mm_storeu_si128((__m128i *)(pjDest + 16), x1);
+        _mm_storeu_si128((__m128i *)(pjDest + 32), x2);
+        _mm_storeu_si128((__m128i *)(pjDest + 48), x3);
+        pjDest += 64;
+        pjSrc += 64;
+    }
+    for (; cj >= 16; cj -= 16)
+    {
+        _mm_storeu_si128((__m128i *)pjDest, _mm_loadu_si128((const __m128i *)pjSrc));
+        pjDest += 16;
+        pjSrc += 16;
+    }
+    memcpy(pjDest, pjSrc, cj);
+}
+
+#define DIBROW_SSE2(name, intrinsic) \
+static \
+DIB_TARGET("sse2") \
+VOID \
+DibRow_##name##_SSE2(PBYTE pjDest, const BYTE *pjSrc, SIZE_T cj) \
+{ \
+    __m128i x0, x1; \
+    for (; cj >= 32; cj -= 32) \
+    { \
+        x0 = intrinsic(_mm_loadu_si128((const __m128i *)pjDest), \
+                       _mm_loadu_si128((const __m128i *)pjSrc)); \
+        x1 = intrinsic(_mm_loadu_si128((const __m128i *)(pjDest + 16)), \
+                       _mm_loadu_si128((const __m128i *)(pjSrc + 16))); \
+        _mm_storeu_si128((__m128i *)pjDest, x0); \
+        _mm_storeu_si128((__m128i *)(pjDest + 16), x1); \
+        pjDest += 32; \
+        pjSrc += 32; \
+    } \
+    DibRow_##name##_C(pjDest, pjSrc, cj); \
+}
+
+DIBROW_SSE2(And, _mm_and_si128)
+DIBROW_SSE2(Or, _mm_or_si128)
+DIBROW_SSE2(Xor, _mm_xor_si128)
+
+static
+DIB_TARGET("sse2")
+VOID
+DibRow_Fill_SSE2(PBYTE pjDest, const BYTE *pjSrc, SIZE_T cj)
+{
+    __m128i x0, x1, x2, x3, x4, x5;
+
+    x0 = _mm_loadu_si128((const __m128i *)pjSrc);
+    x1 = _mm_loadu_si128((const __m128i *)(pjSrc + 16));
+    x2 = _mm_loadu_si128((const __m128i *)(pjSrc + 32));
+    x3 = _mm_loadu_si128((const __m128i *)(pjSrc + 48));
+    x4 = _mm_loadu_si128((const __m128i *)(pjSrc + 64));
+    x5 = _mm_loadu_si128((const __m128i *)(pjSrc + 80));
+
+    for (; cj >= DIB_FILL_PERIOD; cj -= DIB_FILL_PERIOD)
+    {
+        _mm_storeu_si128((__m128i *)pjDest, x0);
+        _mm_storeu_si128((__m128i *)(pjDest + 16), x1);
+        _mm_storeu_si128((__m128i *)(pjDest + 32), x2);
+        _mm_storeu_si128((__m128i *)(pjDest + 48), x3);
+        _mm_storeu_si128((__m128i *)(pjDest + 64), x4);
+        _mm_storeu_si128((__m128i *)(pjDest + 80), x5);
+        pjDest += DIB_FILL_PERIOD;
+    }
+    memcpy(pjDest, pjSrc, cj);
+}
+
+static
+DIB_TARGET("avx2")
+VOID
+DibRow_Copy_AVX2(PBYTE pjDest, const BYTE *pjSrc, SIZE_T cj)
+{
+    __m256i y0, y1, y2, y3;
+
+    for (; cj >= 128; cj -= 128)
+    {
+        y0 = _mm256_loadu_si256((const __m256i *)pjSrc);
+        y1 = _mm256_loadu_si256((const __m256i *)(pjSrc + 32));
+        y2 = _mm256_loadu_si256((const __m256i *)(pjSrc + 64));
+        y3 = _mm256_loadu_si256((const __m256i *)(pjSrc + 96));
+        _mm256_storeu_si256((__m256i *)pjDest, y0);
+        _mm256_storeu_si256((__m256i *)(pjDest + 32), y1);
+        _mm256_storeu_si256((__m256i *)(pjDest + 64), y2);
+        _mm256_storeu_si256((__m256i *)(pjDest + 96), y3);
+        pjDest += 128;
+        pjSrc += 128;
+    }
+    for (; cj >= 32; cj -= 32)
+    {
+        _mm256_storeu_si256((__m256i *)pjDest, _mm256_loadu_si256((const __m256i *)pjSrc));
+        pjDest += 32;
+        pjSrc += 32;
+    }
+    _mm256_zeroupper();
+    memcpy(pjDest, pjSrc, cj);
+}
+
+#define DIBROW_AVX2(name, intrinsic) \
+static \
+DIB_TARGET("avx2") \
+VOID \
+DibRow_##name##_AVX2(PBYTE pjDest, const BYTE *pjSrc, SIZE_T cj) \
+{ \
+    __m256i y0, y1; \
+    for (; cj >= 64; cj -= 64) \
+    { \
+        y0 = intrinsic(_mm256_loadu_si256((const __m256i *)pjDest), \
+                       _mm256_loadu_si256((const __m256i *)pjSrc)); \
+        y1 = intrinsic(_mm256_loadu_si256((const __m256i *)(pjDest + 32)), \
+                       _mm256_loadu_si256((const __m256i *)(pjSrc + 32))); \
+        _mm256_storeu_si256((__m256i *)pjDest, y0); \
+        _mm256_storeu_si256((__m256i *)(pjDest + 32), y1); \
+        pjDest += 64; \
+        pjSrc += 64; \
+    } \
+    _mm256_zeroupper(); \
+    DibRow_##name##_C(pjDest, pjSrc, cj); \
+}
+
+DIBROW_AVX2(And, _mm256_and_si256)
+DIBROW_AVX2(Or, _mm256_or_si256)
+DIBROW_AVX2(Xor, _mm256_xor_si256)
+
+static
+DIB_TARGET("avx2")
+VOID
+DibRow_Fill_AVX2(PBYTE pjDest, const BYTE *pjSrc, SIZE_T cj)
+{
+    __m256i y0, y1, y2;
+
+    y0 = _mm256_loadu_si256((const __m256i *)pjSrc);
+    y1 = _mm256_loadu_si256((const __m256i *)(pjSrc + 32));
+    y2 = _mm256_loadu_si256((const __m256i *)(pjSrc + 64));
+
+    for (; cj >= DIB_FILL_PERIOD; cj -= DIB_FILL_PERIOD)
+    {
+        _mm256_storeu_si256((__m256i *)pjDest, y0);
+        _mm256_storeu_si256((__m256i *)(pjDest + 32), y1);
+        _mm256_storeu_si256((__m256i *)(pjDest + 64), y2);
+        pjDest += DIB_FILL_PERIOD;
+    }
+    _mm256_zeroupper();
+    memcpy(pjDest, pjSrc, cj);
+}
+
+#endif /* _DIBLIB_SIMD_ */
+
+static const PFN_DIBROW gapfnDibRow[][DIBROW_COUNT] =
+{
+    {DibRow_Copy_C, DibRow_And_C, DibRow_Or_C, DibRow_Xor_C, DibRow_Fill_C},
+#ifdef _DIBLIB_SIMD_
+    {DibRow_Copy_SSE2, DibRow_And_SSE2, DibRow_Or_SSE2, DibRow_Xor_SSE2, DibRow_Fill_SSE2},
+    {DibRow_Copy_AVX2, DibRow_And_AVX2, DibRow_Or_AVX2, DibRow_Xor_AVX2, DibRow_Fill_AVX2},
+#endif
+};
+
+static
+PFN_DIBROW
+DibGetRowFunction(ULONG flSimd, ULONG iRowOp)
+{
+#ifdef _DIBLIB_SIMD_
+    if (flSimd & DIBLIB_SIMD_AVX2)
+        return gapfnDibRow[2][iRowOp];
+    if (flSimd & DIBLIB_SIMD_SSE2)
+        return gapfnDibRow[1][iRowOp];
+#endif
+    return gapfnDibRow[0][iRowOp];
+}
+
+/*
+ * Detects the vector units of the processor. flSimdAllowed limits them to
+ * what the caller can use, e.g. kernel code must not touch the AVX state.
+ * Each blit then only uses the ones given in BLTDATA::flSimd.
+ */
+VOID
+FASTCALL
+DibLib_Initialize(ULONG flSimdAllowed)
+{
+    ULONG flSimd = 0;
+#ifdef _DIBLIB_SIMD_
+    INT aiCpuInfo[4];
+    INT iMaxLeaf;
+
+    __cpuid(aiCpuInfo, 0);
+    iMaxLeaf = aiCpuInfo[0];
+
+    __cpuid(aiCpuInfo, 1);
+    if (aiCpuInfo[3] & (1 << 26))
+    {
+        flSimd |= DIBLIB_SIMD_SSE2;
+
+        /* AVX2 also needs the OS to save the YMM registers (OSXSAVE, XCR0) */
+        if ((iMaxLeaf >= 7) &&
+            (aiCpuInfo[2] & (1 << 27)) &&
+            (aiCpuInfo[2] & (1 << 28)) &&
+            ((_xgetbv(0) & 6) == 6))
+        {
+            __cpuidex(aiCpuInfo, 7, 0);
+            if (aiCpuInfo[1] & (1 << 5))
+                flSimd |= DIBLIB_SIMD_AVX2;
+        }
+    }
+#endif
+
+    gflDibSimd = flSimd & flSimdAllowed;
+}
+
+VOID
+FASTCALL
+Dib_RowOperation(PBLTDATA pBltData, ULONG iRowOp)
+{
+    PFN_DIBROW pfnRow = DibGetRowFunction(pBltData->flSimd, iRowOp);
+    PBYTE pjDestBase = pBltData->siDst.pjBase;
+    PBYTE pjSrcBase = pBltData->siSrc.pjBase;
+    SIZE_T cjWidth;
+    ULONG cLines;
+
+    /* Calculate the width in bytes */
+    cjWidth = pBltData->ulWidth * pBltData->siDst.jBpp / 8;
+
+    /* Loop all lines */
+    cLines = pBltData->ulHeight;
+    while (cLines--)
+    {
+        pfnRow(pjDestBase, pjSrcBase, cjWidth);
+        pjDestBase += pBltData->siDst.cjAdvanceY;
+        pjSrcBase += pBltData->siSrc.cjAdvanceY;
+    }
+}
+
+VOID
+FASTCALL
+Dib_RowFill(PBLTDATA pBltData)
+{
+    PFN_DIBROW pfnRow = DibGetRowFunction(pBltData->flSimd, DIBROW_FILL);
+    PBYTE pjDestBase = pBltData->siDst.pjBase;
+    BYTE ajPattern[DIB_FILL_PERIOD];
+    ULONG i, cjPixel, cLines;
+    SIZE_T cjWidth;
+
+    /* Repeat the color over a whole period, the bytes are in memory order */
+    cjPixel = pBltData->siDst.jBpp / 8;
+    for (i = 0; i < DIB_FILL_PERIOD; i++)
+        ajPattern[i] = (BYTE)(pBltData->ulSolidColor >> ((i % cjPixel) * 8));
+
+    /* Calculate the width in bytes */
+    cjWidth = pBltData->ulWidth * cjPixel;
+
+    /* Loop all lines */
+    cLines = pBltData->ulHeight;
+    while (cLines--)
+    {
+        pfnRow(pjDestBase, ajPattern, cjWidth);
+        pjDestBase += pBltData->siDst.cjAdvanceY;
+    }
+}
@@ -16,7 +16,6 @@ VOID
 FASTCALL
 Dib_SrcPaint(PBLTDATA pBltData)
 {
-    // TODO: XLATEless same-surface variants
     gapfnSrcPaint[pBltData->siDst.iFormat][pBltData->siSrc.iFormat](pBltData);
 }
 
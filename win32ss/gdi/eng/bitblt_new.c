@@ -89,12 +89,29 @@ CalculateCoordinates(
         /* Check for right-to-left case */
         if (pbltdata->siDst.iFormat == 0)
         {
-            pbltdata->siPat.pjBase += (psizlPat->cx - 1) * pbltdata->siMsk.jBpp / 8;
+            pbltdata->siPat.pjBase += (psizlPat->cx - 1) * pbltdata->siPat.jBpp / 8;
             pbltdata->siPat.ptOrig.x = psizlPat->cx - 1 - pbltdata->siPat.ptOrig.x;
         }
     }
 }
 
+/* Below this many pixels saving the FPU state costs more than it gains */
+#define DIB_SIMD_MIN_PIXELS 4096
+
+static
+BOOL
+IntDibUsesSimd(PFN_DIBFUNCTION pfnBitBlt)
+{
+    /* These have row functions for same format blits and solid fills */
+    return (pfnBitBlt == Dib_BitBlt_SRCCOPY) ||
+           (pfnBitBlt == Dib_BitBlt_SRCAND) ||
+           (pfnBitBlt == Dib_BitBlt_SRCPAINT) ||
+           (pfnBitBlt == Dib_BitBlt_SRCINVERT) ||
+           (pfnBitBlt == Dib_BitBlt_PATCOPY) ||
+           (pfnBitBlt == Dib_BitBlt_BLACKNESS) ||
+           (pfnBitBlt == Dib_BitBlt_WHITENESS);
+}
+
 BOOL
 APIENTRY
 EngBitBlt(
@@ -118,6 +135,10 @@ EngBitBlt(
     RECT_ENUM rcenum;
     PSIZEL psizlPat;
     SURFOBJ *psoPattern;
+#ifdef _M_IX86
+    KFLOATING_SAVE FloatSave;
+    BOOL bFloatSaved = FALSE;
+#endif
 
 //static int count = 0;
 //if (++count >= 1230) __debugbreak();
@@ -183,6 +204,14 @@ EngBitBlt(
                 bltdata.siSrc.iFormat = 0;
             }
         }
+        else if ((psoSrc->iBitmapFormat == psoTrg->iBitmapFormat) &&
+                 (pxlo->flXlate & XO_TRIVIAL))
+        {
+            /* Same format without color translation, the equal surface
+               versions work on the raw bits as well */
+            bltdata.siDst.iFormat = psoTrg->iBitmapFormat;
+            bltdata.siSrc.iFormat = 0;
+        }
         else
         {
             bltdata.siDst.iFormat = psoTrg->iBitmapFormat;
@@ -222,7 +251,7 @@ EngBitBlt(
             psoPattern = BRUSHOBJ_psoPattern(pbo);
             if (!psoPattern)
             {
-                __debugbreak();
+                ERR("Failed to realize the pattern brush\n");
                 return FALSE;
             }
 
@@ -250,26 +279,32 @@ EngBitBlt(
         psizlPat = NULL;
     }
 
-    /* Check if the ROP uses a mask */
-    if (ROP4_USES_MASK(rop4))
+    /* Check if the ROP uses a mask, but we don't have a mask surface */
+    if (ROP4_USES_MASK(rop4) && (psoMask == NULL))
     {
-        //__debugbreak();
+        /* Must have a brush */
+        NT_ASSERT(pbo); // FIXME: test this!
 
-        /* Check if we don't have a mask surface */
+        /* Check if the BRUSHOBJ can provide the mask */
+        psoMask = BRUSHOBJ_psoMask(pbo);
         if (psoMask == NULL)
         {
-            /* Must have a brush */
-            NT_ASSERT(pbo); // FIXME: test this!
-
-            /* Check if the BRUSHOBJ can provide the mask */
-            psoMask = BRUSHOBJ_psoMask(pbo);
-            if (psoMask == NULL)
-            {
-                /* We have no mask, assume the mask is all foreground */
-                rop4 = (rop4 & 0xFF) || ((rop4 & 0xFF) << 8);
-            }
+            /* We have no mask, assume the mask is all foreground */
+            rop4 = (rop4 & 0xFF) | ((rop4 & 0xFF) << 8);
+            bltdata.rop4 = rop4;
+            bltdata.apfnDoRop[0] = bltdata.apfnDoRop[1];
+            pptlMask = NULL;
         }
+        else if (pptlMask == NULL)
+        {
+            /* The brush mask is aligned like the pattern */
+            pptlMask = pptlBrush;
+        }
+    }
 
+    /* Check if the ROP uses a mask */
+    if (ROP4_USES_MASK(rop4))
+    {
         /* Set the mask format info */
         bltdata.siMsk.iFormat = psoMask->iBitmapFormat;
         bltdata.siMsk.pvScan0 = psoMask->pvScan0;
@@ -294,6 +329,24 @@ EngBitBlt(
         pfnBitBlt = gapfnDibFunction[iFunctionIndex];
     }
 
+    /* Let the row functions use the vector units */
+    bltdata.flSimd = IntDibUsesSimd(pfnBitBlt) ? gflDibSimd : 0;
+#ifdef _M_IX86
+    /* The FPU state of the thread is only saved for user mode on x86 */
+    if (bltdata.flSimd)
+    {
+        if (((ULONGLONG)(rcTrg.right - rcTrg.left) * (rcTrg.bottom - rcTrg.top) >= DIB_SIMD_MIN_PIXELS) &&
+            NT_SUCCESS(KeSaveFloatingPointState(&FloatSave)))
+        {
+            bFloatSaved = TRUE;
+        }
+        else
+        {
+            bltdata.flSimd = 0;
+        }
+    }
+#endif
+
     /* If no clip object is given, use trivial one */
     if (!pco) pco = (CLIPOBJ*)&gxcoTrivial;
 
@@ -352,6 +405,11 @@ EngBitBlt(
         bEnumMore = CLIPOBJ_bEnum(pco, sizeof(rcenum), (ULONG*)&rcenum);
     }
 
+#ifdef _M_IX86
+    if (bFloatSaved)
+        KeRestoreFloatingPointState(&FloatSave);
+#endif
+
     return TRUE;
 }
 
@@ -129,9 +129,12 @@ typedef struct _SHARED_FACE_CACHE {
 } SHARED_FACE_CACHE, *PSHARED_FACE_CACHE;
 
 typedef struct _SHARED_FACE {
-  FT_Face       Face;
+  FT_Face       Face;           /* NULL until first used, see SharedFace_GetFace */
   LONG          RefCount;
   PSHARED_MEM   Memory;
+  FT_Long       FaceIndex;
+  BOOLEAN       LoadFailed;
+  LIST_ENTRY    GlyphCacheHead;
   SHARED_FACE_CACHE EnglishUS;
   SHARED_FACE_CACHE UserLanguage;
 } SHARED_FACE, *PSHARED_FACE;
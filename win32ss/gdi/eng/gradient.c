@@ -60,6 +60,8 @@ IntEngGradientFillRect(
     POINTL Translate;
     INTENG_ENTER_LEAVE EnterLeave;
     LONG y, dy, c[3], dc[3], ec[3], ic[3];
+    PBYTE pjRow = NULL;
+    ULONG cjPixel = 0;
 
     v1 = (pVertex + gRect->UpperLeft);
     v2 = (pVertex + gRect->LowerRight);
@@ -87,6 +89,60 @@ IntEngGradientFillRect(
 
     if((v1->Red != v2->Red || v1->Green != v2->Green || v1->Blue != v2->Blue) && dy > 1)
     {
+        /* The colors of a horizontal gradient only depend on x, so on 16 and
+           32bpp surfaces one row is computed and copied to every line */
+        if (Horizontal &&
+            (psoOutput->iBitmapFormat == BMF_16BPP || psoOutput->iBitmapFormat == BMF_32BPP))
+        {
+            cjPixel = BitsPerFormat(psoOutput->iBitmapFormat) / 8;
+            pjRow = ExAllocatePoolWithTag(PagedPool, dy * cjPixel, GDITAG_TEMP);
+        }
+
+        if (pjRow)
+        {
+            ULONG Color;
+
+            HVINITCOL(Red, 0);
+            HVINITCOL(Green, 1);
+            HVINITCOL(Blue, 2);
+
+            for (y = 0; y < dy; y++)
+            {
+                Color = XLATEOBJ_iXlate(pxlo, RGB(c[0], c[1], c[2]));
+                if (cjPixel == 4)
+                    ((PULONG)pjRow)[y] = Color;
+                else
+                    ((PUSHORT)pjRow)[y] = (USHORT)Color;
+                HVSTEPCOL(0);
+                HVSTEPCOL(1);
+                HVSTEPCOL(2);
+            }
+
+            CLIPOBJ_cEnumStart(pco, FALSE, CT_RECTANGLES, CD_RIGHTDOWN, 0);
+            do
+            {
+                RECTL FillRect;
+
+                EnumMore = CLIPOBJ_bEnum(pco, (ULONG) sizeof(RectEnum), (PVOID) &RectEnum);
+                for (i = 0; i < RectEnum.c && RectEnum.arcl[i].top <= rcSG.bottom; i++)
+                {
+                    if (RECTL_bIntersectRect(&FillRect, &RectEnum.arcl[i], &rcSG))
+                    {
+                        DIB_vFillRectFromRow(psoOutput,
+                                             FillRect.left + Translate.x,
+                                             FillRect.top + Translate.y,
+                                             FillRect.bottom + Translate.y,
+                                             pjRow + (FillRect.left - rcSG.left) * cjPixel,
+                                             (FillRect.right - FillRect.left) * cjPixel);
+                    }
+                }
+            }
+            while (EnumMore);
+
+            ExFreePoolWithTag(pjRow, GDITAG_TEMP);
+            return IntEngLeave(&EnterLeave);
+        }
+
         CLIPOBJ_cEnumStart(pco, FALSE, CT_RECTANGLES, CD_RIGHTDOWN, 0);
         do
         {
@@ -19,6 +19,32 @@ EXLATEOBJ_iXlateTrivial(
     _In_ PEXLATEOBJ pexlo,
     _In_ ULONG iColor);
 
+/*
+ * Translation table from an indexed palette, cached in the source palette
+ * and reused as long as neither of the palettes changes its colors.
+ */
+typedef struct _XLATETABLE
+{
+    ULONG ulSrcUnique;
+    ULONG ulDstUnique;
+    ULONG cEntries;
+    BOOL bTrivial;
+    ULONG aulXlate[ANYSIZE_ARRAY];
+} XLATETABLE, *PXLATETABLE;
+
+/*
+ * Nearest index cache of an indexed destination palette. The cells are
+ * addressed by the upper 5 bits of each channel and tagged with the lower
+ * 3, so that a hit gives exactly what the palette search would. The tag
+ * also holds the low bits of the palette's ulColorsUnique, so an entry
+ * stored for the old colors while the cache was being reset never hits.
+ */
+#define INVERSE_CELLS 0x8000
+#define INVERSE_VALID 0x80000000
+#define INVERSE_UNIQUE_SHIFT 25
+#define INVERSE_UNIQUE_MASK 0x3F
+#define INVERSE_MIN_COLORS 16
+
 /** Globals *******************************************************************/
 
 EXLATEOBJ gexloTrivial = {{0, XO_TRIVIAL, 0, 0, 0, 0}, EXLATEOBJ_iXlateTrivial};
@@ -38,6 +64,36 @@ static const BYTE gajXlate6to8[64] =
 
 /** iXlate functions **********************************************************/
 
+static
+ULONG
+EXLATEOBJ_iNearestIndex(
+    _In_ PEXLATEOBJ pexlo,
+    _In_ ULONG iColor)
+{
+    ULONG iCell, ulTag, ulEntry;
+
+    if (!pexlo->pulInverse)
+        return PALETTE_ulGetNearestPaletteIndex(pexlo->ppalDst, iColor);
+
+    iColor &= 0xFFFFFF;
+    iCell = ((iColor >> 3) & 0x1F) | ((iColor >> 6) & 0x3E0) | ((iColor >> 9) & 0x7C00);
+    ulTag = INVERSE_VALID |
+            ((pexlo->ulInverseUnique & INVERSE_UNIQUE_MASK) << INVERSE_UNIQUE_SHIFT) |
+            (((iColor & 0x7) | ((iColor >> 5) & 0x38) | ((iColor >> 10) & 0x1C0)) << 16);
+
+    ulEntry = pexlo->pulInverse[iCell];
+    if ((ulEntry & 0xFFFF0000) == ulTag)
+        return ulEntry & 0xFFFF;
+
+    ulEntry = PALETTE_ulGetNearestPaletteIndex(pexlo->ppalDst, iColor);
+
+    /* Don't store results for colors that were changed meanwhile */
+    if (pexlo->ulInverseUnique == pexlo->ppalDst->ulColorsUnique)
+        pexlo->pulInverse[iCell] = ulTag | ulEntry;
+
+    return ulEntry;
+}
+
 _Post_satisfies_(return==iColor)
 _Function_class_(FN_XLATE)
 ULONG
@@ -179,7 +235,7 @@ ULONG
 FASTCALL
 EXLATEOBJ_iXlateRGBtoPal(PEXLATEOBJ pexlo, ULONG iColor)
 {
-    return PALETTE_ulGetNearestPaletteIndex(pexlo->ppalDst, iColor);
+    return EXLATEOBJ_iNearestIndex(pexlo, iColor);
 }
 
 _Function_class_(FN_XLATE)
@@ -252,7 +308,7 @@ EXLATEOBJ_iXlate555toPal(PEXLATEOBJ pexlo, ULONG iColor)
 {
     iColor = EXLATEOBJ_iXlate555toRGB(pexlo, iColor);
 
-    return PALETTE_ulGetNearestPaletteIndex(pexlo->ppalDst, iColor);
+    return EXLATEOBJ_iNearestIndex(pexlo, iColor);
 }
 
 _Function_class_(FN_XLATE)
@@ -321,7 +377,7 @@ EXLATEOBJ_iXlate565toPal(EXLATEOBJ *pexlo, ULONG iColor)
 {
     iColor = EXLATEOBJ_iXlate565toRGB(pexlo, iColor);
 
-    return PALETTE_ulGetNearestPaletteIndex(pexlo->ppalDst, iColor);
+    return EXLATEOBJ_iNearestIndex(pexlo, iColor);
 }
 
 _Function_class_(FN_XLATE)
@@ -347,12 +403,127 @@ EXLATEOBJ_iXlateBitfieldsToPal(PEXLATEOBJ pexlo, ULONG iColor)
     iColor = EXLATEOBJ_iXlateShiftAndMask(pexlo, iColor);
 
     /* Return nearest index */
-    return PALETTE_ulGetNearestPaletteIndex(pexlo->ppalDst, iColor);
+    return EXLATEOBJ_iNearestIndex(pexlo, iColor);
 }
 
 
 /** Private Functions *********************************************************/
 
+/* Returns the nearest index cache of an indexed palette, NULL if it has none */
+static
+PULONG
+EXLATEOBJ_pulGetInverse(
+    _In_ PPALETTE ppal,
+    _Out_ PULONG pulUnique)
+{
+    PULONG pulInverse;
+    ULONG ulUnique;
+
+    *pulUnique = 0;
+
+    /* Small palettes are searched quickly enough */
+    if (ppal->NumColors <= INVERSE_MIN_COLORS)
+        return NULL;
+
+    pulInverse = ppal->pulInverse;
+    if (!pulInverse)
+    {
+        pulInverse = EngAllocMem(FL_ZERO_MEMORY,
+                                 INVERSE_CELLS * sizeof(ULONG),
+                                 GDITAG_PXLATE);
+        if (!pulInverse)
+            return NULL;
+
+        if (InterlockedCompareExchangePointer((PVOID*)&ppal->pulInverse,
+                                              pulInverse,
+                                              NULL) != NULL)
+        {
+            /* Someone else was faster */
+            EngFreeMem(pulInverse);
+            pulInverse = ppal->pulInverse;
+        }
+    }
+
+    /* Forget the results for the previous colors. Entries that are still
+       being stored for them carry the old tag and are simply missed. */
+    ulUnique = ppal->ulColorsUnique;
+    if (ppal->ulInverseUnique != ulUnique)
+    {
+        RtlZeroMemory(pulInverse, INVERSE_CELLS * sizeof(ULONG));
+        ppal->ulInverseUnique = ulUnique;
+    }
+
+    *pulUnique = ulUnique;
+    return pulInverse;
+}
+
+/* Copies the table cached for this pair of palettes, if there is one */
+static
+BOOL
+EXLATEOBJ_bGetCachedTable(
+    _In_ PPALETTE ppalSrc,
+    _In_ PPALETTE ppalDst,
+    _Out_writes_(cEntries) PULONG pulXlate,
+    _In_ ULONG cEntries,
+    _Out_ PBOOL pbTrivial)
+{
+    PXLATETABLE pTable;
+    BOOL bFound = FALSE;
+
+    /* Take it out, so that nobody frees it meanwhile */
+    pTable = InterlockedExchangePointer((PVOID*)&ppalSrc->pXlateTable, NULL);
+    if (!pTable)
+        return FALSE;
+
+    if (pTable->ulSrcUnique == ppalSrc->ulColorsUnique &&
+        pTable->ulDstUnique == ppalDst->ulColorsUnique &&
+        pTable->cEntries == cEntries)
+    {
+        RtlCopyMemory(pulXlate, pTable->aulXlate, cEntries * sizeof(ULONG));
+        *pbTrivial = pTable->bTrivial;
+        bFound = TRUE;
+    }
+
+    /* Put it back, unless a new one was cached meanwhile */
+    if (InterlockedCompareExchangePointer((PVOID*)&ppalSrc->pXlateTable,
+                                          pTable,
+                                          NULL) != NULL)
+    {
+        EngFreeMem(pTable);
+    }
+
+    return bFound;
+}
+
+static
+VOID
+EXLATEOBJ_vCacheTable(
+    _In_ PPALETTE ppalSrc,
+    _In_ PPALETTE ppalDst,
+    _In_reads_(cEntries) PULONG pulXlate,
+    _In_ ULONG cEntries,
+    _In_ BOOL bTrivial)
+{
+    PXLATETABLE pTable;
+
+    pTable = EngAllocMem(0,
+                         FIELD_OFFSET(XLATETABLE, aulXlate[cEntries]),
+                         GDITAG_PXLATE);
+    if (!pTable)
+        return;
+
+    pTable->ulSrcUnique = ppalSrc->ulColorsUnique;
+    pTable->ulDstUnique = ppalDst->ulColorsUnique;
+    pTable->cEntries = cEntries;
+    pTable->bTrivial = bTrivial;
+    RtlCopyMemory(pTable->aulXlate, pulXlate, cEntries * sizeof(ULONG));
+
+    /* Replace the previous one */
+    pTable = InterlockedExchangePointer((PVOID*)&ppalSrc->pXlateTable, pTable);
+    if (pTable)
+        EngFreeMem(pTable);
+}
+
 VOID
 NTAPI
 EXLATEOBJ_vInitialize(
@@ -375,6 +546,8 @@ EXLATEOBJ_vInitialize(
     pexlo->xlo.pulXlate = pexlo->aulXlate;
     pexlo->pfnXlate = EXLATEOBJ_iXlateTrivial;
     pexlo->hColorTransform = NULL;
+    pexlo->pulInverse = NULL;
+    pexlo->ulInverseUnique = 0;
     pexlo->ppalSrc = ppalSrc;
     pexlo->ppalDst = ppalDst;
     pexlo->xlo.iSrcType = (USHORT)ppalSrc->flFlags;
@@ -453,6 +626,8 @@ EXLATEOBJ_vInitialize(
     }
     else if (ppalSrc->flFlags & PAL_INDEXED)
     {
+        BOOL bTrivial = FALSE;
+
         cEntries = ppalSrc->NumColors;
 
         /* Allocate buffer if needed */
@@ -474,7 +649,11 @@ EXLATEOBJ_vInitialize(
         pexlo->xlo.cEntries = cEntries;
         pexlo->xlo.flXlate |= XO_TABLE;
 
-        if (ppalDst->flFlags & PAL_INDEXED)
+        if (EXLATEOBJ_bGetCachedTable(ppalSrc, ppalDst, pexlo->xlo.pulXlate, cEntries, &bTrivial))
+        {
+            /* Nothing changed since the last time */
+        }
+        else if (ppalDst->flFlags & PAL_INDEXED)
         {
             ULONG cDiff = 0;
 
@@ -490,19 +669,8 @@ EXLATEOBJ_vInitialize(
                 if (pexlo->xlo.pulXlate[i] != i) cDiff++;
             }
 
-            /* Check if we have only trivial mappings */
-            if (cDiff == 0)
-            {
-                if (pexlo->xlo.pulXlate != pexlo->aulXlate)
-                {
-                    EngFreeMem(pexlo->xlo.pulXlate);
-                    pexlo->xlo.pulXlate = pexlo->aulXlate;
-                }
-                pexlo->pfnXlate = EXLATEOBJ_iXlateTrivial;
-                pexlo->xlo.flXlate = XO_TRIVIAL;
-                pexlo->xlo.cEntries = 0;
-                return;
-            }
+            bTrivial = (cDiff == 0);
+            EXLATEOBJ_vCacheTable(ppalSrc, ppalDst, pexlo->xlo.pulXlate, cEntries, bTrivial);
         }
         else
         {
@@ -513,6 +681,22 @@ EXLATEOBJ_vInitialize(
                               ppalSrc->IndexedColors[i].peBlue);
                 pexlo->xlo.pulXlate[i] = PALETTE_ulGetNearestBitFieldsIndex(ppalDst, ulColor);
             }
+
+            EXLATEOBJ_vCacheTable(ppalSrc, ppalDst, pexlo->xlo.pulXlate, cEntries, FALSE);
+        }
+
+        /* Check if we have only trivial mappings */
+        if (bTrivial)
+        {
+            if (pexlo->xlo.pulXlate != pexlo->aulXlate)
+            {
+                EngFreeMem(pexlo->xlo.pulXlate);
+                pexlo->xlo.pulXlate = pexlo->aulXlate;
+            }
+            pexlo->pfnXlate = EXLATEOBJ_iXlateTrivial;
+            pexlo->xlo.flXlate = XO_TRIVIAL;
+            pexlo->xlo.cEntries = 0;
+            return;
         }
     }
     else if (ppalSrc->flFlags & PAL_RGB)
@@ -599,6 +783,13 @@ EXLATEOBJ_vInitialize(
             pexlo->pfnXlate = EXLATEOBJ_iXlateTrivial;
     }
 
+    /* Colors from a non-indexed source are looked up through the cache */
+    if (!(ppalSrc->flFlags & PAL_INDEXED) && (ppalDst->flFlags & PAL_INDEXED) &&
+        !(ppalDst->flFlags & PAL_MONOCHROME))
+    {
+        pexlo->pulInverse = EXLATEOBJ_pulGetInverse(ppalDst, &pexlo->ulInverseUnique);
+    }
+
     /* Check for trivial xlate */
     if (pexlo->pfnXlate == EXLATEOBJ_iXlateTrivial)
         pexlo->xlo.flXlate = XO_TRIVIAL;
@@ -28,6 +28,10 @@ typedef struct _EXLATEOBJ
 
     HANDLE hColorTransform;
 
+    /* Nearest index cache of ppalDst, for translations to an indexed palette */
+    PULONG pulInverse;
+    ULONG ulInverseUnique;
+
     union
     {
         ULONG aulXlate[6];
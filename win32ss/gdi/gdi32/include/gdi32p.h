@@ -402,6 +402,11 @@ GdiAllocBatchCommand(
     else if (Cmd == GdiBCSelObj) cjSize = sizeof(GDIBSOBJECT);
     else if (Cmd == GdiBCDelRgn) cjSize = sizeof(GDIBSOBJECT);
     else if (Cmd == GdiBCDelObj) cjSize = sizeof(GDIBSOBJECT);
+    else if (Cmd == GdiBCLineTo) cjSize = sizeof(GDIBSLINETO);
+    else if (Cmd == GdiBCPolyline) cjSize = sizeof(GDIBSPOLYLINE);
+    else if (Cmd == GdiBCRectangle) cjSize = sizeof(GDIBSRECTANGLE);
+    else if (Cmd == GdiBCSetPixel) cjSize = sizeof(GDIBSSETPIXEL);
+    else if (Cmd == GdiBCBitBlt) cjSize = sizeof(GDIBSBITBLT);
     else cjSize = 0;
 
     /* Unsupported operation */
@@ -446,6 +451,25 @@ GdiAllocBatchCommand(
     return pHdr;
 }
 
+FORCEINLINE
+VOID
+GdiSnapshotDrawAttributes(
+    PDC_ATTR pdcattr,
+    PGDIBSDRAWATTR pAttr)
+{
+    pAttr->hbrush          = pdcattr->hbrush;
+    pAttr->hpen            = pdcattr->hpen;
+    pAttr->crForegroundClr = pdcattr->crForegroundClr;
+    pAttr->crBackgroundClr = pdcattr->crBackgroundClr;
+    pAttr->crBrushClr      = pdcattr->crBrushClr;
+    pAttr->crPenClr        = pdcattr->crPenClr;
+    pAttr->ulForegroundClr = pdcattr->ulForegroundClr;
+    pAttr->ulBackgroundClr = pdcattr->ulBackgroundClr;
+    pAttr->ulBrushClr      = pdcattr->ulBrushClr;
+    pAttr->ulPenClr        = pdcattr->ulPenClr;
+    pAttr->lBkMode         = pdcattr->lBkMode;
+}
+
 FORCEINLINE
 PDC_ATTR
 GdiGetDcAttr(HDC hdc)
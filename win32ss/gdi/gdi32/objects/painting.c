@@ -11,10 +11,41 @@ LineTo(
     _In_ INT x,
     _In_ INT y )
 {
+    PDC_ATTR pdcattr;
+
     HANDLE_METADC(BOOL, LineTo, FALSE, hdc, x, y);
 
     if ( GdiConvertAndCheckDC(hdc) == NULL ) return FALSE;
 
+    /* Get the DC attribute */
+    pdcattr = GdiGetDcAttr(hdc);
+    /* Only batch when the current position is known in logical units */
+    if (pdcattr &&
+        !(pdcattr->ulDirty_ & (DC_DIBSECTION|DIRTY_PTLCURRENT)))
+    {
+        PGDIBSLINETO pgO;
+
+        pgO = GdiAllocBatchCommand(hdc, GdiBCLineTo);
+        if (pgO)
+        {
+            pdcattr->ulDirty_ |= DC_MODE_DIRTY;
+            pgO->ptlStart = pdcattr->ptlCurrent;
+            pgO->ptlEnd.x = x;
+            pgO->ptlEnd.y = y;
+            /* A MoveToEx since the last line starts a new figure */
+            pgO->flDirty = pdcattr->ulDirty_ & (DIRTY_PTFXCURRENT|DIRTY_STYLESTATE);
+            GdiSnapshotDrawAttributes(pdcattr, &pgO->Attr);
+
+            /* Move the current position like win32k does after a line,
+               the next one goes on with the same figure */
+            pdcattr->ptlCurrent.x = x;
+            pdcattr->ptlCurrent.y = y;
+            pdcattr->ulDirty_ &= ~(DIRTY_PTLCURRENT|DIRTY_STYLESTATE);
+            pdcattr->ulDirty_ |= DIRTY_PTFXCURRENT;
+            return TRUE;
+        }
+    }
+
     return NtGdiLineTo(hdc, x, y);
 }
 
@@ -95,10 +126,31 @@ Rectangle(
     _In_ INT right,
     _In_ INT bottom)
 {
+    PDC_ATTR pdcattr;
+
     HANDLE_METADC(BOOL, Rectangle, FALSE, hdc, left, top, right, bottom);
 
     if ( GdiConvertAndCheckDC(hdc) == NULL ) return FALSE;
 
+    /* Get the DC attribute */
+    pdcattr = GdiGetDcAttr(hdc);
+    if (pdcattr && !(pdcattr->ulDirty_ & DC_DIBSECTION))
+    {
+        PGDIBSRECTANGLE pgO;
+
+        pgO = GdiAllocBatchCommand(hdc, GdiBCRectangle);
+        if (pgO)
+        {
+            pdcattr->ulDirty_ |= DC_MODE_DIRTY;
+            pgO->rc.left   = left;
+            pgO->rc.top    = top;
+            pgO->rc.right  = right;
+            pgO->rc.bottom = bottom;
+            GdiSnapshotDrawAttributes(pdcattr, &pgO->Attr);
+            return TRUE;
+        }
+    }
+
     return NtGdiRectangle(hdc, left, top, right, bottom);
 }
 
@@ -171,7 +223,32 @@ SetPixelV(
     _In_ INT y,
     _In_ COLORREF crColor)
 {
-    return SetPixel(hdc, x, y, crColor) != CLR_INVALID;
+    PDC_ATTR pdcattr;
+
+    /* Meta DCs record a SetPixel */
+    if (GDI_HANDLE_GET_TYPE(hdc) != GDILoObjType_LO_DC_TYPE)
+        return SetPixel(hdc, x, y, crColor) != CLR_INVALID;
+
+    if ( GdiConvertAndCheckDC(hdc) == NULL ) return FALSE;
+
+    /* Unlike SetPixel, nothing has to be returned from the kernel */
+    pdcattr = GdiGetDcAttr(hdc);
+    if (pdcattr && !(pdcattr->ulDirty_ & DC_DIBSECTION))
+    {
+        PGDIBSSETPIXEL pgO;
+
+        pgO = GdiAllocBatchCommand(hdc, GdiBCSetPixel);
+        if (pgO)
+        {
+            pdcattr->ulDirty_ |= DC_MODE_DIRTY;
+            pgO->x = x;
+            pgO->y = y;
+            pgO->crColor = crColor;
+            return TRUE;
+        }
+    }
+
+    return NtGdiSetPixel(hdc, x, y, crColor) != CLR_INVALID;
 }
 
 
@@ -338,10 +415,43 @@ Polyline(
     _In_reads_(cpt) const POINT *apt,
     _In_ INT cpt)
 {
+    PDC_ATTR pdcattr;
+
     HANDLE_METADC(BOOL, Polyline, FALSE, hdc, apt, cpt);
 
     if ( GdiConvertAndCheckDC(hdc) == NULL ) return FALSE;
 
+    /* Get the DC attribute */
+    pdcattr = GdiGetDcAttr(hdc);
+    if (cpt >= 2 && pdcattr && !(pdcattr->ulDirty_ & DC_DIBSECTION))
+    {
+        PGDIBSPOLYLINE pgO;
+        PTEB pTeb = NtCurrentTeb();
+
+        pgO = GdiAllocBatchCommand(hdc, GdiBCPolyline);
+        if (pgO)
+        {
+            ULONG cjSize, cjEnd;
+
+            if (NT_SUCCESS(RtlULongMult(cpt - 1, sizeof(POINT), &cjSize)) &&
+                NT_SUCCESS(RtlULongAdd(pTeb->GdiTebBatch.Offset, cjSize, &cjEnd)) &&
+                cjEnd <= GDIBATCHBUFSIZE)
+            {
+                pdcattr->ulDirty_ |= DC_MODE_DIRTY;
+                pgO->Count = cpt;
+                GdiSnapshotDrawAttributes(pdcattr, &pgO->Attr);
+                RtlCopyMemory(pgO->apt, apt, cpt * sizeof(POINT));
+                // Recompute offset and return size, remember one is already accounted for in the structure.
+                pTeb->GdiTebBatch.Offset += cjSize;
+                ((PGDIBATCHHDR)pgO)->Size += cjSize;
+                return TRUE;
+            }
+            // Reset offset and count then fall through
+            pTeb->GdiTebBatch.Offset -= sizeof(GDIBSPOLYLINE);
+            pTeb->GdiBatchCount--;
+        }
+    }
+
     return NtGdiPolyPolyDraw(hdc, (PPOINT)apt, (PULONG)&cpt, 1, GdiPolyPolyLine);
 }
 
@@ -477,6 +587,32 @@ BitBlt(
 
     if ( GdiConvertAndCheckDC(hdcDest) == NULL ) return FALSE;
 
+    /* Only copies within one DC are batched, the flush can't lock a second DC */
+    if (hdcSrc == hdcDest)
+    {
+        PDC_ATTR pdcattr = GdiGetDcAttr(hdcDest);
+
+        if (pdcattr && !(pdcattr->ulDirty_ & DC_DIBSECTION))
+        {
+            PGDIBSBITBLT pgO;
+
+            pgO = GdiAllocBatchCommand(hdcDest, GdiBCBitBlt);
+            if (pgO)
+            {
+                pdcattr->ulDirty_ |= DC_MODE_DIRTY;
+                pgO->xDest = xDest;
+                pgO->yDest = yDest;
+                pgO->cx    = cx;
+                pgO->cy    = cy;
+                pgO->xSrc  = xSrc;
+                pgO->ySrc  = ySrc;
+                pgO->dwRop = dwRop;
+                GdiSnapshotDrawAttributes(pdcattr, &pgO->Attr);
+                return TRUE;
+            }
+        }
+    }
+
     return NtGdiBitBlt(hdcDest, xDest, yDest, cx, cy, hdcSrc, xSrc, ySrc, dwRop, 0, 0);
 }
 
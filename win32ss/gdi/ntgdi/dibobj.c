@@ -2224,6 +2224,7 @@ DIB_MapPaletteColors(PPALETTE ppalDc, CONST BITMAPINFO* lpbmi)
         ppalNew->IndexedColors[i] = ppalDc->IndexedColors[iColorIndex];
         lpIndex++;
     }
+    PALETTE_vColorsChanged(ppalNew);
 
     hpal = ppalNew->BaseObject.hHmgr;
     PALETTE_UnlockPalette(ppalNew);
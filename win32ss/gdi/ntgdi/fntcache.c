@@ -0,0 +1,453 @@
+/*
+ * PROJECT:     ReactOS win32 kernel mode subsystem
+ * LICENSE:     GPL-2.0-or-later (https://spdx.org/licenses/GPL-2.0-or-later)
+ * PURPOSE:     Persistent cache of the font metadata needed at startup
+ */
+
+/*
+ * At session start every font listed in the registry used to be parsed by
+ * FreeType only to learn its names and charsets. What is learnt is now kept
+ * in FNTCACHE.DAT, keyed by the file name, size and last write time, so that
+ * on the next boot the faces are only parsed once they are actually used
+ * (see SharedFace_GetFace in freetype.c).
+ *
+ * The cache is only read and written while InitFontSupport loads the fonts.
+ */
+
+#include <win32k.h>
+
+#define NDEBUG
+#include <debug.h>
+
+#define FONT_METADATA_MAGIC     'CTNF'
+#define FONT_METADATA_VERSION   1
+#define FONT_METADATA_MAX_SIZE  (16 * 1024 * 1024)
+/* Every face of a collection gets loaded, so do not trust any count */
+#define FONT_METADATA_MAX_FACES 256
+
+static UNICODE_STRING g_FontMetadataPath =
+    RTL_CONSTANT_STRING(L"\\SystemRoot\\System32\\FNTCACHE.DAT");
+
+typedef struct _FONT_METADATA_HEADER
+{
+    ULONG Magic;
+    ULONG Version;
+    ULONG LanguageID;       /* The localized names are for this language */
+    ULONG RecordCount;
+    ULONG DataSize;         /* Bytes of records following the header */
+    ULONG Reserved;
+} FONT_METADATA_HEADER, *PFONT_METADATA_HEADER;
+
+enum
+{
+    FONT_METADATA_FILE_NAME,
+    FONT_METADATA_FAMILY_NAME,
+    FONT_METADATA_STYLE_NAME,
+    FONT_METADATA_LOCAL_FAMILY_NAME,
+    FONT_METADATA_LOCAL_FULL_NAME,
+    FONT_METADATA_NAMES
+};
+
+typedef struct _FONT_METADATA_RECORD
+{
+    ULONG RecordSize;       /* Up to the next record */
+    LONG FaceIndex;
+    LARGE_INTEGER FileSize;
+    LARGE_INTEGER LastWriteTime;
+    LONG FaceCount;
+    USHORT OriginalWeight;
+    BOOLEAN IsTrueType;
+    BOOLEAN OriginalItalic;
+    ULONG CharSetCount;
+    BYTE CharSets[FONT_METADATA_MAX_CHARSETS];
+    USHORT NameLength[FONT_METADATA_NAMES];    /* In bytes */
+    USHORT Reserved;
+    /* The names follow in the same order, not terminated */
+} FONT_METADATA_RECORD, *PFONT_METADATA_RECORD;
+
+#define FONT_METADATA_ALIGNMENT TYPE_ALIGNMENT(FONT_METADATA_RECORD)
+
+C_ASSERT(sizeof(FONT_METADATA_HEADER) % FONT_METADATA_ALIGNMENT == 0);
+
+/* The file as read at startup */
+static PFONT_METADATA_HEADER g_FontMetadataOld;
+/* Fonts load in the same order every time, so the next lookup starts here */
+static ULONG g_FontMetadataNextOffset;
+
+/* The records of the fonts loaded this time, written back at the end */
+static PUCHAR g_FontMetadataNew;
+static ULONG g_FontMetadataNewSize;
+static ULONG g_FontMetadataNewMaxSize;
+static ULONG g_FontMetadataNewCount;
+
+static BOOLEAN g_FontMetadataActive;
+static BOOLEAN g_FontMetadataDirty;
+static BOOLEAN g_FontMetadataFailed;
+
+static PWCHAR
+IntGetFontMetadataName(PFONT_METADATA_RECORD Record, ULONG Index)
+{
+    PUCHAR Name = (PUCHAR)(Record + 1);
+    ULONG i;
+
+    for (i = 0; i < Index; ++i)
+        Name += Record->NameLength[i];
+
+    return (PWCHAR)Name;
+}
+
+static VOID
+IntGetFontMetadataString(PFONT_METADATA_RECORD Record, ULONG Index, PUNICODE_STRING String)
+{
+    String->Buffer = IntGetFontMetadataName(Record, Index);
+    String->Length = String->MaximumLength = Record->NameLength[Index];
+}
+
+static BOOL
+IntValidateFontMetadata(PFONT_METADATA_HEADER Header, ULONG Size)
+{
+    PFONT_METADATA_RECORD Record;
+    ULONG Offset, Count, NamesSize, i;
+
+    if (Header->Magic != FONT_METADATA_MAGIC ||
+        Header->Version != FONT_METADATA_VERSION ||
+        Header->DataSize != Size - sizeof(*Header))
+    {
+        return FALSE;
+    }
+
+    /* The localized names are only good for the language they were taken in */
+    if (Header->LanguageID != gusLanguageID)
+        return FALSE;
+
+    for (Offset = 0, Count = 0; Offset < Header->DataSize; Offset += Record->RecordSize, ++Count)
+    {
+        if (Header->DataSize - Offset < sizeof(*Record))
+            return FALSE;
+
+        Record = (PFONT_METADATA_RECORD)((PUCHAR)(Header + 1) + Offset);
+        if (Record->RecordSize < sizeof(*Record) ||
+            Record->RecordSize > Header->DataSize - Offset ||
+            Record->RecordSize % FONT_METADATA_ALIGNMENT != 0 ||
+            Record->CharSetCount == 0 ||
+            Record->CharSetCount > FONT_METADATA_MAX_CHARSETS ||
+            Record->FaceCount < 1 ||
+            Record->FaceCount > FONT_METADATA_MAX_FACES ||
+            Record->FaceIndex < 0 ||
+            Record->FaceIndex >= Record->FaceCount)
+        {
+            return FALSE;
+        }
+
+        for (i = 0, NamesSize = 0; i < FONT_METADATA_NAMES; ++i)
+        {
+            if (Record->NameLength[i] % sizeof(WCHAR) != 0)
+                return FALSE;
+            NamesSize += Record->NameLength[i];
+        }
+
+        if (NamesSize > Record->RecordSize - sizeof(*Record) ||
+            Record->NameLength[FONT_METADATA_FILE_NAME] == 0 ||
+            Record->NameLength[FONT_METADATA_FAMILY_NAME] == 0)
+        {
+            return FALSE;
+        }
+    }
+
+    return (Count == Header->RecordCount);
+}
+
+VOID FASTCALL
+IntLoadFontMetadataCache(VOID)
+{
+    OBJECT_ATTRIBUTES ObjectAttributes;
+    IO_STATUS_BLOCK Iosb;
+    FILE_STANDARD_INFORMATION FileInfo;
+    PFONT_METADATA_HEADER Header;
+    HANDLE FileHandle;
+    NTSTATUS Status;
+    ULONG Size;
+
+    g_FontMetadataActive = TRUE;
+    g_FontMetadataDirty = TRUE;
+    g_FontMetadataFailed = FALSE;
+    g_FontMetadataNewSize = sizeof(FONT_METADATA_HEADER);
+    g_FontMetadataNewCount = 0;
+
+    InitializeObjectAttributes(&ObjectAttributes, &g_FontMetadataPath,
+                               OBJ_CASE_INSENSITIVE | OBJ_KERNEL_HANDLE, NULL, NULL);
+    Status = ZwOpenFile(&FileHandle,
+                        FILE_GENERIC_READ | SYNCHRONIZE,
+                        &ObjectAttributes,
+                        &Iosb,
+                        FILE_SHARE_READ,
+                        FILE_SYNCHRONOUS_IO_NONALERT | FILE_NON_DIRECTORY_FILE);
+    if (!NT_SUCCESS(Status))
+    {
+        DPRINT("No font metadata cache (0x%08lx)\n", Status);
+        return;
+    }
+
+    Status = ZwQueryInformationFile(FileHandle, &Iosb, &FileInfo, sizeof(FileInfo),
+                                    FileStandardInformation);
+    if (!NT_SUCCESS(Status) ||
+        FileInfo.EndOfFile.QuadPart < sizeof(FONT_METADATA_HEADER) ||
+        FileInfo.EndOfFile.QuadPart > FONT_METADATA_MAX_SIZE)
+    {
+        DPRINT1("Ignoring the font metadata cache\n");
+        ZwClose(FileHandle);
+        return;
+    }
+
+    Size = FileInfo.EndOfFile.LowPart;
+    Header = ExAllocatePoolWithTag(PagedPool, Size, TAG_FONT);
+    if (!Header)
+    {
+        ZwClose(FileHandle);
+        return;
+    }
+
+    Status = ZwReadFile(FileHandle, NULL, NULL, NULL, &Iosb, Header, Size, NULL, NULL);
+    ZwClose(FileHandle);
+
+    if (!NT_SUCCESS(Status) || Iosb.Information != Size ||
+        !IntValidateFontMetadata(Header, Size))
+    {
+        DPRINT1("Ignoring the font metadata cache\n");
+        ExFreePoolWithTag(Header, TAG_FONT);
+        return;
+    }
+
+    g_FontMetadataOld = Header;
+    g_FontMetadataNextOffset = 0;
+    g_FontMetadataDirty = FALSE;
+}
+
+static PFONT_METADATA_RECORD
+IntAllocFontMetadataRecord(ULONG RecordSize)
+{
+    PFONT_METADATA_RECORD Record;
+    PUCHAR NewBuffer;
+    ULONG NewMaxSize;
+
+    if (g_FontMetadataFailed)
+        return NULL;
+
+    if (g_FontMetadataNewSize + RecordSize > g_FontMetadataNewMaxSize)
+    {
+        NewMaxSize = max(g_FontMetadataNewMaxSize * 2, 0x10000);
+        while (g_FontMetadataNewSize + RecordSize > NewMaxSize)
+            NewMaxSize *= 2;
+
+        if (NewMaxSize > FONT_METADATA_MAX_SIZE)
+            NewBuffer = NULL;
+        else
+            NewBuffer = ExAllocatePoolWithTag(PagedPool, NewMaxSize, TAG_FONT);
+
+        if (!NewBuffer)
+        {
+            /* A partial cache would only be rebuilt on the next boot */
+            DPRINT1("Not updating the font metadata cache\n");
+            g_FontMetadataFailed = TRUE;
+            return NULL;
+        }
+
+        if (g_FontMetadataNew)
+        {
+            RtlCopyMemory(NewBuffer, g_FontMetadataNew, g_FontMetadataNewSize);
+            ExFreePoolWithTag(g_FontMetadataNew, TAG_FONT);
+        }
+
+        g_FontMetadataNew = NewBuffer;
+        g_FontMetadataNewMaxSize = NewMaxSize;
+    }
+
+    Record = (PFONT_METADATA_RECORD)(g_FontMetadataNew + g_FontMetadataNewSize);
+    g_FontMetadataNewSize += RecordSize;
+    ++g_FontMetadataNewCount;
+
+    return Record;
+}
+
+BOOL FASTCALL
+IntFindFontMetadata(PCUNICODE_STRING FileName, PLARGE_INTEGER FileSize,
+                    PLARGE_INTEGER LastWriteTime, LONG FaceIndex,
+                    PFONT_METADATA Metadata)
+{
+    PFONT_METADATA_RECORD Record, NewRecord;
+    UNICODE_STRING RecordFileName;
+    ULONG Offset, i;
+
+    if (!g_FontMetadataActive || !g_FontMetadataOld)
+        return FALSE;
+
+    Offset = g_FontMetadataNextOffset;
+    for (i = 0; i < g_FontMetadataOld->RecordCount; ++i)
+    {
+        Record = (PFONT_METADATA_RECORD)((PUCHAR)(g_FontMetadataOld + 1) + Offset);
+
+        Offset += Record->RecordSize;
+        if (Offset >= g_FontMetadataOld->DataSize)
+            Offset = 0;
+
+        if (Record->FaceIndex != FaceIndex ||
+            Record->FileSize.QuadPart != FileSize->QuadPart ||
+            Record->LastWriteTime.QuadPart != LastWriteTime->QuadPart)
+        {
+            continue;
+        }
+
+        IntGetFontMetadataString(Record, FONT_METADATA_FILE_NAME, &RecordFileName);
+        if (!RtlEqualUnicodeString(&RecordFileName, FileName, TRUE))
+            continue;
+
+        g_FontMetadataNextOffset = Offset;
+
+        /* Keep it for the next boot */
+        NewRecord = IntAllocFontMetadataRecord(Record->RecordSize);
+        if (NewRecord)
+            RtlCopyMemory(NewRecord, Record, Record->RecordSize);
+
+        Metadata->FaceCount = Record->FaceCount;
+        Metadata->IsTrueType = Record->IsTrueType;
+        Metadata->OriginalItalic = Record->OriginalItalic;
+        Metadata->OriginalWeight = Record->OriginalWeight;
+        Metadata->CharSetCount = Record->CharSetCount;
+        RtlCopyMemory(Metadata->CharSets, Record->CharSets, sizeof(Metadata->CharSets));
+
+        /* These stay valid until IntSaveFontMetadataCache */
+        IntGetFontMetadataString(Record, FONT_METADATA_FAMILY_NAME, &Metadata->FamilyName);
+        IntGetFontMetadataString(Record, FONT_METADATA_STYLE_NAME, &Metadata->StyleName);
+        IntGetFontMetadataString(Record, FONT_METADATA_LOCAL_FAMILY_NAME, &Metadata->LocalFamilyName);
+        IntGetFontMetadataString(Record, FONT_METADATA_LOCAL_FULL_NAME, &Metadata->LocalFullName);
+
+        return TRUE;
+    }
+
+    return FALSE;
+}
+
+VOID FASTCALL
+IntAddFontMetadata(PCUNICODE_STRING FileName, PLARGE_INTEGER FileSize,
+                   PLARGE_INTEGER LastWriteTime, LONG FaceIndex,
+                   const FONT_METADATA *Metadata)
+{
+    PCUNICODE_STRING Names[FONT_METADATA_NAMES];
+    PFONT_METADATA_RECORD Record;
+    ULONG RecordSize, i;
+    PUCHAR Name;
+
+    if (!g_FontMetadataActive)
+        return;
+
+    Names[FONT_METADATA_FILE_NAME] = FileName;
+    Names[FONT_METADATA_FAMILY_NAME] = &Metadata->FamilyName;
+    Names[FONT_METADATA_STYLE_NAME] = &Metadata->StyleName;
+    Names[FONT_METADATA_LOCAL_FAMILY_NAME] = &Metadata->LocalFamilyName;
+    Names[FONT_METADATA_LOCAL_FULL_NAME] = &Metadata->LocalFullName;
+
+    /* Such faces are parsed at every boot */
+    if (FileName->Length == 0 || Metadata->FamilyName.Length == 0 ||
+        Metadata->FaceCount > FONT_METADATA_MAX_FACES)
+    {
+        return;
+    }
+
+    RecordSize = sizeof(*Record);
+    for (i = 0; i < FONT_METADATA_NAMES; ++i)
+        RecordSize += Names[i]->Length;
+    RecordSize = ALIGN_UP_BY(RecordSize, FONT_METADATA_ALIGNMENT);
+
+    Record = IntAllocFontMetadataRecord(RecordSize);
+    if (!Record)
+        return;
+
+    RtlZeroMemory(Record, RecordSize);
+    Record->RecordSize = RecordSize;
+    Record->FaceIndex = FaceIndex;
+    Record->FileSize = *FileSize;
+    Record->LastWriteTime = *LastWriteTime;
+    Record->FaceCount = Metadata->FaceCount;
+    Record->OriginalWeight = Metadata->OriginalWeight;
+    Record->IsTrueType = Metadata->IsTrueType;
+    Record->OriginalItalic = Metadata->OriginalItalic;
+    Record->CharSetCount = Metadata->CharSetCount;
+    RtlCopyMemory(Record->CharSets, Metadata->CharSets, sizeof(Record->CharSets));
+
+    Name = (PUCHAR)(Record + 1);
+    for (i = 0; i < FONT_METADATA_NAMES; ++i)
+    {
+        Record->NameLength[i] = Names[i]->Length;
+        RtlCopyMemory(Name, Names[i]->Buffer, Names[i]->Length);
+        Name += Names[i]->Length;
+    }
+
+    g_FontMetadataDirty = TRUE;
+}
+
+VOID FASTCALL
+IntSaveFontMetadataCache(VOID)
+{
+    OBJECT_ATTRIBUTES ObjectAttributes;
+    IO_STATUS_BLOCK Iosb;
+    PFONT_METADATA_HEADER Header;
+    HANDLE FileHandle;
+    NTSTATUS Status;
+
+    if (!g_FontMetadataActive)
+        return;
+
+    g_FontMetadataActive = FALSE;
+
+    /* Records of fonts that are gone were not carried over */
+    if (g_FontMetadataOld && g_FontMetadataOld->RecordCount != g_FontMetadataNewCount)
+        g_FontMetadataDirty = TRUE;
+
+    if (g_FontMetadataDirty && !g_FontMetadataFailed && g_FontMetadataNew)
+    {
+        Header = (PFONT_METADATA_HEADER)g_FontMetadataNew;
+        Header->Magic = FONT_METADATA_MAGIC;
+        Header->Version = FONT_METADATA_VERSION;
+        Header->LanguageID = gusLanguageID;
+        Header->RecordCount = g_FontMetadataNewCount;
+        Header->DataSize = g_FontMetadataNewSize - sizeof(*Header);
+        Header->Reserved = 0;
+
+        InitializeObjectAttributes(&ObjectAttributes, &g_FontMetadataPath,
+                                   OBJ_CASE_INSENSITIVE | OBJ_KERNEL_HANDLE, NULL, NULL);
+        Status = ZwCreateFile(&FileHandle,
+                              FILE_GENERIC_WRITE | SYNCHRONIZE,
+                              &ObjectAttributes,
+                              &Iosb,
+                              NULL,
+                              FILE_ATTRIBUTE_NORMAL,
+                              0,
+                              FILE_OVERWRITE_IF,
+                              FILE_SYNCHRONOUS_IO_NONALERT | FILE_NON_DIRECTORY_FILE,
+                              NULL,
+                              0);
+        if (NT_SUCCESS(Status))
+        {
+            /* A short write leaves a file that fails validation next time */
+            Status = ZwWriteFile(FileHandle, NULL, NULL, NULL, &Iosb,
+                                 g_FontMetadataNew, g_FontMetadataNewSize, NULL, NULL);
+            ZwClose(FileHandle);
+        }
+
+        if (!NT_SUCCESS(Status))
+            DPRINT1("Failed to write the font metadata cache (0x%08lx)\n", Status);
+    }
+
+    if (g_FontMetadataNew)
+    {
+        ExFreePoolWithTag(g_FontMetadataNew, TAG_FONT);
+        g_FontMetadataNew = NULL;
+    }
+    g_FontMetadataNewSize = g_FontMetadataNewMaxSize = g_FontMetadataNewCount = 0;
+
+    if (g_FontMetadataOld)
+    {
+        ExFreePoolWithTag(g_FontMetadataOld, TAG_FONT);
+        g_FontMetadataOld = NULL;
+    }
+}
@@ -54,8 +54,12 @@ typedef struct _FONT_CACHE_HASHED
 
 typedef struct _FONT_CACHE_ENTRY
 {
-    LIST_ENTRY ListEntry;
+    LIST_ENTRY ListEntry;       /* LRU order, most recently used first */
+    LIST_ENTRY HashEntry;       /* Hash bucket */
+    LIST_ENTRY FaceEntry;       /* SHARED_FACE::GlyphCacheHead */
     FT_BitmapGlyph BitmapGlyph;
+    LONG RefCount;              /* One is held by the cache while the entry is listed */
+    ULONG Size;                 /* Bytes charged against the cache budget */
     DWORD dwHash;
     FONT_CACHE_HASHED Hashed;
 } FONT_CACHE_ENTRY, *PFONT_CACHE_ENTRY;
@@ -90,5 +94,8 @@ typedef struct GDI_LOAD_FONT
     BOOL                IsTrueType;
     BYTE                CharSet;
     PFONT_ENTRY_MEM     PrivateEntry;
+    BOOL                HasFileStamp;   /* FileSize and LastWriteTime are valid */
+    LARGE_INTEGER       FileSize;
+    LARGE_INTEGER       LastWriteTime;
 } GDI_LOAD_FONT, *PGDI_LOAD_FONT;
 
@@ -388,10 +388,18 @@ do { \
     ExReleaseFastMutexUnsafeAndLeaveCriticalRegion(g_FreeTypeLock); \
 } while(0)
 
-#define MAX_FONT_CACHE 256
+/* The glyph cache is hashed on FONT_CACHE_HASHED and trimmed in LRU order
+ * once the rendered bitmaps take more than FONT_CACHE_BUDGET bytes */
+#define FONT_CACHE_BUCKETS 1024 /* Must be a power of two */
+#define FONT_CACHE_BUDGET (2 * 1024 * 1024)
 
 static RTL_STATIC_LIST_HEAD(g_FontCacheListHead);
+static LIST_ENTRY g_FontCacheHashTable[FONT_CACHE_BUCKETS];
 static UINT g_FontCacheNumEntries;
+static SIZE_T g_FontCacheSize;
+static ULONG g_FontCacheHits;
+static ULONG g_FontCacheMisses;
+static ULONG g_FontCacheEvictions;
 
 static PWCHAR g_ElfScripts[32] =   /* These are in the order of the fsCsb[0] bits */
 {
@@ -569,8 +577,9 @@ SharedFaceCache_Init(PSHARED_FACE_CACHE Cache)
     RtlInitUnicodeString(&Cache->FullName, NULL);
 }
 
+/* Face can be NULL, it is then parsed from Memory on first use */
 static PSHARED_FACE
-SharedFace_Create(FT_Face Face, PSHARED_MEM Memory)
+SharedFace_Create(FT_Face Face, PSHARED_MEM Memory, FT_Long FaceIndex)
 {
     PSHARED_FACE Ptr;
     Ptr = ExAllocatePoolWithTag(PagedPool, sizeof(SHARED_FACE), TAG_FONT);
@@ -579,15 +588,69 @@ SharedFace_Create(FT_Face Face, PSHARED_MEM Memory)
         Ptr->Face = Face;
         Ptr->RefCount = 1;
         Ptr->Memory = Memory;
+        Ptr->FaceIndex = FaceIndex;
+        Ptr->LoadFailed = FALSE;
+        InitializeListHead(&Ptr->GlyphCacheHead);
         SharedFaceCache_Init(&Ptr->EnglishUS);
         SharedFaceCache_Init(&Ptr->UserLanguage);
 
+        /* Lets the glyph cache find the face's entries list */
+        if (Face)
+            Face->generic.data = Ptr;
+
         SharedMem_AddRef(Memory);
-        DPRINT("Creating SharedFace for %s\n", Face->family_name ? Face->family_name : "<NULL>");
+        DPRINT("Creating SharedFace for %s\n",
+               (Face && Face->family_name) ? Face->family_name : "<NULL>");
     }
     return Ptr;
 }
 
+/* Returns the FreeType face, parsing it if it was only known from the font metadata cache */
+static FT_Face
+SharedFace_GetFace(PSHARED_FACE SharedFace)
+{
+    FT_Face Face;
+    FT_Error Error;
+    BOOL bLocked = FALSE;
+
+    Face = SharedFace->Face;
+    if (Face || SharedFace->LoadFailed)
+        return Face;
+
+    if (g_FreeTypeLock->Owner != KeGetCurrentThread())
+    {
+        IntLockFreeType();
+        bLocked = TRUE;
+    }
+
+    /* Someone may have been faster */
+    Face = SharedFace->Face;
+    if (!Face && !SharedFace->LoadFailed)
+    {
+        Error = FT_New_Memory_Face(g_FreeTypeLibrary,
+                                   SharedFace->Memory->Buffer,
+                                   SharedFace->Memory->BufferSize,
+                                   SharedFace->FaceIndex,
+                                   &Face);
+        if (!Error)
+        {
+            Face->generic.data = SharedFace;
+            SharedFace->Face = Face;
+        }
+        else
+        {
+            DPRINT1("Error loading deferred face %ld (error %d)\n", SharedFace->FaceIndex, Error);
+            SharedFace->LoadFailed = TRUE;
+            Face = NULL;
+        }
+    }
+
+    if (bLocked)
+        IntUnLockFreeType();
+
+    return Face;
+}
+
 static PSHARED_MEM
 SharedMem_Create(PBYTE Buffer, ULONG BufferSize, BOOL IsMapping)
 {
@@ -612,37 +675,46 @@ SharedFace_AddRef(PSHARED_FACE Ptr)
     ++Ptr->RefCount;
 }
 
+/* Does not need the FreeType lock: the entry may already be out of the cache */
+static void
+IntReleaseGlyphEntry(PFONT_CACHE_ENTRY Entry)
+{
+    ASSERT(Entry->RefCount > 0);
+
+    if (InterlockedDecrement(&Entry->RefCount) == 0)
+    {
+        FT_Done_Glyph((FT_Glyph)Entry->BitmapGlyph);
+        ExFreePoolWithTag(Entry, TAG_FONT);
+    }
+}
+
 static void
 RemoveCachedEntry(PFONT_CACHE_ENTRY Entry)
 {
     ASSERT_FREETYPE_LOCK_HELD();
 
-    FT_Done_Glyph((FT_Glyph)Entry->BitmapGlyph);
     RemoveEntryList(&Entry->ListEntry);
-    ExFreePoolWithTag(Entry, TAG_FONT);
+    RemoveEntryList(&Entry->HashEntry);
+    RemoveEntryList(&Entry->FaceEntry);
+    ASSERT(g_FontCacheNumEntries > 0 && g_FontCacheSize >= Entry->Size);
     g_FontCacheNumEntries--;
-    ASSERT(g_FontCacheNumEntries <= MAX_FONT_CACHE);
+    g_FontCacheSize -= Entry->Size;
+
+    /* Text output may still be drawing it, see IntExtTextOutW */
+    IntReleaseGlyphEntry(Entry);
 }
 
 static void
-RemoveCacheEntries(FT_Face Face)
+RemoveCacheEntries(PSHARED_FACE SharedFace)
 {
-    PLIST_ENTRY CurrentEntry, NextEntry;
     PFONT_CACHE_ENTRY FontEntry;
 
     ASSERT_FREETYPE_LOCK_HELD();
 
-    for (CurrentEntry = g_FontCacheListHead.Flink;
-         CurrentEntry != &g_FontCacheListHead;
-         CurrentEntry = NextEntry)
+    while (!IsListEmpty(&SharedFace->GlyphCacheHead))
     {
-        FontEntry = CONTAINING_RECORD(CurrentEntry, FONT_CACHE_ENTRY, ListEntry);
-        NextEntry = CurrentEntry->Flink;
-
-        if (FontEntry->Hashed.Face == Face)
-        {
-            RemoveCachedEntry(FontEntry);
-        }
+        FontEntry = CONTAINING_RECORD(SharedFace->GlyphCacheHead.Flink, FONT_CACHE_ENTRY, FaceEntry);
+        RemoveCachedEntry(FontEntry);
     }
 }
 
@@ -685,9 +757,11 @@ SharedFace_Release(PSHARED_FACE Ptr)
     --Ptr->RefCount;
     if (Ptr->RefCount == 0)
     {
-        DPRINT("Releasing SharedFace for %s\n", Ptr->Face->family_name ? Ptr->Face->family_name : "<NULL>");
-        RemoveCacheEntries(Ptr->Face);
-        FT_Done_Face(Ptr->Face);
+        DPRINT("Releasing SharedFace for %s\n",
+               (Ptr->Face && Ptr->Face->family_name) ? Ptr->Face->family_name : "<NULL>");
+        RemoveCacheEntries(Ptr);
+        if (Ptr->Face)
+            FT_Done_Face(Ptr->Face);
         SharedMem_Release(Ptr->Memory);
         SharedFaceCache_Release(&Ptr->EnglishUS);
         SharedFaceCache_Release(&Ptr->UserLanguage);
@@ -1020,8 +1094,12 @@ BOOL FASTCALL
 InitFontSupport(VOID)
 {
     ULONG ulError;
+    UINT i;
 
     g_FontCacheNumEntries = 0;
+    g_FontCacheSize = 0;
+    for (i = 0; i < FONT_CACHE_BUCKETS; ++i)
+        InitializeListHead(&g_FontCacheHashTable[i]);
 
     g_FreeTypeLock = ExAllocatePoolWithTag(NonPagedPool, sizeof(FAST_MUTEX), TAG_INTERNAL_SYNC);
     if (g_FreeTypeLock == NULL)
@@ -1037,6 +1115,9 @@ InitFontSupport(VOID)
         return FALSE;
     }
 
+    /* Faces known from the last boot are only parsed when first used */
+    IntLoadFontMetadataCache();
+
     if (!IntLoadFontsInRegistry())
     {
         DPRINT1("Fonts registry is empty.\n");
@@ -1045,6 +1126,8 @@ InitFontSupport(VOID)
         IntLoadSystemFonts();
     }
 
+    IntSaveFontMetadataCache();
+
     IntLoadFontSubstList(&g_FontSubstListHead);
 
 #if 0
@@ -1073,8 +1156,7 @@ FreeFontSupport(VOID)
     pHead = &g_FontCacheListHead;
     while (!IsListEmpty(pHead))
     {
-        pEntry = RemoveHeadList(pHead);
-        pFontCache = CONTAINING_RECORD(pEntry, FONT_CACHE_ENTRY, ListEntry);
+        pFontCache = CONTAINING_RECORD(pHead->Flink, FONT_CACHE_ENTRY, ListEntry);
         RemoveCachedEntry(pFontCache);
     }
 
@@ -1254,6 +1336,15 @@ DuplicateUnicodeString(PUNICODE_STRING Source, PUNICODE_STRING Destination)
     return Status;
 }
 
+/* Same, for sources that may not be null-terminated */
+static NTSTATUS
+DuplicateTerminatedString(PCUNICODE_STRING Source, PUNICODE_STRING Destination)
+{
+    UNICODE_STRING Tmp = *Source;
+    Tmp.MaximumLength = Source->Length + sizeof(UNICODE_NULL);
+    return DuplicateUnicodeString(&Tmp, Destination);
+}
+
 static BOOL
 SubstituteFontRecurse(PLOGFONTW pLogFont)
 {
@@ -1712,12 +1803,134 @@ UINT FASTCALL IntGetCharSet(INT nIndex, FT_ULong CodePageRange1)
     return (nIndex < 0) ? nCount : ANSI_CHARSET;
 }
 
+static NTSTATUS
+IntGetFontLocalizedName(PUNICODE_STRING pNameW, PSHARED_FACE SharedFace,
+                        FT_UShort NameID, FT_UShort LangID);
+
+static VOID
+IntFreeFaceMetadata(PFONT_METADATA Metadata)
+{
+    RtlFreeUnicodeString(&Metadata->FamilyName);
+    RtlFreeUnicodeString(&Metadata->StyleName);
+    RtlFreeUnicodeString(&Metadata->LocalFamilyName);
+    RtlFreeUnicodeString(&Metadata->LocalFullName);
+}
+
+C_ASSERT(FONT_METADATA_MAX_CHARSETS >= MAXTCIINDEX);
+
+/* Reads from a parsed face what the font metadata cache keeps about it */
+static BOOL
+IntGetFaceMetadata(PSHARED_FACE SharedFace, PFONT_METADATA Metadata)
+{
+    FT_Face             Face = SharedFace->Face;
+    TT_OS2 *            pOS2;
+    FT_WinFNT_HeaderRec WinFNT;
+    ANSI_STRING         AnsiString;
+    NTSTATUS            Status;
+    INT                 BitIndex;
+
+    RtlZeroMemory(Metadata, sizeof(*Metadata));
+    Metadata->CharSets[0] = ANSI_CHARSET;
+
+    IntLockFreeType();
+
+    Metadata->IsTrueType = !!FT_IS_SFNT(Face);
+    Metadata->FaceCount = 1;
+    if (FT_IS_SFNT(Face) && ((TT_Face)Face)->ttc_header.count > 1)
+        Metadata->FaceCount = ((TT_Face)Face)->ttc_header.count;
+
+    pOS2 = (TT_OS2 *)FT_Get_Sfnt_Table(Face, FT_SFNT_OS2);
+    if (pOS2)
+    {
+        Metadata->OriginalItalic = !!(pOS2->fsSelection & 0x1);
+        Metadata->OriginalWeight = pOS2->usWeightClass;
+    }
+
+    if (pOS2 && pOS2->version >= 1)
+    {
+        /* get charsets from OS/2 header */
+        for (BitIndex = 0; BitIndex < MAXTCIINDEX; ++BitIndex)
+        {
+            if (!(pOS2->ulCodePageRange1 & (1 << BitIndex)) ||
+                g_FontTci[BitIndex].ciCharset == DEFAULT_CHARSET)
+            {
+                continue;
+            }
+
+            Metadata->CharSets[Metadata->CharSetCount++] = g_FontTci[BitIndex].ciCharset;
+        }
+    }
+    else if (!FT_Get_WinFNT_Header(Face, &WinFNT))
+    {
+        /* get charset from WinFNT header */
+        if (!pOS2)
+        {
+            Metadata->OriginalItalic = !!WinFNT.italic;
+            Metadata->OriginalWeight = WinFNT.weight;
+        }
+        Metadata->CharSets[0] = WinFNT.charset;
+    }
+
+    if (Metadata->CharSetCount == 0)
+        Metadata->CharSetCount = 1;
+
+    RtlInitAnsiString(&AnsiString, Face->family_name);
+    Status = RtlAnsiStringToUnicodeString(&Metadata->FamilyName, &AnsiString, TRUE);
+    if (NT_SUCCESS(Status) &&
+        Face->style_name && Face->style_name[0] &&
+        strcmp(Face->style_name, "Regular") != 0)
+    {
+        RtlInitAnsiString(&AnsiString, Face->style_name);
+        Status = RtlAnsiStringToUnicodeString(&Metadata->StyleName, &AnsiString, TRUE);
+    }
+
+    if (NT_SUCCESS(Status))
+    {
+        /* These also fill the name cache of the face */
+        IntGetFontLocalizedName(&Metadata->LocalFamilyName, SharedFace,
+                                TT_NAME_ID_FONT_FAMILY, gusLanguageID);
+        IntGetFontLocalizedName(&Metadata->LocalFullName, SharedFace,
+                                TT_NAME_ID_FULL_NAME, gusLanguageID);
+    }
+
+    IntUnLockFreeType();
+
+    if (!NT_SUCCESS(Status))
+    {
+        IntFreeFaceMetadata(Metadata);
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+/* Gives a face that is not parsed yet the names matching and enumeration look at */
+static VOID
+IntFillNameCacheFromMetadata(PSHARED_FACE SharedFace, const FONT_METADATA *Metadata)
+{
+    PSHARED_FACE_CACHE Cache;
+
+    ASSERT_FREETYPE_LOCK_HELD();
+
+    if (!Metadata->LocalFamilyName.Length || !Metadata->LocalFullName.Length)
+        return;
+
+    if (PRIMARYLANGID(gusLanguageID) == LANG_ENGLISH)
+        Cache = &SharedFace->EnglishUS;
+    else
+        Cache = &SharedFace->UserLanguage;
+
+    DuplicateTerminatedString(&Metadata->LocalFamilyName, &Cache->FontFamily);
+    DuplicateTerminatedString(&Metadata->LocalFullName, &Cache->FullName);
+}
+
 /* pixels to points */
 #define PX2PT(pixels) FT_MulDiv((pixels), 72, 96)
 
 static INT FASTCALL
 IntGdiLoadFontsFromMemory(PGDI_LOAD_FONT pLoadFont,
-                          PSHARED_FACE SharedFace, FT_Long FontIndex, INT CharSetIndex)
+                          PSHARED_FACE SharedFace, FT_Long FontIndex, INT CharSetIndex,
+                          const FONT_METADATA *ParentMetadata)
 {
     FT_Error            Error;
     PFONT_ENTRY         Entry;
@@ -1725,52 +1938,82 @@ IntGdiLoadFontsFromMemory(PGDI_LOAD_FONT pLoadFont,
     FONTGDI *           FontGDI;
     NTSTATUS            Status;
     FT_Face             Face;
-    ANSI_STRING         AnsiString;
-    FT_WinFNT_HeaderRec WinFNT;
-    INT                 FaceCount = 0, CharSetCount = 0;
+    FT_Long             FaceIndex;
+    FONT_METADATA       Metadata;
+    BOOL                bFreeMetadata = FALSE;
+    INT                 FaceCount = 0;
     PUNICODE_STRING     pFileName       = pLoadFont->pFileName;
     DWORD               Characteristics = pLoadFont->Characteristics;
     PUNICODE_STRING     pValueName = &pLoadFont->RegValueName;
-    TT_OS2 *            pOS2;
-    INT                 BitIndex;
-    FT_UShort           os2_version;
-    FT_ULong            os2_ulCodePageRange1;
-    FT_UShort           os2_usWeightClass;
+    BOOL                bUseMetadataCache = (pFileName && pLoadFont->HasFileStamp);
 
     if (SharedFace == NULL && CharSetIndex == -1)
     {
-        /* load a face from memory */
-        IntLockFreeType();
-        Error = FT_New_Memory_Face(
-                    g_FreeTypeLibrary,
-                    pLoadFont->Memory->Buffer,
-                    pLoadFont->Memory->BufferSize,
-                    ((FontIndex != -1) ? FontIndex : 0),
-                    &Face);
+        FaceIndex = ((FontIndex != -1) ? FontIndex : 0);
 
-        if (!Error)
-            SharedFace = SharedFace_Create(Face, pLoadFont->Memory);
+        if (bUseMetadataCache &&
+            IntFindFontMetadata(pFileName, &pLoadFont->FileSize, &pLoadFont->LastWriteTime,
+                                FaceIndex, &Metadata))
+        {
+            /* known face: it is only parsed once it is used */
+            IntLockFreeType();
+            SharedFace = SharedFace_Create(NULL, pLoadFont->Memory, FaceIndex);
+            if (SharedFace)
+                IntFillNameCacheFromMetadata(SharedFace, &Metadata);
+            IntUnLockFreeType();
 
-        IntUnLockFreeType();
+            if (SharedFace == NULL)
+                return 0;   /* failure */
+        }
+        else
+        {
+            /* load a face from memory */
+            IntLockFreeType();
+            Error = FT_New_Memory_Face(
+                        g_FreeTypeLibrary,
+                        pLoadFont->Memory->Buffer,
+                        pLoadFont->Memory->BufferSize,
+                        FaceIndex,
+                        &Face);
 
-        if (!Error && FT_IS_SFNT(Face))
-            pLoadFont->IsTrueType = TRUE;
+            if (!Error)
+                SharedFace = SharedFace_Create(Face, pLoadFont->Memory, FaceIndex);
 
-        if (Error || SharedFace == NULL)
-        {
-            if (SharedFace)
+            IntUnLockFreeType();
+
+            if (Error || SharedFace == NULL)
+            {
+                if (SharedFace)
+                    SharedFace_Release(SharedFace);
+
+                if (Error == FT_Err_Unknown_File_Format)
+                    DPRINT1("Unknown font file format\n");
+                else
+                    DPRINT1("Error reading font (error code: %d)\n", Error);
+                return 0;   /* failure */
+            }
+
+            if (!IntGetFaceMetadata(SharedFace, &Metadata))
+            {
                 SharedFace_Release(SharedFace);
+                return 0;   /* failure */
+            }
+            bFreeMetadata = TRUE;
 
-            if (Error == FT_Err_Unknown_File_Format)
-                DPRINT1("Unknown font file format\n");
-            else
-                DPRINT1("Error reading font (error code: %d)\n", Error);
-            return 0;   /* failure */
+            if (bUseMetadataCache)
+            {
+                IntAddFontMetadata(pFileName, &pLoadFont->FileSize, &pLoadFont->LastWriteTime,
+                                   FaceIndex, &Metadata);
+            }
         }
+
+        if (Metadata.IsTrueType)
+            pLoadFont->IsTrueType = TRUE;
     }
     else
     {
-        Face = SharedFace->Face;
+        ASSERT(ParentMetadata);
+        Metadata = *ParentMetadata;
         IntLockFreeType();
         SharedFace_AddRef(SharedFace);
         IntUnLockFreeType();
@@ -1780,6 +2023,8 @@ IntGdiLoadFontsFromMemory(PGDI_LOAD_FONT pLoadFont,
     Entry = ExAllocatePoolWithTag(PagedPool, sizeof(FONT_ENTRY), TAG_FONT);
     if (!Entry)
     {
+        if (bFreeMetadata)
+            IntFreeFaceMetadata(&Metadata);
         SharedFace_Release(SharedFace);
         EngSetLastError(ERROR_NOT_ENOUGH_MEMORY);
         return 0;   /* failure */
@@ -1789,6 +2034,8 @@ IntGdiLoadFontsFromMemory(PGDI_LOAD_FONT pLoadFont,
     FontGDI = EngAllocMem(FL_ZERO_MEMORY, sizeof(FONTGDI), GDITAG_RFONT);
     if (!FontGDI)
     {
+        if (bFreeMetadata)
+            IntFreeFaceMetadata(&Metadata);
         SharedFace_Release(SharedFace);
         ExFreePoolWithTag(Entry, TAG_FONT);
         EngSetLastError(ERROR_NOT_ENOUGH_MEMORY);
@@ -1804,6 +2051,8 @@ IntGdiLoadFontsFromMemory(PGDI_LOAD_FONT pLoadFont,
         if (FontGDI->Filename == NULL)
         {
             EngFreeMem(FontGDI);
+            if (bFreeMetadata)
+                IntFreeFaceMetadata(&Metadata);
             SharedFace_Release(SharedFace);
             ExFreePoolWithTag(Entry, TAG_FONT);
             EngSetLastError(ERROR_NOT_ENOUGH_MEMORY);
@@ -1823,6 +2072,8 @@ IntGdiLoadFontsFromMemory(PGDI_LOAD_FONT pLoadFont,
             if (FontGDI->Filename)
                 ExFreePoolWithTag(FontGDI->Filename, GDITAG_PFF);
             EngFreeMem(FontGDI);
+            if (bFreeMetadata)
+                IntFreeFaceMetadata(&Metadata);
             SharedFace_Release(SharedFace);
             ExFreePoolWithTag(Entry, TAG_FONT);
             return 0;
@@ -1842,39 +2093,18 @@ IntGdiLoadFontsFromMemory(PGDI_LOAD_FONT pLoadFont,
 
     /* set face */
     FontGDI->SharedFace = SharedFace;
-    FontGDI->CharSet = ANSI_CHARSET;
-    FontGDI->OriginalItalic = FALSE;
+    FontGDI->CharSet = Metadata.CharSets[(CharSetIndex != -1) ? CharSetIndex : 0];
+    FontGDI->OriginalItalic = Metadata.OriginalItalic;
     FontGDI->RequestItalic = FALSE;
-    FontGDI->OriginalWeight = FALSE;
+    FontGDI->OriginalWeight = Metadata.OriginalWeight;
     FontGDI->RequestWeight = FW_NORMAL;
 
-    IntLockFreeType();
-    pOS2 = (TT_OS2 *)FT_Get_Sfnt_Table(Face, FT_SFNT_OS2);
-    if (pOS2)
-    {
-        FontGDI->OriginalItalic = !!(pOS2->fsSelection & 0x1);
-        FontGDI->OriginalWeight = pOS2->usWeightClass;
-    }
-    else
-    {
-        Error = FT_Get_WinFNT_Header(Face, &WinFNT);
-        if (!Error)
-        {
-            FontGDI->OriginalItalic = !!WinFNT.italic;
-            FontGDI->OriginalWeight = WinFNT.weight;
-        }
-    }
-    IntUnLockFreeType();
-
-    RtlInitAnsiString(&AnsiString, Face->family_name);
-    Status = RtlAnsiStringToUnicodeString(&Entry->FaceName, &AnsiString, TRUE);
+    Status = DuplicateTerminatedString(&Metadata.FamilyName, &Entry->FaceName);
     if (NT_SUCCESS(Status))
     {
-        if (Face->style_name && Face->style_name[0] &&
-            strcmp(Face->style_name, "Regular") != 0)
+        if (Metadata.StyleName.Length)
         {
-            RtlInitAnsiString(&AnsiString, Face->style_name);
-            Status = RtlAnsiStringToUnicodeString(&Entry->StyleName, &AnsiString, TRUE);
+            Status = DuplicateTerminatedString(&Metadata.StyleName, &Entry->StyleName);
             if (!NT_SUCCESS(Status))
             {
                 RtlFreeUnicodeString(&Entry->FaceName);
@@ -1902,66 +2132,16 @@ IntGdiLoadFontsFromMemory(PGDI_LOAD_FONT pLoadFont,
         if (FontGDI->Filename)
             ExFreePoolWithTag(FontGDI->Filename, GDITAG_PFF);
         EngFreeMem(FontGDI);
+        if (bFreeMetadata)
+            IntFreeFaceMetadata(&Metadata);
         SharedFace_Release(SharedFace);
         ExFreePoolWithTag(Entry, TAG_FONT);
         return 0;
     }
 
-    os2_version = 0;
-    IntLockFreeType();
-    pOS2 = (TT_OS2 *)FT_Get_Sfnt_Table(Face, FT_SFNT_OS2);
-    if (pOS2)
-    {
-        os2_version = pOS2->version;
-        os2_ulCodePageRange1 = pOS2->ulCodePageRange1;
-        os2_usWeightClass = pOS2->usWeightClass;
-    }
-    IntUnLockFreeType();
-
-    if (pOS2 && os2_version >= 1)
-    {
-        /* get charset and weight from OS/2 header */
-
-        /* Make sure we do not use this pointer anymore */
-        pOS2 = NULL;
-
-        for (BitIndex = 0; BitIndex < MAXTCIINDEX; ++BitIndex)
-        {
-            if (os2_ulCodePageRange1 & (1 << BitIndex))
-            {
-                if (g_FontTci[BitIndex].ciCharset == DEFAULT_CHARSET)
-                    continue;
-
-                if ((CharSetIndex == -1 && CharSetCount == 0) ||
-                    CharSetIndex == CharSetCount)
-                {
-                    FontGDI->CharSet = g_FontTci[BitIndex].ciCharset;
-                }
-
-                ++CharSetCount;
-            }
-        }
-
-        /* set actual weight */
-        FontGDI->OriginalWeight = os2_usWeightClass;
-    }
-    else
-    {
-        /* get charset from WinFNT header */
-        IntLockFreeType();
-        Error = FT_Get_WinFNT_Header(Face, &WinFNT);
-        if (!Error)
-        {
-            FontGDI->CharSet = WinFNT.charset;
-        }
-        IntUnLockFreeType();
-    }
-
     ++FaceCount;
-    DPRINT("Font loaded: %s (%s)\n",
-           Face->family_name ? Face->family_name : "<NULL>",
-           Face->style_name ? Face->style_name : "<NULL>");
-    DPRINT("Num glyphs: %d\n", Face->num_glyphs);
+    DPRINT("Font loaded: %wZ (%wZ)\n", &Entry->FaceName, &Entry->StyleName);
+    DPRINT("Parsed: %s\n", SharedFace->Face ? "yes" : "deferred");
     DPRINT("CharSet: %d\n", FontGDI->CharSet);
 
     /* Add this font resource to the font table */
@@ -1986,16 +2166,12 @@ IntGdiLoadFontsFromMemory(PGDI_LOAD_FONT pLoadFont,
 
     if (FontIndex == -1)
     {
-        if (FT_IS_SFNT(Face))
+        if (Metadata.FaceCount > 1)
         {
-            TT_Face TrueType = (TT_Face)Face;
-            if (TrueType->ttc_header.count > 1)
+            FT_Long i;
+            for (i = 1; i < Metadata.FaceCount; ++i)
             {
-                FT_Long i;
-                for (i = 1; i < TrueType->ttc_header.count; ++i)
-                {
-                    FaceCount += IntGdiLoadFontsFromMemory(pLoadFont, NULL, i, -1);
-                }
+                FaceCount += IntGdiLoadFontsFromMemory(pLoadFont, NULL, i, -1, NULL);
             }
         }
         FontIndex = 0;
@@ -2003,7 +2179,7 @@ IntGdiLoadFontsFromMemory(PGDI_LOAD_FONT pLoadFont,
 
     if (CharSetIndex == -1)
     {
-        INT i;
+        ULONG i;
         USHORT NameLength = Entry->FaceName.Length;
 
         if (Entry->StyleName.Length)
@@ -2043,13 +2219,16 @@ IntGdiLoadFontsFromMemory(PGDI_LOAD_FONT pLoadFont,
             RtlAppendUnicodeStringToString(pValueName, &Entry->StyleName);
         }
 
-        for (i = 1; i < CharSetCount; ++i)
+        for (i = 1; i < Metadata.CharSetCount; ++i)
         {
             /* Do not count charsets towards 'faces' loaded */
-            IntGdiLoadFontsFromMemory(pLoadFont, SharedFace, FontIndex, i);
+            IntGdiLoadFontsFromMemory(pLoadFont, SharedFace, FontIndex, i, &Metadata);
         }
     }
 
+    if (bFreeMetadata)
+        IntFreeFaceMetadata(&Metadata);
+
     return FaceCount;   /* number of loaded faces */
 }
 
@@ -2105,6 +2284,7 @@ IntGdiAddFontResourceEx(PUNICODE_STRING FileName, DWORD Characteristics,
     UNICODE_STRING PathName;
     LPWSTR pszBuffer;
     PFILE_OBJECT FileObject;
+    FILE_NETWORK_OPEN_INFORMATION FileInfo;
     static const UNICODE_STRING TrueTypePostfix = RTL_CONSTANT_STRING(L" (TrueType)");
     static const UNICODE_STRING DosPathPrefix = RTL_CONSTANT_STRING(L"\\??\\");
 
@@ -2167,6 +2347,16 @@ IntGdiAddFontResourceEx(PUNICODE_STRING FileName, DWORD Characteristics,
         RtlFreeUnicodeString(&PathName);
         return 0;
     }
+
+    /* The font metadata cache is only valid for this very file */
+    Status = ZwQueryInformationFile(FileHandle, &Iosb, &FileInfo, sizeof(FileInfo),
+                                    FileNetworkOpenInformation);
+    LoadFont.HasFileStamp = NT_SUCCESS(Status);
+    if (LoadFont.HasFileStamp)
+    {
+        LoadFont.FileSize = FileInfo.EndOfFile;
+        LoadFont.LastWriteTime = FileInfo.LastWriteTime;
+    }
     ZwClose(FileHandle);
 
     Status = MmMapViewInSystemSpace(SectionObject, &Buffer, &ViewSize);
@@ -2186,7 +2376,7 @@ IntGdiAddFontResourceEx(PUNICODE_STRING FileName, DWORD Characteristics,
     LoadFont.IsTrueType         = FALSE;
     LoadFont.CharSet            = DEFAULT_CHARSET;
     LoadFont.PrivateEntry       = NULL;
-    FontCount = IntGdiLoadFontsFromMemory(&LoadFont, NULL, -1, -1);
+    FontCount = IntGdiLoadFontsFromMemory(&LoadFont, NULL, -1, -1, NULL);
 
     /* Release our copy */
     IntLockFreeType();
@@ -2476,7 +2666,8 @@ IntGdiAddFontMemResource(PVOID Buffer, DWORD dwSize, PDWORD pNumAdded)
     RtlInitUnicodeString(&LoadFont.RegValueName, NULL);
     LoadFont.IsTrueType         = FALSE;
     LoadFont.PrivateEntry       = NULL;
-    FaceCount = IntGdiLoadFontsFromMemory(&LoadFont, NULL, -1, -1);
+    LoadFont.HasFileStamp       = FALSE;
+    FaceCount = IntGdiLoadFontsFromMemory(&LoadFont, NULL, -1, -1, NULL);
 
     RtlFreeUnicodeString(&LoadFont.RegValueName);
 
@@ -2776,10 +2967,16 @@ FillTM(TEXTMETRICW *TM, PFONTGDI FontGDI,
 {
     FT_Fixed XScale, YScale;
     int Ascent, Descent;
-    FT_Face Face = FontGDI->SharedFace->Face;
+    FT_Face Face = SharedFace_GetFace(FontGDI->SharedFace);
 
     ASSERT_FREETYPE_LOCK_HELD();
 
+    if (!Face)
+    {
+        RtlZeroMemory(TM, sizeof(*TM));
+        return;
+    }
+
     XScale = Face->size->metrics.x_scale;
     YScale = Face->size->metrics.y_scale;
 
@@ -2985,10 +3182,6 @@ FillTM(TEXTMETRICW *TM, PFONTGDI FontGDI,
     TM->tmCharSet = FontGDI->CharSet;
 }
 
-static NTSTATUS
-IntGetFontLocalizedName(PUNICODE_STRING pNameW, PSHARED_FACE SharedFace,
-                        FT_UShort NameID, FT_UShort LangID);
-
 typedef struct FONT_NAMES
 {
     UNICODE_STRING FamilyNameW;     /* family name (TT_NAME_ID_FONT_FAMILY) */
@@ -3087,7 +3280,7 @@ IntGetOutlineTextMetrics(PFONTGDI FontGDI,
     FONT_NAMES FontNames;
     PSHARED_FACE SharedFace = FontGDI->SharedFace;
     PSHARED_FACE_CACHE Cache;
-    FT_Face Face = SharedFace->Face;
+    FT_Face Face;
 
     if (bLocked)
         ASSERT_FREETYPE_LOCK_HELD();
@@ -3109,6 +3302,10 @@ IntGetOutlineTextMetrics(PFONTGDI FontGDI,
         return Cache->OutlineRequiredSize;
     }
 
+    Face = SharedFace_GetFace(SharedFace);
+    if (!Face)
+        return 0;
+
     if (!bLocked)
         IntLockFreeType();
 
@@ -3300,7 +3497,7 @@ IntGetFontLocalizedName(PUNICODE_STRING pNameW, PSHARED_FACE SharedFace,
     NTSTATUS Status = STATUS_NOT_FOUND;
     ANSI_STRING AnsiName;
     PSHARED_FACE_CACHE Cache;
-    FT_Face Face = SharedFace->Face;
+    FT_Face Face;
 
     RtlFreeUnicodeString(pNameW);
 
@@ -3324,6 +3521,10 @@ IntGetFontLocalizedName(PUNICODE_STRING pNameW, PSHARED_FACE SharedFace,
         return DuplicateUnicodeString(&Cache->FullName, pNameW);
     }
 
+    Face = SharedFace_GetFace(SharedFace);
+    if (!Face)
+        return STATUS_UNSUCCESSFUL;
+
     BestIndex = -1;
     BestScore = 0;
 
@@ -3463,11 +3664,13 @@ FontFamilyFillInfo(PFONTFAMILYINFO Info, LPCWSTR FaceName,
     DWORD fs0;
     NTSTATUS status;
     PSHARED_FACE SharedFace = FontGDI->SharedFace;
-    FT_Face Face = SharedFace->Face;
+    FT_Face Face = SharedFace_GetFace(SharedFace);
     UNICODE_STRING NameW;
 
     RtlInitUnicodeString(&NameW, NULL);
     RtlZeroMemory(Info, sizeof(FONTFAMILYINFO));
+    if (!Face)
+        return;
     ASSERT_FREETYPE_LOCK_HELD();
     Size = IntGetOutlineTextMetrics(FontGDI, 0, NULL, TRUE);
     Otm = ExAllocatePoolWithTag(PagedPool, Size, GDITAG_TEXT);
@@ -3629,6 +3832,23 @@ FontFamilyFillInfo(PFONTFAMILYINFO Info, LPCWSTR FaceName,
     Info->NewTextMetricEx.ntmFontSig = fs;
 }
 
+/* The family and full names of the face in the user language, if known without parsing it */
+static PSHARED_FACE_CACHE
+SharedFace_GetNameCache(PSHARED_FACE SharedFace)
+{
+    PSHARED_FACE_CACHE Cache;
+
+    if (PRIMARYLANGID(gusLanguageID) == LANG_ENGLISH)
+        Cache = &SharedFace->EnglishUS;
+    else
+        Cache = &SharedFace->UserLanguage;
+
+    if (!Cache->FontFamily.Buffer || !Cache->FullName.Buffer)
+        return NULL;
+
+    return Cache;
+}
+
 static BOOLEAN FASTCALL
 GetFontFamilyInfoForList(const LOGFONTW *LogFont,
                          PFONTFAMILYINFO Info,
@@ -3641,6 +3861,7 @@ GetFontFamilyInfoForList(const LOGFONTW *LogFont,
     PFONT_ENTRY CurrentEntry;
     FONTGDI *FontGDI;
     FONTFAMILYINFO InfoEntry;
+    PSHARED_FACE_CACHE Cache;
     LONG Count = *pCount;
 
     for (Entry = Head->Flink; Entry != Head; Entry = Entry->Flink)
@@ -3655,6 +3876,20 @@ GetFontFamilyInfoForList(const LOGFONTW *LogFont,
             continue;   /* charset mismatch */
         }
 
+        /* skip the faces of other names without parsing them */
+        Cache = SharedFace_GetNameCache(FontGDI->SharedFace);
+        if (Cache && LogFont->lfFaceName[0] != UNICODE_NULL &&
+            _wcsnicmp(LogFont->lfFaceName, Cache->FontFamily.Buffer,
+                      RTL_NUMBER_OF(LogFont->lfFaceName) - 1) != 0 &&
+            _wcsnicmp(LogFont->lfFaceName, Cache->FullName.Buffer,
+                      RTL_NUMBER_OF(LogFont->lfFaceName) - 1) != 0)
+        {
+            continue;
+        }
+
+        if (!SharedFace_GetFace(FontGDI->SharedFace))
+            continue;   /* unusable */
+
         /* get one info entry */
         FontFamilyFillInfo(&InfoEntry, NULL, NULL, FontGDI);
 
@@ -3784,20 +4019,21 @@ IntGetHash(IN LPCVOID pv, IN DWORD cdw)
     return dwHash;
 }
 
-static FT_BitmapGlyph
+static PFONT_CACHE_ENTRY
 IntFindGlyphCache(IN const FONT_CACHE_ENTRY *pCache)
 {
-    PLIST_ENTRY CurrentEntry;
+    PLIST_ENTRY Head, CurrentEntry;
     PFONT_CACHE_ENTRY FontEntry;
     DWORD dwHash = pCache->dwHash;
 
     ASSERT_FREETYPE_LOCK_HELD();
 
-    for (CurrentEntry = g_FontCacheListHead.Flink;
-         CurrentEntry != &g_FontCacheListHead;
+    Head = &g_FontCacheHashTable[dwHash & (FONT_CACHE_BUCKETS - 1)];
+    for (CurrentEntry = Head->Flink;
+         CurrentEntry != Head;
          CurrentEntry = CurrentEntry->Flink)
     {
-        FontEntry = CONTAINING_RECORD(CurrentEntry, FONT_CACHE_ENTRY, ListEntry);
+        FontEntry = CONTAINING_RECORD(CurrentEntry, FONT_CACHE_ENTRY, HashEntry);
         if (FontEntry->dwHash == dwHash &&
             FontEntry->Hashed.GlyphIndex == pCache->Hashed.GlyphIndex &&
             FontEntry->Hashed.Face == pCache->Hashed.Face &&
@@ -3811,24 +4047,27 @@ IntFindGlyphCache(IN const FONT_CACHE_ENTRY *pCache)
         }
     }
 
-    if (CurrentEntry == &g_FontCacheListHead)
+    if (CurrentEntry == Head)
     {
+        ++g_FontCacheMisses;
         return NULL;
     }
 
-    RemoveEntryList(CurrentEntry);
-    InsertHeadList(&g_FontCacheListHead, CurrentEntry);
-    return FontEntry->BitmapGlyph;
+    ++g_FontCacheHits;
+    RemoveEntryList(&FontEntry->ListEntry);
+    InsertHeadList(&g_FontCacheListHead, &FontEntry->ListEntry);
+    return FontEntry;
 }
 
-static FT_BitmapGlyph
+static PFONT_CACHE_ENTRY
 IntGetBitmapGlyphWithCache(
     IN OUT PFONT_CACHE_ENTRY Cache,
     IN FT_GlyphSlot GlyphSlot)
 {
     FT_Glyph GlyphCopy;
     INT error;
-    PFONT_CACHE_ENTRY NewEntry;
+    PFONT_CACHE_ENTRY NewEntry, OldEntry;
+    PSHARED_FACE SharedFace;
     FT_Bitmap AlignedBitmap;
     FT_BitmapGlyph BitmapGlyph;
 
@@ -3872,17 +4111,44 @@ IntGetBitmapGlyphWithCache(
     BitmapGlyph->bitmap = AlignedBitmap;
 
     NewEntry->BitmapGlyph = BitmapGlyph;
+    NewEntry->RefCount = 1;
+    NewEntry->Size = sizeof(FONT_CACHE_ENTRY) + sizeof(FT_BitmapGlyphRec) +
+                     abs(BitmapGlyph->bitmap.pitch) * BitmapGlyph->bitmap.rows;
     NewEntry->dwHash = Cache->dwHash;
     NewEntry->Hashed = Cache->Hashed;
 
+    SharedFace = Cache->Hashed.Face->generic.data;
+    ASSERT(SharedFace && SharedFace->Face == Cache->Hashed.Face);
+
     InsertHeadList(&g_FontCacheListHead, &NewEntry->ListEntry);
-    if (++g_FontCacheNumEntries > MAX_FONT_CACHE)
+    InsertHeadList(&g_FontCacheHashTable[NewEntry->dwHash & (FONT_CACHE_BUCKETS - 1)],
+                   &NewEntry->HashEntry);
+    InsertHeadList(&SharedFace->GlyphCacheHead, &NewEntry->FaceEntry);
+    g_FontCacheNumEntries++;
+    g_FontCacheSize += NewEntry->Size;
+
+    /* Trim the least recently used glyphs, but keep the one we return */
+    while (g_FontCacheSize > FONT_CACHE_BUDGET)
     {
-        NewEntry = CONTAINING_RECORD(g_FontCacheListHead.Blink, FONT_CACHE_ENTRY, ListEntry);
-        RemoveCachedEntry(NewEntry);
+        OldEntry = CONTAINING_RECORD(g_FontCacheListHead.Blink, FONT_CACHE_ENTRY, ListEntry);
+        if (OldEntry == NewEntry)
+            break;
+
+        RemoveCachedEntry(OldEntry);
+        ++g_FontCacheEvictions;
     }
 
-    return BitmapGlyph;
+    return NewEntry;
+}
+
+/* Called from the kernel debugger, so it doesn't take the FreeType lock */
+VOID FASTCALL
+IntDumpFontCache(VOID)
+{
+    DbgPrint("Glyph cache: %u entries, %Iu bytes (budget %u)\n",
+             g_FontCacheNumEntries, g_FontCacheSize, FONT_CACHE_BUDGET);
+    DbgPrint("Hits: %lu, misses: %lu, evictions: %lu\n",
+             g_FontCacheHits, g_FontCacheMisses, g_FontCacheEvictions);
 }
 
 
@@ -4088,12 +4354,15 @@ IntRequestFontSize(PDC dc, PFONTGDI FontGDI, LONG lfWidth, LONG lfHeight)
 {
     FT_Error error;
     FT_Size_RequestRec  req;
-    FT_Face face = FontGDI->SharedFace->Face;
+    FT_Face face = SharedFace_GetFace(FontGDI->SharedFace);
     TT_OS2 *pOS2;
     TT_HoriHeader *pHori;
     FT_WinFNT_HeaderRec WinFNT;
     LONG Ascent, Descent, Sum, EmHeight, Width64;
 
+    if (!face)
+        return FT_Err_Invalid_Face_Handle;
+
     lfWidth = abs(lfWidth);
     if (lfHeight == 0)
     {
@@ -4237,7 +4506,14 @@ TextIntUpdateSize(PDC dc,
     if (bDoLock)
         IntLockFreeType();
 
-    face = FontGDI->SharedFace->Face;
+    face = SharedFace_GetFace(FontGDI->SharedFace);
+    if (!face)
+    {
+        if (bDoLock)
+            IntUnLockFreeType();
+        return FALSE;
+    }
+
     if (face->charmap == NULL)
     {
         DPRINT("WARNING: No charmap selected!\n");
@@ -4408,7 +4684,10 @@ FontLink_Chain_FindGlyph(
         if (!FontLink_PrepareFontInfo(pFontLink))
             continue; // This link is not useful, check the next one
 
-        face = pFontLink->SharedFace->Face;
+        face = SharedFace_GetFace(pFontLink->SharedFace);
+        if (!face)
+            continue; // The face cannot be parsed
+
         index = get_glyph_index(face, code);
         if (!index)
             continue; // The glyph does not exist, continue searching
@@ -4485,7 +4764,12 @@ ftGdiGetGlyphOutline(
         return GDI_ERROR;
     }
     FontGDI = ObjToGDI(TextObj->Font, FONT);
-    ft_face = FontGDI->SharedFace->Face;
+    ft_face = SharedFace_GetFace(FontGDI->SharedFace);
+    if (!ft_face)
+    {
+        TEXTOBJ_UnlockText(TextObj);
+        return GDI_ERROR;
+    }
 
     plf = &TextObj->logfont.elfEnumLogfontEx.elfLogFont;
     aveWidth = FT_IS_SCALABLE(ft_face) ? abs(plf->lfWidth) : 0;
@@ -4914,21 +5198,22 @@ ftGdiGetGlyphOutline(
     return needed;
 }
 
-static FT_BitmapGlyph
-IntGetRealGlyph(
+/* The entry stays valid only as long as the FreeType lock is held */
+static PFONT_CACHE_ENTRY
+IntGetRealGlyphEntry(
     IN OUT PFONT_CACHE_ENTRY Cache)
 {
     INT error;
     FT_GlyphSlot glyph;
-    FT_BitmapGlyph realglyph;
+    PFONT_CACHE_ENTRY Entry;
 
     ASSERT_FREETYPE_LOCK_HELD();
 
     Cache->dwHash = IntGetHash(&Cache->Hashed, sizeof(Cache->Hashed) / sizeof(DWORD));
 
-    realglyph = IntFindGlyphCache(Cache);
-    if (realglyph)
-        return realglyph;
+    Entry = IntFindGlyphCache(Cache);
+    if (Entry)
+        return Entry;
 
     error = FT_Load_Glyph(Cache->Hashed.Face, Cache->Hashed.GlyphIndex, FT_LOAD_DEFAULT);
     if (error)
@@ -4945,12 +5230,21 @@ IntGetRealGlyph(
     if (Cache->Hashed.Aspect.Emu.Italic)
         FT_GlyphSlot_Oblique(glyph); /* Emulate Italic */
 
-    realglyph = IntGetBitmapGlyphWithCache(Cache, glyph);
+    Entry = IntGetBitmapGlyphWithCache(Cache, glyph);
 
-    if (!realglyph)
+    if (!Entry)
         DPRINT1("Failed to render glyph! [index: %d]\n", Cache->Hashed.GlyphIndex);
 
-    return realglyph;
+    return Entry;
+}
+
+static FT_BitmapGlyph
+IntGetRealGlyph(
+    IN OUT PFONT_CACHE_ENTRY Cache)
+{
+    PFONT_CACHE_ENTRY Entry = IntGetRealGlyphEntry(Cache);
+
+    return Entry ? Entry->BitmapGlyph : NULL;
 }
 
 BOOL
@@ -4978,7 +5272,10 @@ TextIntGetTextExtentPoint(PDC dc,
 
     FontGDI = ObjToGDI(TextObj->Font, FONT);
 
-    Cache.Hashed.Face = FontGDI->SharedFace->Face;
+    Cache.Hashed.Face = SharedFace_GetFace(FontGDI->SharedFace);
+    if (!Cache.Hashed.Face)
+        return FALSE;
+
     if (NULL != Fit)
     {
         *Fit = 0;
@@ -5105,8 +5402,10 @@ ftGdiGetTextCharsetInfo(
         return Ret;
     }
     FontGdi = ObjToGDI(TextObj->Font, FONT);
-    Face = FontGdi->SharedFace->Face;
+    Face = SharedFace_GetFace(FontGdi->SharedFace);
     TEXTOBJ_UnlockText(TextObj);
+    if (!Face)
+        return Ret;
 
     memset(&fs, 0, sizeof(FONTSIGNATURE));
     IntLockFreeType();
@@ -5194,7 +5493,10 @@ ftGetFontUnicodeRanges(PFONTGDI Font, PGLYPHSET glyphset)
 {
     DWORD size = 0;
     DWORD num_ranges = 0;
-    FT_Face face = Font->SharedFace->Face;
+    FT_Face face = SharedFace_GetFace(Font->SharedFace);
+
+    if (!face)
+        return 0;
 
     if (face->charmap == NULL)
     {
@@ -5299,12 +5601,14 @@ ftGdiGetTextMetricsW(
         plf = &TextObj->logfont.elfEnumLogfontEx.elfLogFont;
         FontGDI = ObjToGDI(TextObj->Font, FONT);
 
-        Face = FontGDI->SharedFace->Face;
+        Face = SharedFace_GetFace(FontGDI->SharedFace);
 
         // NOTE: GetTextMetrics simply ignores lfEscapement and XFORM.
         IntLockFreeType();
+        /* Fails if the face cannot be parsed */
         Error = IntRequestFontSize(dc, FontGDI, plf->lfWidth, plf->lfHeight);
-        FT_Set_Transform(Face, NULL, NULL);
+        if (!Error)
+            FT_Set_Transform(Face, NULL, NULL);
 
         IntUnLockFreeType();
 
@@ -5369,7 +5673,10 @@ ftGdiGetFontData(
     DWORD Size)
 {
     DWORD Result = GDI_ERROR;
-    FT_Face Face = FontGdi->SharedFace->Face;
+    FT_Face Face = SharedFace_GetFace(FontGdi->SharedFace);
+
+    if (!Face)
+        return Result;
 
     IntLockFreeType();
 
@@ -5746,6 +6053,44 @@ GetFontPenalty(const LOGFONTW *               LogFont,
     return Penalty;     /* success */
 }
 
+/* What GetFontPenalty returns at least for this font, known without parsing the face */
+static UINT
+GetFontPenaltyLowerBound(const LOGFONTW *LogFont, PFONTGDI FontGDI)
+{
+    ULONG   Penalty = 0;
+    BYTE    Byte;
+    const BYTE UserCharSet = CharSetFromLangID(gusLanguageID);
+    PSHARED_FACE_CACHE Cache;
+
+    Byte = LogFont->lfCharSet;
+
+    if (Byte != FontGDI->CharSet)
+    {
+        if (Byte != DEFAULT_CHARSET && Byte != ANSI_CHARSET)
+        {
+            GOT_PENALTY("CharSet", 65000);
+        }
+        else if (UserCharSet != FontGDI->CharSet)
+        {
+            GOT_PENALTY("UNDOCUMENTED:NotUserLanguage", 100);
+
+            if (ANSI_CHARSET != FontGDI->CharSet)
+                GOT_PENALTY("UNDOCUMENTED:NotAnsiCharSet", 100);
+        }
+    }
+
+    /* The cached names are the localized ones GetFontPenalty compares */
+    Cache = SharedFace_GetNameCache(FontGDI->SharedFace);
+    if (LogFont->lfFaceName[0] != UNICODE_NULL && Cache &&
+        _wcsicmp(LogFont->lfFaceName, Cache->FontFamily.Buffer) != 0 &&
+        _wcsicmp(LogFont->lfFaceName, Cache->FullName.Buffer) != 0)
+    {
+        GOT_PENALTY("FaceName", 10000);
+    }
+
+    return Penalty;
+}
+
 #undef GOT_PENALTY
 
 static __inline VOID
@@ -5760,6 +6105,8 @@ FindBestFontFromList(FONTOBJ **FontObj, ULONG *MatchPenalty,
     OUTLINETEXTMETRICW *Otm = NULL;
     UINT OtmSize, OldOtmSize = 0;
     FT_Face Face;
+    UINT LowerBound, Pass;
+    LONG Index, BestIndex = -1; /* The best one is from an earlier list */
 
     ASSERT(FontObj);
     ASSERT(MatchPenalty);
@@ -5770,43 +6117,64 @@ FindBestFontFromList(FONTOBJ **FontObj, ULONG *MatchPenalty,
     OldOtmSize = 0x200;
     Otm = ExAllocatePoolWithTag(PagedPool, OldOtmSize, GDITAG_TEXT);
 
-    /* get the FontObj of lowest penalty */
-    for (Entry = Head->Flink; Entry != Head; Entry = Entry->Flink)
+    /* get the FontObj of lowest penalty. The fonts not of the requested name
+     * go in a second pass: once one of that name is found, they are skipped
+     * without parsing their faces. The list order still breaks ties. */
+    for (Pass = 0; Pass < 2; ++Pass)
     {
-        CurrentEntry = CONTAINING_RECORD(Entry, FONT_ENTRY, ListEntry);
+        for (Entry = Head->Flink, Index = 0; Entry != Head; Entry = Entry->Flink, ++Index)
+        {
+            CurrentEntry = CONTAINING_RECORD(Entry, FONT_ENTRY, ListEntry);
 
-        FontGDI = CurrentEntry->Font;
-        ASSERT(FontGDI);
-        Face = FontGDI->SharedFace->Face;
+            FontGDI = CurrentEntry->Font;
+            ASSERT(FontGDI);
 
-        /* get text metrics */
-        ASSERT_FREETYPE_LOCK_HELD();
-        OtmSize = IntGetOutlineTextMetrics(FontGDI, 0, NULL, TRUE);
-        if (OtmSize > OldOtmSize)
-        {
-            if (Otm)
-                ExFreePoolWithTag(Otm, GDITAG_TEXT);
-            Otm = ExAllocatePoolWithTag(PagedPool, OtmSize, GDITAG_TEXT);
-        }
+            LowerBound = GetFontPenaltyLowerBound(LogFont, FontGDI);
+            if ((LowerBound < 10000) != (Pass == 0))
+                continue;   /* not in this pass */
 
-        /* update FontObj if lowest penalty */
-        if (Otm)
-        {
-            ASSERT_FREETYPE_LOCK_HELD();
-            IntRequestFontSize(NULL, FontGDI, LogFont->lfWidth, LogFont->lfHeight);
+            if (*MatchPenalty != MAXULONG &&
+                (LowerBound > *MatchPenalty ||
+                 (LowerBound == *MatchPenalty && Index > BestIndex)))
+            {
+                continue;   /* cannot win */
+            }
 
-            ASSERT_FREETYPE_LOCK_HELD();
-            OtmSize = IntGetOutlineTextMetrics(FontGDI, OtmSize, Otm, TRUE);
-            if (!OtmSize)
-                continue;
+            Face = SharedFace_GetFace(FontGDI->SharedFace);
+            if (!Face)
+                continue;   /* unusable */
 
-            OldOtmSize = OtmSize;
+            /* get text metrics */
+            ASSERT_FREETYPE_LOCK_HELD();
+            OtmSize = IntGetOutlineTextMetrics(FontGDI, 0, NULL, TRUE);
+            if (OtmSize > OldOtmSize)
+            {
+                if (Otm)
+                    ExFreePoolWithTag(Otm, GDITAG_TEXT);
+                Otm = ExAllocatePoolWithTag(PagedPool, OtmSize, GDITAG_TEXT);
+            }
 
-            Penalty = GetFontPenalty(LogFont, Otm, Face->style_name);
-            if (*MatchPenalty == MAXULONG || Penalty < *MatchPenalty)
+            /* update FontObj if lowest penalty */
+            if (Otm)
             {
-                *FontObj = GDIToObj(FontGDI, FONT);
-                *MatchPenalty = Penalty;
+                ASSERT_FREETYPE_LOCK_HELD();
+                IntRequestFontSize(NULL, FontGDI, LogFont->lfWidth, LogFont->lfHeight);
+
+                ASSERT_FREETYPE_LOCK_HELD();
+                OtmSize = IntGetOutlineTextMetrics(FontGDI, OtmSize, Otm, TRUE);
+                if (!OtmSize)
+                    continue;
+
+                OldOtmSize = OtmSize;
+
+                Penalty = GetFontPenalty(LogFont, Otm, Face->style_name);
+                if (*MatchPenalty == MAXULONG || Penalty < *MatchPenalty ||
+                    (Penalty == *MatchPenalty && Index < BestIndex))
+                {
+                    *FontObj = GDIToObj(FontGDI, FONT);
+                    *MatchPenalty = Penalty;
+                    BestIndex = Index;
+                }
             }
         }
     }
@@ -5822,7 +6190,10 @@ IntFontType(PFONTGDI Font)
 {
     PS_FontInfoRec psfInfo;
     FT_ULong tmp_size = 0;
-    FT_Face Face = Font->SharedFace->Face;
+    FT_Face Face = SharedFace_GetFace(Font->SharedFace);
+
+    if (!Face)
+        return;
 
     ASSERT_FREETYPE_LOCK_NOT_HELD();
     IntLockFreeType();
@@ -6362,11 +6733,16 @@ BOOL
 FASTCALL
 ftGdiRealizationInfo(PFONTGDI Font, PREALIZATION_INFO Info)
 {
-    if (FT_HAS_FIXED_SIZES(Font->SharedFace->Face))
+    FT_Face Face = SharedFace_GetFace(Font->SharedFace);
+
+    if (!Face)
+        return FALSE;
+
+    if (FT_HAS_FIXED_SIZES(Face))
         Info->iTechnology = RI_TECH_BITMAP;
     else
     {
-        if (FT_IS_SCALABLE(Font->SharedFace->Face))
+        if (FT_IS_SCALABLE(Face))
             Info->iTechnology = RI_TECH_SCALABLE;
         else
             Info->iTechnology = RI_TECH_FIXED;
@@ -6385,9 +6761,9 @@ ftGdiGetKerningPairs( PFONTGDI Font,
 {
     DWORD Count = 0;
     INT i = 0;
-    FT_Face face = Font->SharedFace->Face;
+    FT_Face face = SharedFace_GetFace(Font->SharedFace);
 
-    if (FT_HAS_KERNING(face) && face->charmap->encoding == FT_ENCODING_UNICODE)
+    if (face && FT_HAS_KERNING(face) && face->charmap->encoding == FT_ENCODING_UNICODE)
     {
         FT_UInt previous_index = 0, glyph_index = 0;
         FT_ULong char_code, char_previous;
@@ -6753,6 +7129,15 @@ IntEngFillBox(
 }
 
 
+/* A glyph resolved by IntExtTextOutW, drawn once the FreeType lock is released */
+typedef struct _GLYPH_BLIT
+{
+    PFONT_CACHE_ENTRY Entry;    /* Referenced */
+    RECTL DestRect;
+} GLYPH_BLIT, *PGLYPH_BLIT;
+
+#define GLYPH_BLIT_STACK_COUNT 32
+
 BOOL
 APIENTRY
 IntExtTextOutW(
@@ -6799,6 +7184,12 @@ IntExtTextOutW(
     const DWORD del = 0x7f, nbsp = 0xa0; // DEL is ASCII DELETE and nbsp is a non-breaking space
     FONTLINK_CHAIN Chain;
     SIZE spaceWidth;
+    GLYPH_BLIT GlyphsBuffer[GLYPH_BLIT_STACK_COUNT];
+    PGLYPH_BLIT Glyphs = NULL;
+    INT GlyphCount = 0;
+    PFONT_CACHE_ENTRY GlyphEntry;
+    INT underline_position = 0, thickness = 1;
+    LONG tmAscent;
 
     /* Check if String is valid */
     if (Count > 0xFFFF || (Count > 0 && String == NULL))
@@ -6893,8 +7284,25 @@ IntExtTextOutW(
     FontGDI = ObjToGDI(FontObj, FONT);
     ASSERT(FontGDI);
 
+    /* The glyphs are only looked up under the FreeType lock, they are drawn
+     * after it is released so that other threads can render meanwhile */
+    if (Count <= GLYPH_BLIT_STACK_COUNT)
+    {
+        Glyphs = GlyphsBuffer;
+    }
+    else
+    {
+        Glyphs = ExAllocatePoolWithTag(PagedPool, Count * sizeof(GLYPH_BLIT), GDITAG_TEXT);
+        if (!Glyphs)
+        {
+            EngSetLastError(ERROR_NOT_ENOUGH_MEMORY);
+            bResult = FALSE;
+            goto Cleanup;
+        }
+    }
+
     IntLockFreeType();
-    Cache.Hashed.Face = face = FontGDI->SharedFace->Face;
+    Cache.Hashed.Face = face = SharedFace_GetFace(FontGDI->SharedFace);
 
     plf = &TextObj->logfont.elfEnumLogfontEx.elfLogFont;
     Cache.Hashed.lfHeight = plf->lfHeight;
@@ -7011,14 +7419,8 @@ IntExtTextOutW(
         }
     }
 
-    EXLATEOBJ_vInitialize(&exloRGB2Dst, &gpalRGB, psurf->ppal, 0, 0, 0);
-    EXLATEOBJ_vInitialize(&exloDst2RGB, psurf->ppal, &gpalRGB, 0, 0, 0);
-
-    if (pdcattr->ulDirty_ & DIRTY_TEXT)
-        DC_vUpdateTextBrush(dc);
-
     /*
-     * The main rendering loop.
+     * The main layout loop.
      */
     X64 = RealXStart64;
     Y64 = RealYStart64;
@@ -7043,12 +7445,17 @@ IntExtTextOutW(
                                                (fuOptions & ETO_GLYPH_INDEX));
         Cache.Hashed.GlyphIndex = glyph_index;
 
-        realglyph = IntGetRealGlyph(&Cache);
-        if (!realglyph)
+        GlyphEntry = IntGetRealGlyphEntry(&Cache);
+        if (!GlyphEntry)
         {
             bResult = FALSE;
             break;
         }
+        realglyph = GlyphEntry->BitmapGlyph;
+
+        /* Keep it alive until it is drawn, even if the cache drops it */
+        InterlockedIncrement(&GlyphEntry->RefCount);
+        Glyphs[GlyphCount].Entry = GlyphEntry;
 
         /* retrieve kerning distance and move pen position */
         if (use_kerning && previous && glyph_index && NULL == Dx)
@@ -7081,79 +7488,32 @@ IntExtTextOutW(
             realglyph->left = 0;
         }
 
-        MaskRect.right = realglyph->bitmap.width;
-        MaskRect.bottom = realglyph->bitmap.rows;
-
         DestRect.left   = ((X64 + 32) >> 6) + realglyph->left;
         DestRect.right  = DestRect.left + bitSize.cx;
         DestRect.top    = ((Y64 + 32) >> 6) - realglyph->top;
         DestRect.bottom = DestRect.top + bitSize.cy;
 
         /* Check if the bitmap has any pixels */
-        if ((bitSize.cx != 0) && (bitSize.cy != 0))
-        {
-            /*
-             * We should create the bitmap out of the loop at the biggest possible
-             * glyph size. Then use memset with 0 to clear it and sourcerect to
-             * limit the work of the transbitblt.
-             */
-            HSourceGlyph = EngCreateBitmap(bitSize, realglyph->bitmap.pitch,
-                                           BMF_8BPP, BMF_TOPDOWN,
-                                           realglyph->bitmap.buffer);
-            if (!HSourceGlyph)
-            {
-                DPRINT1("WARNING: EngCreateBitmap() failed!\n");
-                bResult = FALSE;
-                break;
-            }
-
-            SourceGlyphSurf = EngLockSurface((HSURF)HSourceGlyph);
-            if (!SourceGlyphSurf)
-            {
-                EngDeleteSurface((HSURF)HSourceGlyph);
-                DPRINT1("WARNING: EngLockSurface() failed!\n");
-                bResult = FALSE;
-                break;
-            }
-
-            /*
-             * Use the font data as a mask to paint onto the DCs surface using a
-             * brush.
-             */
-            if (lprc && (fuOptions & ETO_CLIPPED))
+        if ((bitSize.cx != 0) && (bitSize.cy != 0) &&
+            lprc && (fuOptions & ETO_CLIPPED))
+        {
+            // We do the check '>=' instead of '>' to possibly save an iteration
+            // through this loop, since it's breaking after the drawing is done,
+            // and x is always incremented.
+            if (DestRect.right >= lprc->right)
             {
-                // We do the check '>=' instead of '>' to possibly save an iteration
-                // through this loop, since it's breaking after the drawing is done,
-                // and x is always incremented.
-                if (DestRect.right >= lprc->right)
-                {
-                    DestRect.right = lprc->right;
-                    DoBreak = TRUE;
-                }
-
-                if (DestRect.bottom >= lprc->bottom)
-                {
-                    DestRect.bottom = lprc->bottom;
-                }
+                DestRect.right = lprc->right;
+                DoBreak = TRUE;
             }
 
-            if (!IntEngMaskBlt(SurfObj,
-                               SourceGlyphSurf,
-                               (CLIPOBJ *)&dc->co,
-                               &exloRGB2Dst.xlo,
-                               &exloDst2RGB.xlo,
-                               &DestRect,
-                               (PPOINTL)&MaskRect,
-                               &dc->eboText.BrushObject,
-                               &PointZero))
+            if (DestRect.bottom >= lprc->bottom)
             {
-                DPRINT1("Failed to MaskBlt a glyph!\n");
+                DestRect.bottom = lprc->bottom;
             }
-
-            EngUnlockSurface(SourceGlyphSurf);
-            EngDeleteSurface((HSURF)HSourceGlyph);
         }
 
+        Glyphs[GlyphCount++].DestRect = DestRect;
+
         if (DoBreak)
             break;
 
@@ -7189,30 +7549,98 @@ IntExtTextOutW(
     if ((pdcattr->flTextAlign & TA_UPDATECP) && String)
         pdcattr->ptlCurrent.x = DestRect.right - dc->ptlDCOrig.x;
 
-    if (plf->lfUnderline || plf->lfStrikeOut) /* Underline or strike-out? */
+    /* Calculate the position and the thickness of the lines while the face
+     * and its size can't change */
+    if ((plf->lfUnderline || plf->lfStrikeOut) && face->units_per_EM)
     {
-        /* Calculate the position and the thickness */
-        INT underline_position, thickness;
-        FT_Vector vecA64, vecB64;
+        underline_position =
+            face->underline_position * face->size->metrics.y_ppem / face->units_per_EM;
+        thickness =
+            face->underline_thickness * face->size->metrics.y_ppem / face->units_per_EM;
+        if (thickness <= 0)
+            thickness = 1;
+    }
+    tmAscent = FontGDI->tmAscent;
 
-        DeltaX64 = X64 - RealXStart64;
-        DeltaY64 = Y64 - RealYStart64;
+    FontLink_Chain_Finish(&Chain);
+
+    IntUnLockFreeType();
+
+    EXLATEOBJ_vInitialize(&exloRGB2Dst, &gpalRGB, psurf->ppal, 0, 0, 0);
+    EXLATEOBJ_vInitialize(&exloDst2RGB, psurf->ppal, &gpalRGB, 0, 0, 0);
+
+    if (pdcattr->ulDirty_ & DIRTY_TEXT)
+        DC_vUpdateTextBrush(dc);
+
+    /*
+     * The main rendering loop.
+     */
+    for (i = 0; i < GlyphCount; ++i)
+    {
+        realglyph = Glyphs[i].Entry->BitmapGlyph;
+
+        bitSize.cx = realglyph->bitmap.width;
+        bitSize.cy = realglyph->bitmap.rows;
+
+        /* Check if the bitmap has any pixels */
+        if ((bitSize.cx == 0) || (bitSize.cy == 0))
+            continue;
 
-        if (!face->units_per_EM)
+        MaskRect.right = bitSize.cx;
+        MaskRect.bottom = bitSize.cy;
+
+        /*
+         * We should create the bitmap out of the loop at the biggest possible
+         * glyph size. Then use memset with 0 to clear it and sourcerect to
+         * limit the work of the transbitblt.
+         */
+        HSourceGlyph = EngCreateBitmap(bitSize, realglyph->bitmap.pitch,
+                                       BMF_8BPP, BMF_TOPDOWN,
+                                       realglyph->bitmap.buffer);
+        if (!HSourceGlyph)
         {
-            underline_position = 0;
-            thickness = 1;
+            DPRINT1("WARNING: EngCreateBitmap() failed!\n");
+            bResult = FALSE;
+            break;
         }
-        else
+
+        SourceGlyphSurf = EngLockSurface((HSURF)HSourceGlyph);
+        if (!SourceGlyphSurf)
         {
-            underline_position =
-                face->underline_position * face->size->metrics.y_ppem / face->units_per_EM;
-            thickness =
-                face->underline_thickness * face->size->metrics.y_ppem / face->units_per_EM;
-            if (thickness <= 0)
-                thickness = 1;
+            EngDeleteSurface((HSURF)HSourceGlyph);
+            DPRINT1("WARNING: EngLockSurface() failed!\n");
+            bResult = FALSE;
+            break;
         }
 
+        /*
+         * Use the font data as a mask to paint onto the DCs surface using a
+         * brush.
+         */
+        if (!IntEngMaskBlt(SurfObj,
+                           SourceGlyphSurf,
+                           (CLIPOBJ *)&dc->co,
+                           &exloRGB2Dst.xlo,
+                           &exloDst2RGB.xlo,
+                           &Glyphs[i].DestRect,
+                           (PPOINTL)&MaskRect,
+                           &dc->eboText.BrushObject,
+                           &PointZero))
+        {
+            DPRINT1("Failed to MaskBlt a glyph!\n");
+        }
+
+        EngUnlockSurface(SourceGlyphSurf);
+        EngDeleteSurface((HSURF)HSourceGlyph);
+    }
+
+    if (plf->lfUnderline || plf->lfStrikeOut) /* Underline or strike-out? */
+    {
+        FT_Vector vecA64, vecB64;
+
+        DeltaX64 = X64 - RealXStart64;
+        DeltaY64 = Y64 - RealYStart64;
+
         if (plf->lfUnderline) /* Draw underline */
         {
             vecA64.x = 0;
@@ -7250,7 +7678,7 @@ IntExtTextOutW(
         if (plf->lfStrikeOut) /* Draw strike-out */
         {
             vecA64.x = 0;
-            vecA64.y = -(FontGDI->tmAscent << 6) / 3;
+            vecA64.y = -(tmAscent << 6) / 3;
             vecB64.x = 0;
             vecB64.y = vecA64.y + (thickness << 6);
             FT_Vector_Transform(&vecA64, &Cache.Hashed.matTransform);
@@ -7282,16 +7710,18 @@ IntExtTextOutW(
         }
     }
 
-    FontLink_Chain_Finish(&Chain);
-
-    IntUnLockFreeType();
-
     EXLATEOBJ_vCleanup(&exloRGB2Dst);
     EXLATEOBJ_vCleanup(&exloDst2RGB);
 
+    for (i = 0; i < GlyphCount; ++i)
+        IntReleaseGlyphEntry(Glyphs[i].Entry);
+
 Cleanup:
     DC_vFinishBlit(dc, NULL);
 
+    if (Glyphs && Glyphs != GlyphsBuffer)
+        ExFreePoolWithTag(Glyphs, GDITAG_TEXT);
+
     if (TextObj != NULL)
         TEXTOBJ_UnlockText(TextObj);
 
@@ -7571,7 +8001,19 @@ NtGdiGetCharABCWidthsW(
 
     FontGDI = ObjToGDI(TextObj->Font, FONT);
 
-    face = FontGDI->SharedFace->Face;
+    face = SharedFace_GetFace(FontGDI->SharedFace);
+    if (!face)
+    {
+        TEXTOBJ_UnlockText(TextObj);
+        ExFreePoolWithTag(SafeBuff, GDITAG_TEXT);
+
+        if(Safepwch)
+            ExFreePoolWithTag(Safepwch , GDITAG_TEXT);
+
+        EngSetLastError(ERROR_INVALID_HANDLE);
+        return FALSE;
+    }
+
     if (face->charmap == NULL)
     {
         for (i = 0; i < (UINT)face->num_charmaps; i++)
@@ -7760,7 +8202,19 @@ NtGdiGetCharWidthW(
 
     FontGDI = ObjToGDI(TextObj->Font, FONT);
 
-    face = FontGDI->SharedFace->Face;
+    face = SharedFace_GetFace(FontGDI->SharedFace);
+    if (!face)
+    {
+        TEXTOBJ_UnlockText(TextObj);
+        ExFreePoolWithTag(SafeBuff, GDITAG_TEXT);
+
+        if(Safepwc)
+            ExFreePoolWithTag(Safepwc, GDITAG_TEXT);
+
+        EngSetLastError(ERROR_INVALID_HANDLE);
+        return FALSE;
+    }
+
     if (face->charmap == NULL)
     {
         for (i = 0; i < (UINT)face->num_charmaps; i++)
@@ -7896,11 +8350,17 @@ NtGdiGetGlyphIndicesW(
     FontGDI = ObjToGDI(TextObj->Font, FONT);
     TEXTOBJ_UnlockText(TextObj);
 
+    Face = SharedFace_GetFace(FontGDI->SharedFace);
+    if (!Face)
+    {
+        DPRINT1("!Face\n");
+        return GDI_ERROR;
+    }
+
     if (cwc == 0)
     {
         if (!UnSafepwc && !UnSafepgi)
         {
-            Face = FontGDI->SharedFace->Face;
             return Face->num_glyphs;
         }
         else
@@ -7924,7 +8384,6 @@ NtGdiGetGlyphIndicesW(
     }
     else
     {
-        Face = FontGDI->SharedFace->Face;
         if (FT_IS_SFNT(Face))
         {
             IntLockFreeType();
@@ -7988,7 +8447,7 @@ NtGdiGetGlyphIndicesW(
     IntLockFreeType();
     for (i = 0; i < cwc; i++)
     {
-        Buffer[i] = get_glyph_index(FontGDI->SharedFace->Face, Safepwc[i]);
+        Buffer[i] = get_glyph_index(Face, Safepwc[i]);
         if (Buffer[i] == 0)
         {
             Buffer[i] = DefChar;
@@ -62,6 +62,66 @@ SynchronizeDriver(FLONG Flags)
   return;
 }
 
+#define BATCH_ATTR_DIRTY (DIRTY_BACKGROUND|DIRTY_LINE|DIRTY_TEXT|DIRTY_FILL|DC_BRUSH_DIRTY|DC_PEN_DIRTY)
+
+//
+// Switch the DC to the attribute snapshot of a drawing command. The dirty
+// flags set by user mode tell if the realized objects must be updated.
+//
+static
+VOID
+GdiBatchSetAttributes(PDC dc, PGDIBSDRAWATTR pAttr, PGDIBSDRAWATTR pSave, PULONG pflSave)
+{
+  PDC_ATTR pdcattr = dc->pdcattr;
+
+  pSave->hbrush          = pdcattr->hbrush;
+  pSave->hpen            = pdcattr->hpen;
+  pSave->crForegroundClr = pdcattr->crForegroundClr;
+  pSave->crBackgroundClr = pdcattr->crBackgroundClr;
+  pSave->crBrushClr      = pdcattr->crBrushClr;
+  pSave->crPenClr        = pdcattr->crPenClr;
+  pSave->ulForegroundClr = pdcattr->ulForegroundClr;
+  pSave->ulBackgroundClr = pdcattr->ulBackgroundClr;
+  pSave->ulBrushClr      = pdcattr->ulBrushClr;
+  pSave->ulPenClr        = pdcattr->ulPenClr;
+  pSave->lBkMode         = pdcattr->lBkMode;
+  *pflSave = pdcattr->ulDirty_ & BATCH_ATTR_DIRTY;
+
+  pdcattr->hbrush          = pAttr->hbrush;
+  pdcattr->hpen            = pAttr->hpen;
+  pdcattr->crForegroundClr = pAttr->crForegroundClr;
+  pdcattr->crBackgroundClr = pAttr->crBackgroundClr;
+  pdcattr->crBrushClr      = pAttr->crBrushClr;
+  pdcattr->crPenClr        = pAttr->crPenClr;
+  pdcattr->ulForegroundClr = pAttr->ulForegroundClr;
+  pdcattr->ulBackgroundClr = pAttr->ulBackgroundClr;
+  pdcattr->ulBrushClr      = pAttr->ulBrushClr;
+  pdcattr->ulPenClr        = pAttr->ulPenClr;
+  pdcattr->jBkMode         = (BYTE)pAttr->lBkMode;
+  pdcattr->lBkMode         = pAttr->lBkMode;
+}
+
+static
+VOID
+GdiBatchRestoreAttributes(PDC dc, PGDIBSDRAWATTR pSave, ULONG flSave)
+{
+  PDC_ATTR pdcattr = dc->pdcattr;
+
+  pdcattr->hbrush          = pSave->hbrush;
+  pdcattr->hpen            = pSave->hpen;
+  pdcattr->crForegroundClr = pSave->crForegroundClr;
+  pdcattr->crBackgroundClr = pSave->crBackgroundClr;
+  pdcattr->crBrushClr      = pSave->crBrushClr;
+  pdcattr->crPenClr        = pSave->crPenClr;
+  pdcattr->ulForegroundClr = pSave->ulForegroundClr;
+  pdcattr->ulBackgroundClr = pSave->ulBackgroundClr;
+  pdcattr->ulBrushClr      = pSave->ulBrushClr;
+  pdcattr->ulPenClr        = pSave->ulPenClr;
+  pdcattr->jBkMode         = (BYTE)pSave->lBkMode;
+  pdcattr->lBkMode         = pSave->lBkMode;
+  pdcattr->ulDirty_ |= flSave;
+}
+
 //
 // Process the batch.
 //
@@ -443,6 +503,90 @@ GdiFlushUserBatch(PDC dc, PGDIBATCHHDR pHdr)
         break;
      }
 
+     case GdiBCLineTo:
+     {
+        PGDIBSLINETO pgO;
+        GDIBSDRAWATTR SaveAttr;
+        POINTL ptlCurrent, ptfxCurrent;
+        ULONG flSave, flCurrent;
+        if (!dc) break;
+        pgO = (PGDIBSLINETO) pHdr;
+        GdiBatchSetAttributes(dc, &pgO->Attr, &SaveAttr, &flSave);
+        // Start from the position LineTo was called at
+        ptlCurrent  = pdcattr->ptlCurrent;
+        ptfxCurrent = pdcattr->ptfxCurrent;
+        flCurrent   = pdcattr->ulDirty_ & (DIRTY_PTLCURRENT|DIRTY_PTFXCURRENT|DIRTY_STYLESTATE);
+        pdcattr->ptlCurrent = pgO->ptlStart;
+        pdcattr->ulDirty_ &= ~(DIRTY_PTLCURRENT|DIRTY_PTFXCURRENT|DIRTY_STYLESTATE);
+        // A MoveToEx made before the call still starts a new figure and resets the style
+        pdcattr->ulDirty_ |= pgO->flDirty & (DIRTY_PTFXCURRENT|DIRTY_STYLESTATE);
+        NtGdiLineTo(dc->BaseObject.hHmgr, pgO->ptlEnd.x, pgO->ptlEnd.y);
+        // User mode already moved on, keep its current position
+        pdcattr->ptlCurrent  = ptlCurrent;
+        pdcattr->ptfxCurrent = ptfxCurrent;
+        pdcattr->ulDirty_ &= ~(DIRTY_PTLCURRENT|DIRTY_PTFXCURRENT|DIRTY_STYLESTATE);
+        pdcattr->ulDirty_ |= flCurrent;
+        GdiBatchRestoreAttributes(dc, &SaveAttr, flSave);
+        break;
+     }
+
+     case GdiBCPolyline:
+     {
+        PGDIBSPOLYLINE pgO;
+        GDIBSDRAWATTR SaveAttr;
+        ULONG flSave;
+        if (!dc) break;
+        pgO = (PGDIBSPOLYLINE) pHdr;
+        // The count comes from user mode, the points must be within the entry
+        if (pHdr->Size < (SHORT)FIELD_OFFSET(GDIBSPOLYLINE, apt) ||
+            pgO->Count > (pHdr->Size - FIELD_OFFSET(GDIBSPOLYLINE, apt)) / sizeof(POINT))
+        {
+            break;
+        }
+        GdiBatchSetAttributes(dc, &pgO->Attr, &SaveAttr, &flSave);
+        // The points are in the TEB, NtGdiPolyPolyDraw captures them
+        NtGdiPolyPolyDraw(dc->BaseObject.hHmgr, pgO->apt, &pgO->Count, 1, GdiPolyPolyLine);
+        GdiBatchRestoreAttributes(dc, &SaveAttr, flSave);
+        break;
+     }
+
+     case GdiBCRectangle:
+     {
+        PGDIBSRECTANGLE pgO;
+        GDIBSDRAWATTR SaveAttr;
+        ULONG flSave;
+        if (!dc) break;
+        pgO = (PGDIBSRECTANGLE) pHdr;
+        GdiBatchSetAttributes(dc, &pgO->Attr, &SaveAttr, &flSave);
+        NtGdiRectangle(dc->BaseObject.hHmgr, pgO->rc.left, pgO->rc.top, pgO->rc.right, pgO->rc.bottom);
+        GdiBatchRestoreAttributes(dc, &SaveAttr, flSave);
+        break;
+     }
+
+     case GdiBCSetPixel:
+     {
+        PGDIBSSETPIXEL pgO;
+        if (!dc) break;
+        pgO = (PGDIBSSETPIXEL) pHdr;
+        NtGdiSetPixel(dc->BaseObject.hHmgr, pgO->x, pgO->y, pgO->crColor);
+        break;
+     }
+
+     case GdiBCBitBlt:
+     {
+        PGDIBSBITBLT pgO;
+        GDIBSDRAWATTR SaveAttr;
+        ULONG flSave;
+        if (!dc) break;
+        pgO = (PGDIBSBITBLT) pHdr;
+        GdiBatchSetAttributes(dc, &pgO->Attr, &SaveAttr, &flSave);
+        // Source and destination are the batch DC, which is already locked
+        NtGdiBitBlt(dc->BaseObject.hHmgr, pgO->xDest, pgO->yDest, pgO->cx, pgO->cy,
+                    dc->BaseObject.hHmgr, pgO->xSrc, pgO->ySrc, pgO->dwRop, 0, 0);
+        GdiBatchRestoreAttributes(dc, &SaveAttr, flSave);
+        break;
+     }
+
      case GdiBCDelRgn:
         DPRINT("Delete Region Object!\n");
         /* Fall through */
@@ -16,6 +16,7 @@
 #define MAX_PALCOLORS 65536
 
 static UINT SystemPaletteUse = SYSPAL_NOSTATIC;  /* The program need save the pallete and restore it */
+static ULONG gulPaletteUnique = 0;
 
 PALETTE gpalRGB, gpalBGR, gpalRGB555, gpalRGB565, *gppalMono, *gppalDefault;
 PPALETTE appalSurfaceDefault[11];
@@ -103,6 +104,11 @@ InitPaletteImpl(VOID)
     gpalRGB565.BaseObject.ulShareCount = 1;
     gpalRGB565.BaseObject.BaseFlags = 0 ;
 
+    PALETTE_vColorsChanged(&gpalRGB);
+    PALETTE_vColorsChanged(&gpalBGR);
+    PALETTE_vColorsChanged(&gpalRGB555);
+    PALETTE_vColorsChanged(&gpalRGB565);
+
     gppalMono = PALETTE_AllocPalette(PAL_MONOCHROME|PAL_INDEXED, 2, NULL, 0, 0, 0);
     PALETTE_vSetRGBColorForIndex(gppalMono, 0, 0x000000);
     PALETTE_vSetRGBColorForIndex(gppalMono, 1, 0xffffff);
@@ -201,6 +207,8 @@ PALETTE_AllocPalette(
             ppal->flFlags |= PAL_RGB;
     }
 
+    PALETTE_vColorsChanged(ppal);
+
     return ppal;
 }
 
@@ -240,6 +248,28 @@ PALETTE_vCleanup(PVOID ObjectBody)
     {
         ExFreePoolWithTag(pPal->IndexedColors, TAG_PALETTE);
     }
+
+    /* Free the cached translations */
+    if (pPal->pXlateTable)
+    {
+        EngFreeMem(pPal->pXlateTable);
+    }
+    if (pPal->pulInverse)
+    {
+        EngFreeMem(pPal->pulInverse);
+    }
+}
+
+/*
+ * Gives the palette a new unique value, so that color translations
+ * cached for its previous colors are no longer used.
+ */
+VOID
+NTAPI
+PALETTE_vColorsChanged(
+    _Inout_ PPALETTE ppal)
+{
+    ppal->ulColorsUnique = InterlockedIncrement((LONG*)&gulPaletteUnique);
 }
 
 INT
@@ -507,6 +537,7 @@ NtGdiCreatePaletteInternal(
     _SEH2_END;
 
     PALETTE_ValidateFlags(ppal->IndexedColors, cEntries);
+    PALETTE_vColorsChanged(ppal);
     hpal = ppal->BaseObject.hHmgr;
     PALETTE_UnlockPalette(ppal);
 
@@ -814,6 +845,8 @@ IntAnimatePalette(HPALETTE hPal,
             }
         }
 
+        if (ret) PALETTE_vColorsChanged(palPtr);
+
         PALETTE_ShareUnlockPalette(palPtr);
 
 #if 0
@@ -980,6 +1013,7 @@ IntSetPaletteEntries(
         Entries = numEntries - Start;
     }
     memcpy(palGDI->IndexedColors + Start, pe, Entries * sizeof(PALETTEENTRY));
+    PALETTE_vColorsChanged(palGDI);
     PALETTE_ShareUnlockPalette(palGDI);
 
     return Entries;
@@ -1039,6 +1073,7 @@ GreGetSetColorTable(
                 ppal->IndexedColors[i].peGreen = prgbColors->rgbGreen;
                 ppal->IndexedColors[i].peBlue = prgbColors->rgbBlue;
             }
+            PALETTE_vColorsChanged(ppal);
 
             /* Mark the dc brushes invalid */
             pdc->pdcattr->ulDirty_ |= DIRTY_FILL|DIRTY_LINE|
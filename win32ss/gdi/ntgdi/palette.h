@@ -47,6 +47,10 @@ typedef struct _PALETTE
     ULONG ulGreenShift;
     ULONG ulBlueShift;
     HDEV  hPDev;
+    ULONG ulColorsUnique; // Changes whenever the colors change
+    struct _XLATETABLE *pXlateTable; // Last table built with this palette as source
+    PULONG pulInverse; // Nearest index cache when this is a destination
+    ULONG ulInverseUnique; // ulColorsUnique the cache was filled for
     PALETTEENTRY apalColors[0];
 } PALETTE, *PPALETTE;
 
@@ -125,6 +129,11 @@ VOID
 NTAPI
 PALETTE_vCleanup(PVOID ObjectBody);
 
+VOID
+NTAPI
+PALETTE_vColorsChanged(
+    _Inout_ PPALETTE ppal);
+
 FORCEINLINE
 ULONG
 CalculateShift(ULONG ulMask1, ULONG ulMask2)
@@ -155,6 +164,7 @@ PALETTE_vSetRGBColorForIndex(PPALETTE ppal, ULONG ulIndex, COLORREF crColor)
     ppal->IndexedColors[ulIndex].peRed = GetRValue(crColor);
     ppal->IndexedColors[ulIndex].peGreen = GetGValue(crColor);
     ppal->IndexedColors[ulIndex].peBlue = GetBValue(crColor);
+    PALETTE_vColorsChanged(ppal);
 }
 
 HPALETTE
@@ -169,6 +169,15 @@ HRGN    hrgnDefault = NULL;
      (r1)->bottom > (r2)->top && \
      (r1)->top < (r2)->bottom)
 
+/*  1 if r1 contains r2.
+ *  0 if it does not.
+ */
+#define EXTENTCONTAINS(r1, r2) \
+    ((r1)->left <= (r2)->left && \
+     (r1)->top <= (r2)->top && \
+     (r1)->right >= (r2)->right && \
+     (r1)->bottom >= (r2)->bottom)
+
 /*
  *  In scan converting polygons, we want to choose those pixels
  *  which are inside the polygon.  Thus, we add .5 to the starting
@@ -1304,6 +1313,34 @@ REGION_IntersectRegion(
     {
         newReg->rdh.nCount = 0;
     }
+    else if ((reg1->rdh.nCount == 1) && (reg2->rdh.nCount == 1))
+    {
+        /* Two rectangles, the result is their intersection */
+        RECTL rcl;
+
+        rcl.left = max(reg1->rdh.rcBound.left, reg2->rdh.rcBound.left);
+        rcl.top = max(reg1->rdh.rcBound.top, reg2->rdh.rcBound.top);
+        rcl.right = min(reg1->rdh.rcBound.right, reg2->rdh.rcBound.right);
+        rcl.bottom = min(reg1->rdh.rcBound.bottom, reg2->rdh.rcBound.bottom);
+
+        if (!REGION_bEnsureBufferSize(newReg, 1))
+            return FALSE;
+
+        newReg->Buffer[0] = rcl;
+        newReg->rdh.nCount = 1;
+        newReg->rdh.iType = RDH_RECTANGLES;
+    }
+    else if ((reg2->rdh.nCount == 1) &&
+             EXTENTCONTAINS(&reg2->rdh.rcBound, &reg1->rdh.rcBound))
+    {
+        /* The rectangle covers the other region completely */
+        return REGION_CopyRegion(newReg, reg1);
+    }
+    else if ((reg1->rdh.nCount == 1) &&
+             EXTENTCONTAINS(&reg1->rdh.rcBound, &reg2->rdh.rcBound))
+    {
+        return REGION_CopyRegion(newReg, reg2);
+    }
     else
     {
         if (!REGION_RegionOp(newReg,
@@ -1730,6 +1767,14 @@ REGION_SubtractRegion(
         return REGION_CopyRegion(regD, regM);
     }
 
+    /* A rectangle that covers the whole region leaves nothing */
+    if ((regS->rdh.nCount == 1) &&
+        EXTENTCONTAINS(&regS->rdh.rcBound, &regM->rdh.rcBound))
+    {
+        EMPTY_REGION(regD);
+        return TRUE;
+    }
+
     if (!REGION_RegionOp(regD,
                     regM,
                     regS,
@@ -105,12 +105,39 @@ TEXTOBJ_UnlockText(PLFONT plfnt)
 #define AFRX_ALTERNATIVE_PATH 0x2
 #define AFRX_DOS_DEVICE_PATH 0x4
 
+/* What loading a face needs to know about it, see fntcache.c */
+#define FONT_METADATA_MAX_CHARSETS 32
+
+typedef struct _FONT_METADATA
+{
+    LONG FaceCount;                 /* Faces in the file (TrueType collections) */
+    BOOLEAN IsTrueType;
+    BOOLEAN OriginalItalic;
+    USHORT OriginalWeight;
+    ULONG CharSetCount;             /* One font entry per charset, at least one */
+    BYTE CharSets[FONT_METADATA_MAX_CHARSETS];
+    UNICODE_STRING FamilyName;      /* FONT_ENTRY::FaceName */
+    UNICODE_STRING StyleName;       /* FONT_ENTRY::StyleName, empty for "Regular" */
+    UNICODE_STRING LocalFamilyName; /* Localized for gusLanguageID */
+    UNICODE_STRING LocalFullName;
+} FONT_METADATA, *PFONT_METADATA;
+
+VOID FASTCALL IntLoadFontMetadataCache(VOID);
+VOID FASTCALL IntSaveFontMetadataCache(VOID);
+BOOL FASTCALL IntFindFontMetadata(PCUNICODE_STRING FileName, PLARGE_INTEGER FileSize,
+                                  PLARGE_INTEGER LastWriteTime, LONG FaceIndex,
+                                  PFONT_METADATA Metadata);
+VOID FASTCALL IntAddFontMetadata(PCUNICODE_STRING FileName, PLARGE_INTEGER FileSize,
+                                 PLARGE_INTEGER LastWriteTime, LONG FaceIndex,
+                                 const FONT_METADATA *Metadata);
+
 PTEXTOBJ FASTCALL RealizeFontInit(HFONT);
 NTSTATUS FASTCALL TextIntRealizeFont(HFONT,PTEXTOBJ);
 NTSTATUS FASTCALL TextIntCreateFontIndirect(CONST LPLOGFONTW lf, HFONT *NewFont);
 BYTE FASTCALL IntCharSetFromCodePage(UINT uCodePage);
 BOOL FASTCALL InitFontSupport(VOID);
 VOID FASTCALL FreeFontSupport(VOID);
+VOID FASTCALL IntDumpFontCache(VOID);
 BOOL FASTCALL IntIsFontRenderingEnabled(VOID);
 BOOL FASTCALL IntIsFontRenderingEnabled(VOID);
 VOID FASTCALL IntEnableFontRendering(BOOL Enable);
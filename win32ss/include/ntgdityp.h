@@ -92,6 +92,11 @@ typedef enum _GDIBATCHCMD
     GdiBCSelObj,
     GdiBCDelObj,
     GdiBCDelRgn,
+    GdiBCLineTo,
+    GdiBCPolyline,
+    GdiBCRectangle,
+    GdiBCSetPixel,
+    GdiBCBitBlt,
 } GDIBATCHCMD, *PGDIBATCHCMD;
 
 typedef enum _TRANSFORMTYPE
@@ -553,6 +558,69 @@ typedef struct _GDIBSEXTSELCLPRGN
   RECTL rcl;
 } GDIBSEXTSELCLPRGN, *PGDIBSEXTSELCLPRGN;
 
+/* Snapshot of the DC attributes the drawing commands below depend on,
+   they can change in user mode before the batch is flushed. */
+typedef struct _GDIBSDRAWATTR
+{
+  HANDLE hbrush;
+  HANDLE hpen;
+  COLORREF crForegroundClr;
+  COLORREF crBackgroundClr;
+  COLORREF crBrushClr;
+  COLORREF crPenClr;
+  ULONG ulForegroundClr;
+  ULONG ulBackgroundClr;
+  ULONG ulBrushClr;
+  ULONG ulPenClr;
+  LONG lBkMode;
+} GDIBSDRAWATTR, *PGDIBSDRAWATTR;
+
+typedef struct _GDIBSLINETO
+{
+  GDIBATCHHDR gbHdr;
+  GDIBSDRAWATTR Attr;
+  POINTL ptlStart; // Current position when LineTo was called
+  POINTL ptlEnd;
+  ULONG flDirty;   // DIRTY_PTFXCURRENT and DIRTY_STYLESTATE pending at the call
+} GDIBSLINETO, *PGDIBSLINETO;
+
+typedef struct _GDIBSPOLYLINE
+{
+  GDIBATCHHDR gbHdr;
+  GDIBSDRAWATTR Attr;
+  ULONG Count;
+  POINT apt[1];
+} GDIBSPOLYLINE, *PGDIBSPOLYLINE;
+
+typedef struct _GDIBSRECTANGLE
+{
+  GDIBATCHHDR gbHdr;
+  GDIBSDRAWATTR Attr;
+  RECT rc;
+} GDIBSRECTANGLE, *PGDIBSRECTANGLE;
+
+typedef struct _GDIBSSETPIXEL
+{
+  GDIBATCHHDR gbHdr;
+  int x;
+  int y;
+  COLORREF crColor;
+} GDIBSSETPIXEL, *PGDIBSSETPIXEL;
+
+/* Only used when the source is the batch DC itself */
+typedef struct _GDIBSBITBLT
+{
+  GDIBATCHHDR gbHdr;
+  GDIBSDRAWATTR Attr;
+  int xDest;
+  int yDest;
+  int cx;
+  int cy;
+  int xSrc;
+  int ySrc;
+  DWORD dwRop;
+} GDIBSBITBLT, *PGDIBSBITBLT;
+
 /* Use with GdiBCSelObj, GdiBCDelObj and GdiBCDelRgn. */
 typedef struct _GDIBSOBJECT
 {
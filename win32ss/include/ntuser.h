@@ -764,6 +764,9 @@ typedef struct _WND
     LIST_ENTRY ThreadListEntry;
 
     PVOID DialogPointer;
+
+    /* Cached visible region, only used by win32k (see vis.c) */
+    PVOID pVisCache;
 } WND, *PWND;
 
 #define PWND_BOTTOM ((PWND)1)
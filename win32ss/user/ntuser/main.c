@@ -8,6 +8,9 @@
 
 #include <win32k.h>
 #include <napi.h>
+#ifdef _USE_DIBLIB_
+#include "../../gdi/diblib/DibLib_interface.h"
+#endif
 
 #define NDEBUG
 #include <debug.h>
@@ -492,7 +495,7 @@ InitThreadCallback(PETHREAD Thread)
 
     InitializeListHead(&ptiCurrent->WindowListHead);
     InitializeListHead(&ptiCurrent->W32CallbackListHead);
-    InitializeListHead(&ptiCurrent->PostedMessagesListHead);
+    MsqInitializePostedMessages(ptiCurrent);
     InitializeListHead(&ptiCurrent->SentMessagesListHead);
     InitializeListHead(&ptiCurrent->PtiLink);
     for (i = 0; i < NB_HOOKS; i++)
@@ -1050,6 +1053,10 @@ DriverEntry(
     CreateSysColorObjects();
 
     NT_ROF(InitBrushImpl());
+#ifdef _USE_DIBLIB_
+    /* Kernel code may use SSE2, but the AVX state is not saved for it */
+    DibLib_Initialize(DIBLIB_SIMD_SSE2);
+#endif
     NT_ROF(InitPDEVImpl());
     NT_ROF(InitLDEVImpl());
     NT_ROF(InitDeviceImpl());
@@ -727,6 +727,38 @@ co_MsqInsertMouseMessage(MSG* Msg, DWORD flags, ULONG_PTR dwExtraInfo, BOOL Hook
    }
 }
 
+/*
+ * Posted messages are kept in posting order on PostedMessagesListHead and
+ * are also linked in two hash indexes, by window and by message number.
+ * Peeks with a window or a narrow message range filter only walk the
+ * messages that can match, instead of the whole queue.
+ */
+#define MSQ_WND_BUCKET(hWnd) ((HandleToUlong(hWnd) ^ (HandleToUlong(hWnd) >> 16)) % POSTED_INDEX_BUCKETS)
+#define MSQ_MSG_BUCKET(Msg)  ((Msg) % POSTED_INDEX_BUCKETS)
+
+VOID FASTCALL
+MsqInitializePostedMessages(PTHREADINFO pti)
+{
+   UINT i;
+
+   InitializeListHead(&pti->PostedMessagesListHead);
+   for (i = 0; i < POSTED_INDEX_BUCKETS; i++)
+   {
+      InitializeListHead(&pti->aPostedWndIndex[i]);
+      InitializeListHead(&pti->aPostedMsgIndex[i]);
+   }
+   pti->PostedSequence = 0;
+}
+
+static VOID FASTCALL
+MsqInsertPostedMessage(PTHREADINFO pti, PUSER_MESSAGE Message)
+{
+   Message->Sequence = pti->PostedSequence++;
+   InsertTailList(&pti->PostedMessagesListHead, &Message->ListEntry);
+   InsertTailList(&pti->aPostedWndIndex[MSQ_WND_BUCKET(Message->Msg.hwnd)], &Message->WndListEntry);
+   InsertTailList(&pti->aPostedMsgIndex[MSQ_MSG_BUCKET(Message->Msg.message)], &Message->MsgListEntry);
+}
+
 PUSER_MESSAGE FASTCALL
 MsqCreateMessage(LPMSG Msg)
 {
@@ -754,6 +786,12 @@ MsqDestroyMessage(PUSER_MESSAGE Message)
       return;
    }
    RemoveEntryList(&Message->ListEntry);
+   /* Hardware messages are not indexed */
+   if (Message->WndListEntry.Flink)
+   {
+      RemoveEntryList(&Message->WndListEntry);
+      RemoveEntryList(&Message->MsgListEntry);
+   }
    Message->pti = NULL;
    ExFreeToPagedLookasideList(pgMessageLookasideList, Message);
    PostMsgCount--;
@@ -801,19 +839,22 @@ MsqRemoveWindowMessagesFromQueue(PWND Window)
    PUSER_SENT_MESSAGE SentMessage;
    PUSER_MESSAGE PostedMessage;
    PLIST_ENTRY CurrentEntry, ListHead;
+   HWND hWnd;
 
    ASSERT(Window);
 
    pti = Window->head.pti;
+   hWnd = UserHMGetHandle(Window);
 
    /* remove the posted messages for this window */
-   CurrentEntry = pti->PostedMessagesListHead.Flink;
-   ListHead = &pti->PostedMessagesListHead;
+   ListHead = &pti->aPostedWndIndex[MSQ_WND_BUCKET(hWnd)];
+   CurrentEntry = ListHead->Flink;
    while (CurrentEntry != ListHead)
    {
-      PostedMessage = CONTAINING_RECORD(CurrentEntry, USER_MESSAGE, ListEntry);
+      PostedMessage = CONTAINING_RECORD(CurrentEntry, USER_MESSAGE, WndListEntry);
+      CurrentEntry = CurrentEntry->Flink;
 
-      if (PostedMessage->Msg.hwnd == UserHMGetHandle(Window))
+      if (PostedMessage->Msg.hwnd == hWnd)
       {
          if (PostedMessage->Msg.message == WM_QUIT && pti->QuitPosted == 0)
          {
@@ -822,11 +863,6 @@ MsqRemoveWindowMessagesFromQueue(PWND Window)
          }
          ClearMsgBitsMask(pti, PostedMessage->QS_Flags);
          MsqDestroyMessage(PostedMessage);
-         CurrentEntry = pti->PostedMessagesListHead.Flink;
-      }
-      else
-      {
-         CurrentEntry = CurrentEntry->Flink;
       }
    }
 
@@ -1366,7 +1402,7 @@ MsqPostMessage(PTHREADINFO pti,
 
    if (!HardwareMessage)
    {
-       InsertTailList(&pti->PostedMessagesListHead, &Message->ListEntry);
+       MsqInsertPostedMessage(pti, Message);
    }
    else
    {
@@ -2052,6 +2088,91 @@ co_MsqPeekHardwareMessage(IN PTHREADINFO pti,
    return Ret;
 }
 
+static BOOLEAN
+MsqPostedMessageMatches(PUSER_MESSAGE CurrentMessage,
+                        PWND Window,
+                        UINT MsgFilterLow,
+                        UINT MsgFilterHigh,
+                        UINT QSflags)
+{
+/*
+ MSDN:
+ 1: any window that belongs to the current thread, and any messages on the current thread's message queue whose hwnd value is NULL.
+ 2: retrieves only messages on the current thread's message queue whose hwnd value is NULL.
+ 3: handle to the window whose messages are to be retrieved.
+ */
+   return ( ( !Window || // 1
+             ( Window == PWND_BOTTOM && CurrentMessage->Msg.hwnd == NULL ) || // 2
+             ( Window != PWND_BOTTOM && UserHMGetHandle(Window) == CurrentMessage->Msg.hwnd ) ) && // 3
+             ( ( ( MsgFilterLow == 0 && MsgFilterHigh == 0 ) && CurrentMessage->QS_Flags & QSflags ) ||
+               ( MsgFilterLow <= CurrentMessage->Msg.message && MsgFilterHigh >= CurrentMessage->Msg.message ) ) );
+}
+
+/* Returns the oldest posted message that matches the filters */
+static PUSER_MESSAGE
+MsqFindPostedMessage(PTHREADINFO pti,
+                     PWND Window,
+                     UINT MsgFilterLow,
+                     UINT MsgFilterHigh,
+                     UINT QSflags)
+{
+   PUSER_MESSAGE CurrentMessage, Found = NULL;
+   PLIST_ENTRY ListHead, Entry;
+   HWND hWnd;
+   UINT Msg;
+
+   /* A narrow message range, each of its messages has its own bucket */
+   if ((MsgFilterLow != 0 || MsgFilterHigh != 0) &&
+       MsgFilterLow <= MsgFilterHigh &&
+       MsgFilterHigh - MsgFilterLow < POSTED_INDEX_BUCKETS)
+   {
+      for (Msg = MsgFilterLow; ; Msg++)
+      {
+         ListHead = &pti->aPostedMsgIndex[MSQ_MSG_BUCKET(Msg)];
+         for (Entry = ListHead->Flink; Entry != ListHead; Entry = Entry->Flink)
+         {
+            CurrentMessage = CONTAINING_RECORD(Entry, USER_MESSAGE, MsgListEntry);
+
+            /* Newer than what was found already */
+            if (Found && (LONG)(CurrentMessage->Sequence - Found->Sequence) > 0)
+               break;
+
+            if (MsqPostedMessageMatches(CurrentMessage, Window, MsgFilterLow, MsgFilterHigh, QSflags))
+            {
+               Found = CurrentMessage;
+               break;
+            }
+         }
+
+         if (Msg == MsgFilterHigh) break;
+      }
+      return Found;
+   }
+
+   /* The messages of one window */
+   if (Window)
+   {
+      hWnd = (Window == PWND_BOTTOM) ? NULL : UserHMGetHandle(Window);
+      ListHead = &pti->aPostedWndIndex[MSQ_WND_BUCKET(hWnd)];
+      for (Entry = ListHead->Flink; Entry != ListHead; Entry = Entry->Flink)
+      {
+         CurrentMessage = CONTAINING_RECORD(Entry, USER_MESSAGE, WndListEntry);
+         if (MsqPostedMessageMatches(CurrentMessage, Window, MsgFilterLow, MsgFilterHigh, QSflags))
+            return CurrentMessage;
+      }
+      return NULL;
+   }
+
+   ListHead = &pti->PostedMessagesListHead;
+   for (Entry = ListHead->Flink; Entry != ListHead; Entry = Entry->Flink)
+   {
+      CurrentMessage = CONTAINING_RECORD(Entry, USER_MESSAGE, ListEntry);
+      if (MsqPostedMessageMatches(CurrentMessage, Window, MsgFilterLow, MsgFilterHigh, QSflags))
+         return CurrentMessage;
+   }
+   return NULL;
+}
+
 BOOLEAN APIENTRY
 MsqPeekMessage(IN PTHREADINFO pti,
                   IN BOOLEAN Remove,
@@ -2064,49 +2185,28 @@ MsqPeekMessage(IN PTHREADINFO pti,
                   OUT PMSG Message)
 {
    PUSER_MESSAGE CurrentMessage;
-   PLIST_ENTRY ListHead;
    DWORD QS_Flags;
-   BOOL Ret = FALSE;
 
-   ListHead = pti->PostedMessagesListHead.Flink;
+   if (IsListEmpty(&pti->PostedMessagesListHead)) return FALSE;
 
-   if (IsListEmpty(ListHead)) return FALSE;
+   CurrentMessage = MsqFindPostedMessage(pti, Window, MsgFilterLow, MsgFilterHigh, QSflags);
+   if (!CurrentMessage) return FALSE;
 
-   while(ListHead != &pti->PostedMessagesListHead)
-   {
-      CurrentMessage = CONTAINING_RECORD(ListHead, USER_MESSAGE, ListEntry);
-      ListHead = ListHead->Flink;
-/*
- MSDN:
- 1: any window that belongs to the current thread, and any messages on the current thread's message queue whose hwnd value is NULL.
- 2: retrieves only messages on the current thread's message queue whose hwnd value is NULL.
- 3: handle to the window whose messages are to be retrieved.
- */
-      if ( ( !Window || // 1
-            ( Window == PWND_BOTTOM && CurrentMessage->Msg.hwnd == NULL ) || // 2
-            ( Window != PWND_BOTTOM && UserHMGetHandle(Window) == CurrentMessage->Msg.hwnd ) ) && // 3
-            ( ( ( MsgFilterLow == 0 && MsgFilterHigh == 0 ) && CurrentMessage->QS_Flags & QSflags ) ||
-              ( MsgFilterLow <= CurrentMessage->Msg.message && MsgFilterHigh >= CurrentMessage->Msg.message ) ) )
-      {
-         *Message   = CurrentMessage->Msg;
-         *ExtraInfo = CurrentMessage->ExtraInfo;
-         QS_Flags   = CurrentMessage->QS_Flags;
-         if (dwQEvent) *dwQEvent = CurrentMessage->dwQEvent;
+   *Message   = CurrentMessage->Msg;
+   *ExtraInfo = CurrentMessage->ExtraInfo;
+   QS_Flags   = CurrentMessage->QS_Flags;
+   if (dwQEvent) *dwQEvent = CurrentMessage->dwQEvent;
 
-         if (Remove)
-         {
-             if (CurrentMessage->pti != NULL)
-             {
-                MsqDestroyMessage(CurrentMessage);
-             }
-             ClearMsgBitsMask(pti, QS_Flags);
-         }
-         Ret = TRUE;
-         break;
-      }
+   if (Remove)
+   {
+       if (CurrentMessage->pti != NULL)
+       {
+          MsqDestroyMessage(CurrentMessage);
+       }
+       ClearMsgBitsMask(pti, QS_Flags);
    }
 
-   return Ret;
+   return TRUE;
 }
 
 NTSTATUS FASTCALL
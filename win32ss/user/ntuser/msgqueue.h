@@ -8,6 +8,9 @@
 typedef struct _USER_MESSAGE
 {
   LIST_ENTRY ListEntry;
+  LIST_ENTRY WndListEntry; // Posted messages only, in aPostedWndIndex
+  LIST_ENTRY MsgListEntry; // Posted messages only, in aPostedMsgIndex
+  ULONG Sequence;          // Posting order, to merge the index lists
   MSG Msg;
   DWORD QS_Flags;
   LONG_PTR ExtraInfo;
@@ -133,6 +136,7 @@ NTSTATUS FASTCALL co_MsqSendMessage(PTHREADINFO ptirec,
            HWND Wnd, UINT Msg, WPARAM wParam, LPARAM lParam,
            UINT uTimeout, BOOL Block, INT HookMessage, ULONG_PTR *uResult);
 PUSER_MESSAGE FASTCALL MsqCreateMessage(LPMSG Msg);
+VOID FASTCALL MsqInitializePostedMessages(PTHREADINFO pti);
 VOID FASTCALL MsqDestroyMessage(PUSER_MESSAGE Message);
 VOID FASTCALL MsqPostMessage(PTHREADINFO, MSG*, BOOLEAN, DWORD, DWORD, LONG_PTR);
 VOID FASTCALL MsqPostQuitMessage(PTHREADINFO pti, ULONG ExitCode);
@@ -9,24 +9,107 @@
 #include <win32k.h>
 DBG_DEFAULT_CHANNEL(UserWinpos);
 
-PREGION FASTCALL
-VIS_ComputeVisibleRegion(
-   PWND Wnd,
-   BOOLEAN ClientArea,
-   BOOLEAN ClipChildren,
-   BOOLEAN ClipSiblings)
+/*
+ * Visible regions are cached per window. Every change of the window layout
+ * is logged together with the screen area it touched, a cached region stays
+ * valid as long as none of the changes logged since it was computed touched
+ * the window. Moving a window then only recomputes the windows around it.
+ */
+#define VIS_CHANGE_LOG_SIZE 64
+
+#define VIS_CLIENTAREA   0x1
+#define VIS_CLIPCHILDREN 0x2
+#define VIS_CLIPSIBLINGS 0x4
+
+/* The styles of the window itself its visible region depends on */
+#define VIS_STYLE_MASK (WS_VISIBLE | WS_MINIMIZE | WS_CLIPSIBLINGS)
+
+typedef struct _VISCACHE
 {
-   PREGION VisRgn, ClipRgn;
-   PWND PreviousWindow, CurrentWindow, CurrentSibling;
+   PREGION Rgn;
+   ULONG Generation;
+   ULONG Flags;
+   ULONG Style;
+   RECTL rcWindow;
+   RECTL rcClient;
+   HRGN hrgnClip;
+} VISCACHE, *PVISCACHE;
 
-   if (!Wnd || !(Wnd->style & WS_VISIBLE))
+static RECTL VisChangeLog[VIS_CHANGE_LOG_SIZE];
+static ULONG VisGeneration = 0;
+
+static BOOLEAN
+VIS_AncestorsVisible(PWND Wnd)
+{
+   PWND CurrentWindow;
+
+   for (CurrentWindow = Wnd->spwndParent;
+        CurrentWindow;
+        CurrentWindow = CurrentWindow->spwndParent)
    {
-      return NULL;
+      if (!VerifyWnd(CurrentWindow))
+      {
+         ERR("ATM the Current Window or Parent is dead! %p\n",CurrentWindow);
+         return FALSE;
+      }
+
+      if (!(CurrentWindow->style & WS_VISIBLE))
+      {
+         return FALSE;
+      }
    }
 
-   VisRgn = NULL;
+   return TRUE;
+}
 
-   if (ClientArea)
+/*
+ * Removes a window, cut by its window region if it has one, from the
+ * visible region.
+ */
+static VOID
+VIS_ExcludeWindow(PREGION VisRgn, PWND Window)
+{
+   PREGION ClipRgn, WndRgnClip;
+   RECTL rcDummy;
+
+   /* Most windows don't even touch what is left */
+   if (!RECTL_bIntersectRect(&rcDummy, &VisRgn->rdh.rcBound, &Window->rcWindow))
+   {
+      return;
+   }
+
+   if (!Window->hrgnClip || (Window->style & WS_MINIMIZE))
+   {
+      REGION_SubtractRectFromRgn(VisRgn, VisRgn, &Window->rcWindow);
+      return;
+   }
+
+   ClipRgn = IntSysCreateRectpRgnIndirect(&Window->rcWindow);
+   if (!ClipRgn)
+   {
+      return;
+   }
+
+   /* Combine it with the window region */
+   WndRgnClip = REGION_LockRgn(Window->hrgnClip);
+   if (WndRgnClip)
+   {
+      REGION_bOffsetRgn(ClipRgn, -Window->rcWindow.left, -Window->rcWindow.top);
+      IntGdiCombineRgn(ClipRgn, ClipRgn, WndRgnClip, RGN_AND);
+      REGION_bOffsetRgn(ClipRgn, Window->rcWindow.left, Window->rcWindow.top);
+      REGION_UnlockRgn(WndRgnClip);
+   }
+   IntGdiCombineRgn(VisRgn, VisRgn, ClipRgn, RGN_DIFF);
+   REGION_Delete(ClipRgn);
+}
+
+static PREGION
+VIS_ComputeRegion(PWND Wnd, ULONG Flags)
+{
+   PREGION VisRgn;
+   PWND PreviousWindow, CurrentWindow, CurrentSibling;
+
+   if (Flags & VIS_CLIENTAREA)
    {
       VisRgn = IntSysCreateRectpRgnIndirect(&Wnd->rcClient);
    }
@@ -35,6 +118,11 @@ VIS_ComputeVisibleRegion(
       VisRgn = IntSysCreateRectpRgnIndirect(&Wnd->rcWindow);
    }
 
+   if (!VisRgn)
+   {
+      return NULL;
+   }
+
    /*
     * Walk through all parent windows and for each clip the visble region
     * to the parent's client area and exclude all siblings that are over
@@ -45,27 +133,14 @@ VIS_ComputeVisibleRegion(
    CurrentWindow = Wnd->spwndParent;
    while (CurrentWindow)
    {
-      if (!VerifyWnd(CurrentWindow))
-      {
-         ERR("ATM the Current Window or Parent is dead! %p\n",CurrentWindow);
-         if (VisRgn)
-             REGION_Delete(VisRgn);
-         return NULL;
-      }
-
-      if (!(CurrentWindow->style & WS_VISIBLE))
+      /* Nothing can become visible again */
+      if (REGION_CropRegion(VisRgn, VisRgn, &CurrentWindow->rcClient) == NULLREGION)
       {
-         if (VisRgn)
-             REGION_Delete(VisRgn);
-         return NULL;
+         return VisRgn;
       }
 
-      ClipRgn = IntSysCreateRectpRgnIndirect(&CurrentWindow->rcClient);
-      IntGdiCombineRgn(VisRgn, VisRgn, ClipRgn, RGN_AND);
-      REGION_Delete(ClipRgn);
-
       if ((PreviousWindow->style & WS_CLIPSIBLINGS) ||
-          (PreviousWindow == Wnd && ClipSiblings))
+          (PreviousWindow == Wnd && (Flags & VIS_CLIPSIBLINGS)))
       {
          CurrentSibling = CurrentWindow->spwndChild;
          while ( CurrentSibling != NULL &&
@@ -74,21 +149,7 @@ VIS_ComputeVisibleRegion(
             if ((CurrentSibling->style & WS_VISIBLE) &&
                 !(CurrentSibling->ExStyle & WS_EX_TRANSPARENT))
             {
-               ClipRgn = IntSysCreateRectpRgnIndirect(&CurrentSibling->rcWindow);
-               /* Combine it with the window region if available */
-               if (CurrentSibling->hrgnClip && !(CurrentSibling->style & WS_MINIMIZE))
-               {
-                  PREGION SiblingClipRgn = REGION_LockRgn(CurrentSibling->hrgnClip);
-                  if (SiblingClipRgn)
-                  {
-                      REGION_bOffsetRgn(ClipRgn, -CurrentSibling->rcWindow.left, -CurrentSibling->rcWindow.top);
-                      IntGdiCombineRgn(ClipRgn, ClipRgn, SiblingClipRgn, RGN_AND);
-                      REGION_bOffsetRgn(ClipRgn, CurrentSibling->rcWindow.left, CurrentSibling->rcWindow.top);
-                      REGION_UnlockRgn(SiblingClipRgn);
-                  }
-               }
-               IntGdiCombineRgn(VisRgn, VisRgn, ClipRgn, RGN_DIFF);
-               REGION_Delete(ClipRgn);
+               VIS_ExcludeWindow(VisRgn, CurrentSibling);
             }
             CurrentSibling = CurrentSibling->spwndNext;
          }
@@ -98,7 +159,7 @@ VIS_ComputeVisibleRegion(
       CurrentWindow = CurrentWindow->spwndParent;
    }
 
-   if (ClipChildren)
+   if (Flags & VIS_CLIPCHILDREN)
    {
       CurrentWindow = Wnd->spwndChild;
       while (CurrentWindow)
@@ -106,21 +167,7 @@ VIS_ComputeVisibleRegion(
          if ((CurrentWindow->style & WS_VISIBLE) &&
              !(CurrentWindow->ExStyle & WS_EX_TRANSPARENT))
          {
-            ClipRgn = IntSysCreateRectpRgnIndirect(&CurrentWindow->rcWindow);
-            /* Combine it with the window region if available */
-            if (CurrentWindow->hrgnClip && !(CurrentWindow->style & WS_MINIMIZE))
-            {
-               PREGION CurrentRgnClip = REGION_LockRgn(CurrentWindow->hrgnClip);
-               if (CurrentRgnClip)
-               {
-                   REGION_bOffsetRgn(ClipRgn, -CurrentWindow->rcWindow.left, -CurrentWindow->rcWindow.top);
-                   IntGdiCombineRgn(ClipRgn, ClipRgn, CurrentRgnClip, RGN_AND);
-                   REGION_bOffsetRgn(ClipRgn, CurrentWindow->rcWindow.left, CurrentWindow->rcWindow.top);
-                   REGION_UnlockRgn(CurrentRgnClip);
-               }
-            }
-            IntGdiCombineRgn(VisRgn, VisRgn, ClipRgn, RGN_DIFF);
-            REGION_Delete(ClipRgn);
+            VIS_ExcludeWindow(VisRgn, CurrentWindow);
          }
          CurrentWindow = CurrentWindow->spwndNext;
       }
@@ -141,6 +188,169 @@ VIS_ComputeVisibleRegion(
    return VisRgn;
 }
 
+static BOOLEAN
+VIS_CacheValid(PWND Wnd, PVISCACHE Cache, ULONG Flags)
+{
+   RECTL rcBound, rcDummy;
+   ULONG Generation;
+
+   /* The window itself must be unchanged */
+   if (Cache->Flags != Flags ||
+       Cache->Style != (Wnd->style & VIS_STYLE_MASK) ||
+       Cache->hrgnClip != Wnd->hrgnClip ||
+       !RtlEqualMemory(&Cache->rcWindow, &Wnd->rcWindow, sizeof(RECTL)) ||
+       !RtlEqualMemory(&Cache->rcClient, &Wnd->rcClient, sizeof(RECTL)))
+   {
+      return FALSE;
+   }
+
+   /* The log only keeps the last changes */
+   if (VisGeneration - Cache->Generation > VIS_CHANGE_LOG_SIZE)
+   {
+      return FALSE;
+   }
+
+   RECTL_bUnionRect(&rcBound, &Wnd->rcWindow, &Wnd->rcClient);
+   for (Generation = Cache->Generation; Generation != VisGeneration; )
+   {
+      Generation++;
+      if (RECTL_bIntersectRect(&rcDummy,
+                               &VisChangeLog[Generation % VIS_CHANGE_LOG_SIZE],
+                               &rcBound))
+      {
+         return FALSE;
+      }
+   }
+
+   /* None of these changes matter, don't look at them again */
+   Cache->Generation = VisGeneration;
+   return TRUE;
+}
+
+static VOID
+VIS_StoreCache(PWND Wnd, PREGION VisRgn, ULONG Flags)
+{
+   PVISCACHE Cache = Wnd->pVisCache;
+
+   if (!Cache)
+   {
+      Cache = ExAllocatePoolWithTag(PagedPool, sizeof(VISCACHE), USERTAG_VISRGN);
+      if (!Cache)
+      {
+         return;
+      }
+      Cache->Rgn = NULL;
+      Wnd->pVisCache = Cache;
+   }
+
+   if (!Cache->Rgn)
+   {
+      Cache->Rgn = IntSysCreateRectpRgn(0, 0, 0, 0);
+   }
+
+   if (!Cache->Rgn ||
+       IntGdiCombineRgn(Cache->Rgn, VisRgn, NULL, RGN_COPY) == ERROR)
+   {
+      VIS_FreeCache(Wnd);
+      return;
+   }
+
+   Cache->Generation = VisGeneration;
+   Cache->Flags = Flags;
+   Cache->Style = Wnd->style & VIS_STYLE_MASK;
+   Cache->rcWindow = Wnd->rcWindow;
+   Cache->rcClient = Wnd->rcClient;
+   Cache->hrgnClip = Wnd->hrgnClip;
+}
+
+PREGION FASTCALL
+VIS_ComputeVisibleRegion(
+   PWND Wnd,
+   BOOLEAN ClientArea,
+   BOOLEAN ClipChildren,
+   BOOLEAN ClipSiblings)
+{
+   PREGION VisRgn;
+   ULONG Flags;
+   BOOLEAN UseCache;
+
+   if (!Wnd || !(Wnd->style & WS_VISIBLE))
+   {
+      return NULL;
+   }
+
+   if (!VIS_AncestorsVisible(Wnd))
+   {
+      return NULL;
+   }
+
+   Flags = (ClientArea ? VIS_CLIENTAREA : 0) |
+           (ClipChildren ? VIS_CLIPCHILDREN : 0) |
+           (ClipSiblings ? VIS_CLIPSIBLINGS : 0);
+
+   /* The cache and the change log are protected by the exclusive lock */
+   UseCache = UserIsEnteredExclusive() && !(Wnd->state2 & WNDS2_INDESTROY);
+
+   if (UseCache && Wnd->pVisCache &&
+       VIS_CacheValid(Wnd, Wnd->pVisCache, Flags))
+   {
+      /* The caller owns what it gets */
+      VisRgn = IntSysCreateRectpRgn(0, 0, 0, 0);
+      if (VisRgn)
+      {
+         if (IntGdiCombineRgn(VisRgn, ((PVISCACHE)Wnd->pVisCache)->Rgn, NULL, RGN_COPY) != ERROR)
+            return VisRgn;
+         REGION_Delete(VisRgn);
+      }
+   }
+
+   VisRgn = VIS_ComputeRegion(Wnd, Flags);
+
+   if (UseCache && VisRgn)
+   {
+      VIS_StoreCache(Wnd, VisRgn, Flags);
+   }
+
+   return VisRgn;
+}
+
+/*
+ * Must be called after the position, the z-order, the visibility or the
+ * window region of a window changed, with its previous window rectangle if
+ * it moved. Cached visible regions of the windows in that area are dropped.
+ */
+VOID FASTCALL
+VIS_WindowChanged(
+   PWND Window,
+   const RECTL *prclOld)
+{
+   RECTL rcChanged;
+
+   RECTL_bUnionRect(&rcChanged, &Window->rcWindow, &Window->rcClient);
+   if (prclOld)
+   {
+      RECTL_bUnionRect(&rcChanged, &rcChanged, prclOld);
+   }
+
+   VisGeneration++;
+   VisChangeLog[VisGeneration % VIS_CHANGE_LOG_SIZE] = rcChanged;
+}
+
+VOID FASTCALL
+VIS_FreeCache(
+   PWND Window)
+{
+   PVISCACHE Cache = Window->pVisCache;
+
+   if (Cache)
+   {
+      if (Cache->Rgn)
+         REGION_Delete(Cache->Rgn);
+      ExFreePoolWithTag(Cache, USERTAG_VISRGN);
+      Window->pVisCache = NULL;
+   }
+}
+
 VOID FASTCALL
 co_VIS_WindowLayoutChanged(
    PWND Wnd,
@@ -36,6 +36,9 @@
 
 #define QSIDCOUNTS 7
 
+/* Hash buckets of the posted message indexes, see msgqueue.c */
+#define POSTED_INDEX_BUCKETS 32
+
 typedef enum _QS_ROS_TYPES
 {
     QSRosKey = 0,
@@ -135,6 +138,10 @@ typedef struct _THREADINFO
     INT                 cEnterCount;
     /* Queue of messages posted to the queue. */
     LIST_ENTRY          PostedMessagesListHead; // mlPost
+    /* The same messages, hashed by window and by message number */
+    LIST_ENTRY          aPostedWndIndex[POSTED_INDEX_BUCKETS];
+    LIST_ENTRY          aPostedMsgIndex[POSTED_INDEX_BUCKETS];
+    ULONG               PostedSequence;
     WORD                fsChangeBitsRemoved;
     WCHAR               wchInjected;
     UINT                cWindows;
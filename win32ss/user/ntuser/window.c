@@ -149,6 +149,8 @@ IntSetStyle( PWND pwnd, ULONG set_bits, ULONG clear_bits )
     styleNew = (pwnd->style | set_bits) & ~clear_bits;
     if (styleNew == styleOld) return styleNew;
     pwnd->style = styleNew;
+    if ((styleOld ^ styleNew) & (WS_VISIBLE | WS_CLIPSIBLINGS | WS_MINIMIZE))
+       VIS_WindowChanged(pwnd, NULL);
     if ((styleOld ^ styleNew) & WS_VISIBLE) // State Change.
     {
        if (styleOld & WS_VISIBLE) pwnd->head.pti->cVisWindows--;
@@ -727,6 +729,7 @@ LRESULT co_UserFreeWindow(PWND Window,
    DceFreeWindowDCE(Window);    /* Always do this to catch orphaned DCs */
 
    IntUnlinkWindow(Window);
+   VIS_FreeCache(Window);
 
    if (Window->PropListItems)
    {
@@ -978,6 +981,8 @@ IntLinkWindow(
 
         WndSetChild(Wnd->spwndParent, Wnd);
     }
+
+    VIS_WindowChanged(Wnd, NULL);
 }
 
 /*
@@ -1248,6 +1253,7 @@ co_IntSetParent(PWND Wnd, PWND WndNewParent)
        !(Wnd->style & WS_CLIPSIBLINGS) )
    {
       Wnd->style |= WS_CLIPSIBLINGS;
+      VIS_WindowChanged(Wnd, NULL);
       DceResetActiveDCEs(Wnd);
    }
 
@@ -1370,6 +1376,8 @@ IntUnlinkWindow(PWND Wnd)
 
     WndSetPrev(Wnd, NULL);
     WndSetNext(Wnd, NULL);
+
+    VIS_WindowChanged(Wnd, NULL);
 }
 
 // Win: ExpandWindowList
@@ -3915,6 +3923,7 @@ co_IntSetWindowLongPtr(HWND hWnd, DWORD Index, LONG_PTR NewValue, BOOL Ansi, ULO
             }
 
             Window->ExStyle = (DWORD)Style.styleNew;
+            VIS_WindowChanged(Window, NULL);
 
             co_IntSendMessage(hWnd, WM_STYLECHANGED, GWL_EXSTYLE, (LPARAM) &Style);
             break;
@@ -3968,6 +3977,7 @@ co_IntSetWindowLongPtr(HWND hWnd, DWORD Index, LONG_PTR NewValue, BOOL Ansi, ULO
                DceResetActiveDCEs( Window );
             }
             Window->style = (DWORD)Style.styleNew;
+            VIS_WindowChanged(Window, NULL);
 
             if (!bAlter)
                 co_IntSendMessage(hWnd, WM_STYLECHANGED, GWL_STYLE, (LPARAM) &Style);
@@ -277,6 +277,8 @@ SelectWindowRgn(PWND Window, HRGN hRgnClip)
 
         Window->hrgnClip = hRgnClip;
     }
+
+    VIS_WindowChanged(Window, NULL);
 }
 
 //
@@ -2013,6 +2015,7 @@ co_WinPosSetWindowPos(
                      NewWindowRect.top - OldWindowRect.top);
    }
 
+   VIS_WindowChanged(Window, &OldWindowRect);
    DceResetActiveDCEs(Window); // For WS_VISIBLE changes.
 
    // Change or update, set send non-client paint flag.